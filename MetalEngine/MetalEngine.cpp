@@ -3,6 +3,13 @@
 
 #include "MetalEngine.h"
 #include "src/headers/MVulkanRenderer.hpp"
+#include "src/headers/MVulkanOffscreen.hpp"
+#include "src/headers/MFrameLoop.hpp"
+#include "src/headers/MJobSystem.hpp"
+#include "src/headers/MLog.h"
+#include "src/headers/MProfiler.hpp"
+#include "src/headers/MCounters.h"
+#include "src/headers/MError.h"
 
 #if defined(WIN32)
 	#include <windows.h>
@@ -12,32 +19,241 @@
 
 using namespace std;
 using namespace engine::vulkan;
+using namespace engine::jobs;
+using namespace engine::loop;
 
-int main(int argc, char* argv[])
+/* Renders a fixed number of frames with no window and prints the counters, for regression runs
+	and thumbnails on machines without a display or GPU (lavapipe works)
+*/
+static int RunHeadless(QWord frames, const char* thumbnail)
 {
-	MetalVulkanWindow* win = new MetalVulkanWindow();
-	
-	if (win->CreateSDLWindow(1280, 720, "MetalEngine") != 0)
+	if (VulkanSetupHeadless() != 0)
+	{
+		return 1;
+	}
+
+	MetalOffscreenTarget* target = new MetalOffscreenTarget();
+	if (target->Create(1280, 720) != 0)
+	{
+		delete target;
+		VulkanShutdownHeadless();
+		return 1;
+	}
+
+	const float clearcolor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	for (QWord frame = 0; frame < frames; frame++)
+	{
+		METAL_FRAME_MARK();
+
+		target->BeginFrame();
+		target->BeginRenderPass(clearcolor);
+		target->EndFrame();
+
+		MetalCountersEndFrame();
+	}
+
+	/* A missing thumbnail fails the run, CI has nothing else to tell it from a good one*/
+	int result = 0;
+	if (thumbnail != nullptr && target->SaveLastFrame(thumbnail) != 0)
 	{
+		WarningMessage("Headless WARNING", "Failed to save the last frame to %s", thumbnail);
+		result = 1;
+	}
+
+	char summary[160];
+	MetalCountersFormat(summary, sizeof(summary));
+	fmt::print("ENGINE: {} headless frames | {}\n", frames, summary);
+
+	delete target;
+	VulkanShutdownHeadless();
+	return result;
+}
+
+/* What the windowed loop's callbacks share*/
+struct MetalEngineState
+{
+	MetalVulkanWindow*	window	= nullptr;
+	QWord				frame	= 0;
+};
+
+static void SimulateEngine(void* userdata, double seconds, QWord tick)
+{
+	/* Nothing simulates yet, game state goes here and publishes through a MetalStateBuffer*/
+	(void)userdata;
+	(void)seconds;
+	(void)tick;
+}
+
+static void RenderEngine(void* userdata, double alpha)
+{
+	MetalEngineState* state = static_cast<MetalEngineState*>(userdata);
+	(void)alpha;
+
+	/* Poor man's HUD until there is text rendering*/
+	if (++state->frame % 60 == 0)
+	{
+		char title[160];
+		int length = snprintf(title, sizeof(title), "MetalEngine | ");
+		MetalCountersFormat(title + length, sizeof(title) - length);
+		SDL_SetWindowTitle(state->window->GetWindow(), title);
+	}
+}
+
+static bool HandleEngineEvent(void* userdata, const SDL_Event& event)
+{
+	(void)userdata;
+
+	if (event.type == SDL_EVENT_QUIT)
+	{
+		return false;
+	}
+	else if (event.type == SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED)
+	{
+		VulkanRequestSwapchainResize(static_cast<VkUint32>(event.window.data1), static_cast<VkUint32>(event.window.data2));
+	}
+	/* F10 cycles V-Sync, mailbox and immediate*/
+	else if (event.type == SDL_EVENT_KEY_DOWN && event.key.key == SDLK_F10)
+	{
+		VulkanSetPresentMode(m_present_mode == VK_PRESENT_MODE_MAILBOX_KHR ? VK_PRESENT_MODE_IMMEDIATE_KHR
+			: m_present_mode == VK_PRESENT_MODE_IMMEDIATE_KHR ? VK_PRESENT_MODE_FIFO_KHR : VK_PRESENT_MODE_MAILBOX_KHR);
+	}
+#if defined(METAL_PROFILE)
+	/* F12 dumps the last frames for chrome://tracing*/
+	else if (event.type == SDL_EVENT_KEY_DOWN && event.key.key == SDLK_F12)
+	{
+		engine::profiler::ProfilerExportChrome("MetalProfile.json", 120);
+	}
+#endif
+
+	return true;
+}
+
+/* Everything between MetalLogInit and MetalLogShutdown, it returns instead of exiting so main always
+	joins the logger thread and flushes whatever explains the failure*/
+static int RunEngine(int argc, char* argv[])
+{
+	/* --headless renders offscreen with no window, --frames <n> (default 120) and --thumbnail <file.ppm> go with it*/
+	bool headless = false;
+	QWord headlessframes = 120;
+	const char* thumbnail = nullptr;
+
+	/* --tickrate <n> simulation ticks per second, --framecap <n> frames per second (default and 0 the display's refresh rate), --simthread*/
+	MetalFrameLoopSettings loopsettings;
+	bool capgiven = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--headless") == 0)
+		{
+			headless = true;
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			headlessframes = strtoull(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--thumbnail") == 0 && i + 1 < argc)
+		{
+			thumbnail = argv[++i];
+		}
+		else if (strcmp(argv[i], "--tickrate") == 0 && i + 1 < argc)
+		{
+			loopsettings.tickrate = strtod(argv[++i], nullptr);
+		}
+		else if (strcmp(argv[i], "--framecap") == 0 && i + 1 < argc)
+		{
+			loopsettings.framecap = strtod(argv[++i], nullptr);
+			capgiven = loopsettings.framecap > 0.0;
+		}
+		else if (strcmp(argv[i], "--simthread") == 0)
+		{
+			loopsettings.simthread = true;
+		}
+	}
+
+	MetalVulkanWindow* win = nullptr;
+	if (!headless)
+	{
+		win = new MetalVulkanWindow();
+		if (win->CreateSDLWindow(1280, 720, "MetalEngine") != 0)
+		{
+			delete win;
+			return -1;
+		}
+	}
+
+	/* One worker per core, this thread is worker 0*/
+	if (JobSystemInit() != 0)
+	{
+		delete win;
 		return -1;
 	}
 
-	bool running = true;
-	SDL_Event event;
+	/* --counters-csv <file> writes the counters every second or so, for soak runs*/
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--counters-csv") == 0 && MetalCountersOpenCsv(argv[i + 1], 60) != 0)
+		{
+			WarningMessage("Counters WARNING", "Failed to open %s", argv[i + 1]);
+		}
+	}
+
+	/* Headless runs are regression and thumbnail jobs, their exit code is how CI sees a failure*/
+	int result = 0;
+	if (headless && RunHeadless(headlessframes, thumbnail) != 0)
+	{
+		WarningMessage("Headless WARNING", "Headless rendering failed");
+		result = 1;
+	}
 
-	while (running)
+	if (!headless)
 	{
-		while (SDL_PollEvent(&event))
+		/* Nothing presents yet so nothing blocks in FIFO, cap to the display unless given a cap. An uncapped
+			loop (--framecap 0) would spin a core, so 0 gets the display's rate too until frames are presented*/
+		const SDL_DisplayMode* mode = SDL_GetCurrentDisplayMode(SDL_GetDisplayForWindow(win->GetWindow()));
+		if (!capgiven)
 		{
-			if (event.type == SDL_EVENT_QUIT)
-			{
-				running = false;
-			}
+			loopsettings.framecap = mode != nullptr && mode->refresh_rate > 0.0f ? mode->refresh_rate : 60.0;
 		}
+
+		MetalEngineState state;
+		state.window = win;
+		loopsettings.window = win->GetWindow();
+
+		MetalFrameLoop* loop = new MetalFrameLoop();
+		if (loop->Run(loopsettings, SimulateEngine, RenderEngine, HandleEngineEvent, &state) != 0)
+		{
+			WarningMessage("Frame Loop WARNING", "Failed to run the frame loop");
+		}
+		delete loop;
 	}
 
+	MetalCountersCloseCsv();
+	JobSystemShutdown();
+
 	/*The class decontructor does the SDL_DestroyWindow and SDL_Quit for us*/
-	delete win;
+	if (win != nullptr)
+	{
+		delete win;
+	}
+
+	return result;
+}
+
+int main(int argc, char* argv[])
+{
+	/* Lines logged before this are written inline*/
+	MetalLogInit();
+
+#if defined(METAL_PROFILE)
+	engine::profiler::ProfilerInit();
+#endif
+
+	int result = RunEngine(argc, argv);
+
+#if defined(METAL_PROFILE)
+	engine::profiler::ProfilerShutdown();
+#endif
+
+	MetalLogShutdown();
 
-	return 0;
+	return result;
 }
\ No newline at end of file
@@ -0,0 +1,903 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Rendering benchmark (deterministic scenes, headless frames, baseline regression gating)
+// ------------------------------------------------------
+
+/*
+	metal_renderbench builds the same scene every run from a seed: N cubes, M bindless materials and
+	K procedurally generated textures that go through the texture streamer. It renders a fixed number
+	of frames offscreen, writes the results as JSON and, given a baseline written by an earlier run,
+	fails when a metric got worse by more than the threshold.
+
+	metal_renderbench [--objects N] [--materials M] [--textures K] [--texture-size S] [--frames F]
+		[--warmup W] [--seed S] [--width X] [--height Y] [--instanced 0|1] [--shaders dir]
+		[--output file.json] [--baseline file.json] [--threshold percent]
+
+	--instanced 1 streams the objects through MetalInstanceBatcher every frame and draws them with
+	fog_instanced.vert, one draw per material instead of one per object.
+
+	Exit codes: 0 passed, 1 regressed, 2 the benchmark could not run. To update the baseline copy
+	a run's output over it.
+*/
+
+#include "src/headers/MVulkanRenderer.hpp"
+#include "src/headers/MVulkanOffscreen.hpp"
+#include "src/headers/MVulkanBindless.hpp"
+#include "src/headers/MVulkanIndirect.hpp"
+#include "src/headers/MVulkanInstancing.hpp"
+#include "src/headers/MTextureStreamer.hpp"
+#include "src/headers/MJobSystem.hpp"
+#include "src/headers/MLog.h"
+#include "src/headers/MProfiler.hpp"
+#include "src/headers/MCounters.h"
+#include "src/headers/MError.h"
+
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <map>
+
+using namespace std;
+using namespace engine::vulkan;
+using namespace engine::jobs;
+
+struct MetalBenchSettings
+{
+	DWord		objects		= 4096;
+	DWord		materials	= 64;
+	DWord		textures	= 32;
+	DWord		texturesize	= 256;
+	DWord		frames		= 600;
+	DWord		warmup		= 60;
+	QWord		seed		= 1;
+	VkUint32	width		= 1280;
+	VkUint32	height		= 720;
+	bool		instanced	= false;	/* Batch through MetalInstanceBatcher instead of a draw per object*/
+	string		shaders		= "shaders/vulkan";
+	string		output		= "renderbench.json";
+	string		baseline;
+	double		threshold	= 10.0;	/* Percent a metric may grow before it counts as a regression*/
+};
+
+/* Userdata of the texture reader, the pixels are made up on the worker that asks for them*/
+struct MetalBenchTexture
+{
+	imagefile	file;
+	QWord		seed;
+	DWord		handle;
+};
+
+/* Mirrors UMO in fog_indirect.vert*/
+struct MetalBenchFrameData
+{
+	vec4f	viewprojrows[4];
+	vec4f	texgen[4];
+};
+
+/* Mirrors MetalFogMaterial in fog_bindless.frag*/
+struct MetalBenchMaterial
+{
+	vec4f	color;
+	DWord	texture0;	/* Index into the scene's textures, the bindless slot is looked up every frame*/
+	DWord	texture1;
+};
+
+struct MetalBenchScene
+{
+	vector<MetalBenchTexture>	textures;
+	vector<MetalBenchMaterial>	materials;
+	vector<DWord>				objectmaterials;	/* Material of every object, objects are sorted by it*/
+	vector<mat4f>				objectmodels;		/* What the instanced path submits every frame*/
+	MetalInstanceBatcher		batcher;
+	MetalTextureStreamer		streamer;
+	DWord						materialslot		= BINDLESS_INVALID;
+	VkBuffer					vertexbuffer		= VK_NULL_HANDLE;
+	VkDeviceMemory				vertexmemory		= VK_NULL_HANDLE;
+	VkBuffer					indexbuffer			= VK_NULL_HANDLE;
+	VkDeviceMemory				indexmemory			= VK_NULL_HANDLE;
+	VkBuffer					instancebuffer		= VK_NULL_HANDLE;
+	VkDeviceMemory				instancememory		= VK_NULL_HANDLE;
+	VkBuffer					materialbuffer		= VK_NULL_HANDLE;
+	VkDeviceMemory				materialmemory		= VK_NULL_HANDLE;
+	VkBuffer					framebuffer			= VK_NULL_HANDLE;
+	VkDeviceMemory				framememory			= VK_NULL_HANDLE;
+	VkDescriptorSetLayout		framesetlayout		= VK_NULL_HANDLE;
+	VkDescriptorPool			framepool			= VK_NULL_HANDLE;
+	VkDescriptorSet				frameset			= VK_NULL_HANDLE;
+	VkPipelineLayout			pipelinelayout		= VK_NULL_HANDLE;
+	VkPipeline					pipeline			= VK_NULL_HANDLE;
+	VkQueryPool					querypool			= VK_NULL_HANDLE;
+	double						pipelinems			= 0.0;
+};
+
+/* splitmix64, the standard library's distributions differ between implementations so the scene
+	would not be the same everywhere with them
+*/
+static QWord BenchRandom(QWord& state)
+{
+	QWord z = (state += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+static float BenchRandomFloat(QWord& state, float low, float high)
+{
+	return low + (high - low) * static_cast<float>(BenchRandom(state) >> 40) / static_cast<float>(1 << 24);
+}
+
+/* A checkerboard in two colors picked from the texture's seed, the cells stay the same size on screen at every mip*/
+static bool ReadBenchTexture(void* userdata, DWord mip, Byte* destination, QWord size)
+{
+	const MetalBenchTexture* Texture = static_cast<const MetalBenchTexture*>(userdata);
+	const imagemip& Level = Texture->file.mips[mip];
+
+	QWord State = Texture->seed;
+	Byte Colors[2][4];
+	for (int c = 0; c < 2; c++)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			Colors[c][i] = static_cast<Byte>(BenchRandom(State) & 0xFF);
+		}
+		Colors[c][3] = 255;
+	}
+
+	DWord Cell = max<DWord>(1, 32 >> mip);
+	for (DWord y = 0; y < Level.height; y++)
+	{
+		for (DWord x = 0; x < Level.width; x++)
+		{
+			const Byte* Color = Colors[((x / Cell) + (y / Cell)) & 1];
+			memcpy(destination + (static_cast<QWord>(y) * Level.width + x) * 4, Color, 4);
+		}
+	}
+
+	return size == Level.size;
+}
+
+static double Milliseconds(std::chrono::steady_clock::duration duration)
+{
+	return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+static double Percentile(vector<double> samples, double percentile)
+{
+	if (samples.empty())
+	{
+		return 0.0;
+	}
+
+	usize Index = static_cast<usize>(percentile / 100.0 * static_cast<double>(samples.size() - 1) + 0.5);
+	nth_element(samples.begin(), samples.begin() + Index, samples.end());
+	return samples[Index];
+}
+
+static int CreateShaderModule(const string& path, VkShaderModule& module)
+{
+	vector<char> Code = MetalVulkanPipeline::ReadShaderFile(path);
+	if (Code.empty())
+	{
+		return 1;
+	}
+
+	VkShaderModuleCreateInfo ModuleInfo = {};
+	ModuleInfo.sType	= VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	ModuleInfo.codeSize	= Code.size();
+	ModuleInfo.pCode	= reinterpret_cast<const VkUint32*>(Code.data());
+	VK_CHECK(vkCreateShaderModule(m_device, &ModuleInfo, nullptr, &module));
+	return 0;
+}
+
+/* fog_indirect.vert (fog_instanced.vert when instanced) + fog_bindless.frag, timed from reading the SPIR-V to the finished pipeline*/
+static int CreateBenchPipeline(MetalBenchScene& scene, const MetalBenchSettings& settings, VkRenderPass renderpass)
+{
+	auto Start = std::chrono::steady_clock::now();
+
+	VkShaderModule VertexModule = VK_NULL_HANDLE;
+	VkShaderModule FragmentModule = VK_NULL_HANDLE;
+	string VertexShader = settings.instanced ? "/fog_instanced.vert.spv" : "/fog_indirect.vert.spv";
+	if (CreateShaderModule(settings.shaders + VertexShader, VertexModule) != 0
+		|| CreateShaderModule(settings.shaders + "/fog_bindless.frag.spv", FragmentModule) != 0)
+	{
+		vkDestroyShaderModule(m_device, VertexModule, nullptr);
+		return 1;
+	}
+
+	array<VkPipelineShaderStageCreateInfo, 2> Stages = {};
+	Stages[0].sType		= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	Stages[0].stage		= VK_SHADER_STAGE_VERTEX_BIT;
+	Stages[0].module	= VertexModule;
+	Stages[0].pName		= "main";
+	Stages[1].sType		= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	Stages[1].stage		= VK_SHADER_STAGE_FRAGMENT_BIT;
+	Stages[1].module	= FragmentModule;
+	Stages[1].pName		= "main";
+
+	VkVertexInputBindingDescription Binding = {};
+	Binding.binding		= 0;
+	Binding.stride		= sizeof(float) * 3;
+	Binding.inputRate	= VK_VERTEX_INPUT_RATE_VERTEX;
+
+	VkVertexInputAttributeDescription Attribute = {};
+	Attribute.location	= 0;
+	Attribute.binding	= 0;
+	Attribute.format	= VK_FORMAT_R32G32B32_SFLOAT;
+	Attribute.offset	= 0;
+
+	VkPipelineVertexInputStateCreateInfo VertexInput = {};
+	VertexInput.sType							= VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	VertexInput.vertexBindingDescriptionCount	= 1;
+	VertexInput.pVertexBindingDescriptions		= &Binding;
+	VertexInput.vertexAttributeDescriptionCount	= 1;
+	VertexInput.pVertexAttributeDescriptions	= &Attribute;
+
+	MetalInstancedVertexInput InstancedInput;
+
+	/* The config is returned by value, point its state back at its own viewport, scissor and attachment*/
+	MetalVulkanPipelineConfigInfo Config = MetalVulkanPipeline::DefaultPipelineConfigInfo(settings.width, settings.height);
+	Config.viewportinfo.pViewports			= &Config.viewport;
+	Config.viewportinfo.pScissors			= &Config.scissor;
+	Config.colorblendinfo.pAttachments		= &Config.colorblend_attachment;
+	Config.rasterizationinfo.cullMode		= VK_CULL_MODE_NONE;
+
+	VkPipelineDepthStencilStateCreateInfo DepthStencil = {};
+	DepthStencil.sType				= VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	DepthStencil.depthTestEnable	= VK_TRUE;
+	DepthStencil.depthWriteEnable	= VK_TRUE;
+	DepthStencil.depthCompareOp		= VK_COMPARE_OP_LESS;
+	DepthStencil.minDepthBounds		= 0.0f;
+	DepthStencil.maxDepthBounds		= 1.0f;
+
+	VkGraphicsPipelineCreateInfo PipelineInfo = {};
+	PipelineInfo.sType					= VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	PipelineInfo.stageCount				= static_cast<VkUint32>(Stages.size());
+	PipelineInfo.pStages				= Stages.data();
+	PipelineInfo.pVertexInputState		= settings.instanced ? &InstancedInput.info : &VertexInput;
+	PipelineInfo.pInputAssemblyState	= &Config.inputassemblyinfo;
+	PipelineInfo.pViewportState			= &Config.viewportinfo;
+	PipelineInfo.pRasterizationState	= &Config.rasterizationinfo;
+	PipelineInfo.pMultisampleState		= &Config.multisampleinfo;
+	PipelineInfo.pColorBlendState		= &Config.colorblendinfo;
+	PipelineInfo.pDepthStencilState		= &DepthStencil;
+	PipelineInfo.layout					= scene.pipelinelayout;
+	PipelineInfo.renderPass				= renderpass;
+	PipelineInfo.subpass				= 0;
+	PipelineInfo.basePipelineIndex		= -1;
+	VK_CHECK(vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &PipelineInfo, nullptr, &scene.pipeline));
+
+	vkDestroyShaderModule(m_device, VertexModule, nullptr);
+	vkDestroyShaderModule(m_device, FragmentModule, nullptr);
+
+	scene.pipelinems = Milliseconds(std::chrono::steady_clock::now() - Start);
+	return scene.pipeline != VK_NULL_HANDLE ? 0 : 1;
+}
+
+static int CreateBenchScene(MetalBenchScene& scene, const MetalBenchSettings& settings, VkRenderPass renderpass)
+{
+	QWord State = settings.seed;
+
+	/* Textures, streamed in like any other*/
+	if (scene.streamer.Create() != 0)
+	{
+		return 1;
+	}
+
+	scene.textures.resize(settings.textures);
+	for (DWord i = 0; i < settings.textures; i++)
+	{
+		MetalBenchTexture& Texture = scene.textures[i];
+		Texture.file.width	= settings.texturesize;
+		Texture.file.height	= settings.texturesize;
+		Texture.file.type	= TT_DIFFUSE;
+		Texture.file.format	= IF_RGBA8;
+		BuildMipChain(Texture.file);
+		Texture.seed	= BenchRandom(State);
+		Texture.handle	= scene.streamer.AddTexture(Texture.file, ReadBenchTexture, &Texture);
+	}
+
+	/* Materials, all parameters in one buffer*/
+	scene.materials.resize(settings.materials);
+	vector<vec4f> Colors(settings.materials);
+	for (DWord i = 0; i < settings.materials; i++)
+	{
+		MetalBenchMaterial& Material = scene.materials[i];
+		Material.color		= vec4f(BenchRandomFloat(State, 0.25f, 1.0f), BenchRandomFloat(State, 0.25f, 1.0f), BenchRandomFloat(State, 0.25f, 1.0f), 1.0f);
+		Material.texture0	= static_cast<DWord>(BenchRandom(State) % settings.textures);
+		Material.texture1	= static_cast<DWord>(BenchRandom(State) % settings.textures);
+		Colors[i] = Material.color;
+	}
+
+	CreateBuffer(sizeof(vec4f) * settings.materials, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, scene.materialbuffer, scene.materialmemory);
+	UploadToBuffer(scene.materialbuffer, 0, Colors.data(), sizeof(vec4f) * settings.materials);
+	scene.materialslot = BindlessRegisterBuffer(scene.materialbuffer);
+
+	/* Objects, sorted by material so a push happens only when the material changes*/
+	float Spread = 2.0f * std::cbrt(static_cast<float>(settings.objects));
+	vector<pair<DWord, MetalGpuInstance>> Objects(settings.objects);
+	for (DWord i = 0; i < settings.objects; i++)
+	{
+		trans3f Transform;
+		Transform.location	= vec3f(BenchRandomFloat(State, -Spread, Spread), BenchRandomFloat(State, -Spread, Spread), BenchRandomFloat(State, -Spread, Spread));
+		Transform.rotation	= rot3f(BenchRandomFloat(State, 0.0f, 360.0f), BenchRandomFloat(State, 0.0f, 360.0f), BenchRandomFloat(State, 0.0f, 360.0f));
+		float Scale			= BenchRandomFloat(State, 0.5f, 1.5f);
+		Transform.scale		= vec3f(Scale, Scale, Scale);
+
+		mat4f Model = MakeTransformMatrix(Transform);
+		MetalGpuInstance& Instance = Objects[i].second;
+		for (int r = 0; r < 4; r++)
+		{
+			Instance.modelrows[r] = Model.rows[r];
+		}
+		Instance.boundingsphere	= vec4f(0.0f, 0.0f, 0.0f, 1.7320508f);
+		Instance.mesh			= 0;
+		Objects[i].first = static_cast<DWord>(BenchRandom(State) % settings.materials);
+	}
+
+	stable_sort(Objects.begin(), Objects.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+	vector<MetalGpuInstance> Instances(settings.objects);
+	scene.objectmaterials.resize(settings.objects);
+	scene.objectmodels.resize(settings.objects);
+	for (DWord i = 0; i < settings.objects; i++)
+	{
+		scene.objectmaterials[i] = Objects[i].first;
+		Instances[i] = Objects[i].second;
+		for (int r = 0; r < 4; r++)
+		{
+			scene.objectmodels[i].rows[r] = Instances[i].modelrows[r];
+		}
+	}
+
+	CreateBuffer(sizeof(MetalGpuInstance) * settings.objects, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, scene.instancebuffer, scene.instancememory);
+	UploadToBuffer(scene.instancebuffer, 0, Instances.data(), sizeof(MetalGpuInstance) * settings.objects);
+
+	/* One cube for every object*/
+	const float Vertices[] = { -1, -1, -1,	1, -1, -1,	1, 1, -1,	-1, 1, -1,	-1, -1, 1,	1, -1, 1,	1, 1, 1,	-1, 1, 1 };
+	const Word Indices[] = { 0, 1, 2, 2, 3, 0,	5, 4, 7, 7, 6, 5,	4, 0, 3, 3, 7, 4,	1, 5, 6, 6, 2, 1,	3, 2, 6, 6, 7, 3,	4, 5, 1, 1, 0, 4 };
+
+	CreateBuffer(sizeof(Vertices), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, scene.vertexbuffer, scene.vertexmemory);
+	UploadToBuffer(scene.vertexbuffer, 0, Vertices, sizeof(Vertices));
+
+	CreateBuffer(sizeof(Indices), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, scene.indexbuffer, scene.indexmemory);
+	UploadToBuffer(scene.indexbuffer, 0, Indices, sizeof(Indices));
+
+	if (settings.instanced && scene.batcher.Create(settings.objects, { MetalIndirectMesh{ 36, 0, 0, 0.0f } }) != 0)
+	{
+		return 1;
+	}
+
+	/* A fixed camera looking down +Z at the whole volume (Vulkan clip space, depth 0...1)*/
+	float Aspect	= static_cast<float>(settings.width) / static_cast<float>(settings.height);
+	float Focal		= 1.0f / std::tan(0.5f * 1.0471976f);
+	float Distance	= Spread * 2.5f;
+	float Near		= 0.1f;
+	float Far		= Distance + Spread * 2.0f;
+	float DepthA	= Far / (Far - Near);
+	float DepthB	= -Far * Near / (Far - Near);
+
+	MetalBenchFrameData FrameData = {};
+	FrameData.viewprojrows[0]	= vec4f(Focal / Aspect, 0.0f, 0.0f, 0.0f);
+	FrameData.viewprojrows[1]	= vec4f(0.0f, Focal, 0.0f, 0.0f);
+	FrameData.viewprojrows[2]	= vec4f(0.0f, 0.0f, DepthA, DepthA * Distance + DepthB);
+	FrameData.viewprojrows[3]	= vec4f(0.0f, 0.0f, 1.0f, Distance);
+	FrameData.texgen[0]			= vec4f(0.5f, 0.0f, 0.0f, 0.5f);
+	FrameData.texgen[1]			= vec4f(0.0f, 0.5f, 0.0f, 0.5f);
+	FrameData.texgen[2]			= vec4f(0.0f, 0.0f, 1.0f, 0.0f);
+	FrameData.texgen[3]			= vec4f(1.0f, 0.0f, 0.0f, 0.0f);
+
+	CreateBuffer(sizeof(FrameData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, scene.framebuffer, scene.framememory);
+	UploadToBuffer(scene.framebuffer, 0, &FrameData, sizeof(FrameData));
+
+	/* Set 0 of fog_indirect.vert: instances at 0, UMO at 4*/
+	array<VkDescriptorSetLayoutBinding, 2> Bindings = {};
+	Bindings[0].binding			= 0;
+	Bindings[0].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	Bindings[0].descriptorCount	= 1;
+	Bindings[0].stageFlags		= VK_SHADER_STAGE_VERTEX_BIT;
+	Bindings[1].binding			= 4;
+	Bindings[1].descriptorType	= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	Bindings[1].descriptorCount	= 1;
+	Bindings[1].stageFlags		= VK_SHADER_STAGE_VERTEX_BIT;
+
+	VkDescriptorSetLayoutCreateInfo LayoutInfo = {};
+	LayoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	LayoutInfo.bindingCount	= static_cast<VkUint32>(Bindings.size());
+	LayoutInfo.pBindings	= Bindings.data();
+	VK_CHECK(vkCreateDescriptorSetLayout(m_device, &LayoutInfo, nullptr, &scene.framesetlayout));
+
+	array<VkDescriptorPoolSize, 2> PoolSizes = {};
+	PoolSizes[0] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 };
+	PoolSizes[1] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 };
+
+	VkDescriptorPoolCreateInfo PoolInfo = {};
+	PoolInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	PoolInfo.maxSets		= 1;
+	PoolInfo.poolSizeCount	= static_cast<VkUint32>(PoolSizes.size());
+	PoolInfo.pPoolSizes		= PoolSizes.data();
+	VK_CHECK(vkCreateDescriptorPool(m_device, &PoolInfo, nullptr, &scene.framepool));
+
+	VkDescriptorSetAllocateInfo AllocationInfo = {};
+	AllocationInfo.sType				= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	AllocationInfo.descriptorPool		= scene.framepool;
+	AllocationInfo.descriptorSetCount	= 1;
+	AllocationInfo.pSetLayouts			= &scene.framesetlayout;
+	VK_CHECK(vkAllocateDescriptorSets(m_device, &AllocationInfo, &scene.frameset));
+
+	VkDescriptorBufferInfo BufferInfos[2] = {};
+	BufferInfos[0] = { scene.instancebuffer, 0, VK_WHOLE_SIZE };
+	BufferInfos[1] = { scene.framebuffer, 0, VK_WHOLE_SIZE };
+
+	array<VkWriteDescriptorSet, 2> Writes = {};
+	for (int i = 0; i < 2; i++)
+	{
+		Writes[i].sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		Writes[i].dstSet			= scene.frameset;
+		Writes[i].dstBinding		= Bindings[i].binding;
+		Writes[i].descriptorCount	= 1;
+		Writes[i].descriptorType	= Bindings[i].descriptorType;
+		Writes[i].pBufferInfo		= &BufferInfos[i];
+	}
+	vkUpdateDescriptorSets(m_device, static_cast<VkUint32>(Writes.size()), Writes.data(), 0, nullptr);
+	MetalCounterAdd(METAL_COUNTER_DESCRIPTOR_WRITES, static_cast<long long>(Writes.size()));
+
+	CreateBindlessPipelineLayout(scene.framesetlayout, scene.pipelinelayout);
+	if (CreateBenchPipeline(scene, settings, renderpass) != 0)
+	{
+		return 1;
+	}
+
+	/* GPU time of every frame, a begin/end pair per frame in flight*/
+	VkQueryPoolCreateInfo QueryInfo = {};
+	QueryInfo.sType			= VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	QueryInfo.queryType		= VK_QUERY_TYPE_TIMESTAMP;
+	QueryInfo.queryCount	= 2 * MAXIMUM_FRAMES_IN_FLIGHTS;
+	VK_CHECK(vkCreateQueryPool(m_device, &QueryInfo, nullptr, &scene.querypool));
+
+	return 0;
+}
+
+static void DestroyBenchScene(MetalBenchScene& scene)
+{
+	vkDeviceWaitIdle(m_device);
+
+	scene.streamer.Destroy();
+	scene.batcher.Destroy();
+	if (scene.materialslot != BINDLESS_INVALID)
+	{
+		BindlessReleaseBuffer(scene.materialslot);
+	}
+
+	vkDestroyQueryPool(m_device, scene.querypool, nullptr);
+	vkDestroyPipeline(m_device, scene.pipeline, nullptr);
+	vkDestroyPipelineLayout(m_device, scene.pipelinelayout, nullptr);
+	vkDestroyDescriptorPool(m_device, scene.framepool, nullptr);
+	vkDestroyDescriptorSetLayout(m_device, scene.framesetlayout, nullptr);
+
+	VkBuffer Buffers[] = { scene.vertexbuffer, scene.indexbuffer, scene.instancebuffer, scene.materialbuffer, scene.framebuffer };
+	VkDeviceMemory Memories[] = { scene.vertexmemory, scene.indexmemory, scene.instancememory, scene.materialmemory, scene.framememory };
+	for (int i = 0; i < 5; i++)
+	{
+		vkDestroyBuffer(m_device, Buffers[i], nullptr);
+		vkFreeMemory(m_device, Memories[i], nullptr);
+	}
+}
+
+/* Texture slots move with residency, so the push data is rebuilt every frame*/
+static void PushBenchMaterial(MetalBenchScene& scene, VkCommandBuffer commandbuffer, DWord material)
+{
+	const MetalBenchMaterial& Material = scene.materials[material];
+
+	MetalBindlessMaterial Push;
+	Push.texture0	= scene.streamer.GetBindlessSlot(scene.textures[Material.texture0].handle);
+	Push.texture1	= scene.streamer.GetBindlessSlot(scene.textures[Material.texture1].handle);
+	Push.buffer		= scene.materialslot;
+	Push.material	= material;
+	BindlessPushMaterial(commandbuffer, scene.pipelinelayout, Push);
+}
+
+static void BindBenchBatch(VkCommandBuffer commandbuffer, QWord key, QWord, void* userdata)
+{
+	PushBenchMaterial(*static_cast<MetalBenchScene*>(userdata), commandbuffer, InstanceKeyMaterial(key));
+}
+
+static void RecordBenchScene(MetalBenchScene& scene, VkCommandBuffer commandbuffer, bool instanced)
+{
+	METAL_ZONE("Bench Record");
+
+	vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, scene.pipeline);
+	MetalCounterAdd(METAL_COUNTER_PIPELINE_BINDS, 1);
+
+	vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, scene.pipelinelayout, 0, 1, &scene.frameset, 0, nullptr);
+	BindlessBind(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, scene.pipelinelayout);
+
+	VkDeviceSize Offset = 0;
+	vkCmdBindVertexBuffers(commandbuffer, 0, 1, &scene.vertexbuffer, &Offset);
+	vkCmdBindIndexBuffer(commandbuffer, scene.indexbuffer, 0, VK_INDEX_TYPE_UINT16);
+
+	DWord Count = static_cast<DWord>(scene.objectmaterials.size());
+	if (instanced)
+	{
+		/* Resubmitted every frame like a scene that moves would be, the batcher sorts it into one draw per material*/
+		scene.batcher.Begin();
+		for (DWord i = 0; i < Count; i++)
+		{
+			scene.batcher.Submit(MakeInstanceKey(0, scene.objectmaterials[i], 0), scene.objectmodels[i]);
+		}
+		scene.batcher.Build();
+		scene.batcher.Record(commandbuffer, 1, BindBenchBatch, &scene);
+		return;
+	}
+
+	DWord Current = BINDLESS_INVALID;
+	for (DWord i = 0; i < Count; i++)
+	{
+		if (scene.objectmaterials[i] != Current)
+		{
+			Current = scene.objectmaterials[i];
+			PushBenchMaterial(scene, commandbuffer, Current);
+		}
+
+		/* gl_InstanceIndex starts at firstInstance, that picks the object's instance*/
+		vkCmdDrawIndexed(commandbuffer, 36, 1, 0, 0, i);
+	}
+	MetalCounterAdd(METAL_COUNTER_DRAW_CALLS, Count);
+}
+
+static bool IsSceneResident(const MetalBenchScene& scene)
+{
+	for (const MetalBenchTexture& Texture : scene.textures)
+	{
+		if (scene.streamer.GetResidentMip(Texture.handle) != 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Pulls "key": number pairs out of one flat object of the results file, enough for what WriteResults writes*/
+static void ReadJsonObject(const string& text, const char* object, map<string, double>& values)
+{
+	usize Start = text.find(string("\"") + object + "\"");
+	if (Start == string::npos || (Start = text.find('{', Start)) == string::npos)
+	{
+		return;
+	}
+
+	usize End = text.find('}', Start);
+	usize Position = Start;
+	while (true)
+	{
+		usize KeyStart = text.find('"', Position + 1);
+		if (KeyStart == string::npos || KeyStart > End)
+		{
+			break;
+		}
+
+		usize KeyEnd = text.find('"', KeyStart + 1);
+		usize Colon = text.find(':', KeyEnd);
+		if (KeyEnd == string::npos || Colon == string::npos || Colon > End)
+		{
+			break;
+		}
+
+		values[text.substr(KeyStart + 1, KeyEnd - KeyStart - 1)] = strtod(text.c_str() + Colon + 1, nullptr);
+		Position = text.find(',', Colon);
+		if (Position == string::npos || Position > End)
+		{
+			break;
+		}
+	}
+}
+
+static int WriteResults(const MetalBenchSettings& settings, const vector<pair<string, double>>& metrics)
+{
+	FILE* File = fopen(settings.output.c_str(), "w");
+	if (File == nullptr)
+	{
+		WarningMessage("Render Bench WARNING", "Failed to open %s", settings.output.c_str());
+		return 1;
+	}
+
+	string Device = m_properties.deviceName;
+	replace(Device.begin(), Device.end(), '"', '\'');
+
+	fprintf(File, "{\n\t\"scene\": {\n");
+	fprintf(File, "\t\t\"objects\": %u,\n\t\t\"materials\": %u,\n\t\t\"textures\": %u,\n\t\t\"texture_size\": %u,\n",
+		settings.objects, settings.materials, settings.textures, settings.texturesize);
+	fprintf(File, "\t\t\"frames\": %u,\n\t\t\"seed\": %llu,\n\t\t\"width\": %u,\n\t\t\"height\": %u,\n\t\t\"instanced\": %d\n\t},\n",
+		settings.frames, settings.seed, settings.width, settings.height, settings.instanced ? 1 : 0);
+	fprintf(File, "\t\"device\": \"%s\",\n\t\"metrics\": {\n", Device.c_str());
+	for (usize i = 0; i < metrics.size(); i++)
+	{
+		fprintf(File, "\t\t\"%s\": %.4f%s\n", metrics[i].first.c_str(), metrics[i].second, i + 1 < metrics.size() ? "," : "");
+	}
+	fprintf(File, "\t}\n}\n");
+
+	bool Failed = ferror(File) != 0;
+	fclose(File);
+	return Failed ? 1 : 0;
+}
+
+/* Every metric is lower-is-better, returns the number that grew past the threshold or -1 if the baseline doesn't fit*/
+static int CompareBaseline(const MetalBenchSettings& settings, const vector<pair<string, double>>& metrics)
+{
+	ifstream File(settings.baseline);
+	if (!File.is_open())
+	{
+		WarningMessage("Render Bench WARNING", "Failed to open the baseline %s", settings.baseline.c_str());
+		return -1;
+	}
+
+	string Text((std::istreambuf_iterator<char>(File)), std::istreambuf_iterator<char>());
+
+	/* Numbers from another workload say nothing about this one*/
+	map<string, double> Scene;
+	ReadJsonObject(Text, "scene", Scene);
+	if (Scene["objects"] != settings.objects || Scene["materials"] != settings.materials || Scene["textures"] != settings.textures
+		|| Scene["texture_size"] != settings.texturesize || Scene["frames"] != settings.frames || Scene["width"] != settings.width
+		|| Scene["height"] != settings.height || Scene["seed"] != static_cast<double>(settings.seed)
+		|| Scene["instanced"] != (settings.instanced ? 1.0 : 0.0))
+	{
+		WarningMessage("Render Bench WARNING", "The baseline %s was recorded with a different scene", settings.baseline.c_str());
+		return -1;
+	}
+
+	map<string, double> Baseline;
+	ReadJsonObject(Text, "metrics", Baseline);
+
+	int Regressions = 0;
+	for (const auto& [Name, Value] : metrics)
+	{
+		auto Found = Baseline.find(Name);
+		if (Found == Baseline.end() || Found->second <= 0.0)
+		{
+			fmt::print("ENGINE: {:<24} {:>12.4f}  (not in baseline)\n", Name, Value);
+			continue;
+		}
+
+		double Change = (Value - Found->second) / Found->second * 100.0;
+		bool Regressed = Change > settings.threshold;
+		Regressions += Regressed ? 1 : 0;
+		fmt::print("ENGINE: {:<24} {:>12.4f}  baseline {:>12.4f}  {:+7.1f}%{}\n", Name, Value, Found->second, Change, Regressed ? "  REGRESSED" : "");
+	}
+
+	return Regressions;
+}
+
+static bool ParseArguments(int argc, char* argv[], MetalBenchSettings& settings)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (i + 1 >= argc)
+		{
+			WarningMessage("Render Bench WARNING", "%s needs a value", argv[i]);
+			return false;
+		}
+
+		const char* Name = argv[i];
+		const char* Value = argv[++i];
+		if (strcmp(Name, "--objects") == 0)				settings.objects = static_cast<DWord>(strtoul(Value, nullptr, 10));
+		else if (strcmp(Name, "--materials") == 0)		settings.materials = static_cast<DWord>(strtoul(Value, nullptr, 10));
+		else if (strcmp(Name, "--textures") == 0)		settings.textures = static_cast<DWord>(strtoul(Value, nullptr, 10));
+		else if (strcmp(Name, "--texture-size") == 0)	settings.texturesize = static_cast<DWord>(strtoul(Value, nullptr, 10));
+		else if (strcmp(Name, "--frames") == 0)			settings.frames = static_cast<DWord>(strtoul(Value, nullptr, 10));
+		else if (strcmp(Name, "--warmup") == 0)			settings.warmup = static_cast<DWord>(strtoul(Value, nullptr, 10));
+		else if (strcmp(Name, "--seed") == 0)			settings.seed = strtoull(Value, nullptr, 10);
+		else if (strcmp(Name, "--width") == 0)			settings.width = static_cast<VkUint32>(strtoul(Value, nullptr, 10));
+		else if (strcmp(Name, "--height") == 0)			settings.height = static_cast<VkUint32>(strtoul(Value, nullptr, 10));
+		else if (strcmp(Name, "--instanced") == 0)		settings.instanced = strtoul(Value, nullptr, 10) != 0;
+		else if (strcmp(Name, "--shaders") == 0)		settings.shaders = Value;
+		else if (strcmp(Name, "--output") == 0)			settings.output = Value;
+		else if (strcmp(Name, "--baseline") == 0)		settings.baseline = Value;
+		else if (strcmp(Name, "--threshold") == 0)		settings.threshold = strtod(Value, nullptr);
+		else
+		{
+			WarningMessage("Render Bench WARNING", "Unknown argument %s", Name);
+			return false;
+		}
+	}
+
+	if (settings.objects == 0 || settings.materials == 0 || settings.textures == 0 || settings.texturesize == 0
+		|| settings.frames == 0 || settings.width == 0 || settings.height == 0)
+	{
+		WarningMessage("Render Bench WARNING", "Objects, materials, textures, sizes and frames have to be at least 1");
+		return false;
+	}
+
+	return true;
+}
+
+static int RunBench(const MetalBenchSettings& settings)
+{
+	MetalOffscreenTarget* Target = new MetalOffscreenTarget();
+	MetalBenchScene* Scene = new MetalBenchScene();
+
+	int Result = 2;
+	if (Target->Create(settings.width, settings.height) == 0 && CreateBenchScene(*Scene, settings, Target->GetRenderPass()) == 0)
+	{
+		const float ClearColor[4] = { 0.05f, 0.05f, 0.08f, 1.0f };
+
+		/* Let every texture stream in fully first, the measured frames shouldn't see residency changes*/
+		for (DWord i = 0; i < 10000 && !IsSceneResident(*Scene); i++)
+		{
+			VkCommandBuffer CommandBuffer = Target->BeginFrame();
+			BindlessNextFrame();
+			for (const MetalBenchTexture& Texture : Scene->textures)
+			{
+				Scene->streamer.ReportScreenSize(Texture.handle, static_cast<float>(settings.texturesize));
+			}
+			Scene->streamer.Update(CommandBuffer);
+			Target->BeginRenderPass(ClearColor);
+			Target->EndFrame();
+		}
+
+		if (!IsSceneResident(*Scene))
+		{
+			WarningMessage("Render Bench WARNING", "The textures never became resident, is the budget too small?");
+		}
+		else
+		{
+			double TimestampPeriod = static_cast<double>(m_properties.limits.timestampPeriod) * 1e-6;
+			bool Timestamps = m_properties.limits.timestampComputeAndGraphics == VK_TRUE && TimestampPeriod > 0.0;
+			array<QWord, MAXIMUM_FRAMES_IN_FLIGHTS> SlotFrames;
+			SlotFrames.fill(~0ull);
+
+			vector<double> FrameTimes, CpuTimes, GpuTimes;
+			double Draws = 0.0;
+			DWord Total = settings.warmup + settings.frames;
+
+			auto ReadGpuTime = [&](VkUsize slot)
+			{
+				if (!Timestamps || SlotFrames[slot] == ~0ull || SlotFrames[slot] < settings.warmup)
+				{
+					return;
+				}
+
+				QWord Stamps[2] = {};
+				if (vkGetQueryPoolResults(m_device, Scene->querypool, static_cast<VkUint32>(slot * 2), 2, sizeof(Stamps), Stamps,
+					sizeof(QWord), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) == VK_SUCCESS)
+				{
+					GpuTimes.push_back(static_cast<double>(Stamps[1] - Stamps[0]) * TimestampPeriod);
+				}
+				SlotFrames[slot] = ~0ull;
+			};
+
+			for (DWord Frame = 0; Frame < Total; Frame++)
+			{
+				METAL_FRAME_MARK();
+				auto FrameStart = std::chrono::steady_clock::now();
+
+				VkUsize Slot = CurrentFrame;
+				VkCommandBuffer CommandBuffer = Target->BeginFrame();
+				auto RecordStart = std::chrono::steady_clock::now();
+
+				/* The slot's previous frame is done, its timestamps are in*/
+				ReadGpuTime(Slot);
+				BindlessNextFrame();
+
+				vkCmdResetQueryPool(CommandBuffer, Scene->querypool, static_cast<VkUint32>(Slot * 2), 2);
+				vkCmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, Scene->querypool, static_cast<VkUint32>(Slot * 2));
+
+				for (const MetalBenchTexture& Texture : Scene->textures)
+				{
+					Scene->streamer.ReportScreenSize(Texture.handle, static_cast<float>(settings.texturesize));
+				}
+				Scene->streamer.Update(CommandBuffer);
+
+				Target->BeginRenderPass(ClearColor);
+				RecordBenchScene(*Scene, CommandBuffer, settings.instanced);
+				vkCmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, Scene->querypool, static_cast<VkUint32>(Slot * 2 + 1));
+				Target->EndFrame();
+				SlotFrames[Slot] = Frame;
+
+				auto FrameEnd = std::chrono::steady_clock::now();
+				MetalCountersEndFrame();
+
+				if (Frame >= settings.warmup)
+				{
+					FrameTimes.push_back(Milliseconds(FrameEnd - FrameStart));
+					CpuTimes.push_back(Milliseconds(FrameEnd - RecordStart));
+					Draws += static_cast<double>(MetalCounterValue(METAL_COUNTER_DRAW_CALLS));
+				}
+			}
+
+			vkDeviceWaitIdle(m_device);
+			for (VkUsize Slot = 0; Slot < MAXIMUM_FRAMES_IN_FLIGHTS; Slot++)
+			{
+				ReadGpuTime(Slot);
+			}
+
+			vector<pair<string, double>> Metrics;
+			Metrics.push_back({ "frame_p50_ms", Percentile(FrameTimes, 50.0) });
+			Metrics.push_back({ "frame_p95_ms", Percentile(FrameTimes, 95.0) });
+			Metrics.push_back({ "frame_p99_ms", Percentile(FrameTimes, 99.0) });
+			Metrics.push_back({ "cpu_p50_ms", Percentile(CpuTimes, 50.0) });
+			Metrics.push_back({ "cpu_p95_ms", Percentile(CpuTimes, 95.0) });
+			if (!GpuTimes.empty())
+			{
+				Metrics.push_back({ "gpu_p50_ms", Percentile(GpuTimes, 50.0) });
+				Metrics.push_back({ "gpu_p95_ms", Percentile(GpuTimes, 95.0) });
+			}
+			Metrics.push_back({ "pipeline_creation_ms", Scene->pipelinems });
+			Metrics.push_back({ "device_memory_mb", static_cast<double>(MetalCounterValue(METAL_COUNTER_DEVICE_BYTES)) / (1024.0 * 1024.0) });
+			if (m_memorybudget_supported)
+			{
+				Metrics.push_back({ "heap_usage_mb", static_cast<double>(MetalCounterValue(METAL_COUNTER_HEAP_USAGE)) / (1024.0 * 1024.0) });
+			}
+			Metrics.push_back({ "draw_calls", Draws / static_cast<double>(settings.frames) });
+
+			fmt::print("ENGINE: Render bench on {}, {} objects, {} materials, {} textures, {} frames\n",
+				m_properties.deviceName, settings.objects, settings.materials, settings.textures, settings.frames);
+
+			Result = WriteResults(settings, Metrics) == 0 ? 0 : 2;
+			if (Result == 0 && !settings.baseline.empty())
+			{
+				int Regressions = CompareBaseline(settings, Metrics);
+				Result = Regressions < 0 ? 2 : (Regressions > 0 ? 1 : 0);
+				fmt::print("ENGINE: {}\n", Regressions == 0 ? "No regressions" : (Regressions > 0 ? "Regressed past the threshold" : "Baseline unusable"));
+			}
+			else
+			{
+				for (const auto& [Name, Value] : Metrics)
+				{
+					fmt::print("ENGINE: {:<24} {:>12.4f}\n", Name, Value);
+				}
+			}
+		}
+	}
+
+	DestroyBenchScene(*Scene);
+	delete Scene;
+	delete Target;
+	return Result;
+}
+
+int main(int argc, char* argv[])
+{
+	MetalLogInit();
+
+#if defined(METAL_PROFILE)
+	engine::profiler::ProfilerInit();
+#endif
+
+	MetalBenchSettings settings;
+	if (!ParseArguments(argc, argv, settings))
+	{
+		MetalLogShutdown();
+		return 2;
+	}
+
+	int result = 2;
+	if (JobSystemInit() == 0)
+	{
+		if (VulkanSetupHeadless() == 0)
+		{
+			if (VulkanCreateBindlessHeap() == 0)
+			{
+				result = RunBench(settings);
+				VulkanDestroyBindlessHeap();
+			}
+			VulkanShutdownHeadless();
+		}
+		JobSystemShutdown();
+	}
+
+#if defined(METAL_PROFILE)
+	engine::profiler::ProfilerShutdown();
+#endif
+
+	MetalLogShutdown();
+	return result;
+}
@@ -1,4 +1,24 @@
 C:\VulkanSDK\1.4.321.1\Bin\glslc shaders\vulkan\simpleshader.vert -o shaders\vulkan\simpleshader.vert.spv 
 C:\VulkanSDK\1.4.321.1\Bin\glslc shaders\vulkan\simpleshader.frag -o shaders\vulkan\simpleshader.frag.spv 
+C:\VulkanSDK\1.4.321.1\Bin\glslc shaders\vulkan\cull.comp -o shaders\vulkan\cull.comp.spv 
+C:\VulkanSDK\1.4.321.1\Bin\glslc shaders\vulkan\fog_indirect.vert -o shaders\vulkan\fog_indirect.vert.spv 
+C:\VulkanSDK\1.4.321.1\Bin\glslc shaders\vulkan\fog_bindless.frag -o shaders\vulkan\fog_bindless.frag.spv 
+C:\VulkanSDK\1.4.321.1\Bin\glslc shaders\vulkan\material.frag -o shaders\vulkan\material.frag.spv 
+C:\VulkanSDK\1.4.321.1\Bin\glslc -DMETAL_ORM_PACKED shaders\vulkan\material.frag -o shaders\vulkan\material_orm.frag.spv 
+C:\VulkanSDK\1.4.321.1\Bin\glslc shaders\vulkan\virtualtexture.frag -o shaders\vulkan\virtualtexture.frag.spv 
+C:\VulkanSDK\1.4.321.1\Bin\glslc shaders\vulkan\vt_feedback.frag -o shaders\vulkan\vt_feedback.frag.spv 
+C:\VulkanSDK\1.4.321.1\Bin\glslc shaders\vulkan\mesh.vert -o shaders\vulkan\mesh.vert.spv 
+C:\VulkanSDK\1.4.321.1\Bin\glslc shaders\vulkan\depthpyramid.comp -o shaders\vulkan\depthpyramid.comp.spv 
+C:\VulkanSDK\1.4.321.1\Bin\glslc shaders\vulkan\meshlet_cull.comp -o shaders\vulkan\meshlet_cull.comp.spv 
+C:\VulkanSDK\1.4.321.1\Bin\glslc shaders\vulkan\fog_instanced.vert -o shaders\vulkan\fog_instanced.vert.spv 
+C:\VulkanSDK\1.4.321.1\Bin\glslc shaders\vulkan\cluster_lights.comp -o shaders\vulkan\cluster_lights.comp.spv 
+C:\VulkanSDK\1.4.321.1\Bin\glslc shaders\vulkan\particle_emit.comp -o shaders\vulkan\particle_emit.comp.spv 
+C:\VulkanSDK\1.4.321.1\Bin\glslc shaders\vulkan\particle_simulate.comp -o shaders\vulkan\particle_simulate.comp.spv 
+C:\VulkanSDK\1.4.321.1\Bin\glslc shaders\vulkan\particle_sort.comp -o shaders\vulkan\particle_sort.comp.spv 
+C:\VulkanSDK\1.4.321.1\Bin\glslc shaders\vulkan\particle.vert -o shaders\vulkan\particle.vert.spv 
+C:\VulkanSDK\1.4.321.1\Bin\glslc shaders\vulkan\particle.frag -o shaders\vulkan\particle.frag.spv 
+C:\VulkanSDK\1.4.321.1\Bin\glslc shaders\vulkan\bloom_downsample.comp -o shaders\vulkan\bloom_downsample.comp.spv 
+C:\VulkanSDK\1.4.321.1\Bin\glslc shaders\vulkan\bloom_upsample.comp -o shaders\vulkan\bloom_upsample.comp.spv 
+C:\VulkanSDK\1.4.321.1\Bin\glslc shaders\vulkan\tonemap.comp -o shaders\vulkan\tonemap.comp.spv 
 
 pause
\ No newline at end of file
@@ -27,5 +27,5 @@ layout(location = 0) out vec4 vColor;
 
 void main()
 {
-    vColor = texture(uSample0, uTexCoord0.xy) * texture(uSample1, uTexCoord1x.y) * uColor;
+    vColor = texture(uSample0, uTexCoord0.xy) * texture(uSample1, uTexCoord1.xy) * uColor;
 }
\ No newline at end of file
@@ -0,0 +1,46 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+// 
+//	Description:
+//		Fog shader (fragment version, bindless materials)
+// ------------------------------------------------------
+
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+#pragma shader_stage( fragment )
+
+/*Set 1 is the global heap, see MVulkanBindless.hpp*/
+layout(set = 1, binding = 0) uniform sampler2D uTextures[];
+
+struct MetalFogMaterial
+{
+    vec4 uColor;
+};
+
+layout(std430, set = 1, binding = 1) readonly buffer MetalMaterialBuffer
+{
+    MetalFogMaterial uMaterials[];
+} uBuffers[];
+
+/*Mirrors MetalBindlessMaterial*/
+layout(push_constant) uniform MetalBindlessMaterial
+{
+    uint uTexture0;
+    uint uTexture1;
+    uint uBuffer;
+    uint uMaterial;
+};
+
+layout(location = 0) in vec2 uTexCoord0;
+layout(location = 1) in vec2 uTexCoord1;
+
+layout(location = 0) out vec4 vColor;
+
+void main()
+{
+    vec4 uColor = uBuffers[uBuffer].uMaterials[uMaterial].uColor;
+    vColor = texture(uTextures[uTexture0], uTexCoord0.xy) * texture(uTextures[uTexture1], uTexCoord1.xy) * uColor;
+}
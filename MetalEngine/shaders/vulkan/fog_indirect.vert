@@ -0,0 +1,71 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+// 
+//	Description:
+//		Fog shader (vertex version for GPU-driven indirect draws)
+//		The model matrix comes from the instance buffer written once at load
+// ------------------------------------------------------
+
+#version 450
+#pragma shader_stage( vertex )
+
+struct MetalInstance
+{
+	vec4 uModelMatrixX;
+	vec4 uModelMatrixY;
+	vec4 uModelMatrixZ;
+	vec4 uModelMatrixW;
+	vec4 uBoundingSphere;
+	uint uMesh;
+	uint uLodCount;
+	uint uPad1;
+	uint uPad2;
+};
+
+layout(std430, binding = 0) readonly buffer Instances
+{
+	MetalInstance uInstances[];
+};
+
+layout(binding = 4) uniform UMO
+{
+	vec4 uViewProjMatrixX;
+	vec4 uViewProjMatrixY;
+	vec4 uViewProjMatrixZ;
+	vec4 uViewProjMatrixW;
+	vec4 uTexGen0X;
+	vec4 uTexGen0Y;
+	vec4 uTexGen1X;
+	vec4 uTexGen1Y;
+};
+
+layout(location = 0) in vec3 uPosition;
+
+layout(location = 0) out vec2 vTexCoord0;
+layout(location = 1) out vec2 vTexCoord1;
+
+void main()
+{
+	MetalInstance instance = uInstances[gl_InstanceIndex];
+
+	vec4 vPosition = vec4(uPosition, 1.0);
+	vec4 vWorld;
+	vWorld.x = dot(vPosition, instance.uModelMatrixX);
+	vWorld.y = dot(vPosition, instance.uModelMatrixY);
+	vWorld.z = dot(vPosition, instance.uModelMatrixZ);
+	vWorld.w = dot(vPosition, instance.uModelMatrixW);
+
+	gl_Position.x = dot(vWorld, uViewProjMatrixX);
+	gl_Position.y = dot(vWorld, uViewProjMatrixY);
+	gl_Position.z = dot(vWorld, uViewProjMatrixZ);
+	gl_Position.w = dot(vWorld, uViewProjMatrixW);
+
+	vTexCoord0.x = dot(vPosition, uTexGen0X);
+	vTexCoord0.y = dot(vPosition, uTexGen0Y);
+
+	vTexCoord1.x = dot(vPosition, uTexGen1X);
+	vTexCoord1.y = dot(vPosition, uTexGen1Y);
+}
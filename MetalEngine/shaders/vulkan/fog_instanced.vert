@@ -0,0 +1,56 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+// 
+//	Description:
+//		Fog shader (vertex version for hardware instancing)
+//		The model matrix comes in as per-instance attributes streamed from the instance ring
+// ------------------------------------------------------
+
+#version 450
+#pragma shader_stage( vertex )
+
+layout(binding = 4) uniform UMO
+{
+	vec4 uViewProjMatrixX;
+	vec4 uViewProjMatrixY;
+	vec4 uViewProjMatrixZ;
+	vec4 uViewProjMatrixW;
+	vec4 uTexGen0X;
+	vec4 uTexGen0Y;
+	vec4 uTexGen1X;
+	vec4 uTexGen1Y;
+};
+
+layout(location = 0) in vec3 uPosition;
+
+/* MetalPackedInstance, the fourth row of an affine model matrix is always (0, 0, 0, 1)*/
+layout(location = 1) in vec4 uModelMatrixX;
+layout(location = 2) in vec4 uModelMatrixY;
+layout(location = 3) in vec4 uModelMatrixZ;
+
+layout(location = 0) out vec2 vTexCoord0;
+layout(location = 1) out vec2 vTexCoord1;
+
+void main()
+{
+	vec4 vPosition = vec4(uPosition, 1.0);
+	vec4 vWorld;
+	vWorld.x = dot(vPosition, uModelMatrixX);
+	vWorld.y = dot(vPosition, uModelMatrixY);
+	vWorld.z = dot(vPosition, uModelMatrixZ);
+	vWorld.w = 1.0;
+
+	gl_Position.x = dot(vWorld, uViewProjMatrixX);
+	gl_Position.y = dot(vWorld, uViewProjMatrixY);
+	gl_Position.z = dot(vWorld, uViewProjMatrixZ);
+	gl_Position.w = dot(vWorld, uViewProjMatrixW);
+
+	vTexCoord0.x = dot(vPosition, uTexGen0X);
+	vTexCoord0.y = dot(vPosition, uTexGen0Y);
+
+	vTexCoord1.x = dot(vPosition, uTexGen1X);
+	vTexCoord1.y = dot(vPosition, uTexGen1Y);
+}
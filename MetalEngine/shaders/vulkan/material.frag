@@ -0,0 +1,197 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+// 
+//	Description:
+//		Material shader (fragment version, bindless materials)
+//		Compiled twice, with METAL_ORM_PACKED occlusion/roughness/metallic
+//		come from one fetch of the TT_ORM texture, without it from three maps
+//		Point lights come from the cluster grid cluster_lights.comp builds, see MVulkanClusteredLighting.hpp
+// ------------------------------------------------------
+
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+#pragma shader_stage( fragment )
+
+#define METAL_NO_TEXTURE 0xFFFFFFFFu
+#define METAL_CHANNEL_CONSTANT 0xFFu
+#define METAL_PI 3.14159265
+
+/*Has to match MClusteredLighting.hpp*/
+#define CLUSTER_GRID_X 16u
+#define CLUSTER_GRID_Y 9u
+#define CLUSTER_GRID_Z 24u
+
+/*Set 1 is the global heap, see MVulkanBindless.hpp*/
+layout(set = 1, binding = 0) uniform sampler2D uTextures[];
+
+/*Mirrors MetalGpuMaterial*/
+struct MetalMaterial
+{
+    vec4 uBaseColorFactor;
+    vec4 uORMConstants;
+    uint uBaseColorTexture;
+    uint uNormalTexture;
+    uint uORMTexture;
+    uint uORMChannels;
+    uint uOcclusionTexture;
+    uint uRoughnessTexture;
+    uint uMetallicTexture;
+    uint uPad;
+};
+
+layout(std430, set = 1, binding = 1) readonly buffer MetalMaterialBuffer
+{
+    MetalMaterial uMaterials[];
+} uBuffers[];
+
+/*Set 2 is the light grid, mirrors MetalClusterData*/
+layout(std140, set = 2, binding = 0) uniform MetalClusterData
+{
+    vec4 uViewMatrixX;
+    vec4 uViewMatrixY;
+    vec4 uViewMatrixZ;
+    vec4 uViewMatrixW;
+    vec4 uCamera;
+    float uProjX;
+    float uProjY;
+    float uNear;
+    float uFar;
+    float uSliceScale;
+    float uSliceBias;
+    float uInverseWidth;
+    float uInverseHeight;
+    uint uLightCount;
+    uint uIndexCapacity;
+    uint uPad1;
+    uint uPad2;
+};
+
+/*Mirrors MetalPointLight*/
+struct MetalLight
+{
+    vec4 uPositionRadius;
+    vec4 uColorIntensity;
+};
+
+layout(std430, set = 2, binding = 1) readonly buffer Lights
+{
+    MetalLight uLights[];
+};
+
+layout(std430, set = 2, binding = 2) readonly buffer Clusters
+{
+    uvec2 uClusters[];
+};
+
+layout(std430, set = 2, binding = 3) readonly buffer Indices
+{
+    uint uIndices[];
+};
+
+/*Mirrors MetalBindlessMaterial*/
+layout(push_constant) uniform MetalBindlessMaterial
+{
+    uint uTexture0;
+    uint uTexture1;
+    uint uBuffer;
+    uint uMaterial;
+};
+
+layout(location = 0) in vec2 uTexCoord0;
+layout(location = 1) in vec2 uTexCoord1;
+layout(location = 2) in vec3 uNormal;
+layout(location = 4) in vec3 uWorldPosition;
+
+layout(location = 0) out vec4 vColor;
+
+/*Picks the channel the material's channel map points at, or the constant*/
+float SelectChannel(vec4 texel, uint channels, uint shift, float constant)
+{
+    uint channel = (channels >> shift) & 0xFFu;
+    return channel == METAL_CHANNEL_CONSTANT ? constant : texel[channel];
+}
+
+float SampleOptional(uint texture, float constant)
+{
+    return texture == METAL_NO_TEXTURE ? constant : texture(uTextures[nonuniformEXT(texture)], uTexCoord0.xy).r;
+}
+
+/*The cluster this pixel is in, clip w is view depth so gl_FragCoord.w gives it back for free*/
+uvec2 FindCluster()
+{
+    float viewz = 1.0 / gl_FragCoord.w;
+    uint slice = uint(clamp(log2(viewz) * uSliceScale + uSliceBias, 0.0, float(CLUSTER_GRID_Z - 1u)));
+    uvec2 tile = min(uvec2(gl_FragCoord.xy * vec2(uInverseWidth, uInverseHeight) * vec2(CLUSTER_GRID_X, CLUSTER_GRID_Y)),
+        uvec2(CLUSTER_GRID_X - 1u, CLUSTER_GRID_Y - 1u));
+    return uClusters[tile.x + CLUSTER_GRID_X * (tile.y + CLUSTER_GRID_Y * slice)];
+}
+
+/*Lambert diffuse and GGX specular for every light of the pixel's cluster, lights fade to 0 at their radius*/
+vec3 ShadeLights(vec3 diffuse, vec3 f0, float roughness)
+{
+    vec3 vNormal = normalize(uNormal);
+    vec3 vView = normalize(uCamera.xyz - uWorldPosition);
+    float alpha = max(roughness * roughness, 0.002);
+    float alpha2 = alpha * alpha;
+
+    uvec2 range = FindCluster();
+    vec3 vLight = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++)
+    {
+        MetalLight light = uLights[uIndices[range.x + i]];
+        vec3 vToLight = light.uPositionRadius.xyz - uWorldPosition;
+        float distance2 = max(dot(vToLight, vToLight), 1e-4);
+        vec3 L = vToLight * inversesqrt(distance2);
+
+        float NdotL = max(dot(vNormal, L), 0.0);
+        if (NdotL <= 0.0)
+        {
+            continue;
+        }
+
+        /*Inverse square windowed so it reaches 0 exactly at the radius the light was clustered with*/
+        float ratio = distance2 / (light.uPositionRadius.w * light.uPositionRadius.w);
+        float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+        float attenuation = window * window / (distance2 + 1.0);
+
+        vec3 H = normalize(L + vView);
+        float NdotH = max(dot(vNormal, H), 0.0);
+        float denominator = NdotH * NdotH * (alpha2 - 1.0) + 1.0;
+        float D = alpha2 / (METAL_PI * denominator * denominator);
+        vec3 F = f0 + (1.0 - f0) * pow(1.0 - max(dot(H, vView), 0.0), 5.0);
+
+        vLight += (diffuse / METAL_PI + F * (D * 0.25)) * light.uColorIntensity.rgb * (light.uColorIntensity.w * attenuation * NdotL);
+    }
+    return vLight;
+}
+
+void main()
+{
+    MetalMaterial uMaterial = uBuffers[uBuffer].uMaterials[uMaterial];
+
+    vec4 vBaseColor = uMaterial.uBaseColorFactor;
+    if (uMaterial.uBaseColorTexture != METAL_NO_TEXTURE)
+    {
+        vBaseColor *= texture(uTextures[nonuniformEXT(uMaterial.uBaseColorTexture)], uTexCoord0.xy);
+    }
+
+#ifdef METAL_ORM_PACKED
+    vec4 vORM = uMaterial.uORMTexture != METAL_NO_TEXTURE ? texture(uTextures[nonuniformEXT(uMaterial.uORMTexture)], uTexCoord0.xy) : vec4(1.0);
+    float vOcclusion = SelectChannel(vORM, uMaterial.uORMChannels, 0, uMaterial.uORMConstants.x);
+    float vRoughness = SelectChannel(vORM, uMaterial.uORMChannels, 8, uMaterial.uORMConstants.y);
+    float vMetallic  = SelectChannel(vORM, uMaterial.uORMChannels, 16, uMaterial.uORMConstants.z);
+#else
+    float vOcclusion = SampleOptional(uMaterial.uOcclusionTexture, uMaterial.uORMConstants.x);
+    float vRoughness = SampleOptional(uMaterial.uRoughnessTexture, uMaterial.uORMConstants.y);
+    float vMetallic  = SampleOptional(uMaterial.uMetallicTexture, uMaterial.uORMConstants.z);
+#endif
+
+    /*Ambient, metals tint their reflection and rough surfaces reflect less, occlusion only darkens the ambient*/
+    vec3 vDiffuse = vBaseColor.rgb * (1.0 - vMetallic);
+    vec3 vF0 = mix(vec3(0.04), vBaseColor.rgb, vMetallic);
+    vec3 vAmbient = (vDiffuse + vF0 * (1.0 - vRoughness)) * vOcclusion;
+    vColor = vec4(vAmbient + ShadeLights(vDiffuse, vF0, vRoughness), vBaseColor.a);
+}
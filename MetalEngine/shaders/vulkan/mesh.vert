@@ -0,0 +1,89 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Cooked mesh shader (quantized vertex streams, see MMesh.hpp)
+//		The instance's model matrix already has the mesh's dequantize matrix folded in
+// ------------------------------------------------------
+
+#version 450
+#pragma shader_stage( vertex )
+
+struct MetalInstance
+{
+	vec4 uModelMatrixX;
+	vec4 uModelMatrixY;
+	vec4 uModelMatrixZ;
+	vec4 uModelMatrixW;
+	vec4 uBoundingSphere;
+	uint uMesh;
+	uint uLodCount;
+	uint uPad1;
+	uint uPad2;
+};
+
+layout(std430, binding = 0) readonly buffer Instances
+{
+	MetalInstance uInstances[];
+};
+
+layout(binding = 4) uniform UMO
+{
+	vec4 uViewProjMatrixX;
+	vec4 uViewProjMatrixY;
+	vec4 uViewProjMatrixZ;
+	vec4 uViewProjMatrixW;
+	vec4 uTexGen0X;
+	vec4 uTexGen0Y;
+	vec4 uTexGen1X;
+	vec4 uTexGen1Y;
+};
+
+layout(location = 0) in vec4 uPosition;		/* R16G16B16A16_UNORM, w is the bitangent sign*/
+layout(location = 1) in vec2 uNormal;		/* R16G16_SNORM, octahedral*/
+layout(location = 2) in vec2 uTangent;		/* R16G16_SNORM, octahedral*/
+layout(location = 3) in vec2 uUV;			/* R16G16_SFLOAT*/
+
+layout(location = 0) out vec2 vTexCoord0;
+layout(location = 1) out vec2 vTexCoord1;
+layout(location = 2) out vec3 vNormal;
+layout(location = 3) out vec4 vTangent;
+layout(location = 4) out vec3 vWorldPosition;
+
+vec3 OctahedralDecode(vec2 encoded)
+{
+	vec3 vector = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float fold = clamp(-vector.z, 0.0, 1.0);
+	vector.x += vector.x >= 0.0 ? -fold : fold;
+	vector.y += vector.y >= 0.0 ? -fold : fold;
+	return normalize(vector);
+}
+
+void main()
+{
+	MetalInstance instance = uInstances[gl_InstanceIndex];
+
+	vec4 vPosition = vec4(uPosition.xyz, 1.0);
+	vec4 vWorld;
+	vWorld.x = dot(vPosition, instance.uModelMatrixX);
+	vWorld.y = dot(vPosition, instance.uModelMatrixY);
+	vWorld.z = dot(vPosition, instance.uModelMatrixZ);
+	vWorld.w = dot(vPosition, instance.uModelMatrixW);
+
+	gl_Position.x = dot(vWorld, uViewProjMatrixX);
+	gl_Position.y = dot(vWorld, uViewProjMatrixY);
+	gl_Position.z = dot(vWorld, uViewProjMatrixZ);
+	gl_Position.w = dot(vWorld, uViewProjMatrixW);
+
+	/* The dequantize scale is uniform so the upper 3x3 only needs a normalize afterwards*/
+	mat3 vBasis = mat3(instance.uModelMatrixX.xyz, instance.uModelMatrixY.xyz, instance.uModelMatrixZ.xyz);
+	vNormal = normalize(OctahedralDecode(uNormal) * vBasis);
+	vTangent = vec4(normalize(OctahedralDecode(uTangent) * vBasis), uPosition.w * 2.0 - 1.0);
+	vWorldPosition = vWorld.xyz;
+
+	vTexCoord0 = uUV;
+	vTexCoord1 = uUV;
+}
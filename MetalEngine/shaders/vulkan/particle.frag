@@ -0,0 +1,33 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+// 
+//	Description:
+//		Particle shader (fragment version)
+//		fog.frag's texture modulate with the particle's color on top
+// ------------------------------------------------------
+
+#version 450
+#pragma shader_stage( fragment )
+
+/*uTint of MetalParticleData, the only part of it this stage reads*/
+layout(binding = 0) uniform UMO
+{
+    layout(offset = 208) vec4 uColor;
+};
+
+layout(binding = 2) uniform sampler2D uSample0;
+layout(binding = 3) uniform sampler2D uSample1;
+
+layout(location = 0) in vec2 uTexCoord0;
+layout(location = 1) in vec2 uTexCoord1;
+layout(location = 2) in vec4 uParticleColor;
+
+layout(location = 0) out vec4 vColor;
+
+void main()
+{
+    vColor = texture(uSample0, uTexCoord0.xy) * texture(uSample1, uTexCoord1.xy) * uColor * uParticleColor;
+}
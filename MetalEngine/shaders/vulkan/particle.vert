@@ -0,0 +1,97 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Particle shader (vertex version)
+//		Every instance is one alive particle, expanded into a camera facing quad from gl_VertexIndex
+// ------------------------------------------------------
+
+#version 450
+#pragma shader_stage( vertex )
+
+/* Mirrors MetalGpuParticle*/
+struct MetalParticle
+{
+	vec4 uPositionSize;
+	vec4 uVelocityAge;
+	vec4 uColor;
+	float uLifetime;
+	float uPad1;
+	float uPad2;
+	float uPad3;
+};
+
+struct MetalSortEntry
+{
+	float uKey;		/* Negative view depth, farthest first*/
+	uint uIndex;
+};
+
+/* Mirrors MetalParticleData*/
+layout(std140, binding = 0) uniform MetalParticleData
+{
+	vec4 uViewProjMatrixX;
+	vec4 uViewProjMatrixY;
+	vec4 uViewProjMatrixZ;
+	vec4 uViewProjMatrixW;
+	vec4 uCameraRight;
+	vec4 uCameraUp;
+	vec4 uCameraForward;	/* w = -dot(forward, camera position)*/
+	vec4 uEmitterPosition;	/* w = radius*/
+	vec4 uEmitterVelocity;	/* w = spread*/
+	vec4 uGravity;			/* w = drag*/
+	vec4 uStartColor;
+	vec4 uEndColor;
+	vec4 uTint;
+	float uDeltaTime;
+	float uLifetime;
+	float uLifetimeVariance;
+	float uStartSize;
+	float uEndSize;
+	uint uEmitCount;
+	uint uCapacity;
+	uint uSeed;
+	uint uSortCount;
+	uint uPad1;
+	uint uPad2;
+	uint uPad3;
+};
+
+layout(std430, binding = 4) readonly buffer Particles
+{
+	MetalParticle uParticles[];
+};
+
+layout(std430, binding = 5) readonly buffer Sorted
+{
+	MetalSortEntry uSorted[];
+};
+
+layout(location = 0) out vec2 vTexCoord0;
+layout(location = 1) out vec2 vTexCoord1;
+layout(location = 2) out vec4 vParticleColor;
+
+/* Two triangles, PARTICLE_QUAD_VERTICES*/
+const vec2 uCorners[6] = vec2[](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0));
+
+void main()
+{
+	uint index = uSortCount != 0u ? uSorted[gl_InstanceIndex].uIndex : uint(gl_InstanceIndex);
+	MetalParticle particle = uParticles[index];
+
+	vec2 corner = uCorners[gl_VertexIndex];
+	vec3 offset = (uCameraRight.xyz * corner.x + uCameraUp.xyz * corner.y) * (particle.uPositionSize.w * 0.5);
+	vec4 vPosition = vec4(particle.uPositionSize.xyz + offset, 1.0);
+
+	gl_Position.x = dot(vPosition, uViewProjMatrixX);
+	gl_Position.y = dot(vPosition, uViewProjMatrixY);
+	gl_Position.z = dot(vPosition, uViewProjMatrixZ);
+	gl_Position.w = dot(vPosition, uViewProjMatrixW);
+
+	vTexCoord0 = corner * 0.5 + 0.5;
+	vTexCoord1 = vTexCoord0;
+	vParticleColor = particle.uColor;
+}
@@ -0,0 +1,83 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+// 
+//	Description:
+//		Virtual texture shader (fragment version, bindless)
+//		Looks the page up in the page table and samples it out of the cache atlas
+// ------------------------------------------------------
+
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+#pragma shader_stage( fragment )
+
+/*Mirror VT_PAGE_SIZE/VT_PAGE_BORDER/VT_PAGE_TEXELS in MVirtualTexture.hpp*/
+#define VT_PAGE_SIZE 128.0
+#define VT_PAGE_BORDER 4.0
+#define VT_PAGE_TEXELS 136.0
+
+/*Set 1 is the global heap, see MVulkanBindless.hpp*/
+layout(set = 1, binding = 0) uniform sampler2D uTextures[];
+
+/*Mirrors MetalGpuVirtualTexture*/
+struct MetalVirtualTexture
+{
+    vec2 uSize;
+    uint uPageTable;
+    uint uLevelCount;
+};
+
+/*Mirrors MetalGpuVirtualHeader followed by the textures*/
+layout(std430, set = 1, binding = 1) readonly buffer MetalVirtualInfo
+{
+    uvec4 uAtlasAndFeedback;
+    vec4 uFeedbackBias;
+    MetalVirtualTexture uVirtualTextures[];
+} uBuffers[];
+
+/*Mirrors MetalBindlessMaterial, texture0 is the atlas, buffer the info buffer and material the virtual texture*/
+layout(push_constant) uniform MetalBindlessMaterial
+{
+    uint uTexture0;
+    uint uTexture1;
+    uint uBuffer;
+    uint uMaterial;
+};
+
+layout(location = 0) in vec2 uTexCoord0;
+layout(location = 1) in vec2 uTexCoord1;
+
+layout(location = 0) out vec4 vColor;
+
+void main()
+{
+    MetalVirtualTexture uTexture = uBuffers[uBuffer].uVirtualTextures[uMaterial];
+    vec2 uAtlasPages = vec2(uBuffers[uBuffer].uAtlasAndFeedback.xy);
+    vec2 uUV = clamp(uTexCoord0.xy, vec2(0.0), vec2(0.99999));
+
+    /*Mip in level 0 texels, pages are VT_PAGE_SIZE texels at every level*/
+    vec2 vTexels = uUV * uTexture.uSize;
+    vec2 vDx = dFdx(uTexCoord0.xy * uTexture.uSize);
+    vec2 vDy = dFdy(uTexCoord0.xy * uTexture.uSize);
+    float vLod = 0.5 * log2(max(max(dot(vDx, vDx), dot(vDy, vDy)), 1e-8));
+    int vLevel = int(clamp(floor(vLod), 0.0, float(uTexture.uLevelCount - 1u)));
+
+    ivec2 vPage = ivec2(vTexels / (VT_PAGE_SIZE * exp2(float(vLevel))));
+    vec4 vEntry = texelFetch(uTextures[nonuniformEXT(uTexture.uPageTable)], vPage, vLevel) * 255.0;
+    if (vEntry.a < 127.5)
+    {
+        /*Not even the coarsest page is in yet*/
+        vColor = vec4(0.5, 0.5, 0.5, 1.0);
+        return;
+    }
+
+    /*The entry may point at a coarser page than asked for, find where the texel is inside that one*/
+    float vScale = exp2(round(vEntry.b));
+    vec2 vInPage = vTexels / vScale - floor(vTexels / (VT_PAGE_SIZE * vScale)) * VT_PAGE_SIZE;
+    vec2 vAtlasTexel = round(vEntry.rg) * VT_PAGE_TEXELS + VT_PAGE_BORDER + vInPage;
+    vec2 vAtlasSize = uAtlasPages * VT_PAGE_TEXELS;
+
+    vColor = textureGrad(uTextures[uTexture0], vAtlasTexel / vAtlasSize, vDx / (vScale * vAtlasSize), vDy / (vScale * vAtlasSize));
+}
@@ -0,0 +1,78 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+// 
+//	Description:
+//		Virtual texture feedback shader (fragment version, bindless)
+//		Runs in the low resolution feedback pass and writes the page every texel wants
+// ------------------------------------------------------
+
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+#pragma shader_stage( fragment )
+
+/*Hidden texels must not write requests*/
+layout(early_fragment_tests) in;
+
+/*Mirrors VT_PAGE_SIZE in MVirtualTexture.hpp*/
+#define VT_PAGE_SIZE 128.0
+
+/*Mirrors MetalGpuVirtualTexture*/
+struct MetalVirtualTexture
+{
+    vec2 uSize;
+    uint uPageTable;
+    uint uLevelCount;
+};
+
+/*Mirrors MetalGpuVirtualHeader followed by the textures*/
+layout(std430, set = 1, binding = 1) readonly buffer MetalVirtualInfo
+{
+    uvec4 uAtlasAndFeedback;
+    vec4 uFeedbackBias;
+    MetalVirtualTexture uVirtualTextures[];
+} uBuffers[];
+
+/*The same heap binding seen as the feedback buffer*/
+layout(std430, set = 1, binding = 1) writeonly buffer MetalFeedbackBuffer
+{
+    uint uRequests[];
+} uFeedback[];
+
+/*Mirrors MetalBindlessMaterial, texture1 is this frame's feedback buffer, buffer the info buffer and material the virtual texture*/
+layout(push_constant) uniform MetalBindlessMaterial
+{
+    uint uTexture0;
+    uint uTexture1;
+    uint uBuffer;
+    uint uMaterial;
+};
+
+layout(location = 0) in vec2 uTexCoord0;
+layout(location = 1) in vec2 uTexCoord1;
+
+/*Mirrors PackPageRequest*/
+uint PackRequest(uint texture, uint mip, uvec2 page)
+{
+    return (texture << 24) | (mip << 20) | (page.y << 10) | page.x;
+}
+
+void main()
+{
+    MetalVirtualTexture uTexture = uBuffers[uBuffer].uVirtualTextures[uMaterial];
+    uvec2 uFeedbackSize = uBuffers[uBuffer].uAtlasAndFeedback.zw;
+    vec2 uUV = clamp(uTexCoord0.xy, vec2(0.0), vec2(0.99999));
+
+    /*Same mip as virtualtexture.frag would pick at full resolution*/
+    vec2 vTexels = uUV * uTexture.uSize;
+    vec2 vDx = dFdx(uTexCoord0.xy * uTexture.uSize);
+    vec2 vDy = dFdy(uTexCoord0.xy * uTexture.uSize);
+    float vLod = 0.5 * log2(max(max(dot(vDx, vDx), dot(vDy, vDy)), 1e-8)) + uBuffers[uBuffer].uFeedbackBias.x;
+    uint vLevel = uint(clamp(floor(vLod), 0.0, float(uTexture.uLevelCount - 1u)));
+
+    uvec2 vPage = uvec2(vTexels / (VT_PAGE_SIZE * exp2(float(vLevel))));
+    uvec2 vPixel = min(uvec2(gl_FragCoord.xy), uFeedbackSize - 1u);
+    uFeedback[uTexture1].uRequests[vPixel.y * uFeedbackSize.x + vPixel.x] = PackRequest(uMaterial, vLevel, vPage);
+}
@@ -0,0 +1,942 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine animation (skeletons, compressed clips, pose blending, skinning matrices)
+// ------------------------------------------------------
+
+#include "headers/MAnimation.hpp"
+#include "headers/MJobSystem.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+	#include <immintrin.h>
+	#define METAL_ANIMATION_LANES 8
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+	#include <xmmintrin.h>
+	#define METAL_ANIMATION_LANES 4
+#else
+	#define METAL_ANIMATION_LANES 1
+#endif
+
+namespace engine::animation
+{
+	using engine::jobs::ParallelFor;
+
+	/* Every quaternion component but the largest is inside +- this*/
+	static constexpr float SMALLEST_THREE_RANGE = 0.70710678f;
+
+	/* Track order inside a joint*/
+	static constexpr DWord TRACK_TRANSLATION = 0;
+	static constexpr DWord TRACK_ROTATION = 1;
+	static constexpr DWord TRACK_SCALE = 2;
+
+	/*
+		The pose kernels are written once over these, a set of lanes is as many joints as the widest
+		register of the build holds. ANIMATION_JOINT_ALIGNMENT is a multiple of every width.
+	*/
+#if METAL_ANIMATION_LANES == 8
+	typedef __m256 Lanes;
+	static inline Lanes LoadLanes(const float* p) { return _mm256_loadu_ps(p); }
+	static inline void StoreLanes(float* p, Lanes v) { _mm256_storeu_ps(p, v); }
+	static inline Lanes SetLanes(float v) { return _mm256_set1_ps(v); }
+	static inline Lanes Add(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+	static inline Lanes Sub(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+	static inline Lanes Mul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+	static inline Lanes Div(Lanes a, Lanes b) { return _mm256_div_ps(a, b); }
+	static inline Lanes Sqrt(Lanes a) { return _mm256_sqrt_ps(a); }
+	static inline Lanes SignOf(Lanes a) { return _mm256_and_ps(a, _mm256_set1_ps(-0.0f)); }
+	static inline Lanes FlipSign(Lanes a, Lanes sign) { return _mm256_xor_ps(a, sign); }
+#elif METAL_ANIMATION_LANES == 4
+	typedef __m128 Lanes;
+	static inline Lanes LoadLanes(const float* p) { return _mm_loadu_ps(p); }
+	static inline void StoreLanes(float* p, Lanes v) { _mm_storeu_ps(p, v); }
+	static inline Lanes SetLanes(float v) { return _mm_set1_ps(v); }
+	static inline Lanes Add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+	static inline Lanes Sub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+	static inline Lanes Mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+	static inline Lanes Div(Lanes a, Lanes b) { return _mm_div_ps(a, b); }
+	static inline Lanes Sqrt(Lanes a) { return _mm_sqrt_ps(a); }
+	static inline Lanes SignOf(Lanes a) { return _mm_and_ps(a, _mm_set1_ps(-0.0f)); }
+	static inline Lanes FlipSign(Lanes a, Lanes sign) { return _mm_xor_ps(a, sign); }
+#else
+	typedef float Lanes;
+	static inline Lanes LoadLanes(const float* p) { return *p; }
+	static inline void StoreLanes(float* p, Lanes v) { *p = v; }
+	static inline Lanes SetLanes(float v) { return v; }
+	static inline Lanes Add(Lanes a, Lanes b) { return a + b; }
+	static inline Lanes Sub(Lanes a, Lanes b) { return a - b; }
+	static inline Lanes Mul(Lanes a, Lanes b) { return a * b; }
+	static inline Lanes Div(Lanes a, Lanes b) { return a / b; }
+	static inline Lanes Sqrt(Lanes a) { return std::sqrt(a); }
+	static inline Lanes SignOf(Lanes a) { return std::bit_cast<float>(std::bit_cast<DWord>(a) & 0x80000000u); }
+	static inline Lanes FlipSign(Lanes a, Lanes sign) { return std::bit_cast<float>(std::bit_cast<DWord>(a) ^ std::bit_cast<DWord>(sign)); }
+#endif
+
+	static inline Lanes Lerp(Lanes a, Lanes b, Lanes t)
+	{
+		return Add(a, Mul(Sub(b, a), t));
+	}
+
+	/* Rotations go through the clip as the three smallest components, the largest is rebuilt from the unit length*/
+	static void EncodeRotation(const quatf& rotation, Word encoded[3])
+	{
+		float q[4] = { rotation.x, rotation.y, rotation.z, rotation.w };
+		float length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+		length = length > 0.0f ? length : 1.0f;
+
+		DWord largest = 0;
+		for (DWord i = 1; i < 4; i++)
+		{
+			largest = std::fabs(q[i]) > std::fabs(q[largest]) ? i : largest;
+		}
+
+		/* q and -q are the same rotation, keeping the largest positive means its sign never has to be stored*/
+		float sign = q[largest] < 0.0f ? -1.0f / length : 1.0f / length;
+		DWord written = 0;
+		for (DWord i = 0; i < 4; i++)
+		{
+			if (i == largest)
+			{
+				continue;
+			}
+
+			float value = std::clamp(q[i] * sign / SMALLEST_THREE_RANGE * 0.5f + 0.5f, 0.0f, 1.0f);
+			encoded[written++] = static_cast<Word>(std::lround(value * 32767.0f));
+		}
+
+		encoded[0] |= static_cast<Word>((largest & 1) << 15);
+		encoded[1] |= static_cast<Word>((largest >> 1) << 15);
+	}
+
+	static void DecodeRotation(const Word encoded[3], float q[4])
+	{
+		DWord largest = (encoded[0] >> 15) | ((encoded[1] >> 15) << 1);
+		float sum = 0.0f;
+		DWord read = 0;
+		for (DWord i = 0; i < 4; i++)
+		{
+			if (i == largest)
+			{
+				continue;
+			}
+
+			float value = (static_cast<float>(encoded[read++] & 0x7FFF) * (2.0f / 32767.0f) - 1.0f) * SMALLEST_THREE_RANGE;
+			q[i] = value;
+			sum += value * value;
+		}
+		q[largest] = std::sqrt(std::max(1.0f - sum, 0.0f));
+	}
+
+	static void DecodeValue(const Word encoded[3], const MetalClipTrack& track, DWord type, float value[4])
+	{
+		if (type == TRACK_ROTATION)
+		{
+			DecodeRotation(encoded, value);
+			return;
+		}
+
+		for (DWord i = 0; i < 3; i++)
+		{
+			value[i] = track.minimum[i] + static_cast<float>(encoded[i]) * (track.extent[i] / 65535.0f);
+		}
+	}
+
+	static void DecodeKey(const MetalCompressedClip& clip, const MetalClipTrack& track, DWord type, DWord key, float value[4])
+	{
+		DecodeValue(clip.keyvalues.data() + static_cast<usize>(key) * 3, track, type, value);
+	}
+
+	/* Channel of the first component of a track in a pose*/
+	static DWord TrackChannel(DWord type)
+	{
+		return type == TRACK_TRANSLATION ? POSE_TRANSLATION_X : type == TRACK_ROTATION ? POSE_ROTATION_X : POSE_SCALE_X;
+	}
+
+	void MetalPose::Resize(DWord count)
+	{
+		DWord padded = (count + ANIMATION_JOINT_ALIGNMENT - 1) / ANIMATION_JOINT_ALIGNMENT * ANIMATION_JOINT_ALIGNMENT;
+		if (count == jointcount && padded == stride && channels.size() == static_cast<usize>(padded) * POSE_CHANNEL_COUNT)
+		{
+			return;
+		}
+
+		jointcount = count;
+		stride = padded;
+		channels.assign(static_cast<usize>(stride) * POSE_CHANNEL_COUNT, 0.0f);
+		std::fill_n(Channel(POSE_ROTATION_W), stride, 1.0f);
+		std::fill_n(Channel(POSE_SCALE_X), stride * 3, 1.0f);
+	}
+
+	void MetalPose::SetJoint(DWord joint, const MetalJointTransform& transform)
+	{
+		Channel(POSE_TRANSLATION_X)[joint] = transform.translation.x;
+		Channel(POSE_TRANSLATION_Y)[joint] = transform.translation.y;
+		Channel(POSE_TRANSLATION_Z)[joint] = transform.translation.z;
+		Channel(POSE_ROTATION_X)[joint] = transform.rotation.x;
+		Channel(POSE_ROTATION_Y)[joint] = transform.rotation.y;
+		Channel(POSE_ROTATION_Z)[joint] = transform.rotation.z;
+		Channel(POSE_ROTATION_W)[joint] = transform.rotation.w;
+		Channel(POSE_SCALE_X)[joint] = transform.scale.x;
+		Channel(POSE_SCALE_Y)[joint] = transform.scale.y;
+		Channel(POSE_SCALE_Z)[joint] = transform.scale.z;
+	}
+
+	MetalJointTransform MetalPose::GetJoint(DWord joint) const
+	{
+		MetalJointTransform transform;
+		transform.translation = vec3f(Channel(POSE_TRANSLATION_X)[joint], Channel(POSE_TRANSLATION_Y)[joint], Channel(POSE_TRANSLATION_Z)[joint]);
+		transform.rotation = quatf(Channel(POSE_ROTATION_X)[joint], Channel(POSE_ROTATION_Y)[joint], Channel(POSE_ROTATION_Z)[joint], Channel(POSE_ROTATION_W)[joint]);
+		transform.scale = vec3f(Channel(POSE_SCALE_X)[joint], Channel(POSE_SCALE_Y)[joint], Channel(POSE_SCALE_Z)[joint]);
+		return transform;
+	}
+
+	/* a * b for affine matrices, the result applies b first then a*/
+	static MetalSkinMatrix MultiplyAffine(const MetalSkinMatrix& a, const MetalSkinMatrix& b)
+	{
+		MetalSkinMatrix result;
+		for (DWord i = 0; i < 3; i++)
+		{
+			const vec4f& r = a.rows[i];
+			result.rows[i] = vec4f(
+				r.x * b.rows[0].x + r.y * b.rows[1].x + r.z * b.rows[2].x,
+				r.x * b.rows[0].y + r.y * b.rows[1].y + r.z * b.rows[2].y,
+				r.x * b.rows[0].z + r.y * b.rows[1].z + r.z * b.rows[2].z,
+				r.x * b.rows[0].w + r.y * b.rows[1].w + r.z * b.rows[2].w + r.w);
+		}
+		return result;
+	}
+
+	static bool InvertAffine(const MetalSkinMatrix& m, MetalSkinMatrix& result)
+	{
+		const vec4f& a = m.rows[0];
+		const vec4f& b = m.rows[1];
+		const vec4f& c = m.rows[2];
+
+		/* Cofactors of the 3x3 part*/
+		float c00 = b.y * c.z - b.z * c.y, c01 = b.z * c.x - b.x * c.z, c02 = b.x * c.y - b.y * c.x;
+		float determinant = a.x * c00 + a.y * c01 + a.z * c02;
+		if (std::fabs(determinant) < 1e-12f)
+		{
+			return false;
+		}
+
+		float inverse = 1.0f / determinant;
+		vec3f r0(c00 * inverse, (a.z * c.y - a.y * c.z) * inverse, (a.y * b.z - a.z * b.y) * inverse);
+		vec3f r1(c01 * inverse, (a.x * c.z - a.z * c.x) * inverse, (a.z * b.x - a.x * b.z) * inverse);
+		vec3f r2(c02 * inverse, (a.y * c.x - a.x * c.y) * inverse, (a.x * b.y - a.y * b.x) * inverse);
+
+		result.rows[0] = vec4f(r0.x, r0.y, r0.z, -(r0.x * a.w + r0.y * b.w + r0.z * c.w));
+		result.rows[1] = vec4f(r1.x, r1.y, r1.z, -(r1.x * a.w + r1.y * b.w + r1.z * c.w));
+		result.rows[2] = vec4f(r2.x, r2.y, r2.z, -(r2.x * a.w + r2.y * b.w + r2.z * c.w));
+		return true;
+	}
+
+	static MetalSkinMatrix MakeAffine(const MetalJointTransform& transform)
+	{
+		mat4f matrix = MakeTransformMatrix(transform.translation, transform.rotation, transform.scale);
+		MetalSkinMatrix result;
+		result.rows[0] = matrix.rows[0];
+		result.rows[1] = matrix.rows[1];
+		result.rows[2] = matrix.rows[2];
+		return result;
+	}
+
+	int BuildSkeleton(const Word* parents, const MetalJointTransform* bindpose, DWord jointcount, MetalSkeleton& skeleton)
+	{
+		if (jointcount == 0 || jointcount > ANIMATION_MAX_JOINTS)
+		{
+			return 1;
+		}
+
+		std::vector<MetalSkinMatrix> model(jointcount);
+		skeleton.parents.assign(parents, parents + jointcount);
+		skeleton.bindpose.assign(bindpose, bindpose + jointcount);
+		skeleton.inversebind.resize(jointcount);
+		for (DWord i = 0; i < jointcount; i++)
+		{
+			/* Parents first keeps every evaluation one pass in order*/
+			if (parents[i] != ANIMATION_NO_PARENT && parents[i] >= i)
+			{
+				return 1;
+			}
+
+			MetalSkinMatrix local = MakeAffine(bindpose[i]);
+			model[i] = parents[i] == ANIMATION_NO_PARENT ? local : MultiplyAffine(model[parents[i]], local);
+			if (!InvertAffine(model[i], skeleton.inversebind[i]))
+			{
+				return 1;
+			}
+		}
+		return 0;
+	}
+
+	/* Dense samples of one track, four floats each (translation and scale leave w at 0)*/
+	struct MetalTrackSamples
+	{
+		std::vector<float>	values;		/* What the source has*/
+		std::vector<float>	decoded;	/* What a key on the frame would decode to*/
+		std::vector<Word>	encoded;	/* Three per frame*/
+	};
+
+	static float TrackError(const MetalTrackSamples& samples, DWord type, DWord first, DWord last, DWord frame)
+	{
+		const float* a = samples.decoded.data() + static_cast<usize>(first) * 4;
+		const float* b = samples.decoded.data() + static_cast<usize>(last) * 4;
+		const float* source = samples.values.data() + static_cast<usize>(frame) * 4;
+		float t = last > first ? static_cast<float>(frame - first) / static_cast<float>(last - first) : 0.0f;
+
+		float value[4];
+		if (type == TRACK_ROTATION)
+		{
+			/* Same normalized lerp along the shorter arc the runtime does*/
+			float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+			float sign = dot < 0.0f ? -1.0f : 1.0f;
+			float length = 0.0f;
+			for (DWord i = 0; i < 4; i++)
+			{
+				value[i] = a[i] + (b[i] * sign - a[i]) * t;
+				length += value[i] * value[i];
+			}
+
+			/* The source may sit on the other hemisphere, both are the same rotation*/
+			float inverse = length > 0.0f ? 1.0f / std::sqrt(length) : 1.0f;
+			float same = 0.0f, flipped = 0.0f;
+			for (DWord i = 0; i < 4; i++)
+			{
+				same = std::max(same, std::fabs(value[i] * inverse - source[i]));
+				flipped = std::max(flipped, std::fabs(value[i] * inverse + source[i]));
+			}
+			return std::min(same, flipped);
+		}
+
+		float error = 0.0f;
+		for (DWord i = 0; i < 3; i++)
+		{
+			error = std::max(error, std::fabs(a[i] + (b[i] - a[i]) * t - source[i]));
+		}
+		return error;
+	}
+
+	static bool SegmentFits(const MetalTrackSamples& samples, DWord type, DWord first, DWord last, float tolerance)
+	{
+		for (DWord frame = first + 1; frame < last; frame++)
+		{
+			if (TrackError(samples, type, first, last, frame) > tolerance)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static void CookTrack(const MetalClipSource& source, DWord joint, DWord type, float tolerance, MetalTrackSamples& samples,
+		MetalClipTrack& track, MetalCompressedClip& clip)
+	{
+		DWord framecount = source.framecount;
+		samples.values.assign(static_cast<usize>(framecount) * 4, 0.0f);
+		samples.decoded.assign(static_cast<usize>(framecount) * 4, 0.0f);
+		samples.encoded.assign(static_cast<usize>(framecount) * 3, 0);
+
+		for (DWord frame = 0; frame < framecount; frame++)
+		{
+			const MetalJointTransform& transform = source.frames[static_cast<usize>(frame) * source.jointcount + joint];
+			float* value = samples.values.data() + static_cast<usize>(frame) * 4;
+			if (type == TRACK_ROTATION)
+			{
+				const quatf& q = transform.rotation;
+				float length = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+				length = length > 0.0f ? length : 1.0f;
+				value[0] = q.x / length;
+				value[1] = q.y / length;
+				value[2] = q.z / length;
+				value[3] = q.w / length;
+			}
+			else
+			{
+				const vec3f& v = type == TRACK_TRANSLATION ? transform.translation : transform.scale;
+				value[0] = v.x;
+				value[1] = v.y;
+				value[2] = v.z;
+			}
+		}
+
+		/* Translation and scale are quantized over the range the track covers*/
+		track.firstkey = static_cast<DWord>(clip.keyframes.size());
+		for (DWord i = 0; i < 3; i++)
+		{
+			float minimum = samples.values[i], maximum = samples.values[i];
+			for (DWord frame = 1; frame < framecount; frame++)
+			{
+				minimum = std::min(minimum, samples.values[static_cast<usize>(frame) * 4 + i]);
+				maximum = std::max(maximum, samples.values[static_cast<usize>(frame) * 4 + i]);
+			}
+			track.minimum[i] = type == TRACK_ROTATION ? 0.0f : minimum;
+			track.extent[i] = type == TRACK_ROTATION ? 0.0f : maximum - minimum;
+		}
+
+		for (DWord frame = 0; frame < framecount; frame++)
+		{
+			const float* value = samples.values.data() + static_cast<usize>(frame) * 4;
+			Word* encoded = samples.encoded.data() + static_cast<usize>(frame) * 3;
+			if (type == TRACK_ROTATION)
+			{
+				EncodeRotation(quatf(value[0], value[1], value[2], value[3]), encoded);
+			}
+			else
+			{
+				for (DWord i = 0; i < 3; i++)
+				{
+					float normalized = track.extent[i] > 0.0f ? (value[i] - track.minimum[i]) / track.extent[i] : 0.0f;
+					encoded[i] = static_cast<Word>(std::lround(std::clamp(normalized, 0.0f, 1.0f) * 65535.0f));
+				}
+			}
+
+			/* Errors are measured on what will actually be decoded so quantization can't stack on top of the fit*/
+			DecodeValue(encoded, track, type, samples.decoded.data() + static_cast<usize>(frame) * 4);
+		}
+
+		/*
+			Greedy fit, every key reaches as far ahead as linear interpolation stays inside the tolerance.
+			The reach is found by doubling then halving so long holds don't cost a test per frame.
+		*/
+		std::vector<DWord> keys = { 0 };
+		bool constant = true;
+		for (DWord frame = 1; frame < framecount && constant; frame++)
+		{
+			constant = TrackError(samples, type, 0, 0, frame) <= tolerance;
+		}
+
+		DWord first = 0;
+		while (!constant && first + 1 < framecount)
+		{
+			DWord good = first + 1;
+			DWord step = 1;
+			while (good + step < framecount && SegmentFits(samples, type, first, good + step, tolerance))
+			{
+				good += step;
+				step *= 2;
+			}
+
+			DWord bad = std::min(good + step, framecount);
+			while (bad - good > 1)
+			{
+				DWord middle = good + (bad - good) / 2;
+				if (SegmentFits(samples, type, first, middle, tolerance))
+				{
+					good = middle;
+				}
+				else
+				{
+					bad = middle;
+				}
+			}
+
+			keys.push_back(good);
+			first = good;
+		}
+
+		track.keycount = static_cast<DWord>(keys.size());
+		for (DWord key : keys)
+		{
+			const Word* encoded = samples.encoded.data() + static_cast<usize>(key) * 3;
+			clip.keyframes.push_back(static_cast<Word>(key));
+			clip.keyvalues.insert(clip.keyvalues.end(), encoded, encoded + 3);
+		}
+	}
+
+	int CookClip(const MetalClipSource& source, MetalCompressedClip& clip, const MetalClipCookSettings& settings)
+	{
+		if (source.jointcount == 0 || source.jointcount > ANIMATION_MAX_JOINTS || source.framecount == 0 || source.framecount > 65536 ||
+			source.framerate <= 0.0f || source.frames.size() != static_cast<usize>(source.jointcount) * source.framecount)
+		{
+			return 1;
+		}
+
+		clip.tracks.resize(static_cast<usize>(source.jointcount) * 3);
+		clip.keyframes.clear();
+		clip.keyvalues.clear();
+
+		MetalTrackSamples samples;
+		const float tolerances[3] = { settings.translationerror, settings.rotationerror, settings.scaleerror };
+		for (DWord joint = 0; joint < source.jointcount; joint++)
+		{
+			for (DWord type = 0; type < 3; type++)
+			{
+				MetalClipTrack& track = clip.tracks[static_cast<usize>(joint) * 3 + type];
+				CookTrack(source, joint, type, tolerances[type], samples, track, clip);
+			}
+		}
+
+		MetalClipHeader& header = clip.header;
+		header.magic		= ANIMATION_CLIP_MAGIC;
+		header.version		= ANIMATION_VERSION;
+		header.jointcount	= source.jointcount;
+		header.framecount	= source.framecount;
+		header.framerate	= source.framerate;
+		header.duration		= static_cast<float>(source.framecount - 1) / source.framerate;
+		header.keycount		= static_cast<DWord>(clip.keyframes.size());
+		header.reserved		= 0;
+		return 0;
+	}
+
+	int WritePackageSkeleton(MEPF* package, const char* name, const MetalSkeleton& skeleton)
+	{
+		DWord jointcount = skeleton.GetJointCount();
+		if (jointcount == 0 || jointcount > ANIMATION_MAX_JOINTS || skeleton.bindpose.size() != jointcount || skeleton.inversebind.size() != jointcount)
+		{
+			return 1;
+		}
+
+		MetalSkeletonHeader header = { SKELETON_MAGIC, ANIMATION_VERSION, jointcount, 0 };
+		usize posesize = sizeof(MetalJointTransform) * jointcount;
+		usize inversesize = sizeof(MetalSkinMatrix) * jointcount;
+
+		std::vector<Byte> entry(sizeof(header) + posesize + inversesize + sizeof(Word) * jointcount);
+		std::memcpy(entry.data(), &header, sizeof(header));
+		std::memcpy(entry.data() + sizeof(header), skeleton.bindpose.data(), posesize);
+		std::memcpy(entry.data() + sizeof(header) + posesize, skeleton.inversebind.data(), inversesize);
+		std::memcpy(entry.data() + sizeof(header) + posesize + inversesize, skeleton.parents.data(), sizeof(Word) * jointcount);
+		return MEPFAddEntry(package, name, MEPF_ENTRY_SKELETON, entry.data(), entry.size());
+	}
+
+	int ReadPackageSkeleton(MEPF* package, const char* name, MetalSkeleton& skeleton)
+	{
+		const MEPFEntry* entry = MEPFFindEntry(package, name);
+		if (entry == nullptr || entry->type != MEPF_ENTRY_SKELETON)
+		{
+			return 1;
+		}
+
+		MetalSkeletonHeader header;
+		if (MEPFReadEntry(package, entry, 0, &header, sizeof(header)) != 0 || header.magic != SKELETON_MAGIC ||
+			header.version != ANIMATION_VERSION || header.jointcount == 0 || header.jointcount > ANIMATION_MAX_JOINTS)
+		{
+			return 1;
+		}
+
+		usize posesize = sizeof(MetalJointTransform) * header.jointcount;
+		usize inversesize = sizeof(MetalSkinMatrix) * header.jointcount;
+		usize parentsize = sizeof(Word) * header.jointcount;
+		if (sizeof(header) + posesize + inversesize + parentsize > entry->size)
+		{
+			return 1;
+		}
+
+		skeleton.bindpose.resize(header.jointcount);
+		skeleton.inversebind.resize(header.jointcount);
+		skeleton.parents.resize(header.jointcount);
+		if (MEPFReadEntry(package, entry, sizeof(header), skeleton.bindpose.data(), posesize) != 0 ||
+			MEPFReadEntry(package, entry, sizeof(header) + posesize, skeleton.inversebind.data(), inversesize) != 0 ||
+			MEPFReadEntry(package, entry, sizeof(header) + posesize + inversesize, skeleton.parents.data(), parentsize) != 0)
+		{
+			return 1;
+		}
+
+		/* Evaluation walks the joints in order and trusts every parent to be done already*/
+		for (DWord i = 0; i < header.jointcount; i++)
+		{
+			if (skeleton.parents[i] != ANIMATION_NO_PARENT && skeleton.parents[i] >= i)
+			{
+				return 1;
+			}
+		}
+		return 0;
+	}
+
+	int WritePackageClip(MEPF* package, const char* name, const MetalCompressedClip& clip)
+	{
+		const MetalClipHeader& header = clip.header;
+		if (header.magic != ANIMATION_CLIP_MAGIC || clip.tracks.size() != static_cast<usize>(header.jointcount) * 3 ||
+			clip.keyframes.size() != header.keycount || clip.keyvalues.size() != static_cast<usize>(header.keycount) * 3)
+		{
+			return 1;
+		}
+
+		usize tracksize = sizeof(MetalClipTrack) * clip.tracks.size();
+		usize framesize = sizeof(Word) * clip.keyframes.size();
+		usize valuesize = sizeof(Word) * clip.keyvalues.size();
+
+		std::vector<Byte> entry(sizeof(header) + tracksize + framesize + valuesize);
+		std::memcpy(entry.data(), &header, sizeof(header));
+		std::memcpy(entry.data() + sizeof(header), clip.tracks.data(), tracksize);
+		std::memcpy(entry.data() + sizeof(header) + tracksize, clip.keyframes.data(), framesize);
+		std::memcpy(entry.data() + sizeof(header) + tracksize + framesize, clip.keyvalues.data(), valuesize);
+		return MEPFAddEntry(package, name, MEPF_ENTRY_ANIMATION, entry.data(), entry.size());
+	}
+
+	int ReadPackageClip(MEPF* package, const char* name, MetalCompressedClip& clip)
+	{
+		const MEPFEntry* entry = MEPFFindEntry(package, name);
+		if (entry == nullptr || entry->type != MEPF_ENTRY_ANIMATION)
+		{
+			return 1;
+		}
+
+		MetalClipHeader header;
+		if (MEPFReadEntry(package, entry, 0, &header, sizeof(header)) != 0 || header.magic != ANIMATION_CLIP_MAGIC ||
+			header.version != ANIMATION_VERSION || header.jointcount == 0 || header.jointcount > ANIMATION_MAX_JOINTS ||
+			header.framecount == 0 || header.framecount > 65536 || header.framerate <= 0.0f)
+		{
+			return 1;
+		}
+
+		usize tracksize = sizeof(MetalClipTrack) * header.jointcount * 3;
+		usize framesize = sizeof(Word) * header.keycount;
+		usize valuesize = sizeof(Word) * header.keycount * 3;
+		if (sizeof(header) + tracksize + framesize + valuesize > entry->size)
+		{
+			return 1;
+		}
+
+		clip.tracks.resize(static_cast<usize>(header.jointcount) * 3);
+		clip.keyframes.resize(header.keycount);
+		clip.keyvalues.resize(static_cast<usize>(header.keycount) * 3);
+		if (MEPFReadEntry(package, entry, sizeof(header), clip.tracks.data(), tracksize) != 0 ||
+			(framesize != 0 && MEPFReadEntry(package, entry, sizeof(header) + tracksize, clip.keyframes.data(), framesize) != 0) ||
+			(valuesize != 0 && MEPFReadEntry(package, entry, sizeof(header) + tracksize + framesize, clip.keyvalues.data(), valuesize) != 0))
+		{
+			return 1;
+		}
+
+		/* Sampling indexes the key tables without checking, a bad range would read past them*/
+		for (const MetalClipTrack& track : clip.tracks)
+		{
+			if (track.keycount == 0 || track.firstkey > header.keycount || track.keycount > header.keycount - track.firstkey)
+			{
+				return 1;
+			}
+		}
+
+		clip.header = header;
+		return 0;
+	}
+
+	/*
+		Blends a towards b, translation and scale linearly and rotations as normalized lerps along the
+		shorter arc. alpha holds a factor per joint for each of the three tracks, without it every
+		joint uses weight.
+	*/
+	static void LerpPose(const MetalPose& a, const MetalPose& b, const float* alpha, float weight, MetalPose& result)
+	{
+		DWord stride = a.stride;
+		const Lanes one = SetLanes(1.0f);
+		for (DWord i = 0; i < stride; i += METAL_ANIMATION_LANES)
+		{
+			Lanes wt = alpha != nullptr ? LoadLanes(alpha + i) : SetLanes(weight);
+			Lanes wr = alpha != nullptr ? LoadLanes(alpha + stride + i) : wt;
+			Lanes ws = alpha != nullptr ? LoadLanes(alpha + stride * 2 + i) : wt;
+
+			for (DWord c = POSE_TRANSLATION_X; c <= POSE_TRANSLATION_Z; c++)
+			{
+				StoreLanes(result.Channel(c) + i, Lerp(LoadLanes(a.Channel(c) + i), LoadLanes(b.Channel(c) + i), wt));
+			}
+
+			for (DWord c = POSE_SCALE_X; c <= POSE_SCALE_Z; c++)
+			{
+				StoreLanes(result.Channel(c) + i, Lerp(LoadLanes(a.Channel(c) + i), LoadLanes(b.Channel(c) + i), ws));
+			}
+
+			Lanes ax = LoadLanes(a.Channel(POSE_ROTATION_X) + i), ay = LoadLanes(a.Channel(POSE_ROTATION_Y) + i);
+			Lanes az = LoadLanes(a.Channel(POSE_ROTATION_Z) + i), aw = LoadLanes(a.Channel(POSE_ROTATION_W) + i);
+			Lanes bx = LoadLanes(b.Channel(POSE_ROTATION_X) + i), by = LoadLanes(b.Channel(POSE_ROTATION_Y) + i);
+			Lanes bz = LoadLanes(b.Channel(POSE_ROTATION_Z) + i), bw = LoadLanes(b.Channel(POSE_ROTATION_W) + i);
+
+			/* b onto a's hemisphere so the blend takes the shorter way round*/
+			Lanes sign = SignOf(Add(Add(Mul(ax, bx), Mul(ay, by)), Add(Mul(az, bz), Mul(aw, bw))));
+			Lanes x = Lerp(ax, FlipSign(bx, sign), wr);
+			Lanes y = Lerp(ay, FlipSign(by, sign), wr);
+			Lanes z = Lerp(az, FlipSign(bz, sign), wr);
+			Lanes w = Lerp(aw, FlipSign(bw, sign), wr);
+
+			Lanes inverse = Div(one, Sqrt(Add(Add(Mul(x, x), Mul(y, y)), Add(Mul(z, z), Mul(w, w)))));
+			StoreLanes(result.Channel(POSE_ROTATION_X) + i, Mul(x, inverse));
+			StoreLanes(result.Channel(POSE_ROTATION_Y) + i, Mul(y, inverse));
+			StoreLanes(result.Channel(POSE_ROTATION_Z) + i, Mul(z, inverse));
+			StoreLanes(result.Channel(POSE_ROTATION_W) + i, Mul(w, inverse));
+		}
+	}
+
+	static float ClipFrame(const MetalClipHeader& header, float time, bool loop)
+	{
+		float last = static_cast<float>(header.framecount - 1);
+		if (header.framecount <= 1)
+		{
+			return 0.0f;
+		}
+
+		if (loop)
+		{
+			time = std::fmod(time, header.duration);
+			time = time < 0.0f ? time + header.duration : time;
+		}
+		return std::clamp(time * header.framerate, 0.0f, last);
+	}
+
+	void SampleClip(const MetalCompressedClip& clip, float time, bool loop, MetalPose& pose, MetalAnimationScratch& scratch)
+	{
+		DWord jointcount = clip.header.jointcount;
+		pose.Resize(jointcount);
+		scratch.next.Resize(jointcount);
+		scratch.alpha.resize(static_cast<usize>(pose.stride) * 3, 0.0f);
+
+		/*
+			Finding and decoding the keys is per track, the interpolation between them is one pass
+			over the whole pose in LerpPose
+		*/
+		float frame = ClipFrame(clip.header, time, loop);
+		for (DWord joint = 0; joint < jointcount; joint++)
+		{
+			for (DWord type = 0; type < 3; type++)
+			{
+				const MetalClipTrack& track = clip.tracks[static_cast<usize>(joint) * 3 + type];
+				const Word* frames = clip.keyframes.data() + track.firstkey;
+				DWord channel = TrackChannel(type);
+				DWord components = type == TRACK_ROTATION ? 4 : 3;
+
+				float previous[4], next[4];
+				float alpha = 0.0f;
+				if (track.keycount == 1)
+				{
+					DecodeKey(clip, track, type, track.firstkey, previous);
+					std::memcpy(next, previous, sizeof(next));
+				}
+				else
+				{
+					DWord second = static_cast<DWord>(std::upper_bound(frames, frames + track.keycount, frame,
+						[](float value, Word key) { return value < static_cast<float>(key); }) - frames);
+					second = std::clamp(second, 1u, track.keycount - 1);
+
+					float start = static_cast<float>(frames[second - 1]);
+					float end = static_cast<float>(frames[second]);
+					alpha = std::clamp((frame - start) / (end - start), 0.0f, 1.0f);
+					DecodeKey(clip, track, type, track.firstkey + second - 1, previous);
+					DecodeKey(clip, track, type, track.firstkey + second, next);
+				}
+
+				for (DWord c = 0; c < components; c++)
+				{
+					pose.Channel(channel + c)[joint] = previous[c];
+					scratch.next.Channel(channel + c)[joint] = next[c];
+				}
+				scratch.alpha[static_cast<usize>(type) * pose.stride + joint] = alpha;
+			}
+		}
+
+		LerpPose(pose, scratch.next, scratch.alpha.data(), 0.0f, pose);
+	}
+
+	void BlendPoses(const MetalPose& a, const MetalPose& b, float weight, MetalPose& result)
+	{
+		result.Resize(a.jointcount);
+		LerpPose(a, b, nullptr, weight, result);
+	}
+
+	void AddPoses(const MetalPose& base, const MetalPose& additive, float weight, MetalPose& result)
+	{
+		result.Resize(base.jointcount);
+
+		const Lanes one = SetLanes(1.0f);
+		const Lanes w = SetLanes(weight);
+		for (DWord i = 0; i < base.stride; i += METAL_ANIMATION_LANES)
+		{
+			for (DWord c = POSE_TRANSLATION_X; c <= POSE_TRANSLATION_Z; c++)
+			{
+				StoreLanes(result.Channel(c) + i, Add(LoadLanes(base.Channel(c) + i), Mul(LoadLanes(additive.Channel(c) + i), w)));
+			}
+
+			for (DWord c = POSE_SCALE_X; c <= POSE_SCALE_Z; c++)
+			{
+				StoreLanes(result.Channel(c) + i, Mul(LoadLanes(base.Channel(c) + i), Lerp(one, LoadLanes(additive.Channel(c) + i), w)));
+			}
+
+			/* Weighted delta, identity towards the additive rotation along the shorter arc*/
+			Lanes ax = LoadLanes(additive.Channel(POSE_ROTATION_X) + i), ay = LoadLanes(additive.Channel(POSE_ROTATION_Y) + i);
+			Lanes az = LoadLanes(additive.Channel(POSE_ROTATION_Z) + i), aw = LoadLanes(additive.Channel(POSE_ROTATION_W) + i);
+			Lanes sign = SignOf(aw);
+			Lanes dx = Mul(FlipSign(ax, sign), w);
+			Lanes dy = Mul(FlipSign(ay, sign), w);
+			Lanes dz = Mul(FlipSign(az, sign), w);
+			Lanes dw = Lerp(one, FlipSign(aw, sign), w);
+			Lanes inverse = Div(one, Sqrt(Add(Add(Mul(dx, dx), Mul(dy, dy)), Add(Mul(dz, dz), Mul(dw, dw)))));
+			dx = Mul(dx, inverse);
+			dy = Mul(dy, inverse);
+			dz = Mul(dz, inverse);
+			dw = Mul(dw, inverse);
+
+			/* base * delta, the delta is in the joint's own space*/
+			Lanes bx = LoadLanes(base.Channel(POSE_ROTATION_X) + i), by = LoadLanes(base.Channel(POSE_ROTATION_Y) + i);
+			Lanes bz = LoadLanes(base.Channel(POSE_ROTATION_Z) + i), bw = LoadLanes(base.Channel(POSE_ROTATION_W) + i);
+			StoreLanes(result.Channel(POSE_ROTATION_X) + i, Sub(Add(Add(Mul(bw, dx), Mul(bx, dw)), Mul(by, dz)), Mul(bz, dy)));
+			StoreLanes(result.Channel(POSE_ROTATION_Y) + i, Add(Add(Sub(Mul(bw, dy), Mul(bx, dz)), Mul(by, dw)), Mul(bz, dx)));
+			StoreLanes(result.Channel(POSE_ROTATION_Z) + i, Add(Sub(Add(Mul(bw, dz), Mul(bx, dy)), Mul(by, dx)), Mul(bz, dw)));
+			StoreLanes(result.Channel(POSE_ROTATION_W) + i, Sub(Sub(Sub(Mul(bw, dw), Mul(bx, dx)), Mul(by, dy)), Mul(bz, dz)));
+		}
+	}
+
+	void BuildSkinMatrices(const MetalSkeleton& skeleton, const MetalPose& pose, MetalSkinMatrix* skinmatrices, MetalAnimationScratch& scratch)
+	{
+		DWord stride = pose.stride;
+		scratch.locals.resize(static_cast<usize>(stride) * 12);
+		scratch.model.resize(skeleton.GetJointCount());
+
+		/* Local matrices for every joint at once, locals[(row * 4 + column) * stride + joint]*/
+		float* locals = scratch.locals.data();
+		const Lanes one = SetLanes(1.0f);
+		const Lanes two = SetLanes(2.0f);
+		for (DWord i = 0; i < stride; i += METAL_ANIMATION_LANES)
+		{
+			Lanes x = LoadLanes(pose.Channel(POSE_ROTATION_X) + i), y = LoadLanes(pose.Channel(POSE_ROTATION_Y) + i);
+			Lanes z = LoadLanes(pose.Channel(POSE_ROTATION_Z) + i), w = LoadLanes(pose.Channel(POSE_ROTATION_W) + i);
+			Lanes sx = LoadLanes(pose.Channel(POSE_SCALE_X) + i), sy = LoadLanes(pose.Channel(POSE_SCALE_Y) + i);
+			Lanes sz = LoadLanes(pose.Channel(POSE_SCALE_Z) + i);
+
+			Lanes xx = Mul(x, x), yy = Mul(y, y), zz = Mul(z, z);
+			Lanes xy = Mul(x, y), xz = Mul(x, z), yz = Mul(y, z);
+			Lanes wx = Mul(w, x), wy = Mul(w, y), wz = Mul(w, z);
+
+			StoreLanes(locals + 0 * stride + i, Mul(Sub(one, Mul(two, Add(yy, zz))), sx));
+			StoreLanes(locals + 1 * stride + i, Mul(Mul(two, Sub(xy, wz)), sy));
+			StoreLanes(locals + 2 * stride + i, Mul(Mul(two, Add(xz, wy)), sz));
+			StoreLanes(locals + 3 * stride + i, LoadLanes(pose.Channel(POSE_TRANSLATION_X) + i));
+			StoreLanes(locals + 4 * stride + i, Mul(Mul(two, Add(xy, wz)), sx));
+			StoreLanes(locals + 5 * stride + i, Mul(Sub(one, Mul(two, Add(xx, zz))), sy));
+			StoreLanes(locals + 6 * stride + i, Mul(Mul(two, Sub(yz, wx)), sz));
+			StoreLanes(locals + 7 * stride + i, LoadLanes(pose.Channel(POSE_TRANSLATION_Y) + i));
+			StoreLanes(locals + 8 * stride + i, Mul(Mul(two, Sub(xz, wy)), sx));
+			StoreLanes(locals + 9 * stride + i, Mul(Mul(two, Add(yz, wx)), sy));
+			StoreLanes(locals + 10 * stride + i, Mul(Sub(one, Mul(two, Add(xx, yy))), sz));
+			StoreLanes(locals + 11 * stride + i, LoadLanes(pose.Channel(POSE_TRANSLATION_Z) + i));
+		}
+
+		/* The hierarchy is a chain of dependencies, one joint at a time in parent order*/
+		for (DWord joint = 0; joint < skeleton.GetJointCount(); joint++)
+		{
+			MetalSkinMatrix local;
+			for (DWord row = 0; row < 3; row++)
+			{
+				const float* r = locals + static_cast<usize>(row) * 4 * stride + joint;
+				local.rows[row] = vec4f(r[0], r[stride], r[stride * 2], r[stride * 3]);
+			}
+
+			Word parent = skeleton.parents[joint];
+			scratch.model[joint] = parent == ANIMATION_NO_PARENT ? local : MultiplyAffine(scratch.model[parent], local);
+
+			/* One whole matrix per joint in order, mapped memory is usually write combined and hates partial or scattered writes*/
+			skinmatrices[joint] = MultiplyAffine(scratch.model[joint], skeleton.inversebind[joint]);
+		}
+	}
+
+	/* Evaluates a node into scratch.poses[slot], inputs go in the slots after it*/
+	static bool EvaluateNode(const MetalCharacter& character, DWord index, DWord slot, DWord depth, MetalAnimationScratch& scratch)
+	{
+		const MetalBlendTree& tree = *character.tree;
+		if (depth >= ANIMATION_MAX_BLEND_DEPTH || index >= tree.nodes.size())
+		{
+			return false;
+		}
+
+		const MetalBlendNode& node = tree.nodes[index];
+		if (node.parameter >= character.parametercount)
+		{
+			return false;
+		}
+
+		float parameter = character.parameters[node.parameter];
+		switch (node.type)
+		{
+		case BLEND_NODE_CLIP:
+		{
+			if (node.clip >= character.clipcount || character.clips[node.clip] == nullptr ||
+				character.clips[node.clip]->header.jointcount != character.skeleton->GetJointCount())
+			{
+				return false;
+			}
+
+			SampleClip(*character.clips[node.clip], parameter, node.loop, scratch.poses[slot], scratch);
+			return true;
+		}
+		case BLEND_NODE_LERP:
+		{
+			/* Fully one side is just that side*/
+			if (parameter <= 0.0f || parameter >= 1.0f)
+			{
+				return EvaluateNode(character, node.inputs[parameter <= 0.0f ? 0 : 1], slot, depth + 1, scratch);
+			}
+
+			if (!EvaluateNode(character, node.inputs[0], slot + 1, depth + 1, scratch) ||
+				!EvaluateNode(character, node.inputs[1], slot + 2, depth + 1, scratch))
+			{
+				return false;
+			}
+
+			BlendPoses(scratch.poses[slot + 1], scratch.poses[slot + 2], parameter, scratch.poses[slot]);
+			return true;
+		}
+		case BLEND_NODE_ADDITIVE:
+		{
+			if (parameter <= 0.0f)
+			{
+				return EvaluateNode(character, node.inputs[0], slot, depth + 1, scratch);
+			}
+
+			if (!EvaluateNode(character, node.inputs[0], slot + 1, depth + 1, scratch) ||
+				!EvaluateNode(character, node.inputs[1], slot + 2, depth + 1, scratch))
+			{
+				return false;
+			}
+
+			AddPoses(scratch.poses[slot + 1], scratch.poses[slot + 2], parameter, scratch.poses[slot]);
+			return true;
+		}
+		default:
+			return false;
+		}
+	}
+
+	int EvaluateCharacter(const MetalCharacter& character, MetalAnimationScratch& scratch)
+	{
+		if (character.skeleton == nullptr || character.tree == nullptr || character.skinmatrices == nullptr ||
+			character.skeleton->GetJointCount() == 0)
+		{
+			return 1;
+		}
+
+		/* A node's inputs sit in the two slots after it, so a tree never needs more than this many*/
+		scratch.poses.resize(std::max<usize>(scratch.poses.size(), ANIMATION_MAX_BLEND_DEPTH * 2 + 1));
+		if (!EvaluateNode(character, character.tree->root, 0, 0, scratch))
+		{
+			return 1;
+		}
+
+		BuildSkinMatrices(*character.skeleton, scratch.poses[0], character.skinmatrices, scratch);
+		return 0;
+	}
+
+	DWord EvaluateCharacters(const MetalCharacter* characters, DWord count)
+	{
+		std::atomic<DWord> evaluated{ 0 };
+
+		/* Characters don't share anything they write, each batch only needs its own scratch*/
+		ParallelFor(count, 0, [&](DWord first, DWord last)
+		{
+			MetalAnimationScratch Scratch;
+			DWord done = 0;
+			for (DWord i = first; i < last; i++)
+			{
+				done += EvaluateCharacter(characters[i], Scratch) == 0 ? 1 : 0;
+			}
+			evaluated.fetch_add(done, std::memory_order_relaxed);
+		});
+
+		return evaluated.load(std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,772 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine bounding volume hierarchy (scene spatial index)
+// ------------------------------------------------------
+
+#include "headers/MBvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+	#include <xmmintrin.h>
+	#define METAL_BVH_SSE 1
+#endif
+
+namespace engine::spatial
+{
+	/* Traversal stack entries kept on the stack, enough for any sensible tree. Degenerate trees (lots of
+		boxes piled on one spot) can go deeper, the rest spills to the heap rather than dropping subtrees.
+	*/
+	static constexpr DWord BVH_STACK_SIZE = 128;
+
+	/* SAH costs, a node visit is cheaper than testing an object*/
+	static constexpr float SAH_TRAVERSAL_COST = 1.0f;
+	static constexpr float SAH_INTERSECT_COST = 1.0f;
+
+	void MetalAABB::Grow(const vec3f& p)
+	{
+		min = vec3f(std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z));
+		max = vec3f(std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z));
+	}
+
+	void MetalAABB::Grow(const MetalAABB& b)
+	{
+		min = vec3f(std::min(min.x, b.min.x), std::min(min.y, b.min.y), std::min(min.z, b.min.z));
+		max = vec3f(std::max(max.x, b.max.x), std::max(max.y, b.max.y), std::max(max.z, b.max.z));
+	}
+
+	float MetalAABB::SurfaceArea() const
+	{
+		if (IsEmpty())
+		{
+			return 0.0f;
+		}
+
+		float dx = max.x - min.x;
+		float dy = max.y - min.y;
+		float dz = max.z - min.z;
+		return 2.0f * (dx * dy + dy * dz + dz * dx);
+	}
+
+	MetalAABB TransformAABB(const MetalAABB& local, const mat4f& world)
+	{
+		/* Arvo: new center is the transformed center, new extents are |R| * extents*/
+		vec3f c = local.Center();
+		vec3f e = local.Extents();
+		MetalAABB result;
+		float center[3];
+		float extent[3];
+
+		for (int i = 0; i < 3; i++)
+		{
+			const vec4f& r = world.rows[i];
+			center[i] = r.x * c.x + r.y * c.y + r.z * c.z + r.w;
+			extent[i] = std::fabs(r.x) * e.x + std::fabs(r.y) * e.y + std::fabs(r.z) * e.z;
+		}
+
+		result.min = vec3f(center[0] - extent[0], center[1] - extent[1], center[2] - extent[2]);
+		result.max = vec3f(center[0] + extent[0], center[1] + extent[1], center[2] + extent[2]);
+		return result;
+	}
+
+	template<typename T> struct MetalTraversalStack
+	{
+		T				local[BVH_STACK_SIZE];
+		std::vector<T>	spill;
+		DWord			top = 0;
+
+		bool IsEmpty() const { return top == 0; }
+
+		void Push(const T& entry)
+		{
+			if (top < BVH_STACK_SIZE)
+			{
+				local[top++] = entry;
+				return;
+			}
+			spill.push_back(entry);
+		}
+
+		/* Entries only spill once local is full, so the newest ones are always in spill*/
+		T Pop()
+		{
+			if (!spill.empty())
+			{
+				T entry = spill.back();
+				spill.pop_back();
+				return entry;
+			}
+			return local[--top];
+		}
+	};
+
+	static float AxisOf(const vec3f& v, int axis)
+	{
+		return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+	}
+
+	void MetalBvh::Build(const std::vector<MetalAABB>& bounds)
+	{
+		objectbounds = bounds;
+		Rebuild();
+	}
+
+	void MetalBvh::Rebuild()
+	{
+		DWord count = static_cast<DWord>(objectbounds.size());
+
+		nodes.clear();
+		primitives.resize(count);
+		objectnode.assign(count, BVH_INVALID);
+		objectslot.assign(count, 0);
+		isdirty.assign(count, 0);
+		dirty.clear();
+
+		if (count == 0)
+		{
+			return;
+		}
+
+		std::vector<vec3f> centroids(count);
+		for (DWord i = 0; i < count; i++)
+		{
+			primitives[i] = i;
+			centroids[i] = objectbounds[i].Center();
+		}
+
+		/* Build a binary SAH tree first, then fold it into 4-wide nodes*/
+		std::vector<BuildNode> build;
+		build.reserve(count * 2);
+		DWord root = BuildRecursive(build, centroids, 0, count);
+
+		nodes.reserve(count / 2 + 1);
+		if (build[root].count > 0)
+		{
+			/* Tiny scene, the root is a single leaf*/
+			nodes.emplace_back();
+			MetalBvhNode& node = nodes.back();
+			for (DWord i = 0; i < BVH_WIDTH; i++)
+			{
+				SetSlot(node, i, MetalAABB());
+				node.child[i] = BVH_INVALID;
+				node.count[i] = 0;
+			}
+			SetSlot(node, 0, build[root].bounds);
+			node.child[0] = build[root].first;
+			node.count[0] = static_cast<Byte>(build[root].count);
+			node.parent = BVH_INVALID;
+			node.parentslot = 0;
+
+			for (DWord i = 0; i < build[root].count; i++)
+			{
+				objectnode[primitives[build[root].first + i]] = 0;
+				objectslot[primitives[build[root].first + i]] = 0;
+			}
+			return;
+		}
+
+		Collapse(build, root, BVH_INVALID, 0);
+	}
+
+	DWord MetalBvh::BuildRecursive(std::vector<BuildNode>& build, const std::vector<vec3f>& centroids, DWord first, DWord count)
+	{
+		DWord index = static_cast<DWord>(build.size());
+		build.emplace_back();
+
+		MetalAABB bounds;
+		MetalAABB centroidbounds;
+		for (DWord i = first; i < first + count; i++)
+		{
+			bounds.Grow(objectbounds[primitives[i]]);
+			centroidbounds.Grow(centroids[primitives[i]]);
+		}
+
+		build[index].bounds = bounds;
+		build[index].left = BVH_INVALID;
+		build[index].right = BVH_INVALID;
+		build[index].first = first;
+		build[index].count = count;
+
+		if (count <= 1)
+		{
+			return index;
+		}
+
+		/* Split on the axis where the centroids are spread out the most*/
+		vec3f spread(centroidbounds.max.x - centroidbounds.min.x, centroidbounds.max.y - centroidbounds.min.y, centroidbounds.max.z - centroidbounds.min.z);
+		int axis = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+		float axismin = AxisOf(centroidbounds.min, axis);
+		float axisspread = AxisOf(spread, axis);
+
+		DWord split = BVH_INVALID;
+		float bestcost = 1e30f;
+
+		if (axisspread > 1e-6f)
+		{
+			MetalAABB binbounds[BVH_SAH_BINS];
+			DWord bincount[BVH_SAH_BINS] = {};
+			float scale = static_cast<float>(BVH_SAH_BINS) * (1.0f - 1e-5f) / axisspread;
+
+			for (DWord i = first; i < first + count; i++)
+			{
+				DWord bin = static_cast<DWord>((AxisOf(centroids[primitives[i]], axis) - axismin) * scale);
+				bincount[bin]++;
+				binbounds[bin].Grow(objectbounds[primitives[i]]);
+			}
+
+			/* Sweep from the right to get the cost of every right side, then from the left*/
+			float rightarea[BVH_SAH_BINS];
+			DWord rightcount[BVH_SAH_BINS];
+			MetalAABB accumulated;
+			DWord accumulatedcount = 0;
+			for (DWord i = BVH_SAH_BINS - 1; i > 0; i--)
+			{
+				accumulated.Grow(binbounds[i]);
+				accumulatedcount += bincount[i];
+				rightarea[i] = accumulated.SurfaceArea();
+				rightcount[i] = accumulatedcount;
+			}
+
+			accumulated = MetalAABB();
+			accumulatedcount = 0;
+			for (DWord i = 0; i < BVH_SAH_BINS - 1; i++)
+			{
+				accumulated.Grow(binbounds[i]);
+				accumulatedcount += bincount[i];
+
+				if (accumulatedcount == 0 || rightcount[i + 1] == 0)
+				{
+					continue;
+				}
+
+				float cost = accumulated.SurfaceArea() * accumulatedcount + rightarea[i + 1] * rightcount[i + 1];
+				if (cost < bestcost)
+				{
+					bestcost = cost;
+					split = i;
+				}
+			}
+		}
+
+		float area = bounds.SurfaceArea();
+		float leafcost = SAH_INTERSECT_COST * count;
+		float splitcost = area > 0.0f ? SAH_TRAVERSAL_COST + SAH_INTERSECT_COST * bestcost / area : leafcost;
+
+		if (count <= BVH_MAX_LEAF_SIZE && (split == BVH_INVALID || splitcost >= leafcost))
+		{
+			return index;
+		}
+
+		DWord middle;
+		if (split != BVH_INVALID)
+		{
+			float scale = static_cast<float>(BVH_SAH_BINS) * (1.0f - 1e-5f) / axisspread;
+			DWord* partition = std::partition(primitives.data() + first, primitives.data() + first + count, [&](DWord object)
+			{
+				return static_cast<DWord>((AxisOf(centroids[object], axis) - axismin) * scale) <= split;
+			});
+			middle = static_cast<DWord>(partition - primitives.data());
+		}
+		else
+		{
+			/* All centroids on top of each other, just cut the list in half*/
+			middle = first + count / 2;
+		}
+
+		if (middle == first || middle == first + count)
+		{
+			middle = first + count / 2;
+			std::nth_element(primitives.data() + first, primitives.data() + middle, primitives.data() + first + count, [&](DWord a, DWord b)
+			{
+				return AxisOf(centroids[a], axis) < AxisOf(centroids[b], axis);
+			});
+		}
+
+		DWord left = BuildRecursive(build, centroids, first, middle - first);
+		DWord right = BuildRecursive(build, centroids, middle, first + count - middle);
+		build[index].left = left;
+		build[index].right = right;
+		build[index].count = 0;
+		return index;
+	}
+
+	DWord MetalBvh::Collapse(const std::vector<BuildNode>& build, DWord binary, DWord parent, DWord parentslot)
+	{
+		/* Open up the biggest inner child until we have four children (or only leaves left)*/
+		DWord children[BVH_WIDTH] = { build[binary].left, build[binary].right };
+		DWord childcount = 2;
+
+		while (childcount < BVH_WIDTH)
+		{
+			int best = -1;
+			float bestarea = -1.0f;
+			for (DWord i = 0; i < childcount; i++)
+			{
+				const BuildNode& c = build[children[i]];
+				if (c.count == 0 && c.bounds.SurfaceArea() > bestarea)
+				{
+					bestarea = c.bounds.SurfaceArea();
+					best = static_cast<int>(i);
+				}
+			}
+
+			if (best < 0)
+			{
+				break;
+			}
+
+			DWord opened = children[best];
+			children[best] = build[opened].left;
+			children[childcount++] = build[opened].right;
+		}
+
+		DWord index = static_cast<DWord>(nodes.size());
+		nodes.emplace_back();
+		nodes[index].parent = parent;
+		nodes[index].parentslot = parentslot;
+
+		for (DWord i = 0; i < BVH_WIDTH; i++)
+		{
+			MetalBvhNode& node = nodes[index];
+			if (i >= childcount)
+			{
+				SetSlot(node, i, MetalAABB());
+				node.child[i] = BVH_INVALID;
+				node.count[i] = 0;
+				continue;
+			}
+
+			const BuildNode& c = build[children[i]];
+			SetSlot(node, i, c.bounds);
+
+			if (c.count > 0)
+			{
+				node.child[i] = c.first;
+				node.count[i] = static_cast<Byte>(c.count);
+				for (DWord p = 0; p < c.count; p++)
+				{
+					objectnode[primitives[c.first + p]] = index;
+					objectslot[primitives[c.first + p]] = static_cast<Byte>(i);
+				}
+			}
+			else
+			{
+				/* nodes may reallocate in here, so don't hold on to the reference across the call*/
+				node.count[i] = 0;
+				DWord child = Collapse(build, children[i], index, i);
+				nodes[index].child[i] = child;
+			}
+		}
+
+		return index;
+	}
+
+	void MetalBvh::SetSlot(MetalBvhNode& node, DWord slot, const MetalAABB& bounds)
+	{
+		node.minx[slot] = bounds.min.x;
+		node.miny[slot] = bounds.min.y;
+		node.minz[slot] = bounds.min.z;
+		node.maxx[slot] = bounds.max.x;
+		node.maxy[slot] = bounds.max.y;
+		node.maxz[slot] = bounds.max.z;
+	}
+
+	MetalAABB MetalBvh::NodeBounds(const MetalBvhNode& node) const
+	{
+		MetalAABB bounds;
+		for (DWord i = 0; i < BVH_WIDTH; i++)
+		{
+			bounds.Grow(MetalAABB(vec3f(node.minx[i], node.miny[i], node.minz[i]), vec3f(node.maxx[i], node.maxy[i], node.maxz[i])));
+		}
+		return bounds;
+	}
+
+	void MetalBvh::UpdateObject(DWord object, const MetalAABB& bounds)
+	{
+		objectbounds[object] = bounds;
+		if (!isdirty[object])
+		{
+			isdirty[object] = 1;
+			dirty.push_back(object);
+		}
+	}
+
+	void MetalBvh::UpdateObject(DWord object, const trans3f& transform, const MetalAABB& localbounds)
+	{
+		UpdateObject(object, TransformAABB(localbounds, MakeTransformMatrix(transform)));
+	}
+
+	DWord MetalBvh::Refit()
+	{
+		DWord touched = 0;
+
+		for (DWord object : dirty)
+		{
+			isdirty[object] = 0;
+
+			DWord nodeindex = objectnode[object];
+			DWord slot = objectslot[object];
+			MetalBvhNode& leafnode = nodes[nodeindex];
+
+			/* Leaf slot box = union of all objects in it*/
+			MetalAABB leafbounds;
+			for (DWord i = 0; i < leafnode.count[slot]; i++)
+			{
+				leafbounds.Grow(objectbounds[primitives[leafnode.child[slot] + i]]);
+			}
+			SetSlot(leafnode, slot, leafbounds);
+			touched++;
+
+			/* Walk up until a parent's box comes out the same as before*/
+			while (nodes[nodeindex].parent != BVH_INVALID)
+			{
+				MetalBvhNode& node = nodes[nodeindex];
+				MetalBvhNode& parent = nodes[node.parent];
+				DWord parentslot = node.parentslot;
+				MetalAABB bounds = NodeBounds(node);
+
+				if (parent.minx[parentslot] == bounds.min.x && parent.miny[parentslot] == bounds.min.y && parent.minz[parentslot] == bounds.min.z &&
+					parent.maxx[parentslot] == bounds.max.x && parent.maxy[parentslot] == bounds.max.y && parent.maxz[parentslot] == bounds.max.z)
+				{
+					break;
+				}
+
+				SetSlot(parent, parentslot, bounds);
+				nodeindex = node.parent;
+				touched++;
+			}
+		}
+
+		dirty.clear();
+		return touched;
+	}
+
+	/* Ray against the four children, returns a hit mask and the entry distance per child*/
+	static unsigned IntersectRay4(const MetalBvhNode& node, const vec3f& origin, const vec3f& inverse, float maxdistance, float entry[BVH_WIDTH])
+	{
+		/* Pick the near and far slab per axis from the ray's sign, inverted empty slots then always miss*/
+		const float* nearx = inverse.x >= 0.0f ? node.minx : node.maxx;
+		const float* farx = inverse.x >= 0.0f ? node.maxx : node.minx;
+		const float* neary = inverse.y >= 0.0f ? node.miny : node.maxy;
+		const float* fary = inverse.y >= 0.0f ? node.maxy : node.miny;
+		const float* nearz = inverse.z >= 0.0f ? node.minz : node.maxz;
+		const float* farz = inverse.z >= 0.0f ? node.maxz : node.minz;
+
+#if defined(METAL_BVH_SSE)
+		__m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+		__m128 ix = _mm_set1_ps(inverse.x), iy = _mm_set1_ps(inverse.y), iz = _mm_set1_ps(inverse.z);
+
+		__m128 tnear = _mm_max_ps(
+			_mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(nearx), ox), ix), _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(neary), oy), iy)),
+			_mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(nearz), oz), iz), _mm_setzero_ps()));
+		__m128 tfar = _mm_min_ps(
+			_mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(farx), ox), ix), _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(fary), oy), iy)),
+			_mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(farz), oz), iz), _mm_set1_ps(maxdistance)));
+
+		_mm_storeu_ps(entry, tnear);
+		return static_cast<unsigned>(_mm_movemask_ps(_mm_cmple_ps(tnear, tfar)));
+#else
+		unsigned mask = 0;
+		for (DWord i = 0; i < BVH_WIDTH; i++)
+		{
+			float tnear = std::max(std::max((nearx[i] - origin.x) * inverse.x, (neary[i] - origin.y) * inverse.y), std::max((nearz[i] - origin.z) * inverse.z, 0.0f));
+			float tfar = std::min(std::min((farx[i] - origin.x) * inverse.x, (fary[i] - origin.y) * inverse.y), std::min((farz[i] - origin.z) * inverse.z, maxdistance));
+			entry[i] = tnear;
+			mask |= (tnear <= tfar ? 1u : 0u) << i;
+		}
+		return mask;
+#endif
+	}
+
+	static unsigned Overlap4(const MetalBvhNode& node, const MetalAABB& box)
+	{
+#if defined(METAL_BVH_SSE)
+		__m128 a = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(node.minx), _mm_set1_ps(box.max.x)), _mm_cmpge_ps(_mm_loadu_ps(node.maxx), _mm_set1_ps(box.min.x)));
+		__m128 b = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(node.miny), _mm_set1_ps(box.max.y)), _mm_cmpge_ps(_mm_loadu_ps(node.maxy), _mm_set1_ps(box.min.y)));
+		__m128 c = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(node.minz), _mm_set1_ps(box.max.z)), _mm_cmpge_ps(_mm_loadu_ps(node.maxz), _mm_set1_ps(box.min.z)));
+		return static_cast<unsigned>(_mm_movemask_ps(_mm_and_ps(a, _mm_and_ps(b, c))));
+#else
+		unsigned mask = 0;
+		for (DWord i = 0; i < BVH_WIDTH; i++)
+		{
+			bool overlap = node.minx[i] <= box.max.x && node.maxx[i] >= box.min.x &&
+				node.miny[i] <= box.max.y && node.maxy[i] >= box.min.y &&
+				node.minz[i] <= box.max.z && node.maxz[i] >= box.min.z;
+			mask |= (overlap ? 1u : 0u) << i;
+		}
+		return mask;
+#endif
+	}
+
+	/* Frustum against the four children, fills which ones touch it and which are fully inside*/
+	static void Frustum4(const MetalBvhNode& node, const MetalFrustum& frustum, unsigned& touching, unsigned& inside)
+	{
+#if defined(METAL_BVH_SSE)
+		__m128 half = _mm_set1_ps(0.5f);
+		__m128 mnx = _mm_loadu_ps(node.minx), mny = _mm_loadu_ps(node.miny), mnz = _mm_loadu_ps(node.minz);
+		__m128 mxx = _mm_loadu_ps(node.maxx), mxy = _mm_loadu_ps(node.maxy), mxz = _mm_loadu_ps(node.maxz);
+		__m128 cx = _mm_mul_ps(_mm_add_ps(mnx, mxx), half), cy = _mm_mul_ps(_mm_add_ps(mny, mxy), half), cz = _mm_mul_ps(_mm_add_ps(mnz, mxz), half);
+		__m128 ex = _mm_mul_ps(_mm_sub_ps(mxx, mnx), half), ey = _mm_mul_ps(_mm_sub_ps(mxy, mny), half), ez = _mm_mul_ps(_mm_sub_ps(mxz, mnz), half);
+		__m128 out = _mm_setzero_ps();
+		__m128 partial = _mm_setzero_ps();
+
+		for (int p = 0; p < 6; p++)
+		{
+			const vec4f& plane = frustum.planes[p];
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), cx), _mm_mul_ps(_mm_set1_ps(plane.y), cy)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), cz), _mm_set1_ps(plane.w)));
+			__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::fabs(plane.x)), ex), _mm_mul_ps(_mm_set1_ps(std::fabs(plane.y)), ey)),
+				_mm_mul_ps(_mm_set1_ps(std::fabs(plane.z)), ez));
+			out = _mm_or_ps(out, _mm_cmplt_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+			partial = _mm_or_ps(partial, _mm_cmplt_ps(_mm_sub_ps(d, r), _mm_setzero_ps()));
+		}
+
+		unsigned outside = static_cast<unsigned>(_mm_movemask_ps(out));
+		touching = ~outside & 0xF;
+		inside = touching & ~static_cast<unsigned>(_mm_movemask_ps(partial)) & 0xF;
+#else
+		touching = 0;
+		inside = 0;
+		for (DWord i = 0; i < BVH_WIDTH; i++)
+		{
+			float cx = (node.minx[i] + node.maxx[i]) * 0.5f, ex = (node.maxx[i] - node.minx[i]) * 0.5f;
+			float cy = (node.miny[i] + node.maxy[i]) * 0.5f, ey = (node.maxy[i] - node.miny[i]) * 0.5f;
+			float cz = (node.minz[i] + node.maxz[i]) * 0.5f, ez = (node.maxz[i] - node.minz[i]) * 0.5f;
+			bool outside = false;
+			bool partial = false;
+
+			for (int p = 0; p < 6; p++)
+			{
+				const vec4f& plane = frustum.planes[p];
+				float d = plane.x * cx + plane.y * cy + plane.z * cz + plane.w;
+				float r = std::fabs(plane.x) * ex + std::fabs(plane.y) * ey + std::fabs(plane.z) * ez;
+				outside |= d + r < 0.0f;
+				partial |= d - r < 0.0f;
+			}
+
+			touching |= (outside ? 0u : 1u) << i;
+			inside |= (outside || partial ? 0u : 1u) << i;
+		}
+#endif
+	}
+
+	static bool RayBox(const MetalAABB& box, const vec3f& origin, const vec3f& inverse, float maxdistance, float& distance)
+	{
+		float tx0 = (box.min.x - origin.x) * inverse.x, tx1 = (box.max.x - origin.x) * inverse.x;
+		float ty0 = (box.min.y - origin.y) * inverse.y, ty1 = (box.max.y - origin.y) * inverse.y;
+		float tz0 = (box.min.z - origin.z) * inverse.z, tz1 = (box.max.z - origin.z) * inverse.z;
+		float tnear = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::max(std::min(tz0, tz1), 0.0f));
+		float tfar = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::min(std::max(tz0, tz1), maxdistance));
+		distance = tnear;
+		return tnear <= tfar;
+	}
+
+	static float SafeInverse(float v)
+	{
+		/* Keep the sign of zero components so the slab selection above still works*/
+		if (std::fabs(v) < 1e-30f)
+		{
+			return std::signbit(v) ? -1e30f : 1e30f;
+		}
+		return 1.0f / v;
+	}
+
+	bool MetalBvh::RayCast(const vec3f& origin, const vec3f& direction, float maxdistance, MetalRayHit& hit,
+		MetalRayFilter filter, void* userdata) const
+	{
+		hit = MetalRayHit();
+		if (nodes.empty())
+		{
+			return false;
+		}
+
+		vec3f inverse(SafeInverse(direction.x), SafeInverse(direction.y), SafeInverse(direction.z));
+		float closest = maxdistance;
+
+		struct StackEntry
+		{
+			DWord node;
+			float distance;
+		};
+		MetalTraversalStack<StackEntry> stack;
+		stack.Push({ 0, 0.0f });
+
+		while (!stack.IsEmpty())
+		{
+			StackEntry entry = stack.Pop();
+			if (entry.distance > closest)
+			{
+				continue;
+			}
+
+			const MetalBvhNode& node = nodes[entry.node];
+			float distances[BVH_WIDTH];
+			unsigned mask = IntersectRay4(node, origin, inverse, closest, distances);
+
+			/* Push the inner children far to near so the nearest is popped first*/
+			DWord order[BVH_WIDTH];
+			DWord ordercount = 0;
+
+			for (DWord i = 0; i < BVH_WIDTH; i++)
+			{
+				if (!(mask & (1u << i)))
+				{
+					continue;
+				}
+
+				if (node.count[i] > 0)
+				{
+					for (DWord p = 0; p < node.count[i]; p++)
+					{
+						DWord object = primitives[node.child[i] + p];
+						float distance;
+						if (!RayBox(objectbounds[object], origin, inverse, closest, distance))
+						{
+							continue;
+						}
+
+						if (filter != nullptr)
+						{
+							distance = filter(object, origin, direction, userdata);
+							if (distance < 0.0f || distance > closest)
+							{
+								continue;
+							}
+						}
+
+						closest = distance;
+						hit.object = object;
+						hit.distance = distance;
+					}
+				}
+				else
+				{
+					DWord slot = ordercount++;
+					while (slot > 0 && distances[order[slot - 1]] < distances[i])
+					{
+						order[slot] = order[slot - 1];
+						slot--;
+					}
+					order[slot] = i;
+				}
+			}
+
+			for (DWord i = 0; i < ordercount; i++)
+			{
+				stack.Push({ node.child[order[i]], distances[order[i]] });
+			}
+		}
+
+		return hit.object != BVH_INVALID;
+	}
+
+	DWord MetalBvh::OverlapAABB(const MetalAABB& box, std::vector<DWord>& results) const
+	{
+		if (nodes.empty())
+		{
+			return 0;
+		}
+
+		DWord before = static_cast<DWord>(results.size());
+		MetalTraversalStack<DWord> stack;
+		stack.Push(0);
+
+		while (!stack.IsEmpty())
+		{
+			const MetalBvhNode& node = nodes[stack.Pop()];
+			unsigned mask = Overlap4(node, box);
+
+			for (DWord i = 0; i < BVH_WIDTH; i++)
+			{
+				if (!(mask & (1u << i)))
+				{
+					continue;
+				}
+
+				if (node.count[i] == 0)
+				{
+					stack.Push(node.child[i]);
+					continue;
+				}
+
+				for (DWord p = 0; p < node.count[i]; p++)
+				{
+					DWord object = primitives[node.child[i] + p];
+					const MetalAABB& b = objectbounds[object];
+					if (b.min.x <= box.max.x && b.max.x >= box.min.x && b.min.y <= box.max.y && b.max.y >= box.min.y &&
+						b.min.z <= box.max.z && b.max.z >= box.min.z)
+					{
+						results.push_back(object);
+					}
+				}
+			}
+		}
+
+		return static_cast<DWord>(results.size()) - before;
+	}
+
+	void MetalBvh::AppendSubtree(DWord nodeindex, std::vector<DWord>& results) const
+	{
+		const MetalBvhNode& node = nodes[nodeindex];
+		for (DWord i = 0; i < BVH_WIDTH; i++)
+		{
+			if (node.count[i] > 0)
+			{
+				results.insert(results.end(), primitives.begin() + node.child[i], primitives.begin() + node.child[i] + node.count[i]);
+			}
+			else if (node.child[i] != BVH_INVALID)
+			{
+				AppendSubtree(node.child[i], results);
+			}
+		}
+	}
+
+	DWord MetalBvh::FrustumQuery(const MetalFrustum& frustum, std::vector<DWord>& results) const
+	{
+		if (nodes.empty())
+		{
+			return 0;
+		}
+
+		DWord before = static_cast<DWord>(results.size());
+		MetalTraversalStack<DWord> stack;
+		stack.Push(0);
+
+		while (!stack.IsEmpty())
+		{
+			const MetalBvhNode& node = nodes[stack.Pop()];
+			unsigned touching, inside;
+			Frustum4(node, frustum, touching, inside);
+
+			for (DWord i = 0; i < BVH_WIDTH; i++)
+			{
+				if (!(touching & (1u << i)))
+				{
+					continue;
+				}
+
+				if (node.count[i] > 0)
+				{
+					/* Leaf boxes are loose when they hold several objects, the culling stage will tighten it up*/
+					results.insert(results.end(), primitives.begin() + node.child[i], primitives.begin() + node.child[i] + node.count[i]);
+				}
+				else if (inside & (1u << i))
+				{
+					AppendSubtree(node.child[i], results);
+				}
+				else
+				{
+					stack.Push(node.child[i]);
+				}
+			}
+		}
+
+		return static_cast<DWord>(results.size()) - before;
+	}
+}
@@ -0,0 +1,259 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine clustered lighting (cluster grid, light assignment, CPU reference of cluster_lights.comp)
+// ------------------------------------------------------
+
+#include "headers/MClusteredLighting.hpp"
+#include "headers/MJobSystem.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+	#include <immintrin.h>
+#endif
+
+namespace engine::lighting
+{
+	using engine::jobs::ParallelFor;
+
+	/* Padding entries sit this far away with no radius so they never touch a cluster*/
+	static constexpr float PADDING_DISTANCE = 1e18f;
+
+	/* The lights that reach one depth slice, in view space as structure-of-arrays*/
+	struct MetalSliceLights
+	{
+		std::vector<float>	x;
+		std::vector<float>	y;
+		std::vector<float>	z;
+		std::vector<float>	radius;
+		std::vector<DWord>	index;
+	};
+
+	static float GetSliceDepth(const MetalClusterGrid& grid, DWord slice)
+	{
+		return grid.nearz * std::pow(grid.farz / grid.nearz, static_cast<float>(slice) / static_cast<float>(CLUSTER_GRID_Z));
+	}
+
+	DWord GetClusterSlice(const MetalClusterGrid& grid, float viewz)
+	{
+		if (viewz <= grid.nearz)
+		{
+			return 0;
+		}
+
+		float slice = std::log(viewz / grid.nearz) / std::log(grid.farz / grid.nearz) * static_cast<float>(CLUSTER_GRID_Z);
+		return std::min(static_cast<DWord>(slice), CLUSTER_GRID_Z - 1);
+	}
+
+	void GetClusterBounds(const MetalClusterGrid& grid, DWord x, DWord y, DWord z, vec3f& boxmin, vec3f& boxmax)
+	{
+		float z0 = GetSliceDepth(grid, z);
+		float z1 = GetSliceDepth(grid, z + 1);
+
+		/* Screen edges in NDC over the projection scale are view x (or y) per unit of depth*/
+		float ax = (2.0f * static_cast<float>(x) / CLUSTER_GRID_X - 1.0f) / grid.projx;
+		float bx = (2.0f * static_cast<float>(x + 1) / CLUSTER_GRID_X - 1.0f) / grid.projx;
+		float ay = (2.0f * static_cast<float>(y) / CLUSTER_GRID_Y - 1.0f) / grid.projy;
+		float by = (2.0f * static_cast<float>(y + 1) / CLUSTER_GRID_Y - 1.0f) / grid.projy;
+
+		/* The piece of frustum widens with depth, the box has to hold both of its ends*/
+		boxmin.x = std::min(std::min(ax * z0, ax * z1), std::min(bx * z0, bx * z1));
+		boxmax.x = std::max(std::max(ax * z0, ax * z1), std::max(bx * z0, bx * z1));
+		boxmin.y = std::min(std::min(ay * z0, ay * z1), std::min(by * z0, by * z1));
+		boxmax.y = std::max(std::max(ay * z0, ay * z1), std::max(by * z0, by * z1));
+		boxmin.z = z0;
+		boxmax.z = z1;
+	}
+
+	/*
+		A sphere touches a box when the distance from its center to the closest point of the box
+		is at most its radius. Each of these writes the indices of the lights that touch into out
+		and returns how many there were, lights stay in the order they are in.
+	*/
+
+#if defined(__AVX512F__)
+	static DWord TestClusterLights(const MetalSliceLights& l, DWord padded, const vec3f& boxmin, const vec3f& boxmax, DWord* out)
+	{
+		const __m512 zero = _mm512_setzero_ps();
+		__m512 minx = _mm512_set1_ps(boxmin.x), miny = _mm512_set1_ps(boxmin.y), minz = _mm512_set1_ps(boxmin.z);
+		__m512 maxx = _mm512_set1_ps(boxmax.x), maxy = _mm512_set1_ps(boxmax.y), maxz = _mm512_set1_ps(boxmax.z);
+		DWord written = 0;
+
+		for (DWord i = 0; i < padded; i += 16)
+		{
+			__m512 px = _mm512_loadu_ps(&l.x[i]);
+			__m512 py = _mm512_loadu_ps(&l.y[i]);
+			__m512 pz = _mm512_loadu_ps(&l.z[i]);
+			__m512 r = _mm512_loadu_ps(&l.radius[i]);
+
+			__m512 dx = _mm512_max_ps(_mm512_max_ps(_mm512_sub_ps(minx, px), _mm512_sub_ps(px, maxx)), zero);
+			__m512 dy = _mm512_max_ps(_mm512_max_ps(_mm512_sub_ps(miny, py), _mm512_sub_ps(py, maxy)), zero);
+			__m512 dz = _mm512_max_ps(_mm512_max_ps(_mm512_sub_ps(minz, pz), _mm512_sub_ps(pz, maxz)), zero);
+			__m512 distance = _mm512_fmadd_ps(dx, dx, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dz, dz)));
+			__mmask16 inside = _mm512_cmp_ps_mask(distance, _mm512_mul_ps(r, r), _CMP_LE_OQ);
+
+			__m512i indices = _mm512_loadu_si512(&l.index[i]);
+			_mm512_mask_compressstoreu_epi32(out + written, inside, indices);
+			written += static_cast<DWord>(std::popcount(static_cast<unsigned>(inside)));
+		}
+		return written;
+	}
+#elif defined(__AVX2__)
+	static DWord TestClusterLights(const MetalSliceLights& l, DWord padded, const vec3f& boxmin, const vec3f& boxmax, DWord* out)
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		__m256 minx = _mm256_set1_ps(boxmin.x), miny = _mm256_set1_ps(boxmin.y), minz = _mm256_set1_ps(boxmin.z);
+		__m256 maxx = _mm256_set1_ps(boxmax.x), maxy = _mm256_set1_ps(boxmax.y), maxz = _mm256_set1_ps(boxmax.z);
+		DWord written = 0;
+
+		for (DWord i = 0; i < padded; i += 8)
+		{
+			__m256 px = _mm256_loadu_ps(&l.x[i]);
+			__m256 py = _mm256_loadu_ps(&l.y[i]);
+			__m256 pz = _mm256_loadu_ps(&l.z[i]);
+			__m256 r = _mm256_loadu_ps(&l.radius[i]);
+
+			__m256 dx = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(minx, px), _mm256_sub_ps(px, maxx)), zero);
+			__m256 dy = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(miny, py), _mm256_sub_ps(py, maxy)), zero);
+			__m256 dz = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(minz, pz), _mm256_sub_ps(pz, maxz)), zero);
+			__m256 distance = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+			__m256 inside = _mm256_cmp_ps(distance, _mm256_mul_ps(r, r), _CMP_LE_OQ);
+
+			/* Walk the set bits of the mask to compact the indices*/
+			unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(inside));
+			while (mask != 0)
+			{
+				out[written++] = l.index[i + static_cast<DWord>(std::countr_zero(mask))];
+				mask &= mask - 1;
+			}
+		}
+		return written;
+	}
+#else
+	static DWord TestClusterLights(const MetalSliceLights& l, DWord padded, const vec3f& boxmin, const vec3f& boxmax, DWord* out)
+	{
+		DWord written = 0;
+		for (DWord i = 0; i < padded; i++)
+		{
+			float dx = std::max(std::max(boxmin.x - l.x[i], l.x[i] - boxmax.x), 0.0f);
+			float dy = std::max(std::max(boxmin.y - l.y[i], l.y[i] - boxmax.y), 0.0f);
+			float dz = std::max(std::max(boxmin.z - l.z[i], l.z[i] - boxmax.z), 0.0f);
+
+			out[written] = l.index[i];
+			written += dx * dx + dy * dy + dz * dz <= l.radius[i] * l.radius[i] ? 1 : 0;
+		}
+		return written;
+	}
+#endif
+
+	DWord AssignLights(const MetalClusterGrid& grid, const MetalPointLight* lights, DWord count, MetalClusterLightList& result)
+	{
+		/* Into view space once up front, every slice shares it*/
+		std::vector<float> viewx(count), viewy(count), viewz(count), radius(count);
+		for (DWord i = 0; i < count; i++)
+		{
+			const vec4f& light = lights[i].positionradius;
+			vec4f view = grid.view.Transform(vec3f(light.x, light.y, light.z));
+			viewx[i] = view.x;
+			viewy[i] = view.y;
+			viewz[i] = view.z;
+			radius[i] = light.w;
+		}
+
+		/* Every slice fills its own list, then they are stitched together in order.
+			Keeps the result deterministic no matter which worker ran what.
+		*/
+		std::vector<std::vector<DWord>> sliceindices(CLUSTER_GRID_Z);
+		std::vector<DWord> slicedropped(CLUSTER_GRID_Z, 0);
+		result.clusters.assign(CLUSTER_COUNT, MetalClusterRange{ 0, 0 });
+
+		ParallelFor(CLUSTER_GRID_Z, 1, [&](DWord first, DWord last)
+		{
+			MetalSliceLights Slice;
+			std::vector<DWord> hits;
+
+			for (DWord z = first; z < last; z++)
+			{
+				float z0 = GetSliceDepth(grid, z);
+				float z1 = GetSliceDepth(grid, z + 1);
+
+				/* Most lights miss most slices, drop them before the per cluster tests*/
+				Slice.x.clear();
+				Slice.y.clear();
+				Slice.z.clear();
+				Slice.radius.clear();
+				Slice.index.clear();
+				for (DWord i = 0; i < count; i++)
+				{
+					if (radius[i] > 0.0f && viewz[i] + radius[i] >= z0 && viewz[i] - radius[i] <= z1)
+					{
+						Slice.x.push_back(viewx[i]);
+						Slice.y.push_back(viewy[i]);
+						Slice.z.push_back(viewz[i]);
+						Slice.radius.push_back(radius[i]);
+						Slice.index.push_back(i);
+					}
+				}
+
+				std::vector<DWord>& indices = sliceindices[z];
+				indices.clear();
+				if (Slice.index.empty())
+				{
+					continue;
+				}
+
+				DWord padded = (static_cast<DWord>(Slice.index.size()) + CLUSTER_LIGHTS_ALIGNMENT - 1) / CLUSTER_LIGHTS_ALIGNMENT * CLUSTER_LIGHTS_ALIGNMENT;
+				Slice.x.resize(padded, PADDING_DISTANCE);
+				Slice.y.resize(padded, PADDING_DISTANCE);
+				Slice.z.resize(padded, PADDING_DISTANCE);
+				Slice.radius.resize(padded, 0.0f);
+				Slice.index.resize(padded, 0);
+				hits.resize(padded);
+
+				for (DWord y = 0; y < CLUSTER_GRID_Y; y++)
+				{
+					for (DWord x = 0; x < CLUSTER_GRID_X; x++)
+					{
+						vec3f boxmin, boxmax;
+						GetClusterBounds(grid, x, y, z, boxmin, boxmax);
+
+						DWord found = TestClusterLights(Slice, padded, boxmin, boxmax, hits.data());
+						if (found > CLUSTER_MAX_LIGHTS)
+						{
+							slicedropped[z] += found - CLUSTER_MAX_LIGHTS;
+							found = CLUSTER_MAX_LIGHTS;
+						}
+
+						MetalClusterRange& range = result.clusters[x + CLUSTER_GRID_X * (y + CLUSTER_GRID_Y * z)];
+						range.offset = static_cast<DWord>(indices.size());
+						range.count = found;
+						indices.insert(indices.end(), hits.begin(), hits.begin() + found);
+					}
+				}
+			}
+		});
+
+		result.indices.clear();
+		result.dropped = 0;
+		for (DWord z = 0; z < CLUSTER_GRID_Z; z++)
+		{
+			DWord base = static_cast<DWord>(result.indices.size());
+			for (DWord cluster = z * CLUSTER_GRID_X * CLUSTER_GRID_Y; cluster < (z + 1) * CLUSTER_GRID_X * CLUSTER_GRID_Y; cluster++)
+			{
+				result.clusters[cluster].offset += base;
+			}
+
+			result.indices.insert(result.indices.end(), sliceindices[z].begin(), sliceindices[z].end());
+			result.dropped += slicedropped[z];
+		}
+
+		return static_cast<DWord>(result.indices.size());
+	}
+}
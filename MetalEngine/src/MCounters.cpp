@@ -0,0 +1,388 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine performance counters (named counters, frame time percentiles, CSV dumps)
+// ------------------------------------------------------
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+
+#include "headers/MCounters.h"
+#include "headers/MTypes.hpp"
+
+namespace engine::counters
+{
+	static constexpr usize COUNTER_NAME = 48;
+
+	/* One cache line each so threads bumping different counters don't fight*/
+	struct alignas(64) MetalCounter
+	{
+		std::atomic<long long>	value{ 0 };
+		long long				lastframe	= 0;	/* FRAME: value of the last finished frame*/
+		long long				interval	= 0;	/* FRAME: sum since the last CSV row*/
+		int						kind		= METAL_COUNTER_KIND_FRAME;
+		char					name[COUNTER_NAME] = {};
+	};
+
+	/* Sample window of a HISTOGRAM counter*/
+	struct MetalCounterWindow
+	{
+		std::atomic_flag	lock = ATOMIC_FLAG_INIT;
+		float				samples[METAL_COUNTER_WINDOW] = {};
+		DWord				count = 0;	/* Samples ever taken, the newest is at (count - 1) % window*/
+		double				last = 0.0;
+	};
+
+	static MetalCounter						m_counters[METAL_COUNTER_MAX];
+	static MetalCounterWindow*				m_windows[METAL_COUNTER_MAX] = {};
+	static std::atomic<DWord>				m_count{ 0 };
+	static std::mutex						m_registerlock;
+	static std::once_flag					m_builtins;
+
+	static FILE*							m_csv = nullptr;
+	static DWord							m_csvcounters = 0;
+	static DWord							m_csvinterval = 60;
+	static QWord							m_frame = 0;
+	static QWord							m_intervalframes = 0;
+	static std::chrono::steady_clock::time_point	m_framestart;
+	static std::chrono::steady_clock::time_point	m_start = std::chrono::steady_clock::now();
+
+	static void Lock(MetalCounterWindow* window)
+	{
+		while (window->lock.test_and_set(std::memory_order_acquire))
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	static void Unlock(MetalCounterWindow* window)
+	{
+		window->lock.clear(std::memory_order_release);
+	}
+
+	/* Caller holds m_registerlock*/
+	static DWord RegisterLocked(const char* name, int kind)
+	{
+		DWord count = m_count.load(std::memory_order_relaxed);
+		for (DWord i = 0; i < count; i++)
+		{
+			if (strncmp(m_counters[i].name, name, COUNTER_NAME - 1) == 0)
+			{
+				return m_counters[i].kind == kind ? i : METAL_COUNTER_INVALID;
+			}
+		}
+
+		if (count >= METAL_COUNTER_MAX || kind < METAL_COUNTER_KIND_FRAME || kind > METAL_COUNTER_KIND_HISTOGRAM)
+		{
+			return METAL_COUNTER_INVALID;
+		}
+
+		MetalCounter& counter = m_counters[count];
+		snprintf(counter.name, sizeof(counter.name), "%s", name);
+		counter.kind = kind;
+		if (kind == METAL_COUNTER_KIND_HISTOGRAM)
+		{
+			m_windows[count] = new MetalCounterWindow();
+		}
+
+		/* Publishes the name and window to readers that go by m_count*/
+		m_count.store(count + 1, std::memory_order_release);
+		return count;
+	}
+
+	/* The built-ins have fixed numbers, they are registered before anything else can be*/
+	static void RegisterBuiltins()
+	{
+		std::call_once(m_builtins, []()
+		{
+			static const struct { const char* name; int kind; } builtins[METAL_COUNTER_BUILTIN_COUNT] =
+			{
+				{ "frame_time_ms",		METAL_COUNTER_KIND_HISTOGRAM },
+				{ "queue_submits",		METAL_COUNTER_KIND_FRAME },
+				{ "draw_calls",			METAL_COUNTER_KIND_FRAME },
+				{ "pipeline_binds",		METAL_COUNTER_KIND_FRAME },
+				{ "descriptor_writes",	METAL_COUNTER_KIND_FRAME },
+				{ "bytes_uploaded",		METAL_COUNTER_KIND_FRAME },
+				{ "fence_wait_us",		METAL_COUNTER_KIND_HISTOGRAM },
+				{ "device_allocations",	METAL_COUNTER_KIND_TOTAL },
+				{ "device_bytes",		METAL_COUNTER_KIND_TOTAL },
+				{ "heap_usage",			METAL_COUNTER_KIND_GAUGE },
+				{ "heap_budget",		METAL_COUNTER_KIND_GAUGE },
+			};
+
+			std::lock_guard<std::mutex> guard(m_registerlock);
+			for (const auto& builtin : builtins)
+			{
+				RegisterLocked(builtin.name, builtin.kind);
+			}
+			m_framestart = std::chrono::steady_clock::now();
+		});
+	}
+
+	static bool IsValid(unsigned int counter)
+	{
+		RegisterBuiltins();
+		return counter < m_count.load(std::memory_order_acquire);
+	}
+
+	static double Percentile(DWord counter, double percentile, float* scratch)
+	{
+		MetalCounterWindow* window = m_windows[counter];
+		Lock(window);
+		DWord count = std::min<DWord>(window->count, METAL_COUNTER_WINDOW);
+		memcpy(scratch, window->samples, sizeof(float) * count);
+		Unlock(window);
+
+		if (count == 0)
+		{
+			return 0.0;
+		}
+
+		percentile = std::clamp(percentile, 0.0, 100.0);
+		DWord rank = static_cast<DWord>((percentile / 100.0) * (count - 1) + 0.5);
+		std::nth_element(scratch, scratch + rank, scratch + count);
+		return scratch[rank];
+	}
+
+	static void WriteCsvRow()
+	{
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+		fprintf(m_csv, "%llu,%.3f", static_cast<unsigned long long>(m_frame), seconds);
+
+		static float scratch[METAL_COUNTER_WINDOW];
+		for (DWord i = 0; i < m_csvcounters; i++)
+		{
+			MetalCounter& counter = m_counters[i];
+			switch (counter.kind)
+			{
+			case METAL_COUNTER_KIND_FRAME:
+				fprintf(m_csv, ",%.2f", m_intervalframes != 0 ? static_cast<double>(counter.interval) / m_intervalframes : 0.0);
+				break;
+
+			case METAL_COUNTER_KIND_HISTOGRAM:
+				fprintf(m_csv, ",%.3f,%.3f,%.3f,%.3f", Percentile(i, 50.0, scratch), Percentile(i, 95.0, scratch),
+					Percentile(i, 99.0, scratch), Percentile(i, 100.0, scratch));
+				break;
+
+			default:
+				fprintf(m_csv, ",%lld", counter.value.load(std::memory_order_relaxed));
+				break;
+			}
+		}
+		fputc('\n', m_csv);
+
+		/* Soak runs get killed instead of shut down, don't leave the last rows in a buffer*/
+		fflush(m_csv);
+	}
+}
+
+using namespace engine::counters;
+
+extern "C" unsigned int MetalCounterRegister(const char* name, int kind)
+{
+	RegisterBuiltins();
+	if (name == nullptr)
+	{
+		return METAL_COUNTER_INVALID;
+	}
+
+	std::lock_guard<std::mutex> guard(m_registerlock);
+	return RegisterLocked(name, kind);
+}
+
+extern "C" unsigned int MetalCounterFind(const char* name)
+{
+	RegisterBuiltins();
+	DWord count = m_count.load(std::memory_order_acquire);
+	for (DWord i = 0; name != nullptr && i < count; i++)
+	{
+		if (strncmp(m_counters[i].name, name, COUNTER_NAME - 1) == 0)
+		{
+			return i;
+		}
+	}
+	return METAL_COUNTER_INVALID;
+}
+
+extern "C" void MetalCounterAdd(unsigned int counter, long long value)
+{
+	if (counter < METAL_COUNTER_MAX)
+	{
+		m_counters[counter].value.fetch_add(value, std::memory_order_relaxed);
+	}
+}
+
+extern "C" void MetalCounterSet(unsigned int counter, long long value)
+{
+	if (counter < METAL_COUNTER_MAX)
+	{
+		m_counters[counter].value.store(value, std::memory_order_relaxed);
+	}
+}
+
+extern "C" void MetalCounterSample(unsigned int counter, double value)
+{
+	if (!IsValid(counter) || m_windows[counter] == nullptr)
+	{
+		return;
+	}
+
+	MetalCounterWindow* window = m_windows[counter];
+	Lock(window);
+	window->samples[window->count % METAL_COUNTER_WINDOW] = static_cast<float>(value);
+	window->count++;
+	window->last = value;
+	Unlock(window);
+}
+
+extern "C" void MetalCountersEndFrame(void)
+{
+	RegisterBuiltins();
+
+	auto now = std::chrono::steady_clock::now();
+	MetalCounterSample(METAL_COUNTER_FRAME_TIME, std::chrono::duration<double, std::milli>(now - m_framestart).count());
+	m_framestart = now;
+
+	DWord count = m_count.load(std::memory_order_acquire);
+	for (DWord i = 0; i < count; i++)
+	{
+		MetalCounter& counter = m_counters[i];
+		if (counter.kind == METAL_COUNTER_KIND_FRAME)
+		{
+			counter.lastframe = counter.value.exchange(0, std::memory_order_relaxed);
+			counter.interval += counter.lastframe;
+		}
+	}
+
+	m_frame++;
+	m_intervalframes++;
+	if (m_intervalframes < m_csvinterval)
+	{
+		return;
+	}
+
+	if (m_csv != nullptr)
+	{
+		WriteCsvRow();
+	}
+
+	for (DWord i = 0; i < count; i++)
+	{
+		m_counters[i].interval = 0;
+	}
+	m_intervalframes = 0;
+}
+
+extern "C" long long MetalCounterValue(unsigned int counter)
+{
+	if (!IsValid(counter))
+	{
+		return 0;
+	}
+
+	switch (m_counters[counter].kind)
+	{
+	case METAL_COUNTER_KIND_FRAME:
+		return m_counters[counter].lastframe;
+
+	case METAL_COUNTER_KIND_HISTOGRAM:
+	{
+		MetalCounterWindow* window = m_windows[counter];
+		Lock(window);
+		long long last = static_cast<long long>(window->last);
+		Unlock(window);
+		return last;
+	}
+
+	default:
+		return m_counters[counter].value.load(std::memory_order_relaxed);
+	}
+}
+
+extern "C" double MetalCounterPercentile(unsigned int counter, double percentile)
+{
+	if (!IsValid(counter) || m_windows[counter] == nullptr)
+	{
+		return 0.0;
+	}
+
+	float scratch[METAL_COUNTER_WINDOW];
+	return Percentile(counter, percentile, scratch);
+}
+
+extern "C" unsigned int MetalCounterCount(void)
+{
+	RegisterBuiltins();
+	return m_count.load(std::memory_order_acquire);
+}
+
+extern "C" const char* MetalCounterName(unsigned int counter)
+{
+	return IsValid(counter) ? m_counters[counter].name : nullptr;
+}
+
+extern "C" int MetalCounterKind(unsigned int counter)
+{
+	return IsValid(counter) ? m_counters[counter].kind : -1;
+}
+
+extern "C" int MetalCountersOpenCsv(const char* path, unsigned int intervalframes)
+{
+	RegisterBuiltins();
+	MetalCountersCloseCsv();
+
+	m_csv = fopen(path, "w");
+	if (m_csv == nullptr)
+	{
+		return 1;
+	}
+
+	m_csvinterval = intervalframes != 0 ? intervalframes : 60;
+	m_csvcounters = m_count.load(std::memory_order_acquire);
+
+	fprintf(m_csv, "frame,seconds");
+	for (DWord i = 0; i < m_csvcounters; i++)
+	{
+		const char* name = m_counters[i].name;
+		if (m_counters[i].kind == METAL_COUNTER_KIND_HISTOGRAM)
+		{
+			fprintf(m_csv, ",%s_p50,%s_p95,%s_p99,%s_max", name, name, name, name);
+		}
+		else
+		{
+			fprintf(m_csv, ",%s", name);
+		}
+	}
+	fputc('\n', m_csv);
+	return 0;
+}
+
+extern "C" void MetalCountersCloseCsv(void)
+{
+	if (m_csv != nullptr)
+	{
+		fclose(m_csv);
+		m_csv = nullptr;
+	}
+}
+
+extern "C" int MetalCountersFormat(char* buffer, size_t size)
+{
+	RegisterBuiltins();
+
+	float scratch[METAL_COUNTER_WINDOW];
+	return snprintf(buffer, size, "%.2fms p95 %.2fms p99 %.2fms | %lld draws %lld binds %lld submits | fence %.0fus",
+		Percentile(METAL_COUNTER_FRAME_TIME, 50.0, scratch), Percentile(METAL_COUNTER_FRAME_TIME, 95.0, scratch),
+		Percentile(METAL_COUNTER_FRAME_TIME, 99.0, scratch), m_counters[METAL_COUNTER_DRAW_CALLS].lastframe,
+		m_counters[METAL_COUNTER_PIPELINE_BINDS].lastframe, m_counters[METAL_COUNTER_QUEUE_SUBMITS].lastframe,
+		Percentile(METAL_COUNTER_FENCE_WAIT, 50.0, scratch));
+}
@@ -0,0 +1,482 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine visibility culling (frustum and software occlusion)
+// ------------------------------------------------------
+
+#include "headers/MCulling.hpp"
+#include "headers/MJobSystem.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+	#include <immintrin.h>
+#endif
+
+namespace engine::culling
+{
+	using engine::jobs::ParallelFor;
+
+	/* Anything with w below this is treated as touching the near plane*/
+	static constexpr float NEAR_W_EPSILON = 1e-5f;
+
+	static vec4f AddRows(const vec4f& a, const vec4f& b, float sign)
+	{
+		return vec4f(a.x + b.x * sign, a.y + b.y * sign, a.z + b.z * sign, a.w + b.w * sign);
+	}
+
+	static vec4f NormalizePlane(const vec4f& p)
+	{
+		float length = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+		float inverse = length > 0.0f ? 1.0f / length : 0.0f;
+		return vec4f(p.x * inverse, p.y * inverse, p.z * inverse, p.w * inverse);
+	}
+
+	MetalFrustum ExtractFrustum(const mat4f& viewproj)
+	{
+		/* Gribb/Hartmann. -w <= x,y <= w and 0 <= z <= w turned into planes*/
+		const vec4f* r = viewproj.rows;
+		MetalFrustum frustum;
+		frustum.planes[0] = NormalizePlane(AddRows(r[3], r[0], 1.0f));	/* Left*/
+		frustum.planes[1] = NormalizePlane(AddRows(r[3], r[0], -1.0f));	/* Right*/
+		frustum.planes[2] = NormalizePlane(AddRows(r[3], r[1], 1.0f));	/* Bottom*/
+		frustum.planes[3] = NormalizePlane(AddRows(r[3], r[1], -1.0f));	/* Top*/
+		frustum.planes[4] = NormalizePlane(r[2]);							/* Near*/
+		frustum.planes[5] = NormalizePlane(AddRows(r[3], r[2], -1.0f));	/* Far*/
+		return frustum;
+	}
+
+	void MetalCullBounds::Resize(DWord newcount)
+	{
+		DWord padded = (newcount + CULL_BOUNDS_ALIGNMENT - 1) / CULL_BOUNDS_ALIGNMENT * CULL_BOUNDS_ALIGNMENT;
+		DWord old = PaddedCount();
+
+		centerx.resize(padded, 0.0f);
+		centery.resize(padded, 0.0f);
+		centerz.resize(padded, 0.0f);
+		extentx.resize(padded, 0.0f);
+		extenty.resize(padded, 0.0f);
+		extentz.resize(padded, 0.0f);
+		radius.resize(padded, -1.0f);
+
+		/* A negative radius fails the sphere test against any plane so empty slots are never visible*/
+		for (DWord i = std::min(old, newcount); i < padded; i++)
+		{
+			centerx[i] = centery[i] = centerz[i] = 0.0f;
+			extentx[i] = extenty[i] = extentz[i] = 0.0f;
+			radius[i] = -1e30f;
+		}
+
+		count = newcount;
+	}
+
+	void MetalCullBounds::Set(DWord index, const vec3f& center, const vec3f& extents)
+	{
+		Set(index, center, extents, std::sqrt(extents.x * extents.x + extents.y * extents.y + extents.z * extents.z));
+	}
+
+	void MetalCullBounds::Set(DWord index, const vec3f& center, const vec3f& extents, float r)
+	{
+		centerx[index] = center.x;
+		centery[index] = center.y;
+		centerz[index] = center.z;
+		extentx[index] = extents.x;
+		extenty[index] = extents.y;
+		extentz[index] = extents.z;
+		radius[index] = r;
+	}
+
+	/*
+		An entity is outside a plane if its sphere or its box is fully behind it, so the test
+		per plane is d + min(radius, projected box radius) < 0. Each of these writes the indices
+		that passed into out and returns how many there were.
+	*/
+
+#if defined(__AVX512F__)
+	static DWord FrustumCullBatch(const MetalCullBounds& b, const MetalFrustum& f, DWord begin, DWord end, DWord* out)
+	{
+		const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+		DWord written = 0;
+
+		for (DWord i = begin; i < end; i += 16)
+		{
+			__m512 cx = _mm512_loadu_ps(&b.centerx[i]);
+			__m512 cy = _mm512_loadu_ps(&b.centery[i]);
+			__m512 cz = _mm512_loadu_ps(&b.centerz[i]);
+			__m512 ex = _mm512_loadu_ps(&b.extentx[i]);
+			__m512 ey = _mm512_loadu_ps(&b.extenty[i]);
+			__m512 ez = _mm512_loadu_ps(&b.extentz[i]);
+			__m512 rad = _mm512_loadu_ps(&b.radius[i]);
+			__mmask16 inside = 0xffff;
+
+			for (int p = 0; p < 6; p++)
+			{
+				__m512 nx = _mm512_set1_ps(f.planes[p].x);
+				__m512 ny = _mm512_set1_ps(f.planes[p].y);
+				__m512 nz = _mm512_set1_ps(f.planes[p].z);
+				__m512 d = _mm512_fmadd_ps(nx, cx, _mm512_fmadd_ps(ny, cy, _mm512_fmadd_ps(nz, cz, _mm512_set1_ps(f.planes[p].w))));
+				__m512 r = _mm512_fmadd_ps(_mm512_abs_ps(nx), ex, _mm512_fmadd_ps(_mm512_abs_ps(ny), ey, _mm512_mul_ps(_mm512_abs_ps(nz), ez)));
+				inside = _mm512_mask_cmp_ps_mask(inside, _mm512_add_ps(d, _mm512_min_ps(r, rad)), _mm512_setzero_ps(), _CMP_GE_OQ);
+			}
+
+			__m512i indices = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(i)), lanes);
+			_mm512_mask_compressstoreu_epi32(out + written, inside, indices);
+			written += static_cast<DWord>(std::popcount(static_cast<unsigned>(inside)));
+		}
+		return written;
+	}
+#elif defined(__AVX2__)
+	static DWord FrustumCullBatch(const MetalCullBounds& b, const MetalFrustum& f, DWord begin, DWord end, DWord* out)
+	{
+		const __m256 absmask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+		DWord written = 0;
+
+		for (DWord i = begin; i < end; i += 8)
+		{
+			__m256 cx = _mm256_loadu_ps(&b.centerx[i]);
+			__m256 cy = _mm256_loadu_ps(&b.centery[i]);
+			__m256 cz = _mm256_loadu_ps(&b.centerz[i]);
+			__m256 ex = _mm256_loadu_ps(&b.extentx[i]);
+			__m256 ey = _mm256_loadu_ps(&b.extenty[i]);
+			__m256 ez = _mm256_loadu_ps(&b.extentz[i]);
+			__m256 rad = _mm256_loadu_ps(&b.radius[i]);
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+			for (int p = 0; p < 6; p++)
+			{
+				__m256 nx = _mm256_set1_ps(f.planes[p].x);
+				__m256 ny = _mm256_set1_ps(f.planes[p].y);
+				__m256 nz = _mm256_set1_ps(f.planes[p].z);
+				__m256 d = _mm256_fmadd_ps(nx, cx, _mm256_fmadd_ps(ny, cy, _mm256_fmadd_ps(nz, cz, _mm256_set1_ps(f.planes[p].w))));
+				__m256 r = _mm256_fmadd_ps(_mm256_and_ps(nx, absmask), ex,
+					_mm256_fmadd_ps(_mm256_and_ps(ny, absmask), ey, _mm256_mul_ps(_mm256_and_ps(nz, absmask), ez)));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, _mm256_min_ps(r, rad)), _mm256_setzero_ps(), _CMP_GE_OQ));
+			}
+
+			/* Walk the set bits of the mask to compact the indices*/
+			unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(inside));
+			while (mask != 0)
+			{
+				out[written++] = i + static_cast<DWord>(std::countr_zero(mask));
+				mask &= mask - 1;
+			}
+		}
+		return written;
+	}
+#else
+	static DWord FrustumCullBatch(const MetalCullBounds& b, const MetalFrustum& f, DWord begin, DWord end, DWord* out)
+	{
+		DWord written = 0;
+		for (DWord i = begin; i < end; i++)
+		{
+			bool inside = true;
+			for (int p = 0; p < 6 && inside; p++)
+			{
+				const vec4f& plane = f.planes[p];
+				float d = plane.x * b.centerx[i] + plane.y * b.centery[i] + plane.z * b.centerz[i] + plane.w;
+				float r = std::fabs(plane.x) * b.extentx[i] + std::fabs(plane.y) * b.extenty[i] + std::fabs(plane.z) * b.extentz[i];
+				inside = d + std::min(r, b.radius[i]) >= 0.0f;
+			}
+
+			out[written] = i;
+			written += inside ? 1 : 0;
+		}
+		return written;
+	}
+#endif
+
+	DWord FrustumCull(const MetalCullBounds& bounds, const MetalFrustum& frustum, std::vector<DWord>& visible)
+	{
+		DWord padded = bounds.PaddedCount();
+		DWord batches = (padded + CULL_BATCH_SIZE - 1) / CULL_BATCH_SIZE;
+
+		/* Every batch writes into its own slice of the output, then we close the gaps.
+			Keeps the result sorted and deterministic no matter which worker ran what.
+		*/
+		visible.resize(padded);
+		std::vector<DWord> written(batches, 0);
+
+		ParallelFor(batches, 1, [&](DWord first, DWord last)
+		{
+			for (DWord batch = first; batch < last; batch++)
+			{
+				DWord begin = batch * CULL_BATCH_SIZE;
+				DWord end = std::min(begin + CULL_BATCH_SIZE, padded);
+				written[batch] = FrustumCullBatch(bounds, frustum, begin, end, visible.data() + begin);
+			}
+		});
+
+		DWord total = 0;
+		for (DWord batch = 0; batch < batches; batch++)
+		{
+			DWord begin = batch * CULL_BATCH_SIZE;
+			if (total != begin)
+			{
+				std::copy(visible.begin() + begin, visible.begin() + begin + written[batch], visible.begin() + total);
+			}
+			total += written[batch];
+		}
+
+		visible.resize(total);
+		return total;
+	}
+
+	/* Box corner in clip space*/
+	static void ProjectBoxCorners(const vec3f& c, const vec3f& e, const mat4f& m, vec4f corners[8])
+	{
+		for (int i = 0; i < 8; i++)
+		{
+			vec3f p(c.x + ((i & 1) ? e.x : -e.x), c.y + ((i & 2) ? e.y : -e.y), c.z + ((i & 4) ? e.z : -e.z));
+			corners[i] = m.Transform(p);
+		}
+	}
+
+	/* Screen space triangle ready to be rasterized (x, y in pixels, z = depth 0..1)*/
+	struct MetalOccluderTriangle
+	{
+		float x[3];
+		float y[3];
+		float z[3];
+		float miny;
+		float maxy;
+		bool valid;
+	};
+
+	/* The 12 triangles of a box, corner index = x | y << 1 | z << 2*/
+	static constexpr Byte BOX_TRIANGLES[12][3] =
+	{
+		{ 0, 2, 3 }, { 0, 3, 1 },	/* -Z*/
+		{ 4, 5, 7 }, { 4, 7, 6 },	/* +Z*/
+		{ 0, 4, 6 }, { 0, 6, 2 },	/* -X*/
+		{ 1, 3, 7 }, { 1, 7, 5 },	/* +X*/
+		{ 0, 1, 5 }, { 0, 5, 4 },	/* -Y*/
+		{ 2, 6, 7 }, { 2, 7, 3 },	/* +Y*/
+	};
+
+	MetalOcclusionBuffer::MetalOcclusionBuffer(DWord w, DWord h) : width(w), height(h), depth(static_cast<usize>(w) * h, 1.0f)
+	{
+	}
+
+	void MetalOcclusionBuffer::Clear()
+	{
+		std::fill(depth.begin(), depth.end(), 1.0f);
+	}
+
+	void MetalOcclusionBuffer::RasterizeOccluders(const MetalCullBounds& bounds, const DWord* occluders, DWord count, const mat4f& viewproj)
+	{
+		std::vector<MetalOccluderTriangle> triangles(static_cast<usize>(count) * 12);
+		float fw = static_cast<float>(width);
+		float fh = static_cast<float>(height);
+
+		/* Project every occluder once up front, the bands below all share the result*/
+		ParallelFor(count, 64, [&](DWord first, DWord last)
+		{
+			for (DWord o = first; o < last; o++)
+			{
+				vec4f clip[8];
+				ProjectBoxCorners(bounds.GetCenter(occluders[o]), bounds.GetExtents(occluders[o]), viewproj, clip);
+
+				for (int t = 0; t < 12; t++)
+				{
+					MetalOccluderTriangle& tri = triangles[static_cast<usize>(o) * 12 + t];
+					tri.valid = true;
+
+					for (int v = 0; v < 3; v++)
+					{
+						const vec4f& p = clip[BOX_TRIANGLES[t][v]];
+
+						/* Crossing the near plane would need clipping, dropping the triangle only
+							loses occlusion so it can never hide something that should be seen
+						*/
+						if (p.w <= NEAR_W_EPSILON)
+						{
+							tri.valid = false;
+							break;
+						}
+
+						float inverse = 1.0f / p.w;
+						tri.x[v] = (p.x * inverse * 0.5f + 0.5f) * fw;
+						tri.y[v] = (p.y * inverse * 0.5f + 0.5f) * fh;
+						tri.z[v] = p.z * inverse;
+					}
+
+					if (tri.valid)
+					{
+						tri.miny = std::min(tri.y[0], std::min(tri.y[1], tri.y[2]));
+						tri.maxy = std::max(tri.y[0], std::max(tri.y[1], tri.y[2]));
+					}
+				}
+			}
+		});
+
+		/* Each job owns a band of rows so nobody fights over pixels*/
+		const DWord BAND_HEIGHT = 8;
+		DWord bands = (height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+
+		ParallelFor(bands, 1, [&](DWord first, DWord last)
+		{
+			for (DWord band = first; band < last; band++)
+			{
+				int bandy0 = static_cast<int>(band * BAND_HEIGHT);
+				int bandy1 = std::min(bandy0 + static_cast<int>(BAND_HEIGHT), static_cast<int>(height));
+
+				for (const MetalOccluderTriangle& tri : triangles)
+				{
+					if (!tri.valid || tri.maxy < bandy0 || tri.miny >= bandy1)
+					{
+						continue;
+					}
+
+					float x0 = tri.x[0], y0 = tri.y[0];
+					float x1 = tri.x[1], y1 = tri.y[1];
+					float x2 = tri.x[2], y2 = tri.y[2];
+					float z0 = tri.z[0], z1 = tri.z[1], z2 = tri.z[2];
+
+					float area = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+					if (std::fabs(area) < 1e-6f)
+					{
+						continue;
+					}
+
+					/* Both windings are solid, flip to counter-clockwise*/
+					if (area < 0.0f)
+					{
+						std::swap(x1, x2);
+						std::swap(y1, y2);
+						std::swap(z1, z2);
+						area = -area;
+					}
+
+					int minx = std::max(0, static_cast<int>(std::floor(std::min(x0, std::min(x1, x2)))));
+					int maxx = std::min(static_cast<int>(width) - 1, static_cast<int>(std::ceil(std::max(x0, std::max(x1, x2)))));
+					int miny = std::max(bandy0, static_cast<int>(std::floor(tri.miny)));
+					int maxy = std::min(bandy1 - 1, static_cast<int>(std::ceil(tri.maxy)));
+					float inversearea = 1.0f / area;
+
+					for (int y = miny; y <= maxy; y++)
+					{
+						float py = static_cast<float>(y) + 0.5f;
+						float* row = depth.data() + static_cast<usize>(y) * width;
+
+						for (int x = minx; x <= maxx; x++)
+						{
+							float px = static_cast<float>(x) + 0.5f;
+							float w0 = (x2 - x1) * (py - y1) - (y2 - y1) * (px - x1);
+							float w1 = (x0 - x2) * (py - y2) - (y0 - y2) * (px - x2);
+							float w2 = (x1 - x0) * (py - y0) - (y1 - y0) * (px - x0);
+
+							if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+							{
+								continue;
+							}
+
+							/* z/w is linear in screen space so plain barycentrics are fine*/
+							float z = (w0 * z0 + w1 * z1 + w2 * z2) * inversearea;
+							row[x] = std::min(row[x], std::max(z, 0.0f));
+						}
+					}
+				}
+			}
+		});
+	}
+
+	bool MetalOcclusionBuffer::IsVisible(const vec3f& center, const vec3f& extents, const mat4f& viewproj) const
+	{
+		vec4f clip[8];
+		ProjectBoxCorners(center, extents, viewproj, clip);
+
+		float minx = 1e30f, miny = 1e30f, maxx = -1e30f, maxy = -1e30f, minz = 1e30f;
+		for (int i = 0; i < 8; i++)
+		{
+			/* Box is around the camera, can't reason about it*/
+			if (clip[i].w <= NEAR_W_EPSILON)
+			{
+				return true;
+			}
+
+			float inverse = 1.0f / clip[i].w;
+			float x = (clip[i].x * inverse * 0.5f + 0.5f) * static_cast<float>(width);
+			float y = (clip[i].y * inverse * 0.5f + 0.5f) * static_cast<float>(height);
+			minx = std::min(minx, x);
+			maxx = std::max(maxx, x);
+			miny = std::min(miny, y);
+			maxy = std::max(maxy, y);
+			minz = std::min(minz, clip[i].z * inverse);
+		}
+
+		int x0 = std::max(0, static_cast<int>(std::floor(minx)));
+		int x1 = std::min(static_cast<int>(width) - 1, static_cast<int>(std::ceil(maxx)));
+		int y0 = std::max(0, static_cast<int>(std::floor(miny)));
+		int y1 = std::min(static_cast<int>(height) - 1, static_cast<int>(std::ceil(maxy)));
+
+		if (x0 > x1 || y0 > y1)
+		{
+			return false;
+		}
+
+		/* Visible as soon as one pixel has its occluder behind the nearest point of the box*/
+		for (int y = y0; y <= y1; y++)
+		{
+			const float* row = depth.data() + static_cast<usize>(y) * width;
+			for (int x = x0; x <= x1; x++)
+			{
+				if (minz <= row[x])
+				{
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
+	DWord MetalOcclusionBuffer::OcclusionCull(const MetalCullBounds& bounds, std::vector<DWord>& visible, const mat4f& viewproj) const
+	{
+		DWord count = static_cast<DWord>(visible.size());
+		std::vector<Byte> keep(count, 0);
+
+		ParallelFor(count, 256, [&](DWord first, DWord last)
+		{
+			for (DWord i = first; i < last; i++)
+			{
+				DWord index = visible[i];
+				keep[i] = IsVisible(bounds.GetCenter(index), bounds.GetExtents(index), viewproj) ? 1 : 0;
+			}
+		});
+
+		DWord total = 0;
+		for (DWord i = 0; i < count; i++)
+		{
+			visible[total] = visible[i];
+			total += keep[i];
+		}
+
+		visible.resize(total);
+		return total;
+	}
+
+	DWord CullScene(const MetalCullBounds& bounds, const mat4f& viewproj, std::vector<DWord>& visible,
+		MetalOcclusionBuffer* occlusion, const DWord* occluders, DWord occludercount)
+	{
+		DWord total = FrustumCull(bounds, ExtractFrustum(viewproj), visible);
+
+		if (occlusion == nullptr || total == 0)
+		{
+			return total;
+		}
+
+		occlusion->Clear();
+		if (occluders != nullptr && occludercount > 0)
+		{
+			occlusion->RasterizeOccluders(bounds, occluders, occludercount, viewproj);
+		}
+
+		return occlusion->OcclusionCull(bounds, visible, viewproj);
+	}
+}
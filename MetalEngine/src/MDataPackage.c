@@ -8,4 +8,258 @@
 //		Engine data packing system (like Unreal Engine 3's UPK or DOOM's WAD)
 // ------------------------------------------------------
 
-#include "headers/MDataPackage.h"
\ No newline at end of file
+#include "headers/MDataPackage.h"
+
+#include "headers/MError.h"
+
+#if defined(_WIN32)
+    #include <windows.h>
+    #define MEPFSeek _fseeki64
+    #define MEPFTell _ftelli64
+#else
+    #include <pthread.h>
+    #define MEPFSeek fseeko
+    #define MEPFTell ftello
+#endif
+
+/*A FILE* has one position, so reads from different threads take turns*/
+static void* MEPFCreateLock(void)
+{
+#if defined(_WIN32)
+    SRWLOCK* lock = (SRWLOCK*)malloc(sizeof(SRWLOCK));
+    if (lock != NULL)
+    {
+        InitializeSRWLock(lock);
+    }
+#else
+    pthread_mutex_t* lock = (pthread_mutex_t*)malloc(sizeof(pthread_mutex_t));
+    if (lock != NULL && pthread_mutex_init(lock, NULL) != 0)
+    {
+        free(lock);
+        lock = NULL;
+    }
+#endif
+    return lock;
+}
+
+static void MEPFDestroyLock(void* lock)
+{
+    if (lock == NULL)
+    {
+        return;
+    }
+#if !defined(_WIN32)
+    pthread_mutex_destroy((pthread_mutex_t*)lock);
+#endif
+    free(lock);
+}
+
+static void MEPFLock(void* lock)
+{
+#if defined(_WIN32)
+    AcquireSRWLockExclusive((SRWLOCK*)lock);
+#else
+    pthread_mutex_lock((pthread_mutex_t*)lock);
+#endif
+}
+
+static void MEPFUnlock(void* lock)
+{
+#if defined(_WIN32)
+    ReleaseSRWLockExclusive((SRWLOCK*)lock);
+#else
+    pthread_mutex_unlock((pthread_mutex_t*)lock);
+#endif
+}
+
+static MEPF* MEPFAllocate(FILE* file)
+{
+    MEPF* package = (MEPF*)calloc(1, sizeof(MEPF));
+    if (package == NULL)
+    {
+        return NULL;
+    }
+
+    /*Without its lock the package can't be shared between threads, so it isn't handed out at all*/
+    package->lock = MEPFCreateLock();
+    if (package->lock == NULL)
+    {
+        free(package);
+        return NULL;
+    }
+
+    package->file = file;
+    return package;
+}
+
+static void MEPFFree(MEPF* package)
+{
+    if (package->file != NULL)
+    {
+        fclose(package->file);
+    }
+    MEPFDestroyLock(package->lock);
+    free(package->entries);
+    free(package);
+}
+
+MEPF* MEPFCreate(const char* path, int code_package, int assets_package)
+{
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        WarningMessage("Package WARNING", "Failed to create package: %s", path);
+        return NULL;
+    }
+
+    MEPF* package = MEPFAllocate(file);
+    if (package == NULL)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    package->writing = 1;
+    package->code_package = code_package ? 1 : 0;
+    package->assets_package = assets_package ? 1 : 0;
+
+    /*The header is written again with the real values by MEPFClose*/
+    MEPFHeader header;
+    memset(&header, 0, sizeof(header));
+    fwrite(&header, sizeof(header), 1, file);
+    package->offset = sizeof(header);
+
+    return package;
+}
+
+int MEPFAddEntry(MEPF* package, const char* name, unsigned int type, const void* data, size_t size)
+{
+    if (package == NULL || !package->writing || strlen(name) >= MEPF_NAME_LENGTH)
+    {
+        return 1;
+    }
+
+    if (package->entry_count == package->entry_capacity)
+    {
+        unsigned int capacity = package->entry_capacity ? package->entry_capacity * 2 : 64;
+        MEPFEntry* entries = (MEPFEntry*)realloc(package->entries, capacity * sizeof(MEPFEntry));
+        if (entries == NULL)
+        {
+            return 1;
+        }
+        package->entries = entries;
+        package->entry_capacity = capacity;
+    }
+
+    if (size > 0 && fwrite(data, 1, size, package->file) != size)
+    {
+        WarningMessage("Package WARNING", "Failed to write package entry: %s", name);
+        return 1;
+    }
+
+    MEPFEntry* entry = &package->entries[package->entry_count++];
+    memset(entry, 0, sizeof(MEPFEntry));
+    strncpy(entry->name, name, MEPF_NAME_LENGTH - 1);
+    entry->type = type;
+    entry->offset = package->offset;
+    entry->size = size;
+
+    package->offset += size;
+    return 0;
+}
+
+MEPF* MEPFOpen(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        WarningMessage("Package WARNING", "Failed to open package: %s", path);
+        return NULL;
+    }
+
+    MEPFHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != MEPF_MAGIC || header.version != MEPF_VERSION)
+    {
+        WarningMessage("Package WARNING", "Not a package or a package from another version: %s", path);
+        fclose(file);
+        return NULL;
+    }
+
+    MEPF* package = MEPFAllocate(file);
+    if (package == NULL)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    package->code_package = header.flags & 1;
+    package->assets_package = (header.flags >> 1) & 1;
+    package->entry_count = header.entry_count;
+    package->entry_capacity = header.entry_count;
+    package->entries = (MEPFEntry*)malloc((header.entry_count ? header.entry_count : 1) * sizeof(MEPFEntry));
+
+    if (package->entries == NULL ||
+        MEPFSeek(file, (long long)header.table_offset, SEEK_SET) != 0 ||
+        fread(package->entries, sizeof(MEPFEntry), header.entry_count, file) != header.entry_count)
+    {
+        WarningMessage("Package WARNING", "Package entry table is damaged: %s", path);
+        MEPFFree(package);
+        return NULL;
+    }
+
+    return package;
+}
+
+const MEPFEntry* MEPFFindEntry(const MEPF* package, const char* name)
+{
+    for (unsigned int i = 0; i < package->entry_count; i++)
+    {
+        if (strncmp(package->entries[i].name, name, MEPF_NAME_LENGTH) == 0)
+        {
+            return &package->entries[i];
+        }
+    }
+    return NULL;
+}
+
+int MEPFReadEntry(MEPF* package, const MEPFEntry* entry, unsigned long long offset, void* destination, size_t size)
+{
+    if (package == NULL || entry == NULL || offset + size > entry->size)
+    {
+        return 1;
+    }
+
+    MEPFLock(package->lock);
+    int result = MEPFSeek(package->file, (long long)(entry->offset + offset), SEEK_SET) != 0 ||
+        fread(destination, 1, size, package->file) != size;
+    MEPFUnlock(package->lock);
+
+    return result;
+}
+
+int MEPFClose(MEPF* package)
+{
+    if (package == NULL)
+    {
+        return 1;
+    }
+
+    int result = 0;
+    if (package->writing)
+    {
+        MEPFHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = MEPF_MAGIC;
+        header.version = MEPF_VERSION;
+        header.entry_count = package->entry_count;
+        header.flags = package->code_package | (package->assets_package << 1);
+        header.table_offset = package->offset;
+
+        result = fwrite(package->entries, sizeof(MEPFEntry), package->entry_count, package->file) != package->entry_count ||
+            MEPFSeek(package->file, 0, SEEK_SET) != 0 ||
+            fwrite(&header, sizeof(header), 1, package->file) != 1;
+    }
+
+    MEPFFree(package);
+    return result;
+}
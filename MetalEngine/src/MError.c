@@ -9,6 +9,7 @@
 // ------------------------------------------------------
 
 #include "headers/MError.h"
+#include "headers/MLog.h"
 
 void WarningMessage(const char* title, const char* msg, ...)
 {
@@ -19,7 +20,11 @@ void WarningMessage(const char* title, const char* msg, ...)
 	vsnprintf(buffer, sizeof(buffer), msg, args);
 	va_end(args);
 
-	MessageBox(NULL, msg, title, MB_OK | MB_ICONEXCLAMATION);
+	MetalLogWrite(METAL_LOG_WARNING, METAL_LOG_ENGINE, "%s: %s", title, buffer);
+
+#if defined(WIN32)
+	MessageBox(NULL, buffer, title, MB_OK | MB_ICONEXCLAMATION);
+#endif
 }
 
 void FatalError(const char* title, const char* msg, ...)
@@ -31,17 +36,17 @@ void FatalError(const char* title, const char* msg, ...)
 	vsnprintf(buffer, sizeof(buffer), msg, args);		// <-- Write formatted string into buffer
 	va_end(args);										// <-- Clean up the variable argument list
 
-	MessageBox(NULL, msg, title, MB_OK | MB_ICONERROR);	// <-- Show the error message box
+	MetalLogWrite(METAL_LOG_FATAL, METAL_LOG_ENGINE, "%s: %s", title, buffer);	// <-- Logged and flushed before the box blocks
+
+#if defined(WIN32)
+	MessageBox(NULL, buffer, title, MB_OK | MB_ICONERROR);	// <-- Show the error message box
+#endif
 }
 
 void ConsoleLog(const char* msg, ...)
 {
-	char buffer[1024];
-
 	va_list args;
 	va_start(args, msg);
-	vsnprintf(buffer, sizeof(buffer), msg, args);
+	MetalLogWriteV(METAL_LOG_INFO, METAL_LOG_ENGINE, METAL_LOG_COPY_FORMAT, msg, args);	/* msg may not be a literal*/
 	va_end(args);
-
-	printf(msg);
 }
\ No newline at end of file
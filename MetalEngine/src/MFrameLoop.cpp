@@ -0,0 +1,250 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine frame loop (fixed-timestep simulation, interpolated rendering, frame pacing)
+// ------------------------------------------------------
+
+#include "headers/MFrameLoop.hpp"
+#include "headers/MProfiler.hpp"
+#include "headers/MCounters.h"
+#include "headers/MError.h"
+
+#include <cmath>
+
+namespace engine::loop
+{
+	using Clock = std::chrono::steady_clock;
+
+	static long long NowNanoseconds()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+	}
+
+	MetalFrameLoop::~MetalFrameLoop()
+	{
+		running.store(false, std::memory_order_release);
+		if (thread.joinable())
+		{
+			thread.join();
+		}
+	}
+
+	double MetalFrameLoop::GetAlpha(QWord completedtick) const
+	{
+		/* Tick n runs at the start of its slot and leaves the world as it is at the end of it, so frames
+			inside the slot blend from the state before it towards its state*/
+		long long length = ticklength.count();
+		long long end = tickbase.load(std::memory_order_acquire) + static_cast<long long>(completedtick) * length;
+		double alpha = static_cast<double>(NowNanoseconds() - end) / static_cast<double>(length);
+		return alpha < 0.0 ? 0.0 : (alpha > 1.0 ? 1.0 : alpha);
+	}
+
+	void MetalFrameLoop::Tick(QWord index)
+	{
+		METAL_ZONE("Simulate");
+		simulate(userdata, std::chrono::duration<double>(ticklength).count(), index);
+		tick.store(index + 1, std::memory_order_release);
+		MetalCounterAdd(tickcounter, 1);
+	}
+
+	void MetalFrameLoop::SimulationThread()
+	{
+		long long length = ticklength.count();
+		QWord next = tick.load(std::memory_order_relaxed);
+
+		while (running.load(std::memory_order_acquire))
+		{
+			long long now = NowNanoseconds();
+			long long start = tickbase.load(std::memory_order_relaxed) + static_cast<long long>(next) * length;
+
+			if (now < start)
+			{
+				std::this_thread::sleep_for(std::chrono::nanoseconds(start - now));
+				continue;
+			}
+
+			/* Too far behind, move the schedule up instead of running a burst of ticks*/
+			if (now - start > static_cast<long long>(settings.maxticks) * length)
+			{
+				tickbase.store(now - static_cast<long long>(next) * length, std::memory_order_release);
+			}
+
+			Tick(next++);
+		}
+	}
+
+	bool MetalFrameLoop::PumpEvents()
+	{
+		SDL_Event polled;
+		while (SDL_PollEvent(&polled))
+		{
+			if (event != nullptr && !event(userdata, polled))
+			{
+				running.store(false, std::memory_order_release);
+			}
+		}
+		return running.load(std::memory_order_acquire);
+	}
+
+	void MetalFrameLoop::WaitUntil(Clock::time_point deadline)
+	{
+		METAL_ZONE("Idle");
+
+		/* Sleep on the event queue for the whole milliseconds, events that come in are handled right away*/
+		while (running.load(std::memory_order_acquire))
+		{
+			auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+			if (remaining.count() < 2)
+			{
+				break;
+			}
+
+			SDL_Event waited;
+			if (SDL_WaitEventTimeout(&waited, static_cast<Sint32>(remaining.count() - 1)))
+			{
+				if (event != nullptr && !event(userdata, waited))
+				{
+					running.store(false, std::memory_order_release);
+				}
+				PumpEvents();
+			}
+		}
+
+		/* And the last bit precisely, the OS scheduler alone would overshoot a frame cap by up to a millisecond*/
+		auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - Clock::now());
+		if (remaining.count() > 0 && running.load(std::memory_order_acquire))
+		{
+			SDL_DelayPrecise(static_cast<Uint64>(remaining.count()));
+		}
+	}
+
+	bool MetalFrameLoop::IsVisible() const
+	{
+		if (settings.window == nullptr)
+		{
+			return true;
+		}
+
+		return (SDL_GetWindowFlags(settings.window) & (SDL_WINDOW_MINIMIZED | SDL_WINDOW_HIDDEN | SDL_WINDOW_OCCLUDED)) == 0;
+	}
+
+	int MetalFrameLoop::Run(const MetalFrameLoopSettings& loopsettings, MetalSimulateEntry simulateentry, MetalRenderEntry renderentry,
+		MetalEventEntry evententry, void* data)
+	{
+		if (simulateentry == nullptr || loopsettings.tickrate <= 0.0 || running.load(std::memory_order_acquire))
+		{
+			WarningMessage("Frame Loop WARNING", "The loop needs a simulate callback, a positive tick rate and can only run once at a time");
+			return 1;
+		}
+
+		settings	= loopsettings;
+		simulate	= simulateentry;
+		render		= renderentry;
+		event		= evententry;
+		userdata	= data;
+		ticklength	= std::chrono::nanoseconds(static_cast<long long>(1e9 / settings.tickrate));
+		settings.maxticks = settings.maxticks == 0 ? 1 : settings.maxticks;
+		tickcounter = MetalCounterRegister("sim_ticks", METAL_COUNTER_KIND_FRAME);
+
+		QWord start = tick.load(std::memory_order_relaxed);
+		tickbase.store(NowNanoseconds() - static_cast<long long>(start) * ticklength.count(), std::memory_order_release);
+		running.store(true, std::memory_order_release);
+
+		if (settings.simthread)
+		{
+			thread = std::thread(&MetalFrameLoop::SimulationThread, this);
+		}
+
+		Clock::duration framelength = settings.framecap > 0.0
+			? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / settings.framecap)) : Clock::duration::zero();
+		std::chrono::nanoseconds accumulator = {};
+		Clock::time_point last = Clock::now();
+
+		while (PumpEvents())
+		{
+			METAL_FRAME_MARK();
+			Clock::time_point framestart = Clock::now();
+
+			double alpha = 0.0;
+			if (!settings.simthread)
+			{
+				accumulator += std::chrono::duration_cast<std::chrono::nanoseconds>(framestart - last);
+				last = framestart;
+
+				DWord ticks = 0;
+				while (accumulator >= ticklength && ticks < settings.maxticks)
+				{
+					Tick(tick.load(std::memory_order_relaxed));
+					accumulator -= ticklength;
+					ticks++;
+				}
+
+				/* Ran out of ticks for this frame, what is left is dropped so the next frame doesn't start behind*/
+				if (accumulator >= ticklength)
+				{
+					accumulator = accumulator % ticklength;
+				}
+
+				alpha = std::chrono::duration<double>(accumulator) / std::chrono::duration<double>(ticklength);
+			}
+			else
+			{
+				QWord completed = tick.load(std::memory_order_acquire);
+				alpha = completed != 0 ? GetAlpha(completed - 1) : 0.0;
+			}
+
+			bool visible = render != nullptr && IsVisible();
+			if (visible)
+			{
+				METAL_ZONE("Render");
+				render(userdata, alpha);
+			}
+
+			MetalCountersEndFrame();
+
+			/* Nothing to draw waits for the next tick, a cap waits out the frame and otherwise present does the pacing*/
+			if (!visible)
+			{
+				Clock::time_point nexttick = settings.simthread
+					? framestart + ticklength
+					: framestart + (ticklength - accumulator);
+				WaitUntil(nexttick);
+			}
+			else if (framelength != Clock::duration::zero())
+			{
+				WaitUntil(framestart + framelength);
+			}
+		}
+
+		running.store(false, std::memory_order_release);
+		if (thread.joinable())
+		{
+			thread.join();
+		}
+
+		return 0;
+	}
+
+	static float InterpolateAngle(float a, float b, float alpha)
+	{
+		float delta = std::fmod(b - a, 360.0f);
+		delta = delta > 180.0f ? delta - 360.0f : (delta < -180.0f ? delta + 360.0f : delta);
+		return a + delta * alpha;
+	}
+
+	trans3f InterpolateTransform(const trans3f& a, const trans3f& b, float alpha)
+	{
+		trans3f result;
+		result.location	= vec3f(a.location.x + (b.location.x - a.location.x) * alpha, a.location.y + (b.location.y - a.location.y) * alpha,
+			a.location.z + (b.location.z - a.location.z) * alpha);
+		result.rotation	= rot3f(InterpolateAngle(a.rotation.pitch, b.rotation.pitch, alpha), InterpolateAngle(a.rotation.yaw, b.rotation.yaw, alpha),
+			InterpolateAngle(a.rotation.roll, b.rotation.roll, alpha));
+		result.scale	= vec3f(a.scale.x + (b.scale.x - a.scale.x) * alpha, a.scale.y + (b.scale.y - a.scale.y) * alpha,
+			a.scale.z + (b.scale.z - a.scale.z) * alpha);
+		return result;
+	}
+}
@@ -0,0 +1,530 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine job system (work-stealing, one worker per core)
+// ------------------------------------------------------
+
+#include "headers/MJobSystem.hpp"
+#include "headers/MError.h"
+#include "headers/MProfiler.hpp"
+
+#include <memory>
+#include <mutex>
+
+namespace engine::jobs
+{
+	/* Slots a worker hands out before new jobs go to the heap, twice the deque so jobs parked on a dependency fit too*/
+	static constexpr DWord JOB_POOL_SIZE = MAXIMUM_JOBS_PER_WORKER * 2;
+	static constexpr DWord JOB_MASK = MAXIMUM_JOBS_PER_WORKER - 1;
+
+	static_assert((MAXIMUM_JOBS_PER_WORKER & JOB_MASK) == 0, "MAXIMUM_JOBS_PER_WORKER must be a power of two");
+
+	/* A pool slot is only reused once the job in it has run. The owner takes slots from freelist and puts
+		back the ones it ran itself, slots of jobs stolen by other workers come back through returned
+		and the owner takes that whole list at once when its own runs dry.
+	*/
+	struct MetalJobWorker
+	{
+		MetalJobDeque			deque;
+		MetalJob				pool[JOB_POOL_SIZE];
+		MetalJob*				freelist = nullptr;
+		std::atomic<MetalJob*>	returned{ nullptr };
+		DWord					stealseed = 0;
+		std::thread				thread;
+
+		MetalJobWorker()
+		{
+			for (DWord i = 0; i < JOB_POOL_SIZE; i++)
+			{
+				pool[i].next = i + 1 < JOB_POOL_SIZE ? &pool[i + 1] : nullptr;
+			}
+			freelist = &pool[0];
+		}
+	};
+
+	static std::vector<std::unique_ptr<MetalJobWorker>>	m_workers;
+	static std::atomic<bool>							m_running{ false };
+	static std::atomic<DWord>							m_jobsignal{ 0 };	/* Bumped every time work is queued so sleeping workers wake up*/
+	static std::mutex									m_injectionlock;
+	static std::vector<MetalJob*>						m_injectionqueue;	/* Jobs queued from threads that are not workers*/
+	static std::atomic<DWord>							m_injectioncount{ 0 };
+	static thread_local int								t_workerindex = -1;
+
+	MetalJobDeque::MetalJobDeque() : top(0), bottom(0)
+	{
+		for (DWord i = 0; i < MAXIMUM_JOBS_PER_WORKER; i++)
+		{
+			jobs[i].store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	bool MetalJobDeque::Push(MetalJob* job)
+	{
+		ssize b = bottom.load(std::memory_order_relaxed);
+		ssize t = top.load(std::memory_order_acquire);
+
+		if (b - t >= static_cast<ssize>(MAXIMUM_JOBS_PER_WORKER))
+		{
+			return false;
+		}
+
+		/* A release store instead of a fence plus relaxed store, same ordering but thread sanitizer understands it*/
+		jobs[b & JOB_MASK].store(job, std::memory_order_relaxed);
+		bottom.store(b + 1, std::memory_order_release);
+		return true;
+	}
+
+	MetalJob* MetalJobDeque::Pop()
+	{
+		ssize b = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		ssize t = top.load(std::memory_order_relaxed);
+
+		if (t > b)
+		{
+			/* Empty, put bottom back where it was*/
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		MetalJob* job = jobs[b & JOB_MASK].load(std::memory_order_relaxed);
+		if (t == b)
+		{
+			/* Last job left, we race the thieves for it*/
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			{
+				job = nullptr;
+			}
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+
+		return job;
+	}
+
+	MetalJob* MetalJobDeque::Steal()
+	{
+		ssize t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		ssize b = bottom.load(std::memory_order_acquire);
+
+		if (t >= b)
+		{
+			return nullptr;
+		}
+
+		MetalJob* job = jobs[t & JOB_MASK].load(std::memory_order_relaxed);
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			return nullptr;
+		}
+
+		return job;
+	}
+
+	bool MetalJobDeque::IsEmpty() const
+	{
+		return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+	}
+
+	static void LockCounter(MetalJobCounter* counter)
+	{
+		while (counter->lock.test_and_set(std::memory_order_acquire))
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	static void UnlockCounter(MetalJobCounter* counter)
+	{
+		counter->lock.clear(std::memory_order_release);
+	}
+
+	static void WakeWorkers()
+	{
+		m_jobsignal.fetch_add(1, std::memory_order_release);
+		m_jobsignal.notify_all();
+	}
+
+	static MetalJob* AllocateJob()
+	{
+		if (t_workerindex < 0)
+		{
+			MetalJob* job = new MetalJob();
+			job->heap = true;
+			return job;
+		}
+
+		MetalJobWorker* worker = m_workers[t_workerindex].get();
+		if (worker->freelist == nullptr)
+		{
+			worker->freelist = worker->returned.exchange(nullptr, std::memory_order_acquire);
+		}
+
+		/* Every slot is queued, parked or running, so don't touch any of them*/
+		MetalJob* job = worker->freelist;
+		if (job == nullptr)
+		{
+			job = new MetalJob();
+			job->heap = true;
+			return job;
+		}
+
+		worker->freelist = job->next;
+		*job = MetalJob();
+		job->owner = worker;
+		return job;
+	}
+
+	static void ReleaseJob(MetalJob* job)
+	{
+		if (job->heap)
+		{
+			delete job;
+			return;
+		}
+
+		MetalJobWorker* owner = job->owner;
+		if (t_workerindex >= 0 && m_workers[t_workerindex].get() == owner)
+		{
+			job->next = owner->freelist;
+			owner->freelist = job;
+			return;
+		}
+
+		MetalJob* head = owner->returned.load(std::memory_order_relaxed);
+		do
+		{
+			job->next = head;
+		} while (!owner->returned.compare_exchange_weak(head, job, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	static void ExecuteJob(MetalJob* job);
+
+	/* Hands a job whose dependency is already satisfied to the workers*/
+	static void QueueReadyJob(MetalJob* job)
+	{
+		if (t_workerindex >= 0)
+		{
+			if (m_workers[t_workerindex]->deque.Push(job))
+			{
+				return;
+			}
+
+			/* Deque is full, just do it right here*/
+			ExecuteJob(job);
+			return;
+		}
+
+		std::lock_guard<std::mutex> guard(m_injectionlock);
+		m_injectionqueue.push_back(job);
+		m_injectioncount.fetch_add(1, std::memory_order_release);
+	}
+
+	/* Either queues the job or parks it on its dependency, returns true if it was queued*/
+	static bool QueueJob(MetalJob* job)
+	{
+		MetalJobCounter* dependency = job->dependency;
+		if (dependency != nullptr && !dependency->IsDone())
+		{
+			LockCounter(dependency);
+			if (dependency->value.load(std::memory_order_acquire) != 0)
+			{
+				job->next = dependency->continuations;
+				dependency->continuations = job;
+				UnlockCounter(dependency);
+				return false;
+			}
+			UnlockCounter(dependency);
+		}
+
+		QueueReadyJob(job);
+		return true;
+	}
+
+	static void FinishJob(MetalJobCounter* counter)
+	{
+		if (counter == nullptr)
+		{
+			return;
+		}
+
+		/* The decrement happens under the lock so a waiter that sees zero and then takes the lock
+			knows we are done touching the counter and it can go out of scope
+		*/
+		MetalJob* released = nullptr;
+		LockCounter(counter);
+		if (counter->value.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			released = counter->continuations;
+			counter->continuations = nullptr;
+		}
+		UnlockCounter(counter);
+
+		if (released == nullptr)
+		{
+			return;
+		}
+
+		while (released != nullptr)
+		{
+			MetalJob* next = released->next;
+			released->next = nullptr;
+			QueueJob(released);
+			released = next;
+		}
+
+		WakeWorkers();
+	}
+
+	static void ExecuteJob(MetalJob* job)
+	{
+		MetalJobCounter* counter = job->counter;
+		{
+			METAL_ZONE("Job");
+			job->entry(job->userdata);
+		}
+
+		ReleaseJob(job);
+		FinishJob(counter);
+	}
+
+	static MetalJob* FindJob()
+	{
+		if (t_workerindex >= 0)
+		{
+			MetalJobWorker* worker = m_workers[t_workerindex].get();
+			if (MetalJob* job = worker->deque.Pop())
+			{
+				return job;
+			}
+		}
+
+		if (m_injectioncount.load(std::memory_order_acquire) != 0)
+		{
+			std::lock_guard<std::mutex> guard(m_injectionlock);
+			if (!m_injectionqueue.empty())
+			{
+				MetalJob* job = m_injectionqueue.back();
+				m_injectionqueue.pop_back();
+				m_injectioncount.fetch_sub(1, std::memory_order_release);
+				return job;
+			}
+		}
+
+		/* Nothing of our own, go and rob somebody. Start at a different victim every time so
+			all the thieves don't pile onto worker 0
+		*/
+		DWord count = static_cast<DWord>(m_workers.size());
+		DWord start = 0;
+		if (t_workerindex >= 0)
+		{
+			DWord& seed = m_workers[t_workerindex]->stealseed;
+			seed = seed * 1664525u + 1013904223u;
+			start = seed >> 16;
+		}
+
+		for (DWord i = 0; i < count; i++)
+		{
+			DWord victim = (start + i) % count;
+			if (static_cast<int>(victim) == t_workerindex)
+			{
+				continue;
+			}
+
+			if (MetalJob* job = m_workers[victim]->deque.Steal())
+			{
+				return job;
+			}
+		}
+
+		return nullptr;
+	}
+
+	static void WorkerThread(int index)
+	{
+		t_workerindex = index;
+
+#if defined(METAL_PROFILE)
+		char name[engine::profiler::PROFILER_THREAD_NAME];
+		snprintf(name, sizeof(name), "Worker %d", index);
+		METAL_THREAD_NAME(name);
+#endif
+
+		while (m_running.load(std::memory_order_acquire))
+		{
+			DWord signal = m_jobsignal.load(std::memory_order_acquire);
+
+			if (MetalJob* job = FindJob())
+			{
+				ExecuteJob(job);
+				continue;
+			}
+
+			/* Spin for a moment before going to sleep, frames tend to queue work in bursts*/
+			bool found = false;
+			for (int spin = 0; spin < 64 && !found; spin++)
+			{
+				std::this_thread::yield();
+				if (MetalJob* job = FindJob())
+				{
+					ExecuteJob(job);
+					found = true;
+				}
+			}
+
+			if (!found && m_running.load(std::memory_order_acquire))
+			{
+				m_jobsignal.wait(signal, std::memory_order_acquire);
+			}
+		}
+
+		t_workerindex = -1;
+	}
+
+	int JobSystemInit(DWord workercount)
+	{
+		if (m_running.load())
+		{
+			WarningMessage("Job System WARNING", "JobSystemInit called twice");
+			return 1;
+		}
+
+		if (workercount == 0)
+		{
+			workercount = std::thread::hardware_concurrency();
+			workercount = workercount == 0 ? 1 : workercount;
+		}
+
+		m_workers.clear();
+		for (DWord i = 0; i < workercount; i++)
+		{
+			m_workers.push_back(std::make_unique<MetalJobWorker>());
+			m_workers.back()->stealseed = i * 2654435761u + 1;
+		}
+
+		m_running.store(true, std::memory_order_release);
+
+		/* The calling thread is worker 0, it only runs jobs when it waits on a counter*/
+		t_workerindex = 0;
+		for (DWord i = 1; i < workercount; i++)
+		{
+			m_workers[i]->thread = std::thread(WorkerThread, static_cast<int>(i));
+		}
+
+		ConsoleLog("ENGINE: Job system started with %u workers\n", workercount);
+		return 0;
+	}
+
+	void JobSystemShutdown(void)
+	{
+		if (!m_running.exchange(false))
+		{
+			return;
+		}
+
+		WakeWorkers();
+		for (auto& worker : m_workers)
+		{
+			if (worker->thread.joinable())
+			{
+				worker->thread.join();
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(m_injectionlock);
+			/* Jobs released from a waiting thread that isn't a worker can be pool slots, those go with their worker*/
+			for (MetalJob* job : m_injectionqueue)
+			{
+				if (job->heap)
+				{
+					delete job;
+				}
+			}
+			m_injectionqueue.clear();
+			m_injectioncount.store(0);
+		}
+
+		m_workers.clear();
+		t_workerindex = -1;
+	}
+
+	void RunJobs(MetalJobEntry entry, void* const* userdata, DWord count, MetalJobCounter* counter, MetalJobCounter* dependency)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+
+		if (counter != nullptr)
+		{
+			counter->value.fetch_add(count, std::memory_order_acq_rel);
+		}
+
+		/* Job system isn't running, behave like a plain function call*/
+		if (!m_running.load(std::memory_order_acquire))
+		{
+			if (dependency != nullptr && !dependency->IsDone())
+			{
+				FatalError("Job System ERROR", "Job queued on an unfinished dependency while the job system is not running");
+			}
+
+			for (DWord i = 0; i < count; i++)
+			{
+				entry(userdata != nullptr ? userdata[i] : nullptr);
+				FinishJob(counter);
+			}
+			return;
+		}
+
+		bool queued = false;
+		for (DWord i = 0; i < count; i++)
+		{
+			MetalJob* job = AllocateJob();
+			job->entry = entry;
+			job->userdata = userdata != nullptr ? userdata[i] : nullptr;
+			job->counter = counter;
+			job->dependency = dependency;
+			queued |= QueueJob(job);
+		}
+
+		if (queued)
+		{
+			WakeWorkers();
+		}
+	}
+
+	void WaitForCounter(MetalJobCounter* counter)
+	{
+		while (counter->value.load(std::memory_order_acquire) != 0)
+		{
+			if (MetalJob* job = FindJob())
+			{
+				ExecuteJob(job);
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		/* Make sure whoever dropped the counter to zero has let go of it*/
+		LockCounter(counter);
+		UnlockCounter(counter);
+	}
+
+	DWord GetWorkerCount(void)
+	{
+		return m_workers.empty() ? 1 : static_cast<DWord>(m_workers.size());
+	}
+
+	int GetWorkerIndex(void)
+	{
+		return t_workerindex;
+	}
+}
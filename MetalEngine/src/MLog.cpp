@@ -0,0 +1,798 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine logging (per-thread lock-free rings, background formatting, sinks)
+// ------------------------------------------------------
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "headers/MLog.h"
+#include "headers/MTypes.hpp"
+
+#if defined(WIN32)
+	#include <Windows.h>
+#elif defined(__linux__)
+	#include <syslog.h>
+#endif
+
+namespace engine::log
+{
+	static constexpr usize	LOG_RING_SIZE		= 64 * 1024;	/* Per thread, power of two*/
+	static constexpr usize	LOG_MAX_STRING		= 1024;			/* %s arguments are cut here*/
+	static constexpr usize	LOG_MAX_RECORD		= 8 * 1024;
+	static constexpr auto	LOG_FLUSH_INTERVAL	= std::chrono::milliseconds(5);
+
+	/* Header of a queued line, followed by the copied format (if any) and the arguments.
+		Every argument takes 8 bytes except strings, which are a DWord length and the characters
+		padded to 8. The reader walks the format again to know what comes next.*/
+	struct MetalLogRecord
+	{
+		DWord		size;			/* Whole record including this header, multiple of 8*/
+		DWord		category;
+		Word		severity;
+		Word		flags;
+		DWord		formatlength;	/* Bytes of copied format after the header (METAL_LOG_COPY_FORMAT)*/
+		QWord		time;			/* Nanoseconds since the logger started*/
+		const char*	format;
+	};
+
+	static_assert(sizeof(MetalLogRecord) % 8 == 0, "Records have to keep the ring 8 byte aligned");
+
+	/* Single producer (the thread that owns it) single consumer (whoever holds m_drainlock)*/
+	struct MetalLogRing
+	{
+		alignas(64) std::atomic<QWord>	head{ 0 };		/* Written by the producer*/
+		alignas(64) std::atomic<QWord>	tail{ 0 };		/* Written by the consumer*/
+		alignas(64) std::atomic<bool>	owned{ false };	/* A thread is producing into it*/
+		std::atomic<QWord>				dropped{ 0 };
+		MetalLogRing*					next = nullptr;
+		Byte							data[LOG_RING_SIZE];
+	};
+
+	struct MetalLogSinkEntry
+	{
+		MetalLogSink	sink;
+		void			(*close)(void*);
+		void*			userdata;
+		int				minseverity;
+	};
+
+	/* One argument as the reader sees it*/
+	struct MetalLogSpec
+	{
+		char	conversion	= 0;	/* 0 when the format ended*/
+		char	length[3]	= {};	/* hh, h, l, ll, z, j, t, L*/
+		int		stars		= 0;	/* '*' width/precision arguments before the value*/
+		const char*	begin	= nullptr;	/* The '%'*/
+		const char*	end		= nullptr;	/* One past the conversion*/
+	};
+
+	static std::atomic<MetalLogRing*>		m_rings{ nullptr };
+	static std::atomic<bool>				m_running{ false };
+	static std::atomic<QWord>				m_totaldropped{ 0 };
+	static std::mutex						m_drainlock;
+	static std::mutex						m_sinklock;
+	static std::mutex						m_wakelock;
+	static std::condition_variable			m_wake;
+	static std::vector<MetalLogSinkEntry>	m_sinks;
+	static std::thread						m_thread;
+	static const auto						m_start = std::chrono::steady_clock::now();
+
+	static const char* SeverityName(int severity)
+	{
+		switch (severity)
+		{
+		case METAL_LOG_TRACE:	return "TRACE";
+		case METAL_LOG_DEBUG:	return "DEBUG";
+		case METAL_LOG_INFO:	return "INFO";
+		case METAL_LOG_WARNING:	return "WARNING";
+		case METAL_LOG_ERROR:	return "ERROR";
+		default:				return "FATAL";
+		}
+	}
+
+	static const char* CategoryName(DWord category)
+	{
+		switch (category)
+		{
+		case METAL_LOG_ENGINE:	return "ENGINE";
+		case METAL_LOG_RENDER:	return "RENDER";
+		case METAL_LOG_JOBS:	return "JOBS";
+		case METAL_LOG_ASSETS:	return "ASSETS";
+		case METAL_LOG_GAME:	return "GAME";
+		default:				return "MIXED";
+		}
+	}
+
+	static usize AlignRecord(usize size)
+	{
+		return (size + 7) & ~usize(7);
+	}
+
+	/* Finds the next conversion, copying the literal text before it into out (when given)*/
+	static bool NextSpec(const char*& cursor, MetalLogSpec& spec, std::string* out)
+	{
+		spec = MetalLogSpec();
+		while (*cursor != '\0')
+		{
+			if (*cursor != '%')
+			{
+				if (out != nullptr)
+				{
+					out->push_back(*cursor);
+				}
+				cursor++;
+				continue;
+			}
+
+			if (cursor[1] == '%')
+			{
+				if (out != nullptr)
+				{
+					out->push_back('%');
+				}
+				cursor += 2;
+				continue;
+			}
+
+			spec.begin = cursor++;
+			while (*cursor != '\0' && std::strchr("-+ #0", *cursor) != nullptr)
+			{
+				cursor++;
+			}
+			if (*cursor == '*')
+			{
+				spec.stars++;
+				cursor++;
+			}
+			while (*cursor >= '0' && *cursor <= '9')
+			{
+				cursor++;
+			}
+			if (*cursor == '.')
+			{
+				cursor++;
+				if (*cursor == '*')
+				{
+					spec.stars++;
+					cursor++;
+				}
+				while (*cursor >= '0' && *cursor <= '9')
+				{
+					cursor++;
+				}
+			}
+
+			int length = 0;
+			while (*cursor != '\0' && std::strchr("hlzjtL", *cursor) != nullptr && length < 2)
+			{
+				spec.length[length++] = *cursor++;
+			}
+
+			if (*cursor == '\0')
+			{
+				return false;
+			}
+
+			spec.conversion = *cursor++;
+			spec.end = cursor;
+			return true;
+		}
+		return false;
+	}
+
+	static bool IsSigned(char conversion) { return conversion == 'd' || conversion == 'i'; }
+	static bool IsUnsigned(char conversion) { return conversion == 'u' || conversion == 'x' || conversion == 'X' || conversion == 'o'; }
+	static bool IsFloat(char conversion) { return std::strchr("fFeEgGaA", conversion) != nullptr; }
+
+	/* Pulls one integer argument with the width its length modifier says it has*/
+	static QWord ReadInteger(const MetalLogSpec& spec, va_list* args)
+	{
+		bool issigned = IsSigned(spec.conversion);
+		if (spec.length[0] == 'l' && spec.length[1] == 'l')
+		{
+			return issigned ? static_cast<QWord>(va_arg(*args, long long)) : va_arg(*args, unsigned long long);
+		}
+		switch (spec.length[0])
+		{
+		case 'l':	return issigned ? static_cast<QWord>(va_arg(*args, long)) : va_arg(*args, unsigned long);
+		case 'z':	return static_cast<QWord>(va_arg(*args, size_t));
+		case 'j':	return issigned ? static_cast<QWord>(va_arg(*args, intmax_t)) : static_cast<QWord>(va_arg(*args, uintmax_t));
+		case 't':	return static_cast<QWord>(va_arg(*args, ptrdiff_t));
+		default:	return issigned ? static_cast<QWord>(static_cast<long long>(va_arg(*args, int))) : va_arg(*args, unsigned int);
+		}
+	}
+
+	/* Writes the arguments of format into destination, returns the bytes used (or what would have been used)*/
+	static usize EncodeArguments(const char* format, va_list source, Byte* destination, usize capacity)
+	{
+		va_list args;
+		va_copy(args, source);
+
+		usize used = 0;
+		auto Put = [&](const void* value, usize size, usize padded)
+		{
+			if (destination != nullptr && used + padded <= capacity)
+			{
+				std::memcpy(destination + used, value, size);
+			}
+			used += padded;
+		};
+
+		MetalLogSpec spec;
+		const char* cursor = format;
+		while (NextSpec(cursor, spec, nullptr))
+		{
+			for (int i = 0; i < spec.stars; i++)
+			{
+				QWord star = static_cast<QWord>(static_cast<long long>(va_arg(args, int)));
+				Put(&star, 8, 8);
+			}
+
+			if (spec.conversion == 's')
+			{
+				const char* string = va_arg(args, const char*);
+				string = string != nullptr ? string : "(null)";
+				DWord length = static_cast<DWord>(strnlen(string, LOG_MAX_STRING));
+				Put(&length, 4, 4);
+				Put(string, length, AlignRecord(length + 4) - 4);
+			}
+			else if (IsFloat(spec.conversion))
+			{
+				double value = spec.length[0] == 'L' ? static_cast<double>(va_arg(args, long double)) : va_arg(args, double);
+				Put(&value, 8, 8);
+			}
+			else if (spec.conversion == 'p')
+			{
+				QWord value = reinterpret_cast<QWord>(va_arg(args, void*));
+				Put(&value, 8, 8);
+			}
+			else if (spec.conversion == 'c' || IsSigned(spec.conversion) || IsUnsigned(spec.conversion))
+			{
+				QWord value = spec.conversion == 'c' ? static_cast<QWord>(va_arg(args, int)) : ReadInteger(spec, &args);
+				Put(&value, 8, 8);
+			}
+			else
+			{
+				/* %n and unknown conversions have nothing safe to store, stop here*/
+				break;
+			}
+		}
+
+		va_end(args);
+		return used;
+	}
+
+	/* Rebuilds a line from a record, each conversion is handed to snprintf on its own*/
+	static void FormatRecord(const MetalLogRecord* record, std::string& line)
+	{
+		const Byte* cursor = reinterpret_cast<const Byte*>(record) + sizeof(MetalLogRecord);
+		const Byte* end = reinterpret_cast<const Byte*>(record) + record->size;
+		const char* format = record->format;
+		if (record->flags & METAL_LOG_COPY_FORMAT)
+		{
+			format = reinterpret_cast<const char*>(cursor);
+			cursor += AlignRecord(record->formatlength + 1);
+		}
+
+		auto Take = [&](void* value, usize size, usize padded) -> bool
+		{
+			if (cursor + padded > end)
+			{
+				return false;
+			}
+			std::memcpy(value, cursor, size);
+			cursor += padded;
+			return true;
+		};
+
+		char buffer[LOG_MAX_STRING + 64];
+		char spectext[64];
+		MetalLogSpec spec;
+		const char* walk = format;
+		while (NextSpec(walk, spec, &line))
+		{
+			int stars[2] = {};
+			for (int i = 0; i < spec.stars; i++)
+			{
+				QWord star;
+				if (!Take(&star, 8, 8))
+				{
+					return;
+				}
+				stars[i] = static_cast<int>(static_cast<long long>(star));
+			}
+
+			/* Same flags/width/precision, length modifiers replaced by what the value is stored as*/
+			usize prefix = 0;
+			for (const char* c = spec.begin; c < spec.end - 1 && prefix < sizeof(spectext) - 4; c++)
+			{
+				if (std::strchr("hlzjtL", *c) == nullptr)
+				{
+					spectext[prefix++] = *c;
+				}
+			}
+
+			auto Finish = [&](const char* length)
+			{
+				usize at = prefix;
+				for (; *length != '\0'; length++)
+				{
+					spectext[at++] = *length;
+				}
+				spectext[at++] = spec.conversion;
+				spectext[at] = '\0';
+			};
+
+			int written = 0;
+			if (spec.conversion == 's')
+			{
+				DWord length;
+				char string[LOG_MAX_STRING + 1];
+				if (!Take(&length, 4, 4) || length > LOG_MAX_STRING || !Take(string, length, AlignRecord(length + 4) - 4))
+				{
+					return;
+				}
+				string[length] = '\0';
+				Finish("");
+				written = spec.stars == 2 ? std::snprintf(buffer, sizeof(buffer), spectext, stars[0], stars[1], string) :
+					spec.stars == 1 ? std::snprintf(buffer, sizeof(buffer), spectext, stars[0], string) :
+					std::snprintf(buffer, sizeof(buffer), spectext, string);
+			}
+			else
+			{
+				QWord raw;
+				if (!Take(&raw, 8, 8))
+				{
+					return;
+				}
+
+				auto Print = [&](auto value)
+				{
+					return spec.stars == 2 ? std::snprintf(buffer, sizeof(buffer), spectext, stars[0], stars[1], value) :
+						spec.stars == 1 ? std::snprintf(buffer, sizeof(buffer), spectext, stars[0], value) :
+						std::snprintf(buffer, sizeof(buffer), spectext, value);
+				};
+
+				if (IsFloat(spec.conversion))
+				{
+					double value;
+					std::memcpy(&value, &raw, 8);
+					Finish("");
+					written = Print(value);
+				}
+				else if (spec.conversion == 'p')
+				{
+					Finish("");
+					written = Print(reinterpret_cast<void*>(raw));
+				}
+				else if (spec.conversion == 'c')
+				{
+					Finish("");
+					written = Print(static_cast<int>(raw));
+				}
+				else
+				{
+					Finish("ll");
+					written = IsSigned(spec.conversion) ? Print(static_cast<long long>(raw)) : Print(static_cast<unsigned long long>(raw));
+				}
+			}
+
+			if (written > 0)
+			{
+				line.append(buffer, std::min<usize>(static_cast<usize>(written), sizeof(buffer) - 1));
+			}
+		}
+	}
+
+	static void EmitLine(int severity, DWord category, const char* line, usize length)
+	{
+		std::lock_guard<std::mutex> guard(m_sinklock);
+		if (m_sinks.empty())
+		{
+			std::fwrite(line, 1, length, stdout);
+			std::fputc('\n', stdout);
+			return;
+		}
+
+		for (const MetalLogSinkEntry& sink : m_sinks)
+		{
+			if (severity >= sink.minseverity)
+			{
+				sink.sink(sink.userdata, severity, category, line, length);
+			}
+		}
+	}
+
+	static void EmitRecord(const MetalLogRecord* record, std::string& line)
+	{
+		char prefix[96];
+		int length = std::snprintf(prefix, sizeof(prefix), "[%12.6f] [%s] [%s] ", static_cast<double>(record->time) * 1e-9,
+			SeverityName(record->severity), CategoryName(record->category));
+
+		line.assign(prefix, length > 0 ? static_cast<usize>(length) : 0);
+		FormatRecord(record, line);
+
+		/* ConsoleLog callers end their messages with a newline, the sinks add their own*/
+		while (!line.empty() && (line.back() == '\n' || line.back() == '\r'))
+		{
+			line.pop_back();
+		}
+		EmitLine(record->severity, record->category, line.data(), line.size());
+	}
+
+	/* Formats everything queued so far, in time order across threads. Caller holds m_drainlock.*/
+	static void Drain()
+	{
+		struct Pending
+		{
+			QWord	time;
+			usize	offset;
+		};
+
+		static std::vector<Byte> copies;
+		static std::vector<Pending> pending;
+		static std::string line;
+		copies.clear();
+		pending.clear();
+
+		for (MetalLogRing* ring = m_rings.load(std::memory_order_acquire); ring != nullptr; ring = ring->next)
+		{
+			QWord dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+			if (dropped != 0)
+			{
+				m_totaldropped.fetch_add(dropped, std::memory_order_relaxed);
+				char message[96];
+				int length = std::snprintf(message, sizeof(message), "[LOG] %llu lines dropped, a ring was full",
+					static_cast<unsigned long long>(dropped));
+				EmitLine(METAL_LOG_WARNING, METAL_LOG_ENGINE, message, static_cast<usize>(length));
+			}
+
+			QWord tail = ring->tail.load(std::memory_order_relaxed);
+			QWord head = ring->head.load(std::memory_order_acquire);
+			while (tail != head)
+			{
+				usize offset = static_cast<usize>(tail & (LOG_RING_SIZE - 1));
+				if (LOG_RING_SIZE - offset < sizeof(MetalLogRecord))
+				{
+					tail += LOG_RING_SIZE - offset;
+					continue;
+				}
+
+				const MetalLogRecord* record = reinterpret_cast<const MetalLogRecord*>(ring->data + offset);
+				if (record->size == 0)
+				{
+					/* Padding up to the end of the ring*/
+					tail += LOG_RING_SIZE - offset;
+					continue;
+				}
+
+				usize at = copies.size();
+				copies.insert(copies.end(), ring->data + offset, ring->data + offset + record->size);
+				pending.push_back({ record->time, at });
+				tail += record->size;
+			}
+
+			/* The producer may reuse the space as soon as this is published*/
+			ring->tail.store(tail, std::memory_order_release);
+		}
+
+		std::stable_sort(pending.begin(), pending.end(), [](const Pending& a, const Pending& b) { return a.time < b.time; });
+		for (const Pending& entry : pending)
+		{
+			EmitRecord(reinterpret_cast<const MetalLogRecord*>(copies.data() + entry.offset), line);
+		}
+	}
+
+	/* Hands the calling thread a ring, reusing ones left behind by threads that exited*/
+	static MetalLogRing* AcquireRing()
+	{
+		for (MetalLogRing* ring = m_rings.load(std::memory_order_acquire); ring != nullptr; ring = ring->next)
+		{
+			bool expected = false;
+			if (!ring->owned.load(std::memory_order_relaxed) && ring->owned.compare_exchange_strong(expected, true, std::memory_order_acquire))
+			{
+				return ring;
+			}
+		}
+
+		MetalLogRing* ring = new MetalLogRing();
+		ring->owned.store(true, std::memory_order_relaxed);
+		MetalLogRing* head = m_rings.load(std::memory_order_relaxed);
+		do
+		{
+			ring->next = head;
+		} while (!m_rings.compare_exchange_weak(head, ring, std::memory_order_release, std::memory_order_relaxed));
+		return ring;
+	}
+
+	struct MetalLogThread
+	{
+		MetalLogRing* ring = nullptr;
+
+		~MetalLogThread()
+		{
+			if (ring != nullptr)
+			{
+				ring->owned.store(false, std::memory_order_release);
+			}
+		}
+	};
+
+	static thread_local MetalLogThread t_log;
+
+	/* Reserves contiguous space for a record, returns nullptr when the ring is full*/
+	static Byte* Reserve(MetalLogRing* ring, usize size, QWord& head)
+	{
+		head = ring->head.load(std::memory_order_relaxed);
+		QWord tail = ring->tail.load(std::memory_order_acquire);
+		usize offset = static_cast<usize>(head & (LOG_RING_SIZE - 1));
+
+		/* Records never wrap, skip the rest of the ring when this one does not fit before the end*/
+		usize skip = LOG_RING_SIZE - offset < size ? LOG_RING_SIZE - offset : 0;
+		if (head + skip + size - tail > LOG_RING_SIZE)
+		{
+			return nullptr;
+		}
+
+		if (skip != 0)
+		{
+			if (skip >= sizeof(MetalLogRecord))
+			{
+				reinterpret_cast<MetalLogRecord*>(ring->data + offset)->size = 0;
+			}
+			head += skip;
+			offset = 0;
+		}
+		return ring->data + offset;
+	}
+
+	static void WriteInline(int severity, DWord category, const char* format, va_list args)
+	{
+		char buffer[LOG_MAX_RECORD];
+		char prefix[96];
+		int length = std::snprintf(prefix, sizeof(prefix), "[%12.6f] [%s] [%s] ",
+			std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count(), SeverityName(severity), CategoryName(category));
+		int message = std::vsnprintf(buffer, sizeof(buffer), format, args);
+
+		std::string line(prefix, length > 0 ? static_cast<usize>(length) : 0);
+		line.append(buffer, message > 0 ? std::min<usize>(static_cast<usize>(message), sizeof(buffer) - 1) : 0);
+		while (!line.empty() && (line.back() == '\n' || line.back() == '\r'))
+		{
+			line.pop_back();
+		}
+
+		std::lock_guard<std::mutex> guard(m_drainlock);
+		EmitLine(severity, category, line.data(), line.size());
+	}
+
+	static void FormatThread()
+	{
+		while (m_running.load(std::memory_order_acquire))
+		{
+			{
+				std::lock_guard<std::mutex> guard(m_drainlock);
+				Drain();
+			}
+
+			std::unique_lock<std::mutex> lock(m_wakelock);
+			m_wake.wait_for(lock, LOG_FLUSH_INTERVAL);
+		}
+	}
+
+	static void StdoutSink(void*, int, unsigned int, const char* line, size_t length)
+	{
+		std::fwrite(line, 1, length, stdout);
+		std::fputc('\n', stdout);
+	}
+
+	static void FileSink(void* userdata, int, unsigned int, const char* line, size_t length)
+	{
+		std::FILE* file = static_cast<std::FILE*>(userdata);
+		std::fwrite(line, 1, length, file);
+		std::fputc('\n', file);
+	}
+
+	static void FileClose(void* userdata)
+	{
+		std::fclose(static_cast<std::FILE*>(userdata));
+	}
+
+	static void SyslogSink(void*, int severity, unsigned int, const char* line, size_t length)
+	{
+#if defined(WIN32)
+		std::string text(line, length);
+		text.push_back('\n');
+		OutputDebugStringA(text.c_str());
+#elif defined(__linux__)
+		static const int priorities[] = { LOG_DEBUG, LOG_DEBUG, LOG_INFO, LOG_WARNING, LOG_ERR, LOG_CRIT };
+		syslog(priorities[std::clamp(severity, 0, 5)], "%.*s", static_cast<int>(length), line);
+#else
+		(void)severity;
+		(void)line;
+		(void)length;
+#endif
+	}
+
+	static void SyslogClose(void*)
+	{
+#if defined(__linux__)
+		closelog();
+#endif
+	}
+}
+
+using namespace engine::log;
+
+extern "C" int MetalLogInit(void)
+{
+	if (m_running.exchange(true))
+	{
+		return 1;
+	}
+
+	m_thread = std::thread(FormatThread);
+	return 0;
+}
+
+extern "C" void MetalLogShutdown(void)
+{
+	if (m_running.exchange(false))
+	{
+		m_wake.notify_all();
+		m_thread.join();
+	}
+
+	MetalLogFlush();
+
+	std::lock_guard<std::mutex> guard(m_sinklock);
+	for (const MetalLogSinkEntry& sink : m_sinks)
+	{
+		if (sink.close != nullptr)
+		{
+			sink.close(sink.userdata);
+		}
+	}
+	m_sinks.clear();
+	std::fflush(stdout);
+}
+
+extern "C" void MetalLogFlush(void)
+{
+	std::lock_guard<std::mutex> guard(m_drainlock);
+	Drain();
+
+	std::lock_guard<std::mutex> sinks(m_sinklock);
+	std::fflush(stdout);
+}
+
+extern "C" int MetalLogAddSink(MetalLogSink sink, void (*close)(void* userdata), void* userdata, int minseverity)
+{
+	if (sink == nullptr)
+	{
+		return 1;
+	}
+
+	std::lock_guard<std::mutex> guard(m_sinklock);
+	m_sinks.push_back({ sink, close, userdata, minseverity });
+	return 0;
+}
+
+extern "C" int MetalLogAddStdoutSink(int minseverity)
+{
+	return MetalLogAddSink(StdoutSink, nullptr, nullptr, minseverity);
+}
+
+extern "C" int MetalLogAddFileSink(const char* path, int minseverity)
+{
+	std::FILE* file = std::fopen(path, "a");
+	if (file == nullptr)
+	{
+		return 1;
+	}
+	return MetalLogAddSink(FileSink, FileClose, file, minseverity);
+}
+
+extern "C" int MetalLogAddSyslogSink(const char* ident, int minseverity)
+{
+#if defined(__linux__)
+	openlog(ident, LOG_PID, LOG_USER);
+#else
+	(void)ident;
+#endif
+	return MetalLogAddSink(SyslogSink, SyslogClose, nullptr, minseverity);
+}
+
+extern "C" void MetalLogWriteV(int severity, unsigned int category, unsigned int flags, const char* format, va_list args)
+{
+	if (format == nullptr)
+	{
+		return;
+	}
+
+	/* Without the formatting thread there is nobody to drain the rings*/
+	if (!m_running.load(std::memory_order_acquire))
+	{
+		WriteInline(severity, category, format, args);
+		return;
+	}
+
+	MetalLogRing* ring = t_log.ring;
+	if (ring == nullptr)
+	{
+		ring = t_log.ring = AcquireRing();
+	}
+
+	usize formatlength = (flags & METAL_LOG_COPY_FORMAT) ? strnlen(format, LOG_MAX_STRING) : 0;
+	usize formatbytes = (flags & METAL_LOG_COPY_FORMAT) ? AlignRecord(formatlength + 1) : 0;
+
+	usize argumentbytes = EncodeArguments(format, args, nullptr, 0);
+
+	usize size = sizeof(MetalLogRecord) + formatbytes + argumentbytes;
+	QWord head;
+	Byte* destination = size <= LOG_MAX_RECORD ? Reserve(ring, size, head) : nullptr;
+	if (destination == nullptr)
+	{
+		ring->dropped.fetch_add(1, std::memory_order_relaxed);
+		m_wake.notify_one();
+		return;
+	}
+
+	MetalLogRecord* record = reinterpret_cast<MetalLogRecord*>(destination);
+	record->size			= static_cast<DWord>(size);
+	record->category		= category;
+	record->severity		= static_cast<Word>(severity);
+	record->flags			= static_cast<Word>(flags);
+	record->formatlength	= static_cast<DWord>(formatlength);
+	record->time			= static_cast<QWord>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count());
+	record->format			= format;
+
+	Byte* payload = destination + sizeof(MetalLogRecord);
+	if (formatbytes != 0)
+	{
+		std::memcpy(payload, format, formatlength);
+		std::memset(payload + formatlength, 0, formatbytes - formatlength);
+		payload += formatbytes;
+	}
+
+	EncodeArguments(format, args, payload, argumentbytes);
+
+	ring->head.store(head + size, std::memory_order_release);
+
+	/* Wake the formatter early when the ring is filling up*/
+	if (head + size - ring->tail.load(std::memory_order_relaxed) > LOG_RING_SIZE / 2)
+	{
+		m_wake.notify_one();
+	}
+
+	if (severity >= METAL_LOG_FATAL)
+	{
+		MetalLogFlush();
+	}
+}
+
+extern "C" void MetalLogWrite(int severity, unsigned int category, const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	MetalLogWriteV(severity, category, 0, format, args);
+	va_end(args);
+}
+
+extern "C" unsigned long long MetalLogDropped(void)
+{
+	return m_totaldropped.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,64 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine material definitions (metadata, channel packing, GPU layout)
+// ------------------------------------------------------
+
+#include "headers/MMaterial.hpp"
+
+namespace engine::materials
+{
+	MetalGpuMaterial MakeGpuMaterial(const MetalMaterialDesc& desc, DWord basecolorslot, DWord normalslot, DWord ormslot,
+		DWord occlusionslot, DWord roughnessslot, DWord metallicslot)
+	{
+		MetalGpuMaterial material = {};
+		material.basecolorfactor	= desc.basecolorfactor;
+		material.ormconstants		= vec4f(desc.occlusion, desc.roughness, desc.metallic, 0.0f);
+		material.basecolortexture	= basecolorslot;
+		material.normaltexture		= normalslot;
+		material.ormtexture			= ormslot;
+
+		/* Without a packed texture every channel falls back to its constant*/
+		MetalChannelMap channels = desc.channels;
+		if (ormslot == MATERIAL_NO_TEXTURE)
+		{
+			channels.occlusion = MC_CONSTANT;
+			channels.roughness = MC_CONSTANT;
+			channels.metallic = MC_CONSTANT;
+		}
+		material.ormchannels		= channels.Pack();
+
+		material.occlusiontexture	= occlusionslot;
+		material.roughnesstexture	= roughnessslot;
+		material.metallictexture	= metallicslot;
+		return material;
+	}
+
+	int WritePackageMaterial(MEPF* package, const char* name, const MetalMaterialDesc& desc)
+	{
+		return MEPFAddEntry(package, name, MEPF_ENTRY_MATERIAL, &desc, sizeof(MetalMaterialDesc));
+	}
+
+	int ReadPackageMaterial(MEPF* package, const char* name, MetalMaterialDesc& desc)
+	{
+		const MEPFEntry* entry = MEPFFindEntry(package, name);
+		if (entry == nullptr || entry->type != MEPF_ENTRY_MATERIAL || entry->size != sizeof(MetalMaterialDesc))
+		{
+			return 1;
+		}
+
+		MetalMaterialDesc loaded;
+		if (MEPFReadEntry(package, entry, 0, &loaded, sizeof(loaded)) != 0 ||
+			loaded.magic != MATERIAL_MAGIC || loaded.version != MATERIAL_VERSION)
+		{
+			return 1;
+		}
+
+		desc = loaded;
+		return 0;
+	}
+}
@@ -0,0 +1,590 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine meshes (quantized vertex streams, cooking, packages)
+// ------------------------------------------------------
+
+#include "headers/MMesh.hpp"
+#include "headers/MMeshOptimizer.hpp"
+#include "headers/MMeshlet.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace engine::meshes
+{
+	static QWord AlignEntry(QWord offset)
+	{
+		return (offset + 15) & ~QWord(15);
+	}
+
+	static short FloatToSnorm16(float value)
+	{
+		value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+		return static_cast<short>(std::lround(value * 32767.0f));
+	}
+
+	void OctahedralEncode(const vec3f& vector, short encoded[2])
+	{
+		float length = std::fabs(vector.x) + std::fabs(vector.y) + std::fabs(vector.z);
+		if (length <= 0.0f)
+		{
+			encoded[0] = 0;
+			encoded[1] = 0;
+			return;
+		}
+
+		float x = vector.x / length;
+		float y = vector.y / length;
+
+		/* The lower half folds over the diagonals onto the outer triangles of the square*/
+		if (vector.z < 0.0f)
+		{
+			float foldx = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			float foldy = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = foldx;
+			y = foldy;
+		}
+
+		encoded[0] = FloatToSnorm16(x);
+		encoded[1] = FloatToSnorm16(y);
+	}
+
+	vec3f OctahedralDecode(const short encoded[2])
+	{
+		/* snorm16 maps -32768 and -32767 both to -1*/
+		float x = std::max(static_cast<float>(encoded[0]) / 32767.0f, -1.0f);
+		float y = std::max(static_cast<float>(encoded[1]) / 32767.0f, -1.0f);
+		float z = 1.0f - std::fabs(x) - std::fabs(y);
+
+		if (z < 0.0f)
+		{
+			float foldx = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			float foldy = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = foldx;
+			y = foldy;
+		}
+
+		float length = std::sqrt(x * x + y * y + z * z);
+		return vec3f(x / length, y / length, z / length);
+	}
+
+	Word FloatToHalf(float value)
+	{
+		DWord bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+
+		DWord sign = (bits >> 16) & 0x8000;
+		DWord exponent = (bits >> 23) & 0xFF;
+		DWord mantissa = bits & 0x7FFFFF;
+
+		/* Infinity and NaN (NaN keeps a mantissa bit so it stays NaN)*/
+		if (exponent == 0xFF)
+		{
+			return static_cast<Word>(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+		}
+
+		int halfexponent = static_cast<int>(exponent) - 127 + 15;
+		if (halfexponent >= 31)
+		{
+			return static_cast<Word>(sign | 0x7C00);
+		}
+
+		/* Too small for a normal half, shift into a denormal (or zero)*/
+		if (halfexponent <= 0)
+		{
+			if (halfexponent < -10)
+			{
+				return static_cast<Word>(sign);
+			}
+
+			mantissa |= 0x800000;
+			DWord shift = static_cast<DWord>(14 - halfexponent);
+			DWord halfmantissa = mantissa >> shift;
+			DWord remainder = mantissa & ((1u << shift) - 1);
+			DWord halfway = 1u << (shift - 1);
+			if (remainder > halfway || (remainder == halfway && (halfmantissa & 1)))
+			{
+				halfmantissa++;
+			}
+			return static_cast<Word>(sign | halfmantissa);
+		}
+
+		/* Round to nearest even, a carry out of the mantissa correctly bumps the exponent*/
+		DWord half = sign | (static_cast<DWord>(halfexponent) << 10) | (mantissa >> 13);
+		DWord remainder = mantissa & 0x1FFF;
+		if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+		{
+			half++;
+		}
+		return static_cast<Word>(half);
+	}
+
+	float HalfToFloat(Word value)
+	{
+		DWord sign = static_cast<DWord>(value & 0x8000) << 16;
+		DWord exponent = (value >> 10) & 0x1F;
+		DWord mantissa = value & 0x3FF;
+		DWord bits;
+
+		if (exponent == 0x1F)
+		{
+			bits = sign | 0x7F800000 | (mantissa << 13);
+		}
+		else if (exponent != 0)
+		{
+			bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+		}
+		else if (mantissa == 0)
+		{
+			bits = sign;
+		}
+		else
+		{
+			/* Denormal, normalize it*/
+			int shift = 0;
+			while ((mantissa & 0x400) == 0)
+			{
+				mantissa <<= 1;
+				shift++;
+			}
+			bits = sign | (static_cast<DWord>(127 - 15 + 1 - shift) << 23) | ((mantissa & 0x3FF) << 13);
+		}
+
+		float result;
+		std::memcpy(&result, &bits, sizeof(result));
+		return result;
+	}
+
+	/* Vertices that share a position with a vertex of another submesh, they have to stay for the LODs of
+		both submeshes to keep meeting*/
+	static void LockSubmeshBorders(const MetalMeshVertex* vertices, DWord vertexcount, const std::vector<std::vector<DWord>>& submeshes,
+		std::vector<Byte>& locked)
+	{
+		static constexpr DWord SHARED = 0xFFFFFFFF;
+		static constexpr DWord UNUSED = 0xFFFFFFFE;
+
+		std::vector<DWord> owner(vertexcount, UNUSED);
+		for (usize s = 0; s < submeshes.size(); s++)
+		{
+			for (DWord v : submeshes[s])
+			{
+				owner[v] = owner[v] == UNUSED || owner[v] == s ? static_cast<DWord>(s) : SHARED;
+			}
+		}
+
+		std::vector<DWord> order;
+		for (DWord v = 0; v < vertexcount; v++)
+		{
+			if (owner[v] != UNUSED)
+			{
+				order.push_back(v);
+			}
+		}
+
+		auto PositionLess = [&](DWord a, DWord b)
+		{
+			const vec3f& p = vertices[a].position;
+			const vec3f& q = vertices[b].position;
+			return p.x != q.x ? p.x < q.x : (p.y != q.y ? p.y < q.y : p.z < q.z);
+		};
+		std::sort(order.begin(), order.end(), PositionLess);
+
+		locked.assign(vertexcount, 0);
+		for (usize i = 0; i < order.size();)
+		{
+			usize j = i + 1;
+			bool shared = owner[order[i]] == SHARED;
+			while (j < order.size() && !PositionLess(order[i], order[j]))
+			{
+				shared = shared || owner[order[j]] != owner[order[i]];
+				j++;
+			}
+
+			for (usize k = i; k < j; k++)
+			{
+				locked[order[k]] = shared ? 1 : 0;
+			}
+			i = j;
+		}
+	}
+
+	int CookMesh(const MetalMeshVertex* vertices, DWord vertexcount, const DWord* indices, DWord indexcount,
+		const MetalCookedSubmesh* submeshes, DWord submeshcount, MetalCookedMesh& mesh, const MetalMeshCookSettings& settings)
+	{
+		if (vertices == nullptr || indices == nullptr || vertexcount == 0 || indexcount == 0 || indexcount % 3 != 0)
+		{
+			return 1;
+		}
+
+		for (DWord i = 0; i < indexcount; i++)
+		{
+			if (indices[i] >= vertexcount)
+			{
+				return 1;
+			}
+		}
+
+		std::vector<MetalCookedSubmesh> sources;
+		if (submeshes != nullptr && submeshcount != 0)
+		{
+			sources.assign(submeshes, submeshes + submeshcount);
+		}
+		else
+		{
+			sources.assign(1, MetalCookedSubmesh{ 0, indexcount, 0 });
+		}
+
+		for (const MetalCookedSubmesh& source : sources)
+		{
+			if (static_cast<QWord>(source.firstindex) + source.indexcount > indexcount || source.indexcount % 3 != 0)
+			{
+				return 1;
+			}
+		}
+
+		/* LOD 0 is the source, every further LOD is simplified from the one before it*/
+		std::vector<std::vector<std::vector<DWord>>> lods(1);
+		std::vector<float> errors(1, 0.0f);
+		for (const MetalCookedSubmesh& source : sources)
+		{
+			lods[0].emplace_back(indices + source.firstindex, indices + source.firstindex + source.indexcount);
+		}
+
+		/* Bounding cube of what is drawn, the longest side sets the scale of every axis*/
+		vec3f minimum(1e30f, 1e30f, 1e30f);
+		vec3f maximum(-1e30f, -1e30f, -1e30f);
+		for (const std::vector<DWord>& list : lods[0])
+		{
+			for (DWord v : list)
+			{
+				const vec3f& p = vertices[v].position;
+				minimum = vec3f(std::min(minimum.x, p.x), std::min(minimum.y, p.y), std::min(minimum.z, p.z));
+				maximum = vec3f(std::max(maximum.x, p.x), std::max(maximum.y, p.y), std::max(maximum.z, p.z));
+			}
+		}
+
+		if (minimum.x > maximum.x)
+		{
+			return 1;
+		}
+
+		float scale = std::max(maximum.x - minimum.x, std::max(maximum.y - minimum.y, maximum.z - minimum.z));
+		scale = scale > 0.0f ? scale : 1.0f;
+
+		std::vector<Byte> locked;
+		DWord maxlods = std::clamp<DWord>(settings.maxlods, 1, COOKED_MESH_MAX_LODS);
+		float maxerror = settings.lodmaxerror * scale;
+		if (maxlods > 1)
+		{
+			LockSubmeshBorders(vertices, vertexcount, lods[0], locked);
+		}
+
+		while (lods.size() < maxlods)
+		{
+			const std::vector<std::vector<DWord>>& previous = lods.back();
+			usize previoustotal = 0;
+			for (const std::vector<DWord>& list : previous)
+			{
+				previoustotal += list.size();
+			}
+
+			float budget = maxerror - errors.back();
+			if (previoustotal / 3 < settings.lodmintriangles || budget <= 0.0f)
+			{
+				break;
+			}
+
+			std::vector<std::vector<DWord>> next(previous.size());
+			usize total = 0;
+			float worst = 0.0f;
+			for (usize s = 0; s < previous.size(); s++)
+			{
+				DWord count = static_cast<DWord>(previous[s].size());
+				DWord target = static_cast<DWord>(static_cast<float>(count / 3) * settings.lodreduction) * 3;
+				float error = 0.0f;
+
+				next[s].resize(count);
+				next[s].resize(SimplifyMesh(next[s].data(), previous[s].data(), count, vertices, vertexcount, locked.data(), target, budget, &error));
+				total += next[s].size();
+				worst = std::max(worst, error);
+			}
+
+			/* A LOD that saves less than a quarter of the triangles is not worth its memory, and the ones after it won't be either*/
+			if (total * 4 > previoustotal * 3)
+			{
+				break;
+			}
+
+			/* Each LOD's error is measured against the one before it, added up they bound the distance to LOD 0*/
+			lods.push_back(std::move(next));
+			errors.push_back(errors.back() + worst);
+		}
+
+		if (settings.optimize)
+		{
+			std::vector<DWord> clusters;
+			for (std::vector<std::vector<DWord>>& lod : lods)
+			{
+				for (std::vector<DWord>& list : lod)
+				{
+					OptimizeVertexCache(list.data(), static_cast<DWord>(list.size()), vertexcount, &clusters);
+					OptimizeOverdraw(list.data(), static_cast<DWord>(list.size()), vertices, vertexcount, clusters);
+				}
+			}
+		}
+
+		/* One index buffer, LOD major and submesh minor*/
+		std::vector<DWord> combined;
+		mesh.lods.clear();
+		mesh.submeshes.clear();
+		for (usize l = 0; l < lods.size(); l++)
+		{
+			MetalCookedLod lod = {};
+			lod.firstindex = static_cast<DWord>(combined.size());
+			lod.error = errors[l];
+
+			for (usize s = 0; s < lods[l].size(); s++)
+			{
+				mesh.submeshes.push_back(MetalCookedSubmesh{ static_cast<DWord>(combined.size()), static_cast<DWord>(lods[l][s].size()), sources[s].material });
+				combined.insert(combined.end(), lods[l][s].begin(), lods[l][s].end());
+			}
+
+			lod.indexcount = static_cast<DWord>(combined.size()) - lod.firstindex;
+			mesh.lods.push_back(lod);
+		}
+
+		/* Vertices in the order LOD 0 first uses them, the coarser LODs only use a subset*/
+		std::vector<DWord> order;
+		if (settings.optimize)
+		{
+			std::vector<DWord> remap;
+			order.resize(OptimizeVertexFetch(combined.data(), static_cast<DWord>(combined.size()), vertexcount, remap));
+			for (DWord v = 0; v < vertexcount; v++)
+			{
+				if (remap[v] != 0xFFFFFFFF)
+				{
+					order[remap[v]] = v;
+				}
+			}
+		}
+		else
+		{
+			order.resize(vertexcount);
+			for (DWord v = 0; v < vertexcount; v++)
+			{
+				order[v] = v;
+			}
+		}
+
+		DWord cookedcount = static_cast<DWord>(order.size());
+		vec3f center((minimum.x + maximum.x) * 0.5f, (minimum.y + maximum.y) * 0.5f, (minimum.z + maximum.z) * 0.5f);
+		float radius = 0.0f;
+		for (DWord v : combined)
+		{
+			const vec3f& p = vertices[order[v]].position;
+			float dx = p.x - center.x, dy = p.y - center.y, dz = p.z - center.z;
+			radius = std::max(radius, dx * dx + dy * dy + dz * dz);
+		}
+
+		MetalCookedMeshHeader& header = mesh.header;
+		header = {};
+		header.magic			= COOKED_MESH_MAGIC;
+		header.version			= COOKED_MESH_VERSION;
+		header.vertexcount		= cookedcount;
+		header.indexcount		= static_cast<DWord>(combined.size());
+		header.indexsize		= cookedcount <= 0x10000 ? 2 : 4;
+		header.submeshcount		= static_cast<DWord>(sources.size());
+		header.lodcount			= static_cast<DWord>(mesh.lods.size());
+		header.meshletcount		= 0;
+		header.boundsmin[0]		= minimum.x;
+		header.boundsmin[1]		= minimum.y;
+		header.boundsmin[2]		= minimum.z;
+		header.boundsscale		= scale;
+		header.boundingsphere[0] = center.x;
+		header.boundingsphere[1] = center.y;
+		header.boundingsphere[2] = center.z;
+		header.boundingsphere[3] = std::sqrt(radius);
+
+		mesh.positions.resize(cookedcount);
+		mesh.attributes.resize(cookedcount);
+		for (DWord i = 0; i < cookedcount; i++)
+		{
+			const MetalMeshVertex& vertex = vertices[order[i]];
+			MetalPackedPosition& position = mesh.positions[i];
+			position.x = static_cast<Word>(std::lround(std::clamp((vertex.position.x - minimum.x) / scale, 0.0f, 1.0f) * 65535.0f));
+			position.y = static_cast<Word>(std::lround(std::clamp((vertex.position.y - minimum.y) / scale, 0.0f, 1.0f) * 65535.0f));
+			position.z = static_cast<Word>(std::lround(std::clamp((vertex.position.z - minimum.z) / scale, 0.0f, 1.0f) * 65535.0f));
+			position.w = vertex.tangent.w < 0.0f ? 0 : 65535;
+
+			MetalPackedAttributes& attributes = mesh.attributes[i];
+			OctahedralEncode(vertex.normal, attributes.normal);
+			OctahedralEncode(vec3f(vertex.tangent.x, vertex.tangent.y, vertex.tangent.z), attributes.tangent);
+			attributes.uv[0] = FloatToHalf(vertex.uv.x);
+			attributes.uv[1] = FloatToHalf(vertex.uv.y);
+		}
+
+		/* Clusters of every LOD, their bounds get half a quantization step of slack so they hold the dequantized triangles*/
+		mesh.meshlets.clear();
+		if (settings.meshlets)
+		{
+			std::vector<MetalMeshVertex> ordered(cookedcount);
+			for (DWord i = 0; i < cookedcount; i++)
+			{
+				ordered[i] = vertices[order[i]];
+			}
+
+			for (usize l = 0; l < mesh.lods.size(); l++)
+			{
+				MetalCookedLod& lod = mesh.lods[l];
+				lod.firstmeshlet = static_cast<DWord>(mesh.meshlets.size());
+				for (DWord s = 0; s < header.submeshcount; s++)
+				{
+					const MetalCookedSubmesh& submesh = mesh.submeshes[l * header.submeshcount + s];
+					BuildMeshlets(combined.data() + submesh.firstindex, submesh.firstindex, submesh.indexcount, ordered.data(), cookedcount, s, mesh.meshlets);
+				}
+				lod.meshletcount = static_cast<DWord>(mesh.meshlets.size()) - lod.firstmeshlet;
+			}
+
+			float slack = scale / 65535.0f;
+			for (MetalCookedMeshlet& meshlet : mesh.meshlets)
+			{
+				meshlet.radius += slack;
+			}
+			header.meshletcount = static_cast<DWord>(mesh.meshlets.size());
+		}
+
+		mesh.indices.resize(combined.size() * header.indexsize);
+		if (header.indexsize == 2)
+		{
+			Word* packed = reinterpret_cast<Word*>(mesh.indices.data());
+			for (usize i = 0; i < combined.size(); i++)
+			{
+				packed[i] = static_cast<Word>(combined[i]);
+			}
+		}
+		else
+		{
+			std::memcpy(mesh.indices.data(), combined.data(), mesh.indices.size());
+		}
+
+		/* Streams back to back after the tables, each on a 16 byte boundary*/
+		header.positionoffset	= AlignEntry(sizeof(MetalCookedMeshHeader) + sizeof(MetalCookedLod) * mesh.lods.size() +
+			sizeof(MetalCookedSubmesh) * mesh.submeshes.size() + sizeof(MetalCookedMeshlet) * mesh.meshlets.size());
+		header.attributeoffset	= AlignEntry(header.positionoffset + sizeof(MetalPackedPosition) * cookedcount);
+		header.indexoffset		= AlignEntry(header.attributeoffset + sizeof(MetalPackedAttributes) * cookedcount);
+		header.datasize			= header.indexoffset + mesh.indices.size() - header.positionoffset;
+		return 0;
+	}
+
+	int WritePackageMesh(MEPF* package, const char* name, const MetalCookedMesh& mesh)
+	{
+		const MetalCookedMeshHeader& header = mesh.header;
+		if (header.magic != COOKED_MESH_MAGIC || mesh.lods.size() != header.lodcount ||
+			mesh.submeshes.size() != static_cast<usize>(header.submeshcount) * header.lodcount || mesh.meshlets.size() != header.meshletcount ||
+			mesh.positions.size() != header.vertexcount || mesh.attributes.size() != header.vertexcount)
+		{
+			return 1;
+		}
+
+		std::vector<Byte> entry(header.positionoffset + header.datasize, 0);
+		std::memcpy(entry.data(), &header, sizeof(header));
+		Byte* tables = entry.data() + sizeof(header);
+		std::memcpy(tables, mesh.lods.data(), sizeof(MetalCookedLod) * mesh.lods.size());
+		tables += sizeof(MetalCookedLod) * mesh.lods.size();
+		std::memcpy(tables, mesh.submeshes.data(), sizeof(MetalCookedSubmesh) * mesh.submeshes.size());
+		tables += sizeof(MetalCookedSubmesh) * mesh.submeshes.size();
+		std::memcpy(tables, mesh.meshlets.data(), sizeof(MetalCookedMeshlet) * mesh.meshlets.size());
+		std::memcpy(entry.data() + header.positionoffset, mesh.positions.data(), sizeof(MetalPackedPosition) * mesh.positions.size());
+		std::memcpy(entry.data() + header.attributeoffset, mesh.attributes.data(), sizeof(MetalPackedAttributes) * mesh.attributes.size());
+		std::memcpy(entry.data() + header.indexoffset, mesh.indices.data(), mesh.indices.size());
+		return MEPFAddEntry(package, name, MEPF_ENTRY_MESH, entry.data(), entry.size());
+	}
+
+	int ReadPackageMesh(MEPF* package, const char* name, MetalPackageMesh& mesh)
+	{
+		const MEPFEntry* entry = MEPFFindEntry(package, name);
+		if (entry == nullptr || entry->type != MEPF_ENTRY_MESH)
+		{
+			return 1;
+		}
+
+		/* The stream layout is baked into the vertex input, an older cook would be read wrong*/
+		MetalCookedMeshHeader header;
+		if (MEPFReadEntry(package, entry, 0, &header, sizeof(header)) != 0 || header.magic != COOKED_MESH_MAGIC ||
+			header.version != COOKED_MESH_VERSION || (header.indexsize != 2 && header.indexsize != 4) ||
+			header.lodcount == 0 || header.lodcount > COOKED_MESH_MAX_LODS || header.positionoffset + header.datasize > entry->size)
+		{
+			return 1;
+		}
+
+		mesh.lods.resize(header.lodcount);
+		mesh.submeshes.resize(static_cast<usize>(header.submeshcount) * header.lodcount);
+		mesh.meshlets.resize(header.meshletcount);
+
+		QWord lodsize = sizeof(MetalCookedLod) * mesh.lods.size();
+		QWord submeshsize = sizeof(MetalCookedSubmesh) * mesh.submeshes.size();
+		QWord meshletsize = sizeof(MetalCookedMeshlet) * mesh.meshlets.size();
+		if (sizeof(header) + lodsize + submeshsize + meshletsize > header.positionoffset ||
+			MEPFReadEntry(package, entry, sizeof(header), mesh.lods.data(), lodsize) != 0 ||
+			(submeshsize != 0 && MEPFReadEntry(package, entry, sizeof(header) + lodsize, mesh.submeshes.data(), submeshsize) != 0) ||
+			(meshletsize != 0 && MEPFReadEntry(package, entry, sizeof(header) + lodsize + submeshsize, mesh.meshlets.data(), meshletsize) != 0))
+		{
+			return 1;
+		}
+
+		mesh.package = package;
+		mesh.entry = entry;
+		mesh.header = header;
+		return 0;
+	}
+
+	float LodProjectionScale(float fovy, float screenheight)
+	{
+		return screenheight / (2.0f * std::tan(fovy * 0.5f));
+	}
+
+	DWord SelectMeshLod(const MetalCookedLod* lods, DWord lodcount, float scale, float distance, float projectionscale, float threshold)
+	{
+		/* Inside the sphere the distance goes to nothing and LOD 0 wins*/
+		float pixels = scale * projectionscale / std::max(distance, 1e-4f);
+		for (DWord lod = lodcount; lod > 1; lod--)
+		{
+			if (lods[lod - 1].error * pixels <= threshold)
+			{
+				return lod - 1;
+			}
+		}
+		return 0;
+	}
+
+	mat4f MakeDequantizeMatrix(const MetalCookedMeshHeader& header)
+	{
+		float s = header.boundsscale;
+		return mat4f(
+			vec4f(s, 0.0f, 0.0f, header.boundsmin[0]),
+			vec4f(0.0f, s, 0.0f, header.boundsmin[1]),
+			vec4f(0.0f, 0.0f, s, header.boundsmin[2]),
+			vec4f(0.0f, 0.0f, 0.0f, 1.0f));
+	}
+
+	MetalMeshVertex UnpackVertex(const MetalCookedMeshHeader& header, const MetalPackedPosition& position, const MetalPackedAttributes& attributes)
+	{
+		MetalMeshVertex vertex;
+		vertex.position = vec3f(
+			header.boundsmin[0] + static_cast<float>(position.x) / 65535.0f * header.boundsscale,
+			header.boundsmin[1] + static_cast<float>(position.y) / 65535.0f * header.boundsscale,
+			header.boundsmin[2] + static_cast<float>(position.z) / 65535.0f * header.boundsscale);
+		vertex.normal = OctahedralDecode(attributes.normal);
+
+		vec3f tangent = OctahedralDecode(attributes.tangent);
+		vertex.tangent = vec4f(tangent.x, tangent.y, tangent.z, position.w >= 32768 ? 1.0f : -1.0f);
+		vertex.uv = vec2f(HalfToFloat(attributes.uv[0]), HalfToFloat(attributes.uv[1]));
+		return vertex;
+	}
+}
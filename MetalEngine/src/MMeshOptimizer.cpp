@@ -0,0 +1,705 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine mesh optimizer (vertex cache, overdraw and fetch ordering, simplification)
+// ------------------------------------------------------
+
+#include "headers/MMeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace engine::meshes
+{
+	static constexpr DWord INVALID_VERTEX = 0xFFFFFFFF;
+
+	/* Triangles around every vertex, triangles[offsets[v]] to triangles[offsets[v + 1]]*/
+	struct MetalTriangleAdjacency
+	{
+		std::vector<DWord>	offsets;
+		std::vector<DWord>	triangles;
+	};
+
+	static void BuildAdjacency(const DWord* indices, DWord indexcount, DWord vertexcount, MetalTriangleAdjacency& adjacency)
+	{
+		adjacency.offsets.assign(static_cast<usize>(vertexcount) + 1, 0);
+		for (DWord i = 0; i < indexcount; i++)
+		{
+			adjacency.offsets[indices[i] + 1]++;
+		}
+
+		for (DWord v = 0; v < vertexcount; v++)
+		{
+			adjacency.offsets[v + 1] += adjacency.offsets[v];
+		}
+
+		adjacency.triangles.resize(indexcount);
+		std::vector<DWord> cursor(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+		for (DWord i = 0; i < indexcount; i++)
+		{
+			adjacency.triangles[cursor[indices[i]]++] = i / 3;
+		}
+	}
+
+	static vec3f Subtract(const vec3f& a, const vec3f& b)
+	{
+		return vec3f(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	static vec3f Cross(const vec3f& a, const vec3f& b)
+	{
+		return vec3f(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	static float Dot(const vec3f& a, const vec3f& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	void OptimizeVertexCache(DWord* indices, DWord indexcount, DWord vertexcount, std::vector<DWord>* clusters)
+	{
+		DWord trianglecount = indexcount / 3;
+		if (clusters != nullptr)
+		{
+			clusters->clear();
+		}
+
+		if (trianglecount == 0 || vertexcount == 0)
+		{
+			return;
+		}
+
+		MetalTriangleAdjacency adjacency;
+		BuildAdjacency(indices, trianglecount * 3, vertexcount, adjacency);
+
+		std::vector<DWord> live(vertexcount);
+		for (DWord v = 0; v < vertexcount; v++)
+		{
+			live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+		}
+
+		std::vector<DWord> cachetime(vertexcount, 0);
+		std::vector<Byte> emitted(trianglecount, 0);
+		std::vector<DWord> deadend;
+		std::vector<DWord> candidates;
+		std::vector<DWord> result;
+		deadend.reserve(static_cast<usize>(trianglecount) * 3);
+		result.reserve(static_cast<usize>(trianglecount) * 3);
+
+		DWord timestamp = VERTEX_CACHE_SIZE + 1;
+		DWord scan = 0;
+		DWord fan = 0;
+		bool restart = true;
+
+		while (fan != INVALID_VERTEX)
+		{
+			/* Emit every triangle left around the fanning vertex*/
+			candidates.clear();
+			for (DWord a = adjacency.offsets[fan]; a < adjacency.offsets[fan + 1]; a++)
+			{
+				DWord triangle = adjacency.triangles[a];
+				if (emitted[triangle])
+				{
+					continue;
+				}
+
+				if (restart && clusters != nullptr)
+				{
+					clusters->push_back(static_cast<DWord>(result.size() / 3));
+				}
+				restart = false;
+
+				for (DWord k = 0; k < 3; k++)
+				{
+					DWord v = indices[triangle * 3 + k];
+					result.push_back(v);
+					deadend.push_back(v);
+					candidates.push_back(v);
+					live[v]--;
+					if (timestamp - cachetime[v] > VERTEX_CACHE_SIZE)
+					{
+						cachetime[v] = timestamp++;
+					}
+				}
+				emitted[triangle] = 1;
+			}
+
+			/* Next fan is the oldest candidate that stays in the cache while its own triangles are emitted*/
+			DWord next = INVALID_VERTEX;
+			long long best = -1;
+			for (DWord v : candidates)
+			{
+				if (live[v] == 0)
+				{
+					continue;
+				}
+
+				long long priority = 0;
+				if (timestamp - cachetime[v] + 2 * live[v] <= VERTEX_CACHE_SIZE)
+				{
+					priority = timestamp - cachetime[v];
+				}
+
+				if (priority > best)
+				{
+					best = priority;
+					next = v;
+				}
+			}
+
+			/* Dead end, back up to the most recent vertex with work left and only then scan for one*/
+			if (next == INVALID_VERTEX)
+			{
+				restart = true;
+				while (!deadend.empty() && next == INVALID_VERTEX)
+				{
+					DWord v = deadend.back();
+					deadend.pop_back();
+					next = live[v] > 0 ? v : INVALID_VERTEX;
+				}
+
+				while (next == INVALID_VERTEX && scan < vertexcount)
+				{
+					next = live[scan] > 0 ? scan : INVALID_VERTEX;
+					scan++;
+				}
+			}
+
+			fan = next;
+		}
+
+		std::memcpy(indices, result.data(), sizeof(DWord) * result.size());
+	}
+
+	float AnalyzeVertexCache(const DWord* indices, DWord indexcount, DWord vertexcount, DWord cachesize)
+	{
+		DWord trianglecount = indexcount / 3;
+		if (trianglecount == 0)
+		{
+			return 0.0f;
+		}
+
+		std::vector<DWord> cachetime(vertexcount, 0);
+		DWord timestamp = cachesize + 1;
+		DWord misses = 0;
+		for (DWord i = 0; i < trianglecount * 3; i++)
+		{
+			DWord v = indices[i];
+			if (timestamp - cachetime[v] > cachesize)
+			{
+				cachetime[v] = timestamp++;
+				misses++;
+			}
+		}
+
+		return static_cast<float>(misses) / static_cast<float>(trianglecount);
+	}
+
+	void OptimizeOverdraw(DWord* indices, DWord indexcount, const MetalMeshVertex* vertices, DWord vertexcount,
+		const std::vector<DWord>& clusters, float threshold)
+	{
+		DWord trianglecount = indexcount / 3;
+		if (trianglecount == 0 || clusters.empty())
+		{
+			return;
+		}
+
+		/* Split the cache runs wherever a prefix is already about as good as the whole run, with a cold cache
+			after every split so a cluster drawn in any order keeps its hit rate*/
+		std::vector<DWord> cachetime(vertexcount, 0);
+		DWord timestamp = VERTEX_CACHE_SIZE + 1;
+		auto Simulate = [&](DWord triangle)
+		{
+			DWord misses = 0;
+			for (DWord k = 0; k < 3; k++)
+			{
+				DWord v = indices[triangle * 3 + k];
+				if (timestamp - cachetime[v] > VERTEX_CACHE_SIZE)
+				{
+					cachetime[v] = timestamp++;
+					misses++;
+				}
+			}
+			return misses;
+		};
+
+		std::vector<DWord> splits;
+		for (usize c = 0; c < clusters.size(); c++)
+		{
+			DWord start = clusters[c];
+			DWord end = c + 1 < clusters.size() ? clusters[c + 1] : trianglecount;
+			if (start >= end)
+			{
+				continue;
+			}
+
+			timestamp += VERTEX_CACHE_SIZE + 1;
+			DWord misses = 0;
+			for (DWord t = start; t < end; t++)
+			{
+				misses += Simulate(t);
+			}
+			float clusteracmr = static_cast<float>(misses) / static_cast<float>(end - start);
+
+			splits.push_back(start);
+			timestamp += VERTEX_CACHE_SIZE + 1;
+			DWord runstart = start;
+			DWord runmisses = 0;
+			for (DWord t = start; t < end; t++)
+			{
+				runmisses += Simulate(t);
+				float acmr = static_cast<float>(runmisses) / static_cast<float>(t + 1 - runstart);
+				if (t + 1 < end && acmr <= clusteracmr * threshold)
+				{
+					splits.push_back(t + 1);
+					runstart = t + 1;
+					runmisses = 0;
+					timestamp += VERTEX_CACHE_SIZE + 1;
+				}
+			}
+		}
+
+		/* Area weighted centroid and normal per cluster*/
+		struct MetalOverdrawCluster
+		{
+			DWord	start;
+			DWord	end;
+			float	sort;
+		};
+
+		std::vector<MetalOverdrawCluster> sorted(splits.size());
+		std::vector<vec3f> centroids(splits.size());
+		std::vector<vec3f> normals(splits.size());
+		vec3f meshcentroid(0.0f, 0.0f, 0.0f);
+		float mesharea = 0.0f;
+
+		for (usize c = 0; c < splits.size(); c++)
+		{
+			sorted[c].start = splits[c];
+			sorted[c].end = c + 1 < splits.size() ? splits[c + 1] : trianglecount;
+
+			vec3f centroid(0.0f, 0.0f, 0.0f);
+			vec3f normal(0.0f, 0.0f, 0.0f);
+			float area = 0.0f;
+			for (DWord t = sorted[c].start; t < sorted[c].end; t++)
+			{
+				const vec3f& p0 = vertices[indices[t * 3 + 0]].position;
+				const vec3f& p1 = vertices[indices[t * 3 + 1]].position;
+				const vec3f& p2 = vertices[indices[t * 3 + 2]].position;
+				vec3f n = Cross(Subtract(p1, p0), Subtract(p2, p0));
+				float a = std::sqrt(Dot(n, n));
+
+				centroid = vec3f(centroid.x + (p0.x + p1.x + p2.x) * a, centroid.y + (p0.y + p1.y + p2.y) * a, centroid.z + (p0.z + p1.z + p2.z) * a);
+				normal = vec3f(normal.x + n.x, normal.y + n.y, normal.z + n.z);
+				area += a;
+			}
+
+			meshcentroid = vec3f(meshcentroid.x + centroid.x, meshcentroid.y + centroid.y, meshcentroid.z + centroid.z);
+			mesharea += area;
+
+			float inverse = area > 0.0f ? 1.0f / (area * 3.0f) : 0.0f;
+			centroids[c] = vec3f(centroid.x * inverse, centroid.y * inverse, centroid.z * inverse);
+			float length = std::sqrt(Dot(normal, normal));
+			normals[c] = length > 0.0f ? vec3f(normal.x / length, normal.y / length, normal.z / length) : vec3f(0.0f, 0.0f, 0.0f);
+		}
+
+		float meshinverse = mesharea > 0.0f ? 1.0f / (mesharea * 3.0f) : 0.0f;
+		meshcentroid = vec3f(meshcentroid.x * meshinverse, meshcentroid.y * meshinverse, meshcentroid.z * meshinverse);
+
+		/* Clusters facing away from the middle of the mesh are the ones in front from most directions*/
+		for (usize c = 0; c < sorted.size(); c++)
+		{
+			sorted[c].sort = Dot(Subtract(centroids[c], meshcentroid), normals[c]);
+		}
+
+		std::stable_sort(sorted.begin(), sorted.end(), [](const MetalOverdrawCluster& a, const MetalOverdrawCluster& b) { return a.sort > b.sort; });
+
+		std::vector<DWord> result;
+		result.reserve(static_cast<usize>(trianglecount) * 3);
+		for (const MetalOverdrawCluster& cluster : sorted)
+		{
+			result.insert(result.end(), indices + cluster.start * 3, indices + cluster.end * 3);
+		}
+		std::memcpy(indices, result.data(), sizeof(DWord) * result.size());
+	}
+
+	DWord OptimizeVertexFetch(DWord* indices, DWord indexcount, DWord vertexcount, std::vector<DWord>& remap)
+	{
+		remap.assign(vertexcount, INVALID_VERTEX);
+		DWord next = 0;
+		for (DWord i = 0; i < indexcount; i++)
+		{
+			DWord& v = remap[indices[i]];
+			if (v == INVALID_VERTEX)
+			{
+				v = next++;
+			}
+			indices[i] = v;
+		}
+		return next;
+	}
+
+	/* Sum of squared distances to a set of planes, weighted by area (or edge length for borders)*/
+	struct MetalQuadric
+	{
+		double	a2, b2, c2, d2;
+		double	ab, ac, ad;
+		double	bc, bd, cd;
+		double	weight;
+	};
+
+	static void QuadricAddPlane(MetalQuadric& q, const vec3f& normal, float distance, double weight)
+	{
+		double a = normal.x, b = normal.y, c = normal.z, d = distance;
+		q.a2 += a * a * weight;
+		q.b2 += b * b * weight;
+		q.c2 += c * c * weight;
+		q.d2 += d * d * weight;
+		q.ab += a * b * weight;
+		q.ac += a * c * weight;
+		q.ad += a * d * weight;
+		q.bc += b * c * weight;
+		q.bd += b * d * weight;
+		q.cd += c * d * weight;
+		q.weight += weight;
+	}
+
+	static void QuadricAdd(MetalQuadric& q, const MetalQuadric& r)
+	{
+		q.a2 += r.a2; q.b2 += r.b2; q.c2 += r.c2; q.d2 += r.d2;
+		q.ab += r.ab; q.ac += r.ac; q.ad += r.ad;
+		q.bc += r.bc; q.bd += r.bd; q.cd += r.cd;
+		q.weight += r.weight;
+	}
+
+	/* Mean squared distance of p to the planes of q and r together*/
+	static double QuadricError(const MetalQuadric& q, const MetalQuadric& r, const vec3f& p)
+	{
+		double x = p.x, y = p.y, z = p.z;
+		double a2 = q.a2 + r.a2, b2 = q.b2 + r.b2, c2 = q.c2 + r.c2, d2 = q.d2 + r.d2;
+		double ab = q.ab + r.ab, ac = q.ac + r.ac, ad = q.ad + r.ad;
+		double bc = q.bc + r.bc, bd = q.bd + r.bd, cd = q.cd + r.cd;
+		double weight = q.weight + r.weight;
+
+		double rx = a2 * x + ab * y + ac * z;
+		double ry = ab * x + b2 * y + bc * z;
+		double rz = ac * x + bc * y + c2 * z;
+		double error = rx * x + ry * y + rz * z + 2.0 * (ad * x + bd * y + cd * z) + d2;
+		return weight > 0.0 ? std::fabs(error) / weight : 0.0;
+	}
+
+	/* Borders pull about as hard as the surface, without this they shrink in on themselves*/
+	static constexpr double SIMPLIFY_BORDER_WEIGHT = 10.0;
+
+	/* A triangle around a collapsing vertex may turn by at most this much (cosine)*/
+	static constexpr float SIMPLIFY_MAX_FLIP = 0.25f;
+
+	enum MetalSimplifyVertex : Byte
+	{
+		MSV_INTERIOR	= 0,
+		MSV_BORDER		= 1,
+		MSV_LOCKED		= 2
+	};
+
+	struct MetalCollapse
+	{
+		float	cost;
+		DWord	from;
+		DWord	to;
+	};
+
+	static QWord EdgeKey(DWord a, DWord b)
+	{
+		return (static_cast<QWord>(a) << 32) | b;
+	}
+
+	DWord SimplifyMesh(DWord* destination, const DWord* indices, DWord indexcount, const MetalMeshVertex* vertices, DWord vertexcount,
+		const Byte* locked, DWord targetindexcount, float targeterror, float* resulterror)
+	{
+		indexcount -= indexcount % 3;
+		std::vector<DWord> current(indices, indices + indexcount);
+		if (resulterror != nullptr)
+		{
+			*resulterror = 0.0f;
+		}
+
+		/* Weld by position, vertices that share one are the sides of a seam*/
+		std::vector<DWord> order;
+		std::vector<Byte> used(vertexcount, 0);
+		for (DWord i = 0; i < indexcount; i++)
+		{
+			used[indices[i]] = 1;
+		}
+		for (DWord v = 0; v < vertexcount; v++)
+		{
+			if (used[v])
+			{
+				order.push_back(v);
+			}
+		}
+
+		auto PositionLess = [&](DWord a, DWord b)
+		{
+			const vec3f& p = vertices[a].position;
+			const vec3f& q = vertices[b].position;
+			return p.x != q.x ? p.x < q.x : (p.y != q.y ? p.y < q.y : p.z < q.z);
+		};
+		std::sort(order.begin(), order.end(), PositionLess);
+
+		std::vector<DWord> position(vertexcount, INVALID_VERTEX);
+		std::vector<Byte> fixed(vertexcount, 0);
+		for (usize i = 0; i < order.size();)
+		{
+			usize j = i + 1;
+			while (j < order.size() && !PositionLess(order[i], order[j]))
+			{
+				j++;
+			}
+
+			for (usize k = i; k < j; k++)
+			{
+				position[order[k]] = order[i];
+				fixed[order[k]] = (j - i > 1 || (locked != nullptr && locked[order[k]])) ? 1 : 0;
+			}
+			i = j;
+		}
+
+		/* Directed edges in position space, an edge without its reverse is on a border*/
+		std::vector<QWord> edges;
+		auto BuildEdges = [&]()
+		{
+			edges.clear();
+			for (usize i = 0; i < current.size(); i += 3)
+			{
+				for (DWord k = 0; k < 3; k++)
+				{
+					edges.push_back(EdgeKey(position[current[i + k]], position[current[i + (k + 1) % 3]]));
+				}
+			}
+			std::sort(edges.begin(), edges.end());
+		};
+		auto EdgeCount = [&](DWord a, DWord b)
+		{
+			auto range = std::equal_range(edges.begin(), edges.end(), EdgeKey(position[a], position[b]));
+			return static_cast<DWord>(range.second - range.first);
+		};
+
+		std::vector<MetalQuadric> quadrics(vertexcount, MetalQuadric{});
+		BuildEdges();
+		for (usize i = 0; i < current.size(); i += 3)
+		{
+			const vec3f& p0 = vertices[current[i + 0]].position;
+			const vec3f& p1 = vertices[current[i + 1]].position;
+			const vec3f& p2 = vertices[current[i + 2]].position;
+			vec3f normal = Cross(Subtract(p1, p0), Subtract(p2, p0));
+			float length = std::sqrt(Dot(normal, normal));
+			if (length <= 0.0f)
+			{
+				continue;
+			}
+			normal = vec3f(normal.x / length, normal.y / length, normal.z / length);
+
+			MetalQuadric plane = {};
+			QuadricAddPlane(plane, normal, -Dot(normal, p0), length * 0.5f);
+			for (DWord k = 0; k < 3; k++)
+			{
+				QuadricAdd(quadrics[current[i + k]], plane);
+			}
+
+			for (DWord k = 0; k < 3; k++)
+			{
+				DWord a = current[i + k];
+				DWord b = current[i + (k + 1) % 3];
+				if (EdgeCount(b, a) != 0)
+				{
+					continue;
+				}
+
+				/* A plane through the border edge, standing up from the triangle*/
+				vec3f edge = Subtract(vertices[b].position, vertices[a].position);
+				vec3f side = Cross(edge, normal);
+				float sidelength = std::sqrt(Dot(side, side));
+				if (sidelength <= 0.0f)
+				{
+					continue;
+				}
+				side = vec3f(side.x / sidelength, side.y / sidelength, side.z / sidelength);
+
+				MetalQuadric border = {};
+				QuadricAddPlane(border, side, -Dot(side, vertices[a].position), Dot(edge, edge) * SIMPLIFY_BORDER_WEIGHT);
+				QuadricAdd(quadrics[a], border);
+				QuadricAdd(quadrics[b], border);
+			}
+		}
+
+		double maximumcost = static_cast<double>(targeterror) * targeterror;
+		double worst = 0.0;
+		MetalTriangleAdjacency adjacency;
+		std::vector<Byte> kind(vertexcount);
+		std::vector<Byte> touched(vertexcount);
+		std::vector<MetalCollapse> collapses;
+
+		/* Passes of independent collapses, cheapest first, until the target or the error bound is hit*/
+		while (current.size() > targetindexcount)
+		{
+			BuildEdges();
+			BuildAdjacency(current.data(), static_cast<DWord>(current.size()), vertexcount, adjacency);
+
+			for (DWord v = 0; v < vertexcount; v++)
+			{
+				kind[v] = fixed[v] ? MSV_LOCKED : MSV_INTERIOR;
+			}
+
+			for (usize i = 0; i < current.size(); i += 3)
+			{
+				for (DWord k = 0; k < 3; k++)
+				{
+					DWord a = current[i + k];
+					DWord b = current[i + (k + 1) % 3];
+					DWord forward = EdgeCount(a, b);
+					DWord backward = EdgeCount(b, a);
+					if (forward > 1 || backward > 1)
+					{
+						kind[a] = MSV_LOCKED;
+						kind[b] = MSV_LOCKED;
+					}
+					else if (backward == 0)
+					{
+						kind[a] = std::max<Byte>(kind[a], MSV_BORDER);
+						kind[b] = std::max<Byte>(kind[b], MSV_BORDER);
+					}
+				}
+			}
+
+			collapses.clear();
+			for (usize i = 0; i < current.size(); i += 3)
+			{
+				for (DWord k = 0; k < 3; k++)
+				{
+					DWord a = current[i + k];
+					DWord b = current[i + (k + 1) % 3];
+					bool border = EdgeCount(b, a) == 0;
+
+					/* Borders only slide along themselves, anything else would tear the outline*/
+					bool forward = kind[a] == MSV_INTERIOR || (kind[a] == MSV_BORDER && border);
+					bool backward = kind[b] == MSV_INTERIOR || (kind[b] == MSV_BORDER && border);
+					if (!forward && !backward)
+					{
+						continue;
+					}
+
+					double forwardcost = forward ? QuadricError(quadrics[a], quadrics[b], vertices[b].position) : 1e30;
+					double backwardcost = backward ? QuadricError(quadrics[a], quadrics[b], vertices[a].position) : 1e30;
+					if (forwardcost <= backwardcost)
+					{
+						collapses.push_back(MetalCollapse{ static_cast<float>(forwardcost), a, b });
+					}
+					else
+					{
+						collapses.push_back(MetalCollapse{ static_cast<float>(backwardcost), b, a });
+					}
+				}
+			}
+
+			std::sort(collapses.begin(), collapses.end(), [](const MetalCollapse& x, const MetalCollapse& y) { return x.cost < y.cost; });
+			std::fill(touched.begin(), touched.end(), 0);
+
+			usize remaining = current.size();
+			DWord applied = 0;
+			for (const MetalCollapse& collapse : collapses)
+			{
+				if (remaining <= targetindexcount || collapse.cost > maximumcost)
+				{
+					break;
+				}
+
+				if (touched[collapse.from] || touched[collapse.to])
+				{
+					continue;
+				}
+
+				/* Reject collapses that flip or squash a triangle staying around the vertex*/
+				const vec3f& target = vertices[collapse.to].position;
+				bool valid = true;
+				for (DWord a = adjacency.offsets[collapse.from]; a < adjacency.offsets[collapse.from + 1] && valid; a++)
+				{
+					const DWord* triangle = &current[adjacency.triangles[a] * 3];
+					if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+					{
+						continue;
+					}
+
+					DWord k = triangle[0] == collapse.from ? 0 : (triangle[1] == collapse.from ? 1 : 2);
+					const vec3f& p0 = vertices[triangle[k]].position;
+					const vec3f& p1 = vertices[triangle[(k + 1) % 3]].position;
+					const vec3f& p2 = vertices[triangle[(k + 2) % 3]].position;
+
+					vec3f before = Cross(Subtract(p1, p0), Subtract(p2, p0));
+					vec3f after = Cross(Subtract(p1, target), Subtract(p2, target));
+					float lengths = std::sqrt(Dot(before, before) * Dot(after, after));
+					valid = lengths > 0.0f && Dot(before, after) >= SIMPLIFY_MAX_FLIP * lengths;
+				}
+
+				if (!valid)
+				{
+					continue;
+				}
+
+				for (DWord a = adjacency.offsets[collapse.from]; a < adjacency.offsets[collapse.from + 1]; a++)
+				{
+					DWord* triangle = &current[adjacency.triangles[a] * 3];
+					bool removed = triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to;
+					for (DWord k = 0; k < 3; k++)
+					{
+						touched[triangle[k]] = 1;
+						triangle[k] = triangle[k] == collapse.from ? collapse.to : triangle[k];
+					}
+					remaining -= removed ? 3 : 0;
+				}
+
+				touched[collapse.from] = 1;
+				touched[collapse.to] = 1;
+				QuadricAdd(quadrics[collapse.to], quadrics[collapse.from]);
+				worst = std::max(worst, static_cast<double>(collapse.cost));
+				applied++;
+			}
+
+			/* Drop what collapsed down to a line*/
+			usize write = 0;
+			for (usize i = 0; i < current.size(); i += 3)
+			{
+				DWord a = position[current[i + 0]];
+				DWord b = position[current[i + 1]];
+				DWord c = position[current[i + 2]];
+				if (a == b || b == c || a == c)
+				{
+					continue;
+				}
+
+				current[write + 0] = current[i + 0];
+				current[write + 1] = current[i + 1];
+				current[write + 2] = current[i + 2];
+				write += 3;
+			}
+			current.resize(write);
+
+			if (applied == 0)
+			{
+				break;
+			}
+		}
+
+		if (resulterror != nullptr)
+		{
+			*resulterror = static_cast<float>(std::sqrt(worst));
+		}
+
+		std::memcpy(destination, current.data(), sizeof(DWord) * current.size());
+		return static_cast<DWord>(current.size());
+	}
+}
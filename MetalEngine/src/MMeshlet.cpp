@@ -0,0 +1,361 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine meshlets (clustering, cluster bounds, CPU reference culling)
+// ------------------------------------------------------
+
+#include "headers/MMeshlet.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace engine::meshes
+{
+	/* A cone that would have to open wider than this (normals dotted with the axis) never culls anything*/
+	static constexpr float MESHLET_CONE_MIN_DOT = 0.1f;
+
+	static vec3f Subtract(const vec3f& a, const vec3f& b)
+	{
+		return vec3f(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	static vec3f Cross(const vec3f& a, const vec3f& b)
+	{
+		return vec3f(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	static float Dot(const vec3f& a, const vec3f& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	static vec3f Normalize(const vec3f& v)
+	{
+		float length = std::sqrt(Dot(v, v));
+		return length > 0.0f ? vec3f(v.x / length, v.y / length, v.z / length) : vec3f(0.0f, 0.0f, 0.0f);
+	}
+
+	/* Sphere around the cluster's box and the cone its triangle normals fit in*/
+	static void ComputeMeshletBounds(const DWord* indices, DWord indexcount, const MetalMeshVertex* vertices, MetalCookedMeshlet& meshlet)
+	{
+		vec3f minimum(1e30f, 1e30f, 1e30f);
+		vec3f maximum(-1e30f, -1e30f, -1e30f);
+		for (DWord i = 0; i < indexcount; i++)
+		{
+			const vec3f& p = vertices[indices[i]].position;
+			minimum = vec3f(std::min(minimum.x, p.x), std::min(minimum.y, p.y), std::min(minimum.z, p.z));
+			maximum = vec3f(std::max(maximum.x, p.x), std::max(maximum.y, p.y), std::max(maximum.z, p.z));
+		}
+
+		vec3f center((minimum.x + maximum.x) * 0.5f, (minimum.y + maximum.y) * 0.5f, (minimum.z + maximum.z) * 0.5f);
+		float radius = 0.0f;
+		for (DWord i = 0; i < indexcount; i++)
+		{
+			vec3f d = Subtract(vertices[indices[i]].position, center);
+			radius = std::max(radius, Dot(d, d));
+		}
+
+		meshlet.center[0] = center.x;
+		meshlet.center[1] = center.y;
+		meshlet.center[2] = center.z;
+		meshlet.radius = std::sqrt(radius);
+
+		/* Start with a cone that never culls*/
+		meshlet.coneapex[0] = center.x;
+		meshlet.coneapex[1] = center.y;
+		meshlet.coneapex[2] = center.z;
+		meshlet.coneaxis[0] = 0.0f;
+		meshlet.coneaxis[1] = 0.0f;
+		meshlet.coneaxis[2] = 1.0f;
+		meshlet.conecutoff = 1.0f;
+
+		vec3f normals[MESHLET_MAX_TRIANGLES];
+		const vec3f* corners[MESHLET_MAX_TRIANGLES];
+		DWord count = 0;
+		vec3f sum(0.0f, 0.0f, 0.0f);
+		for (DWord i = 0; i + 2 < indexcount && count < MESHLET_MAX_TRIANGLES; i += 3)
+		{
+			const vec3f& p0 = vertices[indices[i + 0]].position;
+			vec3f normal = Normalize(Cross(Subtract(vertices[indices[i + 1]].position, p0), Subtract(vertices[indices[i + 2]].position, p0)));
+			if (Dot(normal, normal) == 0.0f)
+			{
+				continue;
+			}
+
+			normals[count] = normal;
+			corners[count] = &p0;
+			sum = vec3f(sum.x + normal.x, sum.y + normal.y, sum.z + normal.z);
+			count++;
+		}
+
+		vec3f axis = Normalize(sum);
+		if (count == 0 || Dot(axis, axis) == 0.0f)
+		{
+			return;
+		}
+
+		float mindot = 1.0f;
+		for (DWord t = 0; t < count; t++)
+		{
+			mindot = std::min(mindot, Dot(normals[t], axis));
+		}
+
+		if (mindot <= MESHLET_CONE_MIN_DOT)
+		{
+			return;
+		}
+
+		/* Slide the apex back along the axis until it is behind every triangle's plane*/
+		float maxt = 0.0f;
+		for (DWord t = 0; t < count; t++)
+		{
+			float distance = Dot(Subtract(center, *corners[t]), normals[t]);
+			maxt = std::max(maxt, distance / Dot(axis, normals[t]));
+		}
+
+		meshlet.coneapex[0] = center.x - axis.x * maxt;
+		meshlet.coneapex[1] = center.y - axis.y * maxt;
+		meshlet.coneapex[2] = center.z - axis.z * maxt;
+		meshlet.coneaxis[0] = axis.x;
+		meshlet.coneaxis[1] = axis.y;
+		meshlet.coneaxis[2] = axis.z;
+		meshlet.conecutoff = std::sqrt(1.0f - mindot * mindot);
+	}
+
+	DWord BuildMeshlets(const DWord* indices, DWord firstindex, DWord indexcount, const MetalMeshVertex* vertices, DWord vertexcount,
+		DWord submesh, std::vector<MetalCookedMeshlet>& meshlets)
+	{
+		usize first = meshlets.size();
+		std::vector<DWord> stamp(vertexcount, 0xFFFFFFFF);
+		DWord current = 0;
+		DWord start = 0;
+		DWord triangles = 0;
+		DWord used = 0;
+
+		auto Flush = [&](DWord end)
+		{
+			if (triangles == 0)
+			{
+				return;
+			}
+
+			MetalCookedMeshlet meshlet = {};
+			meshlet.firstindex		= firstindex + start;
+			meshlet.trianglecount	= triangles;
+			meshlet.vertexcount		= used;
+			meshlet.submesh			= submesh;
+			ComputeMeshletBounds(indices + start, end - start, vertices, meshlet);
+			meshlets.push_back(meshlet);
+
+			current++;
+			start = end;
+			triangles = 0;
+			used = 0;
+		};
+
+		for (DWord i = 0; i + 2 < indexcount; i += 3)
+		{
+			DWord a = indices[i], b = indices[i + 1], c = indices[i + 2];
+			DWord added = (stamp[a] != current) + (stamp[b] != current && b != a) + (stamp[c] != current && c != a && c != b);
+			if (used + added > MESHLET_MAX_VERTICES || triangles + 1 > MESHLET_MAX_TRIANGLES)
+			{
+				Flush(i);
+			}
+
+			for (DWord v : { a, b, c })
+			{
+				if (stamp[v] != current)
+				{
+					stamp[v] = current;
+					used++;
+				}
+			}
+			triangles++;
+		}
+
+		Flush(indexcount - indexcount % 3);
+		return static_cast<DWord>(meshlets.size() - first);
+	}
+
+	void BuildDepthPyramid(const float* depth, DWord width, DWord height, MetalDepthPyramid& pyramid)
+	{
+		pyramid.width = width;
+		pyramid.height = height;
+		pyramid.widths.clear();
+		pyramid.heights.clear();
+		pyramid.levels.clear();
+
+		const float* source = depth;
+		DWord sourcewidth = width;
+		DWord sourceheight = height;
+		while (pyramid.levels.size() < DEPTH_PYRAMID_MAX_LEVELS && sourcewidth != 0 && sourceheight != 0)
+		{
+			/* Rounding up means source pixel x always lands in x / 2, odd edges are never dropped*/
+			DWord levelwidth = (sourcewidth + 1) / 2;
+			DWord levelheight = (sourceheight + 1) / 2;
+			std::vector<float> level(static_cast<usize>(levelwidth) * levelheight);
+
+			for (DWord y = 0; y < levelheight; y++)
+			{
+				DWord y0 = std::min(y * 2, sourceheight - 1);
+				DWord y1 = std::min(y * 2 + 1, sourceheight - 1);
+				for (DWord x = 0; x < levelwidth; x++)
+				{
+					DWord x0 = std::min(x * 2, sourcewidth - 1);
+					DWord x1 = std::min(x * 2 + 1, sourcewidth - 1);
+					level[y * levelwidth + x] = std::max(
+						std::max(source[y0 * sourcewidth + x0], source[y0 * sourcewidth + x1]),
+						std::max(source[y1 * sourcewidth + x0], source[y1 * sourcewidth + x1]));
+				}
+			}
+
+			pyramid.widths.push_back(levelwidth);
+			pyramid.heights.push_back(levelheight);
+			pyramid.levels.push_back(std::move(level));
+			if (levelwidth == 1 && levelheight == 1)
+			{
+				break;
+			}
+
+			source = pyramid.levels.back().data();
+			sourcewidth = levelwidth;
+			sourceheight = levelheight;
+		}
+	}
+
+	bool IsSphereOccluded(const MetalDepthPyramid& pyramid, const mat4f& viewproj, const vec3f& center, float radius)
+	{
+		if (pyramid.levels.empty())
+		{
+			return false;
+		}
+
+		/* Project the sphere's box, anything reaching behind the near plane counts as visible*/
+		float minx = 1e30f, miny = 1e30f, maxx = -1e30f, maxy = -1e30f, minz = 1e30f;
+		for (DWord corner = 0; corner < 8; corner++)
+		{
+			vec3f p(center.x + ((corner & 1) ? radius : -radius), center.y + ((corner & 2) ? radius : -radius),
+				center.z + ((corner & 4) ? radius : -radius));
+			vec4f clip = viewproj.Transform(p);
+			if (clip.w <= 1e-4f)
+			{
+				return false;
+			}
+
+			float x = clip.x / clip.w, y = clip.y / clip.w, z = clip.z / clip.w;
+			minx = std::min(minx, x);
+			maxx = std::max(maxx, x);
+			miny = std::min(miny, y);
+			maxy = std::max(maxy, y);
+			minz = std::min(minz, z);
+		}
+
+		if (minz < 0.0f)
+		{
+			return false;
+		}
+
+		auto Pixel = [](float ndc, DWord size)
+		{
+			float pixel = std::floor((ndc * 0.5f + 0.5f) * static_cast<float>(size));
+			return static_cast<DWord>(std::clamp(pixel, 0.0f, static_cast<float>(size - 1)));
+		};
+		DWord x0 = Pixel(minx, pyramid.width), x1 = Pixel(maxx, pyramid.width);
+		DWord y0 = Pixel(miny, pyramid.height), y1 = Pixel(maxy, pyramid.height);
+
+		/* The finest level where the rectangle spans at most 2x2 texels*/
+		DWord level = 0;
+		while (level + 1 < pyramid.levels.size() && ((x1 >> (level + 1)) - (x0 >> (level + 1)) > 1 || (y1 >> (level + 1)) - (y0 >> (level + 1)) > 1))
+		{
+			level++;
+		}
+
+		DWord shift = level + 1;
+		DWord w = pyramid.widths[level], h = pyramid.heights[level];
+		DWord tx0 = std::min(x0 >> shift, w - 1), tx1 = std::min(x1 >> shift, w - 1);
+		DWord ty0 = std::min(y0 >> shift, h - 1), ty1 = std::min(y1 >> shift, h - 1);
+		const std::vector<float>& texels = pyramid.levels[level];
+		float farthest = std::max(std::max(texels[ty0 * w + tx0], texels[ty0 * w + tx1]), std::max(texels[ty1 * w + tx0], texels[ty1 * w + tx1]));
+		return minz > farthest;
+	}
+
+	DWord CullMeshlets(const MetalCookedMeshlet* meshlets, DWord meshletcount, const mat4f& model, const mat4f& viewproj, const vec3f& camera,
+		const MetalDepthPyramid* pyramid, const mat4f& occlusionviewproj, DWord* visible, MetalMeshletCullStats* stats)
+	{
+		/* Gribb/Hartmann planes for Vulkan clip space (-w <= x,y <= w, 0 <= z <= w), in world space*/
+		const vec4f* r = viewproj.rows;
+		vec4f planes[6] = {
+			vec4f(r[3].x + r[0].x, r[3].y + r[0].y, r[3].z + r[0].z, r[3].w + r[0].w),
+			vec4f(r[3].x - r[0].x, r[3].y - r[0].y, r[3].z - r[0].z, r[3].w - r[0].w),
+			vec4f(r[3].x + r[1].x, r[3].y + r[1].y, r[3].z + r[1].z, r[3].w + r[1].w),
+			vec4f(r[3].x - r[1].x, r[3].y - r[1].y, r[3].z - r[1].z, r[3].w - r[1].w),
+			r[2],
+			vec4f(r[3].x - r[2].x, r[3].y - r[2].y, r[3].z - r[2].z, r[3].w - r[2].w) };
+		for (vec4f& plane : planes)
+		{
+			float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+			plane = vec4f(plane.x / length, plane.y / length, plane.z / length, plane.w / length);
+		}
+
+		const vec4f* m = model.rows;
+		float scale = std::sqrt(std::max(m[0].x * m[0].x + m[1].x * m[1].x + m[2].x * m[2].x,
+			std::max(m[0].y * m[0].y + m[1].y * m[1].y + m[2].y * m[2].y, m[0].z * m[0].z + m[1].z * m[1].z + m[2].z * m[2].z)));
+
+		MetalMeshletCullStats counts;
+		DWord visiblecount = 0;
+		for (DWord i = 0; i < meshletcount; i++)
+		{
+			const MetalCookedMeshlet& meshlet = meshlets[i];
+			counts.tested++;
+
+			vec4f center = model.Transform(vec3f(meshlet.center[0], meshlet.center[1], meshlet.center[2]));
+			float radius = meshlet.radius * scale;
+
+			bool outside = false;
+			for (const vec4f& plane : planes)
+			{
+				outside = outside || plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius;
+			}
+
+			if (outside)
+			{
+				counts.frustum++;
+				continue;
+			}
+
+			if (meshlet.conecutoff < 1.0f)
+			{
+				vec4f apex = model.Transform(vec3f(meshlet.coneapex[0], meshlet.coneapex[1], meshlet.coneapex[2]));
+				vec3f axis = Normalize(vec3f(
+					m[0].x * meshlet.coneaxis[0] + m[0].y * meshlet.coneaxis[1] + m[0].z * meshlet.coneaxis[2],
+					m[1].x * meshlet.coneaxis[0] + m[1].y * meshlet.coneaxis[1] + m[1].z * meshlet.coneaxis[2],
+					m[2].x * meshlet.coneaxis[0] + m[2].y * meshlet.coneaxis[1] + m[2].z * meshlet.coneaxis[2]));
+				vec3f view = Normalize(Subtract(vec3f(apex.x, apex.y, apex.z), camera));
+				if (Dot(view, axis) >= meshlet.conecutoff)
+				{
+					counts.backface++;
+					continue;
+				}
+			}
+
+			if (pyramid != nullptr && IsSphereOccluded(*pyramid, occlusionviewproj, vec3f(center.x, center.y, center.z), radius))
+			{
+				counts.occluded++;
+				continue;
+			}
+
+			visible[visiblecount++] = i;
+		}
+
+		counts.visible = visiblecount;
+		if (stats != nullptr)
+		{
+			*stats = counts;
+		}
+		return visiblecount;
+	}
+}
@@ -0,0 +1,260 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine frame profiler (scoped CPU zones, GPU timeline, Chrome trace export)
+// ------------------------------------------------------
+
+#include "headers/MProfiler.hpp"
+#include "headers/MError.h"
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+namespace engine::profiler
+{
+	static constexpr DWord EVENT_MASK = PROFILER_EVENTS_PER_THREAD - 1;
+
+	static_assert((PROFILER_EVENTS_PER_THREAD & EVENT_MASK) == 0, "PROFILER_EVENTS_PER_THREAD must be a power of two");
+
+	/* Written only by its thread, read by the exporter. The exporter checks head again after copying
+		and throws away anything the thread could have overwritten in the meantime.
+	*/
+	struct MetalProfileThread
+	{
+		std::atomic<QWord>	head{ 0 };
+		DWord				id = 0;
+		char				name[PROFILER_THREAD_NAME] = {};
+		MetalProfileEvent	events[PROFILER_EVENTS_PER_THREAD];
+	};
+
+	static std::mutex										m_threadlock;
+	static std::vector<std::unique_ptr<MetalProfileThread>>	m_threads;
+	static MetalProfileThread*								m_gputhread = nullptr;
+	static std::atomic<QWord>								m_frameindex{ 0 };
+	static QWord											m_frames[PROFILER_MAX_FRAMES] = {};
+	static double											m_tickspersecond = 1e9;
+	static thread_local MetalProfileThread*					t_thread = nullptr;
+
+	static MetalProfileThread* RegisterThread(const char* name)
+	{
+		std::lock_guard<std::mutex> guard(m_threadlock);
+		m_threads.push_back(std::make_unique<MetalProfileThread>());
+
+		MetalProfileThread* thread = m_threads.back().get();
+		thread->id = static_cast<DWord>(m_threads.size());
+		if (name != nullptr)
+		{
+			snprintf(thread->name, sizeof(thread->name), "%s", name);
+		}
+		else
+		{
+			snprintf(thread->name, sizeof(thread->name), "Thread %u", thread->id);
+		}
+		return thread;
+	}
+
+	static MetalProfileThread* GetThread()
+	{
+		if (t_thread == nullptr)
+		{
+			t_thread = RegisterThread(nullptr);
+		}
+		return t_thread;
+	}
+
+	static void PushEvent(MetalProfileThread* thread, const char* name, QWord begin, QWord end)
+	{
+		QWord head = thread->head.load(std::memory_order_relaxed);
+		thread->events[head & EVENT_MASK] = { name, begin, end };
+		thread->head.store(head + 1, std::memory_order_release);
+	}
+
+	int ProfilerInit(void)
+	{
+		/* Time the ticks against steady_clock for a little while*/
+		auto clockbegin = std::chrono::steady_clock::now();
+		QWord tickbegin = ProfilerTicks();
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		auto clockend = std::chrono::steady_clock::now();
+		QWord tickend = ProfilerTicks();
+
+		double seconds = std::chrono::duration<double>(clockend - clockbegin).count();
+		if (seconds <= 0.0 || tickend <= tickbegin)
+		{
+			WarningMessage("Profiler WARNING", "Could not measure the profiler clock");
+			return 1;
+		}
+
+		m_tickspersecond = static_cast<double>(tickend - tickbegin) / seconds;
+		ProfilerSetThreadName("Main");
+		return 0;
+	}
+
+	void ProfilerShutdown(void)
+	{
+		std::lock_guard<std::mutex> guard(m_threadlock);
+		m_threads.clear();
+		m_gputhread = nullptr;
+		m_frameindex.store(0);
+
+		/* Threads that are still alive would write into freed buffers otherwise*/
+		t_thread = nullptr;
+	}
+
+	double ProfilerTicksPerSecond(void)
+	{
+		return m_tickspersecond;
+	}
+
+	void ProfilerSetThreadName(const char* name)
+	{
+		if (t_thread == nullptr)
+		{
+			t_thread = RegisterThread(name);
+			return;
+		}
+
+		std::lock_guard<std::mutex> guard(m_threadlock);
+		snprintf(t_thread->name, sizeof(t_thread->name), "%s", name);
+	}
+
+	void ProfilerFrameMark(void)
+	{
+		QWord index = m_frameindex.load(std::memory_order_relaxed);
+		m_frames[index % PROFILER_MAX_FRAMES] = ProfilerTicks();
+		m_frameindex.store(index + 1, std::memory_order_release);
+	}
+
+	QWord ProfilerFrameIndex(void)
+	{
+		return m_frameindex.load(std::memory_order_acquire);
+	}
+
+	void ProfilerRecord(const char* name, QWord begin, QWord end)
+	{
+		PushEvent(GetThread(), name, begin, end);
+	}
+
+	void ProfilerRecordGpu(const char* name, QWord begin, QWord end)
+	{
+		if (m_gputhread == nullptr)
+		{
+			m_gputhread = RegisterThread("GPU");
+		}
+		PushEvent(m_gputhread, name, begin, end);
+	}
+
+	/* Names are literals but a stray quote or backslash would still break the file*/
+	static void WriteJsonString(FILE* file, const char* string)
+	{
+		fputc('"', file);
+		for (; *string != '\0'; string++)
+		{
+			unsigned char c = static_cast<unsigned char>(*string);
+			if (c == '"' || c == '\\')
+			{
+				fputc('\\', file);
+				fputc(c, file);
+			}
+			else if (c < 0x20)
+			{
+				fprintf(file, "\\u%04x", c);
+			}
+			else
+			{
+				fputc(c, file);
+			}
+		}
+		fputc('"', file);
+	}
+
+	int ProfilerExportChrome(const char* path, DWord frames)
+	{
+		QWord frameindex = m_frameindex.load(std::memory_order_acquire);
+		if (frameindex < 2 || frames == 0)
+		{
+			WarningMessage("Profiler WARNING", "Nothing to export, call METAL_FRAME_MARK every frame");
+			return 1;
+		}
+
+		/* The newest mark starts a frame that hasn't finished yet*/
+		QWord finished = frameindex - 1;
+		QWord count = std::min<QWord>({ static_cast<QWord>(frames), finished, PROFILER_MAX_FRAMES - 1 });
+		QWord firstframe = finished - count;
+		QWord rangebegin = m_frames[firstframe % PROFILER_MAX_FRAMES];
+		QWord rangeend = m_frames[finished % PROFILER_MAX_FRAMES];
+
+		FILE* file = fopen(path, "wb");
+		if (file == nullptr)
+		{
+			WarningMessage("Profiler WARNING", "Failed to open %s for writing", path);
+			return 1;
+		}
+
+		double microseconds = 1e6 / m_tickspersecond;
+		auto Time = [&](QWord ticks) { return static_cast<double>(static_cast<ssize>(ticks - rangebegin)) * microseconds; };
+
+		fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+		fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Frames\"}}");
+
+		for (QWord frame = firstframe; frame < finished; frame++)
+		{
+			QWord begin = m_frames[frame % PROFILER_MAX_FRAMES];
+			QWord end = m_frames[(frame + 1) % PROFILER_MAX_FRAMES];
+			fprintf(file, ",\n{\"name\":\"Frame %llu\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f}",
+				static_cast<unsigned long long>(frame), Time(begin), Time(end) - Time(begin));
+		}
+
+		std::lock_guard<std::mutex> guard(m_threadlock);
+		std::vector<MetalProfileEvent> events;
+		for (const auto& thread : m_threads)
+		{
+			fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", thread->id);
+			WriteJsonString(file, thread->name);
+			fprintf(file, "}}");
+
+			QWord head = thread->head.load(std::memory_order_acquire);
+			QWord oldest = head > PROFILER_EVENTS_PER_THREAD ? head - PROFILER_EVENTS_PER_THREAD : 0;
+
+			events.clear();
+			for (QWord i = oldest; i < head; i++)
+			{
+				events.push_back(thread->events[i & EVENT_MASK]);
+			}
+
+			/* Drop whatever the thread wrapped over while we were copying*/
+			QWord after = thread->head.load(std::memory_order_acquire);
+			QWord overwritten = after > PROFILER_EVENTS_PER_THREAD ? after - PROFILER_EVENTS_PER_THREAD : 0;
+			usize skip = overwritten > oldest ? static_cast<usize>(std::min(overwritten - oldest, head - oldest)) : 0;
+
+			const char* category = thread.get() == m_gputhread ? "gpu" : "cpu";
+			for (usize i = skip; i < events.size(); i++)
+			{
+				const MetalProfileEvent& event = events[i];
+				if (event.end < rangebegin || event.begin > rangeend || event.end < event.begin)
+				{
+					continue;
+				}
+
+				fprintf(file, ",\n{\"name\":");
+				WriteJsonString(file, event.name);
+				fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+					category, thread->id, Time(event.begin), Time(event.end) - Time(event.begin));
+			}
+		}
+
+		fprintf(file, "\n]}\n");
+		int failed = ferror(file);
+		fclose(file);
+		return failed != 0 ? 1 : 0;
+	}
+}
@@ -0,0 +1,128 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine parallel radix sort (64-bit keys with a payload, on the job system)
+// ------------------------------------------------------
+
+#include "headers/MRadixSort.hpp"
+#include "headers/MJobSystem.hpp"
+#include "headers/MProfiler.hpp"
+
+#include <array>
+#include <cstring>
+#include <vector>
+
+namespace engine::jobs
+{
+	static constexpr DWord RADIX_BITS		= 8;
+	static constexpr DWord RADIX_BUCKETS	= 1u << RADIX_BITS;
+	static constexpr DWord RADIX_PASSES		= 64 / RADIX_BITS;
+
+	void RadixSort(QWord* keys, DWord* values, DWord count, QWord* scratchkeys, DWord* scratchvalues)
+	{
+		if (count < 2)
+		{
+			return;
+		}
+
+		METAL_ZONE("Radix Sort");
+
+		/* About four blocks per worker, but never blocks so small the jobs cost more than the sorting*/
+		DWord Workers = GetWorkerCount();
+		DWord BlockSize = (count + Workers * 4 - 1) / (Workers * 4);
+		BlockSize = BlockSize < RADIX_SORT_BLOCK_SIZE ? RADIX_SORT_BLOCK_SIZE : BlockSize;
+		DWord BlockCount = (count + BlockSize - 1) / BlockSize;
+
+		auto BlockBegin = [&](DWord block) { return block * BlockSize; };
+		auto BlockEnd = [&](DWord block) { return block + 1 == BlockCount ? count : (block + 1) * BlockSize; };
+
+		/* Bits where some key differs from the first, a digit with none of them would be a pass that moves nothing*/
+		std::vector<QWord> Differences(BlockCount, 0);
+		ParallelFor(BlockCount, 1, [&](DWord begin, DWord end)
+		{
+			for (DWord block = begin; block < end; block++)
+			{
+				QWord Difference = 0;
+				for (DWord i = BlockBegin(block); i < BlockEnd(block); i++)
+				{
+					Difference |= keys[i] ^ keys[0];
+				}
+				Differences[block] = Difference;
+			}
+		});
+
+		QWord Varying = 0;
+		for (QWord Difference : Differences)
+		{
+			Varying |= Difference;
+		}
+
+		std::vector<std::array<DWord, RADIX_BUCKETS>> Offsets(BlockCount);
+		QWord* SourceKeys = keys;
+		DWord* SourceValues = values;
+		QWord* DestinationKeys = scratchkeys;
+		DWord* DestinationValues = scratchvalues;
+
+		for (DWord Pass = 0; Pass < RADIX_PASSES; Pass++)
+		{
+			DWord Shift = Pass * RADIX_BITS;
+			if (((Varying >> Shift) & (RADIX_BUCKETS - 1)) == 0)
+			{
+				continue;
+			}
+
+			ParallelFor(BlockCount, 1, [&](DWord begin, DWord end)
+			{
+				for (DWord block = begin; block < end; block++)
+				{
+					std::array<DWord, RADIX_BUCKETS>& Histogram = Offsets[block];
+					Histogram.fill(0);
+					for (DWord i = BlockBegin(block); i < BlockEnd(block); i++)
+					{
+						Histogram[(SourceKeys[i] >> Shift) & (RADIX_BUCKETS - 1)]++;
+					}
+				}
+			});
+
+			/* Digit major, block minor: every block scatters into its own slice of each bucket, which keeps it stable*/
+			DWord Running = 0;
+			for (DWord Digit = 0; Digit < RADIX_BUCKETS; Digit++)
+			{
+				for (DWord Block = 0; Block < BlockCount; Block++)
+				{
+					DWord Count = Offsets[Block][Digit];
+					Offsets[Block][Digit] = Running;
+					Running += Count;
+				}
+			}
+
+			ParallelFor(BlockCount, 1, [&](DWord begin, DWord end)
+			{
+				for (DWord block = begin; block < end; block++)
+				{
+					std::array<DWord, RADIX_BUCKETS>& Offset = Offsets[block];
+					for (DWord i = BlockBegin(block); i < BlockEnd(block); i++)
+					{
+						DWord Position = Offset[(SourceKeys[i] >> Shift) & (RADIX_BUCKETS - 1)]++;
+						DestinationKeys[Position] = SourceKeys[i];
+						DestinationValues[Position] = SourceValues[i];
+					}
+				}
+			});
+
+			std::swap(SourceKeys, DestinationKeys);
+			std::swap(SourceValues, DestinationValues);
+		}
+
+		/* An odd number of passes leaves the result in the scratch arrays*/
+		if (SourceKeys != keys)
+		{
+			std::memcpy(keys, SourceKeys, sizeof(QWord) * count);
+			std::memcpy(values, SourceValues, sizeof(DWord) * count);
+		}
+	}
+}
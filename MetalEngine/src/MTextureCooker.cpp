@@ -0,0 +1,999 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine texture cooker (mipmaps, BC1-7 compression, packages)
+// ------------------------------------------------------
+
+#include "headers/MTextureCooker.hpp"
+#include "headers/MJobSystem.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+	#include <emmintrin.h>
+	#define METAL_COOKER_SSE
+#endif
+
+namespace engine::textures
+{
+	/* BC7 interpolation weights for 4-bit indices (out of 64)*/
+	static constexpr int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	/* Weight of the second endpoint for each BC1 index*/
+	static constexpr float BC1_WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+	/* Same curve as sRGBToLinear in the shaders*/
+	static float SRGBToLinear(float color)
+	{
+		return color < 0.04045f ? color * (1.0f / 12.92f) : std::pow(color * (1.0f / 1.055f) + 0.0521327f, 2.4f);
+	}
+
+	static float LinearToSRGB(float color)
+	{
+		return color < 0.0031308f ? color * 12.92f : 1.055f * std::pow(color, 1.0f / 2.4f) - 0.055f;
+	}
+
+	static Byte ToByte(float value)
+	{
+		return static_cast<Byte>(std::clamp(value * 255.0f + 0.5f, 0.0f, 255.0f));
+	}
+
+	struct MetalBitWriter
+	{
+		Byte*	block;
+		DWord	position = 0;
+
+		void Put(DWord value, DWord count)
+		{
+			for (DWord i = 0; i < count; i++, position++)
+			{
+				if ((value >> i) & 1)
+				{
+					block[position >> 3] |= static_cast<Byte>(1 << (position & 7));
+				}
+			}
+		}
+	};
+
+	/*
+		Block fitting helpers. A block is 16 pixels split into per channel float arrays so the
+		index search can run 4 pixels at a time.
+	*/
+	struct MetalBlockPixels
+	{
+		alignas(16) float channels[4][16];
+		DWord count;
+	};
+
+	static void LoadBlock(const Byte* pixels, DWord channelcount, MetalBlockPixels& block)
+	{
+		block.count = channelcount;
+		for (DWord i = 0; i < 16; i++)
+		{
+			for (DWord c = 0; c < channelcount; c++)
+			{
+				block.channels[c][i] = pixels[i * 4 + c];
+			}
+		}
+	}
+
+	/**
+	* @brief Line through the block's colors that keeps the most variance (power iteration on the covariance)
+	*/
+	static void PrincipalAxis(const MetalBlockPixels& block, float* mean, float* axis)
+	{
+		DWord n = block.count;
+		float minimum[4];
+		float maximum[4];
+
+		for (DWord c = 0; c < n; c++)
+		{
+			float sum = 0.0f;
+			minimum[c] = 255.0f;
+			maximum[c] = 0.0f;
+			for (DWord i = 0; i < 16; i++)
+			{
+				sum += block.channels[c][i];
+				minimum[c] = std::min(minimum[c], block.channels[c][i]);
+				maximum[c] = std::max(maximum[c], block.channels[c][i]);
+			}
+			mean[c] = sum / 16.0f;
+		}
+
+		float covariance[4][4] = {};
+		for (DWord i = 0; i < 16; i++)
+		{
+			for (DWord a = 0; a < n; a++)
+			{
+				float da = block.channels[a][i] - mean[a];
+				for (DWord b = a; b < n; b++)
+				{
+					covariance[a][b] += da * (block.channels[b][i] - mean[b]);
+				}
+			}
+		}
+		for (DWord a = 0; a < n; a++)
+		{
+			for (DWord b = 0; b < a; b++)
+			{
+				covariance[a][b] = covariance[b][a];
+			}
+		}
+
+		/* The bounding box diagonal is a good first guess and avoids starting orthogonal to the answer*/
+		for (DWord c = 0; c < n; c++)
+		{
+			axis[c] = maximum[c] - minimum[c];
+		}
+
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[4] = {};
+			float length = 0.0f;
+			for (DWord a = 0; a < n; a++)
+			{
+				for (DWord b = 0; b < n; b++)
+				{
+					next[a] += covariance[a][b] * axis[b];
+				}
+				length += next[a] * next[a];
+			}
+
+			if (length < 1e-12f)
+			{
+				break;
+			}
+
+			length = 1.0f / std::sqrt(length);
+			for (DWord c = 0; c < n; c++)
+			{
+				axis[c] = next[c] * length;
+			}
+		}
+
+		float length = 0.0f;
+		for (DWord c = 0; c < n; c++)
+		{
+			length += axis[c] * axis[c];
+		}
+		length = length > 1e-12f ? 1.0f / std::sqrt(length) : 0.0f;
+		for (DWord c = 0; c < n; c++)
+		{
+			axis[c] *= length;
+		}
+	}
+
+	/**
+	* @brief Endpoints at the extremes of the block projected on the principal axis
+	*/
+	static void FitEndpoints(const MetalBlockPixels& block, float* endpoint0, float* endpoint1)
+	{
+		float mean[4];
+		float axis[4];
+		PrincipalAxis(block, mean, axis);
+
+		float tmin = 1e30f;
+		float tmax = -1e30f;
+		for (DWord i = 0; i < 16; i++)
+		{
+			float t = 0.0f;
+			for (DWord c = 0; c < block.count; c++)
+			{
+				t += (block.channels[c][i] - mean[c]) * axis[c];
+			}
+			tmin = std::min(tmin, t);
+			tmax = std::max(tmax, t);
+		}
+
+		for (DWord c = 0; c < block.count; c++)
+		{
+			endpoint0[c] = std::clamp(mean[c] + axis[c] * tmin, 0.0f, 255.0f);
+			endpoint1[c] = std::clamp(mean[c] + axis[c] * tmax, 0.0f, 255.0f);
+		}
+	}
+
+	/**
+	* @brief Picks the closest palette entry for every pixel
+	* @returns The summed squared error
+	*/
+	static float SelectIndices(const MetalBlockPixels& block, const float (*palette)[4], DWord palettecount, Byte* indices)
+	{
+		float total = 0.0f;
+
+#if defined(METAL_COOKER_SSE)
+		for (DWord group = 0; group < 16; group += 4)
+		{
+			__m128 best = _mm_set1_ps(1e30f);
+			__m128 bestindex = _mm_setzero_ps();
+
+			for (DWord k = 0; k < palettecount; k++)
+			{
+				__m128 distance = _mm_setzero_ps();
+				for (DWord c = 0; c < block.count; c++)
+				{
+					__m128 d = _mm_sub_ps(_mm_load_ps(&block.channels[c][group]), _mm_set1_ps(palette[k][c]));
+					distance = _mm_add_ps(distance, _mm_mul_ps(d, d));
+				}
+
+				__m128 closer = _mm_cmplt_ps(distance, best);
+				best = _mm_min_ps(distance, best);
+				bestindex = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps(static_cast<float>(k))), _mm_andnot_ps(closer, bestindex));
+			}
+
+			alignas(16) float errors[4];
+			alignas(16) float chosen[4];
+			_mm_store_ps(errors, best);
+			_mm_store_ps(chosen, bestindex);
+			for (DWord i = 0; i < 4; i++)
+			{
+				indices[group + i] = static_cast<Byte>(chosen[i]);
+				total += errors[i];
+			}
+		}
+#else
+		for (DWord i = 0; i < 16; i++)
+		{
+			float best = 1e30f;
+			for (DWord k = 0; k < palettecount; k++)
+			{
+				float distance = 0.0f;
+				for (DWord c = 0; c < block.count; c++)
+				{
+					float d = block.channels[c][i] - palette[k][c];
+					distance += d * d;
+				}
+				if (distance < best)
+				{
+					best = distance;
+					indices[i] = static_cast<Byte>(k);
+				}
+			}
+			total += best;
+		}
+#endif
+		return total;
+	}
+
+	/**
+	* @brief Solves for the two endpoints that best reproduce the block with the indices fixed
+	* @param weights -> Weight of endpoint1 for every pixel
+	* @returns false if the system is degenerate (every pixel uses the same weight)
+	*/
+	static bool LeastSquaresEndpoints(const MetalBlockPixels& block, const float* weights, float* endpoint0, float* endpoint1)
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float xa[4] = {};
+		float xb[4] = {};
+
+		for (DWord i = 0; i < 16; i++)
+		{
+			float b = weights[i];
+			float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (DWord c = 0; c < block.count; c++)
+			{
+				xa[c] += a * block.channels[c][i];
+				xb[c] += b * block.channels[c][i];
+			}
+		}
+
+		float determinant = aa * bb - ab * ab;
+		if (std::fabs(determinant) < 1e-6f)
+		{
+			return false;
+		}
+
+		float inverse = 1.0f / determinant;
+		for (DWord c = 0; c < block.count; c++)
+		{
+			endpoint0[c] = std::clamp((bb * xa[c] - ab * xb[c]) * inverse, 0.0f, 255.0f);
+			endpoint1[c] = std::clamp((aa * xb[c] - ab * xa[c]) * inverse, 0.0f, 255.0f);
+		}
+		return true;
+	}
+
+	static Word PackColor565(const float* color)
+	{
+		DWord r = static_cast<DWord>(std::clamp(color[0] * (31.0f / 255.0f) + 0.5f, 0.0f, 31.0f));
+		DWord g = static_cast<DWord>(std::clamp(color[1] * (63.0f / 255.0f) + 0.5f, 0.0f, 63.0f));
+		DWord b = static_cast<DWord>(std::clamp(color[2] * (31.0f / 255.0f) + 0.5f, 0.0f, 31.0f));
+		return static_cast<Word>((r << 11) | (g << 5) | b);
+	}
+
+	static void UnpackColor565(Word packed, float* color)
+	{
+		DWord r = (packed >> 11) & 31;
+		DWord g = (packed >> 5) & 63;
+		DWord b = packed & 31;
+		color[0] = static_cast<float>((r << 3) | (r >> 2));
+		color[1] = static_cast<float>((g << 2) | (g >> 4));
+		color[2] = static_cast<float>((b << 3) | (b >> 2));
+	}
+
+	/* Color half of BC1 and BC3, always in 4 color mode*/
+	static void EncodeColorBlock(const Byte* pixels, Byte* block)
+	{
+		MetalBlockPixels colors;
+		LoadBlock(pixels, 3, colors);
+
+		float endpoint0[4];
+		float endpoint1[4];
+		FitEndpoints(colors, endpoint0, endpoint1);
+
+		float besterror = 1e30f;
+		Word best0 = 0;
+		Word best1 = 0;
+		Byte bestindices[16] = {};
+
+		for (int iteration = 0; iteration < 2; iteration++)
+		{
+			Word packed0 = PackColor565(endpoint0);
+			Word packed1 = PackColor565(endpoint1);
+
+			/* 4 color mode needs color0 > color1*/
+			if (packed0 < packed1)
+			{
+				std::swap(packed0, packed1);
+			}
+
+			float palette[4][4] = {};
+			UnpackColor565(packed0, palette[0]);
+			UnpackColor565(packed1, palette[1]);
+			for (int c = 0; c < 3; c++)
+			{
+				palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+				palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+			}
+
+			Byte indices[16];
+			float error = SelectIndices(colors, palette, packed0 == packed1 ? 1 : 4, indices);
+			if (error < besterror)
+			{
+				besterror = error;
+				best0 = packed0;
+				best1 = packed1;
+				std::memcpy(bestindices, indices, 16);
+			}
+
+			float weights[16];
+			for (int i = 0; i < 16; i++)
+			{
+				weights[i] = BC1_WEIGHTS[indices[i]];
+			}
+
+			if (!LeastSquaresEndpoints(colors, weights, endpoint0, endpoint1))
+			{
+				break;
+			}
+		}
+
+		std::memset(block, 0, 8);
+		block[0] = static_cast<Byte>(best0 & 0xFF);
+		block[1] = static_cast<Byte>(best0 >> 8);
+		block[2] = static_cast<Byte>(best1 & 0xFF);
+		block[3] = static_cast<Byte>(best1 >> 8);
+
+		MetalBitWriter writer{ block + 4 };
+		for (int i = 0; i < 16; i++)
+		{
+			writer.Put(bestindices[i], 2);
+		}
+	}
+
+	void EncodeBC1(const Byte* pixels, Byte* block)
+	{
+		EncodeColorBlock(pixels, block);
+	}
+
+	void EncodeBC4(const Byte* pixels, DWord channel, Byte* block)
+	{
+		int minimum = 255;
+		int maximum = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			minimum = std::min(minimum, static_cast<int>(pixels[i * 4 + channel]));
+			maximum = std::max(maximum, static_cast<int>(pixels[i * 4 + channel]));
+		}
+
+		std::memset(block, 0, 8);
+		block[0] = static_cast<Byte>(maximum);
+		block[1] = static_cast<Byte>(minimum);
+		if (maximum == minimum)
+		{
+			return;
+		}
+
+		/* With red0 > red1 the palette is red0, red1 and 6 evenly spaced steps between them*/
+		float scale = 7.0f / static_cast<float>(maximum - minimum);
+		MetalBitWriter writer{ block + 2 };
+		for (int i = 0; i < 16; i++)
+		{
+			int step = static_cast<int>((maximum - pixels[i * 4 + channel]) * scale + 0.5f);
+			writer.Put(step == 0 ? 0 : step == 7 ? 1 : step + 1, 3);
+		}
+	}
+
+	void EncodeBC3(const Byte* pixels, Byte* block)
+	{
+		EncodeBC4(pixels, 3, block);
+		EncodeColorBlock(pixels, block + 8);
+	}
+
+	void EncodeBC5(const Byte* pixels, Byte* block)
+	{
+		EncodeBC4(pixels, 0, block);
+		EncodeBC4(pixels, 1, block + 8);
+	}
+
+	/**
+	* @brief Rounds an endpoint to 7 bits per channel plus the shared p-bit that gives the smaller error
+	*/
+	static void QuantizeBC7Endpoint(const float* endpoint, DWord* quantized, DWord& pbit, int* expanded)
+	{
+		float besterror = 1e30f;
+		for (DWord p = 0; p < 2; p++)
+		{
+			DWord candidate[4];
+			float error = 0.0f;
+			for (int c = 0; c < 4; c++)
+			{
+				candidate[c] = static_cast<DWord>(std::clamp((endpoint[c] - p) * 0.5f + 0.5f, 0.0f, 127.0f));
+				float d = static_cast<float>((candidate[c] << 1) | p) - endpoint[c];
+				error += d * d;
+			}
+
+			if (error < besterror)
+			{
+				besterror = error;
+				pbit = p;
+				for (int c = 0; c < 4; c++)
+				{
+					quantized[c] = candidate[c];
+					expanded[c] = static_cast<int>((candidate[c] << 1) | p);
+				}
+			}
+		}
+	}
+
+	/*
+		BC7 mode 6 only: one subset, RGBA endpoints at 7 bits + p-bit, 4-bit indices.
+		It handles alpha and smooth gradients well and skips the partition search that makes
+		full BC7 encoders slow.
+	*/
+	void EncodeBC7(const Byte* pixels, Byte* block)
+	{
+		MetalBlockPixels colors;
+		LoadBlock(pixels, 4, colors);
+
+		float endpoint0[4];
+		float endpoint1[4];
+		FitEndpoints(colors, endpoint0, endpoint1);
+
+		float besterror = 1e30f;
+		DWord best0[4] = {};
+		DWord best1[4] = {};
+		DWord bestp0 = 0;
+		DWord bestp1 = 0;
+		Byte bestindices[16] = {};
+
+		for (int iteration = 0; iteration < 2; iteration++)
+		{
+			DWord quantized0[4];
+			DWord quantized1[4];
+			DWord p0 = 0;
+			DWord p1 = 0;
+			int expanded0[4];
+			int expanded1[4];
+			QuantizeBC7Endpoint(endpoint0, quantized0, p0, expanded0);
+			QuantizeBC7Endpoint(endpoint1, quantized1, p1, expanded1);
+
+			float palette[16][4];
+			for (int k = 0; k < 16; k++)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					palette[k][c] = static_cast<float>(((64 - BC7_WEIGHTS[k]) * expanded0[c] + BC7_WEIGHTS[k] * expanded1[c] + 32) >> 6);
+				}
+			}
+
+			Byte indices[16];
+			float error = SelectIndices(colors, palette, 16, indices);
+			if (error < besterror)
+			{
+				besterror = error;
+				std::memcpy(best0, quantized0, sizeof(best0));
+				std::memcpy(best1, quantized1, sizeof(best1));
+				bestp0 = p0;
+				bestp1 = p1;
+				std::memcpy(bestindices, indices, 16);
+			}
+
+			float weights[16];
+			for (int i = 0; i < 16; i++)
+			{
+				weights[i] = BC7_WEIGHTS[indices[i]] / 64.0f;
+			}
+
+			if (!LeastSquaresEndpoints(colors, weights, endpoint0, endpoint1))
+			{
+				break;
+			}
+		}
+
+		/* The first pixel's index has its top bit dropped, so it has to point at the first half*/
+		if (bestindices[0] & 8)
+		{
+			std::swap(best0, best1);
+			std::swap(bestp0, bestp1);
+			for (int i = 0; i < 16; i++)
+			{
+				bestindices[i] = static_cast<Byte>(15 - bestindices[i]);
+			}
+		}
+
+		std::memset(block, 0, 16);
+		MetalBitWriter writer{ block };
+		writer.Put(1 << 6, 7);
+		for (int c = 0; c < 4; c++)
+		{
+			writer.Put(best0[c], 7);
+			writer.Put(best1[c], 7);
+		}
+		writer.Put(bestp0, 1);
+		writer.Put(bestp1, 1);
+
+		writer.Put(bestindices[0], 3);
+		for (int i = 1; i < 16; i++)
+		{
+			writer.Put(bestindices[i], 4);
+		}
+	}
+
+	imageformat ChooseCookedFormat(texturetype type, bool hasalpha)
+	{
+		switch (type)
+		{
+		case TT_DIFFUSE:
+			return IF_BC7_SRGB;
+		case TT_NORMAL:
+			return IF_BC5;
+		case TT_ORM:
+			return IF_BC7;
+		case TT_ROUGHNESS:
+		case TT_METALLIC:
+		case TT_AMBIENT_OCCLUSION:
+		case TT_DISPLACEMENT:
+		case TT_OPACITY:
+			return IF_BC4;
+		case TT_SPECULAR:
+		case TT_EMISSIVE:
+		case TT_SUBSURFACE_SCATTERING:
+			return hasalpha ? IF_BC3_SRGB : IF_BC1_SRGB;
+		default:
+			return hasalpha ? IF_BC3 : IF_BC1;
+		}
+	}
+
+	bool IsColorTexture(texturetype type)
+	{
+		return type == TT_DIFFUSE || type == TT_SPECULAR || type == TT_EMISSIVE || type == TT_SUBSURFACE_SCATTERING;
+	}
+
+	/* Source texels one destination texel covers along one axis and how much each counts*/
+	struct MipTaps
+	{
+		DWord	index[3];
+		float	weight[3];
+		DWord	count;
+	};
+
+	/* Even sizes are a 2 tap box. Odd sizes use a 3 tap polyphase box, every destination texel covers
+		size / nextsize source texels so the last row or column is spread over the level instead of dropped*/
+	static MipTaps MipFootprint(DWord x, DWord size, DWord nextsize)
+	{
+		MipTaps taps = {};
+		if (size == 1)
+		{
+			taps.index[0] = 0;
+			taps.weight[0] = 1.0f;
+			taps.count = 1;
+		}
+		else if ((size & 1) == 0)
+		{
+			taps.index[0] = x * 2;
+			taps.index[1] = x * 2 + 1;
+			taps.weight[0] = 0.5f;
+			taps.weight[1] = 0.5f;
+			taps.count = 2;
+		}
+		else
+		{
+			float inverse = 1.0f / size;
+			taps.index[0] = x * 2;
+			taps.index[1] = x * 2 + 1;
+			taps.index[2] = x * 2 + 2;
+			taps.weight[0] = (nextsize - x) * inverse;
+			taps.weight[1] = nextsize * inverse;
+			taps.weight[2] = (x + 1) * inverse;
+			taps.count = 3;
+		}
+		return taps;
+	}
+
+	void GenerateMips(const Byte* rgba, DWord width, DWord height, texturetype type, std::vector<std::vector<Byte>>& levels)
+	{
+		bool color = IsColorTexture(type);
+		bool normal = type == TT_NORMAL;
+
+		levels.clear();
+		levels.emplace_back(rgba, rgba + static_cast<usize>(width) * height * 4);
+
+		/* Table of the sRGB curve for the 256 byte values*/
+		float linear[256];
+		for (int i = 0; i < 256; i++)
+		{
+			linear[i] = color ? SRGBToLinear(i / 255.0f) : normal ? i / 127.5f - 1.0f : i / 255.0f;
+		}
+
+		/* Every level is filtered from the float version of the one above it, not from the rounded bytes*/
+		std::vector<float> current(static_cast<usize>(width) * height * 4);
+		for (usize i = 0; i < current.size(); i++)
+		{
+			current[i] = (i & 3) == 3 ? rgba[i] / 255.0f : linear[rgba[i]];
+		}
+
+		while (width > 1 || height > 1)
+		{
+			DWord nextwidth = width > 1 ? width / 2 : 1;
+			DWord nextheight = height > 1 ? height / 2 : 1;
+
+			std::vector<float> next(static_cast<usize>(nextwidth) * nextheight * 4);
+			std::vector<Byte> bytes(next.size());
+
+			std::vector<MipTaps> columns(nextwidth);
+			for (DWord x = 0; x < nextwidth; x++)
+			{
+				columns[x] = MipFootprint(x, width, nextwidth);
+			}
+
+			engine::jobs::ParallelFor(nextheight, 0, [&](DWord begin, DWord end)
+			{
+				for (DWord y = begin; y < end; y++)
+				{
+					MipTaps rows = MipFootprint(y, height, nextheight);
+
+					for (DWord x = 0; x < nextwidth; x++)
+					{
+						const MipTaps& taps = columns[x];
+
+						float* out = &next[(static_cast<usize>(y) * nextwidth + x) * 4];
+						out[0] = out[1] = out[2] = out[3] = 0.0f;
+						for (DWord j = 0; j < rows.count; j++)
+						{
+							for (DWord k = 0; k < taps.count; k++)
+							{
+								const float* texel = &current[(static_cast<usize>(rows.index[j]) * width + taps.index[k]) * 4];
+								float weight = rows.weight[j] * taps.weight[k];
+								for (int i = 0; i < 4; i++)
+								{
+									out[i] += texel[i] * weight;
+								}
+							}
+						}
+
+						if (normal)
+						{
+							float length = std::sqrt(out[0] * out[0] + out[1] * out[1] + out[2] * out[2]);
+							if (length > 1e-6f)
+							{
+								out[0] /= length;
+								out[1] /= length;
+								out[2] /= length;
+							}
+						}
+
+						Byte* pixel = &bytes[(static_cast<usize>(y) * nextwidth + x) * 4];
+						for (int i = 0; i < 3; i++)
+						{
+							pixel[i] = color ? ToByte(LinearToSRGB(out[i])) : normal ? ToByte(out[i] * 0.5f + 0.5f) : ToByte(out[i]);
+						}
+						pixel[3] = ToByte(out[3]);
+					}
+				}
+			});
+
+			levels.push_back(std::move(bytes));
+			current.swap(next);
+			width = nextwidth;
+			height = nextheight;
+		}
+	}
+
+	/* Copies a 4x4 block out of an image, repeating the edge for blocks that hang over it*/
+	static void FetchBlock(const Byte* rgba, DWord width, DWord height, DWord bx, DWord by, Byte* pixels)
+	{
+		for (DWord y = 0; y < 4; y++)
+		{
+			DWord sy = std::min(by * 4 + y, height - 1);
+			for (DWord x = 0; x < 4; x++)
+			{
+				DWord sx = std::min(bx * 4 + x, width - 1);
+				std::memcpy(pixels + (y * 4 + x) * 4, rgba + (static_cast<usize>(sy) * width + sx) * 4, 4);
+			}
+		}
+	}
+
+	void CompressImage(imageformat format, const Byte* rgba, DWord width, DWord height, Byte* destination)
+	{
+		DWord blockswide = (width + 3) / 4;
+		DWord blockshigh = (height + 3) / 4;
+		DWord blocksize = (format == IF_BC1 || format == IF_BC1_SRGB || format == IF_BC4) ? 8 : 16;
+
+		/* One row of blocks per task keeps every task's source rows next to each other in memory*/
+		engine::jobs::ParallelFor(blockshigh, 0, [&](DWord begin, DWord end)
+		{
+			Byte pixels[64];
+			for (DWord by = begin; by < end; by++)
+			{
+				Byte* out = destination + static_cast<usize>(by) * blockswide * blocksize;
+				for (DWord bx = 0; bx < blockswide; bx++, out += blocksize)
+				{
+					FetchBlock(rgba, width, height, bx, by, pixels);
+
+					switch (format)
+					{
+					case IF_BC1:
+					case IF_BC1_SRGB:	EncodeBC1(pixels, out);		break;
+					case IF_BC3:
+					case IF_BC3_SRGB:	EncodeBC3(pixels, out);		break;
+					case IF_BC4:		EncodeBC4(pixels, 0, out);	break;
+					case IF_BC5:		EncodeBC5(pixels, out);		break;
+					case IF_BC7:
+					case IF_BC7_SRGB:	EncodeBC7(pixels, out);		break;
+					default:										break;
+					}
+				}
+			}
+		});
+	}
+
+	int CookTexture(const Byte* rgba, DWord width, DWord height, texturetype type, imagefile& image, std::vector<Byte>& data,
+		const MetalCookSettings& settings)
+	{
+		if (rgba == nullptr || width == 0 || height == 0)
+		{
+			return 1;
+		}
+
+		bool hasalpha = false;
+		for (usize i = 3; i < static_cast<usize>(width) * height * 4 && !hasalpha; i += 4)
+		{
+			hasalpha = rgba[i] != 255;
+		}
+
+		std::vector<std::vector<Byte>> levels;
+		if (settings.generatemips)
+		{
+			GenerateMips(rgba, width, height, type, levels);
+		}
+		else
+		{
+			levels.emplace_back(rgba, rgba + static_cast<usize>(width) * height * 4);
+		}
+
+		/* Drop top levels that are over the size limit*/
+		DWord first = 0;
+		while (settings.maxsize != 0 && first + 1 < levels.size() && std::max(width, height) > settings.maxsize)
+		{
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+			first++;
+		}
+
+		image.width = width;
+		image.height = height;
+		image.type = type;
+		image.format = settings.compress ? ChooseCookedFormat(type, hasalpha) : IsColorTexture(type) ? IF_RGBA8_SRGB : IF_RGBA8;
+		BuildMipChain(image);
+		image.mips.resize(levels.size() - first);
+
+		const imagemip& last = image.mips.back();
+		data.resize(last.offset + last.size);
+
+		for (usize i = 0; i < image.mips.size(); i++)
+		{
+			const imagemip& mip = image.mips[i];
+			if (settings.compress)
+			{
+				CompressImage(image.format, levels[first + i].data(), mip.width, mip.height, data.data() + mip.offset);
+			}
+			else
+			{
+				std::memcpy(data.data() + mip.offset, levels[first + i].data(), mip.size);
+			}
+		}
+
+		return 0;
+	}
+
+	/* Bilinear sample of one channel, u and v in pixels of the source*/
+	static float SampleChannel(const MetalChannelSource& source, float u, float v)
+	{
+		u = std::clamp(u, 0.0f, static_cast<float>(source.width - 1));
+		v = std::clamp(v, 0.0f, static_cast<float>(source.height - 1));
+
+		DWord x0 = static_cast<DWord>(u);
+		DWord y0 = static_cast<DWord>(v);
+		DWord x1 = std::min(x0 + 1, source.width - 1);
+		DWord y1 = std::min(y0 + 1, source.height - 1);
+		float fx = u - x0;
+		float fy = v - y0;
+
+		auto Texel = [&](DWord x, DWord y) { return static_cast<float>(source.rgba[(static_cast<usize>(y) * source.width + x) * 4 + source.channel]); };
+		float top = Texel(x0, y0) + (Texel(x1, y0) - Texel(x0, y0)) * fx;
+		float bottom = Texel(x0, y1) + (Texel(x1, y1) - Texel(x0, y1)) * fx;
+		return top + (bottom - top) * fy;
+	}
+
+	int PackChannels(const MetalChannelSource sources[4], std::vector<Byte>& rgba, DWord& width, DWord& height)
+	{
+		width = 0;
+		height = 0;
+		for (int c = 0; c < 4; c++)
+		{
+			if (sources[c].rgba != nullptr)
+			{
+				width = std::max(width, sources[c].width);
+				height = std::max(height, sources[c].height);
+			}
+		}
+
+		if (width == 0 || height == 0)
+		{
+			return 1;
+		}
+
+		rgba.resize(static_cast<usize>(width) * height * 4);
+
+		engine::jobs::ParallelFor(height, 0, [&](DWord begin, DWord end)
+		{
+			for (DWord y = begin; y < end; y++)
+			{
+				for (DWord x = 0; x < width; x++)
+				{
+					Byte* pixel = &rgba[(static_cast<usize>(y) * width + x) * 4];
+					for (int c = 0; c < 4; c++)
+					{
+						const MetalChannelSource& source = sources[c];
+						if (source.rgba == nullptr)
+						{
+							pixel[c] = source.constant;
+						}
+						else if (source.width == width && source.height == height)
+						{
+							pixel[c] = source.rgba[(static_cast<usize>(y) * width + x) * 4 + source.channel];
+						}
+						else
+						{
+							/* Pixel centers line up between the two sizes*/
+							float u = (x + 0.5f) * source.width / width - 0.5f;
+							float v = (y + 0.5f) * source.height / height - 0.5f;
+							pixel[c] = static_cast<Byte>(SampleChannel(source, u, v) + 0.5f);
+						}
+					}
+				}
+			}
+		});
+
+		return 0;
+	}
+
+	int CookORM(const MetalChannelSource& occlusion, const MetalChannelSource& roughness, const MetalChannelSource& metallic,
+		imagefile& image, std::vector<Byte>& data, engine::materials::MetalChannelMap& channels, const MetalCookSettings& settings)
+	{
+		using namespace engine::materials;
+
+		/* Alpha stays opaque so the encoder spends no bits on it*/
+		MetalChannelSource sources[4] = { occlusion, roughness, metallic, MetalChannelSource() };
+		sources[3].constant = 255;
+
+		std::vector<Byte> packed;
+		DWord width;
+		DWord height;
+		if (PackChannels(sources, packed, width, height) != 0)
+		{
+			return 1;
+		}
+
+		channels.occlusion = occlusion.rgba != nullptr ? MC_RED : MC_CONSTANT;
+		channels.roughness = roughness.rgba != nullptr ? MC_GREEN : MC_CONSTANT;
+		channels.metallic = metallic.rgba != nullptr ? MC_BLUE : MC_CONSTANT;
+
+		return CookTexture(packed.data(), width, height, TT_ORM, image, data, settings);
+	}
+
+	int WritePackageTexture(MEPF* package, const char* name, const imagefile& image, const std::vector<Byte>& data)
+	{
+		MetalCookedHeader header = {};
+		header.magic		= COOKED_TEXTURE_MAGIC;
+		header.width		= image.width;
+		header.height		= image.height;
+		header.type			= image.type;
+		header.format		= image.format;
+		header.mipcount		= static_cast<DWord>(image.mips.size());
+		header.dataoffset	= (sizeof(MetalCookedHeader) + sizeof(MetalCookedMip) * image.mips.size() + 15) & ~QWord(15);
+
+		std::vector<Byte> entry(header.dataoffset + data.size(), 0);
+		std::memcpy(entry.data(), &header, sizeof(header));
+
+		MetalCookedMip* mips = reinterpret_cast<MetalCookedMip*>(entry.data() + sizeof(header));
+		for (usize i = 0; i < image.mips.size(); i++)
+		{
+			mips[i] = { image.mips[i].width, image.mips[i].height, image.mips[i].offset, image.mips[i].size };
+		}
+
+		if (!data.empty())
+		{
+			std::memcpy(entry.data() + header.dataoffset, data.data(), data.size());
+		}
+		return MEPFAddEntry(package, name, MEPF_ENTRY_TEXTURE, entry.data(), entry.size());
+	}
+
+	int ReadPackageTexture(MEPF* package, const char* name, imagefile& image, MetalPackageTexture& source)
+	{
+		const MEPFEntry* entry = MEPFFindEntry(package, name);
+		if (entry == nullptr || entry->type != MEPF_ENTRY_TEXTURE)
+		{
+			return 1;
+		}
+
+		MetalCookedHeader header;
+		if (MEPFReadEntry(package, entry, 0, &header, sizeof(header)) != 0 || header.magic != COOKED_TEXTURE_MAGIC ||
+			header.mipcount == 0 || header.mipcount > 32)
+		{
+			return 1;
+		}
+
+		std::vector<MetalCookedMip> mips(header.mipcount);
+		if (MEPFReadEntry(package, entry, sizeof(header), mips.data(), sizeof(MetalCookedMip) * mips.size()) != 0)
+		{
+			return 1;
+		}
+
+		image.width = header.width;
+		image.height = header.height;
+		image.type = static_cast<texturetype>(header.type);
+		image.format = static_cast<imageformat>(header.format);
+		image.mips.resize(header.mipcount);
+
+		source.package = package;
+		source.entry = entry;
+		source.dataoffset = header.dataoffset;
+		source.mipoffsets.resize(header.mipcount);
+
+		for (DWord i = 0; i < header.mipcount; i++)
+		{
+			image.mips[i] = { mips[i].width, mips[i].height, mips[i].offset, mips[i].size };
+			source.mipoffsets[i] = mips[i].offset;
+		}
+		return 0;
+	}
+
+	bool PackageTextureReader(void* userdata, DWord mip, Byte* destination, QWord size)
+	{
+		const MetalPackageTexture* source = static_cast<const MetalPackageTexture*>(userdata);
+		if (mip >= source->mipoffsets.size())
+		{
+			return false;
+		}
+		return MEPFReadEntry(source->package, source->entry, source->dataoffset + source->mipoffsets[mip], destination, size) == 0;
+	}
+}
@@ -0,0 +1,702 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine texture streaming (mip residency, VRAM budget, async uploads)
+// ------------------------------------------------------
+
+#include <algorithm>
+
+#include "headers/MTextureStreamer.hpp"
+#include "headers/MError.h"
+#include "headers/MProfiler.hpp"
+#include "headers/MCounters.h"
+
+namespace engine::vulkan
+{
+	/* vkCmdCopyBufferToImage wants offsets aligned to the texel block size and to 4*/
+	static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+	static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	VkFormat GetImageVkFormat(imageformat format)
+	{
+		switch (format)
+		{
+		case IF_RGBA8:			return VK_FORMAT_R8G8B8A8_UNORM;
+		case IF_RGBA8_SRGB:		return VK_FORMAT_R8G8B8A8_SRGB;
+		case IF_BC1:			return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+		case IF_BC1_SRGB:		return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+		case IF_BC3:			return VK_FORMAT_BC3_UNORM_BLOCK;
+		case IF_BC3_SRGB:		return VK_FORMAT_BC3_SRGB_BLOCK;
+		case IF_BC4:			return VK_FORMAT_BC4_UNORM_BLOCK;
+		case IF_BC5:			return VK_FORMAT_BC5_UNORM_BLOCK;
+		case IF_BC7:			return VK_FORMAT_BC7_UNORM_BLOCK;
+		case IF_BC7_SRGB:		return VK_FORMAT_BC7_SRGB_BLOCK;
+		default:				return VK_FORMAT_UNDEFINED;
+		}
+	}
+
+	MetalTextureStreamer::~MetalTextureStreamer()
+	{
+		Destroy();
+	}
+
+	int MetalTextureStreamer::Create(VkDeviceSize budgetbytes, VkDeviceSize size)
+	{
+		budget = budgetbytes != 0 ? budgetbytes : DefaultBudget();
+		stagingsize = size;
+
+		/* Workers write mips straight into this, so it stays mapped for the streamer's whole life*/
+		CreateBuffer(stagingsize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingbuffer, stagingmemory);
+		VK_CHECK(vkMapMemory(m_device, stagingmemory, 0, stagingsize, 0, (void**)&stagingdata));
+
+		VkSamplerCreateInfo SamplerInfo = {};
+		SamplerInfo.sType				= VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		SamplerInfo.magFilter			= VK_FILTER_LINEAR;
+		SamplerInfo.minFilter			= VK_FILTER_LINEAR;
+		SamplerInfo.mipmapMode			= VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		SamplerInfo.addressModeU		= VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		SamplerInfo.addressModeV		= VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		SamplerInfo.addressModeW		= VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		SamplerInfo.anisotropyEnable	= VK_TRUE;
+		SamplerInfo.maxAnisotropy		= m_properties.limits.maxSamplerAnisotropy;
+		SamplerInfo.minLod				= 0.0f;
+		SamplerInfo.maxLod				= VK_LOD_CLAMP_NONE;
+		VK_CHECK(vkCreateSampler(m_device, &SamplerInfo, nullptr, &sampler));
+
+		fmt::print("ENGINE: Texture streaming ready ({} MB budget, {} MB staging)\n", budget >> 20, stagingsize >> 20);
+		return 0;
+	}
+
+	void MetalTextureStreamer::Destroy()
+	{
+		if (stagingbuffer == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		/* Readers write into the staging memory, so they have to be done before it goes*/
+		engine::jobs::WaitForCounter(&readcounter);
+		loads.clear();
+
+		for (auto& texture : textures)
+		{
+			if (texture && texture->alive)
+			{
+				RetireImage(*texture);
+			}
+		}
+
+		for (const Retired& image : retired)
+		{
+			vkDestroyImageView(m_device, image.view, nullptr);
+			vkDestroyImage(m_device, image.image, nullptr);
+			vkFreeMemory(m_device, image.memory, nullptr);
+		}
+
+		textures.clear();
+		freetextures.clear();
+		retired.clear();
+		stagingblocks.clear();
+		usedmemory = 0;
+		retiredmemory = 0;
+
+		vkDestroySampler(m_device, sampler, nullptr);
+		vkUnmapMemory(m_device, stagingmemory);
+		vkDestroyBuffer(m_device, stagingbuffer, nullptr);
+		vkFreeMemory(m_device, stagingmemory, nullptr);
+
+		sampler = VK_NULL_HANDLE;
+		stagingbuffer = VK_NULL_HANDLE;
+		stagingmemory = VK_NULL_HANDLE;
+		stagingdata = nullptr;
+	}
+
+	DWord MetalTextureStreamer::AddTexture(const imagefile& file, MetalTextureReader reader, void* userdata)
+	{
+		if (file.mips.empty() || file.mips.size() > 32 || reader == nullptr)
+		{
+			WarningMessage("Texture Streaming WARNING", "Tried to add a texture without a mip chain or reader");
+			return STREAMING_INVALID;
+		}
+
+		DWord handle;
+		if (!freetextures.empty())
+		{
+			handle = freetextures.back();
+			freetextures.pop_back();
+		}
+		else
+		{
+			handle = static_cast<DWord>(textures.size());
+			textures.emplace_back();
+		}
+
+		textures[handle] = std::make_unique<Texture>();
+		Texture& texture = *textures[handle];
+		texture.file = file;
+		texture.reader = reader;
+		texture.userdata = userdata;
+		texture.alive = true;
+		texture.lastused = frame;
+
+		/* Everything from the first level at or under STREAMING_RESIDENT_TAIL down to 1x1*/
+		DWord mipcount = static_cast<DWord>(file.mips.size());
+		texture.tailmip = mipcount - 1;
+		while (texture.tailmip > 0 &&
+			max(file.mips[texture.tailmip - 1].width, file.mips[texture.tailmip - 1].height) <= STREAMING_RESIDENT_TAIL)
+		{
+			texture.tailmip--;
+		}
+
+		texture.residentmip = mipcount;
+		texture.wantedmip = texture.tailmip;
+		return handle;
+	}
+
+	void MetalTextureStreamer::RemoveTexture(DWord handle)
+	{
+		if (handle >= textures.size() || !textures[handle] || !textures[handle]->alive)
+		{
+			return;
+		}
+
+		Texture& texture = *textures[handle];
+		texture.alive = false;
+		RetireImage(texture);
+
+		/* A read still in flight keeps the handle until Update sees it finish*/
+		if (texture.loading == nullptr)
+		{
+			freetextures.push_back(handle);
+		}
+	}
+
+	void MetalTextureStreamer::ReportScreenSize(DWord handle, float pixels)
+	{
+		Texture& texture = *textures[handle];
+		if (!texture.alive)
+		{
+			return;
+		}
+
+		/* One mip finer than needed is never useful, the sampler would only pick the coarser one*/
+		float longest = static_cast<float>(max(texture.file.width, texture.file.height));
+		DWord mip = texture.tailmip;
+		if (pixels > 0.0f)
+		{
+			float ratio = longest / pixels;
+			mip = ratio <= 1.0f ? 0 : static_cast<DWord>(std::floor(std::log2(ratio)));
+			mip = min(mip, texture.tailmip);
+		}
+
+		DWord current = texture.requestedmip.load(std::memory_order_relaxed);
+		while (mip < current && !texture.requestedmip.compare_exchange_weak(current, mip, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	DWord MetalTextureStreamer::GetBindlessSlot(DWord handle) const
+	{
+		const Texture& texture = *textures[handle];
+		return texture.alive && texture.slot != BINDLESS_INVALID ? texture.slot : fallbackslot;
+	}
+
+	float MetalTextureStreamer::ScreenSizeFromSphere(float radius, float distance, float fovy, float screenheight)
+	{
+		distance = max(distance, radius);
+		if (distance <= 0.0f)
+		{
+			return screenheight;
+		}
+		return (radius / (distance * std::tan(fovy * 0.5f))) * screenheight;
+	}
+
+	VkDeviceSize MetalTextureStreamer::DefaultBudget()
+	{
+		VkPhysicalDeviceMemoryProperties MemoryProperties;
+		vkGetPhysicalDeviceMemoryProperties(m_physicaldevice, &MemoryProperties);
+
+		VkDeviceSize largest = 0;
+		for (VkUint32 i = 0; i < MemoryProperties.memoryHeapCount; i++)
+		{
+			if (MemoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+			{
+				largest = max(largest, MemoryProperties.memoryHeaps[i].size);
+			}
+		}
+		return largest / 2;
+	}
+
+	bool MetalTextureStreamer::AllocateStaging(VkDeviceSize size, VkDeviceSize& offset)
+	{
+		size = AlignUp(size, STAGING_ALIGNMENT);
+		if (size > stagingsize)
+		{
+			return false;
+		}
+
+		if (stagingblocks.empty())
+		{
+			offset = 0;
+			stagingblocks.push_back({ 0, 0, size, STREAMING_NEVER });
+			return true;
+		}
+
+		VkDeviceSize head = stagingblocks.back().end;
+		VkDeviceSize tail = stagingblocks.front().start;
+
+		if (head > tail)
+		{
+			/* Free space is after head and before tail*/
+			if (stagingsize - head >= size)
+			{
+				offset = head;
+				stagingblocks.push_back({ head, head, head + size, STREAMING_NEVER });
+				return true;
+			}
+			if (tail >= size)
+			{
+				offset = 0;
+				stagingblocks.push_back({ head, 0, size, STREAMING_NEVER });
+				return true;
+			}
+			return false;
+		}
+
+		/* Wrapped, the free space is between head and tail (none when they meet)*/
+		if (tail - head >= size)
+		{
+			offset = head;
+			stagingblocks.push_back({ head, head, head + size, STREAMING_NEVER });
+			return true;
+		}
+		return false;
+	}
+
+	void MetalTextureStreamer::ReleaseStaging(VkDeviceSize offset, QWord consumed)
+	{
+		for (StagingBlock& block : stagingblocks)
+		{
+			if (block.offset == offset && block.frame == STREAMING_NEVER)
+			{
+				block.frame = consumed;
+				return;
+			}
+		}
+	}
+
+	void MetalTextureStreamer::FreeStaging(QWord current)
+	{
+		/* Blocks free in order, a slow read at the front holds back the ones after it*/
+		while (!stagingblocks.empty() && stagingblocks.front().frame != STREAMING_NEVER &&
+			stagingblocks.front().frame + MAXIMUM_FRAMES_IN_FLIGHTS <= current)
+		{
+			stagingblocks.pop_front();
+		}
+	}
+
+	VkDeviceSize MetalTextureStreamer::ChainSize(const Texture& texture, DWord firstmip) const
+	{
+		VkDeviceSize size = 0;
+		for (usize i = firstmip; i < texture.file.mips.size(); i++)
+		{
+			size += texture.file.mips[i].size;
+		}
+		return size;
+	}
+
+	void MetalTextureStreamer::ReadJob(void* userdata)
+	{
+		Load* load = static_cast<Load*>(userdata);
+
+		for (DWord mip = load->firstmip; mip <= load->lastmip; mip++)
+		{
+			const imagemip& level = load->file->mips[mip];
+			if (!load->reader(load->userdata, mip, load->destination + load->mipoffsets[mip - load->firstmip], level.size))
+			{
+				load->state.store(2, std::memory_order_release);
+				return;
+			}
+		}
+
+		load->state.store(1, std::memory_order_release);
+	}
+
+	bool MetalTextureStreamer::StartLoad(DWord handle, DWord firstmip, DWord lastmip)
+	{
+		if (loads.size() >= STREAMING_MAX_LOADS)
+		{
+			return false;
+		}
+
+		Texture& texture = *textures[handle];
+
+		QWord offsets[32];
+		VkDeviceSize total = 0;
+		for (DWord mip = firstmip; mip <= lastmip; mip++)
+		{
+			offsets[mip - firstmip] = total;
+			total += AlignUp(texture.file.mips[mip].size, STAGING_ALIGNMENT);
+		}
+
+		VkDeviceSize offset;
+		if (!AllocateStaging(total, offset))
+		{
+			return false;
+		}
+
+		auto load = std::make_unique<Load>();
+		load->texture		= handle;
+		load->firstmip		= firstmip;
+		load->lastmip		= lastmip;
+		load->stagingoffset	= offset;
+		load->destination	= stagingdata + offset;
+		load->reader		= texture.reader;
+		load->userdata		= texture.userdata;
+		load->file			= &texture.file;
+		std::copy(offsets, offsets + (lastmip - firstmip + 1), load->mipoffsets);
+
+		texture.loading = load.get();
+		engine::jobs::RunJob(ReadJob, load.get(), &readcounter);
+		loads.push_back(std::move(load));
+		return true;
+	}
+
+	void MetalTextureStreamer::RetireImage(Texture& texture)
+	{
+		if (texture.image != VK_NULL_HANDLE)
+		{
+			retired.push_back({ texture.image, texture.memory, texture.view, texture.bytes, frame });
+			usedmemory -= texture.bytes;
+			retiredmemory += texture.bytes;
+			texture.image = VK_NULL_HANDLE;
+			texture.memory = VK_NULL_HANDLE;
+			texture.view = VK_NULL_HANDLE;
+			texture.bytes = 0;
+		}
+
+		if (texture.slot != BINDLESS_INVALID)
+		{
+			BindlessReleaseTexture(texture.slot);
+			texture.slot = BINDLESS_INVALID;
+		}
+	}
+
+	void MetalTextureStreamer::Rebuild(VkCommandBuffer commandbuffer, DWord handle, DWord newmip, const Load* load)
+	{
+		Texture& texture = *textures[handle];
+		const vector<imagemip>& mips = texture.file.mips;
+		DWord mipcount = static_cast<DWord>(mips.size());
+		DWord levels = mipcount - newmip;
+
+		VkImageCreateInfo ImageInfo = {};
+		ImageInfo.sType			= VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		ImageInfo.imageType		= VK_IMAGE_TYPE_2D;
+		ImageInfo.format		= GetImageVkFormat(texture.file.format);
+		ImageInfo.extent		= { mips[newmip].width, mips[newmip].height, 1 };
+		ImageInfo.mipLevels		= levels;
+		ImageInfo.arrayLayers	= 1;
+		ImageInfo.samples		= VK_SAMPLE_COUNT_1_BIT;
+		ImageInfo.tiling		= VK_IMAGE_TILING_OPTIMAL;
+		ImageInfo.usage			= VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		ImageInfo.sharingMode	= VK_SHARING_MODE_EXCLUSIVE;
+		ImageInfo.initialLayout	= VK_IMAGE_LAYOUT_UNDEFINED;
+
+		VkImage image;
+		VkDeviceMemory memory;
+		CreateImageWithInfo(ImageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
+
+		VkMemoryRequirements Requirements;
+		vkGetImageMemoryRequirements(m_device, image, &Requirements);
+
+		/* New image becomes a copy target, the old one a copy source*/
+		array<VkImageMemoryBarrier, 2> Barriers = {};
+		Barriers[0].sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		Barriers[0].srcAccessMask					= 0;
+		Barriers[0].dstAccessMask					= VK_ACCESS_TRANSFER_WRITE_BIT;
+		Barriers[0].oldLayout						= VK_IMAGE_LAYOUT_UNDEFINED;
+		Barriers[0].newLayout						= VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		Barriers[0].srcQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		Barriers[0].dstQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		Barriers[0].image							= image;
+		Barriers[0].subresourceRange				= { VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1 };
+
+		VkUint32 barriercount = 1;
+		if (texture.image != VK_NULL_HANDLE)
+		{
+			Barriers[1] = Barriers[0];
+			Barriers[1].dstAccessMask				= VK_ACCESS_TRANSFER_READ_BIT;
+			Barriers[1].oldLayout					= VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			Barriers[1].newLayout					= VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			Barriers[1].image						= texture.image;
+			Barriers[1].subresourceRange.levelCount	= mipcount - texture.residentmip;
+			barriercount = 2;
+		}
+
+		vkCmdPipelineBarrier(commandbuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, barriercount, Barriers.data());
+
+		/* Levels both images have are copied on the GPU instead of read again*/
+		if (texture.image != VK_NULL_HANDLE)
+		{
+			vector<VkImageCopy> Copies;
+			for (DWord mip = max(newmip, texture.residentmip); mip < mipcount; mip++)
+			{
+				VkImageCopy Copy = {};
+				Copy.srcSubresource	= { VK_IMAGE_ASPECT_COLOR_BIT, mip - texture.residentmip, 0, 1 };
+				Copy.dstSubresource	= { VK_IMAGE_ASPECT_COLOR_BIT, mip - newmip, 0, 1 };
+				Copy.extent			= { mips[mip].width, mips[mip].height, 1 };
+				Copies.push_back(Copy);
+			}
+
+			vkCmdCopyImage(commandbuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<VkUint32>(Copies.size()), Copies.data());
+		}
+
+		if (load != nullptr)
+		{
+			vector<VkBufferImageCopy> Uploads;
+			long long UploadBytes = 0;
+			for (DWord mip = load->firstmip; mip <= load->lastmip; mip++)
+			{
+				UploadBytes += static_cast<long long>(mips[mip].size);
+				VkBufferImageCopy Upload = {};
+				Upload.bufferOffset		= load->stagingoffset + load->mipoffsets[mip - load->firstmip];
+				Upload.imageSubresource	= { VK_IMAGE_ASPECT_COLOR_BIT, mip - newmip, 0, 1 };
+				Upload.imageExtent		= { mips[mip].width, mips[mip].height, 1 };
+				Uploads.push_back(Upload);
+			}
+
+			vkCmdCopyBufferToImage(commandbuffer, stagingbuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				static_cast<VkUint32>(Uploads.size()), Uploads.data());
+			MetalCounterAdd(METAL_COUNTER_BYTES_UPLOADED, UploadBytes);
+		}
+
+		Barriers[0].srcAccessMask	= VK_ACCESS_TRANSFER_WRITE_BIT;
+		Barriers[0].dstAccessMask	= VK_ACCESS_SHADER_READ_BIT;
+		Barriers[0].oldLayout		= VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		Barriers[0].newLayout		= VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, Barriers.data());
+
+		VkImageViewCreateInfo ViewInfo = {};
+		ViewInfo.sType				= VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		ViewInfo.image				= image;
+		ViewInfo.viewType			= VK_IMAGE_VIEW_TYPE_2D;
+		ViewInfo.format				= ImageInfo.format;
+		ViewInfo.subresourceRange	= { VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1 };
+
+		VkImageView view;
+		VK_CHECK(vkCreateImageView(m_device, &ViewInfo, nullptr, &view));
+
+		/* The old image may still be sampled by frames in flight*/
+		RetireImage(texture);
+
+		texture.image		= image;
+		texture.memory		= memory;
+		texture.view		= view;
+		texture.bytes		= Requirements.size;
+		texture.residentmip	= newmip;
+		texture.slot		= BindlessRegisterTexture(view, sampler);
+		usedmemory += Requirements.size;
+	}
+
+	void MetalTextureStreamer::FinishLoad(VkCommandBuffer commandbuffer, Load* load)
+	{
+		Rebuild(commandbuffer, load->texture, load->firstmip, load);
+	}
+
+	bool MetalTextureStreamer::Evict(VkCommandBuffer commandbuffer, DWord handle)
+	{
+		Texture& texture = *textures[handle];
+		if (texture.image == VK_NULL_HANDLE || texture.residentmip >= texture.tailmip || texture.loading != nullptr)
+		{
+			return false;
+		}
+
+		Rebuild(commandbuffer, handle, texture.residentmip + 1, nullptr);
+		return true;
+	}
+
+	void MetalTextureStreamer::Update(VkCommandBuffer commandbuffer)
+	{
+		METAL_ZONE("Texture Streamer Update");
+
+		frame++;
+
+		/* Anything retired MAXIMUM_FRAMES_IN_FLIGHTS frames ago has had its fence waited on*/
+		usize kept = 0;
+		for (usize i = 0; i < retired.size(); i++)
+		{
+			if (retired[i].frame + MAXIMUM_FRAMES_IN_FLIGHTS <= frame)
+			{
+				vkDestroyImageView(m_device, retired[i].view, nullptr);
+				vkDestroyImage(m_device, retired[i].image, nullptr);
+				vkFreeMemory(m_device, retired[i].memory, nullptr);
+				retiredmemory -= retired[i].bytes;
+			}
+			else
+			{
+				retired[kept++] = retired[i];
+			}
+		}
+		retired.resize(kept);
+		FreeStaging(frame);
+
+		/* Reads that finished since the last frame*/
+		for (usize i = 0; i < loads.size();)
+		{
+			Load* load = loads[i].get();
+			DWord state = load->state.load(std::memory_order_acquire);
+			if (state == 0)
+			{
+				i++;
+				continue;
+			}
+
+			Texture& texture = *textures[load->texture];
+			texture.loading = nullptr;
+
+			if (!texture.alive)
+			{
+				freetextures.push_back(load->texture);
+			}
+			else if (state == 1)
+			{
+				FinishLoad(commandbuffer, load);
+			}
+			else
+			{
+				WarningMessage("Texture Streaming WARNING", "Failed to read mips %u-%u of texture %u, it will not stream",
+					load->firstmip, load->lastmip, load->texture);
+				texture.reader = nullptr;
+			}
+
+			ReleaseStaging(load->stagingoffset, frame);
+			loads[i] = std::move(loads.back());
+			loads.pop_back();
+		}
+
+		/* Turn this frame's feedback into what every texture wants*/
+		vector<DWord> wanting;
+		vector<DWord> evictable;
+		for (DWord handle = 0; handle < textures.size(); handle++)
+		{
+			Texture* texture = textures[handle].get();
+			if (texture == nullptr || !texture->alive)
+			{
+				continue;
+			}
+
+			DWord requested = texture->requestedmip.exchange(STREAMING_INVALID, std::memory_order_relaxed);
+			if (requested != STREAMING_INVALID)
+			{
+				texture->wantedmip = requested;
+				texture->lastused = frame;
+			}
+			else
+			{
+				texture->wantedmip = texture->tailmip;
+			}
+
+			if (texture->loading != nullptr)
+			{
+				continue;
+			}
+
+			if (texture->reader != nullptr && (texture->residentmip > texture->tailmip || texture->residentmip > texture->wantedmip))
+			{
+				wanting.push_back(handle);
+			}
+
+			if (texture->lastused != frame && texture->residentmip < texture->tailmip)
+			{
+				evictable.push_back(handle);
+			}
+		}
+
+		/* Least recently used first*/
+		std::sort(evictable.begin(), evictable.end(), [this](DWord a, DWord b)
+		{
+			return textures[a]->lastused < textures[b]->lastused;
+		});
+
+		usize victim = 0;
+		auto EvictUntil = [&](VkDeviceSize needed) -> bool
+		{
+			while (usedmemory + needed > budget)
+			{
+				while (victim < evictable.size() && !Evict(commandbuffer, evictable[victim]))
+				{
+					victim++;
+				}
+				if (victim >= evictable.size())
+				{
+					return false;
+				}
+			}
+			return true;
+		};
+
+		/* Get back under the budget if it shrank*/
+		EvictUntil(0);
+
+		/* Missing tails first, then whatever is the most mips short of what it wants*/
+		std::sort(wanting.begin(), wanting.end(), [this](DWord a, DWord b)
+		{
+			const Texture& ta = *textures[a];
+			const Texture& tb = *textures[b];
+			bool tailsa = ta.residentmip > ta.tailmip;
+			bool tailsb = tb.residentmip > tb.tailmip;
+			if (tailsa != tailsb)
+			{
+				return tailsa;
+			}
+			return (ta.residentmip - ta.wantedmip) > (tb.residentmip - tb.wantedmip);
+		});
+
+		for (DWord handle : wanting)
+		{
+			Texture& texture = *textures[handle];
+			DWord mipcount = static_cast<DWord>(texture.file.mips.size());
+
+			DWord firstmip;
+			DWord lastmip;
+			if (texture.residentmip > texture.tailmip)
+			{
+				/* The tail is always allowed, a texture has to have something to sample*/
+				firstmip = texture.tailmip;
+				lastmip = mipcount - 1;
+			}
+			else
+			{
+				firstmip = texture.residentmip - 1;
+				lastmip = firstmip;
+
+				VkDeviceSize needed = ChainSize(texture, firstmip) - ChainSize(texture, texture.residentmip);
+				if (!EvictUntil(needed))
+				{
+					continue;
+				}
+			}
+
+			/* Out of staging space or read slots, try again next frame*/
+			if (!StartLoad(handle, firstmip, lastmip))
+			{
+				break;
+			}
+		}
+	}
+}
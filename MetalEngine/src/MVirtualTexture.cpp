@@ -0,0 +1,715 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine virtual texturing, CPU side (page cooking, page cache, page tables, feedback resolver)
+// ------------------------------------------------------
+
+#include <algorithm>
+#include <cstring>
+
+#include "headers/MVirtualTexture.hpp"
+#include "headers/MTextureCooker.hpp"
+#include "headers/MError.h"
+
+namespace engine::textures
+{
+	using engine::jobs::RunJob;
+	using engine::jobs::WaitForCounter;
+	using engine::jobs::ParallelFor;
+
+	static bool IsPowerOfTwo(DWord value)
+	{
+		return value != 0 && (value & (value - 1)) == 0;
+	}
+
+	static void GrowRect(MetalPageRect& rect, DWord x0, DWord y0, DWord x1, DWord y1)
+	{
+		rect.x0 = std::min(rect.x0, x0);
+		rect.y0 = std::min(rect.y0, y0);
+		rect.x1 = std::max(rect.x1, x1);
+		rect.y1 = std::max(rect.y1, y1);
+	}
+
+	MetalPageResolver::~MetalPageResolver()
+	{
+		Destroy();
+	}
+
+	int MetalPageResolver::Create(DWord width, DWord height, QWord bytes, Byte* memory, DWord stagingpages, DWord frames)
+	{
+		if (width == 0 || height == 0 || width > VT_MAX_ATLAS_PAGES || height > VT_MAX_ATLAS_PAGES ||
+			bytes == 0 || memory == nullptr || stagingpages == 0)
+		{
+			WarningMessage("Virtual Texture WARNING", "Invalid page cache (%ux%u pages, %u staging pages)", width, height, stagingpages);
+			return 1;
+		}
+
+		cachewidth = width;
+		cacheheight = height;
+		pagebytes = bytes;
+		staging = memory;
+		latency = frames;
+		frame = 0;
+
+		slots.assign(static_cast<usize>(width) * height, Slot());
+		freeslots.clear();
+		for (DWord i = static_cast<DWord>(slots.size()); i > 0; i--)
+		{
+			freeslots.push_back(i - 1);
+		}
+
+		freestaging.clear();
+		for (DWord i = stagingpages; i > 0; i--)
+		{
+			freestaging.push_back(i - 1);
+		}
+		usedstaging.clear();
+
+		lruhead = VT_INVALID;
+		lrutail = VT_INVALID;
+		return 0;
+	}
+
+	void MetalPageResolver::Destroy()
+	{
+		/* Readers write into the staging memory, so they have to be done before it goes*/
+		WaitForCounter(&readcounter);
+		loads.clear();
+
+		textures.clear();
+		freetextures.clear();
+		slots.clear();
+		freeslots.clear();
+		pages.clear();
+		requests.clear();
+		freestaging.clear();
+		usedstaging.clear();
+		staging = nullptr;
+		lruhead = VT_INVALID;
+		lrutail = VT_INVALID;
+	}
+
+	DWord MetalPageResolver::AddTexture(const MetalVirtualTextureDesc& desc, MetalPageReader reader, void* userdata)
+	{
+		if (desc.levels.empty() || desc.levels.size() > VT_MAX_LEVELS || desc.pagebytes != pagebytes || reader == nullptr)
+		{
+			WarningMessage("Virtual Texture WARNING", "Tried to add a virtual texture that does not match the page cache");
+			return VT_INVALID;
+		}
+
+		DWord handle;
+		if (!freetextures.empty())
+		{
+			handle = freetextures.back();
+			freetextures.pop_back();
+		}
+		else if (textures.size() < VT_MAX_TEXTURES)
+		{
+			handle = static_cast<DWord>(textures.size());
+			textures.emplace_back();
+		}
+		else
+		{
+			WarningMessage("Virtual Texture WARNING", "Out of virtual texture handles (%u)", VT_MAX_TEXTURES);
+			return VT_INVALID;
+		}
+
+		textures[handle] = std::make_unique<Texture>();
+		Texture& texture = *textures[handle];
+		texture.desc = desc;
+		texture.reader = reader;
+		texture.userdata = userdata;
+		texture.alive = true;
+
+		/* Starts out all unmapped, which is what a cleared GPU table holds as well*/
+		usize levelcount = desc.levels.size();
+		texture.table.entries.resize(levelcount);
+		texture.table.slots.resize(levelcount);
+		texture.table.dirty.assign(levelcount, MetalPageRect());
+		for (usize level = 0; level < levelcount; level++)
+		{
+			usize count = static_cast<usize>(desc.levels[level].pagesx) * desc.levels[level].pagesy;
+			texture.table.entries[level].assign(count, 0);
+			texture.table.slots[level].assign(count, VT_INVALID);
+		}
+
+		RequestPage(handle, static_cast<DWord>(levelcount - 1), 0, 0);
+		return handle;
+	}
+
+	void MetalPageResolver::RemoveTexture(DWord handle)
+	{
+		if (!IsAlive(handle))
+		{
+			return;
+		}
+
+		Texture& texture = *textures[handle];
+		texture.alive = false;
+
+		for (DWord slot = 0; slot < slots.size(); slot++)
+		{
+			Slot& page = slots[slot];
+			if (!page.used || (page.key >> 40) != handle || page.loading)
+			{
+				continue;
+			}
+
+			Unlink(slot);
+			pages.erase(page.key);
+			page = Slot();
+			freeslots.push_back(slot);
+		}
+
+		for (auto it = requests.begin(); it != requests.end();)
+		{
+			it = (it->first >> 40) == handle ? requests.erase(it) : std::next(it);
+		}
+
+		/* A read still in flight keeps the handle until Update sees it finish*/
+		if (texture.loading == 0)
+		{
+			FreeTextureHandle(handle);
+		}
+	}
+
+	void MetalPageResolver::FreeTextureHandle(DWord handle)
+	{
+		textures[handle].reset();
+		freetextures.push_back(handle);
+	}
+
+	bool MetalPageResolver::IsResident(DWord handle, DWord mip, DWord x, DWord y) const
+	{
+		if (!IsAlive(handle))
+		{
+			return false;
+		}
+
+		const Texture& texture = *textures[handle];
+		if (mip >= texture.desc.levels.size() || x >= texture.desc.levels[mip].pagesx || y >= texture.desc.levels[mip].pagesy)
+		{
+			return false;
+		}
+		return texture.table.slots[mip][static_cast<usize>(y) * texture.desc.levels[mip].pagesx + x] != VT_INVALID;
+	}
+
+	void MetalPageResolver::Unlink(DWord slot)
+	{
+		Slot& page = slots[slot];
+		if (page.prev == VT_INVALID && lruhead != slot)
+		{
+			return;
+		}
+
+		if (page.prev != VT_INVALID)
+		{
+			slots[page.prev].next = page.next;
+		}
+		else
+		{
+			lruhead = page.next;
+		}
+
+		if (page.next != VT_INVALID)
+		{
+			slots[page.next].prev = page.prev;
+		}
+		else
+		{
+			lrutail = page.prev;
+		}
+
+		page.prev = VT_INVALID;
+		page.next = VT_INVALID;
+	}
+
+	void MetalPageResolver::PushFront(DWord slot)
+	{
+		Slot& page = slots[slot];
+		page.prev = VT_INVALID;
+		page.next = lruhead;
+		if (lruhead != VT_INVALID)
+		{
+			slots[lruhead].prev = slot;
+		}
+		lruhead = slot;
+		if (lrutail == VT_INVALID)
+		{
+			lrutail = slot;
+		}
+	}
+
+	void MetalPageResolver::Touch(DWord slot)
+	{
+		Slot& page = slots[slot];
+		if (page.lastused == frame || page.loading)
+		{
+			page.lastused = frame;
+			return;
+		}
+
+		page.lastused = frame;
+		if (!page.pinned)
+		{
+			Unlink(slot);
+			PushFront(slot);
+		}
+	}
+
+	DWord MetalPageResolver::AllocateSlot()
+	{
+		if (!freeslots.empty())
+		{
+			DWord slot = freeslots.back();
+			freeslots.pop_back();
+			return slot;
+		}
+
+		/* Pages used this frame are on screen, evicting them would only bring them right back*/
+		if (lrutail == VT_INVALID || slots[lrutail].lastused == frame)
+		{
+			return VT_INVALID;
+		}
+
+		DWord slot = lrutail;
+		Unlink(slot);
+		MapPage(slot, false);
+		pages.erase(slots[slot].key);
+		slots[slot] = Slot();
+		stats.evicted++;
+		return slot;
+	}
+
+	void MetalPageResolver::MapPage(DWord slot, bool map)
+	{
+		const Slot& page = slots[slot];
+		DWord handle = static_cast<DWord>(page.key >> 40);
+		DWord mip = static_cast<DWord>(page.key >> 32) & 0xFF;
+		DWord y = static_cast<DWord>(page.key >> 16) & 0xFFFF;
+		DWord x = static_cast<DWord>(page.key) & 0xFFFF;
+
+		Texture& texture = *textures[handle];
+		texture.table.slots[mip][static_cast<usize>(y) * texture.desc.levels[mip].pagesx + x] = map ? slot : VT_INVALID;
+		UpdateTable(texture, mip, x, y);
+	}
+
+	void MetalPageResolver::UpdateTable(Texture& texture, DWord mip, DWord x, DWord y)
+	{
+		/* Every page under the changed one falls back to it (or to whatever its parent falls back to),
+			so walk down from its level rebuilding the rectangle it covers*/
+		DWord levelcount = static_cast<DWord>(texture.desc.levels.size());
+		for (DWord level = mip + 1; level-- > 0;)
+		{
+			const MetalVirtualLevel& info = texture.desc.levels[level];
+			DWord shift = mip - level;
+			DWord x0 = std::min(x << shift, info.pagesx);
+			DWord y0 = std::min(y << shift, info.pagesy);
+			DWord x1 = std::min((x + 1) << shift, info.pagesx);
+			DWord y1 = std::min((y + 1) << shift, info.pagesy);
+
+			const std::vector<DWord>* parent = level + 1 < levelcount ? &texture.table.entries[level + 1] : nullptr;
+			DWord parentwidth = level + 1 < levelcount ? texture.desc.levels[level + 1].pagesx : 0;
+			DWord parentheight = level + 1 < levelcount ? texture.desc.levels[level + 1].pagesy : 0;
+
+			for (DWord py = y0; py < y1; py++)
+			{
+				for (DWord px = x0; px < x1; px++)
+				{
+					usize index = static_cast<usize>(py) * info.pagesx + px;
+					DWord slot = texture.table.slots[level][index];
+					DWord entry = 0;
+					if (slot != VT_INVALID)
+					{
+						entry = PackPageEntry(slot % cachewidth, slot / cachewidth, level);
+					}
+					else if (parent != nullptr)
+					{
+						entry = (*parent)[static_cast<usize>(std::min(py >> 1, parentheight - 1)) * parentwidth + std::min(px >> 1, parentwidth - 1)];
+					}
+					texture.table.entries[level][index] = entry;
+				}
+			}
+
+			GrowRect(texture.table.dirty[level], x0, y0, x1, y1);
+		}
+	}
+
+	void MetalPageResolver::ClearDirty(DWord handle)
+	{
+		if (IsAlive(handle))
+		{
+			std::fill(textures[handle]->table.dirty.begin(), textures[handle]->table.dirty.end(), MetalPageRect());
+		}
+	}
+
+	void MetalPageResolver::RequestPage(DWord handle, DWord mip, DWord x, DWord y)
+	{
+		if (!IsAlive(handle))
+		{
+			return;
+		}
+
+		const Texture& texture = *textures[handle];
+		DWord levelcount = static_cast<DWord>(texture.desc.levels.size());
+		if (mip >= levelcount || x >= texture.desc.levels[mip].pagesx || y >= texture.desc.levels[mip].pagesy)
+		{
+			return;
+		}
+
+		/* The pages above are what gets sampled until this one arrives, keep them around too*/
+		for (; mip < levelcount; mip++, x >>= 1, y >>= 1)
+		{
+			QWord key = MakeKey(handle, mip, x, y);
+			auto found = pages.find(key);
+			if (found != pages.end())
+			{
+				Touch(found->second);
+			}
+			else
+			{
+				requests[key]++;
+			}
+		}
+	}
+
+	void MetalPageResolver::ProcessFeedback(const DWord* feedback, usize count)
+	{
+		/* Neighbouring texels mostly want the same page, skip runs instead of hashing each one*/
+		DWord previous = VT_FEEDBACK_NONE;
+		for (usize i = 0; i < count; i++)
+		{
+			DWord request = feedback[i];
+			if (request == VT_FEEDBACK_NONE || request == previous)
+			{
+				continue;
+			}
+			previous = request;
+
+			DWord handle, mip, x, y;
+			UnpackPageRequest(request, handle, mip, x, y);
+			RequestPage(handle, mip, x, y);
+		}
+	}
+
+	void MetalPageResolver::ReadJob(void* userdata)
+	{
+		Load* load = static_cast<Load*>(userdata);
+		bool read = load->reader(load->userdata, load->mip, load->x, load->y, load->destination, load->size);
+		load->state.store(read ? 1 : 2, std::memory_order_release);
+	}
+
+	void MetalPageResolver::Update(std::vector<MetalPageUpload>& uploads)
+	{
+		stats = MetalPageStats();
+
+		/* Staging pages the GPU has finished copying out of*/
+		for (usize i = 0; i < usedstaging.size();)
+		{
+			if (usedstaging[i].second + latency <= frame)
+			{
+				freestaging.push_back(usedstaging[i].first);
+				usedstaging[i] = usedstaging.back();
+				usedstaging.pop_back();
+			}
+			else
+			{
+				i++;
+			}
+		}
+
+		/* Reads that finished since the last frame*/
+		for (usize i = 0; i < loads.size();)
+		{
+			Load* load = loads[i].get();
+			DWord state = load->state.load(std::memory_order_acquire);
+			if (state == 0)
+			{
+				i++;
+				continue;
+			}
+
+			Texture& texture = *textures[load->texture];
+			texture.loading--;
+			Slot& page = slots[load->slot];
+
+			if (!texture.alive || state == 2)
+			{
+				if (texture.alive)
+				{
+					WarningMessage("Virtual Texture WARNING", "Failed to read page %u (%u, %u) of virtual texture %u",
+						load->mip, load->x, load->y, load->texture);
+					stats.failed++;
+				}
+
+				/* Nothing was uploaded, so the staging page is free right away*/
+				pages.erase(page.key);
+				page = Slot();
+				freeslots.push_back(load->slot);
+				freestaging.push_back(load->staging);
+
+				if (!texture.alive && texture.loading == 0)
+				{
+					FreeTextureHandle(load->texture);
+				}
+			}
+			else
+			{
+				page.loading = false;
+				page.lastused = frame;
+				page.pinned = load->mip + 1 == texture.desc.levels.size();
+				if (!page.pinned)
+				{
+					PushFront(load->slot);
+				}
+
+				MapPage(load->slot, true);
+				uploads.push_back({ load->slot, load->staging });
+				usedstaging.push_back({ load->staging, frame });
+				stats.uploaded++;
+			}
+
+			loads[i] = std::move(loads.back());
+			loads.pop_back();
+		}
+
+		/* Coarse pages first since everything finer falls back to them, then the most wanted*/
+		std::vector<std::pair<QWord, DWord>> missing(requests.begin(), requests.end());
+		requests.clear();
+		stats.requested = static_cast<DWord>(missing.size());
+
+		std::sort(missing.begin(), missing.end(), [](const std::pair<QWord, DWord>& a, const std::pair<QWord, DWord>& b)
+		{
+			DWord mipa = static_cast<DWord>(a.first >> 32) & 0xFF;
+			DWord mipb = static_cast<DWord>(b.first >> 32) & 0xFF;
+			if (mipa != mipb)
+			{
+				return mipa > mipb;
+			}
+			return a.second != b.second ? a.second > b.second : a.first < b.first;
+		});
+
+		for (const auto& request : missing)
+		{
+			/* Out of read slots or staging, what is left gets asked for again by next frame's feedback*/
+			if (loads.size() >= VT_MAX_LOADS || freestaging.empty())
+			{
+				break;
+			}
+
+			QWord key = request.first;
+			DWord handle = static_cast<DWord>(key >> 40);
+			if (!IsAlive(handle) || pages.find(key) != pages.end())
+			{
+				continue;
+			}
+
+			DWord slot = AllocateSlot();
+			if (slot == VT_INVALID)
+			{
+				break;
+			}
+
+			Texture& texture = *textures[handle];
+			Slot& page = slots[slot];
+			page.key = key;
+			page.used = true;
+			page.loading = true;
+			page.lastused = frame;
+			pages[key] = slot;
+
+			DWord stagingpage = freestaging.back();
+			freestaging.pop_back();
+
+			auto load = std::make_unique<Load>();
+			load->slot			= slot;
+			load->staging		= stagingpage;
+			load->texture		= handle;
+			load->mip			= static_cast<DWord>(key >> 32) & 0xFF;
+			load->y				= static_cast<DWord>(key >> 16) & 0xFFFF;
+			load->x				= static_cast<DWord>(key) & 0xFFFF;
+			load->reader		= texture.reader;
+			load->userdata		= texture.userdata;
+			load->destination	= GetStagingPage(stagingpage);
+			load->size			= pagebytes;
+
+			texture.loading++;
+			stats.started++;
+			Load* started = load.get();
+			loads.push_back(std::move(load));
+			RunJob(ReadJob, started, &readcounter);
+		}
+
+		stats.resident = static_cast<DWord>(pages.size() - loads.size());
+
+		/* Feedback for the next Update is stamped with the new frame*/
+		frame++;
+	}
+
+	int CookVirtualTexture(const Byte* rgba, DWord width, DWord height, texturetype type, MetalVirtualTextureDesc& desc,
+		std::vector<Byte>& data, bool compress)
+	{
+		if (rgba == nullptr || !IsPowerOfTwo(width) || !IsPowerOfTwo(height) || width < VT_PAGE_SIZE || height < VT_PAGE_SIZE ||
+			width > VT_PAGE_SIZE * VT_MAX_PAGES || height > VT_PAGE_SIZE * VT_MAX_PAGES)
+		{
+			WarningMessage("Virtual Texture WARNING", "Virtual textures need power of two sides between %u and %u (got %ux%u)",
+				VT_PAGE_SIZE, VT_PAGE_SIZE * VT_MAX_PAGES, width, height);
+			return 1;
+		}
+
+		bool hasalpha = false;
+		for (usize i = 3; i < static_cast<usize>(width) * height * 4 && !hasalpha; i += 4)
+		{
+			hasalpha = rgba[i] != 255;
+		}
+
+		std::vector<std::vector<Byte>> mips;
+		GenerateMips(rgba, width, height, type, mips);
+
+		desc.width = width;
+		desc.height = height;
+		desc.type = type;
+		desc.format = compress ? ChooseCookedFormat(type, hasalpha) : IsColorTexture(type) ? IF_RGBA8_SRGB : IF_RGBA8;
+		desc.pagebytes = GetImageMipSize(desc.format, VT_PAGE_TEXELS, VT_PAGE_TEXELS);
+		desc.levels.clear();
+
+		QWord firstpage = 0;
+		for (DWord level = 0; level < mips.size(); level++)
+		{
+			DWord pagesx = std::max(1u, (width >> level) / VT_PAGE_SIZE);
+			DWord pagesy = std::max(1u, (height >> level) / VT_PAGE_SIZE);
+			desc.levels.push_back({ pagesx, pagesy, firstpage });
+			firstpage += static_cast<QWord>(pagesx) * pagesy;
+			if (pagesx == 1 && pagesy == 1)
+			{
+				break;
+			}
+		}
+
+		data.assign(firstpage * desc.pagebytes, 0);
+
+		for (DWord level = 0; level < desc.levels.size(); level++)
+		{
+			const MetalVirtualLevel& info = desc.levels[level];
+			const Byte* source = mips[level].data();
+			int levelwidth = static_cast<int>(std::max(1u, width >> level));
+			int levelheight = static_cast<int>(std::max(1u, height >> level));
+
+			/* Each page is cut out with its border (clamped at the edges of the texture) and encoded on its own*/
+			ParallelFor(info.pagesx * info.pagesy, 0, [&](DWord begin, DWord end)
+			{
+				std::vector<Byte> page(static_cast<usize>(VT_PAGE_TEXELS) * VT_PAGE_TEXELS * 4);
+				for (DWord index = begin; index < end; index++)
+				{
+					int originx = static_cast<int>((index % info.pagesx) * VT_PAGE_SIZE) - static_cast<int>(VT_PAGE_BORDER);
+					int originy = static_cast<int>((index / info.pagesx) * VT_PAGE_SIZE) - static_cast<int>(VT_PAGE_BORDER);
+
+					for (int y = 0; y < static_cast<int>(VT_PAGE_TEXELS); y++)
+					{
+						int sy = std::clamp(originy + y, 0, levelheight - 1);
+						for (int x = 0; x < static_cast<int>(VT_PAGE_TEXELS); x++)
+						{
+							int sx = std::clamp(originx + x, 0, levelwidth - 1);
+							std::memcpy(&page[(static_cast<usize>(y) * VT_PAGE_TEXELS + x) * 4],
+								&source[(static_cast<usize>(sy) * levelwidth + sx) * 4], 4);
+						}
+					}
+
+					Byte* destination = data.data() + (info.firstpage + index) * desc.pagebytes;
+					if (compress)
+					{
+						CompressImage(desc.format, page.data(), VT_PAGE_TEXELS, VT_PAGE_TEXELS, destination);
+					}
+					else
+					{
+						std::memcpy(destination, page.data(), desc.pagebytes);
+					}
+				}
+			});
+		}
+
+		return 0;
+	}
+
+	int WritePackageVirtualTexture(MEPF* package, const char* name, const MetalVirtualTextureDesc& desc, const std::vector<Byte>& data)
+	{
+		if (data.size() != desc.GetPageCount() * desc.pagebytes)
+		{
+			return 1;
+		}
+
+		MetalVirtualHeader header = {};
+		header.magic		= COOKED_VIRTUAL_MAGIC;
+		header.width		= desc.width;
+		header.height		= desc.height;
+		header.type			= desc.type;
+		header.format		= desc.format;
+		header.levelcount	= static_cast<DWord>(desc.levels.size());
+		header.pagesize		= VT_PAGE_SIZE;
+		header.border		= VT_PAGE_BORDER;
+		header.pagebytes	= desc.pagebytes;
+		header.dataoffset	= (sizeof(MetalVirtualHeader) + sizeof(MetalVirtualLevel) * desc.levels.size() + 15) & ~QWord(15);
+
+		std::vector<Byte> entry(header.dataoffset + data.size(), 0);
+		std::memcpy(entry.data(), &header, sizeof(header));
+		std::memcpy(entry.data() + sizeof(header), desc.levels.data(), sizeof(MetalVirtualLevel) * desc.levels.size());
+		if (!data.empty())
+		{
+			std::memcpy(entry.data() + header.dataoffset, data.data(), data.size());
+		}
+		return MEPFAddEntry(package, name, MEPF_ENTRY_VIRTUAL, entry.data(), entry.size());
+	}
+
+	int ReadPackageVirtualTexture(MEPF* package, const char* name, MetalPackageVirtualTexture& source)
+	{
+		const MEPFEntry* entry = MEPFFindEntry(package, name);
+		if (entry == nullptr || entry->type != MEPF_ENTRY_VIRTUAL)
+		{
+			return 1;
+		}
+
+		/* Pages cooked with a different size or border would not line up with the shaders*/
+		MetalVirtualHeader header;
+		if (MEPFReadEntry(package, entry, 0, &header, sizeof(header)) != 0 || header.magic != COOKED_VIRTUAL_MAGIC ||
+			header.pagesize != VT_PAGE_SIZE || header.border != VT_PAGE_BORDER ||
+			header.levelcount == 0 || header.levelcount > VT_MAX_LEVELS)
+		{
+			return 1;
+		}
+
+		MetalVirtualTextureDesc& desc = source.desc;
+		desc.levels.resize(header.levelcount);
+		if (MEPFReadEntry(package, entry, sizeof(header), desc.levels.data(), sizeof(MetalVirtualLevel) * desc.levels.size()) != 0)
+		{
+			return 1;
+		}
+
+		desc.width = header.width;
+		desc.height = header.height;
+		desc.type = static_cast<texturetype>(header.type);
+		desc.format = static_cast<imageformat>(header.format);
+		desc.pagebytes = header.pagebytes;
+
+		source.package = package;
+		source.entry = entry;
+		source.dataoffset = header.dataoffset;
+		return 0;
+	}
+
+	bool PackageVirtualPageReader(void* userdata, DWord mip, DWord x, DWord y, Byte* destination, QWord size)
+	{
+		const MetalPackageVirtualTexture* source = static_cast<const MetalPackageVirtualTexture*>(userdata);
+		const MetalVirtualTextureDesc& desc = source->desc;
+		if (mip >= desc.levels.size() || x >= desc.levels[mip].pagesx || y >= desc.levels[mip].pagesy || size > desc.pagebytes)
+		{
+			return false;
+		}
+
+		QWord offset = source->dataoffset + desc.GetPageIndex(mip, x, y) * desc.pagebytes;
+		return MEPFReadEntry(source->package, source->entry, offset, destination, size) == 0;
+	}
+}
@@ -0,0 +1,318 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine bindless descriptor heap (one global set of textures and buffers)
+// ------------------------------------------------------
+
+#include "headers/MVulkanBindless.hpp"
+#include "headers/MCounters.h"
+#include "headers/MError.h"
+
+namespace engine::vulkan
+{
+	/* Slot allocator for one array of the heap. Slots come from the free list first and
+		from the high water mark after that. Released slots wait in retired until no frame
+		in flight can still be reading them.
+	*/
+	struct MetalBindlessSlots
+	{
+		struct Retired
+		{
+			DWord slot;
+			QWord frame;
+		};
+
+		vector<DWord>	freelist;
+		vector<Retired>	retired;
+		DWord			next		= 0;
+		DWord			capacity	= 0;
+
+		DWord Allocate()
+		{
+			if (!freelist.empty())
+			{
+				DWord slot = freelist.back();
+				freelist.pop_back();
+				return slot;
+			}
+			return next < capacity ? next++ : BINDLESS_INVALID;
+		}
+
+		void Release(DWord slot, QWord frame)
+		{
+			if (slot < next)
+			{
+				retired.push_back({ slot, frame });
+			}
+		}
+
+		void Recycle(QWord frame)
+		{
+			usize kept = 0;
+			for (usize i = 0; i < retired.size(); i++)
+			{
+				if (frame - retired[i].frame >= MAXIMUM_FRAMES_IN_FLIGHTS)
+				{
+					freelist.push_back(retired[i].slot);
+				}
+				else
+				{
+					retired[kept++] = retired[i];
+				}
+			}
+			retired.resize(kept);
+		}
+
+		void Reset(DWord size)
+		{
+			freelist.clear();
+			retired.clear();
+			next = 0;
+			capacity = size;
+		}
+	};
+
+	/* Registration can come from loading jobs on any worker*/
+	static std::mutex			s_bindlesslock;
+	static MetalBindlessSlots	s_textureslots;
+	static MetalBindlessSlots	s_bufferslots;
+	static QWord				s_bindlessframe = 0;
+
+	int VulkanCreateBindlessHeap(DWord maxtextures, DWord maxbuffers)
+	{
+		if (!m_descriptorindexing_supported)
+		{
+			WarningMessage("Vulkan Bindless WARNING", "The GPU does not support update-after-bind descriptor indexing");
+			return 1;
+		}
+
+		/* Update-after-bind sets have their own (usually much larger) limits*/
+		VkPhysicalDeviceVulkan12Properties Properties12 = {};
+		Properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+		VkPhysicalDeviceProperties2 Properties = {};
+		Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		Properties.pNext = &Properties12;
+		vkGetPhysicalDeviceProperties2(m_physicaldevice, &Properties);
+
+		/* A combined image sampler counts as both a sampled image and a sampler*/
+		m_bindless_maxtextures = min<DWord>(maxtextures, min(Properties12.maxDescriptorSetUpdateAfterBindSampledImages,
+			Properties12.maxPerStageDescriptorUpdateAfterBindSampledImages));
+		m_bindless_maxtextures = min<DWord>(m_bindless_maxtextures, min(Properties12.maxDescriptorSetUpdateAfterBindSamplers,
+			Properties12.maxPerStageDescriptorUpdateAfterBindSamplers));
+		m_bindless_maxbuffers = min<DWord>(maxbuffers, min(Properties12.maxDescriptorSetUpdateAfterBindStorageBuffers,
+			Properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers));
+
+		/* Both bindings are visible to every stage, so together they have to fit in one stage's resources*/
+		QWord Resources = static_cast<QWord>(m_bindless_maxtextures) + m_bindless_maxbuffers;
+		if (Resources > Properties12.maxPerStageUpdateAfterBindResources)
+		{
+			DWord Limit = Properties12.maxPerStageUpdateAfterBindResources;
+			m_bindless_maxtextures = static_cast<DWord>(static_cast<QWord>(Limit) * m_bindless_maxtextures / Resources);
+			m_bindless_maxbuffers = Limit - m_bindless_maxtextures;
+		}
+
+		array<VkDescriptorSetLayoutBinding, 2> Bindings = {};
+		Bindings[0].binding			= BINDLESS_TEXTURE_BINDING;
+		Bindings[0].descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		Bindings[0].descriptorCount	= m_bindless_maxtextures;
+		Bindings[0].stageFlags		= VK_SHADER_STAGE_ALL;
+		Bindings[1].binding			= BINDLESS_BUFFER_BINDING;
+		Bindings[1].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		Bindings[1].descriptorCount	= m_bindless_maxbuffers;
+		Bindings[1].stageFlags		= VK_SHADER_STAGE_ALL;
+
+		/* Empty slots are never read, and slots can be written while other slots are in use by the GPU*/
+		array<VkDescriptorBindingFlags, 2> BindingFlags = {};
+		BindingFlags[0] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+			VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+		BindingFlags[1] = BindingFlags[0];
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo FlagsInfo = {};
+		FlagsInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		FlagsInfo.bindingCount	= static_cast<VkUint32>(BindingFlags.size());
+		FlagsInfo.pBindingFlags	= BindingFlags.data();
+
+		VkDescriptorSetLayoutCreateInfo LayoutInfo = {};
+		LayoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		LayoutInfo.pNext		= &FlagsInfo;
+		LayoutInfo.flags		= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+		LayoutInfo.bindingCount	= static_cast<VkUint32>(Bindings.size());
+		LayoutInfo.pBindings	= Bindings.data();
+		VK_CHECK(vkCreateDescriptorSetLayout(m_device, &LayoutInfo, nullptr, &m_bindlesslayout));
+
+		array<VkDescriptorPoolSize, 2> PoolSizes = {};
+		PoolSizes[0] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_bindless_maxtextures };
+		PoolSizes[1] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_bindless_maxbuffers };
+
+		VkDescriptorPoolCreateInfo PoolInfo = {};
+		PoolInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		PoolInfo.flags			= VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		PoolInfo.maxSets		= 1;
+		PoolInfo.poolSizeCount	= static_cast<VkUint32>(PoolSizes.size());
+		PoolInfo.pPoolSizes		= PoolSizes.data();
+		VK_CHECK(vkCreateDescriptorPool(m_device, &PoolInfo, nullptr, &m_descriptorpool));
+
+		VkDescriptorSetAllocateInfo AllocationInfo = {};
+		AllocationInfo.sType				= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		AllocationInfo.descriptorPool		= m_descriptorpool;
+		AllocationInfo.descriptorSetCount	= 1;
+		AllocationInfo.pSetLayouts			= &m_bindlesslayout;
+		VK_CHECK(vkAllocateDescriptorSets(m_device, &AllocationInfo, &m_bindlessset));
+
+		std::lock_guard<std::mutex> lock(s_bindlesslock);
+		s_textureslots.Reset(m_bindless_maxtextures);
+		s_bufferslots.Reset(m_bindless_maxbuffers);
+		s_bindlessframe = 0;
+
+		fmt::print("ENGINE: Vulkan bindless heap ready ({} textures, {} buffers)\n", m_bindless_maxtextures, m_bindless_maxbuffers);
+		return 0;
+	}
+
+	void VulkanDestroyBindlessHeap()
+	{
+		if (m_descriptorpool != VK_NULL_HANDLE)
+		{
+			/* Frees m_bindlessset with it*/
+			vkDestroyDescriptorPool(m_device, m_descriptorpool, nullptr);
+			m_descriptorpool = VK_NULL_HANDLE;
+			m_bindlessset = VK_NULL_HANDLE;
+		}
+
+		if (m_bindlesslayout != VK_NULL_HANDLE)
+		{
+			vkDestroyDescriptorSetLayout(m_device, m_bindlesslayout, nullptr);
+			m_bindlesslayout = VK_NULL_HANDLE;
+		}
+
+		std::lock_guard<std::mutex> lock(s_bindlesslock);
+		s_textureslots.Reset(0);
+		s_bufferslots.Reset(0);
+	}
+
+	DWord BindlessRegisterTexture(VkImageView view, VkSampler sampler)
+	{
+		DWord slot;
+		{
+			std::lock_guard<std::mutex> lock(s_bindlesslock);
+			slot = s_textureslots.Allocate();
+		}
+
+		if (slot == BINDLESS_INVALID)
+		{
+			WarningMessage("Vulkan Bindless WARNING", "The texture heap is full (%u slots)", m_bindless_maxtextures);
+			return BINDLESS_INVALID;
+		}
+
+		VkDescriptorImageInfo ImageInfo = {};
+		ImageInfo.sampler		= sampler;
+		ImageInfo.imageView		= view;
+		ImageInfo.imageLayout	= VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkWriteDescriptorSet Write = {};
+		Write.sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		Write.dstSet			= m_bindlessset;
+		Write.dstBinding		= BINDLESS_TEXTURE_BINDING;
+		Write.dstArrayElement	= slot;
+		Write.descriptorCount	= 1;
+		Write.descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		Write.pImageInfo		= &ImageInfo;
+
+		/* Every thread writes a different element, which update-after-bind allows*/
+		vkUpdateDescriptorSets(m_device, 1, &Write, 0, nullptr);
+		MetalCounterAdd(METAL_COUNTER_DESCRIPTOR_WRITES, 1);
+		return slot;
+	}
+
+	DWord BindlessRegisterBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+	{
+		DWord slot;
+		{
+			std::lock_guard<std::mutex> lock(s_bindlesslock);
+			slot = s_bufferslots.Allocate();
+		}
+
+		if (slot == BINDLESS_INVALID)
+		{
+			WarningMessage("Vulkan Bindless WARNING", "The buffer heap is full (%u slots)", m_bindless_maxbuffers);
+			return BINDLESS_INVALID;
+		}
+
+		VkDescriptorBufferInfo BufferInfo = { buffer, offset, range };
+
+		VkWriteDescriptorSet Write = {};
+		Write.sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		Write.dstSet			= m_bindlessset;
+		Write.dstBinding		= BINDLESS_BUFFER_BINDING;
+		Write.dstArrayElement	= slot;
+		Write.descriptorCount	= 1;
+		Write.descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		Write.pBufferInfo		= &BufferInfo;
+
+		vkUpdateDescriptorSets(m_device, 1, &Write, 0, nullptr);
+		MetalCounterAdd(METAL_COUNTER_DESCRIPTOR_WRITES, 1);
+		return slot;
+	}
+
+	void BindlessReleaseTexture(DWord slot)
+	{
+		std::lock_guard<std::mutex> lock(s_bindlesslock);
+		s_textureslots.Release(slot, s_bindlessframe);
+	}
+
+	void BindlessReleaseBuffer(DWord slot)
+	{
+		std::lock_guard<std::mutex> lock(s_bindlesslock);
+		s_bufferslots.Release(slot, s_bindlessframe);
+	}
+
+	void BindlessNextFrame()
+	{
+		std::lock_guard<std::mutex> lock(s_bindlesslock);
+		s_bindlessframe++;
+		s_textureslots.Recycle(s_bindlessframe);
+		s_bufferslots.Recycle(s_bindlessframe);
+	}
+
+	void CreateBindlessPipelineLayout(VkDescriptorSetLayout frameset, VkPipelineLayout& layout)
+	{
+		/* Set 0 can't be left as a hole, an empty layout stands in when there is no frame set*/
+		VkDescriptorSetLayout EmptyLayout = VK_NULL_HANDLE;
+		if (frameset == VK_NULL_HANDLE)
+		{
+			VkDescriptorSetLayoutCreateInfo EmptyInfo = {};
+			EmptyInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+			VK_CHECK(vkCreateDescriptorSetLayout(m_device, &EmptyInfo, nullptr, &EmptyLayout));
+		}
+
+		VkDescriptorSetLayout SetLayouts[2] = { frameset != VK_NULL_HANDLE ? frameset : EmptyLayout, m_bindlesslayout };
+
+		VkPushConstantRange PushRange = {};
+		PushRange.stageFlags	= VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+		PushRange.offset		= 0;
+		PushRange.size			= sizeof(MetalBindlessMaterial);
+
+		VkPipelineLayoutCreateInfo LayoutInfo = {};
+		LayoutInfo.sType					= VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		LayoutInfo.setLayoutCount			= 2;
+		LayoutInfo.pSetLayouts				= SetLayouts;
+		LayoutInfo.pushConstantRangeCount	= 1;
+		LayoutInfo.pPushConstantRanges		= &PushRange;
+		VK_CHECK(vkCreatePipelineLayout(m_device, &LayoutInfo, nullptr, &layout));
+
+		/* The pipeline layout doesn't keep a reference to it*/
+		if (EmptyLayout != VK_NULL_HANDLE)
+		{
+			vkDestroyDescriptorSetLayout(m_device, EmptyLayout, nullptr);
+		}
+	}
+
+	void BindlessBind(VkCommandBuffer commandbuffer, VkPipelineBindPoint bindpoint, VkPipelineLayout layout)
+	{
+		vkCmdBindDescriptorSets(commandbuffer, bindpoint, layout, BINDLESS_SET, 1, &m_bindlessset, 0, nullptr);
+	}
+}
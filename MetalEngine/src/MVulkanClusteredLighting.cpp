@@ -0,0 +1,274 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine GPU clustered lighting (light grid built by compute, read by material.frag)
+// ------------------------------------------------------
+
+#include "headers/MVulkanClusteredLighting.hpp"
+#include "headers/MVulkanProfiler.hpp"
+#include "headers/MCounters.h"
+#include "headers/MError.h"
+
+#include <cmath>
+#include <cstring>
+
+using namespace engine::lighting;
+
+namespace engine::vulkan
+{
+	MetalClusteredLighting::~MetalClusteredLighting()
+	{
+		Destroy();
+	}
+
+	int MetalClusteredLighting::Create(DWord maxlightcount, DWord maxindices, const string& shaderpath)
+	{
+		if (maxlightcount == 0 || maxindices == 0)
+		{
+			WarningMessage("Vulkan Lighting WARNING", "Tried to create clustered lighting with no room for lights");
+			return 1;
+		}
+
+		maxlights = maxlightcount;
+		indexcapacity = maxindices;
+		lightcounts = {};
+
+		for (int i = 0; i < MAXIMUM_FRAMES_IN_FLIGHTS; i++)
+		{
+			/* Lights and camera change every frame, written straight into mapped memory*/
+			CreateBuffer(sizeof(MetalPointLight) * maxlights, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, lightbuffers[i], lightmemory[i]);
+			VK_CHECK(vkMapMemory(m_device, lightmemory[i], 0, sizeof(MetalPointLight) * maxlights, 0, &lightmapped[i]));
+
+			CreateBuffer(sizeof(MetalClusterData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformbuffers[i], uniformmemory[i]);
+			VK_CHECK(vkMapMemory(m_device, uniformmemory[i], 0, sizeof(MetalClusterData), 0, &uniformmapped[i]));
+
+			CreateBuffer(sizeof(MetalClusterRange) * CLUSTER_COUNT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, clusterbuffers[i], clustermemory[i]);
+
+			CreateBuffer(sizeof(VkUint32) * static_cast<VkDeviceSize>(indexcapacity), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexbuffers[i], indexmemory[i]);
+
+			CreateBuffer(sizeof(VkUint32), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, counterbuffers[i], countermemory[i]);
+		}
+
+		/* Set 0 of cluster_lights.comp and set CLUSTER_DESCRIPTOR_SET of material.frag: camera, lights, ranges, indices, index counter*/
+		array<VkDescriptorSetLayoutBinding, 5> Bindings = {};
+		for (VkUint32 i = 0; i < Bindings.size(); i++)
+		{
+			Bindings[i].binding			= i;
+			Bindings[i].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			Bindings[i].descriptorCount	= 1;
+			Bindings[i].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+		}
+		Bindings[0].descriptorType	= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		Bindings[4].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+
+		VkDescriptorSetLayoutCreateInfo LayoutInfo = {};
+		LayoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		LayoutInfo.bindingCount	= static_cast<VkUint32>(Bindings.size());
+		LayoutInfo.pBindings	= Bindings.data();
+		VK_CHECK(vkCreateDescriptorSetLayout(m_device, &LayoutInfo, nullptr, &descriptorsetlayout));
+
+		array<VkDescriptorPoolSize, 2> PoolSizes = {};
+		PoolSizes[0].type				= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		PoolSizes[0].descriptorCount	= 4 * MAXIMUM_FRAMES_IN_FLIGHTS;
+		PoolSizes[1].type				= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		PoolSizes[1].descriptorCount	= MAXIMUM_FRAMES_IN_FLIGHTS;
+
+		VkDescriptorPoolCreateInfo PoolInfo = {};
+		PoolInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		PoolInfo.maxSets		= MAXIMUM_FRAMES_IN_FLIGHTS;
+		PoolInfo.poolSizeCount	= static_cast<VkUint32>(PoolSizes.size());
+		PoolInfo.pPoolSizes		= PoolSizes.data();
+		VK_CHECK(vkCreateDescriptorPool(m_device, &PoolInfo, nullptr, &descriptorpool));
+
+		array<VkDescriptorSetLayout, MAXIMUM_FRAMES_IN_FLIGHTS> SetLayouts;
+		SetLayouts.fill(descriptorsetlayout);
+
+		VkDescriptorSetAllocateInfo AllocationInfo = {};
+		AllocationInfo.sType				= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		AllocationInfo.descriptorPool		= descriptorpool;
+		AllocationInfo.descriptorSetCount	= MAXIMUM_FRAMES_IN_FLIGHTS;
+		AllocationInfo.pSetLayouts			= SetLayouts.data();
+		VK_CHECK(vkAllocateDescriptorSets(m_device, &AllocationInfo, descriptorsets.data()));
+
+		for (int Frame = 0; Frame < MAXIMUM_FRAMES_IN_FLIGHTS; Frame++)
+		{
+			VkDescriptorBufferInfo BufferInfos[5] = {};
+			BufferInfos[0] = { uniformbuffers[Frame], 0, sizeof(MetalClusterData) };
+			BufferInfos[1] = { lightbuffers[Frame], 0, VK_WHOLE_SIZE };
+			BufferInfos[2] = { clusterbuffers[Frame], 0, VK_WHOLE_SIZE };
+			BufferInfos[3] = { indexbuffers[Frame], 0, VK_WHOLE_SIZE };
+			BufferInfos[4] = { counterbuffers[Frame], 0, VK_WHOLE_SIZE };
+
+			array<VkWriteDescriptorSet, 5> Writes = {};
+			for (VkUint32 i = 0; i < Writes.size(); i++)
+			{
+				Writes[i].sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				Writes[i].dstSet			= descriptorsets[Frame];
+				Writes[i].dstBinding		= i;
+				Writes[i].descriptorCount	= 1;
+				Writes[i].descriptorType	= Bindings[i].descriptorType;
+				Writes[i].pBufferInfo		= &BufferInfos[i];
+			}
+			vkUpdateDescriptorSets(m_device, static_cast<VkUint32>(Writes.size()), Writes.data(), 0, nullptr);
+			MetalCounterAdd(METAL_COUNTER_DESCRIPTOR_WRITES, static_cast<long long>(Writes.size()));
+		}
+
+		VkPipelineLayoutCreateInfo PipelineLayoutInfo = {};
+		PipelineLayoutInfo.sType			= VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		PipelineLayoutInfo.setLayoutCount	= 1;
+		PipelineLayoutInfo.pSetLayouts		= &descriptorsetlayout;
+		VK_CHECK(vkCreatePipelineLayout(m_device, &PipelineLayoutInfo, nullptr, &pipelinelayout));
+
+		if (CreateComputePipeline(shaderpath, pipelinelayout, pipeline) != 0)
+		{
+			return 1;
+		}
+
+		fmt::print("ENGINE: Vulkan clustered lighting ready ({}x{}x{} clusters, {} lights, {} indices)\n",
+			CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, maxlights, indexcapacity);
+		return 0;
+	}
+
+	void MetalClusteredLighting::Destroy()
+	{
+		if (m_device == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		if (pipeline != VK_NULL_HANDLE)				vkDestroyPipeline(m_device, pipeline, nullptr);
+		if (pipelinelayout != VK_NULL_HANDLE)		vkDestroyPipelineLayout(m_device, pipelinelayout, nullptr);
+		if (descriptorpool != VK_NULL_HANDLE)		vkDestroyDescriptorPool(m_device, descriptorpool, nullptr);
+		if (descriptorsetlayout != VK_NULL_HANDLE)	vkDestroyDescriptorSetLayout(m_device, descriptorsetlayout, nullptr);
+
+		for (int i = 0; i < MAXIMUM_FRAMES_IN_FLIGHTS; i++)
+		{
+			VkBuffer Buffers[] = { lightbuffers[i], uniformbuffers[i], clusterbuffers[i], indexbuffers[i], counterbuffers[i] };
+			VkDeviceMemory Memories[] = { lightmemory[i], uniformmemory[i], clustermemory[i], indexmemory[i], countermemory[i] };
+			for (int j = 0; j < 5; j++)
+			{
+				if (Buffers[j] != VK_NULL_HANDLE)	vkDestroyBuffer(m_device, Buffers[j], nullptr);
+				if (Memories[j] != VK_NULL_HANDLE)	vkFreeMemory(m_device, Memories[j], nullptr);
+			}
+		}
+
+		pipeline = VK_NULL_HANDLE;
+		pipelinelayout = VK_NULL_HANDLE;
+		descriptorpool = VK_NULL_HANDLE;
+		descriptorsetlayout = VK_NULL_HANDLE;
+		lightbuffers = {};
+		lightmemory = {};
+		lightmapped = {};
+		uniformbuffers = {};
+		uniformmemory = {};
+		uniformmapped = {};
+		clusterbuffers = {};
+		clustermemory = {};
+		indexbuffers = {};
+		indexmemory = {};
+		counterbuffers = {};
+		countermemory = {};
+		descriptorsets = {};
+		lightcounts = {};
+		maxlights = 0;
+		indexcapacity = 0;
+	}
+
+	void MetalClusteredLighting::SetLights(const MetalPointLight* lights, DWord count)
+	{
+		if (lightmapped[CurrentFrame] == nullptr)
+		{
+			return;
+		}
+
+		count = count > maxlights ? maxlights : count;
+		std::memcpy(lightmapped[CurrentFrame], lights, sizeof(MetalPointLight) * count);
+		lightcounts[CurrentFrame] = count;
+	}
+
+	void MetalClusteredLighting::RecordCulling(VkCommandBuffer commandbuffer, const MetalClusterGrid& grid, DWord width, DWord height)
+	{
+		if (pipeline == VK_NULL_HANDLE || width == 0 || height == 0)
+		{
+			return;
+		}
+
+		METAL_GPU_ZONE(commandbuffer, "Light Clusters");
+
+		/* The view is a rigid transform, so the camera sits at -transpose(rotation) * translation*/
+		const vec4f* v = grid.view.rows;
+		vec4f Camera(-(v[0].x * v[0].w + v[1].x * v[1].w + v[2].x * v[2].w),
+			-(v[0].y * v[0].w + v[1].y * v[1].w + v[2].y * v[2].w),
+			-(v[0].z * v[0].w + v[1].z * v[1].w + v[2].z * v[2].w), 1.0f);
+
+		/* Same slices as GetClusterSlice, log(z / near) / log(far / near) * slices moved into one multiply add*/
+		float SliceScale = static_cast<float>(CLUSTER_GRID_Z) / std::log2(grid.farz / grid.nearz);
+
+		MetalClusterData Data = {};
+		for (int i = 0; i < 4; i++)
+		{
+			Data.viewrows[i] = grid.view.rows[i];
+		}
+		Data.camera			= Camera;
+		Data.projx			= grid.projx;
+		Data.projy			= grid.projy;
+		Data.nearz			= grid.nearz;
+		Data.farz			= grid.farz;
+		Data.slicescale		= SliceScale;
+		Data.slicebias		= -std::log2(grid.nearz) * SliceScale;
+		Data.inversewidth	= 1.0f / static_cast<float>(width);
+		Data.inverseheight	= 1.0f / static_cast<float>(height);
+		Data.lightcount		= lightcounts[CurrentFrame];
+		Data.indexcapacity	= indexcapacity;
+		std::memcpy(uniformmapped[CurrentFrame], &Data, sizeof(Data));
+
+		/* Reset the index list, then make the compute shader wait for the clear*/
+		vkCmdFillBuffer(commandbuffer, counterbuffers[CurrentFrame], 0, sizeof(VkUint32), 0);
+
+		VkBufferMemoryBarrier ClearBarrier = {};
+		ClearBarrier.sType					= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		ClearBarrier.srcAccessMask			= VK_ACCESS_TRANSFER_WRITE_BIT;
+		ClearBarrier.dstAccessMask			= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		ClearBarrier.srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		ClearBarrier.dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		ClearBarrier.buffer					= counterbuffers[CurrentFrame];
+		ClearBarrier.offset					= 0;
+		ClearBarrier.size					= VK_WHOLE_SIZE;
+
+		vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 1, &ClearBarrier, 0, nullptr);
+
+		VkDescriptorSet Set = descriptorsets[CurrentFrame];
+		vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		MetalCounterAdd(METAL_COUNTER_PIPELINE_BINDS, 1);
+		vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelinelayout, 0, 1, &Set, 0, nullptr);
+		vkCmdDispatch(commandbuffer, (CLUSTER_COUNT + CLUSTER_WORKGROUP_SIZE - 1) / CLUSTER_WORKGROUP_SIZE, 1, 1);
+
+		/* Ranges and indices are read by the fragment shaders of this frame*/
+		array<VkBufferMemoryBarrier, 2> ShadeBarriers = {};
+		VkBuffer Targets[] = { clusterbuffers[CurrentFrame], indexbuffers[CurrentFrame] };
+		for (int i = 0; i < 2; i++)
+		{
+			ShadeBarriers[i].sType					= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			ShadeBarriers[i].srcAccessMask			= VK_ACCESS_SHADER_WRITE_BIT;
+			ShadeBarriers[i].dstAccessMask			= VK_ACCESS_SHADER_READ_BIT;
+			ShadeBarriers[i].srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+			ShadeBarriers[i].dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+			ShadeBarriers[i].buffer					= Targets[i];
+			ShadeBarriers[i].offset					= 0;
+			ShadeBarriers[i].size					= VK_WHOLE_SIZE;
+		}
+
+		vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0, 0, nullptr, static_cast<VkUint32>(ShadeBarriers.size()), ShadeBarriers.data(), 0, nullptr);
+	}
+}
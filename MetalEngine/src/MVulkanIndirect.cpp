@@ -0,0 +1,271 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine GPU-driven rendering (compute culling + indirect draws)
+// ------------------------------------------------------
+
+#include "headers/MVulkanIndirect.hpp"
+#include "headers/MVulkanProfiler.hpp"
+#include "headers/MCounters.h"
+#include "headers/MError.h"
+
+namespace engine::vulkan
+{
+	MetalIndirectRenderer::~MetalIndirectRenderer()
+	{
+		Destroy();
+	}
+
+	int MetalIndirectRenderer::Create(DWord maxinstancecount, const vector<MetalIndirectMesh>& meshes, const string& cullshaderpath)
+	{
+		if (maxinstancecount == 0 || meshes.empty())
+		{
+			WarningMessage("Vulkan Indirect WARNING", "Tried to create an indirect renderer with no instances or meshes");
+			return 1;
+		}
+
+		maxinstances = maxinstancecount;
+		instancecount = 0;
+		/* The count variant can't be split, past maxDrawIndirectCount every instance gets a command instead*/
+		compact = m_drawindirectcount_supported && maxinstances <= m_properties.limits.maxDrawIndirectCount;
+
+		/* Instances and meshes are written once and only read by the GPU after that*/
+		CreateBuffer(sizeof(MetalGpuInstance) * maxinstances,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, instancebuffer, instancememory);
+
+		CreateBuffer(sizeof(MetalIndirectMesh) * meshes.size(),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshbuffer, meshmemory);
+		UploadToBuffer(meshbuffer, 0, meshes.data(), sizeof(MetalIndirectMesh) * meshes.size());
+
+		CreateBuffer(sizeof(VkDrawIndexedIndirectCommand) * maxinstances,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawbuffer, drawmemory);
+
+		CreateBuffer(sizeof(VkUint32),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, countbuffer, countmemory);
+
+		/* Set 0 of cull.comp: instances, meshes, draw commands, draw count*/
+		array<VkDescriptorSetLayoutBinding, 4> Bindings = {};
+		for (VkUint32 i = 0; i < Bindings.size(); i++)
+		{
+			Bindings[i].binding			= i;
+			Bindings[i].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			Bindings[i].descriptorCount	= 1;
+			Bindings[i].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+
+		VkDescriptorSetLayoutCreateInfo LayoutInfo = {};
+		LayoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		LayoutInfo.bindingCount	= static_cast<VkUint32>(Bindings.size());
+		LayoutInfo.pBindings	= Bindings.data();
+		VK_CHECK(vkCreateDescriptorSetLayout(m_device, &LayoutInfo, nullptr, &descriptorsetlayout));
+
+		VkDescriptorPoolSize PoolSize = {};
+		PoolSize.type				= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		PoolSize.descriptorCount	= static_cast<VkUint32>(Bindings.size());
+
+		VkDescriptorPoolCreateInfo PoolInfo = {};
+		PoolInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		PoolInfo.maxSets		= 1;
+		PoolInfo.poolSizeCount	= 1;
+		PoolInfo.pPoolSizes		= &PoolSize;
+		VK_CHECK(vkCreateDescriptorPool(m_device, &PoolInfo, nullptr, &descriptorpool));
+
+		VkDescriptorSetAllocateInfo AllocationInfo = {};
+		AllocationInfo.sType				= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		AllocationInfo.descriptorPool		= descriptorpool;
+		AllocationInfo.descriptorSetCount	= 1;
+		AllocationInfo.pSetLayouts			= &descriptorsetlayout;
+		VK_CHECK(vkAllocateDescriptorSets(m_device, &AllocationInfo, &descriptorset));
+
+		VkDescriptorBufferInfo BufferInfos[4] = {};
+		BufferInfos[0] = { instancebuffer, 0, VK_WHOLE_SIZE };
+		BufferInfos[1] = { meshbuffer, 0, VK_WHOLE_SIZE };
+		BufferInfos[2] = { drawbuffer, 0, VK_WHOLE_SIZE };
+		BufferInfos[3] = { countbuffer, 0, VK_WHOLE_SIZE };
+
+		array<VkWriteDescriptorSet, 4> Writes = {};
+		for (VkUint32 i = 0; i < Writes.size(); i++)
+		{
+			Writes[i].sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			Writes[i].dstSet			= descriptorset;
+			Writes[i].dstBinding		= i;
+			Writes[i].descriptorCount	= 1;
+			Writes[i].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			Writes[i].pBufferInfo		= &BufferInfos[i];
+		}
+		vkUpdateDescriptorSets(m_device, static_cast<VkUint32>(Writes.size()), Writes.data(), 0, nullptr);
+		MetalCounterAdd(METAL_COUNTER_DESCRIPTOR_WRITES, static_cast<long long>(Writes.size()));
+
+		VkPushConstantRange PushRange = {};
+		PushRange.stageFlags	= VK_SHADER_STAGE_COMPUTE_BIT;
+		PushRange.offset		= 0;
+		PushRange.size			= sizeof(MetalCullConstants);
+
+		VkPipelineLayoutCreateInfo PipelineLayoutInfo = {};
+		PipelineLayoutInfo.sType					= VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		PipelineLayoutInfo.setLayoutCount			= 1;
+		PipelineLayoutInfo.pSetLayouts				= &descriptorsetlayout;
+		PipelineLayoutInfo.pushConstantRangeCount	= 1;
+		PipelineLayoutInfo.pPushConstantRanges		= &PushRange;
+		VK_CHECK(vkCreatePipelineLayout(m_device, &PipelineLayoutInfo, nullptr, &cullpipelinelayout));
+
+		if (CreateComputePipeline(cullshaderpath, cullpipelinelayout, cullpipeline) != 0)
+		{
+			return 1;
+		}
+
+		fmt::print("ENGINE: Vulkan indirect renderer ready ({} instances, {})\n", maxinstances,
+			compact ? "draw count from GPU" : "drawing every slot");
+		return 0;
+	}
+
+	void MetalIndirectRenderer::Destroy()
+	{
+		if (m_device == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		if (cullpipeline != VK_NULL_HANDLE)			vkDestroyPipeline(m_device, cullpipeline, nullptr);
+		if (cullpipelinelayout != VK_NULL_HANDLE)	vkDestroyPipelineLayout(m_device, cullpipelinelayout, nullptr);
+		if (descriptorpool != VK_NULL_HANDLE)		vkDestroyDescriptorPool(m_device, descriptorpool, nullptr);
+		if (descriptorsetlayout != VK_NULL_HANDLE)	vkDestroyDescriptorSetLayout(m_device, descriptorsetlayout, nullptr);
+
+		VkBuffer Buffers[] = { instancebuffer, meshbuffer, drawbuffer, countbuffer };
+		VkDeviceMemory Memories[] = { instancememory, meshmemory, drawmemory, countmemory };
+		for (int i = 0; i < 4; i++)
+		{
+			if (Buffers[i] != VK_NULL_HANDLE)	vkDestroyBuffer(m_device, Buffers[i], nullptr);
+			if (Memories[i] != VK_NULL_HANDLE)	vkFreeMemory(m_device, Memories[i], nullptr);
+		}
+
+		cullpipeline = VK_NULL_HANDLE;
+		cullpipelinelayout = VK_NULL_HANDLE;
+		descriptorpool = VK_NULL_HANDLE;
+		descriptorset = VK_NULL_HANDLE;
+		descriptorsetlayout = VK_NULL_HANDLE;
+		instancebuffer = meshbuffer = drawbuffer = countbuffer = VK_NULL_HANDLE;
+		instancememory = meshmemory = drawmemory = countmemory = VK_NULL_HANDLE;
+		maxinstances = 0;
+		instancecount = 0;
+	}
+
+	void MetalIndirectRenderer::UploadInstances(const MetalGpuInstance* instances, DWord first, DWord count)
+	{
+		if (first >= maxinstances)
+		{
+			return;
+		}
+
+		count = first + count > maxinstances ? maxinstances - first : count;
+		UploadToBuffer(instancebuffer, sizeof(MetalGpuInstance) * first, instances, sizeof(MetalGpuInstance) * count);
+	}
+
+	void MetalIndirectRenderer::RecordCulling(VkCommandBuffer commandbuffer, const mat4f& viewproj)
+	{
+		if (instancecount == 0)
+		{
+			return;
+		}
+
+		METAL_GPU_ZONE(commandbuffer, "Indirect Culling");
+
+		/* The draw and count buffers are shared by every frame in flight, so the previous frame's
+			indirect draw has to be done reading them before the clear and the culling overwrite them
+		*/
+		array<VkBufferMemoryBarrier, 2> ReuseBarriers = {};
+		VkBuffer Targets[] = { drawbuffer, countbuffer };
+		for (int i = 0; i < 2; i++)
+		{
+			ReuseBarriers[i].sType					= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			ReuseBarriers[i].srcAccessMask			= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+			ReuseBarriers[i].dstAccessMask			= VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			ReuseBarriers[i].srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+			ReuseBarriers[i].dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+			ReuseBarriers[i].buffer					= Targets[i];
+			ReuseBarriers[i].offset					= 0;
+			ReuseBarriers[i].size					= VK_WHOLE_SIZE;
+		}
+
+		vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, static_cast<VkUint32>(ReuseBarriers.size()), ReuseBarriers.data(), 0, nullptr);
+
+		/* Reset the draw count, then make the compute shader wait for the clear*/
+		vkCmdFillBuffer(commandbuffer, countbuffer, 0, sizeof(VkUint32), 0);
+
+		VkBufferMemoryBarrier ClearBarrier = {};
+		ClearBarrier.sType					= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		ClearBarrier.srcAccessMask			= VK_ACCESS_TRANSFER_WRITE_BIT;
+		ClearBarrier.dstAccessMask			= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		ClearBarrier.srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		ClearBarrier.dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		ClearBarrier.buffer					= countbuffer;
+		ClearBarrier.offset					= 0;
+		ClearBarrier.size					= VK_WHOLE_SIZE;
+
+		vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 1, &ClearBarrier, 0, nullptr);
+
+		MetalCullConstants Constants = {};
+		for (int i = 0; i < 4; i++)
+		{
+			Constants.viewprojrows[i] = viewproj.rows[i];
+		}
+		Constants.instancecount = instancecount;
+		Constants.compact = compact ? 1 : 0;
+		Constants.lodscale = lodscale;
+		Constants.lodthreshold = lodthreshold;
+
+		vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullpipeline);
+		MetalCounterAdd(METAL_COUNTER_PIPELINE_BINDS, 1);
+		vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullpipelinelayout, 0, 1, &descriptorset, 0, nullptr);
+		vkCmdPushConstants(commandbuffer, cullpipelinelayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MetalCullConstants), &Constants);
+		vkCmdDispatch(commandbuffer, (instancecount + INDIRECT_WORKGROUP_SIZE - 1) / INDIRECT_WORKGROUP_SIZE, 1, 1);
+
+		/* Draw commands and count are consumed by the indirect draw*/
+		array<VkBufferMemoryBarrier, 2> DrawBarriers = {};
+		for (int i = 0; i < 2; i++)
+		{
+			DrawBarriers[i].sType				= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			DrawBarriers[i].srcAccessMask		= VK_ACCESS_SHADER_WRITE_BIT;
+			DrawBarriers[i].dstAccessMask		= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+			DrawBarriers[i].srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+			DrawBarriers[i].dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+			DrawBarriers[i].buffer				= Targets[i];
+			DrawBarriers[i].offset				= 0;
+			DrawBarriers[i].size				= VK_WHOLE_SIZE;
+		}
+
+		vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+			0, 0, nullptr, static_cast<VkUint32>(DrawBarriers.size()), DrawBarriers.data(), 0, nullptr);
+	}
+
+	void MetalIndirectRenderer::RecordDraw(VkCommandBuffer commandbuffer)
+	{
+		if (instancecount == 0)
+		{
+			return;
+		}
+
+		METAL_GPU_ZONE(commandbuffer, "Indirect Draw");
+
+		if (compact)
+		{
+			vkCmdDrawIndexedIndirectCount(commandbuffer, drawbuffer, 0, countbuffer, 0, instancecount, sizeof(VkDrawIndexedIndirectCommand));
+			MetalCounterAdd(METAL_COUNTER_DRAW_CALLS, 1);
+		}
+		else
+		{
+			VkUint32 Calls = CmdDrawIndexedIndirectBatched(commandbuffer, drawbuffer, 0, instancecount, sizeof(VkDrawIndexedIndirectCommand));
+			MetalCounterAdd(METAL_COUNTER_DRAW_CALLS, Calls);
+		}
+	}
+}
@@ -0,0 +1,236 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine hardware instancing (per frame instance ring, automatic batching)
+// ------------------------------------------------------
+
+#include "headers/MVulkanInstancing.hpp"
+#include "headers/MVulkanProfiler.hpp"
+#include "headers/MRadixSort.hpp"
+#include "headers/MProfiler.hpp"
+#include "headers/MCounters.h"
+#include "headers/MError.h"
+
+namespace engine::vulkan
+{
+	MetalInstancedVertexInput::MetalInstancedVertexInput()
+	{
+		bindings[0] = { 0, sizeof(float) * 3, VK_VERTEX_INPUT_RATE_VERTEX };
+		bindings[1] = { 1, sizeof(MetalPackedInstance), VK_VERTEX_INPUT_RATE_INSTANCE };
+
+		attributes[0] = { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 };
+		for (VkUint32 i = 0; i < 3; i++)
+		{
+			attributes[i + 1] = { i + 1, 1, VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<VkUint32>(sizeof(vec4f) * i) };
+		}
+
+		info.sType								= VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		info.vertexBindingDescriptionCount		= static_cast<VkUint32>(bindings.size());
+		info.pVertexBindingDescriptions			= bindings.data();
+		info.vertexAttributeDescriptionCount	= static_cast<VkUint32>(attributes.size());
+		info.pVertexAttributeDescriptions		= attributes.data();
+	}
+
+	MetalInstanceRing::~MetalInstanceRing()
+	{
+		Destroy();
+	}
+
+	int MetalInstanceRing::Create(DWord instancesperframe)
+	{
+		if (instancesperframe == 0)
+		{
+			WarningMessage("Vulkan Instancing WARNING", "Tried to create an instance ring with no room");
+			return 1;
+		}
+
+		capacity = instancesperframe;
+		base = 0;
+		used = 0;
+
+		/* Written by the CPU every frame and read once by the GPU, so it lives in host memory and is never staged*/
+		VkDeviceSize Size = sizeof(MetalPackedInstance) * static_cast<VkDeviceSize>(capacity) * MAXIMUM_FRAMES_IN_FLIGHTS;
+		CreateBuffer(Size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, memory);
+
+		void* Mapped = nullptr;
+		VK_CHECK(vkMapMemory(m_device, memory, 0, Size, 0, &Mapped));
+		mapped = static_cast<MetalPackedInstance*>(Mapped);
+		return 0;
+	}
+
+	void MetalInstanceRing::Destroy()
+	{
+		if (m_device == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		/* Freeing the memory unmaps it*/
+		if (buffer != VK_NULL_HANDLE)	vkDestroyBuffer(m_device, buffer, nullptr);
+		if (memory != VK_NULL_HANDLE)	vkFreeMemory(m_device, memory, nullptr);
+
+		buffer = VK_NULL_HANDLE;
+		memory = VK_NULL_HANDLE;
+		mapped = nullptr;
+		capacity = 0;
+		base = 0;
+		used = 0;
+	}
+
+	void MetalInstanceRing::BeginFrame()
+	{
+		base = capacity * static_cast<DWord>(CurrentFrame);
+		used = 0;
+	}
+
+	MetalPackedInstance* MetalInstanceRing::Allocate(DWord count, DWord& firstinstance)
+	{
+		if (mapped == nullptr || count > capacity - used)
+		{
+			return nullptr;
+		}
+
+		firstinstance = base + used;
+		used += count;
+		return mapped + firstinstance;
+	}
+
+	int MetalInstanceBatcher::Create(DWord maxinstancecount, const vector<MetalIndirectMesh>& meshtable)
+	{
+		if (meshtable.empty())
+		{
+			WarningMessage("Vulkan Instancing WARNING", "Tried to create an instance batcher with no meshes");
+			return 1;
+		}
+
+		if (ring.Create(maxinstancecount) != 0)
+		{
+			return 1;
+		}
+
+		maxinstances = maxinstancecount;
+		meshes = meshtable;
+		keys.reserve(maxinstances);
+		transforms.reserve(maxinstances);
+		order.reserve(maxinstances);
+		sortedkeys.reserve(maxinstances);
+		scratchkeys.reserve(maxinstances);
+		scratchorder.reserve(maxinstances);
+		return 0;
+	}
+
+	void MetalInstanceBatcher::Destroy()
+	{
+		ring.Destroy();
+		meshes.clear();
+		keys.clear();
+		transforms.clear();
+		order.clear();
+		sortedkeys.clear();
+		scratchkeys.clear();
+		scratchorder.clear();
+		batches.clear();
+		maxinstances = 0;
+	}
+
+	void MetalInstanceBatcher::Begin()
+	{
+		ring.BeginFrame();
+		keys.clear();
+		transforms.clear();
+		batches.clear();
+	}
+
+	bool MetalInstanceBatcher::Submit(QWord key, const mat4f& model)
+	{
+		if (keys.size() >= maxinstances || InstanceKeyMesh(key) >= meshes.size())
+		{
+			return false;
+		}
+
+		keys.push_back(key);
+		transforms.push_back(MetalPackedInstance{ { model.rows[0], model.rows[1], model.rows[2] } });
+		return true;
+	}
+
+	DWord MetalInstanceBatcher::Build()
+	{
+		METAL_ZONE("Instance Batching");
+
+		batches.clear();
+		DWord Count = static_cast<DWord>(keys.size());
+		if (Count == 0)
+		{
+			return 0;
+		}
+
+		/* The sort is stable, equal keys keep their submission order so a frame always batches the same way*/
+		sortedkeys.assign(keys.begin(), keys.end());
+		order.resize(Count);
+		for (DWord i = 0; i < Count; i++)
+		{
+			order[i] = i;
+		}
+		scratchkeys.resize(Count);
+		scratchorder.resize(Count);
+		engine::jobs::RadixSort(sortedkeys.data(), order.data(), Count, scratchkeys.data(), scratchorder.data());
+
+		DWord FirstInstance = 0;
+		MetalPackedInstance* Destination = ring.Allocate(Count, FirstInstance);
+		if (Destination == nullptr)
+		{
+			WarningMessage("Vulkan Instancing WARNING", "The instance ring has no room for %u instances", Count);
+			return 0;
+		}
+
+		for (DWord i = 0; i < Count; i++)
+		{
+			DWord Source = order[i];
+			Destination[i] = transforms[Source];
+
+			if (batches.empty() || batches.back().key != keys[Source])
+			{
+				batches.push_back(MetalInstanceBatch{ keys[Source], FirstInstance + i, 0 });
+			}
+			batches.back().instancecount++;
+		}
+
+		return static_cast<DWord>(batches.size());
+	}
+
+	void MetalInstanceBatcher::Record(VkCommandBuffer commandbuffer, VkUint32 instancebinding, MetalInstanceBindFunction bind, void* userdata)
+	{
+		if (batches.empty())
+		{
+			return;
+		}
+
+		METAL_GPU_ZONE(commandbuffer, "Instanced Draw");
+
+		/* firstInstance offsets instance rate fetches, so the whole ring is bound once*/
+		VkBuffer RingBuffer = ring.GetBuffer();
+		VkDeviceSize Offset = 0;
+		vkCmdBindVertexBuffers(commandbuffer, instancebinding, 1, &RingBuffer, &Offset);
+
+		/* Only the pipeline and material need binding, every mesh shares the vertex and index buffers*/
+		constexpr QWord StateMask = ~((1ull << INSTANCE_KEY_MESH_BITS) - 1);
+		QWord Previous = ~0ull;
+		for (const MetalInstanceBatch& Batch : batches)
+		{
+			if (bind != nullptr && (Previous == ~0ull || (Batch.key & StateMask) != (Previous & StateMask)))
+			{
+				bind(commandbuffer, Batch.key, Previous, userdata);
+			}
+			Previous = Batch.key;
+
+			const MetalIndirectMesh& Mesh = meshes[InstanceKeyMesh(Batch.key)];
+			vkCmdDrawIndexed(commandbuffer, Mesh.indexcount, Batch.instancecount, Mesh.firstindex, Mesh.vertexoffset, Batch.firstinstance);
+		}
+		MetalCounterAdd(METAL_COUNTER_DRAW_CALLS, static_cast<long long>(batches.size()));
+	}
+}
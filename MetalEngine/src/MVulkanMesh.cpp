@@ -0,0 +1,164 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine GPU meshes (cooked mesh uploads, vertex input layout)
+// ------------------------------------------------------
+
+#include "headers/MVulkanMesh.hpp"
+#include "headers/MCounters.h"
+#include "headers/MError.h"
+
+#include <cstddef>
+#include <cstring>
+
+using namespace engine::meshes;
+
+namespace engine::vulkan
+{
+	MetalMeshVertexInput::MetalMeshVertexInput()
+	{
+		bindings[0] = { 0, sizeof(MetalPackedPosition), VK_VERTEX_INPUT_RATE_VERTEX };
+		bindings[1] = { 1, sizeof(MetalPackedAttributes), VK_VERTEX_INPUT_RATE_VERTEX };
+
+		attributes[0] = { MML_POSITION, 0, VK_FORMAT_R16G16B16A16_UNORM, 0 };
+		attributes[1] = { MML_NORMAL, 1, VK_FORMAT_R16G16_SNORM, static_cast<VkUint32>(offsetof(MetalPackedAttributes, normal)) };
+		attributes[2] = { MML_TANGENT, 1, VK_FORMAT_R16G16_SNORM, static_cast<VkUint32>(offsetof(MetalPackedAttributes, tangent)) };
+		attributes[3] = { MML_UV, 1, VK_FORMAT_R16G16_SFLOAT, static_cast<VkUint32>(offsetof(MetalPackedAttributes, uv)) };
+
+		info.sType								= VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		info.vertexBindingDescriptionCount		= static_cast<VkUint32>(bindings.size());
+		info.pVertexBindingDescriptions			= bindings.data();
+		info.vertexAttributeDescriptionCount	= static_cast<VkUint32>(attributes.size());
+		info.pVertexAttributeDescriptions		= attributes.data();
+	}
+
+	/* Makes the buffer, has the caller fill the mapped staging memory and copies it over*/
+	template<typename F> static int UploadMesh(const MetalCookedMeshHeader& header, MetalGpuMesh& mesh, const F& fill)
+	{
+		if (header.datasize == 0)
+		{
+			return 1;
+		}
+
+		VkBuffer StagingBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory StagingMemory = VK_NULL_HANDLE;
+		CreateBuffer(header.datasize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			StagingBuffer, StagingMemory);
+
+		void* Mapped = nullptr;
+		VK_CHECK(vkMapMemory(m_device, StagingMemory, 0, header.datasize, 0, &Mapped));
+		bool Filled = fill(static_cast<Byte*>(Mapped));
+		vkUnmapMemory(m_device, StagingMemory);
+
+		if (Filled)
+		{
+			/* Storage use too, compute passes (culling, skinning) read the streams directly*/
+			CreateBuffer(header.datasize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mesh.buffer, mesh.memory);
+
+			VkCommandBuffer CommandBuffer = BeginSingleTimeCommands();
+			VkBufferCopy CopyRegion = {};
+			CopyRegion.size = header.datasize;
+			vkCmdCopyBuffer(CommandBuffer, StagingBuffer, mesh.buffer, 1, &CopyRegion);
+			MetalCounterAdd(METAL_COUNTER_BYTES_UPLOADED, static_cast<long long>(header.datasize));
+			EndSingleTimeCommands(CommandBuffer);
+
+			mesh.positionoffset		= 0;
+			mesh.attributeoffset	= header.attributeoffset - header.positionoffset;
+			mesh.indexoffset		= header.indexoffset - header.positionoffset;
+			mesh.indextype			= header.indexsize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+			mesh.header				= header;
+		}
+
+		vkDestroyBuffer(m_device, StagingBuffer, nullptr);
+		vkFreeMemory(m_device, StagingMemory, nullptr);
+		return Filled ? 0 : 1;
+	}
+
+	int LoadPackageMesh(MEPF* package, const char* name, MetalGpuMesh& mesh)
+	{
+		MetalPackageMesh Source;
+		if (ReadPackageMesh(package, name, Source) != 0)
+		{
+			WarningMessage("Mesh WARNING", "%s is not a mesh this build can read", name);
+			return 1;
+		}
+
+		mesh.lods = Source.lods;
+		mesh.submeshes = Source.submeshes;
+		mesh.meshlets = Source.meshlets;
+		return UploadMesh(Source.header, mesh, [&](Byte* destination)
+		{
+			return MEPFReadEntry(package, Source.entry, Source.header.positionoffset, destination, Source.header.datasize) == 0;
+		});
+	}
+
+	int LoadCookedMesh(const MetalCookedMesh& cooked, MetalGpuMesh& mesh)
+	{
+		const MetalCookedMeshHeader& Header = cooked.header;
+		if (Header.magic != COOKED_MESH_MAGIC || cooked.positions.size() != Header.vertexcount)
+		{
+			return 1;
+		}
+
+		mesh.lods = cooked.lods;
+		mesh.submeshes = cooked.submeshes;
+		mesh.meshlets = cooked.meshlets;
+		return UploadMesh(Header, mesh, [&](Byte* destination)
+		{
+			std::memset(destination, 0, Header.datasize);
+			std::memcpy(destination, cooked.positions.data(), sizeof(MetalPackedPosition) * cooked.positions.size());
+			std::memcpy(destination + (Header.attributeoffset - Header.positionoffset), cooked.attributes.data(),
+				sizeof(MetalPackedAttributes) * cooked.attributes.size());
+			std::memcpy(destination + (Header.indexoffset - Header.positionoffset), cooked.indices.data(), cooked.indices.size());
+			return true;
+		});
+	}
+
+	void DestroyGpuMesh(MetalGpuMesh& mesh)
+	{
+		vkDestroyBuffer(m_device, mesh.buffer, nullptr);
+		vkFreeMemory(m_device, mesh.memory, nullptr);
+		mesh.buffer = VK_NULL_HANDLE;
+		mesh.memory = VK_NULL_HANDLE;
+		mesh.lods.clear();
+		mesh.submeshes.clear();
+		mesh.meshlets.clear();
+	}
+
+	DWord AppendIndirectLods(const MetalGpuMesh& mesh, DWord submesh, vector<MetalIndirectMesh>& table)
+	{
+		/* cull.comp scales the error by the instance matrix, which already holds boundsscale, so it goes in quantized units*/
+		float inversescale = 1.0f / mesh.header.boundsscale;
+
+		DWord first = static_cast<DWord>(table.size());
+		for (usize lod = 0; lod < mesh.lods.size(); lod++)
+		{
+			const MetalCookedSubmesh& range = mesh.submeshes[lod * mesh.header.submeshcount + submesh];
+			table.push_back(MetalIndirectMesh{ range.indexcount, range.firstindex, 0, mesh.lods[lod].error * inversescale });
+		}
+		return first;
+	}
+
+	vec4f GetQuantizedBoundingSphere(const MetalGpuMesh& mesh)
+	{
+		const MetalCookedMeshHeader& header = mesh.header;
+		float inversescale = 1.0f / header.boundsscale;
+		return vec4f((header.boundingsphere[0] - header.boundsmin[0]) * inversescale,
+			(header.boundingsphere[1] - header.boundsmin[1]) * inversescale,
+			(header.boundingsphere[2] - header.boundsmin[2]) * inversescale,
+			header.boundingsphere[3] * inversescale);
+	}
+
+	void BindGpuMesh(VkCommandBuffer commandbuffer, const MetalGpuMesh& mesh, bool positiononly)
+	{
+		VkBuffer Buffers[2] = { mesh.buffer, mesh.buffer };
+		VkDeviceSize Offsets[2] = { mesh.positionoffset, mesh.attributeoffset };
+		vkCmdBindVertexBuffers(commandbuffer, 0, positiononly ? 1 : 2, Buffers, Offsets);
+		vkCmdBindIndexBuffer(commandbuffer, mesh.buffer, mesh.indexoffset, mesh.indextype);
+	}
+}
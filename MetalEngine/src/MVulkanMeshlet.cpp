@@ -0,0 +1,693 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine GPU meshlet culling (depth pyramid, per meshlet indirect draws)
+// ------------------------------------------------------
+
+#include "headers/MVulkanMeshlet.hpp"
+#include "headers/MVulkanProfiler.hpp"
+#include "headers/MCounters.h"
+#include "headers/MError.h"
+
+#include <cstring>
+
+using namespace engine::meshes;
+
+namespace engine::vulkan
+{
+	/* Makes one pyramid level's writes visible to whatever compute pass reads it next*/
+	static void PyramidLevelBarrier(VkCommandBuffer commandbuffer, VkImage image, VkUint32 level, VkUint32 levelcount,
+		VkAccessFlags srcaccess, VkAccessFlags dstaccess)
+	{
+		VkImageMemoryBarrier Barrier = {};
+		Barrier.sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		Barrier.srcAccessMask					= srcaccess;
+		Barrier.dstAccessMask					= dstaccess;
+		Barrier.oldLayout						= VK_IMAGE_LAYOUT_GENERAL;
+		Barrier.newLayout						= VK_IMAGE_LAYOUT_GENERAL;
+		Barrier.srcQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		Barrier.dstQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		Barrier.image							= image;
+		Barrier.subresourceRange.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+		Barrier.subresourceRange.baseMipLevel	= level;
+		Barrier.subresourceRange.levelCount		= levelcount;
+		Barrier.subresourceRange.baseArrayLayer	= 0;
+		Barrier.subresourceRange.layerCount		= 1;
+
+		vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &Barrier);
+	}
+
+	MetalGpuDepthPyramid::~MetalGpuDepthPyramid()
+	{
+		Destroy();
+	}
+
+	int MetalGpuDepthPyramid::Create(DWord sourcewidth, DWord sourceheight, const string& shaderpath)
+	{
+		if (sourcewidth == 0 || sourceheight == 0)
+		{
+			WarningMessage("Vulkan Meshlet WARNING", "Tried to create a depth pyramid for an empty depth buffer");
+			return 1;
+		}
+
+		width = sourcewidth;
+		height = sourceheight;
+
+		/* Same level sizes as BuildDepthPyramid, rounding up so no edge texel is ever dropped*/
+		DWord levelwidth = width, levelheight = height;
+		do
+		{
+			levelwidth = (levelwidth + 1) / 2;
+			levelheight = (levelheight + 1) / 2;
+			levelwidths.push_back(levelwidth);
+			levelheights.push_back(levelheight);
+		} while (levelwidths.size() < DEPTH_PYRAMID_MAX_LEVELS && (levelwidth > 1 || levelheight > 1));
+
+		VkUint32 LevelCount = static_cast<VkUint32>(levelwidths.size());
+
+		VkImageCreateInfo ImageInfo = {};
+		ImageInfo.sType			= VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		ImageInfo.imageType		= VK_IMAGE_TYPE_2D;
+		ImageInfo.format		= VK_FORMAT_R32_SFLOAT;
+		ImageInfo.extent		= { levelwidths[0], levelheights[0], 1 };
+		ImageInfo.mipLevels		= LevelCount;
+		ImageInfo.arrayLayers	= 1;
+		ImageInfo.samples		= VK_SAMPLE_COUNT_1_BIT;
+		ImageInfo.tiling		= VK_IMAGE_TILING_OPTIMAL;
+		ImageInfo.usage			= VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		ImageInfo.sharingMode	= VK_SHARING_MODE_EXCLUSIVE;
+		ImageInfo.initialLayout	= VK_IMAGE_LAYOUT_UNDEFINED;
+		CreateImageWithInfo(ImageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
+
+		VkImageViewCreateInfo ViewInfo = {};
+		ViewInfo.sType								= VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		ViewInfo.image								= image;
+		ViewInfo.viewType							= VK_IMAGE_VIEW_TYPE_2D;
+		ViewInfo.format								= VK_FORMAT_R32_SFLOAT;
+		ViewInfo.subresourceRange.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+		ViewInfo.subresourceRange.baseMipLevel		= 0;
+		ViewInfo.subresourceRange.levelCount		= LevelCount;
+		ViewInfo.subresourceRange.baseArrayLayer	= 0;
+		ViewInfo.subresourceRange.layerCount		= 1;
+		VK_CHECK(vkCreateImageView(m_device, &ViewInfo, nullptr, &view));
+
+		levelviews.resize(LevelCount, VK_NULL_HANDLE);
+		for (VkUint32 i = 0; i < LevelCount; i++)
+		{
+			ViewInfo.subresourceRange.baseMipLevel	= i;
+			ViewInfo.subresourceRange.levelCount	= 1;
+			VK_CHECK(vkCreateImageView(m_device, &ViewInfo, nullptr, &levelviews[i]));
+		}
+
+		/* texelFetch only, the sampler just has to exist*/
+		VkSamplerCreateInfo SamplerInfo = {};
+		SamplerInfo.sType			= VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		SamplerInfo.magFilter		= VK_FILTER_NEAREST;
+		SamplerInfo.minFilter		= VK_FILTER_NEAREST;
+		SamplerInfo.mipmapMode		= VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		SamplerInfo.addressModeU	= VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		SamplerInfo.addressModeV	= VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		SamplerInfo.addressModeW	= VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		SamplerInfo.minLod			= 0.0f;
+		SamplerInfo.maxLod			= VK_LOD_CLAMP_NONE;
+		VK_CHECK(vkCreateSampler(m_device, &SamplerInfo, nullptr, &sampler));
+
+		/* Set 0 of depthpyramid.comp: source, destination*/
+		array<VkDescriptorSetLayoutBinding, 2> Bindings = {};
+		Bindings[0].binding			= 0;
+		Bindings[0].descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		Bindings[0].descriptorCount	= 1;
+		Bindings[0].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+		Bindings[1].binding			= 1;
+		Bindings[1].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		Bindings[1].descriptorCount	= 1;
+		Bindings[1].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+
+		VkDescriptorSetLayoutCreateInfo LayoutInfo = {};
+		LayoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		LayoutInfo.bindingCount	= static_cast<VkUint32>(Bindings.size());
+		LayoutInfo.pBindings	= Bindings.data();
+		VK_CHECK(vkCreateDescriptorSetLayout(m_device, &LayoutInfo, nullptr, &descriptorsetlayout));
+
+		/* A set per level after the first, and one per frame in flight for the depth buffer into level 0*/
+		VkUint32 SetCount = (LevelCount - 1) + MAXIMUM_FRAMES_IN_FLIGHTS;
+
+		array<VkDescriptorPoolSize, 2> PoolSizes = {};
+		PoolSizes[0].type				= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		PoolSizes[0].descriptorCount	= SetCount;
+		PoolSizes[1].type				= VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		PoolSizes[1].descriptorCount	= SetCount;
+
+		VkDescriptorPoolCreateInfo PoolInfo = {};
+		PoolInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		PoolInfo.maxSets		= SetCount;
+		PoolInfo.poolSizeCount	= static_cast<VkUint32>(PoolSizes.size());
+		PoolInfo.pPoolSizes		= PoolSizes.data();
+		VK_CHECK(vkCreateDescriptorPool(m_device, &PoolInfo, nullptr, &descriptorpool));
+
+		vector<VkDescriptorSetLayout> SetLayouts(SetCount, descriptorsetlayout);
+		vector<VkDescriptorSet> Sets(SetCount, VK_NULL_HANDLE);
+
+		VkDescriptorSetAllocateInfo AllocationInfo = {};
+		AllocationInfo.sType				= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		AllocationInfo.descriptorPool		= descriptorpool;
+		AllocationInfo.descriptorSetCount	= SetCount;
+		AllocationInfo.pSetLayouts			= SetLayouts.data();
+		VK_CHECK(vkAllocateDescriptorSets(m_device, &AllocationInfo, Sets.data()));
+
+		levelsets.assign(LevelCount, VK_NULL_HANDLE);
+		for (VkUint32 i = 1; i < LevelCount; i++)
+		{
+			levelsets[i] = Sets[i - 1];
+		}
+		for (int i = 0; i < MAXIMUM_FRAMES_IN_FLIGHTS; i++)
+		{
+			sourcesets[i] = Sets[LevelCount - 1 + i];
+			sourceviews[i] = VK_NULL_HANDLE;
+		}
+
+		/* Level to level sets never change, the level 0 sets get their source in Build*/
+		vector<VkDescriptorImageInfo> ImageInfos(static_cast<usize>(SetCount) * 2);
+		vector<VkWriteDescriptorSet> Writes;
+		Writes.reserve(ImageInfos.size());
+		for (VkUint32 i = 0; i < SetCount; i++)
+		{
+			bool Source = i >= LevelCount - 1;
+			VkUint32 Level = Source ? 0 : i + 1;
+			VkDescriptorSet Set = Source ? sourcesets[i - (LevelCount - 1)] : levelsets[Level];
+
+			if (!Source)
+			{
+				ImageInfos[i * 2] = { sampler, levelviews[Level - 1], VK_IMAGE_LAYOUT_GENERAL };
+
+				VkWriteDescriptorSet Write = {};
+				Write.sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				Write.dstSet			= Set;
+				Write.dstBinding		= 0;
+				Write.descriptorCount	= 1;
+				Write.descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				Write.pImageInfo		= &ImageInfos[i * 2];
+				Writes.push_back(Write);
+			}
+
+			ImageInfos[i * 2 + 1] = { VK_NULL_HANDLE, levelviews[Level], VK_IMAGE_LAYOUT_GENERAL };
+
+			VkWriteDescriptorSet Write = {};
+			Write.sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			Write.dstSet			= Set;
+			Write.dstBinding		= 1;
+			Write.descriptorCount	= 1;
+			Write.descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			Write.pImageInfo		= &ImageInfos[i * 2 + 1];
+			Writes.push_back(Write);
+		}
+		vkUpdateDescriptorSets(m_device, static_cast<VkUint32>(Writes.size()), Writes.data(), 0, nullptr);
+		MetalCounterAdd(METAL_COUNTER_DESCRIPTOR_WRITES, static_cast<long long>(Writes.size()));
+
+		VkPushConstantRange PushRange = {};
+		PushRange.stageFlags	= VK_SHADER_STAGE_COMPUTE_BIT;
+		PushRange.offset		= 0;
+		PushRange.size			= sizeof(MetalDepthPyramidConstants);
+
+		VkPipelineLayoutCreateInfo PipelineLayoutInfo = {};
+		PipelineLayoutInfo.sType					= VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		PipelineLayoutInfo.setLayoutCount			= 1;
+		PipelineLayoutInfo.pSetLayouts				= &descriptorsetlayout;
+		PipelineLayoutInfo.pushConstantRangeCount	= 1;
+		PipelineLayoutInfo.pPushConstantRanges		= &PushRange;
+		VK_CHECK(vkCreatePipelineLayout(m_device, &PipelineLayoutInfo, nullptr, &pipelinelayout));
+
+		if (CreateComputePipeline(shaderpath, pipelinelayout, pipeline) != 0)
+		{
+			return 1;
+		}
+
+		/* Start out far so nothing is occluded before the first Build, and settle in GENERAL for good*/
+		VkCommandBuffer CommandBuffer = BeginSingleTimeCommands();
+
+		VkImageMemoryBarrier Barrier = {};
+		Barrier.sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		Barrier.srcAccessMask					= 0;
+		Barrier.dstAccessMask					= VK_ACCESS_TRANSFER_WRITE_BIT;
+		Barrier.oldLayout						= VK_IMAGE_LAYOUT_UNDEFINED;
+		Barrier.newLayout						= VK_IMAGE_LAYOUT_GENERAL;
+		Barrier.srcQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		Barrier.dstQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		Barrier.image							= image;
+		Barrier.subresourceRange				= ViewInfo.subresourceRange;
+		Barrier.subresourceRange.baseMipLevel	= 0;
+		Barrier.subresourceRange.levelCount		= LevelCount;
+		vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &Barrier);
+
+		VkClearColorValue Far = {};
+		Far.float32[0] = 1.0f;
+		vkCmdClearColorImage(CommandBuffer, image, VK_IMAGE_LAYOUT_GENERAL, &Far, 1, &Barrier.subresourceRange);
+
+		Barrier.srcAccessMask	= VK_ACCESS_TRANSFER_WRITE_BIT;
+		Barrier.dstAccessMask	= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		Barrier.oldLayout		= VK_IMAGE_LAYOUT_GENERAL;
+		vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &Barrier);
+
+		EndSingleTimeCommands(CommandBuffer);
+		return 0;
+	}
+
+	void MetalGpuDepthPyramid::Destroy()
+	{
+		if (m_device == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		if (pipeline != VK_NULL_HANDLE)				vkDestroyPipeline(m_device, pipeline, nullptr);
+		if (pipelinelayout != VK_NULL_HANDLE)		vkDestroyPipelineLayout(m_device, pipelinelayout, nullptr);
+		if (descriptorpool != VK_NULL_HANDLE)		vkDestroyDescriptorPool(m_device, descriptorpool, nullptr);
+		if (descriptorsetlayout != VK_NULL_HANDLE)	vkDestroyDescriptorSetLayout(m_device, descriptorsetlayout, nullptr);
+		if (sampler != VK_NULL_HANDLE)				vkDestroySampler(m_device, sampler, nullptr);
+		for (VkImageView LevelView : levelviews)
+		{
+			if (LevelView != VK_NULL_HANDLE)		vkDestroyImageView(m_device, LevelView, nullptr);
+		}
+		if (view != VK_NULL_HANDLE)					vkDestroyImageView(m_device, view, nullptr);
+		if (image != VK_NULL_HANDLE)				vkDestroyImage(m_device, image, nullptr);
+		if (memory != VK_NULL_HANDLE)				vkFreeMemory(m_device, memory, nullptr);
+
+		pipeline = VK_NULL_HANDLE;
+		pipelinelayout = VK_NULL_HANDLE;
+		descriptorpool = VK_NULL_HANDLE;
+		descriptorsetlayout = VK_NULL_HANDLE;
+		sampler = VK_NULL_HANDLE;
+		view = VK_NULL_HANDLE;
+		image = VK_NULL_HANDLE;
+		memory = VK_NULL_HANDLE;
+		levelviews.clear();
+		levelsets.clear();
+		levelwidths.clear();
+		levelheights.clear();
+		sourcesets = {};
+		sourceviews = {};
+		width = 0;
+		height = 0;
+	}
+
+	void MetalGpuDepthPyramid::Build(VkCommandBuffer commandbuffer, VkImageView depthview)
+	{
+		if (pipeline == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		METAL_GPU_ZONE(commandbuffer, "Depth Pyramid");
+
+		/* This frame's set is idle once its fence was waited on, so it can follow the depth buffer around*/
+		VkDescriptorSet SourceSet = sourcesets[CurrentFrame];
+		if (sourceviews[CurrentFrame] != depthview)
+		{
+			VkDescriptorImageInfo SourceInfo = { sampler, depthview, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+
+			VkWriteDescriptorSet Write = {};
+			Write.sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			Write.dstSet			= SourceSet;
+			Write.dstBinding		= 0;
+			Write.descriptorCount	= 1;
+			Write.descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			Write.pImageInfo		= &SourceInfo;
+			vkUpdateDescriptorSets(m_device, 1, &Write, 0, nullptr);
+			MetalCounterAdd(METAL_COUNTER_DESCRIPTOR_WRITES, 1);
+			sourceviews[CurrentFrame] = depthview;
+		}
+
+		VkUint32 LevelCount = static_cast<VkUint32>(levelwidths.size());
+
+		/* Last frame's culling may still be reading the pyramid*/
+		PyramidLevelBarrier(commandbuffer, image, 0, LevelCount, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+		vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		MetalCounterAdd(METAL_COUNTER_PIPELINE_BINDS, 1);
+
+		for (VkUint32 Level = 0; Level < LevelCount; Level++)
+		{
+			MetalDepthPyramidConstants Constants = {};
+			Constants.sourcesize[0]			= static_cast<int>(Level == 0 ? width : levelwidths[Level - 1]);
+			Constants.sourcesize[1]			= static_cast<int>(Level == 0 ? height : levelheights[Level - 1]);
+			Constants.destinationsize[0]	= static_cast<int>(levelwidths[Level]);
+			Constants.destinationsize[1]	= static_cast<int>(levelheights[Level]);
+
+			VkDescriptorSet Set = Level == 0 ? SourceSet : levelsets[Level];
+			vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelinelayout, 0, 1, &Set, 0, nullptr);
+			vkCmdPushConstants(commandbuffer, pipelinelayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MetalDepthPyramidConstants), &Constants);
+			vkCmdDispatch(commandbuffer, (levelwidths[Level] + DEPTH_PYRAMID_WORKGROUP_SIZE - 1) / DEPTH_PYRAMID_WORKGROUP_SIZE,
+				(levelheights[Level] + DEPTH_PYRAMID_WORKGROUP_SIZE - 1) / DEPTH_PYRAMID_WORKGROUP_SIZE, 1);
+
+			/* The next level (or the culling pass after the last one) reads this one*/
+			PyramidLevelBarrier(commandbuffer, image, Level, 1, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+		}
+	}
+
+	MetalMeshletRenderer::~MetalMeshletRenderer()
+	{
+		Destroy();
+	}
+
+	int MetalMeshletRenderer::Create(const MetalGpuMesh& mesh, DWord lod, DWord maxinstancecount, const string& cullshaderpath, const string& pyramidshaderpath)
+	{
+		if (maxinstancecount == 0 || lod >= mesh.lods.size() || mesh.lods[lod].meshletcount == 0 ||
+			mesh.lods[lod].firstmeshlet + mesh.lods[lod].meshletcount > mesh.meshlets.size())
+		{
+			WarningMessage("Vulkan Meshlet WARNING", "Tried to create a meshlet renderer with no instances or a LOD without meshlets");
+			return 1;
+		}
+
+		const MetalCookedLod& Lod = mesh.lods[lod];
+		maxinstances = maxinstancecount;
+		instancecount = 0;
+		meshletcount = Lod.meshletcount;
+		/* The count variant can't be split, past maxDrawIndirectCount every slot gets a command instead*/
+		compact = m_drawindirectcount_supported &&
+			static_cast<QWord>(maxinstances) * meshletcount <= m_properties.limits.maxDrawIndirectCount;
+		depthpyramid = nullptr;
+
+		/* The bounds are cooked in mesh space, instances transform from quantized space
+			(their model matrix has the dequantize matrix folded in), so move the bounds there once here
+		*/
+		const MetalCookedMeshHeader& Header = mesh.header;
+		float InverseScale = 1.0f / Header.boundsscale;
+		vector<MetalCookedMeshlet> Meshlets(mesh.meshlets.begin() + Lod.firstmeshlet, mesh.meshlets.begin() + Lod.firstmeshlet + Lod.meshletcount);
+		for (MetalCookedMeshlet& Meshlet : Meshlets)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				Meshlet.center[i] = (Meshlet.center[i] - Header.boundsmin[i]) * InverseScale;
+				Meshlet.coneapex[i] = (Meshlet.coneapex[i] - Header.boundsmin[i]) * InverseScale;
+			}
+			Meshlet.radius *= InverseScale;
+		}
+
+		if (emptypyramid.Create(1, 1, pyramidshaderpath) != 0)
+		{
+			return 1;
+		}
+
+		CreateBuffer(sizeof(MetalGpuInstance) * maxinstances,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, instancebuffer, instancememory);
+
+		CreateBuffer(sizeof(MetalCookedMeshlet) * Meshlets.size(),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshletbuffer, meshletmemory);
+		UploadToBuffer(meshletbuffer, 0, Meshlets.data(), sizeof(MetalCookedMeshlet) * Meshlets.size());
+
+		/* Transfer source so metal_tests can read back what the culling pass wrote*/
+		CreateBuffer(sizeof(VkDrawIndexedIndirectCommand) * maxinstances * meshletcount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawbuffer, drawmemory);
+
+		CreateBuffer(sizeof(VkUint32),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, countbuffer, countmemory);
+
+		/* Camera data changes every frame, one mapped copy per frame in flight*/
+		for (int i = 0; i < MAXIMUM_FRAMES_IN_FLIGHTS; i++)
+		{
+			CreateBuffer(sizeof(MetalMeshletCullData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformbuffers[i], uniformmemory[i]);
+			VK_CHECK(vkMapMemory(m_device, uniformmemory[i], 0, sizeof(MetalMeshletCullData), 0, &uniformmapped[i]));
+		}
+
+		/* Set 0 of meshlet_cull.comp: instances, meshlets, draw commands, draw count, depth pyramid, camera*/
+		array<VkDescriptorSetLayoutBinding, 6> Bindings = {};
+		for (VkUint32 i = 0; i < Bindings.size(); i++)
+		{
+			Bindings[i].binding			= i;
+			Bindings[i].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			Bindings[i].descriptorCount	= 1;
+			Bindings[i].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+		Bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		Bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+		VkDescriptorSetLayoutCreateInfo LayoutInfo = {};
+		LayoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		LayoutInfo.bindingCount	= static_cast<VkUint32>(Bindings.size());
+		LayoutInfo.pBindings	= Bindings.data();
+		VK_CHECK(vkCreateDescriptorSetLayout(m_device, &LayoutInfo, nullptr, &descriptorsetlayout));
+
+		array<VkDescriptorPoolSize, 3> PoolSizes = {};
+		PoolSizes[0].type				= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		PoolSizes[0].descriptorCount	= 4 * MAXIMUM_FRAMES_IN_FLIGHTS;
+		PoolSizes[1].type				= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		PoolSizes[1].descriptorCount	= MAXIMUM_FRAMES_IN_FLIGHTS;
+		PoolSizes[2].type				= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		PoolSizes[2].descriptorCount	= MAXIMUM_FRAMES_IN_FLIGHTS;
+
+		VkDescriptorPoolCreateInfo PoolInfo = {};
+		PoolInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		PoolInfo.maxSets		= MAXIMUM_FRAMES_IN_FLIGHTS;
+		PoolInfo.poolSizeCount	= static_cast<VkUint32>(PoolSizes.size());
+		PoolInfo.pPoolSizes		= PoolSizes.data();
+		VK_CHECK(vkCreateDescriptorPool(m_device, &PoolInfo, nullptr, &descriptorpool));
+
+		array<VkDescriptorSetLayout, MAXIMUM_FRAMES_IN_FLIGHTS> SetLayouts;
+		SetLayouts.fill(descriptorsetlayout);
+
+		VkDescriptorSetAllocateInfo AllocationInfo = {};
+		AllocationInfo.sType				= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		AllocationInfo.descriptorPool		= descriptorpool;
+		AllocationInfo.descriptorSetCount	= MAXIMUM_FRAMES_IN_FLIGHTS;
+		AllocationInfo.pSetLayouts			= SetLayouts.data();
+		VK_CHECK(vkAllocateDescriptorSets(m_device, &AllocationInfo, descriptorsets.data()));
+
+		for (int Frame = 0; Frame < MAXIMUM_FRAMES_IN_FLIGHTS; Frame++)
+		{
+			VkDescriptorBufferInfo BufferInfos[6] = {};
+			BufferInfos[0] = { instancebuffer, 0, VK_WHOLE_SIZE };
+			BufferInfos[1] = { meshletbuffer, 0, VK_WHOLE_SIZE };
+			BufferInfos[2] = { drawbuffer, 0, VK_WHOLE_SIZE };
+			BufferInfos[3] = { countbuffer, 0, VK_WHOLE_SIZE };
+			BufferInfos[5] = { uniformbuffers[Frame], 0, sizeof(MetalMeshletCullData) };
+
+			VkDescriptorImageInfo PyramidInfo = { emptypyramid.GetSampler(), emptypyramid.GetView(), VK_IMAGE_LAYOUT_GENERAL };
+			pyramidviews[Frame] = emptypyramid.GetView();
+
+			array<VkWriteDescriptorSet, 6> Writes = {};
+			for (VkUint32 i = 0; i < Writes.size(); i++)
+			{
+				Writes[i].sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				Writes[i].dstSet			= descriptorsets[Frame];
+				Writes[i].dstBinding		= i;
+				Writes[i].descriptorCount	= 1;
+				Writes[i].descriptorType	= Bindings[i].descriptorType;
+				Writes[i].pBufferInfo		= &BufferInfos[i];
+			}
+			Writes[4].pBufferInfo	= nullptr;
+			Writes[4].pImageInfo	= &PyramidInfo;
+			vkUpdateDescriptorSets(m_device, static_cast<VkUint32>(Writes.size()), Writes.data(), 0, nullptr);
+			MetalCounterAdd(METAL_COUNTER_DESCRIPTOR_WRITES, static_cast<long long>(Writes.size()));
+		}
+
+		VkPipelineLayoutCreateInfo PipelineLayoutInfo = {};
+		PipelineLayoutInfo.sType			= VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		PipelineLayoutInfo.setLayoutCount	= 1;
+		PipelineLayoutInfo.pSetLayouts		= &descriptorsetlayout;
+		VK_CHECK(vkCreatePipelineLayout(m_device, &PipelineLayoutInfo, nullptr, &cullpipelinelayout));
+
+		if (CreateComputePipeline(cullshaderpath, cullpipelinelayout, cullpipeline) != 0)
+		{
+			return 1;
+		}
+
+		fmt::print("ENGINE: Vulkan meshlet renderer ready ({} meshlets, {} instances, {})\n", meshletcount, maxinstances,
+			compact ? "draw count from GPU" : "drawing every slot");
+		return 0;
+	}
+
+	void MetalMeshletRenderer::Destroy()
+	{
+		if (m_device == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		if (cullpipeline != VK_NULL_HANDLE)			vkDestroyPipeline(m_device, cullpipeline, nullptr);
+		if (cullpipelinelayout != VK_NULL_HANDLE)	vkDestroyPipelineLayout(m_device, cullpipelinelayout, nullptr);
+		if (descriptorpool != VK_NULL_HANDLE)		vkDestroyDescriptorPool(m_device, descriptorpool, nullptr);
+		if (descriptorsetlayout != VK_NULL_HANDLE)	vkDestroyDescriptorSetLayout(m_device, descriptorsetlayout, nullptr);
+
+		VkBuffer Buffers[] = { instancebuffer, meshletbuffer, drawbuffer, countbuffer };
+		VkDeviceMemory Memories[] = { instancememory, meshletmemory, drawmemory, countmemory };
+		for (int i = 0; i < 4; i++)
+		{
+			if (Buffers[i] != VK_NULL_HANDLE)	vkDestroyBuffer(m_device, Buffers[i], nullptr);
+			if (Memories[i] != VK_NULL_HANDLE)	vkFreeMemory(m_device, Memories[i], nullptr);
+		}
+
+		for (int i = 0; i < MAXIMUM_FRAMES_IN_FLIGHTS; i++)
+		{
+			if (uniformbuffers[i] != VK_NULL_HANDLE)	vkDestroyBuffer(m_device, uniformbuffers[i], nullptr);
+			if (uniformmemory[i] != VK_NULL_HANDLE)		vkFreeMemory(m_device, uniformmemory[i], nullptr);
+		}
+
+		emptypyramid.Destroy();
+
+		cullpipeline = VK_NULL_HANDLE;
+		cullpipelinelayout = VK_NULL_HANDLE;
+		descriptorpool = VK_NULL_HANDLE;
+		descriptorsetlayout = VK_NULL_HANDLE;
+		instancebuffer = meshletbuffer = drawbuffer = countbuffer = VK_NULL_HANDLE;
+		instancememory = meshletmemory = drawmemory = countmemory = VK_NULL_HANDLE;
+		uniformbuffers = {};
+		uniformmemory = {};
+		uniformmapped = {};
+		descriptorsets = {};
+		pyramidviews = {};
+		depthpyramid = nullptr;
+		maxinstances = 0;
+		instancecount = 0;
+		meshletcount = 0;
+	}
+
+	void MetalMeshletRenderer::UploadInstances(const MetalGpuInstance* instances, DWord first, DWord count)
+	{
+		if (first >= maxinstances)
+		{
+			return;
+		}
+
+		count = first + count > maxinstances ? maxinstances - first : count;
+		UploadToBuffer(instancebuffer, sizeof(MetalGpuInstance) * first, instances, sizeof(MetalGpuInstance) * count);
+	}
+
+	void MetalMeshletRenderer::RecordCulling(VkCommandBuffer commandbuffer, const mat4f& viewproj, const vec3f& camera, const mat4f& occlusionviewproj)
+	{
+		if (instancecount == 0)
+		{
+			return;
+		}
+
+		METAL_GPU_ZONE(commandbuffer, "Meshlet Culling");
+
+		/* Point binding 4 at the pyramid in use, this frame's set is idle once its fence was waited on*/
+		const MetalGpuDepthPyramid& Pyramid = depthpyramid != nullptr ? *depthpyramid : emptypyramid;
+		VkDescriptorSet Set = descriptorsets[CurrentFrame];
+		if (pyramidviews[CurrentFrame] != Pyramid.GetView())
+		{
+			VkDescriptorImageInfo PyramidInfo = { Pyramid.GetSampler(), Pyramid.GetView(), VK_IMAGE_LAYOUT_GENERAL };
+
+			VkWriteDescriptorSet Write = {};
+			Write.sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			Write.dstSet			= Set;
+			Write.dstBinding		= 4;
+			Write.descriptorCount	= 1;
+			Write.descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			Write.pImageInfo		= &PyramidInfo;
+			vkUpdateDescriptorSets(m_device, 1, &Write, 0, nullptr);
+			MetalCounterAdd(METAL_COUNTER_DESCRIPTOR_WRITES, 1);
+			pyramidviews[CurrentFrame] = Pyramid.GetView();
+		}
+
+		MetalMeshletCullData Data = {};
+		for (int i = 0; i < 4; i++)
+		{
+			Data.viewprojrows[i] = viewproj.rows[i];
+			Data.occlusionrows[i] = occlusionviewproj.rows[i];
+		}
+		Data.camera			= vec4f(camera.x, camera.y, camera.z, 1.0f);
+		Data.instancecount	= instancecount;
+		Data.meshletcount	= meshletcount;
+		Data.compact		= compact ? 1 : 0;
+		Data.occlusion		= depthpyramid != nullptr ? 1 : 0;
+		Data.pyramidwidth	= Pyramid.GetWidth();
+		Data.pyramidheight	= Pyramid.GetHeight();
+		Data.pyramidlevels	= Pyramid.GetLevelCount();
+		std::memcpy(uniformmapped[CurrentFrame], &Data, sizeof(Data));
+
+		/* The previous frame in flight draws from the same draw and count buffers, its indirect reads
+			have to finish before the clear and the culling write over them
+		*/
+		array<VkBufferMemoryBarrier, 2> ReuseBarriers = {};
+		VkBuffer Targets[] = { drawbuffer, countbuffer };
+		for (int i = 0; i < 2; i++)
+		{
+			ReuseBarriers[i].sType					= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			ReuseBarriers[i].srcAccessMask			= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+			ReuseBarriers[i].dstAccessMask			= VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			ReuseBarriers[i].srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+			ReuseBarriers[i].dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+			ReuseBarriers[i].buffer					= Targets[i];
+			ReuseBarriers[i].offset					= 0;
+			ReuseBarriers[i].size					= VK_WHOLE_SIZE;
+		}
+
+		vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, static_cast<VkUint32>(ReuseBarriers.size()), ReuseBarriers.data(), 0, nullptr);
+
+		/* Reset the draw count, then make the compute shader wait for the clear*/
+		vkCmdFillBuffer(commandbuffer, countbuffer, 0, sizeof(VkUint32), 0);
+
+		VkBufferMemoryBarrier ClearBarrier = {};
+		ClearBarrier.sType					= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		ClearBarrier.srcAccessMask			= VK_ACCESS_TRANSFER_WRITE_BIT;
+		ClearBarrier.dstAccessMask			= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		ClearBarrier.srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		ClearBarrier.dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		ClearBarrier.buffer					= countbuffer;
+		ClearBarrier.offset					= 0;
+		ClearBarrier.size					= VK_WHOLE_SIZE;
+
+		vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 1, &ClearBarrier, 0, nullptr);
+
+		vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullpipeline);
+		MetalCounterAdd(METAL_COUNTER_PIPELINE_BINDS, 1);
+		vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullpipelinelayout, 0, 1, &Set, 0, nullptr);
+
+		QWord Threads = static_cast<QWord>(instancecount) * meshletcount;
+		vkCmdDispatch(commandbuffer, static_cast<VkUint32>((Threads + MESHLET_WORKGROUP_SIZE - 1) / MESHLET_WORKGROUP_SIZE), 1, 1);
+
+		/* Draw commands and count are consumed by the indirect draw*/
+		array<VkBufferMemoryBarrier, 2> DrawBarriers = {};
+		for (int i = 0; i < 2; i++)
+		{
+			DrawBarriers[i].sType				= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			DrawBarriers[i].srcAccessMask		= VK_ACCESS_SHADER_WRITE_BIT;
+			DrawBarriers[i].dstAccessMask		= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+			DrawBarriers[i].srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+			DrawBarriers[i].dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+			DrawBarriers[i].buffer				= Targets[i];
+			DrawBarriers[i].offset				= 0;
+			DrawBarriers[i].size				= VK_WHOLE_SIZE;
+		}
+
+		vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+			0, 0, nullptr, static_cast<VkUint32>(DrawBarriers.size()), DrawBarriers.data(), 0, nullptr);
+	}
+
+	void MetalMeshletRenderer::RecordDraw(VkCommandBuffer commandbuffer)
+	{
+		if (instancecount == 0)
+		{
+			return;
+		}
+
+		METAL_GPU_ZONE(commandbuffer, "Meshlet Draw");
+
+		DWord Slots = instancecount * meshletcount;
+		if (compact)
+		{
+			vkCmdDrawIndexedIndirectCount(commandbuffer, drawbuffer, 0, countbuffer, 0, Slots, sizeof(VkDrawIndexedIndirectCommand));
+			MetalCounterAdd(METAL_COUNTER_DRAW_CALLS, 1);
+		}
+		else
+		{
+			VkUint32 Calls = CmdDrawIndexedIndirectBatched(commandbuffer, drawbuffer, 0, Slots, sizeof(VkDrawIndexedIndirectCommand));
+			MetalCounterAdd(METAL_COUNTER_DRAW_CALLS, Calls);
+		}
+	}
+}
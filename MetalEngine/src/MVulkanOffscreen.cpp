@@ -0,0 +1,381 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine offscreen rendering (headless frames read back through host visible buffers)
+// ------------------------------------------------------
+
+#include "headers/MVulkanOffscreen.hpp"
+#include "headers/MVulkanProfiler.hpp"
+#include "headers/MCounters.h"
+#include "headers/MError.h"
+
+#include <chrono>
+
+namespace engine::vulkan
+{
+	static bool IsReadbackFormat(VkFormat format)
+	{
+		return format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB
+			|| format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+	}
+
+	MetalOffscreenTarget::~MetalOffscreenTarget()
+	{
+		Destroy();
+	}
+
+	int MetalOffscreenTarget::Create(VkUint32 width, VkUint32 height, VkFormat colorformat)
+	{
+		if (width == 0 || height == 0 || !IsReadbackFormat(colorformat))
+		{
+			WarningMessage("Vulkan Offscreen WARNING", "Tried to create a %ux%u offscreen target with format %d", width, height, static_cast<int>(colorformat));
+			return 1;
+		}
+
+		extent = { width, height };
+		format = colorformat;
+		lastframe = MAXIMUM_FRAMES_IN_FLIGHTS;
+
+		VkFormat DepthFormat = FindDepthFormat();
+
+		VkAttachmentDescription ColorAttachment = {};
+		ColorAttachment.format			= format;
+		ColorAttachment.samples			= VK_SAMPLE_COUNT_1_BIT;
+		ColorAttachment.loadOp			= VK_ATTACHMENT_LOAD_OP_CLEAR;
+		ColorAttachment.storeOp			= VK_ATTACHMENT_STORE_OP_STORE;
+		ColorAttachment.stencilLoadOp	= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		ColorAttachment.stencilStoreOp	= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		ColorAttachment.initialLayout	= VK_IMAGE_LAYOUT_UNDEFINED;
+		ColorAttachment.finalLayout		= VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;	/* Straight into the readback copy*/
+
+		VkAttachmentDescription DepthAttachment = {};
+		DepthAttachment.format			= DepthFormat;
+		DepthAttachment.samples			= VK_SAMPLE_COUNT_1_BIT;
+		DepthAttachment.loadOp			= VK_ATTACHMENT_LOAD_OP_CLEAR;
+		DepthAttachment.storeOp			= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		DepthAttachment.stencilLoadOp	= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		DepthAttachment.stencilStoreOp	= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		DepthAttachment.initialLayout	= VK_IMAGE_LAYOUT_UNDEFINED;
+		DepthAttachment.finalLayout		= VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference ColorRef = {};
+		ColorRef.attachment	= 0;
+		ColorRef.layout		= VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference DepthRef = {};
+		DepthRef.attachment	= 1;
+		DepthRef.layout		= VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkSubpassDescription Subpass = {};
+		Subpass.pipelineBindPoint		= VK_PIPELINE_BIND_POINT_GRAPHICS;
+		Subpass.colorAttachmentCount	= 1;
+		Subpass.pColorAttachments		= &ColorRef;
+		Subpass.pDepthStencilAttachment	= &DepthRef;
+
+		/* In: same as the swapchain render pass. Out: the copy reads what the subpass wrote*/
+		array<VkSubpassDependency, 2> Dependencies = {};
+		Dependencies[0].srcSubpass		= VK_SUBPASS_EXTERNAL;
+		Dependencies[0].dstSubpass		= 0;
+		Dependencies[0].srcStageMask	= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		Dependencies[0].dstStageMask	= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		Dependencies[0].srcAccessMask	= 0;
+		Dependencies[0].dstAccessMask	= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		Dependencies[1].srcSubpass		= 0;
+		Dependencies[1].dstSubpass		= VK_SUBPASS_EXTERNAL;
+		Dependencies[1].srcStageMask	= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		Dependencies[1].dstStageMask	= VK_PIPELINE_STAGE_TRANSFER_BIT;
+		Dependencies[1].srcAccessMask	= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		Dependencies[1].dstAccessMask	= VK_ACCESS_TRANSFER_READ_BIT;
+
+		array<VkAttachmentDescription, 2> Attachments = { ColorAttachment, DepthAttachment };
+		VkRenderPassCreateInfo RenderPassInfo = {};
+		RenderPassInfo.sType			= VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		RenderPassInfo.attachmentCount	= static_cast<VkUint32>(Attachments.size());
+		RenderPassInfo.pAttachments		= Attachments.data();
+		RenderPassInfo.subpassCount		= 1;
+		RenderPassInfo.pSubpasses		= &Subpass;
+		RenderPassInfo.dependencyCount	= static_cast<VkUint32>(Dependencies.size());
+		RenderPassInfo.pDependencies	= Dependencies.data();
+		VK_CHECK(vkCreateRenderPass(m_device, &RenderPassInfo, nullptr, &renderpass));
+
+		VkImageCreateInfo ImageInfo = {};
+		ImageInfo.sType			= VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		ImageInfo.imageType		= VK_IMAGE_TYPE_2D;
+		ImageInfo.extent		= { width, height, 1 };
+		ImageInfo.mipLevels		= 1;
+		ImageInfo.arrayLayers	= 1;
+		ImageInfo.tiling		= VK_IMAGE_TILING_OPTIMAL;
+		ImageInfo.initialLayout	= VK_IMAGE_LAYOUT_UNDEFINED;
+		ImageInfo.samples		= VK_SAMPLE_COUNT_1_BIT;
+		ImageInfo.sharingMode	= VK_SHARING_MODE_EXCLUSIVE;
+
+		VkImageViewCreateInfo ViewInfo = {};
+		ViewInfo.sType								= VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		ViewInfo.viewType							= VK_IMAGE_VIEW_TYPE_2D;
+		ViewInfo.subresourceRange.baseMipLevel		= 0;
+		ViewInfo.subresourceRange.levelCount		= 1;
+		ViewInfo.subresourceRange.baseArrayLayer	= 0;
+		ViewInfo.subresourceRange.layerCount		= 1;
+
+		VkCommandBufferAllocateInfo AllocationInfo = {};
+		AllocationInfo.sType				= VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		AllocationInfo.level				= VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		AllocationInfo.commandPool			= m_commandpool;
+		AllocationInfo.commandBufferCount	= 1;
+
+		VkFenceCreateInfo FenceInfo = {};
+		FenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		FenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+		VkDeviceSize ReadbackSize = static_cast<VkDeviceSize>(width) * height * 4;
+
+		for (MetalOffscreenFrame& Frame : frames)
+		{
+			ImageInfo.format	= format;
+			ImageInfo.usage		= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			CreateImageWithInfo(ImageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, Frame.colorimage, Frame.colormemory);
+
+			ViewInfo.image							= Frame.colorimage;
+			ViewInfo.format							= format;
+			ViewInfo.subresourceRange.aspectMask	= VK_IMAGE_ASPECT_COLOR_BIT;
+			VK_CHECK(vkCreateImageView(m_device, &ViewInfo, nullptr, &Frame.colorview));
+
+			ImageInfo.format	= DepthFormat;
+			ImageInfo.usage		= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+			CreateImageWithInfo(ImageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, Frame.depthimage, Frame.depthmemory);
+
+			ViewInfo.image							= Frame.depthimage;
+			ViewInfo.format							= DepthFormat;
+			ViewInfo.subresourceRange.aspectMask	= VK_IMAGE_ASPECT_DEPTH_BIT;
+			VK_CHECK(vkCreateImageView(m_device, &ViewInfo, nullptr, &Frame.depthview));
+
+			array<VkImageView, 2> Views = { Frame.colorview, Frame.depthview };
+			VkFramebufferCreateInfo FramebufferInfo = {};
+			FramebufferInfo.sType			= VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			FramebufferInfo.renderPass		= renderpass;
+			FramebufferInfo.attachmentCount	= static_cast<VkUint32>(Views.size());
+			FramebufferInfo.pAttachments	= Views.data();
+			FramebufferInfo.width			= width;
+			FramebufferInfo.height			= height;
+			FramebufferInfo.layers			= 1;
+			VK_CHECK(vkCreateFramebuffer(m_device, &FramebufferInfo, nullptr, &Frame.framebuffer));
+
+			CreateBuffer(ReadbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, Frame.readbackbuffer, Frame.readbackmemory);
+			VK_CHECK(vkMapMemory(m_device, Frame.readbackmemory, 0, ReadbackSize, 0, reinterpret_cast<void**>(&Frame.readback)));
+
+			VK_CHECK(vkAllocateCommandBuffers(m_device, &AllocationInfo, &Frame.commandbuffer));
+			VK_CHECK(vkCreateFence(m_device, &FenceInfo, nullptr, &Frame.fence));
+		}
+
+		/* Pipelines are built against the swapchain's render pass and extent, headless there is only us*/
+		if (m_headless)
+		{
+			m_renderpass = renderpass;
+			m_swapchain_extent = extent;
+			m_swapchain_image_format = format;
+			m_window_extent = extent;
+		}
+
+		return 0;
+	}
+
+	void MetalOffscreenTarget::Destroy()
+	{
+		if (renderpass == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		for (MetalOffscreenFrame& Frame : frames)
+		{
+			if (Frame.fence != VK_NULL_HANDLE)
+			{
+				vkWaitForFences(m_device, 1, &Frame.fence, VK_TRUE, UINT64_MAX);
+				vkDestroyFence(m_device, Frame.fence, nullptr);
+			}
+			if (Frame.commandbuffer != VK_NULL_HANDLE)
+			{
+				vkFreeCommandBuffers(m_device, m_commandpool, 1, &Frame.commandbuffer);
+			}
+			if (Frame.readbackmemory != VK_NULL_HANDLE)
+			{
+				vkUnmapMemory(m_device, Frame.readbackmemory);
+			}
+
+			vkDestroyBuffer(m_device, Frame.readbackbuffer, nullptr);
+			vkFreeMemory(m_device, Frame.readbackmemory, nullptr);
+			vkDestroyFramebuffer(m_device, Frame.framebuffer, nullptr);
+			vkDestroyImageView(m_device, Frame.depthview, nullptr);
+			vkDestroyImage(m_device, Frame.depthimage, nullptr);
+			vkFreeMemory(m_device, Frame.depthmemory, nullptr);
+			vkDestroyImageView(m_device, Frame.colorview, nullptr);
+			vkDestroyImage(m_device, Frame.colorimage, nullptr);
+			vkFreeMemory(m_device, Frame.colormemory, nullptr);
+			Frame = MetalOffscreenFrame();
+		}
+
+		if (m_renderpass == renderpass)
+		{
+			m_renderpass = VK_NULL_HANDLE;
+		}
+
+		vkDestroyRenderPass(m_device, renderpass, nullptr);
+		renderpass = VK_NULL_HANDLE;
+		lastframe = MAXIMUM_FRAMES_IN_FLIGHTS;
+	}
+
+	VkCommandBuffer MetalOffscreenTarget::BeginFrame()
+	{
+		METAL_ZONE("Offscreen BeginFrame");
+
+		MetalOffscreenFrame& Frame = frames[CurrentFrame];
+
+		/* Same bookkeeping as AcquireNextImage, there is just no image to acquire*/
+		auto WaitStart = std::chrono::steady_clock::now();
+		vkWaitForFences(m_device, 1, &Frame.fence, VK_TRUE, UINT64_MAX);
+		MetalCounterSample(METAL_COUNTER_FENCE_WAIT, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - WaitStart).count());
+		SampleMemoryCounters();
+
+#if defined(METAL_PROFILE)
+		GpuProfilerCollect();
+#endif
+
+		VK_CHECK(vkResetCommandBuffer(Frame.commandbuffer, 0));
+
+		VkCommandBufferBeginInfo BeginInfo = {};
+		BeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		BeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK(vkBeginCommandBuffer(Frame.commandbuffer, &BeginInfo));
+
+		return Frame.commandbuffer;
+	}
+
+	void MetalOffscreenTarget::BeginRenderPass(const float clearcolor[4])
+	{
+		MetalOffscreenFrame& Frame = frames[CurrentFrame];
+
+		array<VkClearValue, 2> ClearValues = {};
+		ClearValues[0].color		= { { clearcolor[0], clearcolor[1], clearcolor[2], clearcolor[3] } };
+		ClearValues[1].depthStencil	= { 1.0f, 0 };
+
+		VkRenderPassBeginInfo RenderPassInfo = {};
+		RenderPassInfo.sType				= VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		RenderPassInfo.renderPass			= renderpass;
+		RenderPassInfo.framebuffer			= Frame.framebuffer;
+		RenderPassInfo.renderArea.offset	= { 0, 0 };
+		RenderPassInfo.renderArea.extent	= extent;
+		RenderPassInfo.clearValueCount		= static_cast<VkUint32>(ClearValues.size());
+		RenderPassInfo.pClearValues			= ClearValues.data();
+		vkCmdBeginRenderPass(Frame.commandbuffer, &RenderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	}
+
+	void MetalOffscreenTarget::EndFrame()
+	{
+		METAL_ZONE("Offscreen EndFrame");
+
+		MetalOffscreenFrame& Frame = frames[CurrentFrame];
+
+		/* The render pass left the color image in TRANSFER_SRC_OPTIMAL*/
+		vkCmdEndRenderPass(Frame.commandbuffer);
+
+		VkBufferImageCopy Region = {};
+		Region.bufferOffset						= 0;
+		Region.bufferRowLength					= 0;	/* Tightly packed*/
+		Region.bufferImageHeight				= 0;
+		Region.imageSubresource.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+		Region.imageSubresource.mipLevel		= 0;
+		Region.imageSubresource.baseArrayLayer	= 0;
+		Region.imageSubresource.layerCount		= 1;
+		Region.imageOffset						= { 0, 0, 0 };
+		Region.imageExtent						= { extent.width, extent.height, 1 };
+		vkCmdCopyImageToBuffer(Frame.commandbuffer, Frame.colorimage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, Frame.readbackbuffer, 1, &Region);
+
+		/* Make the copy visible to the mapped pointer once the fence says the frame is done*/
+		VkBufferMemoryBarrier Barrier = {};
+		Barrier.sType				= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		Barrier.srcAccessMask		= VK_ACCESS_TRANSFER_WRITE_BIT;
+		Barrier.dstAccessMask		= VK_ACCESS_HOST_READ_BIT;
+		Barrier.srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		Barrier.dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		Barrier.buffer				= Frame.readbackbuffer;
+		Barrier.offset				= 0;
+		Barrier.size				= VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(Frame.commandbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &Barrier, 0, nullptr);
+
+		VK_CHECK(vkEndCommandBuffer(Frame.commandbuffer));
+
+		VkSubmitInfo SubmitInfo = {};
+		SubmitInfo.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		SubmitInfo.commandBufferCount	= 1;
+		SubmitInfo.pCommandBuffers		= &Frame.commandbuffer;
+
+#if defined(METAL_PROFILE)
+		VkCommandBuffer ProfiledBuffers[3];
+		SubmitInfo.commandBufferCount = GpuProfilerWrapSubmit(&Frame.commandbuffer, 1, ProfiledBuffers);
+		SubmitInfo.pCommandBuffers = ProfiledBuffers;
+#endif
+
+		vkResetFences(m_device, 1, &Frame.fence);
+		VK_CHECK(vkQueueSubmit(m_graphicsqueue, 1, &SubmitInfo, Frame.fence));
+		MetalCounterAdd(METAL_COUNTER_QUEUE_SUBMITS, 1);
+
+		lastframe = CurrentFrame;
+		CurrentFrame = (CurrentFrame + 1) % MAXIMUM_FRAMES_IN_FLIGHTS;
+	}
+
+	const Byte* MetalOffscreenTarget::ReadbackLastFrame()
+	{
+		if (lastframe >= MAXIMUM_FRAMES_IN_FLIGHTS)
+		{
+			return nullptr;
+		}
+
+		MetalOffscreenFrame& Frame = frames[lastframe];
+		vkWaitForFences(m_device, 1, &Frame.fence, VK_TRUE, UINT64_MAX);
+		return Frame.readback;
+	}
+
+	int MetalOffscreenTarget::SaveLastFrame(const char* path)
+	{
+		const Byte* Pixels = ReadbackLastFrame();
+		if (Pixels == nullptr)
+		{
+			WarningMessage("Vulkan Offscreen WARNING", "No frame has been rendered to save to %s", path);
+			return 1;
+		}
+
+		FILE* File = fopen(path, "wb");
+		if (File == nullptr)
+		{
+			WarningMessage("Vulkan Offscreen WARNING", "Failed to open %s", path);
+			return 1;
+		}
+
+		/* PPM is RGB, BGRA targets get swizzled and alpha is dropped*/
+		bool Swizzle = format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+		fprintf(File, "P6\n%u %u\n255\n", extent.width, extent.height);
+
+		vector<Byte> Row(static_cast<VkUsize>(extent.width) * 3);
+		for (VkUint32 y = 0; y < extent.height; y++)
+		{
+			const Byte* Source = Pixels + static_cast<VkUsize>(y) * extent.width * 4;
+			for (VkUint32 x = 0; x < extent.width; x++)
+			{
+				Row[x * 3 + 0] = Source[x * 4 + (Swizzle ? 2 : 0)];
+				Row[x * 3 + 1] = Source[x * 4 + 1];
+				Row[x * 3 + 2] = Source[x * 4 + (Swizzle ? 0 : 2)];
+			}
+			fwrite(Row.data(), 1, Row.size(), File);
+		}
+
+		bool Failed = ferror(File) != 0;
+		fclose(File);
+		return Failed ? 1 : 0;
+	}
+}
@@ -0,0 +1,533 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine GPU particles (emit, simulate and compact by compute, bitonic depth sort, indirect draw)
+// ------------------------------------------------------
+
+#include "headers/MVulkanParticles.hpp"
+#include "headers/MVulkanProfiler.hpp"
+#include "headers/MCounters.h"
+#include "headers/MError.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+
+namespace engine::vulkan
+{
+	/* Makes every shader write so far visible to the given stages, the passes here all touch whole buffers*/
+	static void ParticleBarrier(VkCommandBuffer commandbuffer, VkPipelineStageFlags srcstage, VkAccessFlags srcaccess,
+		VkPipelineStageFlags dststage, VkAccessFlags dstaccess)
+	{
+		VkMemoryBarrier Barrier = {};
+		Barrier.sType			= VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		Barrier.srcAccessMask	= srcaccess;
+		Barrier.dstAccessMask	= dstaccess;
+		vkCmdPipelineBarrier(commandbuffer, srcstage, dststage, 0, 1, &Barrier, 0, nullptr, 0, nullptr);
+	}
+
+	static void ComputeToCompute(VkCommandBuffer commandbuffer)
+	{
+		ParticleBarrier(commandbuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	}
+
+	static VkShaderModule LoadShaderModule(const string& path)
+	{
+		vector<char> Code = MetalVulkanPipeline::ReadShaderFile(path);
+		if (Code.empty())
+		{
+			return VK_NULL_HANDLE;
+		}
+
+		VkShaderModuleCreateInfo ModuleInfo = {};
+		ModuleInfo.sType	= VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		ModuleInfo.codeSize	= Code.size();
+		ModuleInfo.pCode	= reinterpret_cast<const VkUint32*>(Code.data());
+
+		VkShaderModule Module = VK_NULL_HANDLE;
+		VK_CHECK(vkCreateShaderModule(m_device, &ModuleInfo, nullptr, &Module));
+		return Module;
+	}
+
+	MetalGpuParticles::~MetalGpuParticles()
+	{
+		Destroy();
+	}
+
+	int MetalGpuParticles::Create(DWord maxparticles, bool sorted, const MetalParticleShaderPaths& shaders, VkRenderPass renderpass, DWord width, DWord height)
+	{
+		if (maxparticles == 0)
+		{
+			WarningMessage("Vulkan Particles WARNING", "Tried to create a particle system with no room for particles");
+			return 1;
+		}
+
+		capacity = maxparticles;
+		source = 0;
+		seed = 0;
+		emitcarry = 0.0f;
+		textures = false;
+
+		/* Bitonic sorts want a power of two, and at least one whole block for the shared memory passes*/
+		sortcount = sorted ? std::max(std::bit_ceil(capacity), PARTICLE_SORT_BLOCK) : 0;
+
+		/* Both start empty, the draw command's instance count is the alive count*/
+		VkDrawIndirectCommand Empty = {};
+		Empty.vertexCount	= PARTICLE_QUAD_VERTICES;
+		Empty.instanceCount	= 0;
+
+		for (int i = 0; i < 2; i++)
+		{
+			CreateBuffer(sizeof(MetalGpuParticle) * static_cast<VkDeviceSize>(capacity), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, particlebuffers[i], particlememory[i]);
+
+			CreateBuffer(sizeof(VkDrawIndirectCommand),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawbuffers[i], drawmemory[i]);
+			UploadToBuffer(drawbuffers[i], 0, &Empty, sizeof(Empty));
+		}
+
+		/* Binding 5 has to point somewhere even unsorted*/
+		CreateBuffer(sizeof(VkUint32) * 2 * static_cast<VkDeviceSize>(std::max(sortcount, 1u)), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sortbuffer, sortmemory);
+
+		for (int i = 0; i < MAXIMUM_FRAMES_IN_FLIGHTS; i++)
+		{
+			CreateBuffer(sizeof(MetalParticleData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformbuffers[i], uniformmemory[i]);
+			VK_CHECK(vkMapMemory(m_device, uniformmemory[i], 0, sizeof(MetalParticleData), 0, &uniformmapped[i]));
+		}
+
+		/* Set 0 of the compute passes: data, source particles, destination particles, source draw, destination draw, sort list*/
+		array<VkDescriptorSetLayoutBinding, 6> ComputeBindings = {};
+		for (VkUint32 i = 0; i < ComputeBindings.size(); i++)
+		{
+			ComputeBindings[i].binding			= i;
+			ComputeBindings[i].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			ComputeBindings[i].descriptorCount	= 1;
+			ComputeBindings[i].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+		ComputeBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+		VkDescriptorSetLayoutCreateInfo LayoutInfo = {};
+		LayoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		LayoutInfo.bindingCount	= static_cast<VkUint32>(ComputeBindings.size());
+		LayoutInfo.pBindings	= ComputeBindings.data();
+		VK_CHECK(vkCreateDescriptorSetLayout(m_device, &LayoutInfo, nullptr, &computesetlayout));
+
+		/* Set 0 of particle.vert and particle.frag: data, the two fog.frag textures, particles, sort list*/
+		array<VkDescriptorSetLayoutBinding, 5> DrawBindings = {};
+		VkUint32 DrawSlots[] = { 0, 2, 3, 4, 5 };
+		for (VkUint32 i = 0; i < DrawBindings.size(); i++)
+		{
+			DrawBindings[i].binding			= DrawSlots[i];
+			DrawBindings[i].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			DrawBindings[i].descriptorCount	= 1;
+			DrawBindings[i].stageFlags		= VK_SHADER_STAGE_VERTEX_BIT;
+		}
+		DrawBindings[0].descriptorType	= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		DrawBindings[0].stageFlags		= VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+		DrawBindings[1].descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		DrawBindings[1].stageFlags		= VK_SHADER_STAGE_FRAGMENT_BIT;
+		DrawBindings[2].descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		DrawBindings[2].stageFlags		= VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		LayoutInfo.bindingCount	= static_cast<VkUint32>(DrawBindings.size());
+		LayoutInfo.pBindings	= DrawBindings.data();
+		VK_CHECK(vkCreateDescriptorSetLayout(m_device, &LayoutInfo, nullptr, &drawsetlayout));
+
+		/* One compute and one draw set per frame in flight and state buffer*/
+		VkUint32 SetCount = MAXIMUM_FRAMES_IN_FLIGHTS * 2;
+
+		array<VkDescriptorPoolSize, 3> PoolSizes = {};
+		PoolSizes[0].type				= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		PoolSizes[0].descriptorCount	= SetCount * 2;
+		PoolSizes[1].type				= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		PoolSizes[1].descriptorCount	= SetCount * 7;
+		PoolSizes[2].type				= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		PoolSizes[2].descriptorCount	= SetCount * 2;
+
+		VkDescriptorPoolCreateInfo PoolInfo = {};
+		PoolInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		PoolInfo.maxSets		= SetCount * 2;
+		PoolInfo.poolSizeCount	= static_cast<VkUint32>(PoolSizes.size());
+		PoolInfo.pPoolSizes		= PoolSizes.data();
+		VK_CHECK(vkCreateDescriptorPool(m_device, &PoolInfo, nullptr, &descriptorpool));
+
+		vector<VkDescriptorSetLayout> SetLayouts(SetCount, computesetlayout);
+		VkDescriptorSetAllocateInfo AllocationInfo = {};
+		AllocationInfo.sType				= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		AllocationInfo.descriptorPool		= descriptorpool;
+		AllocationInfo.descriptorSetCount	= SetCount;
+		AllocationInfo.pSetLayouts			= SetLayouts.data();
+		VK_CHECK(vkAllocateDescriptorSets(m_device, &AllocationInfo, computesets.data()));
+
+		SetLayouts.assign(SetCount, drawsetlayout);
+		VK_CHECK(vkAllocateDescriptorSets(m_device, &AllocationInfo, drawsets.data()));
+
+		/* Buffers never change, only the textures are written later by SetTextures*/
+		for (VkUint32 Set = 0; Set < SetCount; Set++)
+		{
+			VkUint32 Frame = Set / 2;
+			VkUint32 State = Set % 2;
+
+			VkDescriptorBufferInfo ComputeInfos[6] = {};
+			ComputeInfos[0] = { uniformbuffers[Frame], 0, sizeof(MetalParticleData) };
+			ComputeInfos[1] = { particlebuffers[State], 0, VK_WHOLE_SIZE };
+			ComputeInfos[2] = { particlebuffers[1 - State], 0, VK_WHOLE_SIZE };
+			ComputeInfos[3] = { drawbuffers[State], 0, VK_WHOLE_SIZE };
+			ComputeInfos[4] = { drawbuffers[1 - State], 0, VK_WHOLE_SIZE };
+			ComputeInfos[5] = { sortbuffer, 0, VK_WHOLE_SIZE };
+
+			VkDescriptorBufferInfo DrawInfos[3] = {};
+			DrawInfos[0] = { uniformbuffers[Frame], 0, sizeof(MetalParticleData) };
+			DrawInfos[1] = { particlebuffers[State], 0, VK_WHOLE_SIZE };
+			DrawInfos[2] = { sortbuffer, 0, VK_WHOLE_SIZE };
+
+			/* The draw set's buffers are entries 0, 3 and 4 of DrawBindings, the textures come later*/
+			const VkUint32 DrawBuffers[3] = { 0, 3, 4 };
+
+			array<VkWriteDescriptorSet, 9> Writes = {};
+			for (VkUint32 i = 0; i < Writes.size(); i++)
+			{
+				Writes[i].sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				Writes[i].descriptorCount	= 1;
+				if (i < 6)
+				{
+					Writes[i].dstSet			= computesets[Set];
+					Writes[i].dstBinding		= i;
+					Writes[i].descriptorType	= ComputeBindings[i].descriptorType;
+					Writes[i].pBufferInfo		= &ComputeInfos[i];
+				}
+				else
+				{
+					const VkDescriptorSetLayoutBinding& Binding = DrawBindings[DrawBuffers[i - 6]];
+					Writes[i].dstSet			= drawsets[Set];
+					Writes[i].dstBinding		= Binding.binding;
+					Writes[i].descriptorType	= Binding.descriptorType;
+					Writes[i].pBufferInfo		= &DrawInfos[i - 6];
+				}
+			}
+			vkUpdateDescriptorSets(m_device, static_cast<VkUint32>(Writes.size()), Writes.data(), 0, nullptr);
+			MetalCounterAdd(METAL_COUNTER_DESCRIPTOR_WRITES, static_cast<long long>(Writes.size()));
+		}
+
+		VkPushConstantRange PushRange = {};
+		PushRange.stageFlags	= VK_SHADER_STAGE_COMPUTE_BIT;
+		PushRange.offset		= 0;
+		PushRange.size			= sizeof(MetalParticleSortConstants);
+
+		VkPipelineLayoutCreateInfo PipelineLayoutInfo = {};
+		PipelineLayoutInfo.sType					= VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		PipelineLayoutInfo.setLayoutCount			= 1;
+		PipelineLayoutInfo.pSetLayouts				= &computesetlayout;
+		PipelineLayoutInfo.pushConstantRangeCount	= 1;
+		PipelineLayoutInfo.pPushConstantRanges		= &PushRange;
+		VK_CHECK(vkCreatePipelineLayout(m_device, &PipelineLayoutInfo, nullptr, &computelayout));
+
+		PipelineLayoutInfo.pSetLayouts				= &drawsetlayout;
+		PipelineLayoutInfo.pushConstantRangeCount	= 0;
+		PipelineLayoutInfo.pPushConstantRanges		= nullptr;
+		VK_CHECK(vkCreatePipelineLayout(m_device, &PipelineLayoutInfo, nullptr, &drawlayout));
+
+		if (CreateComputePipeline(shaders.emit, computelayout, emitpipeline) != 0
+			|| CreateComputePipeline(shaders.simulate, computelayout, simulatepipeline) != 0
+			|| (sortcount != 0 && CreateComputePipeline(shaders.sort, computelayout, sortpipeline) != 0))
+		{
+			return 1;
+		}
+
+		VkShaderModule VertexModule = LoadShaderModule(shaders.vertex);
+		VkShaderModule FragmentModule = LoadShaderModule(shaders.fragment);
+		if (VertexModule == VK_NULL_HANDLE || FragmentModule == VK_NULL_HANDLE)
+		{
+			if (VertexModule != VK_NULL_HANDLE)		vkDestroyShaderModule(m_device, VertexModule, nullptr);
+			if (FragmentModule != VK_NULL_HANDLE)	vkDestroyShaderModule(m_device, FragmentModule, nullptr);
+			return 1;
+		}
+
+		array<VkPipelineShaderStageCreateInfo, 2> Stages = {};
+		Stages[0].sType		= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		Stages[0].stage		= VK_SHADER_STAGE_VERTEX_BIT;
+		Stages[0].module	= VertexModule;
+		Stages[0].pName		= "main";
+		Stages[1].sType		= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		Stages[1].stage		= VK_SHADER_STAGE_FRAGMENT_BIT;
+		Stages[1].module	= FragmentModule;
+		Stages[1].pName		= "main";
+
+		/* particle.vert pulls everything from the particle buffer*/
+		VkPipelineVertexInputStateCreateInfo VertexInput = {};
+		VertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+		/* The config is returned by value, point its state back at its own viewport, scissor and attachment*/
+		MetalVulkanPipelineConfigInfo Config = MetalVulkanPipeline::DefaultPipelineConfigInfo(width, height);
+		Config.viewportinfo.pViewports			= &Config.viewport;
+		Config.viewportinfo.pScissors			= &Config.scissor;
+		Config.colorblendinfo.pAttachments		= &Config.colorblend_attachment;
+		Config.rasterizationinfo.cullMode		= VK_CULL_MODE_NONE;
+
+		/* Straight alpha over what is already there*/
+		Config.colorblend_attachment.blendEnable			= VK_TRUE;
+		Config.colorblend_attachment.srcColorBlendFactor	= VK_BLEND_FACTOR_SRC_ALPHA;
+		Config.colorblend_attachment.dstColorBlendFactor	= VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		Config.colorblend_attachment.srcAlphaBlendFactor	= VK_BLEND_FACTOR_ONE;
+		Config.colorblend_attachment.dstAlphaBlendFactor	= VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+
+		/* Tested against the opaque depth but never written, particles don't hide each other*/
+		VkPipelineDepthStencilStateCreateInfo DepthStencil = {};
+		DepthStencil.sType				= VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		DepthStencil.depthTestEnable	= VK_TRUE;
+		DepthStencil.depthWriteEnable	= VK_FALSE;
+		DepthStencil.depthCompareOp		= VK_COMPARE_OP_LESS;
+		DepthStencil.minDepthBounds		= 0.0f;
+		DepthStencil.maxDepthBounds		= 1.0f;
+
+		VkGraphicsPipelineCreateInfo PipelineInfo = {};
+		PipelineInfo.sType					= VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		PipelineInfo.stageCount				= static_cast<VkUint32>(Stages.size());
+		PipelineInfo.pStages				= Stages.data();
+		PipelineInfo.pVertexInputState		= &VertexInput;
+		PipelineInfo.pInputAssemblyState	= &Config.inputassemblyinfo;
+		PipelineInfo.pViewportState			= &Config.viewportinfo;
+		PipelineInfo.pRasterizationState	= &Config.rasterizationinfo;
+		PipelineInfo.pMultisampleState		= &Config.multisampleinfo;
+		PipelineInfo.pColorBlendState		= &Config.colorblendinfo;
+		PipelineInfo.pDepthStencilState		= &DepthStencil;
+		PipelineInfo.layout					= drawlayout;
+		PipelineInfo.renderPass				= renderpass;
+		PipelineInfo.subpass				= 0;
+		PipelineInfo.basePipelineIndex		= -1;
+		VK_CHECK(vkCreateGraphicsPipelines(m_device, m_pipelinecache, 1, &PipelineInfo, nullptr, &drawpipeline));
+
+		vkDestroyShaderModule(m_device, VertexModule, nullptr);
+		vkDestroyShaderModule(m_device, FragmentModule, nullptr);
+
+		fmt::print("ENGINE: Vulkan particles ready ({} particles, {})\n", capacity,
+			sortcount != 0 ? "sorted back to front" : "unsorted");
+		return 0;
+	}
+
+	void MetalGpuParticles::Destroy()
+	{
+		if (m_device == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		VkPipeline Pipelines[] = { emitpipeline, simulatepipeline, sortpipeline, drawpipeline };
+		for (VkPipeline Pipeline : Pipelines)
+		{
+			if (Pipeline != VK_NULL_HANDLE)			vkDestroyPipeline(m_device, Pipeline, nullptr);
+		}
+		if (computelayout != VK_NULL_HANDLE)		vkDestroyPipelineLayout(m_device, computelayout, nullptr);
+		if (drawlayout != VK_NULL_HANDLE)			vkDestroyPipelineLayout(m_device, drawlayout, nullptr);
+		if (descriptorpool != VK_NULL_HANDLE)		vkDestroyDescriptorPool(m_device, descriptorpool, nullptr);
+		if (computesetlayout != VK_NULL_HANDLE)		vkDestroyDescriptorSetLayout(m_device, computesetlayout, nullptr);
+		if (drawsetlayout != VK_NULL_HANDLE)		vkDestroyDescriptorSetLayout(m_device, drawsetlayout, nullptr);
+
+		for (int i = 0; i < 2; i++)
+		{
+			if (particlebuffers[i] != VK_NULL_HANDLE)	vkDestroyBuffer(m_device, particlebuffers[i], nullptr);
+			if (particlememory[i] != VK_NULL_HANDLE)	vkFreeMemory(m_device, particlememory[i], nullptr);
+			if (drawbuffers[i] != VK_NULL_HANDLE)		vkDestroyBuffer(m_device, drawbuffers[i], nullptr);
+			if (drawmemory[i] != VK_NULL_HANDLE)		vkFreeMemory(m_device, drawmemory[i], nullptr);
+		}
+		if (sortbuffer != VK_NULL_HANDLE)			vkDestroyBuffer(m_device, sortbuffer, nullptr);
+		if (sortmemory != VK_NULL_HANDLE)			vkFreeMemory(m_device, sortmemory, nullptr);
+
+		for (int i = 0; i < MAXIMUM_FRAMES_IN_FLIGHTS; i++)
+		{
+			if (uniformbuffers[i] != VK_NULL_HANDLE)	vkDestroyBuffer(m_device, uniformbuffers[i], nullptr);
+			if (uniformmemory[i] != VK_NULL_HANDLE)		vkFreeMemory(m_device, uniformmemory[i], nullptr);
+		}
+
+		emitpipeline = simulatepipeline = sortpipeline = drawpipeline = VK_NULL_HANDLE;
+		computelayout = drawlayout = VK_NULL_HANDLE;
+		descriptorpool = VK_NULL_HANDLE;
+		computesetlayout = drawsetlayout = VK_NULL_HANDLE;
+		particlebuffers = {};
+		particlememory = {};
+		drawbuffers = {};
+		drawmemory = {};
+		sortbuffer = VK_NULL_HANDLE;
+		sortmemory = VK_NULL_HANDLE;
+		uniformbuffers = {};
+		uniformmemory = {};
+		uniformmapped = {};
+		computesets = {};
+		drawsets = {};
+		capacity = 0;
+		sortcount = 0;
+		textures = false;
+	}
+
+	void MetalGpuParticles::SetTextures(VkImageView texture0, VkImageView texture1, VkSampler sampler)
+	{
+		if (descriptorpool == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		VkDescriptorImageInfo ImageInfos[2] = {};
+		ImageInfos[0] = { sampler, texture0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		ImageInfos[1] = { sampler, texture1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+		vector<VkWriteDescriptorSet> Writes;
+		Writes.reserve(drawsets.size() * 2);
+		for (VkDescriptorSet Set : drawsets)
+		{
+			for (VkUint32 i = 0; i < 2; i++)
+			{
+				VkWriteDescriptorSet Write = {};
+				Write.sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				Write.dstSet			= Set;
+				Write.dstBinding		= 2 + i;
+				Write.descriptorCount	= 1;
+				Write.descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				Write.pImageInfo		= &ImageInfos[i];
+				Writes.push_back(Write);
+			}
+		}
+		vkUpdateDescriptorSets(m_device, static_cast<VkUint32>(Writes.size()), Writes.data(), 0, nullptr);
+		MetalCounterAdd(METAL_COUNTER_DESCRIPTOR_WRITES, static_cast<long long>(Writes.size()));
+		textures = true;
+	}
+
+	void MetalGpuParticles::RecordSimulation(VkCommandBuffer commandbuffer, float deltatime, const MetalParticleCamera& camera)
+	{
+		if (emitpipeline == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		METAL_GPU_ZONE(commandbuffer, "Particles");
+
+		/* The rate is rarely a whole number of particles per frame, keep what is owed*/
+		emitcarry += emitter.rate * deltatime;
+		DWord EmitCount = emitcarry > 0.0f ? std::min(static_cast<DWord>(emitcarry), capacity) : 0;
+		emitcarry -= static_cast<float>(EmitCount);
+
+		MetalParticleData Data = {};
+		for (int i = 0; i < 4; i++)
+		{
+			Data.viewprojrows[i] = camera.viewproj.rows[i];
+		}
+		Data.cameraright		= vec4f(camera.right.x, camera.right.y, camera.right.z, 0.0f);
+		Data.cameraup			= vec4f(camera.up.x, camera.up.y, camera.up.z, 0.0f);
+		Data.cameraforward		= vec4f(camera.forward.x, camera.forward.y, camera.forward.z,
+			-(camera.forward.x * camera.position.x + camera.forward.y * camera.position.y + camera.forward.z * camera.position.z));
+		Data.emitterposition	= vec4f(emitter.position.x, emitter.position.y, emitter.position.z, emitter.radius);
+		Data.emittervelocity	= vec4f(emitter.velocity.x, emitter.velocity.y, emitter.velocity.z, emitter.spread);
+		Data.gravity			= vec4f(emitter.gravity.x, emitter.gravity.y, emitter.gravity.z, emitter.drag);
+		Data.startcolor			= emitter.startcolor;
+		Data.endcolor			= emitter.endcolor;
+		Data.tint				= tint;
+		Data.deltatime			= deltatime;
+		Data.lifetime			= emitter.lifetime;
+		Data.lifetimevariance	= emitter.lifetimevariance;
+		Data.startsize			= emitter.startsize;
+		Data.endsize			= emitter.endsize;
+		Data.emitcount			= EmitCount;
+		Data.capacity			= capacity;
+		Data.seed				= seed++;
+		Data.sortcount			= sortcount;
+		std::memcpy(uniformmapped[CurrentFrame], &Data, sizeof(Data));
+
+		/* Last frame drew from the buffer emission appends to, and simulated into the one this frame writes*/
+		ParticleBarrier(commandbuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+		/* Empty the destination, only its instance count, the vertex count stays*/
+		vkCmdFillBuffer(commandbuffer, drawbuffers[1 - source], offsetof(VkDrawIndirectCommand, instanceCount), sizeof(VkUint32), 0);
+		ParticleBarrier(commandbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+		VkDescriptorSet Set = computesets[CurrentFrame * 2 + source];
+		vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computelayout, 0, 1, &Set, 0, nullptr);
+
+		if (EmitCount > 0)
+		{
+			vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, emitpipeline);
+			MetalCounterAdd(METAL_COUNTER_PIPELINE_BINDS, 1);
+			vkCmdDispatch(commandbuffer, (EmitCount + PARTICLE_WORKGROUP_SIZE - 1) / PARTICLE_WORKGROUP_SIZE, 1, 1);
+			ComputeToCompute(commandbuffer);
+		}
+
+		/* The alive count only lives on the GPU, so every slot gets a thread and the ones past it leave right away*/
+		vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, simulatepipeline);
+		MetalCounterAdd(METAL_COUNTER_PIPELINE_BINDS, 1);
+		vkCmdDispatch(commandbuffer, (capacity + PARTICLE_WORKGROUP_SIZE - 1) / PARTICLE_WORKGROUP_SIZE, 1, 1);
+
+		if (sortcount != 0)
+		{
+			ComputeToCompute(commandbuffer);
+			vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, sortpipeline);
+			MetalCounterAdd(METAL_COUNTER_PIPELINE_BINDS, 1);
+
+			/* Blocks are sorted in shared memory first, then every merge above the block size takes
+				one global pass per stride down to the block size and finishes inside the blocks
+			*/
+			MetalParticleSortConstants Constants = {};
+			Constants.mode = 0;
+			Constants.size = PARTICLE_SORT_BLOCK;
+			vkCmdPushConstants(commandbuffer, computelayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Constants), &Constants);
+			vkCmdDispatch(commandbuffer, sortcount / PARTICLE_SORT_BLOCK, 1, 1);
+
+			for (DWord Size = PARTICLE_SORT_BLOCK * 2; Size <= sortcount; Size *= 2)
+			{
+				for (DWord Stride = Size / 2; Stride >= PARTICLE_SORT_BLOCK; Stride /= 2)
+				{
+					ComputeToCompute(commandbuffer);
+					Constants.mode		= 1;
+					Constants.size		= Size;
+					Constants.stride	= Stride;
+					vkCmdPushConstants(commandbuffer, computelayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Constants), &Constants);
+					vkCmdDispatch(commandbuffer, sortcount / PARTICLE_SORT_BLOCK, 1, 1);
+				}
+
+				ComputeToCompute(commandbuffer);
+				Constants.mode		= 2;
+				Constants.size		= Size;
+				Constants.stride	= PARTICLE_SORT_BLOCK / 2;
+				vkCmdPushConstants(commandbuffer, computelayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Constants), &Constants);
+				vkCmdDispatch(commandbuffer, sortcount / PARTICLE_SORT_BLOCK, 1, 1);
+			}
+		}
+
+		/* The destination, its draw command and the sort list feed this frame's draw*/
+		ParticleBarrier(commandbuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+
+		source = 1 - source;
+	}
+
+	void MetalGpuParticles::RecordDraw(VkCommandBuffer commandbuffer)
+	{
+		if (drawpipeline == VK_NULL_HANDLE || !textures)
+		{
+			return;
+		}
+
+		METAL_GPU_ZONE(commandbuffer, "Particle Draw");
+
+		/* RecordSimulation already flipped, the source is what it just wrote*/
+		VkDescriptorSet Set = drawsets[CurrentFrame * 2 + source];
+		vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawpipeline);
+		MetalCounterAdd(METAL_COUNTER_PIPELINE_BINDS, 1);
+		vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawlayout, 0, 1, &Set, 0, nullptr);
+
+		vkCmdDrawIndirect(commandbuffer, drawbuffers[source], 0, 1, sizeof(VkDrawIndirectCommand));
+		MetalCounterAdd(METAL_COUNTER_DRAW_CALLS, 1);
+	}
+}
@@ -0,0 +1,571 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine post processing (HDR render target, compute bloom, tonemapping and sRGB output)
+// ------------------------------------------------------
+
+#include "headers/MVulkanPostProcess.hpp"
+#include "headers/MVulkanProfiler.hpp"
+#include "headers/MCounters.h"
+#include "headers/MError.h"
+
+#include <algorithm>
+
+namespace engine::vulkan
+{
+	/* tonemap.comp writes rgba8 and already encodes to sRGB, the blit has to carry the bytes over unchanged*/
+	static bool IsDestinationFormat(VkFormat format)
+	{
+		return format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_A8B8G8R8_UNORM_PACK32;
+	}
+
+	static bool CanRenderAndSample(VkFormat format)
+	{
+		VkFormatProperties Properties = {};
+		vkGetPhysicalDeviceFormatProperties(m_physicaldevice, format, &Properties);
+
+		VkFormatFeatureFlags Required = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+		return (Properties.optimalTilingFeatures & Required) == Required;
+	}
+
+	static void PostProcessBarrier(VkCommandBuffer commandbuffer, VkImage image, VkUint32 level, VkUint32 levelcount,
+		VkImageLayout oldlayout, VkImageLayout newlayout, VkAccessFlags srcaccess, VkAccessFlags dstaccess,
+		VkPipelineStageFlags srcstage, VkPipelineStageFlags dststage)
+	{
+		VkImageMemoryBarrier Barrier = {};
+		Barrier.sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		Barrier.srcAccessMask					= srcaccess;
+		Barrier.dstAccessMask					= dstaccess;
+		Barrier.oldLayout						= oldlayout;
+		Barrier.newLayout						= newlayout;
+		Barrier.srcQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		Barrier.dstQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		Barrier.image							= image;
+		Barrier.subresourceRange.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+		Barrier.subresourceRange.baseMipLevel	= level;
+		Barrier.subresourceRange.levelCount		= levelcount;
+		Barrier.subresourceRange.baseArrayLayer	= 0;
+		Barrier.subresourceRange.layerCount		= 1;
+
+		vkCmdPipelineBarrier(commandbuffer, srcstage, dststage, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+	}
+
+	/* Makes one bloom level's writes visible to the pass that reads it next*/
+	static void BloomLevelBarrier(VkCommandBuffer commandbuffer, VkImage image, VkUint32 level)
+	{
+		PostProcessBarrier(commandbuffer, image, level, 1, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+			VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	}
+
+	static VkUint32 GroupCount(DWord size)
+	{
+		return (size + POST_PROCESS_WORKGROUP_SIZE - 1) / POST_PROCESS_WORKGROUP_SIZE;
+	}
+
+	MetalPostProcess::~MetalPostProcess()
+	{
+		Destroy();
+	}
+
+	int MetalPostProcess::Create(VkUint32 width, VkUint32 height, VkFormat destinationformat, const MetalPostProcessShaderPaths& shaders,
+		VkFormat hdrformat, DWord bloomlevels)
+	{
+		if (width == 0 || height == 0 || !IsDestinationFormat(destinationformat))
+		{
+			WarningMessage("Vulkan Post Process WARNING", "Tried to create a %ux%u post process chain onto format %d", width, height, static_cast<int>(destinationformat));
+			return 1;
+		}
+
+		if (hdrformat != VK_FORMAT_R16G16B16A16_SFLOAT && (hdrformat != VK_FORMAT_B10G11R11_UFLOAT_PACK32 || !CanRenderAndSample(hdrformat)))
+		{
+			WarningMessage("Vulkan Post Process WARNING", "HDR format %d isn't supported as a render target here, using R16G16B16A16_SFLOAT", static_cast<int>(hdrformat));
+			hdrformat = VK_FORMAT_R16G16B16A16_SFLOAT;
+		}
+
+		extent = { width, height };
+		format = hdrformat;
+
+		/* Level 0 is half the target, every level halves again (rounding up) like the depth pyramid*/
+		DWord MaximumLevels = std::clamp<DWord>(bloomlevels, 1, POST_PROCESS_MAX_BLOOM_LEVELS);
+		DWord levelwidth = width, levelheight = height;
+		do
+		{
+			levelwidth = (levelwidth + 1) / 2;
+			levelheight = (levelheight + 1) / 2;
+			levelwidths.push_back(levelwidth);
+			levelheights.push_back(levelheight);
+		} while (levelwidths.size() < MaximumLevels && (levelwidth > 1 || levelheight > 1));
+
+		VkUint32 LevelCount = static_cast<VkUint32>(levelwidths.size());
+		VkFormat DepthFormat = FindDepthFormat();
+
+		VkAttachmentDescription ColorAttachment = {};
+		ColorAttachment.format			= format;
+		ColorAttachment.samples			= VK_SAMPLE_COUNT_1_BIT;
+		ColorAttachment.loadOp			= VK_ATTACHMENT_LOAD_OP_CLEAR;
+		ColorAttachment.storeOp			= VK_ATTACHMENT_STORE_OP_STORE;
+		ColorAttachment.stencilLoadOp	= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		ColorAttachment.stencilStoreOp	= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		ColorAttachment.initialLayout	= VK_IMAGE_LAYOUT_UNDEFINED;
+		ColorAttachment.finalLayout		= VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;	/* Straight into the compute passes*/
+
+		VkAttachmentDescription DepthAttachment = {};
+		DepthAttachment.format			= DepthFormat;
+		DepthAttachment.samples			= VK_SAMPLE_COUNT_1_BIT;
+		DepthAttachment.loadOp			= VK_ATTACHMENT_LOAD_OP_CLEAR;
+		DepthAttachment.storeOp			= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		DepthAttachment.stencilLoadOp	= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		DepthAttachment.stencilStoreOp	= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		DepthAttachment.initialLayout	= VK_IMAGE_LAYOUT_UNDEFINED;
+		DepthAttachment.finalLayout		= VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference ColorRef = {};
+		ColorRef.attachment	= 0;
+		ColorRef.layout		= VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference DepthRef = {};
+		DepthRef.attachment	= 1;
+		DepthRef.layout		= VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkSubpassDescription Subpass = {};
+		Subpass.pipelineBindPoint		= VK_PIPELINE_BIND_POINT_GRAPHICS;
+		Subpass.colorAttachmentCount	= 1;
+		Subpass.pColorAttachments		= &ColorRef;
+		Subpass.pDepthStencilAttachment	= &DepthRef;
+
+		/* In: this frame's target was last read by compute two frames ago. Out: the compute passes read what the subpass wrote*/
+		array<VkSubpassDependency, 2> Dependencies = {};
+		Dependencies[0].srcSubpass		= VK_SUBPASS_EXTERNAL;
+		Dependencies[0].dstSubpass		= 0;
+		Dependencies[0].srcStageMask	= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		Dependencies[0].dstStageMask	= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		Dependencies[0].srcAccessMask	= 0;
+		Dependencies[0].dstAccessMask	= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		Dependencies[1].srcSubpass		= 0;
+		Dependencies[1].dstSubpass		= VK_SUBPASS_EXTERNAL;
+		Dependencies[1].srcStageMask	= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		Dependencies[1].dstStageMask	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		Dependencies[1].srcAccessMask	= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		Dependencies[1].dstAccessMask	= VK_ACCESS_SHADER_READ_BIT;
+
+		array<VkAttachmentDescription, 2> Attachments = { ColorAttachment, DepthAttachment };
+		VkRenderPassCreateInfo RenderPassInfo = {};
+		RenderPassInfo.sType			= VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		RenderPassInfo.attachmentCount	= static_cast<VkUint32>(Attachments.size());
+		RenderPassInfo.pAttachments		= Attachments.data();
+		RenderPassInfo.subpassCount		= 1;
+		RenderPassInfo.pSubpasses		= &Subpass;
+		RenderPassInfo.dependencyCount	= static_cast<VkUint32>(Dependencies.size());
+		RenderPassInfo.pDependencies	= Dependencies.data();
+		VK_CHECK(vkCreateRenderPass(m_device, &RenderPassInfo, nullptr, &renderpass));
+
+		/* texelFetch only, the sampler just has to exist*/
+		VkSamplerCreateInfo SamplerInfo = {};
+		SamplerInfo.sType			= VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		SamplerInfo.magFilter		= VK_FILTER_NEAREST;
+		SamplerInfo.minFilter		= VK_FILTER_NEAREST;
+		SamplerInfo.mipmapMode		= VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		SamplerInfo.addressModeU	= VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		SamplerInfo.addressModeV	= VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		SamplerInfo.addressModeW	= VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		SamplerInfo.minLod			= 0.0f;
+		SamplerInfo.maxLod			= 0.0f;
+		VK_CHECK(vkCreateSampler(m_device, &SamplerInfo, nullptr, &sampler));
+
+		/* One layout for the three shaders: source, bloom (tonemap.comp only), destination*/
+		array<VkDescriptorSetLayoutBinding, 3> Bindings = {};
+		Bindings[0].binding			= 0;
+		Bindings[0].descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		Bindings[0].descriptorCount	= 1;
+		Bindings[0].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+		Bindings[1].binding			= 1;
+		Bindings[1].descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		Bindings[1].descriptorCount	= 1;
+		Bindings[1].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+		Bindings[2].binding			= 2;
+		Bindings[2].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		Bindings[2].descriptorCount	= 1;
+		Bindings[2].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+
+		VkDescriptorSetLayoutCreateInfo LayoutInfo = {};
+		LayoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		LayoutInfo.bindingCount	= static_cast<VkUint32>(Bindings.size());
+		LayoutInfo.pBindings	= Bindings.data();
+		VK_CHECK(vkCreateDescriptorSetLayout(m_device, &LayoutInfo, nullptr, &descriptorsetlayout));
+
+		/* Per frame: a downsample set per level, an upsample set per level but the last and the tonemap set.
+			Every set is allocated with the full layout, so each one takes both of its sampler bindings from the pool
+			even where binding 1 is never written
+		*/
+		VkUint32 FrameSetCount = LevelCount * 2;
+		VkUint32 SetCount = FrameSetCount * MAXIMUM_FRAMES_IN_FLIGHTS;
+
+		array<VkDescriptorPoolSize, 2> PoolSizes = {};
+		PoolSizes[0].type				= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		PoolSizes[0].descriptorCount	= FrameSetCount * 2 * MAXIMUM_FRAMES_IN_FLIGHTS;
+		PoolSizes[1].type				= VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		PoolSizes[1].descriptorCount	= SetCount;
+
+		VkDescriptorPoolCreateInfo PoolInfo = {};
+		PoolInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		PoolInfo.maxSets		= SetCount;
+		PoolInfo.poolSizeCount	= static_cast<VkUint32>(PoolSizes.size());
+		PoolInfo.pPoolSizes		= PoolSizes.data();
+		VK_CHECK(vkCreateDescriptorPool(m_device, &PoolInfo, nullptr, &descriptorpool));
+
+		vector<VkDescriptorSetLayout> SetLayouts(FrameSetCount, descriptorsetlayout);
+
+		VkDescriptorSetAllocateInfo SetAllocationInfo = {};
+		SetAllocationInfo.sType					= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		SetAllocationInfo.descriptorPool		= descriptorpool;
+		SetAllocationInfo.descriptorSetCount	= FrameSetCount;
+		SetAllocationInfo.pSetLayouts			= SetLayouts.data();
+
+		VkImageCreateInfo ImageInfo = {};
+		ImageInfo.sType			= VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		ImageInfo.imageType		= VK_IMAGE_TYPE_2D;
+		ImageInfo.arrayLayers	= 1;
+		ImageInfo.tiling		= VK_IMAGE_TILING_OPTIMAL;
+		ImageInfo.initialLayout	= VK_IMAGE_LAYOUT_UNDEFINED;
+		ImageInfo.samples		= VK_SAMPLE_COUNT_1_BIT;
+		ImageInfo.sharingMode	= VK_SHARING_MODE_EXCLUSIVE;
+
+		VkImageViewCreateInfo ViewInfo = {};
+		ViewInfo.sType								= VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		ViewInfo.viewType							= VK_IMAGE_VIEW_TYPE_2D;
+		ViewInfo.subresourceRange.baseMipLevel		= 0;
+		ViewInfo.subresourceRange.levelCount		= 1;
+		ViewInfo.subresourceRange.baseArrayLayer	= 0;
+		ViewInfo.subresourceRange.layerCount		= 1;
+
+		for (MetalPostProcessFrame& Frame : frames)
+		{
+			ImageInfo.extent	= { width, height, 1 };
+			ImageInfo.mipLevels	= 1;
+			ImageInfo.format	= format;
+			ImageInfo.usage		= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+			CreateImageWithInfo(ImageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, Frame.colorimage, Frame.colormemory);
+
+			ViewInfo.image							= Frame.colorimage;
+			ViewInfo.format							= format;
+			ViewInfo.subresourceRange.aspectMask	= VK_IMAGE_ASPECT_COLOR_BIT;
+			ViewInfo.subresourceRange.baseMipLevel	= 0;
+			VK_CHECK(vkCreateImageView(m_device, &ViewInfo, nullptr, &Frame.colorview));
+
+			ImageInfo.format	= DepthFormat;
+			ImageInfo.usage		= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+			CreateImageWithInfo(ImageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, Frame.depthimage, Frame.depthmemory);
+
+			ViewInfo.image							= Frame.depthimage;
+			ViewInfo.format							= DepthFormat;
+			ViewInfo.subresourceRange.aspectMask	= VK_IMAGE_ASPECT_DEPTH_BIT;
+			VK_CHECK(vkCreateImageView(m_device, &ViewInfo, nullptr, &Frame.depthview));
+
+			array<VkImageView, 2> Views = { Frame.colorview, Frame.depthview };
+			VkFramebufferCreateInfo FramebufferInfo = {};
+			FramebufferInfo.sType			= VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			FramebufferInfo.renderPass		= renderpass;
+			FramebufferInfo.attachmentCount	= static_cast<VkUint32>(Views.size());
+			FramebufferInfo.pAttachments	= Views.data();
+			FramebufferInfo.width			= width;
+			FramebufferInfo.height			= height;
+			FramebufferInfo.layers			= 1;
+			VK_CHECK(vkCreateFramebuffer(m_device, &FramebufferInfo, nullptr, &Frame.framebuffer));
+
+			/* Bloom stays R16G16B16A16_SFLOAT whatever the target is, rgba16f is a storage format every device has*/
+			ImageInfo.extent	= { levelwidths[0], levelheights[0], 1 };
+			ImageInfo.mipLevels	= LevelCount;
+			ImageInfo.format	= VK_FORMAT_R16G16B16A16_SFLOAT;
+			ImageInfo.usage		= VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+			CreateImageWithInfo(ImageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, Frame.bloomimage, Frame.bloommemory);
+
+			ViewInfo.image							= Frame.bloomimage;
+			ViewInfo.format							= VK_FORMAT_R16G16B16A16_SFLOAT;
+			ViewInfo.subresourceRange.aspectMask	= VK_IMAGE_ASPECT_COLOR_BIT;
+			Frame.bloomviews.assign(LevelCount, VK_NULL_HANDLE);
+			for (VkUint32 i = 0; i < LevelCount; i++)
+			{
+				ViewInfo.subresourceRange.baseMipLevel = i;
+				VK_CHECK(vkCreateImageView(m_device, &ViewInfo, nullptr, &Frame.bloomviews[i]));
+			}
+
+			ImageInfo.extent	= { width, height, 1 };
+			ImageInfo.mipLevels	= 1;
+			ImageInfo.format	= VK_FORMAT_R8G8B8A8_UNORM;
+			ImageInfo.usage		= VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			CreateImageWithInfo(ImageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, Frame.outputimage, Frame.outputmemory);
+
+			ViewInfo.image							= Frame.outputimage;
+			ViewInfo.format							= VK_FORMAT_R8G8B8A8_UNORM;
+			ViewInfo.subresourceRange.baseMipLevel	= 0;
+			VK_CHECK(vkCreateImageView(m_device, &ViewInfo, nullptr, &Frame.outputview));
+
+			vector<VkDescriptorSet> Sets(FrameSetCount, VK_NULL_HANDLE);
+			VK_CHECK(vkAllocateDescriptorSets(m_device, &SetAllocationInfo, Sets.data()));
+			Frame.downsamplesets.assign(Sets.begin(), Sets.begin() + LevelCount);
+			Frame.upsamplesets.assign(Sets.begin() + LevelCount, Sets.begin() + (LevelCount * 2 - 1));
+			Frame.tonemapset = Sets.back();
+
+			/* Sources and destinations never change, every set is written once here.
+				Binding 1 is only read by tonemap.comp and is left unwritten in the bloom sets.
+			*/
+			vector<VkDescriptorImageInfo> ImageInfos;
+			ImageInfos.reserve(static_cast<usize>(FrameSetCount) * 2 + 1);
+			vector<VkWriteDescriptorSet> Writes;
+			Writes.reserve(ImageInfos.capacity());
+
+			auto AddWrite = [&](VkDescriptorSet set, VkUint32 binding, VkImageView imageview, VkImageLayout layout)
+			{
+				bool Storage = binding == 2;
+				ImageInfos.push_back({ Storage ? VK_NULL_HANDLE : sampler, imageview, layout });
+
+				VkWriteDescriptorSet Write = {};
+				Write.sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				Write.dstSet			= set;
+				Write.dstBinding		= binding;
+				Write.descriptorCount	= 1;
+				Write.descriptorType	= Storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				Write.pImageInfo		= &ImageInfos.back();
+				Writes.push_back(Write);
+			};
+
+			for (VkUint32 i = 0; i < LevelCount; i++)
+			{
+				if (i == 0)
+				{
+					AddWrite(Frame.downsamplesets[i], 0, Frame.colorview, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				}
+				else
+				{
+					AddWrite(Frame.downsamplesets[i], 0, Frame.bloomviews[i - 1], VK_IMAGE_LAYOUT_GENERAL);
+				}
+				AddWrite(Frame.downsamplesets[i], 2, Frame.bloomviews[i], VK_IMAGE_LAYOUT_GENERAL);
+			}
+			for (VkUint32 i = 0; i + 1 < LevelCount; i++)
+			{
+				AddWrite(Frame.upsamplesets[i], 0, Frame.bloomviews[i + 1], VK_IMAGE_LAYOUT_GENERAL);
+				AddWrite(Frame.upsamplesets[i], 2, Frame.bloomviews[i], VK_IMAGE_LAYOUT_GENERAL);
+			}
+			AddWrite(Frame.tonemapset, 0, Frame.colorview, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			AddWrite(Frame.tonemapset, 1, Frame.bloomviews[0], VK_IMAGE_LAYOUT_GENERAL);
+			AddWrite(Frame.tonemapset, 2, Frame.outputview, VK_IMAGE_LAYOUT_GENERAL);
+
+			vkUpdateDescriptorSets(m_device, static_cast<VkUint32>(Writes.size()), Writes.data(), 0, nullptr);
+			MetalCounterAdd(METAL_COUNTER_DESCRIPTOR_WRITES, static_cast<long long>(Writes.size()));
+		}
+
+		VkPushConstantRange PushRange = {};
+		PushRange.stageFlags	= VK_SHADER_STAGE_COMPUTE_BIT;
+		PushRange.offset		= 0;
+		PushRange.size			= sizeof(MetalPostProcessConstants);
+
+		VkPipelineLayoutCreateInfo PipelineLayoutInfo = {};
+		PipelineLayoutInfo.sType					= VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		PipelineLayoutInfo.setLayoutCount			= 1;
+		PipelineLayoutInfo.pSetLayouts				= &descriptorsetlayout;
+		PipelineLayoutInfo.pushConstantRangeCount	= 1;
+		PipelineLayoutInfo.pPushConstantRanges		= &PushRange;
+		VK_CHECK(vkCreatePipelineLayout(m_device, &PipelineLayoutInfo, nullptr, &pipelinelayout));
+
+		if (CreateComputePipeline(shaders.downsample, pipelinelayout, downsamplepipeline) != 0 ||
+			CreateComputePipeline(shaders.upsample, pipelinelayout, upsamplepipeline) != 0 ||
+			CreateComputePipeline(shaders.tonemap, pipelinelayout, tonemappipeline) != 0)
+		{
+			return 1;
+		}
+
+		return 0;
+	}
+
+	void MetalPostProcess::Destroy()
+	{
+		if (m_device == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		for (VkPipeline Pipeline : { downsamplepipeline, upsamplepipeline, tonemappipeline })
+		{
+			if (Pipeline != VK_NULL_HANDLE)			vkDestroyPipeline(m_device, Pipeline, nullptr);
+		}
+		if (pipelinelayout != VK_NULL_HANDLE)		vkDestroyPipelineLayout(m_device, pipelinelayout, nullptr);
+		if (descriptorpool != VK_NULL_HANDLE)		vkDestroyDescriptorPool(m_device, descriptorpool, nullptr);
+		if (descriptorsetlayout != VK_NULL_HANDLE)	vkDestroyDescriptorSetLayout(m_device, descriptorsetlayout, nullptr);
+		if (sampler != VK_NULL_HANDLE)				vkDestroySampler(m_device, sampler, nullptr);
+
+		for (MetalPostProcessFrame& Frame : frames)
+		{
+			if (Frame.framebuffer != VK_NULL_HANDLE)	vkDestroyFramebuffer(m_device, Frame.framebuffer, nullptr);
+			if (Frame.colorview != VK_NULL_HANDLE)		vkDestroyImageView(m_device, Frame.colorview, nullptr);
+			if (Frame.colorimage != VK_NULL_HANDLE)		vkDestroyImage(m_device, Frame.colorimage, nullptr);
+			if (Frame.colormemory != VK_NULL_HANDLE)	vkFreeMemory(m_device, Frame.colormemory, nullptr);
+			if (Frame.depthview != VK_NULL_HANDLE)		vkDestroyImageView(m_device, Frame.depthview, nullptr);
+			if (Frame.depthimage != VK_NULL_HANDLE)		vkDestroyImage(m_device, Frame.depthimage, nullptr);
+			if (Frame.depthmemory != VK_NULL_HANDLE)	vkFreeMemory(m_device, Frame.depthmemory, nullptr);
+			for (VkImageView LevelView : Frame.bloomviews)
+			{
+				if (LevelView != VK_NULL_HANDLE)		vkDestroyImageView(m_device, LevelView, nullptr);
+			}
+			if (Frame.bloomimage != VK_NULL_HANDLE)		vkDestroyImage(m_device, Frame.bloomimage, nullptr);
+			if (Frame.bloommemory != VK_NULL_HANDLE)	vkFreeMemory(m_device, Frame.bloommemory, nullptr);
+			if (Frame.outputview != VK_NULL_HANDLE)		vkDestroyImageView(m_device, Frame.outputview, nullptr);
+			if (Frame.outputimage != VK_NULL_HANDLE)	vkDestroyImage(m_device, Frame.outputimage, nullptr);
+			if (Frame.outputmemory != VK_NULL_HANDLE)	vkFreeMemory(m_device, Frame.outputmemory, nullptr);
+			Frame = MetalPostProcessFrame();
+		}
+
+		if (renderpass != VK_NULL_HANDLE)			vkDestroyRenderPass(m_device, renderpass, nullptr);
+
+		downsamplepipeline = VK_NULL_HANDLE;
+		upsamplepipeline = VK_NULL_HANDLE;
+		tonemappipeline = VK_NULL_HANDLE;
+		pipelinelayout = VK_NULL_HANDLE;
+		descriptorpool = VK_NULL_HANDLE;
+		descriptorsetlayout = VK_NULL_HANDLE;
+		sampler = VK_NULL_HANDLE;
+		renderpass = VK_NULL_HANDLE;
+		levelwidths.clear();
+		levelheights.clear();
+		extent = { 0, 0 };
+		format = VK_FORMAT_UNDEFINED;
+	}
+
+	void MetalPostProcess::BeginRenderPass(VkCommandBuffer commandbuffer, const float clearcolor[4])
+	{
+		MetalPostProcessFrame& Frame = frames[CurrentFrame];
+
+		array<VkClearValue, 2> ClearValues = {};
+		ClearValues[0].color		= { { clearcolor[0], clearcolor[1], clearcolor[2], clearcolor[3] } };
+		ClearValues[1].depthStencil	= { 1.0f, 0 };
+
+		VkRenderPassBeginInfo RenderPassInfo = {};
+		RenderPassInfo.sType				= VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		RenderPassInfo.renderPass			= renderpass;
+		RenderPassInfo.framebuffer			= Frame.framebuffer;
+		RenderPassInfo.renderArea.offset	= { 0, 0 };
+		RenderPassInfo.renderArea.extent	= extent;
+		RenderPassInfo.clearValueCount		= static_cast<VkUint32>(ClearValues.size());
+		RenderPassInfo.pClearValues			= ClearValues.data();
+		vkCmdBeginRenderPass(commandbuffer, &RenderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	}
+
+	void MetalPostProcess::EndRenderPass(VkCommandBuffer commandbuffer)
+	{
+		/* The render pass leaves the target in SHADER_READ_ONLY_OPTIMAL for the compute passes*/
+		vkCmdEndRenderPass(commandbuffer);
+	}
+
+	void MetalPostProcess::Record(VkCommandBuffer commandbuffer, VkImage destination, VkImageLayout finallayout)
+	{
+		if (tonemappipeline == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		METAL_GPU_ZONE(commandbuffer, "Post Process");
+
+		MetalPostProcessFrame& Frame = frames[CurrentFrame];
+		VkUint32 LevelCount = static_cast<VkUint32>(levelwidths.size());
+
+		MetalPostProcessConstants Constants = {};
+		Constants.threshold	= settings.bloomthreshold;
+		Constants.knee		= std::max(settings.bloomknee, 0.0001f);
+		Constants.intensity	= settings.bloomintensity;
+		Constants.exposure	= settings.exposure;
+
+		/* Every level is rewritten from scratch each frame, so the old contents can go*/
+		PostProcessBarrier(commandbuffer, Frame.bloomimage, 0, LevelCount, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+			0, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		/* Down the chain, the first pass thresholds the target into half resolution*/
+		vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, downsamplepipeline);
+		MetalCounterAdd(METAL_COUNTER_PIPELINE_BINDS, 1);
+
+		for (VkUint32 Level = 0; Level < LevelCount; Level++)
+		{
+			Constants.sourcesize[0]			= static_cast<int>(Level == 0 ? extent.width : levelwidths[Level - 1]);
+			Constants.sourcesize[1]			= static_cast<int>(Level == 0 ? extent.height : levelheights[Level - 1]);
+			Constants.destinationsize[0]	= static_cast<int>(levelwidths[Level]);
+			Constants.destinationsize[1]	= static_cast<int>(levelheights[Level]);
+			Constants.mode					= Level == 0 ? 1 : 0;
+
+			vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelinelayout, 0, 1, &Frame.downsamplesets[Level], 0, nullptr);
+			vkCmdPushConstants(commandbuffer, pipelinelayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MetalPostProcessConstants), &Constants);
+			vkCmdDispatch(commandbuffer, GroupCount(levelwidths[Level]), GroupCount(levelheights[Level]), 1);
+
+			BloomLevelBarrier(commandbuffer, Frame.bloomimage, Level);
+		}
+
+		/* Back up, every level gets the blurred sum of the ones below it added*/
+		if (LevelCount > 1)
+		{
+			vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, upsamplepipeline);
+			MetalCounterAdd(METAL_COUNTER_PIPELINE_BINDS, 1);
+
+			Constants.mode = 0;
+			for (VkUint32 Level = LevelCount - 1; Level-- > 0;)
+			{
+				Constants.sourcesize[0]			= static_cast<int>(levelwidths[Level + 1]);
+				Constants.sourcesize[1]			= static_cast<int>(levelheights[Level + 1]);
+				Constants.destinationsize[0]	= static_cast<int>(levelwidths[Level]);
+				Constants.destinationsize[1]	= static_cast<int>(levelheights[Level]);
+
+				vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelinelayout, 0, 1, &Frame.upsamplesets[Level], 0, nullptr);
+				vkCmdPushConstants(commandbuffer, pipelinelayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MetalPostProcessConstants), &Constants);
+				vkCmdDispatch(commandbuffer, GroupCount(levelwidths[Level]), GroupCount(levelheights[Level]), 1);
+
+				BloomLevelBarrier(commandbuffer, Frame.bloomimage, Level);
+			}
+		}
+
+		/* The last blit out of the output image is done once this frame's fence was waited on, its contents can go too*/
+		PostProcessBarrier(commandbuffer, Frame.outputimage, 0, 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+			0, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, tonemappipeline);
+		MetalCounterAdd(METAL_COUNTER_PIPELINE_BINDS, 1);
+
+		Constants.sourcesize[0]			= static_cast<int>(levelwidths[0]);
+		Constants.sourcesize[1]			= static_cast<int>(levelheights[0]);
+		Constants.destinationsize[0]	= static_cast<int>(extent.width);
+		Constants.destinationsize[1]	= static_cast<int>(extent.height);
+
+		vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelinelayout, 0, 1, &Frame.tonemapset, 0, nullptr);
+		vkCmdPushConstants(commandbuffer, pipelinelayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MetalPostProcessConstants), &Constants);
+		vkCmdDispatch(commandbuffer, GroupCount(extent.width), GroupCount(extent.height), 1);
+
+		PostProcessBarrier(commandbuffer, Frame.outputimage, 0, 1, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		/* Swapchain images are waited on at COLOR_ATTACHMENT_OUTPUT (see SubmitCommandBuffers),
+			starting from that stage chains the blit after the acquire like a render pass would be
+		*/
+		PostProcessBarrier(commandbuffer, destination, 0, 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		/* Same size, so the blit is a copy that also swizzles RGBA into the destination's order*/
+		VkImageBlit Region = {};
+		Region.srcSubresource.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+		Region.srcSubresource.mipLevel			= 0;
+		Region.srcSubresource.baseArrayLayer	= 0;
+		Region.srcSubresource.layerCount		= 1;
+		Region.srcOffsets[0]					= { 0, 0, 0 };
+		Region.srcOffsets[1]					= { static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height), 1 };
+		Region.dstSubresource					= Region.srcSubresource;
+		Region.dstOffsets[0]					= Region.srcOffsets[0];
+		Region.dstOffsets[1]					= Region.srcOffsets[1];
+		vkCmdBlitImage(commandbuffer, Frame.outputimage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &Region, VK_FILTER_NEAREST);
+
+		bool Present = finallayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		PostProcessBarrier(commandbuffer, destination, 0, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, finallayout,
+			VK_ACCESS_TRANSFER_WRITE_BIT, Present ? 0 : VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, Present ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+	}
+}
@@ -0,0 +1,239 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine GPU profiler (timestamp queries fed into the frame profiler's GPU track)
+// ------------------------------------------------------
+
+#include "headers/MVulkanProfiler.hpp"
+#include "headers/MError.h"
+
+using engine::profiler::ProfilerTicks;
+using engine::profiler::ProfilerTicksPerSecond;
+using engine::profiler::ProfilerRecordGpu;
+
+namespace engine::vulkan
+{
+	/* Per frame in flight: the frame's begin and end, then a begin/end pair per zone*/
+	static constexpr DWord GPU_QUERIES_PER_FRAME = 2 + GPU_PROFILER_ZONES * 2;
+
+	struct MetalGpuFrame
+	{
+		const char*		names[GPU_PROFILER_ZONES] = {};
+		DWord			zonecount	= 0;
+		bool			submitted	= false;
+		VkCommandBuffer	begin		= VK_NULL_HANDLE;	/* Resets the frame's queries and writes its first timestamp*/
+		VkCommandBuffer	end			= VK_NULL_HANDLE;	/* Writes its last timestamp*/
+	};
+
+	static VkQueryPool										m_querypool = VK_NULL_HANDLE;
+	static array<MetalGpuFrame, MAXIMUM_FRAMES_IN_FLIGHTS>	m_gpuframes;
+	static QWord											m_timestampmask = 0;
+	static double											m_ticksperquery = 0.0;	/* CPU ticks per GPU timestamp tick*/
+	static QWord											m_calibrationgpu = 0;
+	static QWord											m_calibrationcpu = 0;
+
+	/* Moves a GPU timestamp onto the CPU clock, relative to the calibration point so wrapping and
+		huge values don't eat the double's precision
+	*/
+	static QWord GpuToCpuTicks(QWord timestamp)
+	{
+		ssize delta = static_cast<ssize>((timestamp - m_calibrationgpu) & m_timestampmask);
+		if (m_timestampmask != ~0ull && delta > static_cast<ssize>(m_timestampmask >> 1))
+		{
+			delta -= static_cast<ssize>(m_timestampmask) + 1;
+		}
+		return m_calibrationcpu + static_cast<QWord>(static_cast<ssize>(static_cast<double>(delta) * m_ticksperquery));
+	}
+
+	int GpuProfilerCreate(void)
+	{
+		MetalVulkanQueueFamilyIndices Indices = FindPhysicalQueueFamilies();
+
+		VkUint32 FamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(m_physicaldevice, &FamilyCount, nullptr);
+		vector<VkQueueFamilyProperties> Families(FamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(m_physicaldevice, &FamilyCount, Families.data());
+
+		VkUint32 ValidBits = Indices.graphics_family < FamilyCount ? Families[Indices.graphics_family].timestampValidBits : 0;
+		if (ValidBits == 0 || m_properties.limits.timestampPeriod <= 0.0f)
+		{
+			WarningMessage("Vulkan Profiler WARNING", "The graphics queue does not support timestamps, GPU zones are disabled");
+			return 1;
+		}
+
+		m_timestampmask = ValidBits >= 64 ? ~0ull : (1ull << ValidBits) - 1;
+		m_ticksperquery = static_cast<double>(m_properties.limits.timestampPeriod) * 1e-9 * ProfilerTicksPerSecond();
+
+		VkQueryPoolCreateInfo PoolInfo = {};
+		PoolInfo.sType		= VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		PoolInfo.queryType	= VK_QUERY_TYPE_TIMESTAMP;
+		PoolInfo.queryCount	= GPU_QUERIES_PER_FRAME * MAXIMUM_FRAMES_IN_FLIGHTS;
+		VK_CHECK(vkCreateQueryPool(m_device, &PoolInfo, nullptr, &m_querypool));
+
+		/* Take one timestamp, wait for it and call that moment the same time on both clocks.
+			The CPU side is late by however long the wait took to return, a few microseconds.
+		*/
+		VkCommandBuffer CommandBuffer = BeginSingleTimeCommands();
+		vkCmdResetQueryPool(CommandBuffer, m_querypool, 0, 1);
+		vkCmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_querypool, 0);
+		EndSingleTimeCommands(CommandBuffer);
+		m_calibrationcpu = ProfilerTicks();
+
+		QWord Timestamp = 0;
+		VK_CHECK(vkGetQueryPoolResults(m_device, m_querypool, 0, 1, sizeof(Timestamp), &Timestamp, sizeof(Timestamp),
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+		m_calibrationgpu = Timestamp;
+
+		/* The bracketing command buffers never change, record them once*/
+		VkCommandBufferAllocateInfo AllocationInfo = {};
+		AllocationInfo.sType				= VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		AllocationInfo.level				= VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		AllocationInfo.commandPool			= m_commandpool;
+		AllocationInfo.commandBufferCount	= 1;
+
+		VkCommandBufferBeginInfo BeginInfo = {};
+		BeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+		for (DWord i = 0; i < MAXIMUM_FRAMES_IN_FLIGHTS; i++)
+		{
+			MetalGpuFrame& Frame = m_gpuframes[i];
+			Frame = MetalGpuFrame();
+			DWord Base = i * GPU_QUERIES_PER_FRAME;
+
+			VK_CHECK(vkAllocateCommandBuffers(m_device, &AllocationInfo, &Frame.begin));
+			VK_CHECK(vkBeginCommandBuffer(Frame.begin, &BeginInfo));
+			vkCmdResetQueryPool(Frame.begin, m_querypool, Base, GPU_QUERIES_PER_FRAME);
+			vkCmdWriteTimestamp(Frame.begin, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_querypool, Base);
+			VK_CHECK(vkEndCommandBuffer(Frame.begin));
+
+			VK_CHECK(vkAllocateCommandBuffers(m_device, &AllocationInfo, &Frame.end));
+			VK_CHECK(vkBeginCommandBuffer(Frame.end, &BeginInfo));
+			vkCmdWriteTimestamp(Frame.end, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_querypool, Base + 1);
+			VK_CHECK(vkEndCommandBuffer(Frame.end));
+		}
+
+		return 0;
+	}
+
+	void GpuProfilerDestroy(void)
+	{
+		for (MetalGpuFrame& Frame : m_gpuframes)
+		{
+			if (Frame.begin != VK_NULL_HANDLE)
+			{
+				vkFreeCommandBuffers(m_device, m_commandpool, 1, &Frame.begin);
+			}
+			if (Frame.end != VK_NULL_HANDLE)
+			{
+				vkFreeCommandBuffers(m_device, m_commandpool, 1, &Frame.end);
+			}
+			Frame = MetalGpuFrame();
+		}
+
+		if (m_querypool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(m_device, m_querypool, nullptr);
+			m_querypool = VK_NULL_HANDLE;
+		}
+	}
+
+	void GpuProfilerCollect(void)
+	{
+		if (m_querypool == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		MetalGpuFrame& Frame = m_gpuframes[CurrentFrame];
+		if (Frame.submitted)
+		{
+			/* The fence was waited on so everything is written, but a zone whose command buffer was
+				never submitted stays unavailable and must not be waited for
+			*/
+			struct Result
+			{
+				QWord value;
+				QWord available;
+			};
+
+			Result Results[GPU_QUERIES_PER_FRAME];
+			DWord Count = 2 + Frame.zonecount * 2;
+			VkResult Status = vkGetQueryPoolResults(m_device, m_querypool, static_cast<VkUint32>(CurrentFrame * GPU_QUERIES_PER_FRAME), Count,
+				sizeof(Result) * Count, Results, sizeof(Result), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+			if (Status == VK_SUCCESS || Status == VK_NOT_READY)
+			{
+				if (Results[0].available != 0 && Results[1].available != 0)
+				{
+					ProfilerRecordGpu("GPU Frame", GpuToCpuTicks(Results[0].value), GpuToCpuTicks(Results[1].value));
+				}
+
+				for (DWord i = 0; i < Frame.zonecount; i++)
+				{
+					const Result& Begin = Results[2 + i * 2];
+					const Result& End = Results[3 + i * 2];
+					if (Begin.available != 0 && End.available != 0)
+					{
+						ProfilerRecordGpu(Frame.names[i], GpuToCpuTicks(Begin.value), GpuToCpuTicks(End.value));
+					}
+				}
+			}
+		}
+
+		Frame.zonecount = 0;
+		Frame.submitted = false;
+	}
+
+	VkUint32 GpuProfilerWrapSubmit(const VkCommandBuffer* buffers, VkUint32 count, VkCommandBuffer* output)
+	{
+		if (m_querypool == VK_NULL_HANDLE)
+		{
+			for (VkUint32 i = 0; i < count; i++)
+			{
+				output[i] = buffers[i];
+			}
+			return count;
+		}
+
+		MetalGpuFrame& Frame = m_gpuframes[CurrentFrame];
+		Frame.submitted = true;
+
+		output[0] = Frame.begin;
+		for (VkUint32 i = 0; i < count; i++)
+		{
+			output[i + 1] = buffers[i];
+		}
+		output[count + 1] = Frame.end;
+		return count + 2;
+	}
+
+	DWord GpuZoneBegin(VkCommandBuffer commandbuffer, const char* name)
+	{
+		MetalGpuFrame& Frame = m_gpuframes[CurrentFrame];
+		if (m_querypool == VK_NULL_HANDLE || Frame.zonecount >= GPU_PROFILER_ZONES)
+		{
+			return GPU_PROFILER_INVALID;
+		}
+
+		DWord Zone = Frame.zonecount++;
+		Frame.names[Zone] = name;
+		vkCmdWriteTimestamp(commandbuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_querypool,
+			static_cast<VkUint32>(CurrentFrame * GPU_QUERIES_PER_FRAME + 2 + Zone * 2));
+		return Zone;
+	}
+
+	void GpuZoneEnd(VkCommandBuffer commandbuffer, DWord zone)
+	{
+		if (zone == GPU_PROFILER_INVALID)
+		{
+			return;
+		}
+
+		vkCmdWriteTimestamp(commandbuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_querypool,
+			static_cast<VkUint32>(CurrentFrame * GPU_QUERIES_PER_FRAME + 3 + zone * 2));
+	}
+}
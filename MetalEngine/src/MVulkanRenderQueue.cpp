@@ -0,0 +1,156 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine render queue (64-bit draw sort keys, state change minimizing submission)
+// ------------------------------------------------------
+
+#include "headers/MVulkanRenderQueue.hpp"
+#include "headers/MVulkanProfiler.hpp"
+#include "headers/MRadixSort.hpp"
+#include "headers/MProfiler.hpp"
+#include "headers/MCounters.h"
+
+namespace engine::vulkan
+{
+	void MetalRenderQueue::Reserve(DWord count)
+	{
+		items.reserve(count);
+		keys.reserve(count);
+		order.reserve(count);
+		scratchkeys.reserve(count);
+		scratchorder.reserve(count);
+	}
+
+	void MetalRenderQueue::Clear()
+	{
+		items.clear();
+		keys.clear();
+		order.clear();
+		sorted = false;
+	}
+
+	void MetalRenderQueue::Push(QWord key, const MetalDrawItem& item)
+	{
+		order.push_back(static_cast<DWord>(items.size()));
+		items.push_back(item);
+		keys.push_back(key);
+		sorted = false;
+	}
+
+	void MetalRenderQueue::Sort()
+	{
+		METAL_ZONE("Render Queue Sort");
+
+		DWord Count = static_cast<DWord>(keys.size());
+		scratchkeys.resize(Count);
+		scratchorder.resize(Count);
+		engine::jobs::RadixSort(keys.data(), order.data(), Count, scratchkeys.data(), scratchorder.data());
+		sorted = true;
+	}
+
+	void MetalRenderQueue::Submit(VkCommandBuffer commandbuffer)
+	{
+		if (!sorted)
+		{
+			Sort();
+		}
+
+		METAL_GPU_ZONE(commandbuffer, "Render Queue");
+
+		static const unsigned int PipelineSkips = MetalCounterRegister("pipeline_binds_skipped", METAL_COUNTER_KIND_FRAME);
+		static const unsigned int DescriptorSkips = MetalCounterRegister("descriptor_binds_skipped", METAL_COUNTER_KIND_FRAME);
+		static const unsigned int VertexSkips = MetalCounterRegister("vertex_binds_skipped", METAL_COUNTER_KIND_FRAME);
+
+		stats = {};
+
+		/* Nothing is bound when a command buffer starts, so the first draw binds everything it uses*/
+		VkPipeline			BoundPipeline		= VK_NULL_HANDLE;
+		VkPipelineLayout	BoundLayout			= VK_NULL_HANDLE;
+		VkDescriptorSet		BoundSet			= VK_NULL_HANDLE;
+		VkBuffer			BoundVertexBuffer	= VK_NULL_HANDLE;
+		VkDeviceSize		BoundVertexOffset	= 0;
+		VkBuffer			BoundIndexBuffer	= VK_NULL_HANDLE;
+		VkDeviceSize		BoundIndexOffset	= 0;
+		VkIndexType			BoundIndexType		= VK_INDEX_TYPE_UINT16;
+
+		for (DWord Index : order)
+		{
+			const MetalDrawItem& Item = items[Index];
+
+			if (Item.pipeline != BoundPipeline)
+			{
+				vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Item.pipeline);
+				BoundPipeline = Item.pipeline;
+				stats.pipelinebinds++;
+			}
+			else
+			{
+				stats.pipelineskips++;
+			}
+
+			/* A set bound through an incompatible layout is disturbed, so a new layout always rebinds*/
+			if (Item.descriptorset != VK_NULL_HANDLE)
+			{
+				if (Item.descriptorset != BoundSet || Item.layout != BoundLayout)
+				{
+					vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Item.layout, 0, 1, &Item.descriptorset, 0, nullptr);
+					BoundSet = Item.descriptorset;
+					BoundLayout = Item.layout;
+					stats.descriptorbinds++;
+				}
+				else
+				{
+					stats.descriptorskips++;
+				}
+			}
+
+			if (Item.vertexbuffer != VK_NULL_HANDLE)
+			{
+				if (Item.vertexbuffer != BoundVertexBuffer || Item.vertexoffset != BoundVertexOffset)
+				{
+					vkCmdBindVertexBuffers(commandbuffer, 0, 1, &Item.vertexbuffer, &Item.vertexoffset);
+					BoundVertexBuffer = Item.vertexbuffer;
+					BoundVertexOffset = Item.vertexoffset;
+					stats.vertexbinds++;
+				}
+				else
+				{
+					stats.vertexskips++;
+				}
+			}
+
+			if (Item.indexbuffer != VK_NULL_HANDLE)
+			{
+				if (Item.indexbuffer != BoundIndexBuffer || Item.indexoffset != BoundIndexOffset || Item.indextype != BoundIndexType)
+				{
+					vkCmdBindIndexBuffer(commandbuffer, Item.indexbuffer, Item.indexoffset, Item.indextype);
+					BoundIndexBuffer = Item.indexbuffer;
+					BoundIndexOffset = Item.indexoffset;
+					BoundIndexType = Item.indextype;
+					stats.indexbinds++;
+				}
+				else
+				{
+					stats.indexskips++;
+				}
+
+				vkCmdDrawIndexed(commandbuffer, Item.count, Item.instancecount, Item.first, Item.vertexbase, Item.firstinstance);
+			}
+			else
+			{
+				vkCmdDraw(commandbuffer, Item.count, Item.instancecount, Item.first, Item.firstinstance);
+			}
+			stats.draws++;
+		}
+
+		MetalCounterAdd(METAL_COUNTER_DRAW_CALLS, stats.draws);
+		MetalCounterAdd(METAL_COUNTER_PIPELINE_BINDS, stats.pipelinebinds);
+		MetalCounterAdd(PipelineSkips, stats.pipelineskips);
+		MetalCounterAdd(DescriptorSkips, stats.descriptorskips);
+		MetalCounterAdd(VertexSkips, static_cast<long long>(stats.vertexskips) + stats.indexskips);
+	}
+}
@@ -9,8 +9,13 @@
 // ------------------------------------------------------
 
 #include "headers/MVulkanRenderer.hpp"
+#include "headers/MVulkanPostProcess.hpp"
+#include "headers/MVulkanProfiler.hpp"
+#include "headers/MCounters.h"
 #include "headers/MError.h"
 
+#include <chrono>
+
 namespace engine::vulkan
 {
 	static bool IsExtensionAvailable(const vector<VkExtensionProperties>& properties, const char* extension)
@@ -30,6 +35,15 @@ namespace engine::vulkan
 	{
 		MetalVulkanQueueFamilyIndices indices = FindQueueFamiles(device);
 
+		VkPhysicalDeviceFeatures features;
+		vkGetPhysicalDeviceFeatures(device, &features);
+
+		/* Headless runs never present, no swapchain support needed*/
+		if (m_headless)
+		{
+			return indices.IsComplete() && features.samplerAnisotropy;
+		}
+
 		bool extensions_supported = CheckDeviceExtensionsSupport(device);
 
 		bool swapchain_adequate = false;
@@ -39,9 +53,6 @@ namespace engine::vulkan
 			swapchain_adequate = !swapchain_support.formats.empty() && !swapchain_support.present_modes.empty();
 		}
 
-		VkPhysicalDeviceFeatures features;
-		vkGetPhysicalDeviceFeatures(device, &features);
-
 		return indices.IsComplete() && extensions_supported && swapchain_adequate && features.samplerAnisotropy;
 	}
 
@@ -65,7 +76,15 @@ namespace engine::vulkan
 			}
 
 			VkBool32 presentsupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentsupport);
+			if (m_headless)
+			{
+				/* There is no surface, the graphics queue stands in for the present one*/
+				presentsupport = (queuefamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) ? VK_TRUE : VK_FALSE;
+			}
+			else
+			{
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentsupport);
+			}
 			if (queuefamily.queueCount > 0 && presentsupport)
 			{
 				indices.present_family = i;
@@ -130,6 +149,10 @@ namespace engine::vulkan
 
 	static void VulkanRendererShutdown(void)
 	{
+#if defined(METAL_PROFILE)
+		GpuProfilerDestroy();
+#endif
+
 		/*Free memory*/
 		vkFreeMemory(m_device, m_devicememory, nullptr);
 		m_devicememory = VK_NULL_HANDLE;
@@ -150,6 +173,8 @@ namespace engine::vulkan
 
 		/*Reserving a chunk of GPU memory*/
 		VK_CHECK(vkAllocateMemory(m_device, &mallocinfo, nullptr, &m_devicememory));
+		MetalCounterAdd(METAL_COUNTER_DEVICE_ALLOCATIONS, 1);
+		MetalCounterAdd(METAL_COUNTER_DEVICE_BYTES, static_cast<long long>(m_size));
 
 		/*Checking if the device's memory hasn't been allocated, if so we have an error*/
 		if (m_devicememory == VK_NULL_HANDLE)
@@ -252,16 +277,61 @@ namespace engine::vulkan
 			queue_create_information.push_back(queue_creation_info);
 		}
 
+		/* Ask what the GPU can do before turning optional features on*/
+		VkPhysicalDeviceVulkan12Features supported_features12 = {};
+		supported_features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+		VkPhysicalDeviceFeatures2 supported_features = {};
+		supported_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		supported_features.pNext = &supported_features12;
+		vkGetPhysicalDeviceFeatures2(m_physicaldevice, &supported_features);
+
 		VkPhysicalDeviceFeatures device_features = {};
 		device_features.samplerAnisotropy = VK_TRUE;
+		device_features.multiDrawIndirect = supported_features.features.multiDrawIndirect;
+		m_multidrawindirect_supported = device_features.multiDrawIndirect;
+		device_features.textureCompressionBC = supported_features.features.textureCompressionBC;
+		m_texturecompressionbc_supported = device_features.textureCompressionBC;
+
+		/* GPU-driven rendering wants the draw count to come from a buffer*/
+		VkPhysicalDeviceVulkan12Features device_features12 = {};
+		device_features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		device_features12.drawIndirectCount = supported_features12.drawIndirectCount;
+		m_drawindirectcount_supported = device_features12.drawIndirectCount && device_features.multiDrawIndirect;
+
+		/* Bindless materials need arrays that can be updated while a frame using them is in flight*/
+		device_features12.runtimeDescriptorArray = supported_features12.runtimeDescriptorArray;
+		device_features12.descriptorBindingPartiallyBound = supported_features12.descriptorBindingPartiallyBound;
+		device_features12.descriptorBindingUpdateUnusedWhilePending = supported_features12.descriptorBindingUpdateUnusedWhilePending;
+		device_features12.descriptorBindingSampledImageUpdateAfterBind = supported_features12.descriptorBindingSampledImageUpdateAfterBind;
+		device_features12.descriptorBindingStorageBufferUpdateAfterBind = supported_features12.descriptorBindingStorageBufferUpdateAfterBind;
+		device_features12.shaderSampledImageArrayNonUniformIndexing = supported_features12.shaderSampledImageArrayNonUniformIndexing;
+		m_descriptorindexing_supported = device_features12.runtimeDescriptorArray && device_features12.descriptorBindingPartiallyBound &&
+			device_features12.descriptorBindingUpdateUnusedWhilePending && device_features12.descriptorBindingSampledImageUpdateAfterBind &&
+			device_features12.descriptorBindingStorageBufferUpdateAfterBind;
+
+		/* The memory budget only feeds the heap counters, fine to go without*/
+		VkUint32 available_extension_count = 0;
+		vkEnumerateDeviceExtensionProperties(m_physicaldevice, nullptr, &available_extension_count, nullptr);
+		vector<VkExtensionProperties> available_extensions(available_extension_count);
+		vkEnumerateDeviceExtensionProperties(m_physicaldevice, nullptr, &available_extension_count, available_extensions.data());
+
+		/* Headless devices have nothing to present to, software ICDs may not even have VK_KHR_swapchain*/
+		vector<const char*> device_extensions = m_headless ? vector<const char*>() : m_deviceextension;
+		m_memorybudget_supported = IsExtensionAvailable(available_extensions, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		if (m_memorybudget_supported)
+		{
+			device_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		}
 
 		VkDeviceCreateInfo device_creation_info = {};
 		device_creation_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		device_creation_info.pNext = &device_features12;
 		device_creation_info.queueCreateInfoCount = static_cast<VkUint32>(queue_create_information.size());
 		device_creation_info.pQueueCreateInfos = queue_create_information.data();
 		device_creation_info.pEnabledFeatures = &device_features;
-		device_creation_info.enabledExtensionCount = static_cast<VkUint32>(m_deviceextension.size());
-		device_creation_info.ppEnabledExtensionNames = m_deviceextension.data();
+		device_creation_info.enabledExtensionCount = static_cast<VkUint32>(device_extensions.size());
+		device_creation_info.ppEnabledExtensionNames = device_extensions.data();
 
 		VK_CHECK(vkCreateDevice(m_physicaldevice, &device_creation_info, nullptr, &m_device));
 
@@ -277,6 +347,50 @@ namespace engine::vulkan
 		poolinfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
 		VK_CHECK(vkCreateCommandPool(m_device, &poolinfo, nullptr, &m_commandpool));
+
+#if defined(METAL_PROFILE)
+		/* Not fatal, the frame simply has no GPU track without timestamps*/
+		GpuProfilerCreate();
+#endif
+
+		return 0;
+	}
+
+	int VulkanSetupHeadless(void)
+	{
+		m_headless = true;
+
+		/* No surface extensions, VulkanSetupRenderer adds what else the instance can use*/
+		if (VulkanSetupRenderer({}) != 0)
+		{
+			m_headless = false;
+			return 1;
+		}
+
+		fmt::print("ENGINE: Vulkan running headless\n");
+		return 0;
+	}
+
+	void VulkanShutdownHeadless(void)
+	{
+		if (m_device == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		vkDeviceWaitIdle(m_device);
+		VulkanRendererShutdown();
+
+		vkDestroyCommandPool(m_device, m_commandpool, nullptr);
+		m_commandpool = VK_NULL_HANDLE;
+
+		vkDestroyDevice(m_device, nullptr);
+		m_device = VK_NULL_HANDLE;
+
+		vkDestroyInstance(m_instance, m_allocator);
+		m_instance = VK_NULL_HANDLE;
+		m_physicaldevice = VK_NULL_HANDLE;
+		m_headless = false;
 	}
 
 	MetalVulkanSwapchain::MetalVulkanSwapchain()
@@ -286,6 +400,9 @@ namespace engine::vulkan
 
 	MetalVulkanSwapchain::~MetalVulkanSwapchain()
 	{
+		VulkanDisablePostProcess();
+		ReleaseRetiredSwapchains(true);
+
 		for (auto imageview : m_swapchain_image_views)
 		{
 			vkDestroyImageView(m_device, imageview, nullptr);
@@ -342,7 +459,8 @@ namespace engine::vulkan
 		CreationInfo.imageColorSpace	= SurfaceFormat.colorSpace;
 		CreationInfo.imageExtent		= Extent;
 		CreationInfo.imageArrayLayers	= 1;
-		CreationInfo.imageUsage			= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		/* MetalPostProcess blits its tonemapped output onto the images, ask for that wherever the surface allows it*/
+		CreationInfo.imageUsage			= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | (SwapchainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
 
 		MetalVulkanQueueFamilyIndices Indices = FindPhysicalQueueFamilies();
 		VkUint32 QueueFamilyIndices[] = { Indices.graphics_family, Indices.present_family };
@@ -364,15 +482,239 @@ namespace engine::vulkan
 		CreationInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 		CreationInfo.presentMode	= PresentMode;
 		CreationInfo.clipped		= VK_TRUE;
-		CreationInfo.oldSwapchain	= VK_NULL_HANDLE;
+		CreationInfo.oldSwapchain	= m_swapchain;	/* Lets the driver hand over, VulkanRecreateSwapchain retires the old one*/
 
 		VK_CHECK(vkCreateSwapchainKHR(m_device, &CreationInfo, nullptr, &m_swapchain));
 
+		m_swapchain_usage = CreationInfo.imageUsage;
+		m_swapchain_image_format = SurfaceFormat.format;
+		m_swapchain_extent = Extent;
+
 		vkGetSwapchainImagesKHR(m_device, m_swapchain, &ImageCount, nullptr);
 		m_swapchain_images.resize(ImageCount);
 		vkGetSwapchainImagesKHR(m_device, m_swapchain, &ImageCount, m_swapchain_images.data());
 	}
 
+	/* What VulkanEnablePostProcess was given, the chain is rebuilt from it along with the swapchain*/
+	static MetalPostProcessShaderPaths	PostProcessShaders;
+	static VkFormat						PostProcessFormat	= VK_FORMAT_R16G16B16A16_SFLOAT;
+	static DWord						PostProcessLevels	= 6;
+
+	/* The entry of the recreation in progress, for leftovers found while rebuilding*/
+	static MetalRetiredSwapchain& RetiringSwapchain()
+	{
+		if (m_retired_swapchains.empty() || m_retired_swapchains.back().frame != m_submittedframes)
+		{
+			m_retired_swapchains.emplace_back();
+			m_retired_swapchains.back().frame = m_submittedframes;
+		}
+		return m_retired_swapchains.back();
+	}
+
+	void ReleaseRetiredSwapchains(bool all)
+	{
+		/* Called right after the CurrentFrame fence wait, every frame up to the one that last used this slot is done*/
+		QWord Completed = m_submittedframes + 1 > MAXIMUM_FRAMES_IN_FLIGHTS ? m_submittedframes + 1 - MAXIMUM_FRAMES_IN_FLIGHTS : 0;
+
+		for (VkUsize i = 0; i < m_retired_swapchains.size();)
+		{
+			MetalRetiredSwapchain& Retired = m_retired_swapchains[i];
+			if (!all && Retired.frame > Completed)
+			{
+				i++;
+				continue;
+			}
+
+			for (VkFramebuffer framebuffer : Retired.framebuffers)
+			{
+				vkDestroyFramebuffer(m_device, framebuffer, nullptr);
+			}
+			for (VkImageView imageview : Retired.imageviews)
+			{
+				vkDestroyImageView(m_device, imageview, nullptr);
+			}
+			for (VkUsize j = 0; j < Retired.depthimages.size(); j++)
+			{
+				vkDestroyImageView(m_device, Retired.depthviews[j], nullptr);
+				vkDestroyImage(m_device, Retired.depthimages[j], nullptr);
+			}
+			for (VkDeviceMemory memory : Retired.depthmemories)
+			{
+				vkFreeMemory(m_device, memory, nullptr);
+			}
+			vkDestroySwapchainKHR(m_device, Retired.swapchain, nullptr);
+			delete Retired.postprocess;
+
+			m_retired_swapchains.erase(m_retired_swapchains.begin() + i);
+		}
+	}
+
+	int VulkanRecreateSwapchain()
+	{
+		METAL_ZONE("VulkanRecreateSwapchain");
+
+		/* Minimized, nothing to present to until the window comes back*/
+		VkExtent2D Extent = ChooseSwapExtent(GetSwapchainSupport().capabilities);
+		if (Extent.width == 0 || Extent.height == 0)
+		{
+			m_swapchain_dirty = true;
+			return 1;
+		}
+
+		/* Frames in flight still use these, they go once those frames are done*/
+		m_retired_swapchains.emplace_back();
+		MetalRetiredSwapchain& Retired = m_retired_swapchains.back();
+		Retired.frame = m_submittedframes;
+		Retired.swapchain = m_swapchain;
+		Retired.imageviews.swap(m_swapchain_image_views);
+		Retired.framebuffers.swap(m_swapchain_framebuffers);
+		Retired.depthimages.swap(m_depthimages);
+		Retired.depthviews.swap(m_depthimage_views);
+
+		VkFormat OldFormat = m_swapchain_image_format;
+		VkExtent2D OldExtent = m_swapchain_extent;
+		VulkanCreateSwapchain();
+		if (OldFormat != m_swapchain_image_format)
+		{
+			WarningMessage("Vulkan Swapchain WARNING", "The surface format changed from %d to %d, the render pass no longer matches",
+				static_cast<int>(OldFormat), static_cast<int>(m_swapchain_image_format));
+		}
+
+		VulkanCreateImageViews();
+		VulkanCreateDepthResources();
+		VulkanCreateFramebuffers();
+		m_images_in_flight.assign(m_swapchain_images.size(), VK_NULL_HANDLE);
+
+		/* A present mode switch keeps the size and format, the HDR targets are still good. Otherwise the old
+			chain goes with the old swapchain, frames in flight finish in it and a new one takes the next frame.
+			The render pass comes back compatible, pipelines made against the old one keep working
+		*/
+		bool Rebuild = OldExtent.width != m_swapchain_extent.width || OldExtent.height != m_swapchain_extent.height ||
+			OldFormat != m_swapchain_image_format;
+		if (m_postprocess != nullptr && Rebuild)
+		{
+			MetalPostProcessSettings Settings = m_postprocess->GetSettings();
+			RetiringSwapchain().postprocess = m_postprocess;
+			m_postprocess = nullptr;
+
+			MetalPostProcess* PostProcess = new MetalPostProcess();
+			if ((m_swapchain_usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) == 0 ||
+				PostProcess->Create(m_swapchain_extent.width, m_swapchain_extent.height, m_swapchain_image_format,
+					PostProcessShaders, PostProcessFormat, PostProcessLevels) != 0)
+			{
+				WarningMessage("Vulkan Post Process WARNING", "Failed to rebuild post processing for the new swapchain, rendering straight into it");
+				delete PostProcess;
+			}
+			else
+			{
+				PostProcess->SetSettings(Settings);
+				m_postprocess = PostProcess;
+			}
+		}
+
+		m_swapchain_dirty = false;
+		return 0;
+	}
+
+	void VulkanRequestSwapchainResize(VkUint32 width, VkUint32 height)
+	{
+		m_window_extent = { width, height };
+		m_swapchain_dirty = m_swapchain != VK_NULL_HANDLE;
+	}
+
+	void VulkanSetPresentMode(VkPresentModeKHR mode)
+	{
+		m_present_mode = mode;
+		m_swapchain_dirty = m_swapchain != VK_NULL_HANDLE;
+	}
+
+	int VulkanEnablePostProcess(const MetalPostProcessShaderPaths& shaders, VkFormat hdrformat, DWord bloomlevels)
+	{
+		if (m_swapchain == VK_NULL_HANDLE)
+		{
+			WarningMessage("Vulkan Post Process WARNING", "Tried to enable post processing before the swapchain exists");
+			return 1;
+		}
+
+		/* Record ends with a blit onto the acquired image, which the surface has to allow*/
+		if ((m_swapchain_usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) == 0)
+		{
+			WarningMessage("Vulkan Post Process WARNING", "The surface's images can't be blitted to, rendering straight into the swapchain");
+			return 1;
+		}
+
+		VulkanDisablePostProcess();
+
+		MetalPostProcess* PostProcess = new MetalPostProcess();
+		if (PostProcess->Create(m_swapchain_extent.width, m_swapchain_extent.height, m_swapchain_image_format, shaders, hdrformat, bloomlevels) != 0)
+		{
+			delete PostProcess;
+			return 1;
+		}
+
+		PostProcessShaders = shaders;
+		PostProcessFormat = hdrformat;
+		PostProcessLevels = bloomlevels;
+		m_postprocess = PostProcess;
+
+		fmt::print("ENGINE: Rendering into a {}x{} HDR target ({} bloom levels)\n", m_swapchain_extent.width, m_swapchain_extent.height,
+			PostProcess->GetBloomLevelCount());
+		return 0;
+	}
+
+	void VulkanDisablePostProcess()
+	{
+		if (m_postprocess == nullptr)
+		{
+			return;
+		}
+
+		vkDeviceWaitIdle(m_device);
+		delete m_postprocess;
+		m_postprocess = nullptr;
+	}
+
+	VkRenderPass VulkanGetFrameRenderPass()
+	{
+		return m_postprocess != nullptr ? m_postprocess->GetRenderPass() : m_renderpass;
+	}
+
+	void VulkanBeginFrameRenderPass(VkCommandBuffer commandbuffer, VkUint32 imageindex, const float clearcolor[4])
+	{
+		if (m_postprocess != nullptr)
+		{
+			m_postprocess->BeginRenderPass(commandbuffer, clearcolor);
+			return;
+		}
+
+		array<VkClearValue, 2> ClearValues = {};
+		ClearValues[0].color		= { { clearcolor[0], clearcolor[1], clearcolor[2], clearcolor[3] } };
+		ClearValues[1].depthStencil	= { 1.0f, 0 };
+
+		VkRenderPassBeginInfo RenderPassInfo = {};
+		RenderPassInfo.sType				= VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		RenderPassInfo.renderPass			= m_renderpass;
+		RenderPassInfo.framebuffer			= m_swapchain_framebuffers[imageindex];
+		RenderPassInfo.renderArea.offset	= { 0, 0 };
+		RenderPassInfo.renderArea.extent	= m_swapchain_extent;
+		RenderPassInfo.clearValueCount		= static_cast<VkUint32>(ClearValues.size());
+		RenderPassInfo.pClearValues			= ClearValues.data();
+		vkCmdBeginRenderPass(commandbuffer, &RenderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	}
+
+	void VulkanEndFrameRenderPass(VkCommandBuffer commandbuffer, VkUint32 imageindex)
+	{
+		/* The swapchain render pass leaves its image in PRESENT_SRC_KHR by itself*/
+		if (m_postprocess == nullptr)
+		{
+			vkCmdEndRenderPass(commandbuffer);
+			return;
+		}
+
+		m_postprocess->EndRenderPass(commandbuffer);
+		m_postprocess->Record(commandbuffer, m_swapchain_images[imageindex], VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	}
+
 	void VulkanCreateImageViews()
 	{
 		m_swapchain_image_views.resize(m_swapchain_images.size());
@@ -398,9 +740,18 @@ namespace engine::vulkan
 		VkFormat DepthFormat = FindDepthFormat();
 		VkExtent2D SwapchainExtent = m_swapchain_extent;
 
-		m_depthimages.resize(m_swapchain_images.size());
-		m_depthimages_memories.resize(m_swapchain_images.size());
-		m_depthimage_views.resize(m_swapchain_images.size());
+		VkUsize Count = m_swapchain_images.size();
+		m_depthimages.resize(Count);
+		m_depthimage_views.resize(Count);
+
+		/* A swapchain with fewer images than the last one leaves allocations over, they retire with it*/
+		for (VkUsize i = Count; i < m_depthimages_memories.size(); i++)
+		{
+			RetiringSwapchain().depthmemories.push_back(m_depthimages_memories[i]);
+		}
+		m_depthimages_memories.resize(Count, VK_NULL_HANDLE);
+		m_depthimages_sizes.resize(Count, 0);
+		m_depthimages_types.resize(Count, 0);
 
 		for (VkUint32 i = 0; i < m_depthimages.size(); i++)
 		{
@@ -408,7 +759,7 @@ namespace engine::vulkan
 			CreationInfo.sType			= VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 			CreationInfo.imageType		= VK_IMAGE_TYPE_2D;
 			CreationInfo.extent.width	= m_swapchain_extent.width;
-			CreationInfo.extent.height	= m_swapchain_extent.width;
+			CreationInfo.extent.height	= m_swapchain_extent.height;
 			CreationInfo.extent.depth	= 1;
 			CreationInfo.mipLevels		= 1;
 			CreationInfo.arrayLayers	= 1;
@@ -420,7 +771,35 @@ namespace engine::vulkan
 			CreationInfo.sharingMode	= VK_SHARING_MODE_EXCLUSIVE;
 			CreationInfo.flags			= 0;
 
-			CreateImageWithInfo(CreationInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depthimages[i], m_depthimages_memories[i]);
+			VK_CHECK(vkCreateImage(m_device, &CreationInfo, nullptr, &m_depthimages[i]));
+
+			VkMemoryRequirements memoryrequiem;
+			vkGetImageMemoryRequirements(m_device, m_depthimages[i], &memoryrequiem);
+			VkUint32 MemoryType = FindMemoryType(memoryrequiem.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+			/* Resizing within the old size keeps the allocation, the render pass dependency on depth writes
+				orders this frame after the in flight ones still using the old image in it
+			*/
+			if (m_depthimages_memories[i] == VK_NULL_HANDLE || m_depthimages_sizes[i] < memoryrequiem.size || m_depthimages_types[i] != MemoryType)
+			{
+				if (m_depthimages_memories[i] != VK_NULL_HANDLE)
+				{
+					RetiringSwapchain().depthmemories.push_back(m_depthimages_memories[i]);
+				}
+
+				VkMemoryAllocateInfo mallocinfo = {};
+				mallocinfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+				mallocinfo.allocationSize = memoryrequiem.size;
+				mallocinfo.memoryTypeIndex = MemoryType;
+
+				VK_CHECK(vkAllocateMemory(m_device, &mallocinfo, nullptr, &m_depthimages_memories[i]));
+				MetalCounterAdd(METAL_COUNTER_DEVICE_ALLOCATIONS, 1);
+				MetalCounterAdd(METAL_COUNTER_DEVICE_BYTES, static_cast<long long>(memoryrequiem.size));
+				m_depthimages_sizes[i] = memoryrequiem.size;
+				m_depthimages_types[i] = MemoryType;
+			}
+
+			VK_CHECK(vkBindImageMemory(m_device, m_depthimages[i], m_depthimages_memories[i], 0));
 
 			/* It's french for the view -> La Vue*/
 			VkImageViewCreateInfo LaVueInfo{};
@@ -480,11 +859,11 @@ namespace engine::vulkan
 		*/
 		VkSubpassDependency SubpassPlatoon = {};
 		SubpassPlatoon.srcSubpass		= VK_SUBPASS_EXTERNAL; 
-		SubpassPlatoon.srcAccessMask	= 0;
-		SubpassPlatoon.srcStageMask		= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		SubpassPlatoon.srcAccessMask	= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;	/* Depth memory may be shared with the previous swapchain's images*/
+		SubpassPlatoon.srcStageMask		= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
 		SubpassPlatoon.dstSubpass		= 0;
 		SubpassPlatoon.dstAccessMask	= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-		SubpassPlatoon.dstStageMask		= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		SubpassPlatoon.dstStageMask		= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
 
 		array<VkAttachmentDescription, 2> Attachments = { ColorAttachment, DepthAttachment };
 		VkRenderPassCreateInfo CreationInfo = {};
@@ -501,8 +880,8 @@ namespace engine::vulkan
 
 	void VulkanCreateFramebuffers()
 	{
-		m_swapchain_framebuffers.resize(m_swapchain_image_format);
-		for (VkUsize i = 0; i < m_swapchain_image_format; i++)
+		m_swapchain_framebuffers.resize(m_swapchain_images.size());
+		for (VkUsize i = 0; i < m_swapchain_images.size(); i++)
 		{
 			array<VkImageView, 2> Attachments = { m_swapchain_image_views[i], m_depthimage_views[i] };
 			VkExtent2D SwapchainExtent = m_swapchain_extent;
@@ -557,6 +936,138 @@ namespace engine::vulkan
 		
 		VK_CHECK(vkAllocateMemory(m_device, &mallocinfo, nullptr, &imagememory));
 		VK_CHECK(vkBindImageMemory(m_device, image, imagememory, 0));
+		MetalCounterAdd(METAL_COUNTER_DEVICE_ALLOCATIONS, 1);
+		MetalCounterAdd(METAL_COUNTER_DEVICE_BYTES, static_cast<long long>(memoryrequiem.size));
+	}
+
+	void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& buffermemory)
+	{
+		VkBufferCreateInfo CreationInfo = {};
+		CreationInfo.sType			= VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		CreationInfo.size			= size;
+		CreationInfo.usage			= usage;
+		CreationInfo.sharingMode	= VK_SHARING_MODE_EXCLUSIVE;
+
+		VK_CHECK(vkCreateBuffer(m_device, &CreationInfo, nullptr, &buffer));
+
+		VkMemoryRequirements memoryrequiem;
+		vkGetBufferMemoryRequirements(m_device, buffer, &memoryrequiem);
+
+		VkMemoryAllocateInfo mallocinfo = {};
+		mallocinfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		mallocinfo.allocationSize = memoryrequiem.size;
+		mallocinfo.memoryTypeIndex = FindMemoryType(memoryrequiem.memoryTypeBits, properties);
+
+		VK_CHECK(vkAllocateMemory(m_device, &mallocinfo, nullptr, &buffermemory));
+		VK_CHECK(vkBindBufferMemory(m_device, buffer, buffermemory, 0));
+		MetalCounterAdd(METAL_COUNTER_DEVICE_ALLOCATIONS, 1);
+		MetalCounterAdd(METAL_COUNTER_DEVICE_BYTES, static_cast<long long>(memoryrequiem.size));
+	}
+
+	VkCommandBuffer BeginSingleTimeCommands()
+	{
+		VkCommandBufferAllocateInfo AllocationInfo = {};
+		AllocationInfo.sType				= VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		AllocationInfo.level				= VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		AllocationInfo.commandPool			= m_commandpool;
+		AllocationInfo.commandBufferCount	= 1;
+
+		VkCommandBuffer CommandBuffer;
+		VK_CHECK(vkAllocateCommandBuffers(m_device, &AllocationInfo, &CommandBuffer));
+
+		VkCommandBufferBeginInfo BeginInfo = {};
+		BeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		BeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		VK_CHECK(vkBeginCommandBuffer(CommandBuffer, &BeginInfo));
+		return CommandBuffer;
+	}
+
+	void EndSingleTimeCommands(VkCommandBuffer commandbuffer)
+	{
+		VK_CHECK(vkEndCommandBuffer(commandbuffer));
+
+		VkSubmitInfo SubmitInfo = {};
+		SubmitInfo.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		SubmitInfo.commandBufferCount	= 1;
+		SubmitInfo.pCommandBuffers		= &commandbuffer;
+
+		VK_CHECK(vkQueueSubmit(m_graphicsqueue, 1, &SubmitInfo, VK_NULL_HANDLE));
+		MetalCounterAdd(METAL_COUNTER_QUEUE_SUBMITS, 1);
+		vkQueueWaitIdle(m_graphicsqueue);
+
+		vkFreeCommandBuffers(m_device, m_commandpool, 1, &commandbuffer);
+	}
+
+	void UploadToBuffer(VkBuffer destination, VkDeviceSize offset, const void* data, VkDeviceSize size)
+	{
+		VkBuffer StagingBuffer;
+		VkDeviceMemory StagingMemory;
+		CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, StagingBuffer, StagingMemory);
+
+		void* mapped = nullptr;
+		VK_CHECK(vkMapMemory(m_device, StagingMemory, 0, size, 0, &mapped));
+		memcpy(mapped, data, static_cast<size_t>(size));
+		vkUnmapMemory(m_device, StagingMemory);
+
+		VkCommandBuffer CommandBuffer = BeginSingleTimeCommands();
+
+		VkBufferCopy CopyRegion = {};
+		CopyRegion.srcOffset	= 0;
+		CopyRegion.dstOffset	= offset;
+		CopyRegion.size			= size;
+		vkCmdCopyBuffer(CommandBuffer, StagingBuffer, destination, 1, &CopyRegion);
+		MetalCounterAdd(METAL_COUNTER_BYTES_UPLOADED, static_cast<long long>(size));
+
+		EndSingleTimeCommands(CommandBuffer);
+
+		vkDestroyBuffer(m_device, StagingBuffer, nullptr);
+		vkFreeMemory(m_device, StagingMemory, nullptr);
+	}
+
+	int CreateComputePipeline(const string& shaderpath, VkPipelineLayout layout, VkPipeline& pipeline)
+	{
+		vector<char> Code = MetalVulkanPipeline::ReadShaderFile(shaderpath);
+		if (Code.empty())
+		{
+			return 1;
+		}
+
+		VkShaderModuleCreateInfo ModuleInfo = {};
+		ModuleInfo.sType	= VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		ModuleInfo.codeSize	= Code.size();
+		ModuleInfo.pCode	= reinterpret_cast<const VkUint32*>(Code.data());
+
+		VkShaderModule Module;
+		VK_CHECK(vkCreateShaderModule(m_device, &ModuleInfo, nullptr, &Module));
+
+		VkComputePipelineCreateInfo PipelineInfo = {};
+		PipelineInfo.sType			= VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		PipelineInfo.stage.sType	= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		PipelineInfo.stage.stage	= VK_SHADER_STAGE_COMPUTE_BIT;
+		PipelineInfo.stage.module	= Module;
+		PipelineInfo.stage.pName	= "main";
+		PipelineInfo.layout			= layout;
+		VK_CHECK(vkCreateComputePipelines(m_device, m_pipelinecache, 1, &PipelineInfo, nullptr, &pipeline));
+
+		/* The pipeline keeps its own copy of the code*/
+		vkDestroyShaderModule(m_device, Module, nullptr);
+		return 0;
+	}
+
+	VkUint32 CmdDrawIndexedIndirectBatched(VkCommandBuffer commandbuffer, VkBuffer buffer, VkDeviceSize offset, VkUint32 drawcount, VkUint32 stride)
+	{
+		/* Without multiDrawIndirect drawCount has to be 0 or 1*/
+		VkUint32 BatchSize = m_multidrawindirect_supported ? std::max(m_properties.limits.maxDrawIndirectCount, 1u) : 1u;
+
+		VkUint32 Calls = 0;
+		for (VkUint32 First = 0; First < drawcount; First += BatchSize)
+		{
+			VkUint32 Count = std::min(BatchSize, drawcount - First);
+			vkCmdDrawIndexedIndirect(commandbuffer, buffer, offset + static_cast<VkDeviceSize>(First) * stride, Count, stride);
+			Calls++;
+		}
+		return Calls;
 	}
 
 	VkFormat FindSupportedFormat(const vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features)
@@ -611,6 +1122,17 @@ namespace engine::vulkan
 
 	VkPresentModeKHR ChooseSwapPresentMode(const vector<VkPresentModeKHR>& usable_present_modes)
 	{
+		/* Whatever VulkanSetPresentMode asked for, if the surface has it*/
+		for (const auto& upmode : usable_present_modes)
+		{
+			if (upmode == m_present_mode && m_present_mode != VK_PRESENT_MODE_MAX_ENUM_KHR)
+			{
+				fmt::print("ENGINE: Vulkan present mode = {}\n", upmode == VK_PRESENT_MODE_IMMEDIATE_KHR ? "Immediate"
+					: upmode == VK_PRESENT_MODE_MAILBOX_KHR ? "Mailbox" : upmode == VK_PRESENT_MODE_FIFO_RELAXED_KHR ? "Relaxed V-Sync" : "V-Sync");
+				return upmode;
+			}
+		}
+
 		for (const auto& upmode : usable_present_modes)
 		{
 			if (upmode == VK_PRESENT_MODE_MAILBOX_KHR)
@@ -648,19 +1170,84 @@ namespace engine::vulkan
 		}
 	}
 
+	/* Device local heap usage and budget for the counters, once per frame*/
+	void SampleMemoryCounters()
+	{
+		if (!m_memorybudget_supported)
+		{
+			return;
+		}
+
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT Budget = {};
+		Budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+		VkPhysicalDeviceMemoryProperties2 Properties = {};
+		Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		Properties.pNext = &Budget;
+		vkGetPhysicalDeviceMemoryProperties2(m_physicaldevice, &Properties);
+
+		VkDeviceSize Usage = 0;
+		VkDeviceSize Limit = 0;
+		for (VkUint32 i = 0; i < Properties.memoryProperties.memoryHeapCount; i++)
+		{
+			if (Properties.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+			{
+				Usage += Budget.heapUsage[i];
+				Limit += Budget.heapBudget[i];
+			}
+		}
+
+		MetalCounterSet(METAL_COUNTER_HEAP_USAGE, static_cast<long long>(Usage));
+		MetalCounterSet(METAL_COUNTER_HEAP_BUDGET, static_cast<long long>(Limit));
+	}
+
 	VkResult AcquireNextImage(VkUint32* imageindex)
 	{
 		/* We have a little macros causing major problems so we're going to commit a sin in order to get this to work*/
+		METAL_ZONE("AcquireNextImage");
+
 		VkUint32 requiem = (numeric_limits<VkUint32>::max)(); /* The name is ironic!!*/
+		auto WaitStart = std::chrono::steady_clock::now();
 		vkWaitForFences(m_device, 1, &m_in_flight_fences[CurrentFrame], VK_TRUE, requiem);
+		MetalCounterSample(METAL_COUNTER_FENCE_WAIT, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - WaitStart).count());
+		SampleMemoryCounters();
+
+#if defined(METAL_PROFILE)
+		/* This frame slot's previous run is done, its timestamps can be read*/
+		GpuProfilerCollect();
+#endif
+
+		ReleaseRetiredSwapchains(false);
+
+		if (m_swapchain_dirty && VulkanRecreateSwapchain() != 0)
+		{
+			return VK_ERROR_OUT_OF_DATE_KHR;
+		}
 
 		VkResult result = vkAcquireNextImageKHR(m_device, m_swapchain, requiem, m_image_available_semaphores[CurrentFrame], VK_NULL_HANDLE, imageindex);
 
+		/* The surface changed before we heard about it, the semaphore wasn't signaled so one more try is fine*/
+		if (result == VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			if (VulkanRecreateSwapchain() != 0)
+			{
+				return result;
+			}
+			result = vkAcquireNextImageKHR(m_device, m_swapchain, requiem, m_image_available_semaphores[CurrentFrame], VK_NULL_HANDLE, imageindex);
+		}
+		else if (result == VK_SUBOPTIMAL_KHR)
+		{
+			/* Still presentable, rebuild next frame*/
+			m_swapchain_dirty = true;
+		}
+
 		return result;
 	}
 
 	VkResult SubmitCommandBuffers(const VkCommandBuffer* buffers, VkUint32* imageindex)
 	{
+		METAL_ZONE("SubmitCommandBuffers");
+
 		if (m_images_in_flight[*imageindex] != VK_NULL_HANDLE)
 		{
 			vkWaitForFences(m_device, 1, &m_images_in_flight[*imageindex], VK_TRUE, UINT64_MAX);
@@ -679,12 +1266,20 @@ namespace engine::vulkan
 		SubmitInfo.commandBufferCount = 1;
 		SubmitInfo.pCommandBuffers = buffers;
 
+#if defined(METAL_PROFILE)
+		/* Brackets the frame with the GPU profiler's begin/end timestamps*/
+		VkCommandBuffer ProfiledBuffers[3];
+		SubmitInfo.commandBufferCount = GpuProfilerWrapSubmit(buffers, 1, ProfiledBuffers);
+		SubmitInfo.pCommandBuffers = ProfiledBuffers;
+#endif
+
 		VkSemaphore SignalSemaphores[] = { m_render_finished_semaphores[CurrentFrame] };
 		SubmitInfo.signalSemaphoreCount = 1;
 		SubmitInfo.pSignalSemaphores = SignalSemaphores;
 
 		vkResetFences(m_device, 1, &m_in_flight_fences[CurrentFrame]);
 		VK_CHECK(vkQueueSubmit(m_graphicsqueue, 1, &SubmitInfo, m_in_flight_fences[CurrentFrame]));
+		MetalCounterAdd(METAL_COUNTER_QUEUE_SUBMITS, 1);
 
 		VkSwapchainKHR Swapchains[] = { m_swapchain };
 		VkPresentInfoKHR PresentInfo = {};
@@ -696,12 +1291,18 @@ namespace engine::vulkan
 		PresentInfo.pImageIndices = imageindex;
 
 		auto result = vkQueuePresentKHR(m_presentqueue, &PresentInfo);
+		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+		{
+			m_swapchain_dirty = true;
+		}
+		m_submittedframes++;
 
 		/* This black magic adds 1 to the current frame index
 			but if divides only if current frame index equals 2 to wrap back to zero
 			just in cause you don't know what '%' means... it's just the remainder after division
 		*/
 		CurrentFrame = (CurrentFrame + 1) % MAXIMUM_FRAMES_IN_FLIGHTS;
+		return result;
 	}
 
 	MetalVulkanPipeline::MetalVulkanPipeline(const string& vertexfilepath, const string& fragmentfilepath)
@@ -773,7 +1374,7 @@ namespace engine::vulkan
 		PipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 		PipelineInfo.stageCount = 2;
 		PipelineInfo.pStages = shader_stages;
-		PipelineInfo.pVertexInputState = &VertexInputInfo;
+		PipelineInfo.pVertexInputState = MetalPipelineInfo.vertexinput != nullptr ? MetalPipelineInfo.vertexinput : &VertexInputInfo;
 		PipelineInfo.pInputAssemblyState = &MetalPipelineInfo.inputassemblyinfo;
 		PipelineInfo.pViewportState = &MetalPipelineInfo.viewportinfo;
 		PipelineInfo.pRasterizationState = &MetalPipelineInfo.rasterizationinfo;
@@ -0,0 +1,80 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine skinning matrices (per frame ring the animation system writes into)
+// ------------------------------------------------------
+
+#include "headers/MVulkanSkinning.hpp"
+#include "headers/MError.h"
+
+namespace engine::vulkan
+{
+	MetalSkinningRing::~MetalSkinningRing()
+	{
+		Destroy();
+	}
+
+	int MetalSkinningRing::Create(DWord jointsperframe)
+	{
+		if (jointsperframe == 0)
+		{
+			WarningMessage("Vulkan Skinning WARNING", "Tried to create a skinning ring with no room");
+			return 1;
+		}
+
+		capacity = jointsperframe;
+		base = 0;
+		used = 0;
+
+		/* Rewritten every frame by the CPU, so it lives in host memory like the instance ring*/
+		VkDeviceSize Size = sizeof(MetalSkinMatrix) * static_cast<VkDeviceSize>(capacity) * MAXIMUM_FRAMES_IN_FLIGHTS;
+		CreateBuffer(Size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, memory);
+
+		void* Mapped = nullptr;
+		VK_CHECK(vkMapMemory(m_device, memory, 0, Size, 0, &Mapped));
+		mapped = static_cast<MetalSkinMatrix*>(Mapped);
+		return 0;
+	}
+
+	void MetalSkinningRing::Destroy()
+	{
+		if (m_device == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		/* Freeing the memory unmaps it*/
+		if (buffer != VK_NULL_HANDLE)	vkDestroyBuffer(m_device, buffer, nullptr);
+		if (memory != VK_NULL_HANDLE)	vkFreeMemory(m_device, memory, nullptr);
+
+		buffer = VK_NULL_HANDLE;
+		memory = VK_NULL_HANDLE;
+		mapped = nullptr;
+		capacity = 0;
+		base = 0;
+		used = 0;
+	}
+
+	void MetalSkinningRing::BeginFrame()
+	{
+		base = capacity * static_cast<DWord>(CurrentFrame);
+		used = 0;
+	}
+
+	MetalSkinMatrix* MetalSkinningRing::Allocate(DWord jointcount, DWord& firstjoint)
+	{
+		if (mapped == nullptr || jointcount > capacity - used)
+		{
+			return nullptr;
+		}
+
+		firstjoint = base + used;
+		used += jointcount;
+		return mapped + firstjoint;
+	}
+}
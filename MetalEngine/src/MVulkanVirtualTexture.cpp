@@ -0,0 +1,580 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine virtual texturing, GPU side (cache atlas, page table images, feedback pass)
+// ------------------------------------------------------
+
+#include <cmath>
+#include <cstring>
+
+#include "headers/MVulkanVirtualTexture.hpp"
+#include "headers/MTextureStreamer.hpp"
+#include "headers/MVulkanProfiler.hpp"
+#include "headers/MCounters.h"
+#include "headers/MError.h"
+
+namespace engine::vulkan
+{
+	using namespace engine::textures;
+
+	MetalVirtualTexturing::~MetalVirtualTexturing()
+	{
+		Destroy();
+	}
+
+	int MetalVirtualTexturing::Create(imageformat pageformat, DWord width, DWord height, VkExtent2D screen)
+	{
+		VkFormat AtlasFormat = GetImageVkFormat(pageformat);
+		if (AtlasFormat == VK_FORMAT_UNDEFINED || width * VT_PAGE_TEXELS > m_properties.limits.maxImageDimension2D ||
+			height * VT_PAGE_TEXELS > m_properties.limits.maxImageDimension2D)
+		{
+			WarningMessage("Virtual Texture WARNING", "A %ux%u page cache does not fit in an image on this device", width, height);
+			return 1;
+		}
+
+		format = pageformat;
+		cachewidth = width;
+		cacheheight = height;
+		QWord pagebytes = GetImageMipSize(pageformat, VT_PAGE_TEXELS, VT_PAGE_TEXELS);
+
+		/* Reads land in the first VT_STAGING_PAGES pages, page tables go after them (one range per frame in flight)*/
+		tablestaging = VT_STAGING_PAGES * pagebytes;
+		VkDeviceSize StagingSize = tablestaging + VT_TABLE_STAGING_SIZE * MAXIMUM_FRAMES_IN_FLIGHTS;
+		CreateBuffer(StagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingbuffer, stagingmemory);
+		VK_CHECK(vkMapMemory(m_device, stagingmemory, 0, StagingSize, 0, (void**)&stagingdata));
+
+		if (resolver.Create(width, height, pagebytes, stagingdata, VT_STAGING_PAGES, MAXIMUM_FRAMES_IN_FLIGHTS) != 0)
+		{
+			Destroy();
+			return 1;
+		}
+
+		VkImageCreateInfo ImageInfo = {};
+		ImageInfo.sType			= VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		ImageInfo.imageType		= VK_IMAGE_TYPE_2D;
+		ImageInfo.format		= AtlasFormat;
+		ImageInfo.extent		= { width * VT_PAGE_TEXELS, height * VT_PAGE_TEXELS, 1 };
+		ImageInfo.mipLevels		= 1;
+		ImageInfo.arrayLayers	= 1;
+		ImageInfo.samples		= VK_SAMPLE_COUNT_1_BIT;
+		ImageInfo.tiling		= VK_IMAGE_TILING_OPTIMAL;
+		ImageInfo.usage			= VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		ImageInfo.sharingMode	= VK_SHARING_MODE_EXCLUSIVE;
+		ImageInfo.initialLayout	= VK_IMAGE_LAYOUT_UNDEFINED;
+		CreateImageWithInfo(ImageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, atlas, atlasmemory);
+
+		VkImageViewCreateInfo ViewInfo = {};
+		ViewInfo.sType				= VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		ViewInfo.image				= atlas;
+		ViewInfo.viewType			= VK_IMAGE_VIEW_TYPE_2D;
+		ViewInfo.format				= AtlasFormat;
+		ViewInfo.subresourceRange	= { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		VK_CHECK(vkCreateImageView(m_device, &ViewInfo, nullptr, &atlasview));
+
+		/* Pages are only ever uploaded over, so the atlas can sit in its sampling layout from the start*/
+		VkCommandBuffer CommandBuffer = BeginSingleTimeCommands();
+		VkImageMemoryBarrier Barrier = {};
+		Barrier.sType				= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		Barrier.srcAccessMask		= 0;
+		Barrier.dstAccessMask		= VK_ACCESS_SHADER_READ_BIT;
+		Barrier.oldLayout			= VK_IMAGE_LAYOUT_UNDEFINED;
+		Barrier.newLayout			= VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		Barrier.srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		Barrier.dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		Barrier.image				= atlas;
+		Barrier.subresourceRange	= { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &Barrier);
+		EndSingleTimeCommands(CommandBuffer);
+
+		/* The border keeps bilinear filtering inside a page, the shader picks the mip itself*/
+		VkSamplerCreateInfo SamplerInfo = {};
+		SamplerInfo.sType			= VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		SamplerInfo.magFilter		= VK_FILTER_LINEAR;
+		SamplerInfo.minFilter		= VK_FILTER_LINEAR;
+		SamplerInfo.mipmapMode		= VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		SamplerInfo.addressModeU	= VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		SamplerInfo.addressModeV	= VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		SamplerInfo.addressModeW	= VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		SamplerInfo.maxLod			= 0.0f;
+		VK_CHECK(vkCreateSampler(m_device, &SamplerInfo, nullptr, &atlassampler));
+
+		SamplerInfo.magFilter		= VK_FILTER_NEAREST;
+		SamplerInfo.minFilter		= VK_FILTER_NEAREST;
+		SamplerInfo.maxLod			= VK_LOD_CLAMP_NONE;
+		VK_CHECK(vkCreateSampler(m_device, &SamplerInfo, nullptr, &tablesampler));
+
+		atlasslot = BindlessRegisterTexture(atlasview, atlassampler);
+
+		feedbackextent = { max(1u, screen.width / VT_FEEDBACK_SCALE), max(1u, screen.height / VT_FEEDBACK_SCALE) };
+
+		VkDeviceSize InfoSize = sizeof(MetalGpuVirtualHeader) + sizeof(MetalGpuVirtualTexture) * VT_MAX_TEXTURES;
+		CreateBuffer(InfoSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, infobuffer, infomemory);
+		VK_CHECK(vkMapMemory(m_device, infomemory, 0, InfoSize, 0, (void**)&infodata));
+		std::memset(infodata, 0, InfoSize);
+
+		MetalGpuVirtualHeader Header = {};
+		Header.atlaspagesx		= width;
+		Header.atlaspagesy		= height;
+		Header.feedbackwidth	= feedbackextent.width;
+		Header.feedbackheight	= feedbackextent.height;
+		Header.feedbackbias		= -std::log2(static_cast<float>(VT_FEEDBACK_SCALE));
+		std::memcpy(infodata, &Header, sizeof(Header));
+		infoslot = BindlessRegisterBuffer(infobuffer);
+
+		VkDeviceSize FeedbackSize = static_cast<VkDeviceSize>(feedbackextent.width) * feedbackextent.height * sizeof(DWord);
+		for (int i = 0; i < MAXIMUM_FRAMES_IN_FLIGHTS; i++)
+		{
+			CreateBuffer(FeedbackSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, feedbackbuffers[i], feedbackmemories[i]);
+			VK_CHECK(vkMapMemory(m_device, feedbackmemories[i], 0, FeedbackSize, 0, (void**)&feedbackdata[i]));
+			std::memset(feedbackdata[i], 0xFF, FeedbackSize);
+			feedbackslots[i] = BindlessRegisterBuffer(feedbackbuffers[i]);
+		}
+
+		/* Depth only, the fragment shader's output is the feedback buffer*/
+		VkAttachmentDescription DepthAttachment = {};
+		DepthAttachment.format			= FindDepthFormat();
+		DepthAttachment.samples			= VK_SAMPLE_COUNT_1_BIT;
+		DepthAttachment.loadOp			= VK_ATTACHMENT_LOAD_OP_CLEAR;
+		DepthAttachment.storeOp			= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		DepthAttachment.stencilLoadOp	= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		DepthAttachment.stencilStoreOp	= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		DepthAttachment.initialLayout	= VK_IMAGE_LAYOUT_UNDEFINED;
+		DepthAttachment.finalLayout		= VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference DepthRef = {};
+		DepthRef.attachment	= 0;
+		DepthRef.layout		= VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkSubpassDescription Subpass	= {};
+		Subpass.pipelineBindPoint		= VK_PIPELINE_BIND_POINT_GRAPHICS;
+		Subpass.pDepthStencilAttachment	= &DepthRef;
+
+		VkSubpassDependency Dependency = {};
+		Dependency.srcSubpass		= VK_SUBPASS_EXTERNAL;
+		Dependency.srcStageMask		= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+		Dependency.srcAccessMask	= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		Dependency.dstSubpass		= 0;
+		Dependency.dstStageMask		= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		Dependency.dstAccessMask	= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		VkRenderPassCreateInfo PassInfo = {};
+		PassInfo.sType				= VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		PassInfo.attachmentCount	= 1;
+		PassInfo.pAttachments		= &DepthAttachment;
+		PassInfo.subpassCount		= 1;
+		PassInfo.pSubpasses			= &Subpass;
+		PassInfo.dependencyCount	= 1;
+		PassInfo.pDependencies		= &Dependency;
+		VK_CHECK(vkCreateRenderPass(m_device, &PassInfo, nullptr, &feedbackpass));
+
+		ImageInfo.format		= DepthAttachment.format;
+		ImageInfo.extent		= { feedbackextent.width, feedbackextent.height, 1 };
+		ImageInfo.usage			= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		CreateImageWithInfo(ImageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, feedbackdepth, feedbackdepthmemory);
+
+		ViewInfo.image				= feedbackdepth;
+		ViewInfo.format				= DepthAttachment.format;
+		ViewInfo.subresourceRange	= { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+		VK_CHECK(vkCreateImageView(m_device, &ViewInfo, nullptr, &feedbackdepthview));
+
+		VkFramebufferCreateInfo FramebufferInfo = {};
+		FramebufferInfo.sType			= VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		FramebufferInfo.renderPass		= feedbackpass;
+		FramebufferInfo.attachmentCount	= 1;
+		FramebufferInfo.pAttachments	= &feedbackdepthview;
+		FramebufferInfo.width			= feedbackextent.width;
+		FramebufferInfo.height			= feedbackextent.height;
+		FramebufferInfo.layers			= 1;
+		VK_CHECK(vkCreateFramebuffer(m_device, &FramebufferInfo, nullptr, &feedbackframebuffer));
+
+		fmt::print("ENGINE: Virtual texturing ready ({}x{} page cache, {} MB, feedback {}x{})\n", width, height,
+			(pagebytes * width * height) >> 20, feedbackextent.width, feedbackextent.height);
+		return 0;
+	}
+
+	void MetalVirtualTexturing::DestroyTable(PageTable& table)
+	{
+		if (table.slot != BINDLESS_INVALID)
+		{
+			BindlessReleaseTexture(table.slot);
+		}
+		vkDestroyImageView(m_device, table.view, nullptr);
+		vkDestroyImage(m_device, table.image, nullptr);
+		vkFreeMemory(m_device, table.memory, nullptr);
+		table = PageTable();
+	}
+
+	void MetalVirtualTexturing::Destroy()
+	{
+		if (stagingbuffer == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		/* Readers write into the staging memory, so they have to be done before it goes*/
+		resolver.Destroy();
+
+		for (PageTable& table : tables)
+		{
+			if (table.image != VK_NULL_HANDLE)
+			{
+				DestroyTable(table);
+			}
+		}
+		for (Retired& table : retired)
+		{
+			DestroyTable(table.table);
+		}
+		tables.clear();
+		retired.clear();
+
+		for (int i = 0; i < MAXIMUM_FRAMES_IN_FLIGHTS; i++)
+		{
+			if (feedbackbuffers[i] != VK_NULL_HANDLE)
+			{
+				BindlessReleaseBuffer(feedbackslots[i]);
+				vkUnmapMemory(m_device, feedbackmemories[i]);
+				vkDestroyBuffer(m_device, feedbackbuffers[i], nullptr);
+				vkFreeMemory(m_device, feedbackmemories[i], nullptr);
+			}
+			feedbackbuffers[i] = VK_NULL_HANDLE;
+			feedbackmemories[i] = VK_NULL_HANDLE;
+			feedbackdata[i] = nullptr;
+		}
+
+		if (infobuffer != VK_NULL_HANDLE)
+		{
+			BindlessReleaseBuffer(infoslot);
+			vkUnmapMemory(m_device, infomemory);
+			vkDestroyBuffer(m_device, infobuffer, nullptr);
+			vkFreeMemory(m_device, infomemory, nullptr);
+		}
+
+		if (atlasslot != BINDLESS_INVALID)
+		{
+			BindlessReleaseTexture(atlasslot);
+		}
+
+		vkDestroyFramebuffer(m_device, feedbackframebuffer, nullptr);
+		vkDestroyRenderPass(m_device, feedbackpass, nullptr);
+		vkDestroyImageView(m_device, feedbackdepthview, nullptr);
+		vkDestroyImage(m_device, feedbackdepth, nullptr);
+		vkFreeMemory(m_device, feedbackdepthmemory, nullptr);
+		vkDestroySampler(m_device, atlassampler, nullptr);
+		vkDestroySampler(m_device, tablesampler, nullptr);
+		vkDestroyImageView(m_device, atlasview, nullptr);
+		vkDestroyImage(m_device, atlas, nullptr);
+		vkFreeMemory(m_device, atlasmemory, nullptr);
+		vkUnmapMemory(m_device, stagingmemory);
+		vkDestroyBuffer(m_device, stagingbuffer, nullptr);
+		vkFreeMemory(m_device, stagingmemory, nullptr);
+
+		infobuffer = VK_NULL_HANDLE;
+		infomemory = VK_NULL_HANDLE;
+		infodata = nullptr;
+		infoslot = BINDLESS_INVALID;
+		atlasslot = BINDLESS_INVALID;
+		feedbackframebuffer = VK_NULL_HANDLE;
+		feedbackpass = VK_NULL_HANDLE;
+		feedbackdepthview = VK_NULL_HANDLE;
+		feedbackdepth = VK_NULL_HANDLE;
+		feedbackdepthmemory = VK_NULL_HANDLE;
+		atlassampler = VK_NULL_HANDLE;
+		tablesampler = VK_NULL_HANDLE;
+		atlasview = VK_NULL_HANDLE;
+		atlas = VK_NULL_HANDLE;
+		atlasmemory = VK_NULL_HANDLE;
+		stagingbuffer = VK_NULL_HANDLE;
+		stagingmemory = VK_NULL_HANDLE;
+		stagingdata = nullptr;
+	}
+
+	DWord MetalVirtualTexturing::AddTexture(const MetalVirtualTextureDesc& desc, MetalPageReader reader, void* userdata)
+	{
+		if (desc.format != format)
+		{
+			WarningMessage("Virtual Texture WARNING", "Virtual texture is format %u but the page cache is format %u", desc.format, format);
+			return VT_INVALID;
+		}
+
+		DWord handle = resolver.AddTexture(desc, reader, userdata);
+		if (handle == VT_INVALID)
+		{
+			return VT_INVALID;
+		}
+
+		if (handle >= tables.size())
+		{
+			tables.resize(handle + 1);
+		}
+
+		PageTable& table = tables[handle];
+
+		VkImageCreateInfo ImageInfo = {};
+		ImageInfo.sType			= VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		ImageInfo.imageType		= VK_IMAGE_TYPE_2D;
+		ImageInfo.format		= VK_FORMAT_R8G8B8A8_UNORM;
+		ImageInfo.extent		= { desc.levels[0].pagesx, desc.levels[0].pagesy, 1 };
+		ImageInfo.mipLevels		= static_cast<VkUint32>(desc.levels.size());
+		ImageInfo.arrayLayers	= 1;
+		ImageInfo.samples		= VK_SAMPLE_COUNT_1_BIT;
+		ImageInfo.tiling		= VK_IMAGE_TILING_OPTIMAL;
+		ImageInfo.usage			= VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		ImageInfo.sharingMode	= VK_SHARING_MODE_EXCLUSIVE;
+		ImageInfo.initialLayout	= VK_IMAGE_LAYOUT_UNDEFINED;
+		CreateImageWithInfo(ImageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, table.image, table.memory);
+
+		VkImageViewCreateInfo ViewInfo = {};
+		ViewInfo.sType				= VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		ViewInfo.image				= table.image;
+		ViewInfo.viewType			= VK_IMAGE_VIEW_TYPE_2D;
+		ViewInfo.format				= ImageInfo.format;
+		ViewInfo.subresourceRange	= { VK_IMAGE_ASPECT_COLOR_BIT, 0, ImageInfo.mipLevels, 0, 1 };
+		VK_CHECK(vkCreateImageView(m_device, &ViewInfo, nullptr, &table.view));
+
+		/* Cleared (all unmapped) by the next Update before anything can sample it*/
+		table.slot = BindlessRegisterTexture(table.view, tablesampler);
+		table.cleared = false;
+
+		MetalGpuVirtualTexture Info = {};
+		Info.width		= static_cast<float>(desc.width);
+		Info.height		= static_cast<float>(desc.height);
+		Info.pagetable	= table.slot;
+		Info.levelcount	= static_cast<DWord>(desc.levels.size());
+		std::memcpy(infodata + sizeof(MetalGpuVirtualHeader) + sizeof(MetalGpuVirtualTexture) * handle, &Info, sizeof(Info));
+		return handle;
+	}
+
+	void MetalVirtualTexturing::RemoveTexture(DWord handle)
+	{
+		if (!resolver.IsAlive(handle))
+		{
+			return;
+		}
+
+		resolver.RemoveTexture(handle);
+		retired.push_back({ tables[handle], frame });
+		tables[handle] = PageTable();
+	}
+
+	void MetalVirtualTexturing::UploadTables(VkCommandBuffer commandbuffer)
+	{
+		Byte* Destination = stagingdata + tablestaging + VT_TABLE_STAGING_SIZE * CurrentFrame;
+		VkDeviceSize BaseOffset = tablestaging + VT_TABLE_STAGING_SIZE * CurrentFrame;
+		VkDeviceSize Used = 0;
+
+		for (DWord handle = 0; handle < tables.size(); handle++)
+		{
+			PageTable& table = tables[handle];
+			if (table.image == VK_NULL_HANDLE || !resolver.IsAlive(handle))
+			{
+				continue;
+			}
+
+			const MetalPageTable& Table = resolver.GetPageTable(handle);
+			VkUint32 levelcount = static_cast<VkUint32>(Table.dirty.size());
+
+			VkDeviceSize Needed = 0;
+			for (const MetalPageRect& rect : Table.dirty)
+			{
+				Needed += rect.IsEmpty() ? 0 : static_cast<VkDeviceSize>(rect.x1 - rect.x0) * (rect.y1 - rect.y0) * sizeof(DWord);
+			}
+
+			/* Nothing changed, or out of staging for this frame (it stays dirty until next frame)*/
+			if ((Needed == 0 && table.cleared) || Used + Needed > VT_TABLE_STAGING_SIZE)
+			{
+				continue;
+			}
+
+			VkImageMemoryBarrier Barrier = {};
+			Barrier.sType				= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			Barrier.srcAccessMask		= table.cleared ? VK_ACCESS_SHADER_READ_BIT : 0;
+			Barrier.dstAccessMask		= VK_ACCESS_TRANSFER_WRITE_BIT;
+			Barrier.oldLayout			= table.cleared ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+			Barrier.newLayout			= VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			Barrier.srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+			Barrier.dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+			Barrier.image				= table.image;
+			Barrier.subresourceRange	= { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelcount, 0, 1 };
+			vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				0, 0, nullptr, 0, nullptr, 1, &Barrier);
+
+			if (!table.cleared)
+			{
+				VkClearColorValue Unmapped = {};
+				vkCmdClearColorImage(commandbuffer, table.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &Unmapped, 1, &Barrier.subresourceRange);
+				table.cleared = true;
+			}
+
+			vector<VkBufferImageCopy> Copies;
+			for (VkUint32 level = 0; level < levelcount; level++)
+			{
+				const MetalPageRect& rect = Table.dirty[level];
+				if (rect.IsEmpty())
+				{
+					continue;
+				}
+
+				DWord RowWidth = resolver.GetDesc(handle).levels[level].pagesx;
+				DWord RectWidth = rect.x1 - rect.x0;
+				VkDeviceSize Offset = Used;
+				for (DWord y = rect.y0; y < rect.y1; y++)
+				{
+					std::memcpy(Destination + Used, &Table.entries[level][static_cast<usize>(y) * RowWidth + rect.x0], RectWidth * sizeof(DWord));
+					Used += RectWidth * sizeof(DWord);
+				}
+
+				VkBufferImageCopy Copy = {};
+				Copy.bufferOffset		= BaseOffset + Offset;
+				Copy.bufferRowLength	= RectWidth;
+				Copy.imageSubresource	= { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+				Copy.imageOffset		= { static_cast<int32_t>(rect.x0), static_cast<int32_t>(rect.y0), 0 };
+				Copy.imageExtent		= { RectWidth, rect.y1 - rect.y0, 1 };
+				Copies.push_back(Copy);
+			}
+
+			if (!Copies.empty())
+			{
+				vkCmdCopyBufferToImage(commandbuffer, stagingbuffer, table.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					static_cast<VkUint32>(Copies.size()), Copies.data());
+				MetalCounterAdd(METAL_COUNTER_BYTES_UPLOADED, static_cast<long long>(Needed));
+			}
+
+			Barrier.srcAccessMask	= VK_ACCESS_TRANSFER_WRITE_BIT;
+			Barrier.dstAccessMask	= VK_ACCESS_SHADER_READ_BIT;
+			Barrier.oldLayout		= VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			Barrier.newLayout		= VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				0, 0, nullptr, 0, nullptr, 1, &Barrier);
+
+			resolver.ClearDirty(handle);
+		}
+	}
+
+	void MetalVirtualTexturing::Update(VkCommandBuffer commandbuffer)
+	{
+		METAL_ZONE("Virtual Texture Update");
+		METAL_GPU_ZONE(commandbuffer, "Virtual Texture Uploads");
+
+		frame++;
+
+		/* Page tables removed MAXIMUM_FRAMES_IN_FLIGHTS frames ago are no longer sampled*/
+		usize kept = 0;
+		for (usize i = 0; i < retired.size(); i++)
+		{
+			if (retired[i].frame + MAXIMUM_FRAMES_IN_FLIGHTS <= frame)
+			{
+				DestroyTable(retired[i].table);
+			}
+			else
+			{
+				retired[kept++] = retired[i];
+			}
+		}
+		retired.resize(kept);
+
+		/* This frame slot's fence was waited on in AcquireNextImage, so its feedback is complete*/
+		usize FeedbackCount = static_cast<usize>(feedbackextent.width) * feedbackextent.height;
+		resolver.ProcessFeedback(feedbackdata[CurrentFrame], FeedbackCount);
+
+		uploads.clear();
+		resolver.Update(uploads);
+
+		if (!uploads.empty())
+		{
+			VkImageMemoryBarrier Barrier = {};
+			Barrier.sType				= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			Barrier.srcAccessMask		= VK_ACCESS_SHADER_READ_BIT;
+			Barrier.dstAccessMask		= VK_ACCESS_TRANSFER_WRITE_BIT;
+			Barrier.oldLayout			= VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			Barrier.newLayout			= VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			Barrier.srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+			Barrier.dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+			Barrier.image				= atlas;
+			Barrier.subresourceRange	= { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				0, 0, nullptr, 0, nullptr, 1, &Barrier);
+
+			vector<VkBufferImageCopy> Copies(uploads.size());
+			for (usize i = 0; i < uploads.size(); i++)
+			{
+				Copies[i] = {};
+				Copies[i].bufferOffset		= resolver.GetStagingPage(uploads[i].staging) - stagingdata;
+				Copies[i].imageSubresource	= { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+				Copies[i].imageOffset		= { static_cast<int32_t>((uploads[i].slot % cachewidth) * VT_PAGE_TEXELS),
+												static_cast<int32_t>((uploads[i].slot / cachewidth) * VT_PAGE_TEXELS), 0 };
+				Copies[i].imageExtent		= { VT_PAGE_TEXELS, VT_PAGE_TEXELS, 1 };
+			}
+			vkCmdCopyBufferToImage(commandbuffer, stagingbuffer, atlas, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				static_cast<VkUint32>(Copies.size()), Copies.data());
+			MetalCounterAdd(METAL_COUNTER_BYTES_UPLOADED, static_cast<long long>(uploads.size() * resolver.GetPageBytes()));
+
+			Barrier.srcAccessMask	= VK_ACCESS_TRANSFER_WRITE_BIT;
+			Barrier.dstAccessMask	= VK_ACCESS_SHADER_READ_BIT;
+			Barrier.oldLayout		= VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			Barrier.newLayout		= VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				0, 0, nullptr, 0, nullptr, 1, &Barrier);
+		}
+
+		UploadTables(commandbuffer);
+
+		/* Empty this frame's feedback before the feedback pass writes into it*/
+		vkCmdFillBuffer(commandbuffer, feedbackbuffers[CurrentFrame], 0, VK_WHOLE_SIZE, VT_FEEDBACK_NONE);
+	}
+
+	void MetalVirtualTexturing::BeginFeedbackPass(VkCommandBuffer commandbuffer)
+	{
+#if defined(METAL_PROFILE)
+		feedbackzone = GpuZoneBegin(commandbuffer, "Virtual Texture Feedback");
+#endif
+
+		VkClearValue Clear = {};
+		Clear.depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo BeginInfo = {};
+		BeginInfo.sType				= VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		BeginInfo.renderPass		= feedbackpass;
+		BeginInfo.framebuffer		= feedbackframebuffer;
+		BeginInfo.renderArea.extent	= feedbackextent;
+		BeginInfo.clearValueCount	= 1;
+		BeginInfo.pClearValues		= &Clear;
+		vkCmdBeginRenderPass(commandbuffer, &BeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport Viewport = { 0.0f, 0.0f, static_cast<float>(feedbackextent.width), static_cast<float>(feedbackextent.height), 0.0f, 1.0f };
+		VkRect2D Scissor = { { 0, 0 }, feedbackextent };
+		vkCmdSetViewport(commandbuffer, 0, 1, &Viewport);
+		vkCmdSetScissor(commandbuffer, 0, 1, &Scissor);
+	}
+
+	void MetalVirtualTexturing::EndFeedbackPass(VkCommandBuffer commandbuffer)
+	{
+		vkCmdEndRenderPass(commandbuffer);
+
+		/* Read on the CPU once the frame's fence has been waited on*/
+		VkBufferMemoryBarrier Barrier = {};
+		Barrier.sType				= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		Barrier.srcAccessMask		= VK_ACCESS_SHADER_WRITE_BIT;
+		Barrier.dstAccessMask		= VK_ACCESS_HOST_READ_BIT;
+		Barrier.srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		Barrier.dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		Barrier.buffer				= feedbackbuffers[CurrentFrame];
+		Barrier.offset				= 0;
+		Barrier.size				= VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+			0, 0, nullptr, 1, &Barrier, 0, nullptr);
+
+#if defined(METAL_PROFILE)
+		GpuZoneEnd(commandbuffer, feedbackzone);
+		feedbackzone = GPU_PROFILER_INVALID;
+#endif
+	}
+}
@@ -0,0 +1,316 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine animation (skeletons, compressed clips, pose blending, skinning matrices)
+// ------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "MTypes.hpp"
+#include "MDataPackage.h"
+
+namespace engine::animation
+{
+	inline constexpr DWord SKELETON_MAGIC = 0x4C4B534D;			/* "MSKL"*/
+	inline constexpr DWord ANIMATION_CLIP_MAGIC = 0x4D4E414D;	/* "MANM"*/
+	inline constexpr DWord ANIMATION_VERSION = 1;
+	inline constexpr DWord ANIMATION_MAX_JOINTS = 1024;
+	inline constexpr Word ANIMATION_NO_PARENT = 0xFFFF;
+
+	/* Pose channels are padded to a multiple of this many joints, the widest SIMD path does 8 at once*/
+	inline constexpr DWord ANIMATION_JOINT_ALIGNMENT = 8;
+
+	/* Deepest a blend tree may nest, characters with deeper trees are not evaluated*/
+	inline constexpr DWord ANIMATION_MAX_BLEND_DEPTH = 16;
+
+	/* A joint relative to its parent*/
+	struct MetalJointTransform
+	{
+		vec3f	translation;
+		quatf	rotation;
+		vec3f	scale		= vec3f(1.0f, 1.0f, 1.0f);
+	};
+
+	/* Upper three rows of an affine matrix, the layout skinning matrices are uploaded in (std430)*/
+	struct MetalSkinMatrix
+	{
+		vec4f	rows[3];
+	};
+
+	static_assert(sizeof(MetalSkinMatrix) == 48, "MetalSkinMatrix has to match the std430 layout skinning shaders read");
+
+	/* Metal Skeleton
+		- parents	  -> Parent of every joint, ANIMATION_NO_PARENT for roots, parents always come before their children
+		- bindpose	  -> Local transforms the mesh was skinned in
+		- inversebind -> Model space to joint space of the bind pose
+	*/
+	struct MetalSkeleton
+	{
+		std::vector<Word>				parents;
+		std::vector<MetalJointTransform>	bindpose;
+		std::vector<MetalSkinMatrix>		inversebind;
+
+		DWord GetJointCount() const { return static_cast<DWord>(parents.size()); }
+	};
+
+	/* Header of a MEPF_ENTRY_SKELETON entry, followed by jointcount MetalJointTransform,
+		jointcount MetalSkinMatrix and jointcount Word parents
+	*/
+	struct MetalSkeletonHeader
+	{
+		DWord	magic;
+		DWord	version;
+		DWord	jointcount;
+		DWord	reserved;
+	};
+
+	/* Channels of a pose, each one is a run of MetalPose::stride floats*/
+	enum MetalPoseChannel
+	{
+		POSE_TRANSLATION_X = 0,
+		POSE_TRANSLATION_Y,
+		POSE_TRANSLATION_Z,
+		POSE_ROTATION_X,
+		POSE_ROTATION_Y,
+		POSE_ROTATION_Z,
+		POSE_ROTATION_W,
+		POSE_SCALE_X,
+		POSE_SCALE_Y,
+		POSE_SCALE_Z,
+		POSE_CHANNEL_COUNT
+	};
+
+	/*
+		Local joint transforms as structure-of-arrays, so sampling and blending work on a whole
+		SIMD register of joints per instruction. Padding joints past jointcount hold the identity.
+	*/
+	struct MetalPose
+	{
+		DWord				jointcount	= 0;
+		DWord				stride		= 0;	/* jointcount rounded up to ANIMATION_JOINT_ALIGNMENT*/
+		std::vector<float>	channels;
+
+		/**
+		* @brief Sizes the pose for a skeleton, every joint is reset to the identity when the size changes
+		* @returns void
+		*/
+		void Resize(DWord count);
+
+		float* Channel(DWord channel) { return channels.data() + static_cast<usize>(channel) * stride; }
+		const float* Channel(DWord channel) const { return channels.data() + static_cast<usize>(channel) * stride; }
+
+		void SetJoint(DWord joint, const MetalJointTransform& transform);
+		MetalJointTransform GetJoint(DWord joint) const;
+	};
+
+	/* One track of a compressed clip, the keys of one joint's translation, rotation or scale
+		- firstkey, keycount -> Range of the clip's key tables, one key is a constant track
+		- minimum, extent	 -> Translation and scale keys dequantize as minimum + key / 65535 * extent,
+								rotations are smallest-three quaternions and don't use them
+	*/
+	struct MetalClipTrack
+	{
+		DWord	firstkey;
+		DWord	keycount;
+		float	minimum[3];
+		float	extent[3];
+	};
+
+	/* Header of a MEPF_ENTRY_ANIMATION entry, followed by jointcount * 3 MetalClipTrack (translation,
+		rotation and scale of every joint), keycount Word frames and keycount * 3 Word values
+	*/
+	struct MetalClipHeader
+	{
+		DWord	magic;
+		DWord	version;
+		DWord	jointcount;
+		DWord	framecount;		/* Frames the clip was cooked from, keys are on these frames*/
+		float	framerate;
+		float	duration;		/* Seconds from the first frame to the last*/
+		DWord	keycount;		/* Over every track*/
+		DWord	reserved;
+	};
+
+	/* A cooked clip in memory, exactly as it is stored*/
+	struct MetalCompressedClip
+	{
+		MetalClipHeader				header = {};
+		std::vector<MetalClipTrack>	tracks;		/* Track t of joint j is tracks[j * 3 + t]*/
+		std::vector<Word>			keyframes;
+		std::vector<Word>			keyvalues;	/* Three per key*/
+	};
+
+	/* A clip the way importers hand it over, every joint sampled on every frame
+		- frames -> Frame major, joint j of frame f is frames[f * jointcount + j]
+		Looping clips should end on the pose they start with, the last frame is not blended into the first
+	*/
+	struct MetalClipSource
+	{
+		DWord								jointcount	= 0;
+		DWord								framecount	= 0;
+		float								framerate	= 30.0f;
+		std::vector<MetalJointTransform>	frames;
+	};
+
+	/* How far CookClip may stray from the source, keys are dropped wherever interpolation stays inside these*/
+	struct MetalClipCookSettings
+	{
+		float	translationerror	= 0.0005f;	/* In skeleton units*/
+		float	rotationerror		= 0.0005f;	/* Per quaternion component*/
+		float	scaleerror			= 0.0005f;
+	};
+
+	/* What a blend tree node does
+		- BLEND_NODE_CLIP	  -> Samples clips[clip] at the time in parameters[parameter]
+		- BLEND_NODE_LERP	  -> Blends inputs[0] towards inputs[1] by the weight in parameters[parameter]
+		- BLEND_NODE_ADDITIVE -> Adds inputs[1] on top of inputs[0] by the weight in parameters[parameter],
+								 inputs[1] has to hold deltas (translation offsets, rotations from the
+								 reference pose in joint space and scale factors)
+	*/
+	enum MetalBlendNodeType
+	{
+		BLEND_NODE_CLIP = 0,
+		BLEND_NODE_LERP,
+		BLEND_NODE_ADDITIVE
+	};
+
+	struct MetalBlendNode
+	{
+		DWord	type		= BLEND_NODE_CLIP;
+		DWord	clip		= 0;
+		DWord	parameter	= 0;
+		DWord	inputs[2]	= {};
+		bool	loop		= true;		/* Clip nodes wrap the time instead of holding the last frame*/
+	};
+
+	/* Nodes of one tree, shared by every character it animates. Parameters live with the character.*/
+	struct MetalBlendTree
+	{
+		std::vector<MetalBlendNode>	nodes;
+		DWord						root	= 0;
+	};
+
+	/* Metal Character
+		- skeleton, tree, clips -> What it is animated with, all of them can be shared between characters
+		- parameters			-> Clip times and blend weights the tree's nodes read
+		- skinmatrices			-> Receives one matrix per joint, usually straight into a mapped buffer
+	*/
+	struct MetalCharacter
+	{
+		const MetalSkeleton*				skeleton		= nullptr;
+		const MetalBlendTree*				tree			= nullptr;
+		const MetalCompressedClip* const*	clips			= nullptr;
+		DWord								clipcount		= 0;
+		const float*						parameters		= nullptr;
+		DWord								parametercount	= 0;
+		MetalSkinMatrix*					skinmatrices	= nullptr;
+	};
+
+	/* Working memory of sampling, blending and skinning. Reused between calls so a warm frame allocates nothing, one per thread.*/
+	struct MetalAnimationScratch
+	{
+		MetalPose						next;		/* Keys after the sample time*/
+		std::vector<float>				alpha;		/* Interpolation factor of every track, 3 runs of stride floats*/
+		std::vector<MetalPose>			poses;		/* Blend tree intermediates*/
+		std::vector<float>				locals;		/* Local matrices, 12 runs of stride floats*/
+		std::vector<MetalSkinMatrix>	model;		/* Model space matrices*/
+	};
+
+	/**
+	* @brief Builds a skeleton and its inverse bind matrices
+	* @param parents -> Parent of every joint, parents have to come before their children
+	* @param bindpose -> Local bind transforms
+	* @param jointcount -> Number of joints
+	* @param skeleton -> Receives the skeleton
+	* @returns 0 if successed 1 if failure
+	*/
+	int BuildSkeleton(const Word* parents, const MetalJointTransform* bindpose, DWord jointcount, MetalSkeleton& skeleton);
+
+	/**
+	* @brief Compresses a clip, rotations become smallest-three quaternions and every track keeps only the keys
+	*	linear interpolation can't get within the settings' error from
+	* @returns 0 if successed 1 if failure
+	*/
+	int CookClip(const MetalClipSource& source, MetalCompressedClip& clip, const MetalClipCookSettings& settings = {});
+
+	/**
+	* @brief Writes a skeleton as a MEPF_ENTRY_SKELETON entry
+	* @returns 0 if successed 1 if failure
+	*/
+	int WritePackageSkeleton(MEPF* package, const char* name, const MetalSkeleton& skeleton);
+
+	/**
+	* @brief Reads a MEPF_ENTRY_SKELETON entry
+	* @returns 0 if successed 1 if failure
+	*/
+	int ReadPackageSkeleton(MEPF* package, const char* name, MetalSkeleton& skeleton);
+
+	/**
+	* @brief Writes a cooked clip as a MEPF_ENTRY_ANIMATION entry
+	* @returns 0 if successed 1 if failure
+	*/
+	int WritePackageClip(MEPF* package, const char* name, const MetalCompressedClip& clip);
+
+	/**
+	* @brief Reads a MEPF_ENTRY_ANIMATION entry, clips are small and are read whole
+	* @returns 0 if successed 1 if failure
+	*/
+	int ReadPackageClip(MEPF* package, const char* name, MetalCompressedClip& clip);
+
+	/**
+	* @brief Samples a clip
+	* @param clip -> The clip
+	* @param time -> Seconds from the start
+	* @param loop -> Wrap the time around the clip's duration instead of holding the last frame
+	* @param pose -> Receives the pose, sized for the clip's joints
+	* @param scratch -> Working memory
+	* @returns void
+	*/
+	void SampleClip(const MetalCompressedClip& clip, float time, bool loop, MetalPose& pose, MetalAnimationScratch& scratch);
+
+	/**
+	* @brief Blends two poses of the same skeleton, rotations are normalized lerps along the shorter arc
+	* @param weight -> 0 is a, 1 is b
+	* @param result -> Can be a or b
+	* @returns void
+	*/
+	void BlendPoses(const MetalPose& a, const MetalPose& b, float weight, MetalPose& result);
+
+	/**
+	* @brief Adds a pose of deltas on top of another
+	* @param weight -> How much of the deltas to add
+	* @param result -> Can be base or additive
+	* @returns void
+	*/
+	void AddPoses(const MetalPose& base, const MetalPose& additive, float weight, MetalPose& result);
+
+	/**
+	* @brief Turns a local pose into skinning matrices (model space times inverse bind)
+	* @param skeleton -> The skeleton the pose is of
+	* @param pose -> Local pose
+	* @param skinmatrices -> Receives one matrix per joint, written in order and never read back so it can be write combined memory
+	* @param scratch -> Working memory
+	* @returns void
+	*/
+	void BuildSkinMatrices(const MetalSkeleton& skeleton, const MetalPose& pose, MetalSkinMatrix* skinmatrices, MetalAnimationScratch& scratch);
+
+	/**
+	* @brief Evaluates a character's blend tree and writes its skinning matrices
+	* @returns 0 if successed 1 if failure (nothing is written)
+	*/
+	int EvaluateCharacter(const MetalCharacter& character, MetalAnimationScratch& scratch);
+
+	/**
+	* @brief Evaluates many characters across the job system's workers
+	* @param characters -> The characters
+	* @param count -> Number of characters
+	* @returns Number of characters that were evaluated
+	*/
+	DWord EvaluateCharacters(const MetalCharacter* characters, DWord count);
+}
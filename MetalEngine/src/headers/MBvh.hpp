@@ -0,0 +1,181 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine bounding volume hierarchy (scene spatial index)
+// ------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "MTypes.hpp"
+#include "MCulling.hpp"
+
+namespace engine::spatial
+{
+	using engine::culling::MetalFrustum;
+
+	inline constexpr DWord BVH_INVALID			= 0xFFFFFFFF;
+	inline constexpr DWord BVH_WIDTH			= 4;	/* Children per node, tested together with SSE*/
+	inline constexpr DWord BVH_MAX_LEAF_SIZE	= 4;	/* Objects per leaf before the builder is forced to split*/
+	inline constexpr DWord BVH_SAH_BINS			= 16;
+
+	/* Axis aligned bounding box in world space*/
+	struct MetalAABB
+	{
+		vec3f min;
+		vec3f max;
+
+		MetalAABB() : min(1e30f, 1e30f, 1e30f), max(-1e30f, -1e30f, -1e30f) {}
+		MetalAABB(const vec3f& mn, const vec3f& mx) : min(mn), max(mx) {}
+
+		bool IsEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+		vec3f Center() const { return vec3f((min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f); }
+		vec3f Extents() const { return vec3f((max.x - min.x) * 0.5f, (max.y - min.y) * 0.5f, (max.z - min.z) * 0.5f); }
+
+		void Grow(const vec3f& p);
+		void Grow(const MetalAABB& b);
+		float SurfaceArea() const;
+	};
+
+	/**
+	* @brief Transforms a local space box by a world matrix and returns the box around the result
+	*/
+	MetalAABB TransformAABB(const MetalAABB& local, const mat4f& world);
+
+	/*
+		4-wide node, two cache lines. Child bounds are stored per axis so one SSE load
+		gets the same bound of all four children.
+		- count[i] == 0 -> child[i] is another node (or BVH_INVALID for an empty slot)
+		- count[i] > 0  -> child[i] is the first entry in the primitive list of a leaf
+	*/
+	struct alignas(64) MetalBvhNode
+	{
+		float	minx[BVH_WIDTH];
+		float	miny[BVH_WIDTH];
+		float	minz[BVH_WIDTH];
+		float	maxx[BVH_WIDTH];
+		float	maxy[BVH_WIDTH];
+		float	maxz[BVH_WIDTH];
+		DWord	child[BVH_WIDTH];
+		Byte	count[BVH_WIDTH];
+		DWord	parent;
+		DWord	parentslot;
+	};
+
+	/* Result of a ray cast*/
+	struct MetalRayHit
+	{
+		DWord object	= BVH_INVALID;
+		float distance	= 0.0f;
+	};
+
+	/* Optional exact test for ray casts, called for every object whose box the ray enters.
+		Returns the distance along the ray to the real hit or a negative number for a miss.
+		Without one the box itself counts as the hit (fine for picking and audio occlusion).
+	*/
+	typedef float (*MetalRayFilter)(DWord object, const vec3f& origin, const vec3f& direction, void* userdata);
+
+	class MetalBvh
+	{
+	public:
+		/**
+		* @brief Builds the tree with binned SAH over the given bounds, object ids are the indices into bounds
+		* @param bounds -> World space box of every object
+		* @returns void
+		*/
+		void Build(const std::vector<MetalAABB>& bounds);
+
+		/**
+		* @brief Rebuilds from the bounds currently stored, do this when refits have made the tree too loose
+		* @returns void
+		*/
+		void Rebuild();
+
+		/**
+		* @brief Changes the box of an object, the tree is fixed up on the next Refit
+		* @param object -> The object id
+		* @param bounds -> The new world space box
+		* @returns void
+		*/
+		void UpdateObject(DWord object, const MetalAABB& bounds);
+
+		/**
+		* @brief Changes the box of an object from its transform
+		* @param object -> The object id
+		* @param transform -> The object's new transform
+		* @param localbounds -> The object's box in its own space
+		* @returns void
+		*/
+		void UpdateObject(DWord object, const trans3f& transform, const MetalAABB& localbounds);
+
+		/**
+		* @brief Refits the nodes above every object updated since the last call, walking up
+		*	only until a parent's box stops changing
+		* @returns The number of nodes touched
+		*/
+		DWord Refit();
+
+		/**
+		* @brief Finds the closest object hit by a ray
+		* @param origin -> Start of the ray
+		* @param direction -> Direction of the ray (does not need to be normalized, distance is in its units)
+		* @param maxdistance -> Ignore hits past this
+		* @param hit -> Receives the closest hit
+		* @param filter -> Exact per-object test (nullptr uses the box)
+		* @param userdata -> Handed to filter
+		* @returns true if something was hit
+		*/
+		bool RayCast(const vec3f& origin, const vec3f& direction, float maxdistance, MetalRayHit& hit,
+			MetalRayFilter filter = nullptr, void* userdata = nullptr) const;
+
+		/**
+		* @brief Finds every object whose box overlaps a box
+		* @param box -> The query box
+		* @param results -> Object ids are appended here
+		* @returns The number of objects appended
+		*/
+		DWord OverlapAABB(const MetalAABB& box, std::vector<DWord>& results) const;
+
+		/**
+		* @brief Finds every object whose box is inside or touching the frustum. Subtrees
+		*	that are fully inside are appended without testing anything below them.
+		* @param frustum -> The camera frustum
+		* @param results -> Object ids are appended here
+		* @returns The number of objects appended
+		*/
+		DWord FrustumQuery(const MetalFrustum& frustum, std::vector<DWord>& results) const;
+
+		const MetalAABB& GetObjectBounds(DWord object) const { return objectbounds[object]; }
+		const std::vector<MetalBvhNode>& GetNodes() const { return nodes; }
+		DWord GetObjectCount() const { return static_cast<DWord>(objectbounds.size()); }
+
+	protected:
+		struct BuildNode
+		{
+			MetalAABB	bounds;
+			DWord		left;
+			DWord		right;
+			DWord		first;
+			DWord		count;
+		};
+
+		DWord BuildRecursive(std::vector<BuildNode>& build, const std::vector<vec3f>& centroids, DWord first, DWord count);
+		DWord Collapse(const std::vector<BuildNode>& build, DWord binary, DWord parent, DWord parentslot);
+		void SetSlot(MetalBvhNode& node, DWord slot, const MetalAABB& bounds);
+		MetalAABB NodeBounds(const MetalBvhNode& node) const;
+		void AppendSubtree(DWord node, std::vector<DWord>& results) const;
+
+		std::vector<MetalBvhNode>	nodes;
+		std::vector<DWord>			primitives;		/* Object ids in leaf order*/
+		std::vector<MetalAABB>		objectbounds;
+		std::vector<DWord>			objectnode;		/* Node holding the object's leaf*/
+		std::vector<Byte>			objectslot;		/* Slot of the leaf in that node*/
+		std::vector<DWord>			dirty;
+		std::vector<Byte>			isdirty;
+	};
+}
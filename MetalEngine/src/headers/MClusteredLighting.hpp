@@ -0,0 +1,101 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine clustered lighting (cluster grid, light assignment, CPU reference of cluster_lights.comp)
+// ------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "MTypes.hpp"
+
+namespace engine::lighting
+{
+	/* Clusters along each axis, x and y split the screen and z splits depth exponentially.
+		Has to match the defines in cluster_lights.comp and material.frag
+	*/
+	inline constexpr DWord CLUSTER_GRID_X		= 16;
+	inline constexpr DWord CLUSTER_GRID_Y		= 9;
+	inline constexpr DWord CLUSTER_GRID_Z		= 24;
+	inline constexpr DWord CLUSTER_COUNT		= CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+
+	/* Most lights one cluster keeps, the rest are dropped so a pixel never loops over more than this*/
+	inline constexpr DWord CLUSTER_MAX_LIGHTS	= 256;
+
+	/* Light arrays are padded to this many entries so the SIMD loops never need a scalar tail*/
+	inline constexpr DWord CLUSTER_LIGHTS_ALIGNMENT = 16;
+
+	/* One point light (mirrors MetalLight in cluster_lights.comp and material.frag, std430)*/
+	struct MetalPointLight
+	{
+		vec4f	positionradius;		/* World space position, w is the radius the light fades out at*/
+		vec4f	colorintensity;		/* Linear color, w scales it*/
+	};
+
+	static_assert(sizeof(MetalPointLight) == 32, "MetalPointLight has to match the std430 layout in cluster_lights.comp");
+
+	/* Where a cluster's lights are in the index list (mirrors uClusters in material.frag)*/
+	struct MetalClusterRange
+	{
+		DWord	offset;
+		DWord	count;
+	};
+
+	/* Metal Cluster Grid
+		- view -> World to view space, view space looks down +Z
+		- projx, projy -> What the projection scales view x and y by (clip.x = projx * x, clip.y = projy * y)
+		- nearz, farz -> View depth the grid covers, slice k starts at nearz * (farz / nearz)^(k / CLUSTER_GRID_Z)
+		The projection has to be a symmetric perspective with clip.w = view z, like the one MetalRenderBench uses
+	*/
+	struct MetalClusterGrid
+	{
+		mat4f	view;
+		float	projx	= 1.0f;
+		float	projy	= 1.0f;
+		float	nearz	= 0.1f;
+		float	farz	= 1000.0f;
+	};
+
+	/**
+	* @brief Finds the depth slice a view depth falls into, depths outside the grid clamp to the first or last slice
+	* @returns The slice, 0 to CLUSTER_GRID_Z - 1
+	*/
+	DWord GetClusterSlice(const MetalClusterGrid& grid, float viewz);
+
+	/**
+	* @brief View space bounding box of a cluster, the box around the frustum piece so it is a little loose off axis
+	* @param grid -> The grid
+	* @param x -> Column, 0 is the left edge of the screen
+	* @param y -> Row, 0 is the top edge of the screen (Vulkan clip space, y down)
+	* @param z -> Depth slice
+	* @param boxmin -> Receives the box's minimum corner
+	* @param boxmax -> Receives the box's maximum corner
+	* @returns void
+	*/
+	void GetClusterBounds(const MetalClusterGrid& grid, DWord x, DWord y, DWord z, vec3f& boxmin, vec3f& boxmax);
+
+	/* Compact per cluster light lists, the layout cluster_lights.comp writes and material.frag reads*/
+	struct MetalClusterLightList
+	{
+		std::vector<MetalClusterRange>	clusters;	/* CLUSTER_COUNT ranges, cluster = x + CLUSTER_GRID_X * (y + CLUSTER_GRID_Y * z)*/
+		std::vector<DWord>				indices;	/* Light indices, ascending within each cluster*/
+		DWord							dropped = 0;	/* Light and cluster pairs past CLUSTER_MAX_LIGHTS*/
+	};
+
+	/**
+	* @brief CPU reference of cluster_lights.comp. Every depth slice first keeps the lights that reach its depth range,
+	*	then tests those against each of its clusters' boxes 16 at a time with AVX-512, 8 with AVX2 or one by one otherwise.
+	*	Slices are spread across the job system workers.
+	* @param grid -> The grid
+	* @param lights -> The lights
+	* @param count -> Number of lights
+	* @param result -> Receives the ranges and the index list, the cluster order of the list is deterministic
+	* @returns Number of light indices written
+	*/
+	DWord AssignLights(const MetalClusterGrid& grid, const MetalPointLight* lights, DWord count, MetalClusterLightList& result);
+}
@@ -0,0 +1,117 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine performance counters (named counters, frame time percentiles, CSV dumps)
+// ------------------------------------------------------
+
+#ifndef MCOUNTERS_H
+#define MCOUNTERS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/* Counter kinds
+	- FRAME		-> Added to during a frame and reset when it ends (draw calls, submits...)
+	- TOTAL		-> Only ever added to (allocations made since startup)
+	- GAUGE		-> Set to the current value (memory in use)
+	- HISTOGRAM	-> Every sample is kept for the last METAL_COUNTER_WINDOW samples for percentiles
+*/
+#define METAL_COUNTER_KIND_FRAME		0
+#define METAL_COUNTER_KIND_TOTAL		1
+#define METAL_COUNTER_KIND_GAUGE		2
+#define METAL_COUNTER_KIND_HISTOGRAM	3
+
+#define METAL_COUNTER_MAX		128
+#define METAL_COUNTER_WINDOW	1024
+#define METAL_COUNTER_INVALID	0xFFFFFFFFu
+
+/* Counters the engine itself fills in, always registered*/
+#define METAL_COUNTER_FRAME_TIME			0	/* Histogram, milliseconds between MetalCountersEndFrame calls*/
+#define METAL_COUNTER_QUEUE_SUBMITS			1	/* Frame, vkQueueSubmit calls*/
+#define METAL_COUNTER_DRAW_CALLS			2	/* Frame, vkCmdDraw* calls (an indirect draw counts once)*/
+#define METAL_COUNTER_PIPELINE_BINDS		3	/* Frame, vkCmdBindPipeline calls*/
+#define METAL_COUNTER_DESCRIPTOR_WRITES		4	/* Frame, descriptors written through vkUpdateDescriptorSets*/
+#define METAL_COUNTER_BYTES_UPLOADED		5	/* Frame, bytes copied from staging memory to the GPU*/
+#define METAL_COUNTER_FENCE_WAIT			6	/* Histogram, microseconds AcquireNextImage waited on the frame fence*/
+#define METAL_COUNTER_DEVICE_ALLOCATIONS	7	/* Total, vkAllocateMemory calls*/
+#define METAL_COUNTER_DEVICE_BYTES			8	/* Total, bytes asked of vkAllocateMemory*/
+#define METAL_COUNTER_HEAP_USAGE			9	/* Gauge, device local bytes in use (needs VK_EXT_memory_budget)*/
+#define METAL_COUNTER_HEAP_BUDGET			10	/* Gauge, device local bytes the driver says we may use*/
+#define METAL_COUNTER_BUILTIN_COUNT			11
+
+	/**
+	* @brief Finds or registers a counter, thread safe
+	* @param name -> Copied, a name already registered returns the existing counter
+	* @param kind -> METAL_COUNTER_KIND_*
+	* @returns The counter or METAL_COUNTER_INVALID if all METAL_COUNTER_MAX are taken (or the kind differs)
+	*/
+	unsigned int MetalCounterRegister(const char* name, int kind);
+
+	/**
+	* @brief Finds a counter by name
+	* @returns The counter or METAL_COUNTER_INVALID
+	*/
+	unsigned int MetalCounterFind(const char* name);
+
+	/**
+	* @brief Updates a counter from any thread, these are a relaxed atomic each
+	* @returns void
+	*/
+	void MetalCounterAdd(unsigned int counter, long long value);
+	void MetalCounterSet(unsigned int counter, long long value);
+	void MetalCounterSample(unsigned int counter, double value);
+
+	/**
+	* @brief Ends the frame: samples METAL_COUNTER_FRAME_TIME, moves FRAME counters into their
+	*	last frame value and writes a CSV row when one is due. Call once per frame from one thread.
+	* @returns void
+	*/
+	void MetalCountersEndFrame(void);
+
+	/**
+	* @brief Value of a counter, FRAME counters give the last finished frame, HISTOGRAM ones the last sample
+	*/
+	long long MetalCounterValue(unsigned int counter);
+
+	/**
+	* @brief Percentile of a HISTOGRAM counter over its window
+	* @param percentile -> 0...100 (50 = median)
+	* @returns The value or 0 if there are no samples
+	*/
+	double MetalCounterPercentile(unsigned int counter, double percentile);
+
+	/**
+	* @brief Registered counters, they are numbered 0...count-1
+	*/
+	unsigned int MetalCounterCount(void);
+	const char* MetalCounterName(unsigned int counter);
+	int MetalCounterKind(unsigned int counter);
+
+	/**
+	* @brief Starts writing a CSV row every interval frames (FRAME counters are averaged over the interval,
+	*	histograms give p50/p95/p99/max over their window). Counters registered after this are not in the file.
+	* @param path -> File to write, truncated
+	* @param intervalframes -> Frames between rows (0 = 60)
+	* @returns 0 if successed 1 if failure
+	*/
+	int MetalCountersOpenCsv(const char* path, unsigned int intervalframes);
+	void MetalCountersCloseCsv(void);
+
+	/**
+	* @brief Writes a short summary for a HUD or the window title ("16.6ms p95 17.1ms p99 18.0ms 120 draws...")
+	* @returns Characters written, like snprintf
+	*/
+	int MetalCountersFormat(char* buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,169 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine visibility culling (frustum and software occlusion)
+// ------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "MTypes.hpp"
+
+namespace engine::culling
+{
+	/* Bounds are padded to this many entries so the SIMD loops never need a scalar tail*/
+	inline constexpr DWord CULL_BOUNDS_ALIGNMENT = 16;
+
+	/* Objects per job when culling is spread over the workers*/
+	inline constexpr DWord CULL_BATCH_SIZE = 1024;
+
+	/* Metal Frustum
+		- planes -> left, right, bottom, top, near, far (xyz = normal, w = distance)
+		A point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0
+	*/
+	struct MetalFrustum
+	{
+		vec4f planes[6];
+	};
+
+	/**
+	* @brief Pulls the six frustum planes out of a view-projection matrix (Vulkan clip space, depth 0..1)
+	* @param viewproj -> The camera's view-projection matrix in the row layout of mat4
+	* @returns The normalized frustum planes
+	*/
+	MetalFrustum ExtractFrustum(const mat4f& viewproj);
+
+	/**
+	* @brief Per-entity bounding volumes stored as structure-of-arrays so 8 or 16 entities
+	*	can be loaded into one register. Every entity has an AABB (center + half extents)
+	*	and a bounding sphere sharing the same center.
+	*/
+	class MetalCullBounds
+	{
+	public:
+		/**
+		* @brief Resizes the arrays, new entries are empty and never visible
+		* @param count -> Number of entities
+		* @returns void
+		*/
+		void Resize(DWord count);
+
+		/**
+		* @brief Sets the bounds of an entity, the sphere radius is the length of the extents
+		* @param index -> The entity
+		* @param center -> Center of the AABB and sphere in world space
+		* @param extents -> Half size of the AABB in world space
+		* @returns void
+		*/
+		void Set(DWord index, const vec3f& center, const vec3f& extents);
+
+		/**
+		* @brief Sets the bounds of an entity with a tighter sphere than the AABB would give
+		* @returns void
+		*/
+		void Set(DWord index, const vec3f& center, const vec3f& extents, float radius);
+
+		vec3f GetCenter(DWord index) const { return vec3f(centerx[index], centery[index], centerz[index]); }
+		vec3f GetExtents(DWord index) const { return vec3f(extentx[index], extenty[index], extentz[index]); }
+
+		DWord Count() const { return count; }
+
+		/* Count rounded up to CULL_BOUNDS_ALIGNMENT, the padding entries have a negative radius*/
+		DWord PaddedCount() const { return static_cast<DWord>(radius.size()); }
+
+		std::vector<float> centerx;
+		std::vector<float> centery;
+		std::vector<float> centerz;
+		std::vector<float> extentx;
+		std::vector<float> extenty;
+		std::vector<float> extentz;
+		std::vector<float> radius;
+
+	protected:
+		DWord count = 0;
+	};
+
+	/**
+	* @brief Tests every entity against the frustum, 16 at a time with AVX-512, 8 with AVX2
+	*	or one by one otherwise, spread across the job system workers
+	* @param bounds -> The entities
+	* @param frustum -> The camera frustum
+	* @param visible -> Receives the indices of visible entities in ascending order
+	* @returns The number of visible entities
+	*/
+	DWord FrustumCull(const MetalCullBounds& bounds, const MetalFrustum& frustum, std::vector<DWord>& visible);
+
+	/**
+	* @brief Low resolution software depth buffer. Occluders (walls, terrain, big props) are
+	*	rasterized as their AABB triangles, then the screen rectangle of every remaining entity
+	*	is tested against it. Depth is Vulkan style, 0 is the near plane and 1 the far plane.
+	*/
+	class MetalOcclusionBuffer
+	{
+	public:
+		/**
+		* @brief Creates the buffer
+		* @param width -> Width in pixels (keep it small, 256 is plenty)
+		* @param height -> Height in pixels
+		*/
+		MetalOcclusionBuffer(DWord width = 256, DWord height = 128);
+
+		/**
+		* @brief Resets every pixel to the far plane
+		* @returns void
+		*/
+		void Clear();
+
+		/**
+		* @brief Rasterizes the AABBs of the occluders into the buffer, split into row bands across the workers
+		* @param bounds -> The entities
+		* @param occluders -> Indices of the entities that occlude (must be solid, the whole box is treated as opaque)
+		* @param count -> Number of occluders
+		* @param viewproj -> The camera's view-projection matrix
+		* @returns void
+		*/
+		void RasterizeOccluders(const MetalCullBounds& bounds, const DWord* occluders, DWord count, const mat4f& viewproj);
+
+		/**
+		* @brief Tests a single AABB against the buffer
+		* @returns true if any pixel of the box's screen rectangle is not behind an occluder
+		*/
+		bool IsVisible(const vec3f& center, const vec3f& extents, const mat4f& viewproj) const;
+
+		/**
+		* @brief Removes occluded entities from a visible list (usually the output of FrustumCull)
+		* @param bounds -> The entities
+		* @param visible -> Indices to test, compacted in place keeping their order
+		* @param viewproj -> The camera's view-projection matrix
+		* @returns The number of entities still visible
+		*/
+		DWord OcclusionCull(const MetalCullBounds& bounds, std::vector<DWord>& visible, const mat4f& viewproj) const;
+
+		DWord GetWidth() const { return width; }
+		DWord GetHeight() const { return height; }
+		const float* GetDepth() const { return depth.data(); }
+
+	protected:
+		DWord				width;
+		DWord				height;
+		std::vector<float>	depth;
+	};
+
+	/**
+	* @brief Runs the whole culling stage, frustum first then occlusion if a buffer is given
+	* @param bounds -> The entities
+	* @param viewproj -> The camera's view-projection matrix
+	* @param visible -> Receives the compact list of visible indices for draw submission
+	* @param occlusion -> Occlusion buffer to use (nullptr skips the occlusion pass)
+	* @param occluders -> Indices of occluder entities, rasterized into occlusion first
+	* @param occludercount -> Number of occluders
+	* @returns The number of visible entities
+	*/
+	DWord CullScene(const MetalCullBounds& bounds, const mat4f& viewproj, std::vector<DWord>& visible,
+		MetalOcclusionBuffer* occlusion = nullptr, const DWord* occluders = nullptr, DWord occludercount = 0);
+}
@@ -24,12 +24,60 @@ extern "C" {
 #include <stdlib.h>     /*For malloc and realloc*/
 #include <string.h>     /*For handling string functions*/
 
+#define MEPF_MAGIC          0x4650454D  /*"MEPF" read as a little endian integer*/
+#define MEPF_VERSION        1
+#define MEPF_NAME_LENGTH    56
+
+/*What an entry holds, so tools can list a package without knowing every format*/
+typedef enum MEPFEntryType
+{
+    MEPF_ENTRY_RAW       = 0,
+    MEPF_ENTRY_TEXTURE   = 1,
+    MEPF_ENTRY_MATERIAL  = 2,
+    MEPF_ENTRY_VIRTUAL   = 3,
+    MEPF_ENTRY_MESH      = 4,
+    MEPF_ENTRY_SKELETON  = 5,
+    MEPF_ENTRY_ANIMATION = 6
+} MEPFEntryType;
+
+/* On disk layout of a package
+    [MEPFHeader][entry data ...][MEPFEntry table]
+    The table is written last so entries can be streamed in without knowing how many there will be.
+*/
+typedef struct MEPFHeader
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int entry_count;
+    unsigned int flags;                 /*Bit 0 code package, bit 1 assets package*/
+    unsigned long long table_offset;
+} MEPFHeader;
+
+/* One file inside a package
+    - name   -> Zero terminated name used to look the entry up
+    - type   -> A MEPFEntryType
+    - offset -> Where the data starts, from the start of the package
+    - size   -> Size of the data in bytes
+*/
+typedef struct MEPFEntry
+{
+    char name[MEPF_NAME_LENGTH];
+    unsigned int type;
+    unsigned int flags;
+    unsigned long long offset;
+    unsigned long long size;
+} MEPFEntry;
+
 /* Metal Engine Package File
     - void* data    -> Pointer to the raw data 
     - size_t offset -> The Offset to the start of the next file
     - const char* encryption_id -> The id used for encrypting the data in package
     - unsigned int code_package -> Does this package contain only code? (only uses 2 bits in its form)
     - unsigned int assets_package -> Does this package contain only assets? (only uses 2 bits in its form)
+    - unsigned int writing -> Opened with MEPFCreate
+    - FILE* file -> The package file
+    - MEPFEntry* entries -> The entry table
+    - void* lock -> Serializes reads so any thread can read entries
 */
 typedef struct MEPF
 {
@@ -38,8 +86,64 @@ typedef struct MEPF
     const char* encryption_id;
     unsigned int code_package : 1;
     unsigned int assets_package : 1;
+    unsigned int writing : 1;
+    FILE* file;
+    MEPFEntry* entries;
+    unsigned int entry_count;
+    unsigned int entry_capacity;
+    void* lock;
 } MEPF;
 
+/**
+* @brief Creates a new package for writing, entries are added with MEPFAddEntry
+* @param path -> Where to write the package
+* @param code_package -> Does this package contain only code?
+* @param assets_package -> Does this package contain only assets?
+* @returns The package or NULL if failure
+*/
+MEPF* MEPFCreate(const char* path, int code_package, int assets_package);
+
+/**
+* @brief Appends an entry to a package made with MEPFCreate
+* @param package -> The package
+* @param name -> The entry's name (shorter than MEPF_NAME_LENGTH)
+* @param type -> A MEPFEntryType
+* @param data -> The data to store
+* @param size -> Size of the data in bytes
+* @returns 0 if successed 1 if failure
+*/
+int MEPFAddEntry(MEPF* package, const char* name, unsigned int type, const void* data, size_t size);
+
+/**
+* @brief Opens a package for reading
+* @param path -> The package file
+* @returns The package or NULL if failure
+*/
+MEPF* MEPFOpen(const char* path);
+
+/**
+* @brief Finds an entry by name
+* @returns The entry or NULL if the package doesn't have it
+*/
+const MEPFEntry* MEPFFindEntry(const MEPF* package, const char* name);
+
+/**
+* @brief Reads part of an entry, safe to call from any thread
+* @param package -> The package
+* @param entry -> The entry to read from
+* @param offset -> Byte offset inside the entry
+* @param destination -> Where to write the data
+* @param size -> Number of bytes to read
+* @returns 0 if successed 1 if failure
+*/
+int MEPFReadEntry(MEPF* package, const MEPFEntry* entry, unsigned long long offset, void* destination, size_t size);
+
+/**
+* @brief Closes a package, packages made with MEPFCreate get their entry table written here
+* @returns 0 if successed 1 if failure
+*/
+int MEPFClose(MEPF* package);
+
 #ifdef __cplusplus
 }
 #endif
@@ -43,7 +43,7 @@ extern "C" {
 	void FatalError(const char* title, const char* msg, ...);
 
 	/**
-	* @brief Used for creating a message in the operating system terminal
+	* @brief Used for creating a message in the operating system terminal (goes through the engine log, see MLog.h)
 	* @param msg -> The message you want displayed in the terminal
 	* @returns void
 	*/
@@ -0,0 +1,158 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine frame loop (fixed-timestep simulation, interpolated rendering, frame pacing)
+// ------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <SDL3/SDL.h>
+
+#include "MTypes.hpp"
+
+namespace engine::loop
+{
+	/* Runs one simulation tick of 'seconds', the same every tick so the simulation is deterministic*/
+	typedef void (*MetalSimulateEntry)(void* userdata, double seconds, QWord tick);
+
+	/* Renders a frame, alpha (0...1) is how far the frame lies between the last two simulation states*/
+	typedef void (*MetalRenderEntry)(void* userdata, double alpha);
+
+	/* Handles an SDL event, returning false ends the loop*/
+	typedef bool (*MetalEventEntry)(void* userdata, const SDL_Event& event);
+
+	/* Metal Frame Loop Settings
+		- tickrate	-> Simulation ticks per second
+		- framecap	-> Most frames rendered per second, 0 leaves the pacing to the present mode (FIFO blocks in present)
+		- maxticks	-> Ticks a single frame may catch up on before the backlog is dropped (a stall shouldn't snowball)
+		- simthread	-> Runs the simulation on its own thread, render then only sees what the simulation published
+		- window	-> Nothing is rendered while it is minimized, hidden or occluded (can be nullptr)
+	*/
+	struct MetalFrameLoopSettings
+	{
+		double		tickrate	= 60.0;
+		double		framecap	= 0.0;
+		DWord		maxticks	= 8;
+		bool		simthread	= false;
+		SDL_Window*	window		= nullptr;
+	};
+
+	/*
+		Ticks the simulation at a fixed rate and renders as often as the cap or present mode lets it. Time
+		that is not spent ticking or rendering is spent in SDL_WaitEventTimeout, so an idle or minimized
+		engine sleeps until the next event or tick instead of spinning a core.
+
+		With a simulation thread, the two threads should only share state through a MetalStateBuffer. Render
+		interpolates between its two states using GetAlpha of the tick Read gave back.
+	*/
+	class MetalFrameLoop
+	{
+	public:
+		MetalFrameLoop() = default;
+		~MetalFrameLoop();
+
+		MetalFrameLoop(const MetalFrameLoop&) = delete;
+		void operator=(const MetalFrameLoop&) = delete;
+
+		/**
+		* @brief Runs until the event callback returns false or RequestQuit is called, call from the thread that made the window
+		* @param settings -> Rates and pacing
+		* @param simulate, render, event -> The callbacks (render and event can be nullptr)
+		* @param userdata -> Handed to every callback
+		* @returns 0 if successed 1 if failure
+		*/
+		int Run(const MetalFrameLoopSettings& settings, MetalSimulateEntry simulate, MetalRenderEntry render, MetalEventEntry event, void* userdata);
+
+		/**
+		* @brief Ends the loop after the current frame, any thread may call this
+		* @returns void
+		*/
+		void RequestQuit() { running.store(false, std::memory_order_release); }
+
+		/**
+		* @brief Ticks simulated so far
+		*/
+		QWord GetTick() const { return tick.load(std::memory_order_acquire); }
+
+		/**
+		* @brief How far the present lies past the end of a tick, for interpolating from the state before it
+		*	to the state it produced
+		* @param completedtick -> The tick that produced the newer state
+		* @returns 0...1
+		*/
+		double GetAlpha(QWord completedtick) const;
+
+	protected:
+		void SimulationThread();
+		void Tick(QWord index);
+		bool PumpEvents();
+		void WaitUntil(std::chrono::steady_clock::time_point deadline);
+		bool IsVisible() const;
+
+		MetalFrameLoopSettings				settings;
+		MetalSimulateEntry					simulate	= nullptr;
+		MetalRenderEntry					render		= nullptr;
+		MetalEventEntry						event		= nullptr;
+		void*								userdata	= nullptr;
+		std::chrono::nanoseconds			ticklength	= {};
+		std::atomic<bool>					running{ false };
+		std::atomic<QWord>					tick{ 0 };
+		std::atomic<long long>				tickbase{ 0 };	/* steady_clock nanoseconds at which tick 0 would have started*/
+		std::thread							thread;
+		unsigned int						tickcounter	= 0;
+	};
+
+	/*
+		Previous and current simulation state behind a lock, the simulation publishes every tick and
+		render reads both to interpolate. T should be plain data small enough to copy twice per frame.
+	*/
+	template<typename T> class MetalStateBuffer
+	{
+	public:
+		/**
+		* @brief Makes state the current one, the old current becomes previous
+		* @param completedtick -> The tick that produced state
+		* @returns void
+		*/
+		void Publish(const T& state, QWord completedtick)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			previous = current;
+			current = state;
+			tick = completedtick;
+		}
+
+		/**
+		* @brief Copies out both states
+		* @returns The tick that produced current, hand it to MetalFrameLoop::GetAlpha
+		*/
+		QWord Read(T& previousstate, T& currentstate) const
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			previousstate = previous;
+			currentstate = current;
+			return tick;
+		}
+
+	protected:
+		mutable std::mutex	lock;
+		T					previous	= {};
+		T					current		= {};
+		QWord				tick		= 0;
+	};
+
+	/**
+	* @brief Blends two transforms for rendering between simulation states (rotations take the shorter way round)
+	* @param alpha -> 0 gives a, 1 gives b
+	* @returns The blended transform
+	*/
+	trans3f InterpolateTransform(const trans3f& a, const trans3f& b, float alpha);
+}
@@ -0,0 +1,211 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine job system (work-stealing, one worker per core)
+// ------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "MTypes.hpp"
+
+namespace engine::jobs
+{
+	/* Entry point of a job, the userdata is whatever pointer was handed to the job when it was made*/
+	typedef void (*MetalJobEntry)(void* userdata);
+
+	/* Maximum number of jobs a single worker can have queued before it starts running them inline*/
+	inline constexpr DWord MAXIMUM_JOBS_PER_WORKER = 4096;
+
+	/**
+	* @brief A counter that tracks how many jobs of a group are still running.
+	*	Jobs that depend on a counter are held back until it reaches zero and are
+	*	then handed to the workers, so you can chain frame stages without a wait.
+	*/
+	struct MetalJobCounter
+	{
+		std::atomic<DWord>	value{ 0 };
+		std::atomic_flag	lock = ATOMIC_FLAG_INIT;
+		struct MetalJob*	continuations = nullptr;	/* Jobs waiting on this counter (intrusive list)*/
+
+		MetalJobCounter() = default;
+		MetalJobCounter(const MetalJobCounter&) = delete;
+		void operator=(const MetalJobCounter&) = delete;
+
+		bool IsDone() const { return value.load(std::memory_order_acquire) == 0; }
+	};
+
+	/* Metal Job
+		- entry		 -> The function to run
+		- userdata	 -> Pointer handed to entry
+		- counter	 -> Counter decremented once the job has finished (can be nullptr)
+		- dependency -> Counter that has to reach zero before the job may start (can be nullptr)
+		- next		 -> Link used while the job is parked on a dependency or sitting in a free list
+		- owner		 -> Worker whose pool the job came from, the slot goes back there after running
+		- heap		 -> The job was queued from a thread that is not a worker (or its worker's pool was full)
+						and has to be deleted after running
+	*/
+	struct MetalJob
+	{
+		MetalJobEntry			entry		= nullptr;
+		void*					userdata	= nullptr;
+		MetalJobCounter*		counter		= nullptr;
+		MetalJobCounter*		dependency	= nullptr;
+		MetalJob*				next		= nullptr;
+		struct MetalJobWorker*	owner		= nullptr;
+		bool					heap		= false;
+	};
+
+	/**
+	* @brief Lock-free work-stealing deque (Chase-Lev). The owning worker pushes and pops
+	*	at the bottom, every other worker steals from the top.
+	*/
+	class MetalJobDeque
+	{
+	public:
+		MetalJobDeque();
+
+		MetalJobDeque(const MetalJobDeque&) = delete;
+		void operator=(const MetalJobDeque&) = delete;
+
+		/**
+		* @brief Pushes a job, only the owning worker may call this
+		* @returns false if the deque is full
+		*/
+		bool Push(MetalJob* job);
+
+		/**
+		* @brief Pops the most recent job, only the owning worker may call this
+		* @returns nullptr if the deque is empty
+		*/
+		MetalJob* Pop();
+
+		/**
+		* @brief Steals the oldest job, any thread may call this
+		* @returns nullptr if the deque is empty or another thread won the race
+		*/
+		MetalJob* Steal();
+
+		bool IsEmpty() const;
+
+	protected:
+		alignas(64) std::atomic<ssize>	top;
+		alignas(64) std::atomic<ssize>	bottom;
+		alignas(64) std::atomic<MetalJob*> jobs[MAXIMUM_JOBS_PER_WORKER];
+	};
+
+	/**
+	* @brief Starts the worker threads, the calling thread becomes worker 0 and helps out while waiting
+	* @param workercount -> Number of workers including the calling thread (0 = one per hardware thread)
+	* @returns 0 if successed 1 if failure
+	*/
+	int JobSystemInit(DWord workercount = 0);
+
+	/**
+	* @brief Stops and joins all worker threads, queued jobs that have not run are dropped
+	* @returns void
+	*/
+	void JobSystemShutdown(void);
+
+	/**
+	* @brief Queues a batch of jobs
+	* @param entry -> The function every job runs
+	* @param userdata -> Array of 'count' pointers, one per job (nullptr hands every job nullptr)
+	* @param count -> Number of jobs
+	* @param counter -> Incremented by count and decremented as each job finishes (can be nullptr)
+	* @param dependency -> The jobs will not start until this counter reaches zero (can be nullptr)
+	* @returns void
+	*/
+	void RunJobs(MetalJobEntry entry, void* const* userdata, DWord count, MetalJobCounter* counter, MetalJobCounter* dependency = nullptr);
+
+	/**
+	* @brief Queues a single job
+	* @returns void
+	*/
+	inline void RunJob(MetalJobEntry entry, void* userdata, MetalJobCounter* counter, MetalJobCounter* dependency = nullptr)
+	{
+		RunJobs(entry, &userdata, 1, counter, dependency);
+	}
+
+	/**
+	* @brief Waits for a counter to reach zero
+	* @param counter -> The counter to wait on
+	* @note The calling thread runs other queued jobs while it waits instead of sleeping,
+	*	so waiting from inside a job can not deadlock the pool
+	*/
+	void WaitForCounter(MetalJobCounter* counter);
+
+	/**
+	* @brief Number of workers including the thread that called JobSystemInit
+	*/
+	DWord GetWorkerCount(void);
+
+	/**
+	* @brief Index of the worker the calling thread is (0 = main thread, -1 = not a worker)
+	*/
+	int GetWorkerIndex(void);
+
+	/**
+	* @brief Splits [0, count) into batches of 'grain' items and runs func(begin, end) for each batch on the workers
+	* @param count -> Number of items
+	* @param grain -> Items per job (0 picks one so every worker gets about four batches)
+	* @param func -> Callable taking (DWord begin, DWord end)
+	* @note Returns once every batch has finished
+	*/
+	template<typename F> void ParallelFor(DWord count, DWord grain, const F& func)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+
+		if (grain == 0)
+		{
+			DWord batches = GetWorkerCount() * 4;
+			grain = (count + batches - 1) / batches;
+			grain = grain == 0 ? 1 : grain;
+		}
+
+		/* Too small to be worth waking anybody up*/
+		if (count <= grain || GetWorkerCount() <= 1)
+		{
+			func(DWord(0), count);
+			return;
+		}
+
+		struct Batch
+		{
+			const F*	func;
+			DWord		begin;
+			DWord		end;
+		};
+
+		DWord batchcount = (count + grain - 1) / grain;
+		std::vector<Batch> batches(batchcount);
+		std::vector<void*> pointers(batchcount);
+
+		for (DWord i = 0; i < batchcount; i++)
+		{
+			batches[i].func = &func;
+			batches[i].begin = i * grain;
+			batches[i].end = (i + 1) * grain < count ? (i + 1) * grain : count;
+			pointers[i] = &batches[i];
+		}
+
+		MetalJobCounter counter;
+		RunJobs([](void* userdata)
+		{
+			Batch* batch = static_cast<Batch*>(userdata);
+			(*batch->func)(batch->begin, batch->end);
+		}, pointers.data(), batchcount, &counter);
+
+		WaitForCounter(&counter);
+	}
+}
@@ -0,0 +1,131 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine logging (per-thread lock-free rings, background formatting, sinks)
+// ------------------------------------------------------
+
+#ifndef MLOG_H
+#define MLOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdarg.h>
+#include <stddef.h>
+
+/* Severities, lowest first*/
+#define METAL_LOG_TRACE		0
+#define METAL_LOG_DEBUG		1
+#define METAL_LOG_INFO		2
+#define METAL_LOG_WARNING	3
+#define METAL_LOG_ERROR		4
+#define METAL_LOG_FATAL		5
+
+/* Categories, one bit each so they can be masked*/
+#define METAL_LOG_ENGINE	0x01u
+#define METAL_LOG_RENDER	0x02u
+#define METAL_LOG_JOBS		0x04u
+#define METAL_LOG_ASSETS	0x08u
+#define METAL_LOG_GAME		0x10u
+#define METAL_LOG_ALL		0xFFFFFFFFu
+
+/* Compile time filters, anything under the severity or outside the mask is compiled out
+	(define them before including this header or on the command line)*/
+#ifndef METAL_LOG_MIN_SEVERITY
+	#ifdef NDEBUG
+		#define METAL_LOG_MIN_SEVERITY METAL_LOG_INFO
+	#else
+		#define METAL_LOG_MIN_SEVERITY METAL_LOG_TRACE
+	#endif
+#endif
+
+#ifndef METAL_LOG_CATEGORIES
+	#define METAL_LOG_CATEGORIES METAL_LOG_ALL
+#endif
+
+#define METAL_LOG_ENABLED(severity, category) ((severity) >= METAL_LOG_MIN_SEVERITY && ((category) & (METAL_LOG_CATEGORIES)) != 0)
+
+/* The format has to be a string literal, only its pointer is stored ("" enforces that)*/
+#define METAL_LOG(severity, category, format, ...) \
+	do { if (METAL_LOG_ENABLED(severity, category)) MetalLogWrite((severity), (category), "" format, ##__VA_ARGS__); } while (0)
+
+#define METAL_TRACE(category, format, ...)		METAL_LOG(METAL_LOG_TRACE, category, format, ##__VA_ARGS__)
+#define METAL_DEBUG(category, format, ...)		METAL_LOG(METAL_LOG_DEBUG, category, format, ##__VA_ARGS__)
+#define METAL_INFO(category, format, ...)		METAL_LOG(METAL_LOG_INFO, category, format, ##__VA_ARGS__)
+#define METAL_WARNING(category, format, ...)	METAL_LOG(METAL_LOG_WARNING, category, format, ##__VA_ARGS__)
+#define METAL_ERROR(category, format, ...)		METAL_LOG(METAL_LOG_ERROR, category, format, ##__VA_ARGS__)
+
+/* MetalLogWriteV flags*/
+#define METAL_LOG_COPY_FORMAT	0x01u	/* The format is not a literal and is copied into the ring*/
+
+	/* Receives every formatted line
+		- userdata -> Pointer given when the sink was added
+		- line	   -> The line without a newline, length characters long
+	*/
+	typedef void (*MetalLogSink)(void* userdata, int severity, unsigned int category, const char* line, size_t length);
+
+	/**
+	* @brief Starts the formatting thread, until then (and after MetalLogShutdown) logging formats and writes inline
+	* @returns 0 if successed 1 if failure
+	*/
+	int MetalLogInit(void);
+
+	/**
+	* @brief Flushes, stops the formatting thread and closes every sink
+	* @returns void
+	*/
+	void MetalLogShutdown(void);
+
+	/**
+	* @brief Formats and writes everything logged so far before returning
+	* @returns void
+	*/
+	void MetalLogFlush(void);
+
+	/**
+	* @brief Adds a sink
+	* @param sink -> Called on the formatting thread for every line
+	* @param close -> Called once the sink is removed at shutdown (can be NULL)
+	* @param userdata -> Handed to sink and close
+	* @param minseverity -> Lines under this severity are not handed to the sink
+	* @returns 0 if successed 1 if failure
+	*/
+	int MetalLogAddSink(MetalLogSink sink, void (*close)(void* userdata), void* userdata, int minseverity);
+
+	/**
+	* @brief Built-in sinks, while no sink is added lines go to stdout
+	* @param path -> File to append to
+	* @param ident -> Name syslog shows the lines under (Windows sends them to the debugger instead)
+	* @returns 0 if successed 1 if failure
+	*/
+	int MetalLogAddStdoutSink(int minseverity);
+	int MetalLogAddFileSink(const char* path, int minseverity);
+	int MetalLogAddSyslogSink(const char* ident, int minseverity);
+
+	/**
+	* @brief Queues a printf-style line on the calling thread's ring, the arguments are copied
+	*	in binary and formatted later on the formatting thread. Never blocks, if the ring is
+	*	full the line is dropped and counted. METAL_LOG_FATAL lines are flushed before returning.
+	* @param severity -> METAL_LOG_TRACE...METAL_LOG_FATAL
+	* @param category -> METAL_LOG_ENGINE, METAL_LOG_RENDER...
+	* @param format -> printf format, only the pointer is kept so it has to outlive the program
+	* @returns void
+	*/
+	void MetalLogWrite(int severity, unsigned int category, const char* format, ...);
+	void MetalLogWriteV(int severity, unsigned int category, unsigned int flags, const char* format, va_list args);
+
+	/**
+	* @brief Lines dropped because a ring was full
+	*/
+	unsigned long long MetalLogDropped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
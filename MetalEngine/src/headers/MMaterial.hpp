@@ -0,0 +1,110 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine material definitions (metadata, channel packing, GPU layout)
+// ------------------------------------------------------
+
+#pragma once
+
+#include "MTypes.hpp"
+#include "MDataPackage.h"
+
+namespace engine::materials
+{
+	inline constexpr DWord MATERIAL_MAGIC		= 0x54414D4D;	/* "MMAT"*/
+	inline constexpr DWord MATERIAL_VERSION		= 2;
+	inline constexpr DWord MATERIAL_NO_TEXTURE	= 0xFFFFFFFF;
+
+	/* Which channel of a packed texture a value lives in*/
+	enum materialchannel : Byte
+	{
+		MC_RED		= 0,
+		MC_GREEN	= 1,
+		MC_BLUE		= 2,
+		MC_ALPHA	= 3,
+		MC_CONSTANT	= 0xFF	/* No map, the material's constant is used instead*/
+	};
+
+	/* Where occlusion, roughness and metallic live in a TT_ORM texture (R/G/B by default like glTF)*/
+	struct MetalChannelMap
+	{
+		Byte occlusion	= MC_RED;
+		Byte roughness	= MC_GREEN;
+		Byte metallic	= MC_BLUE;
+		Byte pad		= MC_CONSTANT;
+
+		/* One byte per channel, occlusion in the low byte (what the shaders read as uORMChannels)*/
+		DWord Pack() const { return DWord(occlusion) | (DWord(roughness) << 8) | (DWord(metallic) << 16) | (DWord(pad) << 24); }
+	};
+
+	/* Material metadata as stored in a package (MEPF_ENTRY_MATERIAL)
+		- basecolor/normal/orm -> Names of the texture entries, empty for none
+		- occlusionmap/roughnessmap/metallicmap -> Single channel maps (TT_AMBIENT_OCCLUSION, TT_ROUGHNESS,
+		  TT_METALLIC) the unpacked permutation of material.frag reads instead of orm, empty for none
+		- basecolorfactor	   -> Multiplies the base color texture
+		- occlusion/roughness/metallic -> Values used for channels mapped to MC_CONSTANT
+		- channels			   -> Layout of the orm texture
+	*/
+	struct MetalMaterialDesc
+	{
+		DWord			magic				= MATERIAL_MAGIC;
+		DWord			version				= MATERIAL_VERSION;
+		char			basecolor[MEPF_NAME_LENGTH]	= {};
+		char			normal[MEPF_NAME_LENGTH]	= {};
+		char			orm[MEPF_NAME_LENGTH]		= {};
+		char			occlusionmap[MEPF_NAME_LENGTH]	= {};
+		char			roughnessmap[MEPF_NAME_LENGTH]	= {};
+		char			metallicmap[MEPF_NAME_LENGTH]	= {};
+		vec4f			basecolorfactor		= vec4f(1.0f, 1.0f, 1.0f, 1.0f);
+		float			occlusion			= 1.0f;
+		float			roughness			= 1.0f;
+		float			metallic			= 0.0f;
+		MetalChannelMap	channels;
+	};
+
+	/* One entry of the material buffer (mirrors MetalMaterial in material.frag, std430)*/
+	struct MetalGpuMaterial
+	{
+		vec4f	basecolorfactor;
+		vec4f	ormconstants;			/* x occlusion, y roughness, z metallic*/
+		DWord	basecolortexture;
+		DWord	normaltexture;
+		DWord	ormtexture;
+		DWord	ormchannels;			/* MetalChannelMap::Pack*/
+		DWord	occlusiontexture;		/* Only read by the unpacked permutation*/
+		DWord	roughnesstexture;
+		DWord	metallictexture;
+		DWord	pad;
+	};
+
+	static_assert(sizeof(MetalGpuMaterial) == 64, "MetalGpuMaterial has to match the std430 layout in material.frag");
+
+	/**
+	* @brief Fills the GPU side of a material from its metadata and the bindless slots of its textures
+	* @param desc -> The material
+	* @param basecolorslot -> Slot of the base color texture (MATERIAL_NO_TEXTURE for none)
+	* @param normalslot -> Slot of the normal map (MATERIAL_NO_TEXTURE for none)
+	* @param ormslot -> Slot of the packed ORM texture (MATERIAL_NO_TEXTURE for none)
+	* @param occlusionslot, roughnessslot, metallicslot -> Slots of the single channel maps the unpacked
+	*	permutation reads (MATERIAL_NO_TEXTURE for none, that channel uses its constant)
+	* @returns The GPU material
+	*/
+	MetalGpuMaterial MakeGpuMaterial(const MetalMaterialDesc& desc, DWord basecolorslot, DWord normalslot, DWord ormslot,
+		DWord occlusionslot = MATERIAL_NO_TEXTURE, DWord roughnessslot = MATERIAL_NO_TEXTURE, DWord metallicslot = MATERIAL_NO_TEXTURE);
+
+	/**
+	* @brief Writes a material as a MEPF_ENTRY_MATERIAL entry
+	* @returns 0 if successed 1 if failure
+	*/
+	int WritePackageMaterial(MEPF* package, const char* name, const MetalMaterialDesc& desc);
+
+	/**
+	* @brief Reads a material entry
+	* @returns 0 if successed 1 if failure
+	*/
+	int ReadPackageMaterial(MEPF* package, const char* name, MetalMaterialDesc& desc);
+}
@@ -93,7 +93,7 @@ namespace engine::types
 		T x;
 		T y;
 		vec2<T>() : x{}, y{} {}
-		vec2<T>(T x, T y) : x{ X }, y { Y } {}
+		vec2<T>(T X, T Y) : x{ X }, y{ Y } {}
 	};
 
 	template<typename T> struct vec3
@@ -133,4 +133,137 @@ namespace engine::types
 		trans3<T>() : location{}, rotation{}, scale{} {}
 		trans3<T>(T loc, T rot, T sca) : location{ loc }, rotation{ rot }, scale{ sca } {}
 	};
-}
\ No newline at end of file
+
+	/* Unit quaternion rotation, w is the real part*/
+	template<typename T> struct quat
+	{
+		T x;
+		T y;
+		T z;
+		T w;
+		quat<T>() : x{}, y{}, z{}, w{ 1 } {}
+		quat<T>(T X, T Y, T Z, T W) : x{ X }, y{ Y }, z{ Z }, w{ W } {}
+
+		/**
+		* @brief Combines two rotations (this * b), the result applies b first then this
+		*/
+		quat<T> operator*(const quat<T>& b) const
+		{
+			return quat<T>(
+				w * b.x + x * b.w + y * b.z - z * b.y,
+				w * b.y - x * b.z + y * b.w + z * b.x,
+				w * b.z + x * b.y - y * b.x + z * b.w,
+				w * b.w - x * b.x - y * b.y - z * b.z);
+		}
+
+		/**
+		* @brief Rotates a vector
+		*/
+		vec3<T> Rotate(const vec3<T>& v) const
+		{
+			/* v + 2w(q x v) + 2q x (q x v)*/
+			T tx = T(2) * (y * v.z - z * v.y);
+			T ty = T(2) * (z * v.x - x * v.z);
+			T tz = T(2) * (x * v.y - y * v.x);
+			return vec3<T>(
+				v.x + w * tx + y * tz - z * ty,
+				v.y + w * ty + z * tx - x * tz,
+				v.z + w * tz + x * ty - y * tx);
+		}
+	};
+
+	/**
+	* @brief Builds the quaternion of a rotator, the same rotation MakeTransformMatrix builds (yaw * pitch * roll)
+	* @param r -> Rotation in degrees
+	*/
+	template<typename T> quat<T> MakeQuat(const rot3<T>& r)
+	{
+		const T halfdegtorad = static_cast<T>(0.008726646259971648);
+		quat<T> pitch(std::sin(r.pitch * halfdegtorad), T(0), T(0), std::cos(r.pitch * halfdegtorad));
+		quat<T> yaw(T(0), std::sin(r.yaw * halfdegtorad), T(0), std::cos(r.yaw * halfdegtorad));
+		quat<T> roll(T(0), T(0), std::sin(r.roll * halfdegtorad), std::cos(r.roll * halfdegtorad));
+		return yaw * pitch * roll;
+	}
+
+	/*
+		4x4 matrix stored as rows, same layout the shaders get their MVP in (uMVPMatrixX..W in fog.vert)
+		so clip.x = dot(rows[0], position), clip.y = dot(rows[1], position) and so on
+	*/
+	template<typename T> struct mat4
+	{
+		vec4<T> rows[4];
+
+		mat4<T>() : rows{ vec4<T>(1, 0, 0, 0), vec4<T>(0, 1, 0, 0), vec4<T>(0, 0, 1, 0), vec4<T>(0, 0, 0, 1) } {}
+		mat4<T>(vec4<T> X, vec4<T> Y, vec4<T> Z, vec4<T> W) : rows{ X, Y, Z, W } {}
+
+		/**
+		* @brief Transforms a point (w = 1) by the matrix
+		* @returns The transformed point in homogeneous coordinates
+		*/
+		vec4<T> Transform(const vec3<T>& p) const
+		{
+			return vec4<T>(
+				rows[0].x * p.x + rows[0].y * p.y + rows[0].z * p.z + rows[0].w,
+				rows[1].x * p.x + rows[1].y * p.y + rows[1].z * p.z + rows[1].w,
+				rows[2].x * p.x + rows[2].y * p.y + rows[2].z * p.z + rows[2].w,
+				rows[3].x * p.x + rows[3].y * p.y + rows[3].z * p.z + rows[3].w);
+		}
+
+		/**
+		* @brief Multiplies two matrices (this * b), the result applies b first then this
+		*/
+		mat4<T> operator*(const mat4<T>& b) const
+		{
+			mat4<T> result;
+			for (int i = 0; i < 4; i++)
+			{
+				const vec4<T>& r = rows[i];
+				result.rows[i] = vec4<T>(
+					r.x * b.rows[0].x + r.y * b.rows[1].x + r.z * b.rows[2].x + r.w * b.rows[3].x,
+					r.x * b.rows[0].y + r.y * b.rows[1].y + r.z * b.rows[2].y + r.w * b.rows[3].y,
+					r.x * b.rows[0].z + r.y * b.rows[1].z + r.z * b.rows[2].z + r.w * b.rows[3].z,
+					r.x * b.rows[0].w + r.y * b.rows[1].w + r.z * b.rows[2].w + r.w * b.rows[3].w);
+			}
+			return result;
+		}
+	};
+
+	/**
+	* @brief Builds the world matrix of a transform (scale, then rotation, then translation)
+	* @param t -> The transform, rotation in degrees applied as yaw * pitch * roll
+	* @returns The matrix in the row layout of mat4
+	*/
+	template<typename T> mat4<T> MakeTransformMatrix(const trans3<T>& t)
+	{
+		const T degtorad = static_cast<T>(0.017453292519943295);
+		T cp = std::cos(t.rotation.pitch * degtorad), sp = std::sin(t.rotation.pitch * degtorad);
+		T cy = std::cos(t.rotation.yaw * degtorad), sy = std::sin(t.rotation.yaw * degtorad);
+		T cr = std::cos(t.rotation.roll * degtorad), sr = std::sin(t.rotation.roll * degtorad);
+
+		return mat4<T>(
+			vec4<T>((cy * cr + sy * sp * sr) * t.scale.x, (sy * sp * cr - cy * sr) * t.scale.y, sy * cp * t.scale.z, t.location.x),
+			vec4<T>(cp * sr * t.scale.x, cp * cr * t.scale.y, -sp * t.scale.z, t.location.y),
+			vec4<T>((cy * sp * sr - sy * cr) * t.scale.x, (sy * sr + cy * sp * cr) * t.scale.y, cy * cp * t.scale.z, t.location.z),
+			vec4<T>(T(0), T(0), T(0), T(1)));
+	}
+
+	/**
+	* @brief Builds the matrix of a scale, then a rotation, then a translation
+	* @param location -> Translation
+	* @param rotation -> Unit quaternion
+	* @param scale -> Non-uniform scale
+	* @returns The matrix in the row layout of mat4
+	*/
+	template<typename T> mat4<T> MakeTransformMatrix(const vec3<T>& location, const quat<T>& rotation, const vec3<T>& scale)
+	{
+		T xx = rotation.x * rotation.x, yy = rotation.y * rotation.y, zz = rotation.z * rotation.z;
+		T xy = rotation.x * rotation.y, xz = rotation.x * rotation.z, yz = rotation.y * rotation.z;
+		T wx = rotation.w * rotation.x, wy = rotation.w * rotation.y, wz = rotation.w * rotation.z;
+
+		return mat4<T>(
+			vec4<T>((T(1) - T(2) * (yy + zz)) * scale.x, T(2) * (xy - wz) * scale.y, T(2) * (xz + wy) * scale.z, location.x),
+			vec4<T>(T(2) * (xy + wz) * scale.x, (T(1) - T(2) * (xx + zz)) * scale.y, T(2) * (yz - wx) * scale.z, location.y),
+			vec4<T>(T(2) * (xz - wy) * scale.x, T(2) * (yz + wx) * scale.y, (T(1) - T(2) * (xx + yy)) * scale.z, location.z),
+			vec4<T>(T(0), T(0), T(0), T(1)));
+	}
+}
@@ -0,0 +1,236 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine meshes (quantized vertex streams, cooking, packages)
+// ------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "MTypes.hpp"
+#include "MDataPackage.h"
+
+namespace engine::meshes
+{
+	inline constexpr DWord COOKED_MESH_MAGIC = 0x48534D4D;	/* "MMSH"*/
+	inline constexpr DWord COOKED_MESH_VERSION = 3;
+	inline constexpr DWord COOKED_MESH_MAX_LODS = 8;
+	inline constexpr DWord MESHLET_MAX_VERTICES = 64;
+	inline constexpr DWord MESHLET_MAX_TRIANGLES = 124;
+
+	/* A vertex the way importers hand it over, tangent.w is the bitangent sign*/
+	struct MetalMeshVertex
+	{
+		vec3f	position;
+		vec3f	normal;
+		vec4f	tangent;
+		vec2f	uv;
+	};
+
+	/* Position stream, the only one depth and shadow passes read (R16G16B16A16_UNORM)
+		- x, y, z -> Position inside the mesh's bounding cube, see MetalCookedMeshHeader
+		- w		  -> Bitangent sign, 0 = -1 and 65535 = +1
+	*/
+	struct MetalPackedPosition
+	{
+		Word	x;
+		Word	y;
+		Word	z;
+		Word	w;
+	};
+
+	/* Attribute stream
+		- normal, tangent -> Octahedral unit vectors (R16G16_SNORM)
+		- uv			  -> Half floats (R16G16_SFLOAT)
+	*/
+	struct MetalPackedAttributes
+	{
+		short	normal[2];
+		short	tangent[2];
+		Word	uv[2];
+	};
+
+	static_assert(sizeof(MetalPackedPosition) == 8, "MetalPackedPosition has to match the vertex input in MVulkanMesh");
+	static_assert(sizeof(MetalPackedAttributes) == 12, "MetalPackedAttributes has to match the vertex input in MVulkanMesh");
+
+	/* A range of the index buffer drawn with one material*/
+	struct MetalCookedSubmesh
+	{
+		DWord	firstindex;
+		DWord	indexcount;
+		DWord	material;	/* Index into whatever material list the mesh is used with*/
+	};
+
+	/* One level of detail, a range of the index buffer over the same vertices as every other LOD*/
+	struct MetalCookedLod
+	{
+		DWord	firstindex;
+		DWord	indexcount;
+		float	error;		/* How far this LOD may stray from LOD 0, in mesh units (0 for LOD 0)*/
+		DWord	firstmeshlet;
+		DWord	meshletcount;
+		DWord	reserved;
+	};
+
+	/* A cluster of at most MESHLET_MAX_TRIANGLES triangles touching at most MESHLET_MAX_VERTICES
+		vertices, drawn as one range of the mesh's index buffer. Bounds are in mesh space.
+		- center, radius		-> Bounding sphere
+		- coneapex, coneaxis	-> Normal cone, every triangle faces away from a camera inside the cone
+		- conecutoff			-> Culled when dot(normalize(coneapex - camera), coneaxis) >= conecutoff,
+								   1 for clusters whose normals spread too far to ever be culled
+		Laid out so the table can be uploaded as is (std430, see meshlet_cull.comp)
+	*/
+	struct MetalCookedMeshlet
+	{
+		float	center[3];
+		float	radius;
+		float	coneapex[3];
+		float	conecutoff;
+		float	coneaxis[3];
+		DWord	firstindex;
+		DWord	trianglecount;
+		DWord	vertexcount;
+		DWord	submesh;
+		DWord	reserved;
+	};
+
+	static_assert(sizeof(MetalCookedMeshlet) == 64, "MetalCookedMeshlet has to match the std430 layout in meshlet_cull.comp");
+
+	/* Header of a MEPF_ENTRY_MESH entry, followed by lodcount MetalCookedLod, lodcount * submeshcount
+		MetalCookedSubmesh (LOD major), meshletcount MetalCookedMeshlet and then the GPU data:
+		positions, attributes and indices, each 16 byte aligned. Everything from positionoffset to
+		the end of the entry is uploaded as is into one buffer.
+
+		Positions dequantize as boundsmin + position * boundsscale. The scale is the same on every
+		axis so it can be folded into the model matrix without bending normals (MakeDequantizeMatrix).
+	*/
+	struct MetalCookedMeshHeader
+	{
+		DWord	magic;
+		DWord	version;
+		DWord	vertexcount;
+		DWord	indexcount;
+		DWord	indexsize;			/* 2 or 4 bytes, 16-bit whenever the vertices fit*/
+		DWord	submeshcount;		/* Per LOD*/
+		DWord	lodcount;
+		DWord	meshletcount;		/* Over every LOD, each LOD's are a range of the table*/
+		float	boundsmin[3];
+		float	boundsscale;
+		float	boundingsphere[4];	/* Center and radius in mesh space*/
+		QWord	positionoffset;		/* From the start of the entry*/
+		QWord	attributeoffset;
+		QWord	indexoffset;
+		QWord	datasize;			/* Bytes from positionoffset to the end of the indices*/
+	};
+
+	/* A cooked mesh in memory, the streams exactly as they are stored*/
+	struct MetalCookedMesh
+	{
+		MetalCookedMeshHeader				header = {};
+		std::vector<MetalCookedLod>			lods;
+		std::vector<MetalCookedSubmesh>		submeshes;	/* Submesh i of LOD l is submeshes[l * header.submeshcount + i]*/
+		std::vector<MetalCookedMeshlet>		meshlets;
+		std::vector<MetalPackedPosition>	positions;
+		std::vector<MetalPackedAttributes>	attributes;
+		std::vector<Byte>					indices;	/* header.indexsize bytes each*/
+	};
+
+	/* Everything a loader needs to pull the GPU data out of a package*/
+	struct MetalPackageMesh
+	{
+		MEPF*							package		= nullptr;
+		const MEPFEntry*				entry		= nullptr;
+		MetalCookedMeshHeader			header		= {};
+		std::vector<MetalCookedLod>		lods;
+		std::vector<MetalCookedSubmesh>	submeshes;
+		std::vector<MetalCookedMeshlet>	meshlets;
+	};
+
+	/* How CookMesh optimizes and which LODs it builds*/
+	struct MetalMeshCookSettings
+	{
+		bool	optimize		= true;		/* Vertex cache, overdraw and vertex fetch order*/
+		DWord	maxlods			= 6;		/* Including LOD 0, 1 builds no LODs*/
+		float	lodreduction	= 0.5f;		/* Triangles of a LOD relative to the one before it*/
+		float	lodmaxerror		= 0.05f;	/* Error no LOD may go over, relative to the mesh's bounding cube*/
+		DWord	lodmintriangles	= 64;		/* Meshes this small get no further LODs*/
+		bool	meshlets		= true;		/* Split every LOD into meshlets for cluster culling*/
+	};
+
+	/**
+	* @brief Quantizes a mesh into its GPU streams
+	* @param vertices -> Source vertices
+	* @param vertexcount -> Number of vertices
+	* @param indices -> Triangle list
+	* @param indexcount -> Number of indices (a multiple of 3)
+	* @param submeshes -> Ranges of indices per material (nullptr makes one submesh with material 0)
+	* @param submeshcount -> Number of submeshes
+	* @param mesh -> Receives the cooked mesh
+	* @param settings -> Optimization and LOD settings
+	* @note With optimize on, vertices no submesh uses are dropped and the rest follow the index order
+	* @returns 0 if successed 1 if failure
+	*/
+	int CookMesh(const MetalMeshVertex* vertices, DWord vertexcount, const DWord* indices, DWord indexcount,
+		const MetalCookedSubmesh* submeshes, DWord submeshcount, MetalCookedMesh& mesh, const MetalMeshCookSettings& settings = {});
+
+	/**
+	* @brief Writes a cooked mesh as a MEPF_ENTRY_MESH entry
+	* @returns 0 if successed 1 if failure
+	*/
+	int WritePackageMesh(MEPF* package, const char* name, const MetalCookedMesh& mesh);
+
+	/**
+	* @brief Reads the header and tables of a cooked mesh without touching its GPU data
+	* @param package -> The package
+	* @param name -> The entry's name
+	* @param mesh -> Receives what a loader needs
+	* @returns 0 if successed 1 if failure
+	*/
+	int ReadPackageMesh(MEPF* package, const char* name, MetalPackageMesh& mesh);
+
+	/**
+	* @brief The scale that turns a distance in world units at one unit of view depth into pixels
+	* @param fovy -> Vertical field of view in radians
+	* @param screenheight -> Viewport height in pixels
+	*/
+	float LodProjectionScale(float fovy, float screenheight);
+
+	/**
+	* @brief Picks the coarsest LOD whose error projects to at most threshold pixels
+	* @param lods -> The mesh's LODs, errors growing with the index
+	* @param lodcount -> Number of LODs
+	* @param scale -> Largest axis scale of the instance's transform
+	* @param distance -> View depth of the closest point of the bounding sphere
+	* @param projectionscale -> From LodProjectionScale
+	* @param threshold -> Pixels of error that are allowed
+	* @returns The LOD to draw
+	*/
+	DWord SelectMeshLod(const MetalCookedLod* lods, DWord lodcount, float scale, float distance, float projectionscale, float threshold = 1.0f);
+
+	/**
+	* @brief The matrix that turns quantized positions into mesh space, model * this is the matrix to draw with
+	*/
+	mat4f MakeDequantizeMatrix(const MetalCookedMeshHeader& header);
+
+	/**
+	* @brief Unpacks one vertex (tools and CPU side checks, shaders do the same in mesh.vert)
+	*/
+	MetalMeshVertex UnpackVertex(const MetalCookedMeshHeader& header, const MetalPackedPosition& position, const MetalPackedAttributes& attributes);
+
+	/**
+	* @brief Encodes a unit vector onto the octahedron as two snorm16 values
+	*/
+	void OctahedralEncode(const vec3f& vector, short encoded[2]);
+	vec3f OctahedralDecode(const short encoded[2]);
+
+	/**
+	* @brief IEEE half precision conversions, rounding to nearest even
+	*/
+	Word FloatToHalf(float value);
+	float HalfToFloat(Word value);
+}
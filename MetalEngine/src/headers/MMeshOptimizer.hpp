@@ -0,0 +1,82 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine mesh optimizer (vertex cache, overdraw and fetch ordering, simplification)
+// ------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "MTypes.hpp"
+#include "MMesh.hpp"
+
+namespace engine::meshes
+{
+	/* Post-transform cache size the orderings are tuned for, small enough to hold on every GPU we ship on*/
+	inline constexpr DWord VERTEX_CACHE_SIZE = 16;
+
+	/**
+	* @brief Reorders triangles for post-transform vertex cache hits (Tipsify, Sander et al. 2007)
+	* @param indices -> Triangle list, reordered in place
+	* @param indexcount -> Number of indices (a multiple of 3)
+	* @param vertexcount -> Number of vertices the indices refer to
+	* @param clusters -> Optional, receives the first triangle of every run the cache had to restart on
+	* @returns void
+	*/
+	void OptimizeVertexCache(DWord* indices, DWord indexcount, DWord vertexcount, std::vector<DWord>* clusters = nullptr);
+
+	/**
+	* @brief Reorders the clusters of a cache optimized triangle list so outward facing ones come first,
+	*	which draws occluders before what they hide. Clusters are split further where that costs at most
+	*	threshold times the cache misses.
+	* @param indices -> Triangle list from OptimizeVertexCache, reordered in place
+	* @param indexcount -> Number of indices
+	* @param vertices -> Vertices the indices refer to
+	* @param vertexcount -> Number of vertices
+	* @param clusters -> The clusters OptimizeVertexCache returned
+	* @param threshold -> How much worse than the cache order a split may be (1.05 is 5%)
+	* @returns void
+	*/
+	void OptimizeOverdraw(DWord* indices, DWord indexcount, const MetalMeshVertex* vertices, DWord vertexcount,
+		const std::vector<DWord>& clusters, float threshold = 1.05f);
+
+	/**
+	* @brief Makes the vertex order follow the first use in the index list so fetches walk memory forwards
+	* @param indices -> Index list, rewritten to the new order
+	* @param indexcount -> Number of indices
+	* @param vertexcount -> Number of vertices
+	* @param remap -> Receives the new index of every old vertex (0xFFFFFFFF for unused ones)
+	* @returns Number of vertices that are used
+	*/
+	DWord OptimizeVertexFetch(DWord* indices, DWord indexcount, DWord vertexcount, std::vector<DWord>& remap);
+
+	/**
+	* @brief Simulates a FIFO post-transform cache
+	* @returns Average cache misses per triangle (ACMR), 0.5 is the best a regular grid can do and 3 the worst
+	*/
+	float AnalyzeVertexCache(const DWord* indices, DWord indexcount, DWord vertexcount, DWord cachesize = VERTEX_CACHE_SIZE);
+
+	/**
+	* @brief Simplifies a triangle list with quadric error metrics (Garland and Heckbert). Edges collapse
+	*	onto one of their vertices, so the result indexes the same vertex buffer and keeps its attributes.
+	*	Vertices on UV or normal seams, non-manifold edges and locked vertices never move, open borders only
+	*	slide along themselves.
+	* @param destination -> Receives the simplified triangles (room for indexcount indices)
+	* @param indices -> Source triangle list
+	* @param indexcount -> Number of indices
+	* @param vertices -> Vertices the indices refer to
+	* @param vertexcount -> Number of vertices
+	* @param locked -> Optional, non zero for vertices that have to stay (shared with other submeshes)
+	* @param targetindexcount -> Stop once there are this many indices or less
+	* @param targeterror -> Never make a collapse that strays further than this from the source, in mesh units
+	* @param resulterror -> Optional, receives the largest error a collapse made, in mesh units
+	* @returns Number of indices written to destination
+	*/
+	DWord SimplifyMesh(DWord* destination, const DWord* indices, DWord indexcount, const MetalMeshVertex* vertices, DWord vertexcount,
+		const Byte* locked, DWord targetindexcount, float targeterror, float* resulterror = nullptr);
+}
@@ -0,0 +1,88 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine meshlets (clustering, cluster bounds, CPU reference culling)
+// ------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "MTypes.hpp"
+#include "MMesh.hpp"
+
+namespace engine::meshes
+{
+	/* Depth pyramid level 0 is half the depth buffer, level n covers 2^(n + 1) pixels a side*/
+	inline constexpr DWord DEPTH_PYRAMID_MAX_LEVELS = 16;
+
+	/**
+	* @brief Splits a triangle list into meshlets, walking it in order so every meshlet is one range of it.
+	*	Run it on a cache optimized list, the cache order keeps the clusters tight.
+	* @param indices -> Triangle list
+	* @param firstindex -> Where indices starts in the index buffer the meshlets will point into
+	* @param indexcount -> Number of indices
+	* @param vertices -> Vertices the indices refer to
+	* @param vertexcount -> Number of vertices
+	* @param submesh -> Written into every meshlet
+	* @param meshlets -> Meshlets are appended here
+	* @returns Number of meshlets appended
+	*/
+	DWord BuildMeshlets(const DWord* indices, DWord firstindex, DWord indexcount, const MetalMeshVertex* vertices, DWord vertexcount,
+		DWord submesh, std::vector<MetalCookedMeshlet>& meshlets);
+
+	/* Max depth pyramid of a depth buffer (0 near, 1 far), the CPU side of MetalGpuDepthPyramid*/
+	struct MetalDepthPyramid
+	{
+		DWord							width	= 0;	/* Of the depth buffer it was built from*/
+		DWord							height	= 0;
+		std::vector<DWord>				widths;
+		std::vector<DWord>				heights;
+		std::vector<std::vector<float>>	levels;
+	};
+
+	/**
+	* @brief Builds a depth pyramid, each level halves (rounding up) and keeps the farthest depth
+	* @returns void
+	*/
+	void BuildDepthPyramid(const float* depth, DWord width, DWord height, MetalDepthPyramid& pyramid);
+
+	/**
+	* @brief Tests a sphere against a depth pyramid
+	* @param center -> World space
+	* @param radius -> World space
+	* @param viewproj -> The view-projection the depth buffer was rendered with
+	* @returns true if the sphere is hidden behind the depth buffer
+	*/
+	bool IsSphereOccluded(const MetalDepthPyramid& pyramid, const mat4f& viewproj, const vec3f& center, float radius);
+
+	/* What a CPU meshlet cull found, for tests and the GPU pass's statistics*/
+	struct MetalMeshletCullStats
+	{
+		DWord	tested		= 0;
+		DWord	frustum		= 0;	/* Rejected by the frustum*/
+		DWord	backface	= 0;	/* Rejected by the normal cone*/
+		DWord	occluded	= 0;	/* Rejected by the depth pyramid*/
+		DWord	visible		= 0;
+	};
+
+	/**
+	* @brief CPU reference of meshlet_cull.comp, same tests in the same order
+	* @param meshlets -> The meshlets
+	* @param meshletcount -> Number of meshlets
+	* @param model -> Meshlet space to world, rotation, translation and uniform scale
+	* @param viewproj -> The camera's view-projection
+	* @param camera -> The camera's world position
+	* @param pyramid -> Optional depth pyramid for occlusion
+	* @param occlusionviewproj -> The view-projection the pyramid's depth buffer was rendered with
+	* @param visible -> Receives the indices of the visible meshlets (room for meshletcount)
+	* @param stats -> Optional, receives what was rejected for what
+	* @returns Number of visible meshlets
+	*/
+	DWord CullMeshlets(const MetalCookedMeshlet* meshlets, DWord meshletcount, const mat4f& model, const mat4f& viewproj, const vec3f& camera,
+		const MetalDepthPyramid* pyramid, const mat4f& occlusionviewproj, DWord* visible, MetalMeshletCullStats* stats = nullptr);
+}
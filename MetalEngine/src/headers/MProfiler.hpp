@@ -0,0 +1,143 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine frame profiler (scoped CPU zones, GPU timeline, Chrome trace export)
+// ------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	#include <intrin.h>
+	#define METAL_PROFILE_RDTSC
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	#include <x86intrin.h>
+	#define METAL_PROFILE_RDTSC
+#endif
+
+#include "MTypes.hpp"
+
+/*
+	Zones only exist when the engine is built with METAL_PROFILE (cmake -DMETAL_ENABLE_PROFILER=ON),
+	otherwise every macro below expands to nothing and costs nothing.
+	- METAL_ZONE("name")		 -> Times the enclosing scope on the calling thread, name must be a literal
+	- METAL_FRAME_MARK()		 -> Marks the start of a frame, exports are cut on these
+	- METAL_THREAD_NAME("name")	 -> Names the calling thread's track in the trace
+*/
+#define METAL_PROFILE_CONCAT_INNER(a, b) a##b
+#define METAL_PROFILE_CONCAT(a, b) METAL_PROFILE_CONCAT_INNER(a, b)
+
+#if defined(METAL_PROFILE)
+	#define METAL_ZONE(name)		engine::profiler::MetalZoneScope METAL_PROFILE_CONCAT(metalzone, __LINE__)("" name)
+	#define METAL_FRAME_MARK()		engine::profiler::ProfilerFrameMark()
+	#define METAL_THREAD_NAME(name)	engine::profiler::ProfilerSetThreadName(name)
+#else
+	#define METAL_ZONE(name)		((void)0)
+	#define METAL_FRAME_MARK()		((void)0)
+	#define METAL_THREAD_NAME(name)	((void)0)
+#endif
+
+namespace engine::profiler
+{
+	inline constexpr DWord PROFILER_EVENTS_PER_THREAD	= 32 * 1024;	/* Ring of the most recent zones of one thread, power of two*/
+	inline constexpr DWord PROFILER_MAX_FRAMES			= 256;			/* Frame marks kept, also the most frames one export can hold*/
+	inline constexpr DWord PROFILER_THREAD_NAME			= 32;
+
+	/* One finished zone, times are in ProfilerTicks*/
+	struct MetalProfileEvent
+	{
+		const char*	name;
+		QWord		begin;
+		QWord		end;
+	};
+
+	/**
+	* @brief Current time in profiler ticks (rdtsc on x86, steady_clock nanoseconds elsewhere)
+	*/
+	inline QWord ProfilerTicks()
+	{
+#if defined(METAL_PROFILE_RDTSC)
+		return __rdtsc();
+#else
+		return static_cast<QWord>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+	}
+
+	/**
+	* @brief Measures how fast the ticks run, call once at startup before exporting
+	* @returns 0 if successed 1 if failure
+	*/
+	int ProfilerInit(void);
+
+	/**
+	* @brief Frees every thread's buffer, call it after every other thread that recorded zones has exited
+	* @returns void
+	*/
+	void ProfilerShutdown(void);
+
+	/**
+	* @brief Ticks per second measured by ProfilerInit
+	*/
+	double ProfilerTicksPerSecond(void);
+
+	/**
+	* @brief Names the calling thread's track (copied, up to PROFILER_THREAD_NAME - 1 characters)
+	* @returns void
+	*/
+	void ProfilerSetThreadName(const char* name);
+
+	/**
+	* @brief Marks the start of a new frame, only one thread (the one running the frame loop) should call this
+	* @returns void
+	*/
+	void ProfilerFrameMark(void);
+
+	/**
+	* @brief Number of frame marks so far
+	*/
+	QWord ProfilerFrameIndex(void);
+
+	/**
+	* @brief Records a finished zone on the calling thread's buffer
+	* @param name -> Has to outlive the profiler, only the pointer is kept
+	* @returns void
+	*/
+	void ProfilerRecord(const char* name, QWord begin, QWord end);
+
+	/**
+	* @brief Records a zone on the GPU track, only the thread that collects GPU timestamps may call this
+	* @param begin, end -> Already converted to CPU ticks
+	* @returns void
+	*/
+	void ProfilerRecordGpu(const char* name, QWord begin, QWord end);
+
+	/**
+	* @brief Writes the last frames as a Chrome trace (chrome://tracing, Perfetto, or Tracy through its import-chrome tool)
+	* @param path -> The .json file to write
+	* @param frames -> Number of finished frames to export (clamped to what is recorded)
+	* @returns 0 if successed 1 if failure
+	* @note Zones older than the thread's ring are gone, PROFILER_EVENTS_PER_THREAD bounds what one thread can show
+	*/
+	int ProfilerExportChrome(const char* path, DWord frames);
+
+	/* Times its own lifetime, use METAL_ZONE instead of making these by hand*/
+	class MetalZoneScope
+	{
+	public:
+		explicit MetalZoneScope(const char* name) : name(name), begin(ProfilerTicks()) {}
+		~MetalZoneScope() { ProfilerRecord(name, begin, ProfilerTicks()); }
+
+		MetalZoneScope(const MetalZoneScope&) = delete;
+		void operator=(const MetalZoneScope&) = delete;
+
+	protected:
+		const char*	name;
+		QWord		begin;
+	};
+}
@@ -0,0 +1,32 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine parallel radix sort (64-bit keys with a payload, on the job system)
+// ------------------------------------------------------
+
+#pragma once
+
+#include "MTypes.hpp"
+
+namespace engine::jobs
+{
+	/* Keys per job, fewer than this sort on the calling thread*/
+	inline constexpr DWord RADIX_SORT_BLOCK_SIZE = 8192;
+
+	/**
+	* @brief Sorts 64-bit keys and moves a payload along with each, least significant 8 bits first.
+	*	The sort is stable, and digits that every key shares are skipped, so keys with few bits in
+	*	use take few passes. Every pass histograms and scatters blocks of keys on the workers.
+	* @param keys -> Sorted in place
+	* @param values -> Payload, moved with the keys
+	* @param count -> Number of keys
+	* @param scratchkeys -> Room for count keys
+	* @param scratchvalues -> Room for count values
+	* @returns void
+	*/
+	void RadixSort(QWord* keys, DWord* values, DWord count, QWord* scratchkeys, DWord* scratchvalues);
+}
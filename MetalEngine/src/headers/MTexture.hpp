@@ -9,6 +9,8 @@
 // ------------------------------------------------------
 
 #pragma once
+#include <vector>
+
 #include "MTypes.hpp"
 
 enum texturetype
@@ -23,13 +25,100 @@ enum texturetype
 	TT_SUBSURFACE_SCATTERING	= 8,
 	TT_EMISSIVE					= 9,
 	TT_OPACITY					= 10,
+	TT_ORM						= 11,	/* Packed occlusion/roughness/metallic, see MetalChannelMap*/
 	TT_UNDEFINED				= 0
 };
 
+/* Pixel layout of the stored mips*/
+enum imageformat
+{
+	IF_RGBA8					= 0,
+	IF_RGBA8_SRGB				= 1,
+	IF_BC1						= 2,	/* RGB, 4 bpp*/
+	IF_BC1_SRGB					= 3,
+	IF_BC3						= 4,	/* RGBA, 8 bpp*/
+	IF_BC3_SRGB					= 5,
+	IF_BC4						= 6,	/* R, 4 bpp*/
+	IF_BC5						= 7,	/* RG, 8 bpp*/
+	IF_BC7						= 8,	/* RGBA, 8 bpp*/
+	IF_BC7_SRGB					= 9
+};
+
+/* One level of the mip chain
+	- width/height -> Size in pixels
+	- offset	   -> Byte offset of the level in the texture's data
+	- size		   -> Byte size of the level
+*/
+struct imagemip
+{
+	DWord	width;
+	DWord	height;
+	QWord	offset;
+	QWord	size;
+};
+
+/* mips[0] is the full size image, every next level halves down to 1x1*/
 struct imagefile
 {
-	DWord		width;
-	DWord		height;
-	texturetype type;
+	DWord					width;
+	DWord					height;
+	texturetype				type;
+	imageformat				format	= IF_RGBA8;
+	std::vector<imagemip>	mips;
 };
 
+/**
+* @brief Returns the byte size of one mip level
+*/
+inline QWord GetImageMipSize(imageformat format, DWord width, DWord height)
+{
+	/* Block formats store 4x4 pixels per block, partial blocks still take a whole one*/
+	QWord blocks = static_cast<QWord>((width + 3) / 4) * ((height + 3) / 4);
+
+	switch (format)
+	{
+	case IF_BC1:
+	case IF_BC1_SRGB:
+	case IF_BC4:
+		return blocks * 8;
+	case IF_BC3:
+	case IF_BC3_SRGB:
+	case IF_BC5:
+	case IF_BC7:
+	case IF_BC7_SRGB:
+		return blocks * 16;
+	case IF_RGBA8:
+	case IF_RGBA8_SRGB:
+	default:
+		return static_cast<QWord>(width) * height * 4;
+	}
+}
+
+/**
+* @brief Fills mips with the full chain of image, levels packed back to back starting at offset 0
+* @returns The byte size of the whole chain
+*/
+inline QWord BuildMipChain(imagefile& image)
+{
+	image.mips.clear();
+
+	DWord w = image.width > 0 ? image.width : 1;
+	DWord h = image.height > 0 ? image.height : 1;
+	QWord offset = 0;
+
+	while (true)
+	{
+		QWord size = GetImageMipSize(image.format, w, h);
+		image.mips.push_back({ w, h, offset, size });
+		offset += size;
+
+		if (w == 1 && h == 1)
+		{
+			break;
+		}
+		w = w > 1 ? w / 2 : 1;
+		h = h > 1 ? h / 2 : 1;
+	}
+	return offset;
+}
+
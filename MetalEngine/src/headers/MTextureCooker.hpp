@@ -0,0 +1,186 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine texture cooker (mipmaps, BC1-7 compression, packages)
+// ------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "MTypes.hpp"
+#include "MTexture.hpp"
+#include "MDataPackage.h"
+#include "MMaterial.hpp"
+
+namespace engine::textures
+{
+	inline constexpr DWord COOKED_TEXTURE_MAGIC = 0x5845544D;	/* "MTEX"*/
+
+	/* Header of a MEPF_ENTRY_TEXTURE entry, followed by mipcount MetalCookedMip and then the
+		mip data (mip offsets are from the start of the data)*/
+	struct MetalCookedHeader
+	{
+		DWord	magic;
+		DWord	width;
+		DWord	height;
+		DWord	type;
+		DWord	format;
+		DWord	mipcount;
+		QWord	dataoffset;		/* From the start of the entry*/
+	};
+
+	struct MetalCookedMip
+	{
+		DWord	width;
+		DWord	height;
+		QWord	offset;
+		QWord	size;
+	};
+
+	/* Optional knobs for CookTexture
+		- generatemips -> Build the whole chain (otherwise only the source level is stored)
+		- compress	   -> Encode to a BC format (otherwise RGBA8 is stored)
+		- maxsize	   -> Drop top mips until the largest side fits (0 keeps the source size)
+	*/
+	struct MetalCookSettings
+	{
+		bool	generatemips	= true;
+		bool	compress		= true;
+		DWord	maxsize			= 0;
+	};
+
+	/* One input of a channel pack, either a channel of an image or a constant
+		- rgba	   -> 8-bit RGBA pixels (nullptr for a constant)
+		- channel  -> Which channel of rgba holds the value
+		- constant -> Value written when rgba is nullptr
+	*/
+	struct MetalChannelSource
+	{
+		const Byte*	rgba		= nullptr;
+		DWord		width		= 0;
+		DWord		height		= 0;
+		DWord		channel		= 0;
+		Byte		constant	= 255;
+	};
+
+	/* Everything a texture reader needs to pull mips out of a package*/
+	struct MetalPackageTexture
+	{
+		MEPF*				package		= nullptr;
+		const MEPFEntry*	entry		= nullptr;
+		QWord				dataoffset	= 0;
+		std::vector<QWord>	mipoffsets;
+	};
+
+	/**
+	* @brief Picks the block format for a texture type, BC5 for normals, BC4 for single channel
+	*	masks, BC7 for diffuse and BC1/BC3 for everything else
+	* @param type -> What the texture is used for
+	* @param hasalpha -> Whether any pixel is not fully opaque
+	* @returns The format
+	*/
+	imageformat ChooseCookedFormat(texturetype type, bool hasalpha);
+
+	/**
+	* @brief Whether a texture type holds colors (stored as sRGB and filtered in linear space)
+	*/
+	bool IsColorTexture(texturetype type);
+
+	/**
+	* @brief Builds the mip chain and compresses every level, work is spread over the job system
+	* @param rgba -> Source pixels, 8-bit RGBA, rows packed
+	* @param width -> Source width
+	* @param height -> Source height
+	* @param type -> What the texture is used for
+	* @param image -> Receives the description and mip table
+	* @param data -> Receives the mip data
+	* @param settings -> Optional knobs
+	* @returns 0 if successed 1 if failure
+	*/
+	int CookTexture(const Byte* rgba, DWord width, DWord height, texturetype type, imagefile& image, std::vector<Byte>& data,
+		const MetalCookSettings& settings = MetalCookSettings());
+
+	/**
+	* @brief Builds the mip chain of an 8-bit RGBA image, color textures are filtered in linear
+	*	space with the same curve as the sRGBToLinear shader helper and normal maps are renormalized
+	* @param rgba -> Source pixels
+	* @param width -> Source width
+	* @param height -> Source height
+	* @param type -> What the texture is used for
+	* @param levels -> Receives every level as 8-bit RGBA, levels[0] is a copy of the source
+	* @returns void
+	*/
+	void GenerateMips(const Byte* rgba, DWord width, DWord height, texturetype type, std::vector<std::vector<Byte>>& levels);
+
+	/**
+	* @brief Compresses one 8-bit RGBA level, rows of blocks are encoded in parallel
+	* @param format -> One of the BC formats
+	* @param rgba -> Source pixels
+	* @param width -> Width of the level
+	* @param height -> Height of the level
+	* @param destination -> GetImageMipSize(format, width, height) bytes
+	* @returns void
+	*/
+	void CompressImage(imageformat format, const Byte* rgba, DWord width, DWord height, Byte* destination);
+
+	/**
+	* @brief Block encoders, each takes 16 RGBA pixels in row order
+	*/
+	void EncodeBC1(const Byte* pixels, Byte* block);
+	void EncodeBC3(const Byte* pixels, Byte* block);
+	void EncodeBC4(const Byte* pixels, DWord channel, Byte* block);
+	void EncodeBC5(const Byte* pixels, Byte* block);
+	void EncodeBC7(const Byte* pixels, Byte* block);
+
+	/**
+	* @brief Builds one RGBA image out of channels of other images. Sources of different sizes are
+	*	bilinearly resampled to the largest one.
+	* @param sources -> What goes into R, G, B and A
+	* @param rgba -> Receives the packed pixels
+	* @param width -> Receives the packed width
+	* @param height -> Receives the packed height
+	* @returns 0 if successed 1 if every source is a constant
+	*/
+	int PackChannels(const MetalChannelSource sources[4], std::vector<Byte>& rgba, DWord& width, DWord& height);
+
+	/**
+	* @brief Packs occlusion, roughness and metallic maps into one TT_ORM texture and cooks it.
+	*	Missing maps (rgba == nullptr) are left to the material's constants.
+	* @param occlusion -> Ambient occlusion map
+	* @param roughness -> Roughness map
+	* @param metallic -> Metallic map
+	* @param image -> Receives the description and mip table
+	* @param data -> Receives the mip data
+	* @param channels -> Receives the channel map to store in the material
+	* @returns 0 if successed 1 if none of the maps exist
+	*/
+	int CookORM(const MetalChannelSource& occlusion, const MetalChannelSource& roughness, const MetalChannelSource& metallic,
+		imagefile& image, std::vector<Byte>& data, engine::materials::MetalChannelMap& channels,
+		const MetalCookSettings& settings = MetalCookSettings());
+
+	/**
+	* @brief Writes a cooked texture as a MEPF_ENTRY_TEXTURE entry
+	* @returns 0 if successed 1 if failure
+	*/
+	int WritePackageTexture(MEPF* package, const char* name, const imagefile& image, const std::vector<Byte>& data);
+
+	/**
+	* @brief Reads the description of a cooked texture without touching its mip data
+	* @param package -> The package
+	* @param name -> The entry's name
+	* @param image -> Receives the description and mip table
+	* @param source -> Receives what PackageTextureReader needs
+	* @returns 0 if successed 1 if failure
+	*/
+	int ReadPackageTexture(MEPF* package, const char* name, imagefile& image, MetalPackageTexture& source);
+
+	/**
+	* @brief A MetalTextureReader for textures in packages, userdata is a MetalPackageTexture
+	*/
+	bool PackageTextureReader(void* userdata, DWord mip, Byte* destination, QWord size);
+}
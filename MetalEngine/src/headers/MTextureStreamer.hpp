@@ -0,0 +1,223 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine texture streaming (mip residency, VRAM budget, async uploads)
+// ------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <deque>
+
+#include "MVulkanRenderer.hpp"
+#include "MVulkanBindless.hpp"
+#include "MJobSystem.hpp"
+#include "MTexture.hpp"
+
+namespace engine::vulkan
+{
+	inline constexpr DWord			STREAMING_INVALID			= 0xFFFFFFFF;
+	inline constexpr DWord			STREAMING_RESIDENT_TAIL		= 64;					/* Mips this size and smaller are loaded with the texture and never evicted*/
+	inline constexpr VkDeviceSize	STREAMING_STAGING_SIZE		= 64ull * 1024 * 1024;
+	inline constexpr DWord			STREAMING_MAX_LOADS			= 16;					/* Reads in flight at once*/
+
+	/* Reads one mip level of a texture from wherever it lives (loose file, package...).
+		Runs on a job worker and writes straight into mapped staging memory.
+		- userdata	  -> The pointer given to AddTexture
+		- mip		  -> The level to read, its size is file.mips[mip].size
+		- destination -> Where to write the level
+		Returns true if successed
+	*/
+	typedef bool (*MetalTextureReader)(void* userdata, DWord mip, Byte* destination, QWord size);
+
+	/**
+	* @brief The Vulkan format an imageformat is uploaded as
+	*/
+	VkFormat GetImageVkFormat(imageformat format);
+
+	/*
+		Every texture is one VkImage holding only its resident mips, registered in the bindless heap.
+		Each frame Update looks at the screen size feedback, starts reads for textures that need
+		a finer mip and, when that would go over the budget, drops the finest mip of the least
+		recently used textures. Changing residency creates a new image with one level more or
+		less, copies the shared levels over on the GPU and retires the old image once no frame
+		in flight can use it. Nothing in here waits on the GPU.
+	*/
+	class MetalTextureStreamer
+	{
+	public:
+		MetalTextureStreamer() = default;
+		~MetalTextureStreamer();
+
+		MetalTextureStreamer(const MetalTextureStreamer&) = delete;
+		void operator=(const MetalTextureStreamer&) = delete;
+
+		/**
+		* @brief Creates the staging ring and the sampler, the bindless heap has to exist already
+		* @param budget -> Bytes of VRAM textures may use (0 picks DefaultBudget())
+		* @param stagingsize -> Size of the persistently mapped staging ring
+		* @returns 0 if successed 1 if failure
+		*/
+		int Create(VkDeviceSize budget = 0, VkDeviceSize stagingsize = STREAMING_STAGING_SIZE);
+
+		/**
+		* @brief Waits for outstanding reads and destroys every image (the device must be idle)
+		* @returns void
+		*/
+		void Destroy();
+
+		/**
+		* @brief Adds a texture, its low mips are uploaded on the next Update
+		* @param file -> Description with the full mip chain
+		* @param reader -> Reads mip data on a worker thread
+		* @param userdata -> Handed to reader
+		* @returns The texture handle
+		*/
+		DWord AddTexture(const imagefile& file, MetalTextureReader reader, void* userdata);
+
+		/**
+		* @brief Removes a texture, its memory is freed once the GPU is done with it
+		* @returns void
+		*/
+		void RemoveTexture(DWord texture);
+
+		/**
+		* @brief Feedback from culling/rendering, can be called from any thread while AddTexture
+		*	and Update are not running (the culling jobs of a frame are a good place)
+		* @param texture -> The texture handle
+		* @param pixels -> How many pixels the texture covers along its longest side on screen
+		* @returns void
+		*/
+		void ReportScreenSize(DWord texture, float pixels);
+
+		/**
+		* @brief Runs the residency logic and records uploads and copies, once per frame after
+		*	AcquireNextImage and outside of a render pass
+		* @param commandbuffer -> The frame's command buffer
+		* @returns void
+		*/
+		void Update(VkCommandBuffer commandbuffer);
+
+		/**
+		* @brief Slot to push in MetalBindlessMaterial, changes whenever residency does so fetch it every frame
+		* @returns The bindless slot or the fallback slot while nothing is resident
+		*/
+		DWord GetBindlessSlot(DWord texture) const;
+
+		/**
+		* @brief Finest resident mip of a texture (mips.size() while nothing is resident)
+		*/
+		DWord GetResidentMip(DWord texture) const { return textures[texture]->residentmip; }
+
+		void SetFallbackSlot(DWord slot) { fallbackslot = slot; }
+		void SetBudget(VkDeviceSize bytes) { budget = bytes; }
+		VkDeviceSize GetBudget() const { return budget; }
+		VkDeviceSize GetUsedMemory() const { return usedmemory; }			/* Live images, what the budget is checked against*/
+		VkDeviceSize GetRetiredMemory() const { return retiredmemory; }	/* Replaced images waiting for the GPU*/
+
+		/**
+		* @brief Helper for feedback, the on screen size of a bounding sphere
+		* @param radius -> Sphere radius
+		* @param distance -> Distance from the camera to the sphere's center
+		* @param fovy -> Vertical field of view in radians
+		* @param screenheight -> Height of the render target in pixels
+		* @returns The diameter in pixels
+		*/
+		static float ScreenSizeFromSphere(float radius, float distance, float fovy, float screenheight);
+
+		/**
+		* @returns Half of the largest device local heap
+		*/
+		static VkDeviceSize DefaultBudget();
+
+	protected:
+		struct Load
+		{
+			DWord				texture;
+			DWord				firstmip;
+			DWord				lastmip;
+			VkDeviceSize		stagingoffset;
+			Byte*				destination;
+			QWord				mipoffsets[32];	/* Offset of each level inside this load's staging range*/
+			MetalTextureReader	reader;
+			void*				userdata;
+			const imagefile*	file;
+			std::atomic<DWord>	state{ 0 };		/* 0 reading, 1 ready, 2 failed*/
+		};
+
+		struct Texture
+		{
+			imagefile			file;
+			MetalTextureReader	reader			= nullptr;
+			void*				userdata		= nullptr;
+			DWord				tailmip			= 0;	/* First level of the never evicted tail*/
+			DWord				residentmip		= 0;	/* Finest level in image*/
+			DWord				wantedmip		= 0;
+			std::atomic<DWord>	requestedmip{ STREAMING_INVALID };
+			QWord				lastused		= 0;
+			VkImage				image			= VK_NULL_HANDLE;
+			VkDeviceMemory		memory			= VK_NULL_HANDLE;
+			VkImageView			view			= VK_NULL_HANDLE;
+			VkDeviceSize		bytes			= 0;
+			DWord				slot			= BINDLESS_INVALID;
+			Load*				loading			= nullptr;
+			bool				alive			= false;
+		};
+
+		struct Retired
+		{
+			VkImage			image;
+			VkDeviceMemory	memory;
+			VkImageView		view;
+			VkDeviceSize	bytes;
+			QWord			frame;
+		};
+
+		/* A range of the staging ring, start is where the ring's head was before the block so a
+			block that wrapped around also owns the unused bytes it skipped at the end*/
+		struct StagingBlock
+		{
+			VkDeviceSize	start;
+			VkDeviceSize	offset;
+			VkDeviceSize	end;
+			QWord			frame;	/* Frame it was consumed in, STREAMING_NEVER while still in use*/
+		};
+
+		static constexpr QWord STREAMING_NEVER = ~0ull;
+
+		bool AllocateStaging(VkDeviceSize size, VkDeviceSize& offset);
+		void FreeStaging(QWord frame);
+		void ReleaseStaging(VkDeviceSize offset, QWord frame);
+
+		bool StartLoad(DWord texture, DWord firstmip, DWord lastmip);
+		void FinishLoad(VkCommandBuffer commandbuffer, Load* load);
+		bool Evict(VkCommandBuffer commandbuffer, DWord texture);
+		void Rebuild(VkCommandBuffer commandbuffer, DWord texture, DWord newmip, const Load* load);
+		void RetireImage(Texture& texture);
+		VkDeviceSize ChainSize(const Texture& texture, DWord firstmip) const;
+
+		static void ReadJob(void* userdata);
+
+		std::vector<std::unique_ptr<Texture>>	textures;
+		std::vector<DWord>						freetextures;
+		std::vector<std::unique_ptr<Load>>		loads;
+		std::vector<Retired>					retired;
+		std::deque<StagingBlock>				stagingblocks;
+		engine::jobs::MetalJobCounter			readcounter;
+		VkBuffer								stagingbuffer	= VK_NULL_HANDLE;
+		VkDeviceMemory							stagingmemory	= VK_NULL_HANDLE;
+		Byte*									stagingdata		= nullptr;
+		VkDeviceSize							stagingsize		= 0;
+		VkSampler								sampler			= VK_NULL_HANDLE;
+		VkDeviceSize							budget			= 0;
+		VkDeviceSize							usedmemory		= 0;
+		VkDeviceSize							retiredmemory	= 0;
+		QWord									frame			= 0;
+		DWord									fallbackslot	= BINDLESS_INVALID;
+	};
+}
@@ -37,3 +37,7 @@ typedef rot3<double>	rot3d;
 typedef trans3<int>		trans3i;
 typedef trans3<float>	trans3f;
 typedef trans3<double>	trans3d;
+typedef quat<float>		quatf;
+typedef quat<double>	quatd;
+typedef mat4<float>		mat4f;
+typedef mat4<double>	mat4d;
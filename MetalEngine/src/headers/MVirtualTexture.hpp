@@ -0,0 +1,357 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine virtual texturing, CPU side (page cooking, page cache, page tables, feedback resolver)
+// ------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "MTypes.hpp"
+#include "MTexture.hpp"
+#include "MDataPackage.h"
+#include "MJobSystem.hpp"
+
+namespace engine::textures
+{
+	inline constexpr DWord VT_PAGE_SIZE			= 128;								/* Texels of payload per page side*/
+	inline constexpr DWord VT_PAGE_BORDER		= 4;								/* Texels copied from the neighbours so bilinear filtering stays inside the page*/
+	inline constexpr DWord VT_PAGE_TEXELS		= VT_PAGE_SIZE + VT_PAGE_BORDER * 2;	/* Side of a page in the cache atlas*/
+	inline constexpr DWord VT_MAX_TEXTURES		= 255;								/* Handle 255 is taken by VT_FEEDBACK_NONE*/
+	inline constexpr DWord VT_MAX_PAGES			= 1024;								/* Pages per side of level 0*/
+	inline constexpr DWord VT_MAX_LEVELS		= 16;
+	inline constexpr DWord VT_MAX_LOADS			= 32;								/* Page reads in flight at once*/
+	inline constexpr DWord VT_MAX_ATLAS_PAGES	= 255;								/* Pages per side of the cache, page table entries are 8-bit*/
+	inline constexpr DWord VT_INVALID			= 0xFFFFFFFF;
+	inline constexpr DWord VT_FEEDBACK_NONE		= 0xFFFFFFFF;						/* What a feedback texel holds when nothing virtual was drawn there*/
+	inline constexpr DWord COOKED_VIRTUAL_MAGIC	= 0x5854564D;						/* "MVTX"*/
+
+	/* A feedback texel, 8 bits texture, 4 bits mip, 10 bits y, 10 bits x (mirrors PackRequest in vt_feedback.frag)*/
+	inline constexpr DWord PackPageRequest(DWord texture, DWord mip, DWord x, DWord y)
+	{
+		return (texture << 24) | (mip << 20) | (y << 10) | x;
+	}
+
+	inline constexpr void UnpackPageRequest(DWord request, DWord& texture, DWord& mip, DWord& x, DWord& y)
+	{
+		texture = request >> 24;
+		mip = (request >> 20) & 0xF;
+		y = (request >> 10) & 0x3FF;
+		x = request & 0x3FF;
+	}
+
+	/* A page table entry, 8-bit RGBA so it can sit in the bindless heap as a regular sampled image
+		- R/G -> Cache page holding the data
+		- B	  -> Mip of that page (coarser than asked for while the wanted page is not resident)
+		- A	  -> 255 when anything is mapped, 0 when not even the coarsest page is resident
+	*/
+	inline constexpr DWord PackPageEntry(DWord cachex, DWord cachey, DWord mip)
+	{
+		return cachex | (cachey << 8) | (mip << 16) | (0xFFu << 24);
+	}
+
+	/* One mip of a cooked virtual texture, its pages are stored row by row from firstpage on*/
+	struct MetalVirtualLevel
+	{
+		DWord	pagesx;
+		DWord	pagesy;
+		QWord	firstpage;
+	};
+
+	/* Header of a MEPF_ENTRY_VIRTUAL entry, followed by levelcount MetalVirtualLevel and then
+		the pages (every page is pagebytes, dataoffset is from the start of the entry)*/
+	struct MetalVirtualHeader
+	{
+		DWord	magic;
+		DWord	width;
+		DWord	height;
+		DWord	type;
+		DWord	format;
+		DWord	levelcount;
+		DWord	pagesize;
+		DWord	border;
+		QWord	pagebytes;
+		QWord	dataoffset;
+	};
+
+	/* A virtual texture split in pages, levels stop at the first mip that fits in one page*/
+	struct MetalVirtualTextureDesc
+	{
+		DWord							width		= 0;
+		DWord							height		= 0;
+		texturetype						type		= TT_DIFFUSE;
+		imageformat						format		= IF_RGBA8;
+		QWord							pagebytes	= 0;
+		std::vector<MetalVirtualLevel>	levels;
+
+		QWord GetPageIndex(DWord mip, DWord x, DWord y) const { return levels[mip].firstpage + static_cast<QWord>(y) * levels[mip].pagesx + x; }
+		QWord GetPageCount() const { return levels.empty() ? 0 : GetPageIndex(static_cast<DWord>(levels.size() - 1), 0, 0) + 1; }
+	};
+
+	/* Everything PackageVirtualPageReader needs to pull pages out of a package*/
+	struct MetalPackageVirtualTexture
+	{
+		MEPF*					package		= nullptr;
+		const MEPFEntry*		entry		= nullptr;
+		QWord					dataoffset	= 0;
+		MetalVirtualTextureDesc	desc;
+	};
+
+	/* Reads one page of a virtual texture, runs on a job worker
+		- userdata	  -> The pointer given to AddTexture
+		- mip/x/y	  -> The page
+		- destination -> Staging memory to write the page into
+		Returns true if successed
+	*/
+	typedef bool (*MetalPageReader)(void* userdata, DWord mip, DWord x, DWord y, Byte* destination, QWord size);
+
+	/* A page that finished loading and has to be copied from staging into the cache this frame*/
+	struct MetalPageUpload
+	{
+		DWord	slot;		/* Cache page, (slot % cachewidth, slot / cachewidth) in the atlas*/
+		DWord	staging;	/* Staging page holding the data*/
+	};
+
+	/* A changed rectangle of one page table level, x1/y1 are exclusive and x0 >= x1 means clean*/
+	struct MetalPageRect
+	{
+		DWord	x0 = 0xFFFFFFFF;
+		DWord	y0 = 0xFFFFFFFF;
+		DWord	x1 = 0;
+		DWord	y1 = 0;
+
+		bool IsEmpty() const { return x0 >= x1 || y0 >= y1; }
+	};
+
+	/* CPU copy of one texture's page table
+		- entries -> Per level, PackPageEntry of the finest resident page covering each page
+		- slots	  -> Per level, the cache page a page lives in (VT_INVALID when not resident)
+		- dirty	  -> Per level, what changed since the GPU copy was last updated
+	*/
+	struct MetalPageTable
+	{
+		std::vector<std::vector<DWord>>	entries;
+		std::vector<std::vector<DWord>>	slots;
+		std::vector<MetalPageRect>		dirty;
+	};
+
+	/* Counters of the last Update*/
+	struct MetalPageStats
+	{
+		DWord	requested	= 0;	/* Distinct missing pages the feedback asked for*/
+		DWord	started		= 0;	/* Reads started*/
+		DWord	uploaded	= 0;	/* Pages that became resident*/
+		DWord	evicted		= 0;
+		DWord	failed		= 0;
+		DWord	resident	= 0;
+	};
+
+	/*
+		Owns the page cache and the page tables but no GPU objects, so it runs headless.
+		The cache is a fixed grid of pages, whatever is in it is the only texture memory virtual
+		textures use no matter how much content there is. Feedback (one PackPageRequest per
+		texel) marks pages as used and collects the missing ones, Update starts reads for them
+		coarse mips first, evicts the least recently used pages to make room and hands back the
+		reads that finished as uploads. The coarsest page of every texture is pinned so there is
+		always something to sample.
+		Reads write straight into the staging pages given to Create, a staging page is reused
+		'latency' Updates after its upload was handed out.
+	*/
+	class MetalPageResolver
+	{
+	public:
+		MetalPageResolver() = default;
+		~MetalPageResolver();
+
+		MetalPageResolver(const MetalPageResolver&) = delete;
+		void operator=(const MetalPageResolver&) = delete;
+
+		/**
+		* @brief Sets up the cache
+		* @param cachewidth -> Pages per row of the cache (at most VT_MAX_ATLAS_PAGES)
+		* @param cacheheight -> Pages per column of the cache (at most VT_MAX_ATLAS_PAGES)
+		* @param pagebytes -> Size of one page, every texture has to use the same format
+		* @param staging -> stagingpages * pagebytes bytes that reads write into
+		* @param stagingpages -> Number of staging pages
+		* @param latency -> Updates before an uploaded staging page may be written again (frames in flight)
+		* @returns 0 if successed 1 if failure
+		*/
+		int Create(DWord cachewidth, DWord cacheheight, QWord pagebytes, Byte* staging, DWord stagingpages, DWord latency);
+
+		/**
+		* @brief Waits for outstanding reads and forgets every texture
+		* @returns void
+		*/
+		void Destroy();
+
+		/**
+		* @brief Adds a texture, its coarsest page is requested right away
+		* @param desc -> The cooked layout (pagebytes has to match the cache)
+		* @param reader -> Reads pages on a worker thread
+		* @param userdata -> Handed to reader
+		* @returns The texture handle or VT_INVALID
+		*/
+		DWord AddTexture(const MetalVirtualTextureDesc& desc, MetalPageReader reader, void* userdata);
+
+		/**
+		* @brief Removes a texture and frees its pages
+		* @returns void
+		*/
+		void RemoveTexture(DWord texture);
+
+		/**
+		* @brief Marks the pages in a feedback buffer as used and queues the missing ones
+		* @param requests -> PackPageRequest values, VT_FEEDBACK_NONE is skipped
+		* @param count -> Number of requests
+		* @returns void
+		*/
+		void ProcessFeedback(const DWord* requests, usize count);
+
+		/**
+		* @brief Queues one page (and the pages above it) as if the feedback had asked for it
+		* @returns void
+		*/
+		void RequestPage(DWord texture, DWord mip, DWord x, DWord y);
+
+		/**
+		* @brief Collects finished reads, maps them and starts new ones, once per frame
+		* @param uploads -> Receives the pages to copy from staging into the cache this frame
+		* @returns void
+		*/
+		void Update(std::vector<MetalPageUpload>& uploads);
+
+		/**
+		* @brief Marks every page table level of a texture as uploaded
+		* @returns void
+		*/
+		void ClearDirty(DWord texture);
+
+		bool IsResident(DWord texture, DWord mip, DWord x, DWord y) const;
+		bool IsAlive(DWord texture) const { return texture < textures.size() && textures[texture] && textures[texture]->alive; }
+		const MetalPageTable& GetPageTable(DWord texture) const { return textures[texture]->table; }
+		const MetalVirtualTextureDesc& GetDesc(DWord texture) const { return textures[texture]->desc; }
+		const MetalPageStats& GetStats() const { return stats; }
+		DWord GetTextureCount() const { return static_cast<DWord>(textures.size()); }
+		DWord GetCacheWidth() const { return cachewidth; }
+		DWord GetCacheHeight() const { return cacheheight; }
+		DWord GetLoadingPages() const { return static_cast<DWord>(loads.size()); }
+		Byte* GetStagingPage(DWord page) const { return staging + page * pagebytes; }
+		QWord GetPageBytes() const { return pagebytes; }
+
+	protected:
+		struct Load
+		{
+			DWord				slot;
+			DWord				staging;
+			DWord				texture;
+			DWord				mip;
+			DWord				x;
+			DWord				y;
+			MetalPageReader		reader;
+			void*				userdata;
+			Byte*				destination;
+			QWord				size;
+			std::atomic<DWord>	state{ 0 };		/* 0 reading, 1 ready, 2 failed*/
+		};
+
+		struct Texture
+		{
+			MetalVirtualTextureDesc	desc;
+			MetalPageTable			table;
+			MetalPageReader			reader		= nullptr;
+			void*					userdata	= nullptr;
+			DWord					loading		= 0;	/* Reads in flight, the handle is kept until they finish*/
+			bool					alive		= false;
+		};
+
+		/* A cache page, resident unpinned pages are on the LRU list (head = most recent)*/
+		struct Slot
+		{
+			QWord	key			= 0;
+			QWord	lastused	= 0;
+			DWord	prev		= VT_INVALID;
+			DWord	next		= VT_INVALID;
+			bool	used		= false;
+			bool	loading		= false;
+			bool	pinned		= false;
+		};
+
+		static QWord MakeKey(DWord texture, DWord mip, DWord x, DWord y)
+		{
+			return (QWord(texture) << 40) | (QWord(mip) << 32) | (QWord(y) << 16) | x;
+		}
+
+		static void ReadJob(void* userdata);
+
+		void Touch(DWord slot);
+		void Unlink(DWord slot);
+		void PushFront(DWord slot);
+		DWord AllocateSlot();
+		void MapPage(DWord slot, bool map);
+		void UpdateTable(Texture& texture, DWord mip, DWord x, DWord y);
+		void FreeTextureHandle(DWord texture);
+
+		std::vector<std::unique_ptr<Texture>>	textures;
+		std::vector<DWord>						freetextures;
+		std::vector<Slot>						slots;
+		std::vector<DWord>						freeslots;
+		std::unordered_map<QWord, DWord>		pages;			/* Resident and loading pages to their slot*/
+		std::unordered_map<QWord, DWord>		requests;		/* Missing pages to how often they were asked for*/
+		std::vector<std::unique_ptr<Load>>		loads;
+		std::vector<DWord>						freestaging;
+		std::vector<std::pair<DWord, QWord>>	usedstaging;	/* Staging page and the Update its upload was handed out in*/
+		engine::jobs::MetalJobCounter			readcounter;
+		MetalPageStats							stats;
+		Byte*									staging			= nullptr;
+		QWord									pagebytes		= 0;
+		QWord									frame			= 0;
+		DWord									lruhead			= VT_INVALID;
+		DWord									lrutail			= VT_INVALID;
+		DWord									cachewidth		= 0;
+		DWord									cacheheight		= 0;
+		DWord									latency			= 0;
+	};
+
+	/**
+	* @brief Splits an image into bordered pages for every mip down to the one that fits in a single page.
+	*	The sides have to be powers of two between VT_PAGE_SIZE and VT_PAGE_SIZE * VT_MAX_PAGES.
+	* @param rgba -> Source pixels, 8-bit RGBA
+	* @param width -> Source width
+	* @param height -> Source height
+	* @param type -> What the texture is used for (picks the block format like CookTexture)
+	* @param desc -> Receives the layout
+	* @param data -> Receives every page, desc.GetPageCount() * desc.pagebytes bytes
+	* @param compress -> Encode the pages to a BC format
+	* @returns 0 if successed 1 if failure
+	*/
+	int CookVirtualTexture(const Byte* rgba, DWord width, DWord height, texturetype type, MetalVirtualTextureDesc& desc,
+		std::vector<Byte>& data, bool compress = true);
+
+	/**
+	* @brief Writes a cooked virtual texture as a MEPF_ENTRY_VIRTUAL entry
+	* @returns 0 if successed 1 if failure
+	*/
+	int WritePackageVirtualTexture(MEPF* package, const char* name, const MetalVirtualTextureDesc& desc, const std::vector<Byte>& data);
+
+	/**
+	* @brief Reads the layout of a cooked virtual texture without touching its pages
+	* @param package -> The package
+	* @param name -> The entry's name
+	* @param source -> Receives the layout and what PackageVirtualPageReader needs
+	* @returns 0 if successed 1 if failure
+	*/
+	int ReadPackageVirtualTexture(MEPF* package, const char* name, MetalPackageVirtualTexture& source);
+
+	/**
+	* @brief A MetalPageReader for virtual textures in packages, userdata is a MetalPackageVirtualTexture
+	*/
+	bool PackageVirtualPageReader(void* userdata, DWord mip, DWord x, DWord y, Byte* destination, QWord size);
+}
@@ -0,0 +1,112 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine bindless descriptor heap (one global set of textures and buffers)
+// ------------------------------------------------------
+
+#pragma once
+
+#include <mutex>
+
+#include "MVulkanRenderer.hpp"
+
+namespace engine::vulkan
+{
+	inline constexpr DWord BINDLESS_MAX_TEXTURES	= 16384;
+	inline constexpr DWord BINDLESS_MAX_BUFFERS		= 4096;
+	inline constexpr DWord BINDLESS_INVALID			= 0xFFFFFFFF;
+
+	/* Set number of the heap, set 0 stays free for per-frame data like the UMO in fog.vert*/
+	inline constexpr VkUint32 BINDLESS_SET			= 1;
+	inline constexpr VkUint32 BINDLESS_TEXTURE_BINDING	= 0;
+	inline constexpr VkUint32 BINDLESS_BUFFER_BINDING	= 1;
+
+	/* Per-draw material indices, pushed instead of binding a descriptor set per draw
+		(mirrors the push constant block in fog_bindless.frag)
+		- texture0/1 -> Slots from BindlessRegisterTexture
+		- buffer	 -> Slot from BindlessRegisterBuffer holding the material parameters
+		- material	 -> Element inside that buffer
+	*/
+	struct MetalBindlessMaterial
+	{
+		DWord texture0	= BINDLESS_INVALID;
+		DWord texture1	= BINDLESS_INVALID;
+		DWord buffer	= BINDLESS_INVALID;
+		DWord material	= 0;
+	};
+
+	inline VkDescriptorSetLayout	m_bindlesslayout		= VK_NULL_HANDLE;
+	inline VkDescriptorSet			m_bindlessset			= VK_NULL_HANDLE;
+	inline DWord					m_bindless_maxtextures	= 0;
+	inline DWord					m_bindless_maxbuffers	= 0;
+
+	/**
+	* @brief Creates m_descriptorpool and the one update-after-bind set every material indexes into
+	* @param maxtextures -> Size of the texture array (clamped to the device limit)
+	* @param maxbuffers -> Size of the storage buffer array (clamped to the device limit)
+	* @returns 0 if successed 1 if failure
+	*/
+	int VulkanCreateBindlessHeap(DWord maxtextures = BINDLESS_MAX_TEXTURES, DWord maxbuffers = BINDLESS_MAX_BUFFERS);
+
+	/**
+	* @brief Destroys the heap (the device must be idle)
+	* @returns void
+	*/
+	void VulkanDestroyBindlessHeap();
+
+	/**
+	* @brief Writes a texture into a free slot of the heap
+	* @param view -> The image view (in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+	* @param sampler -> The sampler to pair it with
+	* @returns The slot or BINDLESS_INVALID if the heap is full
+	*/
+	DWord BindlessRegisterTexture(VkImageView view, VkSampler sampler);
+
+	/**
+	* @brief Writes a storage buffer range into a free slot of the heap
+	* @returns The slot or BINDLESS_INVALID if the heap is full
+	*/
+	DWord BindlessRegisterBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+	/**
+	* @brief Gives a slot back, it is reused once the frames that might still read it have finished
+	* @returns void
+	*/
+	void BindlessReleaseTexture(DWord slot);
+	void BindlessReleaseBuffer(DWord slot);
+
+	/**
+	* @brief Advances the heap's frame counter and recycles slots released MAXIMUM_FRAMES_IN_FLIGHTS frames ago,
+	*	call once per frame after AcquireNextImage
+	* @returns void
+	*/
+	void BindlessNextFrame();
+
+	/**
+	* @brief Creates a pipeline layout with the heap at BINDLESS_SET and MetalBindlessMaterial as push constants
+	* @param frameset -> Layout for set 0 (VK_NULL_HANDLE for none)
+	* @param layout -> Receives the pipeline layout
+	* @returns void
+	*/
+	void CreateBindlessPipelineLayout(VkDescriptorSetLayout frameset, VkPipelineLayout& layout);
+
+	/**
+	* @brief Binds the heap, once per command buffer and bind point is enough
+	* @returns void
+	*/
+	void BindlessBind(VkCommandBuffer commandbuffer, VkPipelineBindPoint bindpoint, VkPipelineLayout layout);
+
+	/**
+	* @brief Pushes a draw's material indices
+	* @returns void
+	*/
+	inline void BindlessPushMaterial(VkCommandBuffer commandbuffer, VkPipelineLayout layout, const MetalBindlessMaterial& material)
+	{
+		vkCmdPushConstants(commandbuffer, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+			0, sizeof(MetalBindlessMaterial), &material);
+	}
+}
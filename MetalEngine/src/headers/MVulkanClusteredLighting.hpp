@@ -0,0 +1,123 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine GPU clustered lighting (light grid built by compute, read by material.frag)
+// ------------------------------------------------------
+
+#pragma once
+
+#include "MVulkanRenderer.hpp"
+#include "MClusteredLighting.hpp"
+
+namespace engine::vulkan
+{
+	/* Clusters per compute workgroup, has to match local_size_x in cluster_lights.comp*/
+	inline constexpr DWord CLUSTER_WORKGROUP_SIZE = 64;
+
+	/* Set material.frag reads the light grid from, set 0 is the vertex data and set 1 the bindless heap*/
+	inline constexpr DWord CLUSTER_DESCRIPTOR_SET = 2;
+
+	/* Uniforms of cluster_lights.comp and material.frag (std140)*/
+	struct MetalClusterData
+	{
+		vec4f	viewrows[4];
+		vec4f	camera;
+		float	projx;
+		float	projy;
+		float	nearz;
+		float	farz;
+		float	slicescale;		/* slice = log2(viewz) * slicescale + slicebias*/
+		float	slicebias;
+		float	inversewidth;	/* Of the render target, turns gl_FragCoord into a tile*/
+		float	inverseheight;
+		DWord	lightcount;
+		DWord	indexcapacity;
+		DWord	pad[2];
+	};
+
+	static_assert(sizeof(MetalClusterData) == 128, "MetalClusterData has to match the std140 layout in cluster_lights.comp");
+
+	/*
+		Builds the cluster light grid on the GPU every frame. RecordCulling runs cluster_lights.comp,
+		one thread per cluster, which tests every light against its cluster's box and appends the ones
+		that touch it to a shared index list. The descriptor set it writes into is the one material.frag
+		reads at CLUSTER_DESCRIPTOR_SET, so a pixel only loops over the lights of its own cluster.
+		Everything is kept per frame in flight so next frame's pass never overwrites lists still being shaded.
+	*/
+	class MetalClusteredLighting
+	{
+	public:
+		MetalClusteredLighting() = default;
+		~MetalClusteredLighting();
+
+		MetalClusteredLighting(const MetalClusteredLighting&) = delete;
+		void operator=(const MetalClusteredLighting&) = delete;
+
+		/**
+		* @brief Creates the buffers, descriptors and the culling pipeline
+		* @param maxlights -> Most lights that will ever be set
+		* @param indexcapacity -> Room in the index list, clusters past it get no lights (CLUSTER_COUNT * 32 is plenty for most scenes)
+		* @param shaderpath -> Path to the compiled cluster_lights.comp
+		* @returns 0 if successed 1 if failure
+		*/
+		int Create(DWord maxlights, DWord indexcapacity, const string& shaderpath);
+
+		/**
+		* @brief Destroys everything Create made (the device must be idle)
+		* @returns void
+		*/
+		void Destroy();
+
+		/**
+		* @brief Copies this frame's lights into its mapped light buffer, lights past maxlights are dropped
+		* @param lights -> The lights, in world space
+		* @param count -> Number of lights
+		* @returns void
+		*/
+		void SetLights(const engine::lighting::MetalPointLight* lights, DWord count);
+
+		/**
+		* @brief Records the light assignment, call outside of a render pass and before anything that shades with the grid
+		* @param commandbuffer -> The frame's command buffer
+		* @param grid -> The camera's view and projection, see MetalClusterGrid
+		* @param width -> Width of the render target in pixels
+		* @param height -> Height of the render target in pixels
+		* @returns void
+		*/
+		void RecordCulling(VkCommandBuffer commandbuffer, const engine::lighting::MetalClusterGrid& grid, DWord width, DWord height);
+
+		/* Layout of the set material.frag binds at CLUSTER_DESCRIPTOR_SET, for building its pipeline layout*/
+		VkDescriptorSetLayout GetDescriptorSetLayout() const { return descriptorsetlayout; }
+
+		/* This frame's set, bind it at CLUSTER_DESCRIPTOR_SET after RecordCulling*/
+		VkDescriptorSet GetDescriptorSet() const { return descriptorsets[CurrentFrame]; }
+
+		DWord GetLightCount() const { return lightcounts[CurrentFrame]; }
+
+	protected:
+		DWord					maxlights			= 0;
+		DWord					indexcapacity		= 0;
+		array<DWord, MAXIMUM_FRAMES_IN_FLIGHTS>				lightcounts		= {};
+		array<VkBuffer, MAXIMUM_FRAMES_IN_FLIGHTS>			lightbuffers	= {};
+		array<VkDeviceMemory, MAXIMUM_FRAMES_IN_FLIGHTS>	lightmemory		= {};
+		array<void*, MAXIMUM_FRAMES_IN_FLIGHTS>				lightmapped		= {};
+		array<VkBuffer, MAXIMUM_FRAMES_IN_FLIGHTS>			uniformbuffers	= {};
+		array<VkDeviceMemory, MAXIMUM_FRAMES_IN_FLIGHTS>	uniformmemory	= {};
+		array<void*, MAXIMUM_FRAMES_IN_FLIGHTS>				uniformmapped	= {};
+		array<VkBuffer, MAXIMUM_FRAMES_IN_FLIGHTS>			clusterbuffers	= {};	/* MetalClusterRange per cluster*/
+		array<VkDeviceMemory, MAXIMUM_FRAMES_IN_FLIGHTS>	clustermemory	= {};
+		array<VkBuffer, MAXIMUM_FRAMES_IN_FLIGHTS>			indexbuffers	= {};
+		array<VkDeviceMemory, MAXIMUM_FRAMES_IN_FLIGHTS>	indexmemory		= {};
+		array<VkBuffer, MAXIMUM_FRAMES_IN_FLIGHTS>			counterbuffers	= {};	/* Bump allocator into the index list*/
+		array<VkDeviceMemory, MAXIMUM_FRAMES_IN_FLIGHTS>	countermemory	= {};
+		array<VkDescriptorSet, MAXIMUM_FRAMES_IN_FLIGHTS>	descriptorsets	= {};
+		VkDescriptorSetLayout	descriptorsetlayout	= VK_NULL_HANDLE;
+		VkDescriptorPool		descriptorpool		= VK_NULL_HANDLE;
+		VkPipelineLayout		pipelinelayout		= VK_NULL_HANDLE;
+		VkPipeline				pipeline			= VK_NULL_HANDLE;
+	};
+}
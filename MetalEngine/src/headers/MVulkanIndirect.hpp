@@ -0,0 +1,155 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine GPU-driven rendering (compute culling + indirect draws)
+// ------------------------------------------------------
+
+#pragma once
+
+#include "MVulkanRenderer.hpp"
+
+namespace engine::vulkan
+{
+	/* Instances per compute workgroup, has to match local_size_x in cull.comp*/
+	inline constexpr DWord INDIRECT_WORKGROUP_SIZE = 64;
+
+	/* Metal GPU Instance (mirrors MetalInstance in cull.comp and fog_indirect.vert, std430)
+		- modelrows		 -> Object to world matrix, same row layout as the MVP rows in fog.vert
+		- boundingsphere -> xyz = center in object space, w = radius in object space. For cooked meshes object
+							space is quantized space (the dequantize matrix is folded into modelrows),
+							see GetQuantizedBoundingSphere
+		- mesh			 -> Index into the mesh table given to Create
+		- lodcount		 -> Consecutive table entries from mesh that are its LODs, 0 or 1 for none
+	*/
+	struct MetalGpuInstance
+	{
+		vec4f	modelrows[4];
+		vec4f	boundingsphere;
+		DWord	mesh;
+		DWord	lodcount;
+		DWord	pad[2];
+	};
+
+	static_assert(sizeof(MetalGpuInstance) == 96, "MetalGpuInstance has to match the std430 layout in cull.comp");
+
+	/* Where a mesh lives in the shared vertex and index buffers (mirrors MetalIndirectMesh in cull.comp)*/
+	struct MetalIndirectMesh
+	{
+		DWord	indexcount;
+		DWord	firstindex;
+		int		vertexoffset;
+		float	loderror;	/* Error of this LOD in object units (quantized units for cooked meshes, see AppendIndirectLods)*/
+	};
+
+	/* Push constants of cull.comp*/
+	struct MetalCullConstants
+	{
+		vec4f	viewprojrows[4];
+		DWord	instancecount;
+		DWord	compact;
+		float	lodscale;		/* engine::meshes::LodProjectionScale, 0 always draws LOD 0*/
+		float	lodthreshold;	/* Pixels*/
+	};
+
+	/*
+		All instances live on the GPU. Every frame RecordCulling clears the draw count and runs
+		cull.comp over every instance, which writes a VkDrawIndexedIndirectCommand per visible one,
+		then RecordDraw issues a single vkCmdDrawIndexedIndirectCount. On devices without
+		drawIndirectCount the shader writes a command per instance (culled ones get 0 instances)
+		and plain vkCmdDrawIndexedIndirect calls are used instead, batched at maxDrawIndirectCount
+		or one per instance when the device lacks multiDrawIndirect.
+	*/
+	class MetalIndirectRenderer
+	{
+	public:
+		MetalIndirectRenderer() = default;
+		~MetalIndirectRenderer();
+
+		MetalIndirectRenderer(const MetalIndirectRenderer&) = delete;
+		void operator=(const MetalIndirectRenderer&) = delete;
+
+		/**
+		* @brief Creates the buffers, descriptors and the culling pipeline
+		* @param maxinstances -> Most instances that will ever be uploaded
+		* @param meshes -> The mesh table instances index into
+		* @param cullshaderpath -> Path to the compiled cull.comp
+		* @returns 0 if successed 1 if failure
+		*/
+		int Create(DWord maxinstances, const vector<MetalIndirectMesh>& meshes, const string& cullshaderpath);
+
+		/**
+		* @brief Destroys everything Create made (the device must be idle)
+		* @returns void
+		*/
+		void Destroy();
+
+		/**
+		* @brief Uploads instance data, for static scenes call this once at load
+		* @param instances -> The instances
+		* @param first -> First instance slot to write
+		* @param count -> Number of instances
+		* @returns void
+		*/
+		void UploadInstances(const MetalGpuInstance* instances, DWord first, DWord count);
+
+		/**
+		* @brief Sets how many instance slots (from 0) are culled and drawn
+		* @returns void
+		*/
+		void SetInstanceCount(DWord count) { instancecount = count < maxinstances ? count : maxinstances; }
+
+		/**
+		* @brief Turns on LOD selection in the culling pass, each instance gets the coarsest LOD whose
+		*	error projects to at most threshold pixels
+		* @param projectionscale -> engine::meshes::LodProjectionScale of the camera, 0 turns it off
+		* @param threshold -> Pixels
+		* @returns void
+		*/
+		void SetLodSelection(float projectionscale, float threshold) { lodscale = projectionscale; lodthreshold = threshold; }
+
+		/**
+		* @brief Records the culling pass, call outside of a render pass
+		* @param commandbuffer -> The frame's command buffer
+		* @param viewproj -> The camera's view-projection matrix
+		* @returns void
+		*/
+		void RecordCulling(VkCommandBuffer commandbuffer, const mat4f& viewproj);
+
+		/**
+		* @brief Records the indirect draw, call inside the render pass with the graphics pipeline
+		*	(fog_indirect.vert), its descriptor set (GetInstanceBuffer() at binding 0) and the
+		*	shared vertex/index buffers already bound
+		* @param commandbuffer -> The frame's command buffer
+		* @returns void
+		*/
+		void RecordDraw(VkCommandBuffer commandbuffer);
+
+		VkBuffer GetInstanceBuffer() const { return instancebuffer; }
+		VkDeviceSize GetInstanceBufferSize() const { return sizeof(MetalGpuInstance) * maxinstances; }
+		DWord GetInstanceCount() const { return instancecount; }
+
+	protected:
+		DWord					maxinstances		= 0;
+		DWord					instancecount		= 0;
+		bool					compact				= false;
+		float					lodscale			= 0.0f;
+		float					lodthreshold		= 1.0f;
+		VkBuffer				instancebuffer		= VK_NULL_HANDLE;
+		VkDeviceMemory			instancememory		= VK_NULL_HANDLE;
+		VkBuffer				meshbuffer			= VK_NULL_HANDLE;
+		VkDeviceMemory			meshmemory			= VK_NULL_HANDLE;
+		VkBuffer				drawbuffer			= VK_NULL_HANDLE;
+		VkDeviceMemory			drawmemory			= VK_NULL_HANDLE;
+		VkBuffer				countbuffer			= VK_NULL_HANDLE;
+		VkDeviceMemory			countmemory			= VK_NULL_HANDLE;
+		VkDescriptorSetLayout	descriptorsetlayout	= VK_NULL_HANDLE;
+		VkDescriptorPool		descriptorpool		= VK_NULL_HANDLE;
+		VkDescriptorSet			descriptorset		= VK_NULL_HANDLE;
+		VkPipelineLayout		cullpipelinelayout	= VK_NULL_HANDLE;
+		VkPipeline				cullpipeline		= VK_NULL_HANDLE;
+	};
+}
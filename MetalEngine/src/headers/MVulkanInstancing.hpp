@@ -0,0 +1,207 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine hardware instancing (per frame instance ring, automatic batching)
+// ------------------------------------------------------
+
+#pragma once
+
+#include "MVulkanRenderer.hpp"
+#include "MVulkanIndirect.hpp"
+
+namespace engine::vulkan
+{
+	/* Bits of each field of an instance batch key, pipeline on top so a sorted frame changes pipeline least often*/
+	inline constexpr DWord INSTANCE_KEY_MESH_BITS		= 24;
+	inline constexpr DWord INSTANCE_KEY_MATERIAL_BITS	= 24;
+	inline constexpr DWord INSTANCE_KEY_PIPELINE_BITS	= 16;
+
+	/* Per-instance attributes of fog_instanced.vert, the upper three rows of an affine model matrix*/
+	struct MetalPackedInstance
+	{
+		vec4f	modelrows[3];
+	};
+
+	static_assert(sizeof(MetalPackedInstance) == 48, "MetalPackedInstance has to match the instance attributes in fog_instanced.vert");
+
+	/**
+	* @brief Builds the sort key instances are batched by, instances with the same key become one draw
+	* @param pipeline -> Caller's pipeline id (16 bits)
+	* @param material -> Caller's material id (24 bits)
+	* @param mesh -> Index into the mesh table given to MetalInstanceBatcher::Create (24 bits)
+	* @returns The key
+	*/
+	inline QWord MakeInstanceKey(DWord pipeline, DWord material, DWord mesh)
+	{
+		return (static_cast<QWord>(pipeline & ((1u << INSTANCE_KEY_PIPELINE_BITS) - 1)) << (INSTANCE_KEY_MATERIAL_BITS + INSTANCE_KEY_MESH_BITS)) |
+			(static_cast<QWord>(material & ((1u << INSTANCE_KEY_MATERIAL_BITS) - 1)) << INSTANCE_KEY_MESH_BITS) |
+			static_cast<QWord>(mesh & ((1u << INSTANCE_KEY_MESH_BITS) - 1));
+	}
+
+	inline DWord InstanceKeyPipeline(QWord key) { return static_cast<DWord>(key >> (INSTANCE_KEY_MATERIAL_BITS + INSTANCE_KEY_MESH_BITS)); }
+	inline DWord InstanceKeyMaterial(QWord key) { return static_cast<DWord>(key >> INSTANCE_KEY_MESH_BITS) & ((1u << INSTANCE_KEY_MATERIAL_BITS) - 1); }
+	inline DWord InstanceKeyMesh(QWord key) { return static_cast<DWord>(key) & ((1u << INSTANCE_KEY_MESH_BITS) - 1); }
+
+	/* Vertex input of fog_instanced.vert: float3 positions at binding 0, MetalPackedInstance at binding 1*/
+	struct MetalInstancedVertexInput
+	{
+		array<VkVertexInputBindingDescription, 2>	bindings	= {};
+		array<VkVertexInputAttributeDescription, 4>	attributes	= {};
+		VkPipelineVertexInputStateCreateInfo		info		= {};
+
+		MetalInstancedVertexInput();
+
+		MetalInstancedVertexInput(const MetalInstancedVertexInput&) = delete;
+		void operator=(const MetalInstancedVertexInput&) = delete;
+	};
+
+	/*
+		A host visible buffer that stays mapped, split into one region per frame in flight. The CPU
+		writes this frame's instances straight into CurrentFrame's region while the GPU may still be
+		reading the other one, so nothing is staged or copied and no fence is waited on beyond the
+		frame's own.
+	*/
+	class MetalInstanceRing
+	{
+	public:
+		MetalInstanceRing() = default;
+		~MetalInstanceRing();
+
+		MetalInstanceRing(const MetalInstanceRing&) = delete;
+		void operator=(const MetalInstanceRing&) = delete;
+
+		/**
+		* @brief Creates and maps the buffer
+		* @param instancesperframe -> Most instances one frame can write
+		* @returns 0 if successed 1 if failure
+		*/
+		int Create(DWord instancesperframe);
+
+		/**
+		* @brief Destroys the buffer (the device must be idle)
+		* @returns void
+		*/
+		void Destroy();
+
+		/**
+		* @brief Moves to CurrentFrame's region and empties it, call once the frame's fence was waited on
+		* @returns void
+		*/
+		void BeginFrame();
+
+		/**
+		* @brief Takes room for instances in this frame's region
+		* @param count -> Number of instances
+		* @param firstinstance -> Receives the firstInstance of the draw that reads them (the buffer is bound at offset 0)
+		* @returns Where to write them, nullptr if the region is full
+		*/
+		MetalPackedInstance* Allocate(DWord count, DWord& firstinstance);
+
+		VkBuffer GetBuffer() const { return buffer; }
+		DWord GetCapacity() const { return capacity; }
+		DWord GetUsed() const { return used; }
+
+	protected:
+		VkBuffer				buffer		= VK_NULL_HANDLE;
+		VkDeviceMemory			memory		= VK_NULL_HANDLE;
+		MetalPackedInstance*	mapped		= nullptr;
+		DWord					capacity	= 0;	/* Per frame*/
+		DWord					base		= 0;	/* First instance of the current region*/
+		DWord					used		= 0;
+	};
+
+	/* A run of instances that share a key, drawn with one vkCmdDrawIndexed*/
+	struct MetalInstanceBatch
+	{
+		QWord	key;
+		DWord	firstinstance;
+		DWord	instancecount;
+	};
+
+	/**
+	* @brief Called by MetalInstanceBatcher::Record before a batch whose pipeline or material differs from the one before
+	* @param commandbuffer -> The frame's command buffer
+	* @param key -> The batch's key
+	* @param previouskey -> The key of the batch before it, ~0 for the first one
+	* @param userdata -> What was given to Record
+	*/
+	typedef void (*MetalInstanceBindFunction)(VkCommandBuffer commandbuffer, QWord key, QWord previouskey, void* userdata);
+
+	/*
+		Collects a frame's instances as (key, transform) pairs, sorts them by key and writes them into
+		the instance ring in that order, so every run of equal keys is one instanced draw. Geometry is
+		looked up by the key's mesh in a table of ranges of shared vertex and index buffers, the same
+		table MetalIndirectRenderer takes.
+	*/
+	class MetalInstanceBatcher
+	{
+	public:
+		MetalInstanceBatcher() = default;
+
+		MetalInstanceBatcher(const MetalInstanceBatcher&) = delete;
+		void operator=(const MetalInstanceBatcher&) = delete;
+
+		/**
+		* @brief Creates the instance ring
+		* @param maxinstances -> Most instances one frame can submit
+		* @param meshes -> The mesh table keys index into
+		* @returns 0 if successed 1 if failure
+		*/
+		int Create(DWord maxinstances, const vector<MetalIndirectMesh>& meshes);
+
+		/**
+		* @brief Destroys the ring (the device must be idle)
+		* @returns void
+		*/
+		void Destroy();
+
+		/**
+		* @brief Starts a frame, call once the frame's fence was waited on
+		* @returns void
+		*/
+		void Begin();
+
+		/**
+		* @brief Adds an instance to the frame
+		* @param key -> From MakeInstanceKey
+		* @param model -> Object to world matrix, affine
+		* @returns false if the frame is full and the instance was dropped
+		*/
+		bool Submit(QWord key, const mat4f& model);
+
+		/**
+		* @brief Sorts the frame's instances, writes them into the ring and builds the batches
+		* @returns Number of batches
+		*/
+		DWord Build();
+
+		/**
+		* @brief Records the batches, call inside the render pass after Build
+		* @param commandbuffer -> The frame's command buffer
+		* @param instancebinding -> Vertex binding of the per-instance attributes (1 for fog_instanced.vert)
+		* @param bind -> Binds a batch's pipeline and material when they change
+		* @param userdata -> Given to bind
+		* @returns void
+		*/
+		void Record(VkCommandBuffer commandbuffer, VkUint32 instancebinding, MetalInstanceBindFunction bind, void* userdata);
+
+		const vector<MetalInstanceBatch>& GetBatches() const { return batches; }
+		DWord GetSubmittedCount() const { return static_cast<DWord>(keys.size()); }
+
+	protected:
+		DWord						maxinstances	= 0;
+		vector<MetalIndirectMesh>	meshes;
+		vector<QWord>				keys;			/* In submission order*/
+		vector<MetalPackedInstance>	transforms;		/* In submission order*/
+		vector<DWord>				order;			/* Submissions sorted by key*/
+		vector<QWord>				sortedkeys;
+		vector<QWord>				scratchkeys;
+		vector<DWord>				scratchorder;
+		vector<MetalInstanceBatch>	batches;
+		MetalInstanceRing			ring;
+	};
+}
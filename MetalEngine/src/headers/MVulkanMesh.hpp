@@ -0,0 +1,110 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine GPU meshes (cooked mesh uploads, vertex input layout)
+// ------------------------------------------------------
+
+#pragma once
+
+#include "MVulkanRenderer.hpp"
+#include "MMesh.hpp"
+#include "MVulkanIndirect.hpp"
+
+namespace engine::vulkan
+{
+	/* Vertex input locations of mesh.vert*/
+	enum MetalMeshLocation : VkUint32
+	{
+		MML_POSITION	= 0,	/* vec4, xyz quantized position and w bitangent sign (0 or 1)*/
+		MML_NORMAL		= 1,	/* vec2, octahedral*/
+		MML_TANGENT		= 2,	/* vec2, octahedral*/
+		MML_UV			= 3		/* vec2*/
+	};
+
+	/* Binding 0 is the position stream and binding 1 the attribute stream, so passes that
+		only need depth bind binding 0 and never fetch the rest
+	*/
+	struct MetalMeshVertexInput
+	{
+		array<VkVertexInputBindingDescription, 2>	bindings	= {};
+		array<VkVertexInputAttributeDescription, 4>	attributes	= {};
+		VkPipelineVertexInputStateCreateInfo		info		= {};
+
+		MetalMeshVertexInput();
+		MetalMeshVertexInput(const MetalMeshVertexInput&) = delete;
+		void operator=(const MetalMeshVertexInput&) = delete;
+
+		/**
+		* @brief Only the position stream (depth prepass, shadows)
+		* @returns void
+		*/
+		void PositionOnly() { info.vertexBindingDescriptionCount = 1; info.vertexAttributeDescriptionCount = 1; }
+	};
+
+	/* A cooked mesh on the GPU, every stream lives in one buffer*/
+	struct MetalGpuMesh
+	{
+		VkBuffer									buffer			= VK_NULL_HANDLE;
+		VkDeviceMemory								memory			= VK_NULL_HANDLE;
+		VkDeviceSize								positionoffset	= 0;	/* Into buffer*/
+		VkDeviceSize								attributeoffset	= 0;
+		VkDeviceSize								indexoffset		= 0;
+		VkIndexType									indextype		= VK_INDEX_TYPE_UINT16;
+		engine::meshes::MetalCookedMeshHeader		header			= {};
+		vector<engine::meshes::MetalCookedLod>		lods;
+		vector<engine::meshes::MetalCookedSubmesh>	submeshes;	/* Submesh i of LOD l is submeshes[l * header.submeshcount + i]*/
+		vector<engine::meshes::MetalCookedMeshlet>	meshlets;	/* Kept on the CPU, MetalMeshletRenderer uploads the ones it draws*/
+	};
+
+	/**
+	* @brief Uploads a cooked mesh from a package. The GPU data is read straight into mapped staging
+	*	memory and copied into a device local buffer, nothing is converted on the way.
+	* @param package -> The package
+	* @param name -> The entry's name
+	* @param mesh -> Receives the mesh
+	* @note Blocking, meant for load time
+	* @returns 0 if successed 1 if failure
+	*/
+	int LoadPackageMesh(MEPF* package, const char* name, MetalGpuMesh& mesh);
+
+	/**
+	* @brief Uploads a mesh cooked in memory (tools, procedural meshes)
+	* @returns 0 if successed 1 if failure
+	*/
+	int LoadCookedMesh(const engine::meshes::MetalCookedMesh& cooked, MetalGpuMesh& mesh);
+
+	/**
+	* @brief Destroys the mesh's buffer (the frames using it must be done)
+	* @returns void
+	*/
+	void DestroyGpuMesh(MetalGpuMesh& mesh);
+
+	/**
+	* @brief Adds a submesh's LOD chain to an indirect mesh table, the entries are consecutive and LOD 0 comes first
+	* @param mesh -> The mesh, bound as the shared vertex and index buffers when drawing
+	* @param submesh -> Which submesh
+	* @param table -> The table given to MetalIndirectRenderer::Create
+	* @returns The entry an instance's mesh points at, with lodcount set to mesh.lods.size()
+	* @note The errors are stored in quantized units, instances drawing them need the dequantize matrix
+	*	folded into their model matrix and GetQuantizedBoundingSphere as their bounding sphere
+	*/
+	DWord AppendIndirectLods(const MetalGpuMesh& mesh, DWord submesh, vector<MetalIndirectMesh>& table);
+
+	/**
+	* @brief The mesh's bounding sphere in quantized space, what MetalGpuInstance::boundingsphere holds
+	*	when the instance's model matrix has MakeDequantizeMatrix folded in
+	* @returns xyz = center, w = radius
+	*/
+	vec4f GetQuantizedBoundingSphere(const MetalGpuMesh& mesh);
+
+	/**
+	* @brief Binds the streams and the index buffer
+	* @param positiononly -> Only bind the position stream, for pipelines made with PositionOnly
+	* @returns void
+	*/
+	void BindGpuMesh(VkCommandBuffer commandbuffer, const MetalGpuMesh& mesh, bool positiononly = false);
+}
@@ -0,0 +1,216 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine GPU meshlet culling (depth pyramid, per meshlet indirect draws)
+// ------------------------------------------------------
+
+#pragma once
+
+#include "MVulkanRenderer.hpp"
+#include "MVulkanMesh.hpp"
+#include "MMeshlet.hpp"
+
+namespace engine::vulkan
+{
+	/* Instance and meshlet pairs per compute workgroup, has to match local_size_x in meshlet_cull.comp*/
+	inline constexpr DWord MESHLET_WORKGROUP_SIZE = 64;
+
+	/* Texels a side per workgroup, has to match depthpyramid.comp*/
+	inline constexpr DWord DEPTH_PYRAMID_WORKGROUP_SIZE = 8;
+
+	/* Push constants of depthpyramid.comp*/
+	struct MetalDepthPyramidConstants
+	{
+		int		sourcesize[2];
+		int		destinationsize[2];
+	};
+
+	/* Uniforms of meshlet_cull.comp (std140)*/
+	struct MetalMeshletCullData
+	{
+		vec4f	viewprojrows[4];
+		vec4f	occlusionrows[4];
+		vec4f	camera;
+		DWord	instancecount;
+		DWord	meshletcount;
+		DWord	compact;
+		DWord	occlusion;
+		DWord	pyramidwidth;
+		DWord	pyramidheight;
+		DWord	pyramidlevels;
+		DWord	pad;
+	};
+
+	static_assert(sizeof(MetalMeshletCullData) == 176, "MetalMeshletCullData has to match the std140 layout in meshlet_cull.comp");
+
+	/*
+		Max depth pyramid of a depth buffer, the GPU side of engine::meshes::MetalDepthPyramid.
+		Level 0 is half the depth buffer and every level halves again (rounding up) down to 1x1.
+		The image stays in VK_IMAGE_LAYOUT_GENERAL so it is written and sampled without transitions.
+	*/
+	class MetalGpuDepthPyramid
+	{
+	public:
+		MetalGpuDepthPyramid() = default;
+		~MetalGpuDepthPyramid();
+
+		MetalGpuDepthPyramid(const MetalGpuDepthPyramid&) = delete;
+		void operator=(const MetalGpuDepthPyramid&) = delete;
+
+		/**
+		* @brief Creates the pyramid image, its views and the reduction pipeline. Every level starts out at 1 (far)
+		* @param width -> Width of the depth buffer it will be built from
+		* @param height -> Height of the depth buffer it will be built from
+		* @param shaderpath -> Path to the compiled depthpyramid.comp
+		* @returns 0 if successed 1 if failure
+		*/
+		int Create(DWord width, DWord height, const string& shaderpath);
+
+		/**
+		* @brief Destroys everything Create made (the device must be idle), call before recreating on resize
+		* @returns void
+		*/
+		void Destroy();
+
+		/**
+		* @brief Records the reduction of a depth buffer into the pyramid, call outside of a render pass
+		* @param commandbuffer -> The frame's command buffer
+		* @param depthview -> Depth aspect view of the depth buffer, which was created with VK_IMAGE_USAGE_SAMPLED_BIT
+		*	and is in VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+		* @returns void
+		*/
+		void Build(VkCommandBuffer commandbuffer, VkImageView depthview);
+
+		VkImageView GetView() const { return view; }
+		VkSampler GetSampler() const { return sampler; }
+		DWord GetWidth() const { return width; }
+		DWord GetHeight() const { return height; }
+		DWord GetLevelCount() const { return static_cast<DWord>(levelwidths.size()); }
+
+	protected:
+		DWord					width				= 0;
+		DWord					height				= 0;
+		vector<DWord>			levelwidths;
+		vector<DWord>			levelheights;
+		VkImage					image				= VK_NULL_HANDLE;
+		VkDeviceMemory			memory				= VK_NULL_HANDLE;
+		VkImageView				view				= VK_NULL_HANDLE;	/* Every level, what the culling pass samples*/
+		vector<VkImageView>		levelviews;								/* One level each, written by one pass and read by the next*/
+		VkSampler				sampler				= VK_NULL_HANDLE;
+		VkDescriptorSetLayout	descriptorsetlayout	= VK_NULL_HANDLE;
+		VkDescriptorPool		descriptorpool		= VK_NULL_HANDLE;
+		vector<VkDescriptorSet>	levelsets;								/* levelsets[i] reduces level i - 1 into level i, levelsets[0] is unused*/
+		array<VkDescriptorSet, MAXIMUM_FRAMES_IN_FLIGHTS>	sourcesets	= {};	/* Reduce the depth buffer into level 0*/
+		array<VkImageView, MAXIMUM_FRAMES_IN_FLIGHTS>		sourceviews	= {};	/* What sourcesets currently point at*/
+		VkPipelineLayout		pipelinelayout		= VK_NULL_HANDLE;
+		VkPipeline				pipeline			= VK_NULL_HANDLE;
+	};
+
+	/*
+		Draws one LOD of a cooked mesh meshlet by meshlet. Every frame RecordCulling runs
+		meshlet_cull.comp over every instance and meshlet pair, which tests the meshlet against
+		the frustum, its normal cone and (with a depth pyramid set) last frame's depth, and writes a
+		VkDrawIndexedIndirectCommand per visible meshlet. Meshlets are ranges of the mesh's index
+		buffer, so RecordDraw is a single indirect draw of mesh.vert like MetalIndirectRenderer's.
+	*/
+	class MetalMeshletRenderer
+	{
+	public:
+		MetalMeshletRenderer() = default;
+		~MetalMeshletRenderer();
+
+		MetalMeshletRenderer(const MetalMeshletRenderer&) = delete;
+		void operator=(const MetalMeshletRenderer&) = delete;
+
+		/**
+		* @brief Uploads the LOD's meshlets and creates the buffers, descriptors and the culling pipeline
+		* @param mesh -> A mesh cooked with meshlets, it has to outlive the renderer
+		* @param lod -> Which LOD to draw
+		* @param maxinstances -> Most instances that will ever be uploaded, there is a draw slot for every instance and meshlet pair
+		* @param cullshaderpath -> Path to the compiled meshlet_cull.comp
+		* @param pyramidshaderpath -> Path to the compiled depthpyramid.comp, for the 1x1 pyramid bound while occlusion is off
+		* @returns 0 if successed 1 if failure
+		*/
+		int Create(const MetalGpuMesh& mesh, DWord lod, DWord maxinstances, const string& cullshaderpath, const string& pyramidshaderpath);
+
+		/**
+		* @brief Destroys everything Create made (the device must be idle)
+		* @returns void
+		*/
+		void Destroy();
+
+		/**
+		* @brief Uploads instance data, the model matrices have the mesh's dequantize matrix folded in like mesh.vert expects
+		* @param instances -> The instances
+		* @param first -> First instance slot to write
+		* @param count -> Number of instances
+		* @returns void
+		*/
+		void UploadInstances(const MetalGpuInstance* instances, DWord first, DWord count);
+
+		/**
+		* @brief Sets how many instance slots (from 0) are culled and drawn
+		* @returns void
+		*/
+		void SetInstanceCount(DWord count) { instancecount = count < maxinstances ? count : maxinstances; }
+
+		/**
+		* @brief Sets the depth pyramid occlusion is tested against, nullptr turns occlusion off
+		* @param pyramid -> Built from last frame's depth, it has to outlive its use
+		* @returns void
+		*/
+		void SetDepthPyramid(const MetalGpuDepthPyramid* pyramid) { depthpyramid = pyramid; }
+
+		/**
+		* @brief Records the culling pass, call outside of a render pass and after the pyramid's Build
+		* @param commandbuffer -> The frame's command buffer
+		* @param viewproj -> The camera's view-projection matrix
+		* @param camera -> The camera's world position
+		* @param occlusionviewproj -> The view-projection the pyramid's depth buffer was rendered with (last frame's)
+		* @returns void
+		*/
+		void RecordCulling(VkCommandBuffer commandbuffer, const mat4f& viewproj, const vec3f& camera, const mat4f& occlusionviewproj);
+
+		/**
+		* @brief Records the indirect draw, call inside the render pass with the graphics pipeline
+		*	(mesh.vert), its descriptor set (GetInstanceBuffer() at binding 0) and the mesh (BindGpuMesh) already bound
+		* @param commandbuffer -> The frame's command buffer
+		* @returns void
+		*/
+		void RecordDraw(VkCommandBuffer commandbuffer);
+
+		VkBuffer GetInstanceBuffer() const { return instancebuffer; }
+		VkDeviceSize GetInstanceBufferSize() const { return sizeof(MetalGpuInstance) * maxinstances; }
+		DWord GetInstanceCount() const { return instancecount; }
+		DWord GetMeshletCount() const { return meshletcount; }
+
+	protected:
+		DWord					maxinstances		= 0;
+		DWord					instancecount		= 0;
+		DWord					meshletcount		= 0;
+		bool					compact				= false;
+		const MetalGpuDepthPyramid*	depthpyramid	= nullptr;
+		MetalGpuDepthPyramid	emptypyramid;		/* Keeps binding 4 valid while occlusion is off*/
+		VkBuffer				instancebuffer		= VK_NULL_HANDLE;
+		VkDeviceMemory			instancememory		= VK_NULL_HANDLE;
+		VkBuffer				meshletbuffer		= VK_NULL_HANDLE;
+		VkDeviceMemory			meshletmemory		= VK_NULL_HANDLE;
+		VkBuffer				drawbuffer			= VK_NULL_HANDLE;
+		VkDeviceMemory			drawmemory			= VK_NULL_HANDLE;
+		VkBuffer				countbuffer			= VK_NULL_HANDLE;
+		VkDeviceMemory			countmemory			= VK_NULL_HANDLE;
+		array<VkBuffer, MAXIMUM_FRAMES_IN_FLIGHTS>			uniformbuffers	= {};
+		array<VkDeviceMemory, MAXIMUM_FRAMES_IN_FLIGHTS>	uniformmemory	= {};
+		array<void*, MAXIMUM_FRAMES_IN_FLIGHTS>				uniformmapped	= {};
+		array<VkDescriptorSet, MAXIMUM_FRAMES_IN_FLIGHTS>	descriptorsets	= {};
+		array<VkImageView, MAXIMUM_FRAMES_IN_FLIGHTS>		pyramidviews	= {};	/* What binding 4 of each set currently points at*/
+		VkDescriptorSetLayout	descriptorsetlayout	= VK_NULL_HANDLE;
+		VkDescriptorPool		descriptorpool		= VK_NULL_HANDLE;
+		VkPipelineLayout		cullpipelinelayout	= VK_NULL_HANDLE;
+		VkPipeline				cullpipeline		= VK_NULL_HANDLE;
+	};
+}
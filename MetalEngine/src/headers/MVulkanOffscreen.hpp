@@ -0,0 +1,110 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine offscreen rendering (headless frames read back through host visible buffers)
+// ------------------------------------------------------
+
+#pragma once
+
+#include "MVulkanRenderer.hpp"
+
+namespace engine::vulkan
+{
+	/* One frame in flight of an offscreen target*/
+	struct MetalOffscreenFrame
+	{
+		VkImage			colorimage		= VK_NULL_HANDLE;
+		VkDeviceMemory	colormemory		= VK_NULL_HANDLE;
+		VkImageView		colorview		= VK_NULL_HANDLE;
+		VkImage			depthimage		= VK_NULL_HANDLE;
+		VkDeviceMemory	depthmemory		= VK_NULL_HANDLE;
+		VkImageView		depthview		= VK_NULL_HANDLE;
+		VkFramebuffer	framebuffer		= VK_NULL_HANDLE;
+		VkBuffer		readbackbuffer	= VK_NULL_HANDLE;
+		VkDeviceMemory	readbackmemory	= VK_NULL_HANDLE;
+		Byte*			readback		= nullptr;	/* Stays mapped*/
+		VkCommandBuffer	commandbuffer	= VK_NULL_HANDLE;
+		VkFence			fence			= VK_NULL_HANDLE;
+	};
+
+	/*
+		Stands in for the swapchain when the renderer runs headless (VulkanSetupHeadless). Every frame in
+		flight has its own color and depth image, and EndFrame copies the color image into a host visible
+		buffer of that frame, so reading a frame back only waits for that frame and never for the GPU as a whole.
+		A frame's pixels stay readable until its slot comes round again MAXIMUM_FRAMES_IN_FLIGHTS frames later.
+
+		When headless, Create also points m_renderpass, m_swapchain_extent and m_swapchain_image_format at the
+		target so pipelines made afterwards render into it unchanged.
+	*/
+	class MetalOffscreenTarget
+	{
+	public:
+		MetalOffscreenTarget() = default;
+		~MetalOffscreenTarget();
+
+		MetalOffscreenTarget(const MetalOffscreenTarget&) = delete;
+		void operator=(const MetalOffscreenTarget&) = delete;
+
+		/**
+		* @brief Creates the images, render pass, framebuffers and readback buffers
+		* @param width, height -> Size of the frames
+		* @param format -> An 8-bit RGBA or BGRA format (UNORM or SRGB)
+		* @returns 0 if successed 1 if failure
+		*/
+		int Create(VkUint32 width, VkUint32 height, VkFormat format = VK_FORMAT_R8G8B8A8_UNORM);
+
+		/**
+		* @brief Waits for the frames in flight and destroys everything Create made
+		* @returns void
+		*/
+		void Destroy();
+
+		/**
+		* @brief Waits for the CurrentFrame slot to be free and begins its command buffer, record
+		*	uploads and compute work, then call BeginRenderPass
+		* @returns The command buffer to record the frame into
+		*/
+		VkCommandBuffer BeginFrame();
+
+		/**
+		* @brief Begins the render pass on the frame's color and depth images
+		* @param clearcolor -> RGBA the color image is cleared to
+		* @returns void
+		*/
+		void BeginRenderPass(const float clearcolor[4]);
+
+		/**
+		* @brief Ends the render pass, copies the color image into the readback buffer, submits and moves CurrentFrame on
+		* @returns void
+		*/
+		void EndFrame();
+
+		/**
+		* @brief Waits for the last submitted frame and gives its pixels
+		* @returns width * height tightly packed 4 byte pixels in the target's format, nullptr if nothing was rendered yet
+		*/
+		const Byte* ReadbackLastFrame();
+
+		/**
+		* @brief Writes the last submitted frame as a binary PPM (thumbnails, comparing runs)
+		* @param path -> The .ppm file to write
+		* @returns 0 if successed 1 if failure
+		*/
+		int SaveLastFrame(const char* path);
+
+		VkRenderPass GetRenderPass() const { return renderpass; }
+		VkExtent2D GetExtent() const { return extent; }
+		VkFormat GetFormat() const { return format; }
+
+	protected:
+		array<MetalOffscreenFrame, MAXIMUM_FRAMES_IN_FLIGHTS>	frames;
+		VkRenderPass											renderpass	= VK_NULL_HANDLE;
+		VkExtent2D												extent		= {};
+		VkFormat												format		= VK_FORMAT_UNDEFINED;
+		VkUsize													lastframe	= MAXIMUM_FRAMES_IN_FLIGHTS;	/* Slot of the last EndFrame, none yet*/
+	};
+}
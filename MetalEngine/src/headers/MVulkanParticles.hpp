@@ -0,0 +1,213 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine GPU particles (emit, simulate and compact by compute, bitonic depth sort, indirect draw)
+// ------------------------------------------------------
+
+#pragma once
+
+#include "MVulkanRenderer.hpp"
+
+namespace engine::vulkan
+{
+	/* Particles per compute workgroup, has to match local_size_x in particle_emit.comp and particle_simulate.comp*/
+	inline constexpr DWord PARTICLE_WORKGROUP_SIZE = 64;
+
+	/* Entries one particle_sort.comp workgroup sorts in shared memory (two per thread), has to match PARTICLE_SORT_BLOCK there*/
+	inline constexpr DWord PARTICLE_SORT_BLOCK = 512;
+
+	/* Vertices per particle, particle.vert expands every instance into two triangles*/
+	inline constexpr DWord PARTICLE_QUAD_VERTICES = 6;
+
+	/* One particle (mirrors MetalParticle in the particle shaders, std430)*/
+	struct MetalGpuParticle
+	{
+		vec4f	positionsize;		/* World space position, w is the size of the quad*/
+		vec4f	velocityage;		/* World space velocity, w is the seconds it has been alive*/
+		vec4f	color;
+		float	lifetime;			/* Seconds it lives for*/
+		float	pad[3];
+	};
+
+	static_assert(sizeof(MetalGpuParticle) == 64, "MetalGpuParticle has to match the std430 layout in particle_simulate.comp");
+
+	/* Metal Particle Emitter
+		- position, radius -> New particles start somewhere in this sphere
+		- velocity, spread -> Starting velocity, every axis gets up to spread of random added
+		- gravity, drag -> Constant acceleration and the fraction of velocity lost per second
+		- rate -> Particles per second, fractions carry over to the next frame
+		Color and size go from start to end over a particle's life
+	*/
+	struct MetalParticleEmitter
+	{
+		vec3f	position;
+		float	radius				= 0.0f;
+		vec3f	velocity;
+		float	spread				= 0.0f;
+		vec3f	gravity				= vec3f(0.0f, -9.81f, 0.0f);
+		float	drag				= 0.0f;
+		vec4f	startcolor			= vec4f(1.0f, 1.0f, 1.0f, 1.0f);
+		vec4f	endcolor			= vec4f(1.0f, 1.0f, 1.0f, 0.0f);
+		float	startsize			= 0.1f;
+		float	endsize				= 0.1f;
+		float	lifetime			= 1.0f;
+		float	lifetimevariance	= 0.0f;		/* Lifetimes are spread over lifetime +- this*/
+		float	rate				= 0.0f;
+	};
+
+	/* What the particles are seen from, right, up and forward are the camera's world space axes*/
+	struct MetalParticleCamera
+	{
+		mat4f	viewproj;
+		vec3f	position;
+		vec3f	right;
+		vec3f	up;
+		vec3f	forward;
+	};
+
+	/* Uniforms of every particle shader (std140)*/
+	struct MetalParticleData
+	{
+		vec4f	viewprojrows[4];
+		vec4f	cameraright;
+		vec4f	cameraup;
+		vec4f	cameraforward;		/* w = -dot(forward, camera position) so dot(forward, p) + w is view depth*/
+		vec4f	emitterposition;	/* w = radius*/
+		vec4f	emittervelocity;	/* w = spread*/
+		vec4f	gravity;			/* w = drag*/
+		vec4f	startcolor;
+		vec4f	endcolor;
+		vec4f	tint;				/* The uColor of fog.frag, the whole system is modulated by it*/
+		float	deltatime;
+		float	lifetime;
+		float	lifetimevariance;
+		float	startsize;
+		float	endsize;
+		DWord	emitcount;
+		DWord	capacity;
+		DWord	seed;
+		DWord	sortcount;			/* Entries in the sort list, a power of two, 0 draws unsorted*/
+		DWord	pad[3];
+	};
+
+	static_assert(sizeof(MetalParticleData) == 256, "MetalParticleData has to match the std140 layout in the particle shaders");
+
+	/* Push constants of particle_sort.comp*/
+	struct MetalParticleSortConstants
+	{
+		DWord	mode;		/* 0 sorts whole blocks, 1 is one global compare step, 2 finishes a merge inside blocks*/
+		DWord	size;		/* Size of the bitonic sequences being merged*/
+		DWord	stride;		/* Distance between compared entries, for mode 1*/
+		DWord	pad;
+	};
+
+	/* Compiled shaders the particle system is built from*/
+	struct MetalParticleShaderPaths
+	{
+		string	emit;		/* particle_emit.comp*/
+		string	simulate;	/* particle_simulate.comp*/
+		string	sort;		/* particle_sort.comp*/
+		string	vertex;		/* particle.vert*/
+		string	fragment;	/* particle.frag*/
+	};
+
+	/*
+		A particle system that lives entirely on the GPU. Particles are kept in two buffers that
+		swap every frame: particle_emit.comp appends the new particles after the alive ones of the
+		source, and particle_simulate.comp ages and moves every one of them, writing the survivors
+		packed into the destination. The destination's instance count is the draw command itself, so
+		RecordDraw is one vkCmdDrawIndirect of exactly the alive particles and the CPU never reads back.
+		When sorted, particle_sort.comp orders the alive particles back to front with a bitonic sort
+		before they are drawn alpha blended through particle.frag (fog.frag's texture modulate).
+	*/
+	class MetalGpuParticles
+	{
+	public:
+		MetalGpuParticles() = default;
+		~MetalGpuParticles();
+
+		MetalGpuParticles(const MetalGpuParticles&) = delete;
+		void operator=(const MetalGpuParticles&) = delete;
+
+		/**
+		* @brief Creates the particle buffers, the compute pipelines and the draw pipeline
+		* @param capacity -> Most particles alive at once, emission stops while the system is full
+		* @param sorted -> Sort back to front every frame, needed for alpha blending but not for additive effects
+		* @param shaders -> The compiled shaders
+		* @param renderpass -> Render pass RecordDraw will be called in
+		* @param width -> Width of the render target
+		* @param height -> Height of the render target
+		* @returns 0 if successed 1 if failure
+		*/
+		int Create(DWord capacity, bool sorted, const MetalParticleShaderPaths& shaders, VkRenderPass renderpass, DWord width, DWord height);
+
+		/**
+		* @brief Destroys everything Create made (the device must be idle)
+		* @returns void
+		*/
+		void Destroy();
+
+		/**
+		* @brief Sets the two textures particle.frag modulates, like uSample0 and uSample1 of fog.frag
+		* @note Updates every draw set, call while the device is idle (after Create or between levels)
+		* @returns void
+		*/
+		void SetTextures(VkImageView texture0, VkImageView texture1, VkSampler sampler);
+
+		void SetEmitter(const MetalParticleEmitter& source) { emitter = source; }
+		void SetTint(const vec4f& color) { tint = color; }
+
+		/**
+		* @brief Records emission, simulation and the sort, call outside of a render pass once per frame
+		* @param commandbuffer -> The frame's command buffer
+		* @param deltatime -> Seconds since the last frame
+		* @param camera -> The camera the particles will be drawn from
+		* @returns void
+		*/
+		void RecordSimulation(VkCommandBuffer commandbuffer, float deltatime, const MetalParticleCamera& camera);
+
+		/**
+		* @brief Records the indirect draw, call inside the render pass after the opaque geometry
+		* @param commandbuffer -> The frame's command buffer
+		* @returns void
+		*/
+		void RecordDraw(VkCommandBuffer commandbuffer);
+
+		DWord GetCapacity() const { return capacity; }
+		bool IsSorted() const { return sortcount != 0; }
+
+	protected:
+		DWord					capacity			= 0;
+		DWord					sortcount			= 0;
+		DWord					source				= 0;	/* Which state buffer holds the alive particles, flips every frame*/
+		DWord					seed				= 0;
+		float					emitcarry			= 0.0f;	/* Fraction of a particle the rate still owes*/
+		bool					textures			= false;
+		MetalParticleEmitter	emitter;
+		vec4f					tint				= vec4f(1.0f, 1.0f, 1.0f, 1.0f);
+		array<VkBuffer, 2>			particlebuffers	= {};
+		array<VkDeviceMemory, 2>	particlememory	= {};
+		array<VkBuffer, 2>			drawbuffers		= {};	/* VkDrawIndirectCommand, instanceCount is the alive count*/
+		array<VkDeviceMemory, 2>	drawmemory		= {};
+		VkBuffer				sortbuffer			= VK_NULL_HANDLE;
+		VkDeviceMemory			sortmemory			= VK_NULL_HANDLE;
+		array<VkBuffer, MAXIMUM_FRAMES_IN_FLIGHTS>			uniformbuffers	= {};
+		array<VkDeviceMemory, MAXIMUM_FRAMES_IN_FLIGHTS>	uniformmemory	= {};
+		array<void*, MAXIMUM_FRAMES_IN_FLIGHTS>				uniformmapped	= {};
+		array<VkDescriptorSet, MAXIMUM_FRAMES_IN_FLIGHTS * 2>	computesets	= {};	/* [frame * 2 + source]*/
+		array<VkDescriptorSet, MAXIMUM_FRAMES_IN_FLIGHTS * 2>	drawsets	= {};	/* [frame * 2 + buffer drawn]*/
+		VkDescriptorSetLayout	computesetlayout	= VK_NULL_HANDLE;
+		VkDescriptorSetLayout	drawsetlayout		= VK_NULL_HANDLE;
+		VkDescriptorPool		descriptorpool		= VK_NULL_HANDLE;
+		VkPipelineLayout		computelayout		= VK_NULL_HANDLE;
+		VkPipelineLayout		drawlayout			= VK_NULL_HANDLE;
+		VkPipeline				emitpipeline		= VK_NULL_HANDLE;
+		VkPipeline				simulatepipeline	= VK_NULL_HANDLE;
+		VkPipeline				sortpipeline		= VK_NULL_HANDLE;
+		VkPipeline				drawpipeline		= VK_NULL_HANDLE;
+	};
+}
@@ -0,0 +1,170 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine post processing (HDR render target, compute bloom, tonemapping and sRGB output)
+// ------------------------------------------------------
+
+#pragma once
+
+#include "MVulkanRenderer.hpp"
+
+namespace engine::vulkan
+{
+	/* Texels a side per workgroup, has to match the bloom and tonemap shaders*/
+	inline constexpr DWord POST_PROCESS_WORKGROUP_SIZE = 8;
+
+	/* Most bloom levels, level 0 is half the target so 8 reaches 1/256*/
+	inline constexpr DWord POST_PROCESS_MAX_BLOOM_LEVELS = 8;
+
+	/* Push constants of bloom_downsample.comp, bloom_upsample.comp and tonemap.comp*/
+	struct MetalPostProcessConstants
+	{
+		int		sourcesize[2];
+		int		destinationsize[2];
+		float	threshold;
+		float	knee;
+		float	intensity;
+		float	exposure;
+		DWord	mode;		/* bloom_downsample.comp thresholds the source when 1*/
+		DWord	pad[3];
+	};
+
+	/* Metal Post Process Settings
+		- exposure -> Scale of the HDR color before tonemapping
+		- bloomthreshold, bloomknee -> Brightness bloom starts at, the knee softens the cut around it
+		- bloomintensity -> How much of the bloom chain is added onto the target
+	*/
+	struct MetalPostProcessSettings
+	{
+		float	exposure		= 1.0f;
+		float	bloomthreshold	= 1.0f;
+		float	bloomknee		= 0.5f;
+		float	bloomintensity	= 0.05f;
+	};
+
+	/* Compiled shaders the chain is built from*/
+	struct MetalPostProcessShaderPaths
+	{
+		string	downsample;		/* bloom_downsample.comp*/
+		string	upsample;		/* bloom_upsample.comp*/
+		string	tonemap;		/* tonemap.comp*/
+	};
+
+	/* One frame in flight's images, nothing is shared between frames so a frame never waits on the other*/
+	struct MetalPostProcessFrame
+	{
+		VkImage				colorimage		= VK_NULL_HANDLE;	/* The HDR target*/
+		VkDeviceMemory		colormemory		= VK_NULL_HANDLE;
+		VkImageView			colorview		= VK_NULL_HANDLE;
+		VkImage				depthimage		= VK_NULL_HANDLE;
+		VkDeviceMemory		depthmemory		= VK_NULL_HANDLE;
+		VkImageView			depthview		= VK_NULL_HANDLE;
+		VkFramebuffer		framebuffer		= VK_NULL_HANDLE;
+		VkImage				bloomimage		= VK_NULL_HANDLE;	/* Every bloom level as a mip*/
+		VkDeviceMemory		bloommemory		= VK_NULL_HANDLE;
+		vector<VkImageView>	bloomviews;							/* One level each*/
+		VkImage				outputimage		= VK_NULL_HANDLE;	/* Tonemapped and sRGB encoded, blitted to the destination*/
+		VkDeviceMemory		outputmemory	= VK_NULL_HANDLE;
+		VkImageView			outputview		= VK_NULL_HANDLE;
+		vector<VkDescriptorSet>	downsamplesets;					/* downsamplesets[i] writes level i*/
+		vector<VkDescriptorSet>	upsamplesets;					/* upsamplesets[i] adds level i + 1 onto level i*/
+		VkDescriptorSet		tonemapset		= VK_NULL_HANDLE;
+	};
+
+	/*
+		Scenes are drawn into an R16G16B16A16_SFLOAT (or B10G11R11_UFLOAT_PACK32) target instead of
+		the swapchain image, then Record runs the rest of the frame in compute. bloom_downsample.comp
+		thresholds the target into a chain of levels starting at half resolution and halves it down the
+		chain, bloom_upsample.comp tent filters every level back onto the one above, and tonemap.comp
+		adds the bloom, tonemaps and encodes to sRGB at full resolution. Every pass stages the texels
+		its workgroup reads in shared memory. Swapchain images can't portably be storage images, so
+		the result is blitted onto the destination at the end.
+
+		The renderer owns one for the swapchain (VulkanEnablePostProcess), VulkanBeginFrameRenderPass and
+		VulkanEndFrameRenderPass drive it and VulkanRecreateSwapchain replaces it on resize, the old one
+		is destroyed with the retired swapchain once no frame in flight uses it.
+	*/
+	class MetalPostProcess
+	{
+	public:
+		MetalPostProcess() = default;
+		~MetalPostProcess();
+
+		MetalPostProcess(const MetalPostProcess&) = delete;
+		void operator=(const MetalPostProcess&) = delete;
+
+		/**
+		* @brief Creates the HDR targets, their render pass, the bloom chains and the compute pipelines
+		* @param width -> Width of the target, usually m_swapchain_extent.width
+		* @param height -> Height of the target
+		* @param destinationformat -> Format of the images Record blits to, it has to be a UNORM format
+		*	since the output is already sRGB encoded (ChooseSwapSurfaceFormat picks B8G8R8A8_UNORM)
+		* @param shaders -> The compiled shaders
+		* @param hdrformat -> VK_FORMAT_R16G16B16A16_SFLOAT or VK_FORMAT_B10G11R11_UFLOAT_PACK32 (half the
+		*	bandwidth, no alpha), falls back to the first when the device can't render to and sample the second
+		* @param bloomlevels -> Levels of the bloom chain, capped at POST_PROCESS_MAX_BLOOM_LEVELS and at 1x1
+		* @returns 0 if successed 1 if failure
+		*/
+		int Create(VkUint32 width, VkUint32 height, VkFormat destinationformat, const MetalPostProcessShaderPaths& shaders,
+			VkFormat hdrformat = VK_FORMAT_R16G16B16A16_SFLOAT, DWord bloomlevels = 6);
+
+		/**
+		* @brief Destroys everything Create made, no frame in flight may still be using it
+		* @returns void
+		*/
+		void Destroy();
+
+		void SetSettings(const MetalPostProcessSettings& source) { settings = source; }
+		const MetalPostProcessSettings& GetSettings() const { return settings; }
+
+		/**
+		* @brief Begins the HDR render pass of the current frame, pipelines drawn in it have to be created with GetRenderPass
+		* @param commandbuffer -> The frame's command buffer
+		* @param clearcolor -> Linear HDR color the target is cleared to
+		* @returns void
+		*/
+		void BeginRenderPass(VkCommandBuffer commandbuffer, const float clearcolor[4]);
+
+		/**
+		* @brief Ends the HDR render pass, the target is left for the compute passes to read
+		* @returns void
+		*/
+		void EndRenderPass(VkCommandBuffer commandbuffer);
+
+		/**
+		* @brief Records bloom, tonemapping and the blit onto the destination, call after EndRenderPass
+		* @param commandbuffer -> The frame's command buffer
+		* @param destination -> Image to blit to, created with VK_IMAGE_USAGE_TRANSFER_DST_BIT and the size of the
+		*	target. Its contents are discarded, a swapchain image straight from vkAcquireNextImageKHR works.
+		* @param finallayout -> Layout the destination is left in, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR to present it
+		*	or whatever the next pass over it (UI drawn with a loading render pass) expects
+		* @returns void
+		*/
+		void Record(VkCommandBuffer commandbuffer, VkImage destination, VkImageLayout finallayout);
+
+		VkRenderPass GetRenderPass() const { return renderpass; }
+		VkFormat GetFormat() const { return format; }
+		VkExtent2D GetExtent() const { return extent; }
+		DWord GetBloomLevelCount() const { return static_cast<DWord>(levelwidths.size()); }
+
+	protected:
+		VkExtent2D					extent				= { 0, 0 };
+		VkFormat					format				= VK_FORMAT_UNDEFINED;
+		MetalPostProcessSettings	settings;
+		vector<DWord>				levelwidths;
+		vector<DWord>				levelheights;
+		array<MetalPostProcessFrame, MAXIMUM_FRAMES_IN_FLIGHTS>	frames;
+		VkRenderPass				renderpass			= VK_NULL_HANDLE;
+		VkSampler					sampler				= VK_NULL_HANDLE;
+		VkDescriptorSetLayout		descriptorsetlayout	= VK_NULL_HANDLE;
+		VkDescriptorPool			descriptorpool		= VK_NULL_HANDLE;
+		VkPipelineLayout			pipelinelayout		= VK_NULL_HANDLE;
+		VkPipeline					downsamplepipeline	= VK_NULL_HANDLE;
+		VkPipeline					upsamplepipeline	= VK_NULL_HANDLE;
+		VkPipeline					tonemappipeline		= VK_NULL_HANDLE;
+	};
+}
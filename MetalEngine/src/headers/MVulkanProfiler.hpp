@@ -0,0 +1,84 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine GPU profiler (timestamp queries fed into the frame profiler's GPU track)
+// ------------------------------------------------------
+
+#pragma once
+
+#include "MVulkanRenderer.hpp"
+#include "MProfiler.hpp"
+
+/*
+	- METAL_GPU_ZONE(commandbuffer, "name") -> Times the commands recorded in the enclosing scope on the GPU
+	Like METAL_ZONE it only exists with METAL_PROFILE. The command buffer has to be the one for
+	CurrentFrame, recorded between AcquireNextImage and SubmitCommandBuffers.
+*/
+#if defined(METAL_PROFILE)
+	#define METAL_GPU_ZONE(commandbuffer, name) engine::vulkan::MetalGpuZoneScope METAL_PROFILE_CONCAT(metalgpuzone, __LINE__)(commandbuffer, "" name)
+#else
+	#define METAL_GPU_ZONE(commandbuffer, name) ((void)0)
+#endif
+
+namespace engine::vulkan
+{
+	inline constexpr DWord GPU_PROFILER_ZONES		= 64;	/* Zones one frame can hold, the rest are ignored*/
+	inline constexpr DWord GPU_PROFILER_INVALID	= 0xFFFFFFFF;
+
+	/**
+	* @brief Creates the timestamp query pool and lines the GPU clock up with the CPU one,
+	*	SubmitCommandBuffers brackets every frame with a "GPU Frame" zone from then on.
+	*	Needs ProfilerInit to have measured the CPU clock first.
+	* @returns 0 if successed 1 if failure (the queue has no timestamps, zones are then ignored)
+	*/
+	int GpuProfilerCreate(void);
+
+	/**
+	* @brief Destroys the query pool (the device must be idle)
+	* @returns void
+	*/
+	void GpuProfilerDestroy(void);
+
+	/**
+	* @brief Reads the timestamps of the frame CurrentFrame last ran and hands them to the profiler,
+	*	AcquireNextImage calls this right after waiting on the frame's fence
+	* @returns void
+	*/
+	void GpuProfilerCollect(void);
+
+	/**
+	* @brief Swaps in the command buffers that write the frame's begin and end timestamps
+	* @param buffers -> The frame's command buffers
+	* @param count -> How many there are
+	* @param output -> Receives them, needs room for count + 2
+	* @returns The number of command buffers written to output
+	*/
+	VkUint32 GpuProfilerWrapSubmit(const VkCommandBuffer* buffers, VkUint32 count, VkCommandBuffer* output);
+
+	/**
+	* @brief Writes a zone's begin timestamp
+	* @param name -> Has to outlive the profiler, only the pointer is kept
+	* @returns The zone to hand to GpuZoneEnd or GPU_PROFILER_INVALID
+	*/
+	DWord GpuZoneBegin(VkCommandBuffer commandbuffer, const char* name);
+	void GpuZoneEnd(VkCommandBuffer commandbuffer, DWord zone);
+
+	/* Use METAL_GPU_ZONE instead of making these by hand*/
+	class MetalGpuZoneScope
+	{
+	public:
+		MetalGpuZoneScope(VkCommandBuffer commandbuffer, const char* name) : commandbuffer(commandbuffer), zone(GpuZoneBegin(commandbuffer, name)) {}
+		~MetalGpuZoneScope() { GpuZoneEnd(commandbuffer, zone); }
+
+		MetalGpuZoneScope(const MetalGpuZoneScope&) = delete;
+		void operator=(const MetalGpuZoneScope&) = delete;
+
+	protected:
+		VkCommandBuffer	commandbuffer;
+		DWord			zone;
+	};
+}
@@ -0,0 +1,185 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine render queue (64-bit draw sort keys, state change minimizing submission)
+// ------------------------------------------------------
+
+#pragma once
+
+#include <cstring>
+
+#include "MVulkanRenderer.hpp"
+
+namespace engine::vulkan
+{
+	/* Bits of each field of a draw key, from the top: pass, pipeline, material, mesh, depth*/
+	inline constexpr DWord DRAW_KEY_PASS_BITS		= 4;
+	inline constexpr DWord DRAW_KEY_PIPELINE_BITS	= 12;
+	inline constexpr DWord DRAW_KEY_MATERIAL_BITS	= 16;
+	inline constexpr DWord DRAW_KEY_MESH_BITS		= 16;
+	inline constexpr DWord DRAW_KEY_DEPTH_BITS		= 16;
+
+	static_assert(DRAW_KEY_PASS_BITS + DRAW_KEY_PIPELINE_BITS + DRAW_KEY_MATERIAL_BITS + DRAW_KEY_MESH_BITS + DRAW_KEY_DEPTH_BITS == 64,
+		"A draw key is 64 bits");
+
+	/**
+	* @brief Folds a pipeline hash (of its shaders and state, or just its handle) into the key's pipeline field
+	* @returns DRAW_KEY_PIPELINE_BITS bits
+	*/
+	inline QWord DrawKeyPipeline(QWord hash)
+	{
+		hash ^= hash >> 32;
+		hash ^= hash >> 16;
+		return hash & ((1ull << DRAW_KEY_PIPELINE_BITS) - 1);
+	}
+
+	/**
+	* @brief The depth field, the top bits of the float, which order like the depth itself for positive values
+	* @param viewdepth -> Distance along the view direction, negative counts as 0
+	* @returns DRAW_KEY_DEPTH_BITS bits
+	*/
+	inline QWord DrawKeyDepth(float viewdepth)
+	{
+		DWord bits = 0;
+		viewdepth = viewdepth > 0.0f ? viewdepth : 0.0f;
+		std::memcpy(&bits, &viewdepth, sizeof(bits));
+		return bits >> (32 - DRAW_KEY_DEPTH_BITS);
+	}
+
+	/**
+	* @brief Key of an opaque draw: by pass, then state so binds are shared, then front to back within equal state
+	* @param pass -> Order of the pass in the frame (DRAW_KEY_PASS_BITS)
+	* @param pipelinehash -> Anything that is equal for equal pipelines, see DrawKeyPipeline
+	* @param material -> Material index (DRAW_KEY_MATERIAL_BITS)
+	* @param mesh -> Mesh index (DRAW_KEY_MESH_BITS)
+	* @param viewdepth -> Distance along the view direction
+	* @returns The key
+	*/
+	inline QWord MakeDrawKey(DWord pass, QWord pipelinehash, DWord material, DWord mesh, float viewdepth)
+	{
+		return (static_cast<QWord>(pass & ((1u << DRAW_KEY_PASS_BITS) - 1)) << (64 - DRAW_KEY_PASS_BITS)) |
+			(DrawKeyPipeline(pipelinehash) << (DRAW_KEY_MATERIAL_BITS + DRAW_KEY_MESH_BITS + DRAW_KEY_DEPTH_BITS)) |
+			(static_cast<QWord>(material & ((1u << DRAW_KEY_MATERIAL_BITS) - 1)) << (DRAW_KEY_MESH_BITS + DRAW_KEY_DEPTH_BITS)) |
+			(static_cast<QWord>(mesh & ((1u << DRAW_KEY_MESH_BITS) - 1)) << DRAW_KEY_DEPTH_BITS) |
+			DrawKeyDepth(viewdepth);
+	}
+
+	/**
+	* @brief Key of a blended draw: by pass, then back to front, state only breaks ties because blending needs the order
+	* @returns The key, same fields as MakeDrawKey with the depth moved up under the pass and inverted
+	*/
+	inline QWord MakeBlendedDrawKey(DWord pass, QWord pipelinehash, DWord material, DWord mesh, float viewdepth)
+	{
+		QWord depth = ((1ull << DRAW_KEY_DEPTH_BITS) - 1) - DrawKeyDepth(viewdepth);
+		return (static_cast<QWord>(pass & ((1u << DRAW_KEY_PASS_BITS) - 1)) << (64 - DRAW_KEY_PASS_BITS)) |
+			(depth << (DRAW_KEY_PIPELINE_BITS + DRAW_KEY_MATERIAL_BITS + DRAW_KEY_MESH_BITS)) |
+			(DrawKeyPipeline(pipelinehash) << (DRAW_KEY_MATERIAL_BITS + DRAW_KEY_MESH_BITS)) |
+			(static_cast<QWord>(material & ((1u << DRAW_KEY_MATERIAL_BITS) - 1)) << DRAW_KEY_MESH_BITS) |
+			static_cast<QWord>(mesh & ((1u << DRAW_KEY_MESH_BITS) - 1));
+	}
+
+	/* Metal Draw Item, everything a draw binds and what it draws
+		- pipeline		 -> Graphics pipeline
+		- layout		 -> Its layout, descriptor sets are bound through it
+		- descriptorset	 -> Bound at set 0 (VK_NULL_HANDLE binds nothing)
+		- vertexbuffer	 -> Bound at binding 0 (VK_NULL_HANDLE for shaders that pull their vertices)
+		- indexbuffer	 -> VK_NULL_HANDLE draws non-indexed
+		- count			 -> Indices, or vertices when not indexed
+		- first			 -> First index, or first vertex when not indexed
+		- vertexbase	 -> Added to every index
+	*/
+	struct MetalDrawItem
+	{
+		VkPipeline			pipeline		= VK_NULL_HANDLE;
+		VkPipelineLayout	layout			= VK_NULL_HANDLE;
+		VkDescriptorSet		descriptorset	= VK_NULL_HANDLE;
+		VkBuffer			vertexbuffer	= VK_NULL_HANDLE;
+		VkDeviceSize		vertexoffset	= 0;
+		VkBuffer			indexbuffer		= VK_NULL_HANDLE;
+		VkDeviceSize		indexoffset		= 0;
+		VkIndexType			indextype		= VK_INDEX_TYPE_UINT16;
+		DWord				count			= 0;
+		DWord				first			= 0;
+		int					vertexbase		= 0;
+		DWord				instancecount	= 1;
+		DWord				firstinstance	= 0;
+	};
+
+	/* What a Submit bound and what it found already bound*/
+	struct MetalRenderQueueStats
+	{
+		DWord	draws				= 0;
+		DWord	pipelinebinds		= 0;
+		DWord	pipelineskips		= 0;
+		DWord	descriptorbinds		= 0;
+		DWord	descriptorskips		= 0;
+		DWord	vertexbinds			= 0;
+		DWord	vertexskips			= 0;
+		DWord	indexbinds			= 0;
+		DWord	indexskips			= 0;
+	};
+
+	/*
+		Draws are pushed with a 64-bit sort key in any order, Sort orders them with a parallel radix
+		sort and Submit records them, binding only what differs from the draw before. The skipped
+		binds go into the frame counters pipeline_binds_skipped, descriptor_binds_skipped and
+		vertex_binds_skipped (index buffer binds count with the vertex ones).
+	*/
+	class MetalRenderQueue
+	{
+	public:
+		MetalRenderQueue() = default;
+
+		MetalRenderQueue(const MetalRenderQueue&) = delete;
+		void operator=(const MetalRenderQueue&) = delete;
+
+		/**
+		* @brief Makes room for a frame's draws up front so Push never allocates
+		* @returns void
+		*/
+		void Reserve(DWord count);
+
+		/**
+		* @brief Empties the queue for the next frame, keeps the memory
+		* @returns void
+		*/
+		void Clear();
+
+		/**
+		* @brief Adds a draw, from one thread at a time
+		* @param key -> From MakeDrawKey or MakeBlendedDrawKey
+		* @param item -> The draw
+		* @returns void
+		*/
+		void Push(QWord key, const MetalDrawItem& item);
+
+		/**
+		* @brief Orders the draws by key, equal keys keep the order they were pushed in
+		* @returns void
+		*/
+		void Sort();
+
+		/**
+		* @brief Records the draws in sorted order, call inside the render pass after Sort
+		* @param commandbuffer -> The frame's command buffer
+		* @returns void
+		*/
+		void Submit(VkCommandBuffer commandbuffer);
+
+		DWord GetCount() const { return static_cast<DWord>(items.size()); }
+		const MetalRenderQueueStats& GetStats() const { return stats; }
+
+	protected:
+		vector<MetalDrawItem>	items;			/* In push order*/
+		vector<QWord>			keys;			/* Sorted by Sort*/
+		vector<DWord>			order;			/* Item of every sorted key*/
+		vector<QWord>			scratchkeys;
+		vector<DWord>			scratchorder;
+		bool					sorted			= false;
+		MetalRenderQueueStats	stats;
+	};
+}
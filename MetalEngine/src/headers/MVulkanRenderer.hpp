@@ -93,6 +93,10 @@ using std::string, std::vector, std::ifstream, std::ios, std::set, std::numeric_
 
 namespace engine::vulkan
 {
+	class MetalVulkanBlock;
+	class MetalPostProcess;
+	struct MetalPostProcessShaderPaths;
+
 	enum VulkanMemoryUsage : VkUint8
 	{
 		VMU_GPU_ONLY	= 1,
@@ -180,6 +184,7 @@ namespace engine::vulkan
 		VkPipelineLayout pipeline_layout = nullptr;
 		VkRenderPass renderpass = nullptr;
 		VkUint32 subpass = 0;
+		const VkPipelineVertexInputStateCreateInfo* vertexinput = nullptr;	/* nullptr for shaders that pull their vertices themselves*/
 	};
 	
 	class MetalVulkanBlock;
@@ -226,6 +231,21 @@ namespace engine::vulkan
 		VkShaderModule FragmentShaderModule;
 	};
 
+	/* Metal Retired Swapchain
+		- frame -> m_submittedframes when it was replaced, everything here is destroyed once that many frames are done
+	*/
+	struct MetalRetiredSwapchain
+	{
+		QWord					frame		= 0;
+		VkSwapchainKHR			swapchain	= VK_NULL_HANDLE;
+		vector<VkImageView>		imageviews;
+		vector<VkFramebuffer>	framebuffers;
+		vector<VkImage>			depthimages;
+		vector<VkImageView>		depthviews;
+		vector<VkDeviceMemory>	depthmemories;
+		MetalPostProcess*		postprocess	= nullptr;	/* HDR targets of the old size, frames in flight still render into them*/
+	};
+
 	class MetalVulkanSwapchain
 	{
 	public:
@@ -320,6 +340,8 @@ namespace engine::vulkan
 	inline vector<VkFramebuffer>		m_swapchain_framebuffers;
 	inline vector<VkImage>				m_depthimages;
 	inline vector<VkDeviceMemory>		m_depthimages_memories;
+	inline vector<VkDeviceSize>			m_depthimages_sizes;	/* Allocation size of every depth memory, a new size that fits keeps it*/
+	inline vector<VkUint32>				m_depthimages_types;
 	inline vector<VkImageView>			m_depthimage_views;
 	inline vector<VkImage>				m_swapchain_images;
 	inline vector<VkImageView>			m_swapchain_image_views;
@@ -328,10 +350,22 @@ namespace engine::vulkan
 	inline vector<VkFence>				m_in_flight_fences;
 	inline vector<VkFence>				m_images_in_flight;
 	inline VkExtent2D					m_window_extent;
+	inline VkPresentModeKHR				m_present_mode		= VK_PRESENT_MODE_MAX_ENUM_KHR;	/* From VulkanSetPresentMode, MAX_ENUM takes mailbox or else FIFO*/
+	inline bool							m_swapchain_dirty	= false;	/* Rebuilt at the next AcquireNextImage*/
+	inline VkImageUsageFlags			m_swapchain_usage	= 0;	/* What the swapchain images were created with*/
+	inline MetalPostProcess*			m_postprocess		= nullptr;	/* The HDR target frames render into, see VulkanEnablePostProcess*/
+	inline QWord						m_submittedframes	= 0;
+	inline vector<MetalRetiredSwapchain>	m_retired_swapchains;
+	inline bool							m_multidrawindirect_supported = false;	/* Indirect draws can take a drawCount above 1 (up to maxDrawIndirectCount)*/
+	inline bool							m_drawindirectcount_supported = false;	/* vkCmdDrawIndexedIndirectCount + multiDrawIndirect are usable*/
+	inline bool							m_descriptorindexing_supported = false;	/* Update-after-bind, partially bound descriptor arrays are usable*/
+	inline bool							m_texturecompressionbc_supported = false;	/* BC1-7 images can be sampled*/
+	inline bool							m_memorybudget_supported = false;	/* VK_EXT_memory_budget is enabled, heap usage can be read*/
+	inline bool							m_headless = false;	/* No window or surface, frames go into a MetalOffscreenTarget*/
 	inline VkUsize CurrentFrame = 0;
 	inline constexpr int MAXIMUM_FRAMES_IN_FLIGHTS = 2;
 
-	float ExtentAspectRatio()
+	inline float ExtentAspectRatio()
 	{
 		/* For C developers I'll translate this code into a more understandable C way
 		* return (float)(SwapchainExtent.width) / (float)(SwapchainExtent.height)
@@ -345,22 +379,29 @@ namespace engine::vulkan
 
 	MetalVulkanQueueFamilyIndices FindQueueFamiles(VkPhysicalDevice device);
 
-	MetalVulkanSwapChainSupportDetails GetSwapchainSupport() { return QuerySwapChainSupport(m_physicaldevice); }
+	inline MetalVulkanSwapChainSupportDetails GetSwapchainSupport() { return QuerySwapChainSupport(m_physicaldevice); }
 
 	MetalVulkanSwapChainSupportDetails QuerySwapChainSupport(VkPhysicalDevice device);
 
-	MetalVulkanQueueFamilyIndices FindPhysicalQueueFamilies() { return FindQueueFamiles(m_physicaldevice); }
+	inline MetalVulkanQueueFamilyIndices FindPhysicalQueueFamilies() { return FindQueueFamiles(m_physicaldevice); }
 
 	/**
 	* @brief This function is used for aquiring a swapchain image to render the next frame
 	* @param imageindex -> the Vulkan image index
 	* @note This function is waiting for the GPU to finish render the previous image;
+	*	a resized or out of date swapchain is rebuilt here, VK_ERROR_OUT_OF_DATE_KHR means skip the frame (minimized)
 	*/
 	VkResult AcquireNextImage(VkUint32* imageindex);
 
+	/**
+	* @brief Updates the heap usage and budget counters (needs VK_EXT_memory_budget), once per frame
+	* @returns void
+	*/
+	void SampleMemoryCounters();
+
 	VkFormat FindSupportedFormat(const vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
-	VkFormat FindDepthFormat() 
+	inline VkFormat FindDepthFormat() 
 	{ 
 		return FindSupportedFormat({ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
 			VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
@@ -378,6 +419,60 @@ namespace engine::vulkan
 
 	void CreateImageWithInfo(const VkImageCreateInfo& imageinfo, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imagememory);
 
+	/**
+	* @brief Creates a buffer and gives it its own memory allocation
+	* @param size -> Size of the buffer in bytes
+	* @param usage -> What the buffer will be used for
+	* @param properties -> The memory properties the allocation needs (device local, host visible...)
+	* @param buffer -> Receives the buffer
+	* @param buffermemory -> Receives the memory bound to the buffer
+	* @returns void
+	*/
+	void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& buffermemory);
+
+	/**
+	* @brief Allocates and begins a one time command buffer from the main command pool
+	* @returns The command buffer ready for recording
+	*/
+	VkCommandBuffer BeginSingleTimeCommands();
+
+	/**
+	* @brief Ends, submits and frees a command buffer from BeginSingleTimeCommands
+	* @note This waits for the graphics queue to go idle, only use it for loading
+	*/
+	void EndSingleTimeCommands(VkCommandBuffer commandbuffer);
+
+	/**
+	* @brief Uploads data into a device local buffer through a temporary staging buffer
+	* @param destination -> The buffer to write to (needs VK_BUFFER_USAGE_TRANSFER_DST_BIT)
+	* @param offset -> Byte offset into destination
+	* @param data -> The data to upload
+	* @param size -> Number of bytes
+	* @note Blocking, meant for load time uploads
+	*/
+	void UploadToBuffer(VkBuffer destination, VkDeviceSize offset, const void* data, VkDeviceSize size);
+
+	/**
+	* @brief Builds a compute pipeline from a compiled shader
+	* @param shaderpath -> Path to the .spv file
+	* @param layout -> The pipeline layout
+	* @param pipeline -> Receives the pipeline
+	* @returns 0 if successed 1 if failure
+	*/
+	int CreateComputePipeline(const string& shaderpath, VkPipelineLayout layout, VkPipeline& pipeline);
+
+	/**
+	* @brief Records vkCmdDrawIndexedIndirect over drawcount packed commands the way the device can take them,
+	*	split at maxDrawIndirectCount with multiDrawIndirect and one command per call without it
+	* @param commandbuffer -> The command buffer to record to
+	* @param buffer -> Buffer holding the commands
+	* @param offset -> Byte offset of the first command
+	* @param drawcount -> Number of commands
+	* @param stride -> Bytes between commands
+	* @returns Number of draw calls recorded
+	*/
+	VkUint32 CmdDrawIndexedIndirectBatched(VkCommandBuffer commandbuffer, VkBuffer buffer, VkDeviceSize offset, VkUint32 drawcount, VkUint32 stride);
+
 	static bool CheckDeviceExtensionsSupport(VkPhysicalDevice device);
 
 	/**
@@ -392,12 +487,96 @@ namespace engine::vulkan
 	*/
 	static int VulkanSetupRenderer(vector<const char*> instance_extension);
 
+	/**
+	* @brief Setups up the Vulkan renderer with no window, surface or swapchain. Any device with a graphics
+	*	queue is accepted, software ICDs like lavapipe included. Render with a MetalOffscreenTarget.
+	* @returns 0 if successed 1 if failure
+	*/
+	int VulkanSetupHeadless(void);
+
+	/**
+	* @brief Waits for the device and destroys everything VulkanSetupHeadless made
+	* @returns void
+	*/
+	void VulkanShutdownHeadless(void);
+
 	/**
 	* @brief Initializes the Vulkan renderer (REQUIRES a Vulkan compatible GPU)
 	* @returns void
 	*/
 	static bool VulkanInitRenderer();
 
+	/**
+	* @brief Rebuilds the swapchain, image views, depth images and framebuffers for the window's size and present mode.
+	*	The old swapchain is handed to the new one and destroyed with its views once the frames that used it are done,
+	*	depth memory that is big enough is kept. Post processing is rebuilt only when the extent or format changed,
+	*	the old chain is retired along with the old swapchain. Nothing waits for the device to go idle.
+	* @returns 0 if successed 1 if failure (the window has no area right now)
+	*/
+	int VulkanRecreateSwapchain();
+
+	/**
+	* @brief Marks the swapchain for rebuilding at the next AcquireNextImage
+	* @param width, height -> New size of the window in pixels
+	* @returns void
+	*/
+	void VulkanRequestSwapchainResize(VkUint32 width, VkUint32 height);
+
+	/**
+	* @brief Switches present mode (FIFO, MAILBOX, IMMEDIATE...) at the next AcquireNextImage, falls back
+	*	to mailbox or FIFO if the surface can't do it
+	* @returns void
+	*/
+	void VulkanSetPresentMode(VkPresentModeKHR mode);
+
+	/**
+	* @brief Renders every frame into a MetalPostProcess HDR target which is tonemapped and blitted onto the
+	*	swapchain image, call once the swapchain exists. VulkanRecreateSwapchain rebuilds it at the new size.
+	* @param shaders -> The compiled bloom and tonemap shaders
+	* @param hdrformat -> See MetalPostProcess::Create
+	* @param bloomlevels -> See MetalPostProcess::Create
+	* @note Refused when the surface doesn't allow VK_IMAGE_USAGE_TRANSFER_DST_BIT, frames then render into the swapchain
+	* @returns 0 if successed 1 if failure
+	*/
+	int VulkanEnablePostProcess(const MetalPostProcessShaderPaths& shaders, VkFormat hdrformat = VK_FORMAT_R16G16B16A16_SFLOAT, DWord bloomlevels = 6);
+
+	/**
+	* @brief Waits for the device and goes back to rendering straight into the swapchain
+	* @returns void
+	*/
+	void VulkanDisablePostProcess();
+
+	/**
+	* @brief The render pass frames are drawn in, graphics pipelines have to be created with it
+	* @returns The post process HDR pass when it is enabled, the swapchain's otherwise
+	*/
+	VkRenderPass VulkanGetFrameRenderPass();
+
+	/**
+	* @brief Begins the frame's render pass, on the HDR target when post processing is enabled
+	* @param commandbuffer -> The frame's command buffer
+	* @param imageindex -> From AcquireNextImage
+	* @param clearcolor -> RGBA the color target is cleared to (linear HDR with post processing)
+	* @returns void
+	*/
+	void VulkanBeginFrameRenderPass(VkCommandBuffer commandbuffer, VkUint32 imageindex, const float clearcolor[4]);
+
+	/**
+	* @brief Ends the frame's render pass and, with post processing, records bloom and tonemapping onto the
+	*	acquired image. The image is left in VK_IMAGE_LAYOUT_PRESENT_SRC_KHR either way.
+	* @param commandbuffer -> The frame's command buffer
+	* @param imageindex -> From AcquireNextImage
+	* @returns void
+	*/
+	void VulkanEndFrameRenderPass(VkCommandBuffer commandbuffer, VkUint32 imageindex);
+
+	/**
+	* @brief Destroys retired swapchains whose frames are done
+	* @param all -> Destroys all of them, only when the device is idle
+	* @returns void
+	*/
+	void ReleaseRetiredSwapchains(bool all);
+
 	void VulkanCreateSwapchain();
 	void VulkanCreateImageViews();
 	void VulkanCreateDepthResources();
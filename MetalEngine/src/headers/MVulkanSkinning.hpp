@@ -0,0 +1,74 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine skinning matrices (per frame ring the animation system writes into)
+// ------------------------------------------------------
+
+#pragma once
+
+#include "MVulkanRenderer.hpp"
+#include "MAnimation.hpp"
+
+namespace engine::vulkan
+{
+	using engine::animation::MetalSkinMatrix;
+
+	/*
+		A storage buffer of skinning matrices that stays mapped, split into one region per frame in
+		flight like MetalInstanceRing. Characters get their range from Allocate and EvaluateCharacters
+		writes the matrices straight into it from the workers, so nothing is staged or copied. A
+		skinned vertex shader reads joint j of a character as the matrix at firstjoint + j.
+	*/
+	class MetalSkinningRing
+	{
+	public:
+		MetalSkinningRing() = default;
+		~MetalSkinningRing();
+
+		MetalSkinningRing(const MetalSkinningRing&) = delete;
+		void operator=(const MetalSkinningRing&) = delete;
+
+		/**
+		* @brief Creates and maps the buffer
+		* @param jointsperframe -> Most joints of every character together one frame can write
+		* @returns 0 if successed 1 if failure
+		*/
+		int Create(DWord jointsperframe);
+
+		/**
+		* @brief Destroys the buffer (the device must be idle)
+		* @returns void
+		*/
+		void Destroy();
+
+		/**
+		* @brief Moves to CurrentFrame's region and empties it, call once the frame's fence was waited on
+		* @returns void
+		*/
+		void BeginFrame();
+
+		/**
+		* @brief Takes room for one character's matrices in this frame's region
+		* @param jointcount -> Joints of the character's skeleton
+		* @param firstjoint -> Receives the index of the first matrix in the buffer
+		* @returns Where to write them (MetalCharacter::skinmatrices), nullptr if the region is full
+		*/
+		MetalSkinMatrix* Allocate(DWord jointcount, DWord& firstjoint);
+
+		VkBuffer GetBuffer() const { return buffer; }
+		DWord GetCapacity() const { return capacity; }
+		DWord GetUsed() const { return used; }
+
+	protected:
+		VkBuffer			buffer		= VK_NULL_HANDLE;
+		VkDeviceMemory		memory		= VK_NULL_HANDLE;
+		MetalSkinMatrix*	mapped		= nullptr;
+		DWord				capacity	= 0;	/* Per frame*/
+		DWord				base		= 0;	/* First matrix of the current region*/
+		DWord				used		= 0;
+	};
+}
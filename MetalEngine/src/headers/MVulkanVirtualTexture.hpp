@@ -0,0 +1,182 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine virtual texturing, GPU side (cache atlas, page table images, feedback pass)
+// ------------------------------------------------------
+
+#pragma once
+
+#include "MVulkanRenderer.hpp"
+#include "MVulkanBindless.hpp"
+#include "MVirtualTexture.hpp"
+
+namespace engine::vulkan
+{
+	using engine::textures::MetalPageResolver;
+	using engine::textures::MetalVirtualTextureDesc;
+	using engine::textures::MetalPageReader;
+
+	inline constexpr DWord			VT_STAGING_PAGES		= 64;					/* Pages that can be read ahead of their upload*/
+	inline constexpr VkDeviceSize	VT_TABLE_STAGING_SIZE	= 8ull * 1024 * 1024;	/* Page table bytes uploaded per frame, fits every level of a VT_MAX_PAGES table*/
+	inline constexpr DWord			VT_FEEDBACK_SCALE		= 8;					/* The feedback pass runs at 1/8 of the screen on each side*/
+
+	/* Start of the info buffer (mirrors MetalVirtualInfo in virtualtexture.frag and vt_feedback.frag)*/
+	struct MetalGpuVirtualHeader
+	{
+		DWord	atlaspagesx;
+		DWord	atlaspagesy;
+		DWord	feedbackwidth;
+		DWord	feedbackheight;
+		float	feedbackbias;		/* Added to the mip in the feedback pass since it runs at a lower resolution*/
+		float	pad[3];
+	};
+
+	/* One virtual texture in the info buffer, after the header*/
+	struct MetalGpuVirtualTexture
+	{
+		float	width;
+		float	height;
+		DWord	pagetable;			/* Bindless slot of the page table*/
+		DWord	levelcount;
+	};
+
+	/*
+		The cache is one atlas image of VT_PAGE_TEXELS sized pages shared by every virtual texture
+		(so they all have to be cooked to the same format), each texture has a page table image
+		with one texel per page that shaders read to find where a page lives in the atlas.
+		The feedback pass draws virtual geometry into a small depth target with vt_feedback.frag,
+		which writes the page each texel wants into this frame's feedback buffer. Update reads the
+		buffer back MAXIMUM_FRAMES_IN_FLIGHTS frames later (after its fence was waited on), hands
+		it to the MetalPageResolver and records the atlas and page table uploads.
+
+		Shaders get the indices through MetalBindlessMaterial:
+		- texture0 -> GetAtlasSlot()
+		- texture1 -> GetFeedbackSlot() (feedback pass only)
+		- buffer   -> GetInfoSlot()
+		- material -> The virtual texture handle
+	*/
+	class MetalVirtualTexturing
+	{
+	public:
+		MetalVirtualTexturing() = default;
+		~MetalVirtualTexturing();
+
+		MetalVirtualTexturing(const MetalVirtualTexturing&) = delete;
+		void operator=(const MetalVirtualTexturing&) = delete;
+
+		/**
+		* @brief Creates the atlas, feedback target and buffers, the bindless heap has to exist already
+		* @param format -> Format every virtual texture is cooked to
+		* @param cachewidth -> Pages per row of the atlas
+		* @param cacheheight -> Pages per column of the atlas
+		* @param screen -> Size of the main render target, the feedback pass is 1/VT_FEEDBACK_SCALE of it
+		* @returns 0 if successed 1 if failure
+		*/
+		int Create(imageformat format, DWord cachewidth, DWord cacheheight, VkExtent2D screen);
+
+		/**
+		* @brief Destroys everything (the device must be idle)
+		* @returns void
+		*/
+		void Destroy();
+
+		/**
+		* @brief Adds a texture and creates its page table
+		* @param desc -> The cooked layout
+		* @param reader -> Reads pages on a worker thread
+		* @param userdata -> Handed to reader
+		* @returns The handle to push as MetalBindlessMaterial::material or engine::textures::VT_INVALID
+		*/
+		DWord AddTexture(const MetalVirtualTextureDesc& desc, MetalPageReader reader, void* userdata);
+
+		/**
+		* @brief Removes a texture, its page table is freed once the GPU is done with it
+		* @returns void
+		*/
+		void RemoveTexture(DWord texture);
+
+		/**
+		* @brief Reads back feedback, resolves it and records the uploads, once per frame after
+		*	AcquireNextImage and outside of a render pass
+		* @param commandbuffer -> The frame's command buffer
+		* @returns void
+		*/
+		void Update(VkCommandBuffer commandbuffer);
+
+		/**
+		* @brief Begins the feedback render pass, draw virtual geometry with a pipeline made for
+		*	GetFeedbackRenderPass() between this and EndFeedbackPass
+		* @returns void
+		*/
+		void BeginFeedbackPass(VkCommandBuffer commandbuffer);
+		void EndFeedbackPass(VkCommandBuffer commandbuffer);
+
+		VkRenderPass GetFeedbackRenderPass() const { return feedbackpass; }
+		VkExtent2D GetFeedbackExtent() const { return feedbackextent; }
+		DWord GetAtlasSlot() const { return atlasslot; }
+		DWord GetInfoSlot() const { return infoslot; }
+		DWord GetFeedbackSlot() const { return feedbackslots[CurrentFrame]; }
+		const MetalPageResolver& GetResolver() const { return resolver; }
+
+	protected:
+		struct PageTable
+		{
+			VkImage			image		= VK_NULL_HANDLE;
+			VkDeviceMemory	memory		= VK_NULL_HANDLE;
+			VkImageView		view		= VK_NULL_HANDLE;
+			DWord			slot		= BINDLESS_INVALID;
+			bool			cleared		= false;
+		};
+
+		struct Retired
+		{
+			PageTable	table;
+			QWord		frame;
+		};
+
+		void DestroyTable(PageTable& table);
+		void UploadTables(VkCommandBuffer commandbuffer);
+
+		MetalPageResolver						resolver;
+		vector<PageTable>						tables;
+		vector<Retired>							retired;
+		vector<engine::textures::MetalPageUpload>	uploads;
+		imageformat								format				= IF_RGBA8;
+		DWord									cachewidth			= 0;
+		DWord									cacheheight			= 0;
+		QWord									frame				= 0;
+
+		VkImage									atlas				= VK_NULL_HANDLE;
+		VkDeviceMemory							atlasmemory			= VK_NULL_HANDLE;
+		VkImageView								atlasview			= VK_NULL_HANDLE;
+		VkSampler								atlassampler		= VK_NULL_HANDLE;
+		VkSampler								tablesampler		= VK_NULL_HANDLE;
+		DWord									atlasslot			= BINDLESS_INVALID;
+
+		VkBuffer								stagingbuffer		= VK_NULL_HANDLE;
+		VkDeviceMemory							stagingmemory		= VK_NULL_HANDLE;
+		Byte*									stagingdata			= nullptr;
+		VkDeviceSize							tablestaging		= 0;	/* Offset of the page table part of the staging buffer*/
+
+		VkBuffer								infobuffer			= VK_NULL_HANDLE;
+		VkDeviceMemory							infomemory			= VK_NULL_HANDLE;
+		Byte*									infodata			= nullptr;
+		DWord									infoslot			= BINDLESS_INVALID;
+
+		array<VkBuffer, MAXIMUM_FRAMES_IN_FLIGHTS>			feedbackbuffers		= {};
+		array<VkDeviceMemory, MAXIMUM_FRAMES_IN_FLIGHTS>	feedbackmemories	= {};
+		array<DWord*, MAXIMUM_FRAMES_IN_FLIGHTS>			feedbackdata		= {};
+		array<DWord, MAXIMUM_FRAMES_IN_FLIGHTS>				feedbackslots		= {};
+		VkExtent2D								feedbackextent		= {};
+		VkImage									feedbackdepth		= VK_NULL_HANDLE;
+		VkDeviceMemory							feedbackdepthmemory	= VK_NULL_HANDLE;
+		VkImageView								feedbackdepthview	= VK_NULL_HANDLE;
+		VkRenderPass							feedbackpass		= VK_NULL_HANDLE;
+		VkFramebuffer							feedbackframebuffer	= VK_NULL_HANDLE;
+		DWord									feedbackzone		= 0xFFFFFFFF;	/* GPU profiler zone open between Begin/EndFeedbackPass*/
+	};
+}
@@ -0,0 +1,72 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine tests (test registration and checks, shared by every MTest*.cpp)
+// ------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+#include <fmt/format.h>
+
+#include "../src/headers/MTypes.hpp"
+
+namespace engine::tests
+{
+	/* Returns nothing, a test fails when any of its METAL_CHECKs did*/
+	typedef void (*MetalTestFunction)(void);
+
+	struct MetalTestCase
+	{
+		const char*			name;
+		MetalTestFunction	function;
+	};
+
+	/* Every test in the executable, in registration order*/
+	inline std::vector<MetalTestCase>& GetTests()
+	{
+		static std::vector<MetalTestCase> tests;
+		return tests;
+	}
+
+	/* Failed checks of the test that is running*/
+	inline DWord g_failures = 0;
+
+	/* Set when the test that is running can't run here (no GPU, no compiled shaders)*/
+	inline bool g_skipped = false;
+
+	struct MetalTestRegistrar
+	{
+		MetalTestRegistrar(const char* name, MetalTestFunction function) { GetTests().push_back({ name, function }); }
+	};
+}
+
+/* Defines a test, the name is what ctest and the command line select it by*/
+#define METAL_TEST(name) \
+	static void name(void); \
+	static engine::tests::MetalTestRegistrar name##_registrar(#name, name); \
+	static void name(void)
+
+/* Records a failure and keeps going, so one run reports every broken check*/
+#define METAL_CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			fmt::print("TEST: {}:{} check failed: {}\n", __FILE__, __LINE__, #condition); \
+			engine::tests::g_failures++; \
+		} \
+	} while (0)
+
+/* Leaves the test without failing it, for tests that need something the machine doesn't have*/
+#define METAL_SKIP(reason) \
+	do \
+	{ \
+		fmt::print("TEST: skipped, {}\n", reason); \
+		engine::tests::g_skipped = true; \
+		return; \
+	} while (0)
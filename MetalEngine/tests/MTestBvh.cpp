@@ -0,0 +1,150 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine tests (bvh queries against brute force, before and after refits)
+// ------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "MTest.hpp"
+#include "../src/headers/MBvh.hpp"
+
+using namespace engine::spatial;
+using namespace engine::tests;
+
+static MetalAABB RandomBox(std::mt19937& random, float range, float size)
+{
+	std::uniform_real_distribution<float> position(-range, range);
+	std::uniform_real_distribution<float> extent(0.05f, size);
+	vec3f center(position(random), position(random), position(random));
+	vec3f half(extent(random), extent(random), extent(random));
+	return MetalAABB(vec3f(center.x - half.x, center.y - half.y, center.z - half.z), vec3f(center.x + half.x, center.y + half.y, center.z + half.z));
+}
+
+static bool BoxesOverlap(const MetalAABB& a, const MetalAABB& b)
+{
+	return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y && a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+/* Slab test in doubles, the distance along the ray where it enters the box or a negative number for a miss*/
+static double RayEntry(const MetalAABB& box, const vec3f& origin, const vec3f& direction, float maxdistance)
+{
+	double tnear = 0.0;
+	double tfar = maxdistance;
+	const float mins[3] = { box.min.x, box.min.y, box.min.z };
+	const float maxs[3] = { box.max.x, box.max.y, box.max.z };
+	const float origins[3] = { origin.x, origin.y, origin.z };
+	const float directions[3] = { direction.x, direction.y, direction.z };
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		double t0 = (mins[axis] - static_cast<double>(origins[axis])) / directions[axis];
+		double t1 = (maxs[axis] - static_cast<double>(origins[axis])) / directions[axis];
+		tnear = std::max(tnear, std::min(t0, t1));
+		tfar = std::min(tfar, std::max(t0, t1));
+	}
+	return tnear <= tfar ? tnear : -1.0;
+}
+
+/* Runs the same random overlap and ray queries through the tree and through every box, returns the number of mismatches*/
+static DWord CompareQueries(const MetalBvh& bvh, const std::vector<MetalAABB>& bounds, std::mt19937& random)
+{
+	DWord mismatches = 0;
+	std::vector<DWord> found;
+	std::vector<DWord> expected;
+
+	for (DWord query = 0; query < 200; query++)
+	{
+		MetalAABB box = RandomBox(random, 60.0f, 8.0f);
+		found.clear();
+		expected.clear();
+
+		bvh.OverlapAABB(box, found);
+		for (DWord object = 0; object < bounds.size(); object++)
+		{
+			if (BoxesOverlap(bounds[object], box))
+			{
+				expected.push_back(object);
+			}
+		}
+
+		std::sort(found.begin(), found.end());
+		mismatches += found != expected;
+	}
+
+	std::uniform_real_distribution<float> position(-70.0f, 70.0f);
+	std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+	for (DWord query = 0; query < 500; query++)
+	{
+		vec3f origin(position(random), position(random), position(random));
+		vec3f towards(direction(random), direction(random), direction(random));
+		if (std::fabs(towards.x) < 1e-3f || std::fabs(towards.y) < 1e-3f || std::fabs(towards.z) < 1e-3f)
+		{
+			continue;
+		}
+
+		const float MaxDistance = 200.0f;
+		double closest = -1.0;
+		for (const MetalAABB& b : bounds)
+		{
+			double entry = RayEntry(b, origin, towards, MaxDistance);
+			if (entry >= 0.0 && (closest < 0.0 || entry < closest))
+			{
+				closest = entry;
+			}
+		}
+
+		MetalRayHit hit;
+		bool hitsomething = bvh.RayCast(origin, towards, MaxDistance, hit);
+		if (hitsomething != (closest >= 0.0))
+		{
+			/* A ray that just grazes a corner can go either way in floats*/
+			mismatches += std::fabs(closest) > 1e-3;
+			continue;
+		}
+
+		if (hitsomething && std::fabs(hit.distance - closest) > 1e-3 * std::max(1.0, closest))
+		{
+			mismatches++;
+		}
+	}
+
+	return mismatches;
+}
+
+METAL_TEST(bvh_matches_brute_force)
+{
+	std::mt19937 random(11);
+	std::vector<MetalAABB> bounds(1500);
+	for (MetalAABB& box : bounds)
+	{
+		box = RandomBox(random, 50.0f, 3.0f);
+	}
+
+	MetalBvh bvh;
+	bvh.Build(bounds);
+	METAL_CHECK(bvh.GetObjectCount() == bounds.size());
+	METAL_CHECK(CompareQueries(bvh, bounds, random) == 0);
+
+	/* Move a third of the objects, some a long way so their old leaves end up far too small*/
+	std::uniform_int_distribution<DWord> pick(0, static_cast<DWord>(bounds.size()) - 1);
+	for (DWord i = 0; i < bounds.size() / 3; i++)
+	{
+		DWord object = pick(random);
+		bounds[object] = RandomBox(random, i % 4 == 0 ? 50.0f : 5.0f, 3.0f);
+		bvh.UpdateObject(object, bounds[object]);
+	}
+	METAL_CHECK(bvh.Refit() > 0);
+	METAL_CHECK(CompareQueries(bvh, bounds, random) == 0);
+
+	/* A refit with nothing dirty touches nothing, and a rebuild answers the same as the refitted tree*/
+	METAL_CHECK(bvh.Refit() == 0);
+	bvh.Rebuild();
+	METAL_CHECK(CompareQueries(bvh, bounds, random) == 0);
+}
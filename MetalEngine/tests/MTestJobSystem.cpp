@@ -0,0 +1,172 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine tests (job system counters, dependencies and waits)
+// ------------------------------------------------------
+
+#include <atomic>
+#include <thread>
+
+#include "MTest.hpp"
+#include "../src/headers/MJobSystem.hpp"
+
+using namespace engine::jobs;
+using namespace engine::tests;
+
+/* Enough jobs that every worker runs some and some get stolen*/
+static constexpr DWord TEST_JOB_COUNT = 512;
+
+struct MetalTestStage
+{
+	std::atomic<DWord>	first{ 0 };		/* Jobs of the first stage that have finished*/
+	std::atomic<DWord>	second{ 0 };	/* Jobs of the second stage that have finished*/
+	std::atomic<DWord>	early{ 0 };		/* Second stage jobs that started before the first stage was done*/
+};
+
+static void FirstStageJob(void* userdata)
+{
+	MetalTestStage* stage = static_cast<MetalTestStage*>(userdata);
+	stage->first.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void SecondStageJob(void* userdata)
+{
+	MetalTestStage* stage = static_cast<MetalTestStage*>(userdata);
+	if (stage->first.load(std::memory_order_relaxed) != TEST_JOB_COUNT)
+	{
+		stage->early.fetch_add(1, std::memory_order_relaxed);
+	}
+	stage->second.fetch_add(1, std::memory_order_relaxed);
+}
+
+METAL_TEST(job_dependency_counter)
+{
+	MetalTestStage stage;
+	std::vector<void*> userdata(TEST_JOB_COUNT, &stage);
+
+	MetalJobCounter first;
+	MetalJobCounter second;
+	RunJobs(FirstStageJob, userdata.data(), TEST_JOB_COUNT, &first);
+	RunJobs(SecondStageJob, userdata.data(), TEST_JOB_COUNT, &second, &first);
+
+	/* Only wait on the last stage, the dependency has to hold the second stage back on its own*/
+	WaitForCounter(&second);
+	METAL_CHECK(first.IsDone());
+	METAL_CHECK(stage.first.load() == TEST_JOB_COUNT);
+	METAL_CHECK(stage.second.load() == TEST_JOB_COUNT);
+	METAL_CHECK(stage.early.load() == 0);
+
+	/* A dependency that is already done doesn't park anything*/
+	MetalTestStage done;
+	done.first.store(TEST_JOB_COUNT);
+	std::vector<void*> donedata(TEST_JOB_COUNT, &done);
+	RunJobs(SecondStageJob, donedata.data(), TEST_JOB_COUNT, &second, &first);
+	WaitForCounter(&second);
+	METAL_CHECK(done.second.load() == TEST_JOB_COUNT);
+	METAL_CHECK(done.early.load() == 0);
+}
+
+struct MetalTestNested
+{
+	std::atomic<DWord>	leaves{ 0 };
+	std::atomic<DWord>	unfinished{ 0 };	/* Parents whose children were not all done when their wait returned*/
+};
+
+static void NestedLeafJob(void* userdata)
+{
+	static_cast<MetalTestNested*>(userdata)->leaves.fetch_add(1, std::memory_order_relaxed);
+}
+
+/* Queues its own children and waits on them, with every worker doing the same the pool only
+	keeps going if waiting threads run other jobs*/
+static void NestedParentJob(void* userdata)
+{
+	MetalTestNested* nested = static_cast<MetalTestNested*>(userdata);
+	std::vector<void*> children(16, nested);
+
+	DWord before = nested->leaves.load(std::memory_order_relaxed);
+	MetalJobCounter counter;
+	RunJobs(NestedLeafJob, children.data(), static_cast<DWord>(children.size()), &counter);
+	WaitForCounter(&counter);
+
+	if (!counter.IsDone() || nested->leaves.load(std::memory_order_relaxed) < before + children.size())
+	{
+		nested->unfinished.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+METAL_TEST(job_nested_wait)
+{
+	MetalTestNested nested;
+	const DWord Parents = GetWorkerCount() * 8;
+	std::vector<void*> userdata(Parents, &nested);
+
+	MetalJobCounter counter;
+	RunJobs(NestedParentJob, userdata.data(), Parents, &counter);
+	WaitForCounter(&counter);
+
+	METAL_CHECK(nested.leaves.load() == Parents * 16);
+	METAL_CHECK(nested.unfinished.load() == 0);
+}
+
+METAL_TEST(job_external_submit)
+{
+	/* Threads that are not workers queue through the injection queue and help out while they wait*/
+	const DWord Threads = 4;
+	MetalTestStage stages[Threads];
+	std::atomic<DWord> failed{ 0 };
+	std::vector<std::thread> threads;
+
+	for (DWord i = 0; i < Threads; i++)
+	{
+		threads.emplace_back([&stage = stages[i], &failed]()
+		{
+			if (GetWorkerIndex() != -1)
+			{
+				failed.fetch_add(1);
+			}
+
+			std::vector<void*> userdata(TEST_JOB_COUNT, &stage);
+			MetalJobCounter first;
+			MetalJobCounter second;
+			RunJobs(FirstStageJob, userdata.data(), TEST_JOB_COUNT, &first);
+			RunJobs(SecondStageJob, userdata.data(), TEST_JOB_COUNT, &second, &first);
+			WaitForCounter(&second);
+		});
+	}
+
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	METAL_CHECK(failed.load() == 0);
+	for (DWord i = 0; i < Threads; i++)
+	{
+		METAL_CHECK(stages[i].first.load() == TEST_JOB_COUNT);
+		METAL_CHECK(stages[i].second.load() == TEST_JOB_COUNT);
+		METAL_CHECK(stages[i].early.load() == 0);
+	}
+
+	/* Jobs queued from a thread that never waits on them still get picked up by the workers*/
+	MetalJobCounter counter;
+	std::atomic<DWord> ranonworker{ 0 };
+	std::thread outside([&]()
+	{
+		std::vector<void*> userdata(TEST_JOB_COUNT, &ranonworker);
+		RunJobs([](void* userdata)
+		{
+			if (GetWorkerIndex() >= 0)
+			{
+				static_cast<std::atomic<DWord>*>(userdata)->fetch_add(1, std::memory_order_relaxed);
+			}
+		}, userdata.data(), TEST_JOB_COUNT, &counter);
+	});
+	outside.join();
+	WaitForCounter(&counter);
+	METAL_CHECK(ranonworker.load() == TEST_JOB_COUNT);
+}
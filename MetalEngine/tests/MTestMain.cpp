@@ -0,0 +1,93 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine tests (entry point)
+// ------------------------------------------------------
+
+/*
+	metal_tests runs every test, or only the ones named on the command line. Nothing needs a window,
+	tests that compare against the GPU run headless and skip themselves when there is no device.
+
+	metal_tests [name ...]
+
+	Exit codes: 0 passed, 1 a check failed, 2 a name matched no test, 77 every test that ran was skipped.
+*/
+
+#include <cstring>
+
+#include "MTest.hpp"
+#include "../src/headers/MJobSystem.hpp"
+
+using namespace engine::tests;
+
+static bool IsSelected(const char* name, int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		return true;
+	}
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], name) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+int main(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		bool found = false;
+		for (const MetalTestCase& test : GetTests())
+		{
+			found = found || strcmp(test.name, argv[i]) == 0;
+		}
+
+		if (!found)
+		{
+			fmt::print("TEST: no test named {}\n", argv[i]);
+			return 2;
+		}
+	}
+
+	/* Several of the systems under test hand work to the job system and poll for it instead of waiting,
+		so there have to be workers besides this thread even on a single core machine*/
+	if (engine::jobs::JobSystemInit(4) != 0)
+	{
+		return 2;
+	}
+
+	DWord failed = 0;
+	DWord ran = 0;
+	DWord skipped = 0;
+	for (const MetalTestCase& test : GetTests())
+	{
+		if (!IsSelected(test.name, argc, argv))
+		{
+			continue;
+		}
+
+		g_failures = 0;
+		g_skipped = false;
+		test.function();
+		fmt::print("TEST: {} {}\n", test.name, g_failures != 0 ? "FAILED" : g_skipped ? "skipped" : "passed");
+		failed += g_failures != 0;
+		skipped += g_skipped && g_failures == 0;
+		ran++;
+	}
+
+	engine::jobs::JobSystemShutdown();
+	if (failed != 0)
+	{
+		return 1;
+	}
+	return ran != 0 && skipped == ran ? 77 : 0;
+}
@@ -0,0 +1,81 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine tests (procedural meshes and cameras shared by the mesh and culling tests)
+// ------------------------------------------------------
+
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#include "../src/headers/MMesh.hpp"
+
+namespace engine::tests
+{
+	/* UV sphere around the origin cooked with meshlets, rings * segments * 2 triangles*/
+	inline int CookTestSphere(float radius, DWord rings, DWord segments, engine::meshes::MetalCookedMesh& mesh)
+	{
+		const float Pi = 3.14159265f;
+
+		std::vector<engine::meshes::MetalMeshVertex> vertices;
+		for (DWord ring = 0; ring <= rings; ring++)
+		{
+			float theta = Pi * ring / rings;
+			for (DWord segment = 0; segment <= segments; segment++)
+			{
+				float phi = 2.0f * Pi * segment / segments;
+				vec3f normal(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+
+				engine::meshes::MetalMeshVertex vertex;
+				vertex.position = vec3f(normal.x * radius, normal.y * radius, normal.z * radius);
+				vertex.normal = normal;
+				vertex.tangent = vec4f(-std::sin(phi), 0.0f, std::cos(phi), 1.0f);
+				vertex.uv = vec2f(segment / static_cast<float>(segments), ring / static_cast<float>(rings));
+				vertices.push_back(vertex);
+			}
+		}
+
+		std::vector<DWord> indices;
+		for (DWord ring = 0; ring < rings; ring++)
+		{
+			for (DWord segment = 0; segment < segments; segment++)
+			{
+				DWord a = ring * (segments + 1) + segment;
+				DWord c = a + segments + 1;
+				indices.insert(indices.end(), { a, a + 1, c, a + 1, c + 1, c });
+			}
+		}
+
+		return engine::meshes::CookMesh(vertices.data(), static_cast<DWord>(vertices.size()), indices.data(),
+			static_cast<DWord>(indices.size()), nullptr, 0, mesh);
+	}
+
+	/* Right handed camera looking down -z from eye, Vulkan clip space (y down, depth 0 near to 1 far)*/
+	inline mat4f MakeTestViewProj(const vec3f& eye, float fovy, float aspect, float znear, float zfar)
+	{
+		float t = 1.0f / std::tan(fovy * 0.5f);
+		mat4f projection(
+			vec4f(t / aspect, 0.0f, 0.0f, 0.0f),
+			vec4f(0.0f, -t, 0.0f, 0.0f),
+			vec4f(0.0f, 0.0f, zfar / (znear - zfar), zfar * znear / (znear - zfar)),
+			vec4f(0.0f, 0.0f, -1.0f, 0.0f));
+		mat4f view(
+			vec4f(1.0f, 0.0f, 0.0f, -eye.x),
+			vec4f(0.0f, 1.0f, 0.0f, -eye.y),
+			vec4f(0.0f, 0.0f, 1.0f, -eye.z),
+			vec4f(0.0f, 0.0f, 0.0f, 1.0f));
+		return projection * view;
+	}
+
+	/* Depth buffer value of a point at a view depth straight ahead of the camera*/
+	inline float TestDepthAt(const mat4f& viewproj, const vec3f& eye, float viewdepth)
+	{
+		vec4f clip = viewproj.Transform(vec3f(eye.x, eye.y, eye.z - viewdepth));
+		return clip.z / clip.w;
+	}
+}
@@ -0,0 +1,158 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine tests (CPU meshlet culling and depth pyramid references)
+// ------------------------------------------------------
+
+#include <algorithm>
+#include <random>
+
+#include "MTest.hpp"
+#include "MTestMeshes.hpp"
+#include "../src/headers/MMeshlet.hpp"
+
+using namespace engine::meshes;
+using namespace engine::tests;
+
+static DWord ReadIndex(const MetalCookedMesh& mesh, DWord index)
+{
+	if (mesh.header.indexsize == 2)
+	{
+		return reinterpret_cast<const Word*>(mesh.indices.data())[index];
+	}
+	return reinterpret_cast<const DWord*>(mesh.indices.data())[index];
+}
+
+METAL_TEST(depth_pyramid_reference)
+{
+	/* Odd sides, so every level rounds up and reads its last row and column twice*/
+	const DWord Width = 37;
+	const DWord Height = 23;
+
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<float> depth(static_cast<usize>(Width) * Height);
+	for (float& value : depth)
+	{
+		value = unit(random);
+	}
+
+	MetalDepthPyramid pyramid;
+	BuildDepthPyramid(depth.data(), Width, Height, pyramid);
+	METAL_CHECK(!pyramid.levels.empty());
+	METAL_CHECK(pyramid.widths[0] == (Width + 1) / 2 && pyramid.heights[0] == (Height + 1) / 2);
+	METAL_CHECK(pyramid.widths.back() == 1 && pyramid.heights.back() == 1);
+
+	const float* source = depth.data();
+	DWord sourcewidth = Width;
+	DWord sourceheight = Height;
+	for (usize level = 0; level < pyramid.levels.size(); level++)
+	{
+		for (DWord y = 0; y < pyramid.heights[level]; y++)
+		{
+			for (DWord x = 0; x < pyramid.widths[level]; x++)
+			{
+				DWord x0 = std::min(x * 2, sourcewidth - 1), x1 = std::min(x * 2 + 1, sourcewidth - 1);
+				DWord y0 = std::min(y * 2, sourceheight - 1), y1 = std::min(y * 2 + 1, sourceheight - 1);
+				float farthest = std::max(std::max(source[y0 * sourcewidth + x0], source[y0 * sourcewidth + x1]),
+					std::max(source[y1 * sourcewidth + x0], source[y1 * sourcewidth + x1]));
+				METAL_CHECK(pyramid.levels[level][y * pyramid.widths[level] + x] == farthest);
+			}
+		}
+
+		source = pyramid.levels[level].data();
+		sourcewidth = pyramid.widths[level];
+		sourceheight = pyramid.heights[level];
+	}
+
+	METAL_CHECK(pyramid.levels.back()[0] == *std::max_element(depth.begin(), depth.end()));
+}
+
+METAL_TEST(meshlet_cull_conservative)
+{
+	MetalCookedMesh mesh;
+	METAL_CHECK(CookTestSphere(2.0f, 48, 96, mesh) == 0);
+	if (mesh.lods.empty() || mesh.lods[0].meshletcount == 0)
+	{
+		METAL_CHECK(!"the sphere has no meshlets");
+		return;
+	}
+
+	const MetalCookedLod& lod = mesh.lods[0];
+	const MetalCookedMeshlet* meshlets = mesh.meshlets.data() + lod.firstmeshlet;
+
+	/* The sphere spans view depth 6 to 10*/
+	vec3f eye(0.0f, 0.0f, 8.0f);
+	mat4f viewproj = MakeTestViewProj(eye, 1.0f, 1.0f, 0.1f, 100.0f);
+	mat4f model;
+
+	std::vector<DWord> visible(lod.meshletcount);
+	MetalMeshletCullStats stats;
+
+	/* Without a pyramid nothing is occluded and every meshlet is accounted for*/
+	CullMeshlets(meshlets, lod.meshletcount, model, viewproj, eye, nullptr, viewproj, visible.data(), &stats);
+	METAL_CHECK(stats.tested == lod.meshletcount);
+	METAL_CHECK(stats.occluded == 0);
+	METAL_CHECK(stats.backface > 0);
+	METAL_CHECK(stats.visible + stats.frustum + stats.backface == stats.tested);
+	DWord unoccluded = stats.visible;
+
+	/* A wall at view depth 4 hides all of it*/
+	const DWord Width = 256;
+	const DWord Height = 256;
+	float walldepth = TestDepthAt(viewproj, eye, 4.0f);
+	std::vector<float> depth(static_cast<usize>(Width) * Height, walldepth);
+
+	MetalDepthPyramid pyramid;
+	BuildDepthPyramid(depth.data(), Width, Height, pyramid);
+	CullMeshlets(meshlets, lod.meshletcount, model, viewproj, eye, &pyramid, viewproj, visible.data(), &stats);
+	METAL_CHECK(stats.visible == 0);
+	METAL_CHECK(stats.occluded == unoccluded);
+
+	/* A hole in the middle lets some through, and no meshlet with a vertex in front of the wall may be rejected*/
+	for (DWord y = 0; y < Height; y++)
+	{
+		for (DWord x = 0; x < Width; x++)
+		{
+			if (x > 96 && x < 160 && y > 96 && y < 160)
+			{
+				depth[y * Width + x] = 1.0f;
+			}
+		}
+	}
+	BuildDepthPyramid(depth.data(), Width, Height, pyramid);
+	CullMeshlets(meshlets, lod.meshletcount, model, viewproj, eye, &pyramid, viewproj, visible.data(), &stats);
+	METAL_CHECK(stats.visible > 0);
+	METAL_CHECK(stats.occluded > 0);
+
+	DWord falserejects = 0;
+	for (DWord i = 0; i < lod.meshletcount; i++)
+	{
+		DWord kept;
+		MetalMeshletCullStats single;
+		CullMeshlets(&meshlets[i], 1, model, viewproj, eye, &pyramid, viewproj, &kept, &single);
+		if (single.occluded == 0)
+		{
+			continue;
+		}
+
+		for (DWord corner = 0; corner < meshlets[i].trianglecount * 3; corner++)
+		{
+			DWord index = ReadIndex(mesh, meshlets[i].firstindex + corner);
+			vec3f position = UnpackVertex(mesh.header, mesh.positions[index], mesh.attributes[index]).position;
+			vec4f clip = viewproj.Transform(position);
+			int px = static_cast<int>((clip.x / clip.w * 0.5f + 0.5f) * Width);
+			int py = static_cast<int>((clip.y / clip.w * 0.5f + 0.5f) * Height);
+			if (px >= 0 && px < static_cast<int>(Width) && py >= 0 && py < static_cast<int>(Height) &&
+				clip.z / clip.w < depth[py * Width + px])
+			{
+				falserejects++;
+			}
+		}
+	}
+	METAL_CHECK(falserejects == 0);
+}
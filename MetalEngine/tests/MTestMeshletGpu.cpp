@@ -0,0 +1,358 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine tests (GPU meshlet culling against the CPU reference)
+// ------------------------------------------------------
+
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <utility>
+
+#include "MTest.hpp"
+#include "MTestMeshes.hpp"
+#include "../src/headers/MVulkanMeshlet.hpp"
+
+#if !defined(METAL_TEST_SHADER_DIR)
+	#define METAL_TEST_SHADER_DIR "shaders/vulkan/"
+#endif
+
+using namespace engine::meshes;
+using namespace engine::vulkan;
+using namespace engine::tests;
+
+/* Reads back what the culling pass wrote, the buffers are protected*/
+class MetalMeshletRendererProbe : public MetalMeshletRenderer
+{
+public:
+	bool IsCompact() const { return compact; }
+	DWord GetSlotCount() const { return maxinstances * meshletcount; }
+
+	/* Copies the draw count to offset 0 of destination and the draw commands after it*/
+	void RecordReadback(VkCommandBuffer commandbuffer, VkBuffer destination)
+	{
+		array<VkBufferMemoryBarrier, 2> Barriers = {};
+		VkBuffer Sources[] = { countbuffer, drawbuffer };
+		for (int i = 0; i < 2; i++)
+		{
+			Barriers[i].sType				= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			Barriers[i].srcAccessMask		= VK_ACCESS_SHADER_WRITE_BIT;
+			Barriers[i].dstAccessMask		= VK_ACCESS_TRANSFER_READ_BIT;
+			Barriers[i].srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+			Barriers[i].dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+			Barriers[i].buffer				= Sources[i];
+			Barriers[i].offset				= 0;
+			Barriers[i].size				= VK_WHOLE_SIZE;
+		}
+		vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, nullptr, static_cast<VkUint32>(Barriers.size()), Barriers.data(), 0, nullptr);
+
+		VkBufferCopy CountCopy = { 0, 0, sizeof(VkUint32) };
+		vkCmdCopyBuffer(commandbuffer, countbuffer, destination, 1, &CountCopy);
+		VkBufferCopy DrawCopy = { 0, sizeof(VkUint32), sizeof(VkDrawIndexedIndirectCommand) * GetSlotCount() };
+		vkCmdCopyBuffer(commandbuffer, drawbuffer, destination, 1, &DrawCopy);
+
+		VkMemoryBarrier HostBarrier = {};
+		HostBarrier.sType			= VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		HostBarrier.srcAccessMask	= VK_ACCESS_TRANSFER_WRITE_BIT;
+		HostBarrier.dstAccessMask	= VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+			0, 1, &HostBarrier, 0, nullptr, 0, nullptr);
+	}
+};
+
+static bool FileExists(const string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return file.good();
+}
+
+/* VulkanSetupHeadless treats a missing driver or GPU as fatal, ask first so the test can skip instead*/
+static bool HasVulkanDevice(void)
+{
+	VkInstanceCreateInfo InstanceInfo = {};
+	InstanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+
+	VkInstance Instance = VK_NULL_HANDLE;
+	if (vkCreateInstance(&InstanceInfo, nullptr, &Instance) != VK_SUCCESS)
+	{
+		return false;
+	}
+
+	VkUint32 DeviceCount = 0;
+	vkEnumeratePhysicalDevices(Instance, &DeviceCount, nullptr);
+	vkDestroyInstance(Instance, nullptr);
+	return DeviceCount != 0;
+}
+
+static void ImageBarrier(VkCommandBuffer commandbuffer, VkImage image, VkImageLayout from, VkImageLayout to,
+	VkAccessFlags srcaccess, VkAccessFlags dstaccess, VkPipelineStageFlags srcstage, VkPipelineStageFlags dststage)
+{
+	VkImageMemoryBarrier Barrier = {};
+	Barrier.sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	Barrier.oldLayout						= from;
+	Barrier.newLayout						= to;
+	Barrier.srcAccessMask					= srcaccess;
+	Barrier.dstAccessMask					= dstaccess;
+	Barrier.srcQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+	Barrier.dstQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+	Barrier.image							= image;
+	Barrier.subresourceRange.aspectMask		= VK_IMAGE_ASPECT_DEPTH_BIT;
+	Barrier.subresourceRange.levelCount		= 1;
+	Barrier.subresourceRange.layerCount		= 1;
+	vkCmdPipelineBarrier(commandbuffer, srcstage, dststage, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+}
+
+/* Runs the same scene through meshlet_cull.comp and CullMeshlets and expects the same meshlets drawn*/
+static void CompareMeshletCulling(void)
+{
+	const string CullShader = string(METAL_TEST_SHADER_DIR) + "meshlet_cull.comp.spv";
+	const string PyramidShader = string(METAL_TEST_SHADER_DIR) + "depthpyramid.comp.spv";
+	const DWord Width = 320;
+	const DWord Height = 200;
+	const DWord Columns = 4;
+	const DWord Rows = 3;
+	const DWord InstanceCount = Columns * Rows;
+
+	MetalCookedMesh cooked;
+	METAL_CHECK(CookTestSphere(1.0f, 32, 64, cooked) == 0);
+	if (cooked.lods.empty() || cooked.lods[0].meshletcount == 0)
+	{
+		METAL_CHECK(!"the sphere has no meshlets");
+		return;
+	}
+
+	/* The outer columns straddle the frustum's sides, the left half of the screen is walled off in front of the spheres*/
+	vec3f eye(0.0f, 0.0f, 8.0f);
+	float aspect = static_cast<float>(Width) / Height;
+	mat4f viewproj = MakeTestViewProj(eye, 1.0f, aspect, 0.1f, 100.0f);
+
+	vector<mat4f> worlds(InstanceCount);
+	for (DWord i = 0; i < InstanceCount; i++)
+	{
+		float x = (static_cast<float>(i % Columns) - 1.5f) * 5.5f;
+		float y = (static_cast<float>(i / Columns) - 1.0f) * 2.5f;
+		worlds[i].rows[0].w = x;
+		worlds[i].rows[1].w = y;
+	}
+
+	vector<float> depth(static_cast<usize>(Width) * Height, 1.0f);
+	float walldepth = TestDepthAt(viewproj, eye, 5.0f);
+	for (DWord y = 0; y < Height; y++)
+	{
+		for (DWord x = 0; x < Width * 2 / 5; x++)
+		{
+			depth[y * Width + x] = walldepth;
+		}
+	}
+
+	/* CPU reference, in mesh space with the world matrices as they are*/
+	const MetalCookedLod& Lod = cooked.lods[0];
+	const MetalCookedMeshlet* Meshlets = cooked.meshlets.data() + Lod.firstmeshlet;
+	MetalDepthPyramid pyramid;
+	BuildDepthPyramid(depth.data(), Width, Height, pyramid);
+
+	std::set<std::pair<DWord, DWord>> expected;
+	MetalMeshletCullStats totals;
+	vector<DWord> visible(Lod.meshletcount);
+	for (DWord i = 0; i < InstanceCount; i++)
+	{
+		MetalMeshletCullStats stats;
+		DWord count = CullMeshlets(Meshlets, Lod.meshletcount, worlds[i], viewproj, eye, &pyramid, viewproj, visible.data(), &stats);
+		for (DWord v = 0; v < count; v++)
+		{
+			expected.insert({ i, Meshlets[visible[v]].firstindex });
+		}
+		totals.tested += stats.tested;
+		totals.frustum += stats.frustum;
+		totals.backface += stats.backface;
+		totals.occluded += stats.occluded;
+		totals.visible += stats.visible;
+	}
+
+	/* The scene has to exercise every test or agreeing proves little*/
+	METAL_CHECK(totals.frustum > 0);
+	METAL_CHECK(totals.backface > 0);
+	METAL_CHECK(totals.occluded > 0);
+	METAL_CHECK(totals.visible > 0);
+
+	/* GPU side, the instances carry the dequantize matrix the way mesh.vert expects*/
+	if (!FileExists(CullShader) || !FileExists(PyramidShader))
+	{
+		METAL_SKIP("meshlet_cull.comp.spv or depthpyramid.comp.spv is not compiled");
+	}
+
+	VkFormatProperties DepthProperties;
+	vkGetPhysicalDeviceFormatProperties(m_physicaldevice, VK_FORMAT_D32_SFLOAT, &DepthProperties);
+	const VkFormatFeatureFlags DepthFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+	if ((DepthProperties.optimalTilingFeatures & DepthFeatures) != DepthFeatures)
+	{
+		METAL_SKIP("D32_SFLOAT can't be sampled or copied into");
+	}
+
+	MetalGpuMesh mesh;
+	if (LoadCookedMesh(cooked, mesh) != 0)
+	{
+		METAL_CHECK(!"failed to upload the sphere");
+		return;
+	}
+
+	mat4f dequantize = MakeDequantizeMatrix(cooked.header);
+	vector<MetalGpuInstance> instances(InstanceCount);
+	for (DWord i = 0; i < InstanceCount; i++)
+	{
+		mat4f model = worlds[i] * dequantize;
+		std::memcpy(instances[i].modelrows, model.rows, sizeof(model.rows));
+		instances[i].boundingsphere = GetQuantizedBoundingSphere(mesh);
+		instances[i].mesh = 0;
+		instances[i].lodcount = 1;
+	}
+
+	MetalMeshletRendererProbe* renderer = new MetalMeshletRendererProbe();
+	MetalGpuDepthPyramid* gpupyramid = new MetalGpuDepthPyramid();
+	if (renderer->Create(mesh, 0, InstanceCount, CullShader, PyramidShader) != 0 || gpupyramid->Create(Width, Height, PyramidShader) != 0)
+	{
+		METAL_CHECK(!"failed to create the culling passes");
+		delete gpupyramid;
+		delete renderer;
+		DestroyGpuMesh(mesh);
+		return;
+	}
+	renderer->UploadInstances(instances.data(), 0, InstanceCount);
+	renderer->SetInstanceCount(InstanceCount);
+
+	/* The depth buffer goes up through a staging buffer like any texture*/
+	VkImageCreateInfo ImageInfo = {};
+	ImageInfo.sType			= VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	ImageInfo.imageType		= VK_IMAGE_TYPE_2D;
+	ImageInfo.format		= VK_FORMAT_D32_SFLOAT;
+	ImageInfo.extent		= { Width, Height, 1 };
+	ImageInfo.mipLevels		= 1;
+	ImageInfo.arrayLayers	= 1;
+	ImageInfo.samples		= VK_SAMPLE_COUNT_1_BIT;
+	ImageInfo.tiling		= VK_IMAGE_TILING_OPTIMAL;
+	ImageInfo.usage			= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	ImageInfo.sharingMode	= VK_SHARING_MODE_EXCLUSIVE;
+	ImageInfo.initialLayout	= VK_IMAGE_LAYOUT_UNDEFINED;
+
+	VkImage DepthImage = VK_NULL_HANDLE;
+	VkDeviceMemory DepthMemory = VK_NULL_HANDLE;
+	CreateImageWithInfo(ImageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, DepthImage, DepthMemory);
+
+	VkImageViewCreateInfo ViewInfo = {};
+	ViewInfo.sType								= VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	ViewInfo.image								= DepthImage;
+	ViewInfo.viewType							= VK_IMAGE_VIEW_TYPE_2D;
+	ViewInfo.format								= VK_FORMAT_D32_SFLOAT;
+	ViewInfo.subresourceRange.aspectMask		= VK_IMAGE_ASPECT_DEPTH_BIT;
+	ViewInfo.subresourceRange.levelCount		= 1;
+	ViewInfo.subresourceRange.layerCount		= 1;
+	VkImageView DepthView = VK_NULL_HANDLE;
+	VK_CHECK(vkCreateImageView(m_device, &ViewInfo, nullptr, &DepthView));
+
+	VkDeviceSize DepthSize = sizeof(float) * depth.size();
+	VkDeviceSize ReadbackSize = sizeof(VkUint32) + sizeof(VkDrawIndexedIndirectCommand) * renderer->GetSlotCount();
+	VkBuffer Staging = VK_NULL_HANDLE, Readback = VK_NULL_HANDLE;
+	VkDeviceMemory StagingMemory = VK_NULL_HANDLE, ReadbackMemory = VK_NULL_HANDLE;
+	CreateBuffer(DepthSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, Staging, StagingMemory);
+	CreateBuffer(ReadbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, Readback, ReadbackMemory);
+
+	void* Mapped = nullptr;
+	VK_CHECK(vkMapMemory(m_device, StagingMemory, 0, DepthSize, 0, &Mapped));
+	std::memcpy(Mapped, depth.data(), DepthSize);
+	vkUnmapMemory(m_device, StagingMemory);
+
+	/* Upload, reduce, cull and read back in one go, EndSingleTimeCommands waits for all of it*/
+	VkCommandBuffer CommandBuffer = BeginSingleTimeCommands();
+
+	ImageBarrier(CommandBuffer, DepthImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	VkBufferImageCopy Region = {};
+	Region.imageSubresource.aspectMask	= VK_IMAGE_ASPECT_DEPTH_BIT;
+	Region.imageSubresource.layerCount	= 1;
+	Region.imageExtent					= { Width, Height, 1 };
+	vkCmdCopyBufferToImage(CommandBuffer, Staging, DepthImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &Region);
+
+	ImageBarrier(CommandBuffer, DepthImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+	gpupyramid->Build(CommandBuffer, DepthView);
+	renderer->SetDepthPyramid(gpupyramid);
+	renderer->RecordCulling(CommandBuffer, viewproj, eye, viewproj);
+	renderer->RecordReadback(CommandBuffer, Readback);
+
+	EndSingleTimeCommands(CommandBuffer);
+
+	VK_CHECK(vkMapMemory(m_device, ReadbackMemory, 0, ReadbackSize, 0, &Mapped));
+	VkUint32 DrawCount = 0;
+	std::memcpy(&DrawCount, Mapped, sizeof(VkUint32));
+	vector<VkDrawIndexedIndirectCommand> Commands(renderer->GetSlotCount());
+	std::memcpy(Commands.data(), static_cast<const Byte*>(Mapped) + sizeof(VkUint32), sizeof(VkDrawIndexedIndirectCommand) * Commands.size());
+	vkUnmapMemory(m_device, ReadbackMemory);
+
+	/* Compact writes the visible ones first, otherwise every slot is written and culled ones draw no instance*/
+	std::set<std::pair<DWord, DWord>> drawn;
+	if (renderer->IsCompact())
+	{
+		METAL_CHECK(DrawCount <= Commands.size());
+		for (VkUint32 i = 0; i < DrawCount && i < Commands.size(); i++)
+		{
+			drawn.insert({ Commands[i].firstInstance, Commands[i].firstIndex });
+		}
+	}
+	else
+	{
+		for (const VkDrawIndexedIndirectCommand& Command : Commands)
+		{
+			if (Command.instanceCount == 1)
+			{
+				drawn.insert({ Command.firstInstance, Command.firstIndex });
+			}
+		}
+	}
+
+	/* Meshlets touching a plane or a pyramid texel edge may round either way, allow 1 in 100*/
+	DWord mismatches = 0;
+	for (const auto& key : expected)
+	{
+		mismatches += drawn.count(key) == 0;
+	}
+	for (const auto& key : drawn)
+	{
+		mismatches += expected.count(key) == 0;
+	}
+	if (mismatches > totals.tested / 100)
+	{
+		fmt::print("TEST: CPU drew {} meshlets, GPU {}, {} differ\n", expected.size(), drawn.size(), mismatches);
+	}
+	METAL_CHECK(mismatches <= totals.tested / 100);
+
+	vkDestroyBuffer(m_device, Readback, nullptr);
+	vkFreeMemory(m_device, ReadbackMemory, nullptr);
+	vkDestroyBuffer(m_device, Staging, nullptr);
+	vkFreeMemory(m_device, StagingMemory, nullptr);
+	vkDestroyImageView(m_device, DepthView, nullptr);
+	vkDestroyImage(m_device, DepthImage, nullptr);
+	vkFreeMemory(m_device, DepthMemory, nullptr);
+	delete gpupyramid;
+	delete renderer;
+	DestroyGpuMesh(mesh);
+}
+
+METAL_TEST(meshlet_cull_matches_gpu)
+{
+	if (!HasVulkanDevice() || VulkanSetupHeadless() != 0)
+	{
+		METAL_SKIP("no Vulkan device");
+	}
+
+	CompareMeshletCulling();
+	VulkanShutdownHeadless();
+}
@@ -0,0 +1,209 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine tests (virtual texture page resolver, run headless against an in-memory texture)
+// ------------------------------------------------------
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "MTest.hpp"
+#include "../src/headers/MVirtualTexture.hpp"
+
+using namespace engine::textures;
+using namespace engine::tests;
+
+/* A cooked virtual texture held in memory instead of a package*/
+struct MemoryVirtualTexture
+{
+	MetalVirtualTextureDesc	desc;
+	std::vector<Byte>		data;
+};
+
+static bool MemoryPageReader(void* userdata, DWord mip, DWord x, DWord y, Byte* destination, QWord size)
+{
+	const MemoryVirtualTexture* texture = static_cast<const MemoryVirtualTexture*>(userdata);
+	memcpy(destination, &texture->data[texture->desc.GetPageIndex(mip, x, y) * texture->desc.pagebytes], size);
+	return true;
+}
+
+/* 512x256 gives three levels, 4x2, 2x1 and 1x1 pages, every texel is different from its neighbours*/
+static void CookTestTexture(MemoryVirtualTexture& texture)
+{
+	const DWord Width = 512;
+	const DWord Height = 256;
+
+	std::vector<Byte> rgba(static_cast<usize>(Width) * Height * 4);
+	for (DWord y = 0; y < Height; y++)
+	{
+		for (DWord x = 0; x < Width; x++)
+		{
+			Byte* texel = &rgba[(static_cast<usize>(y) * Width + x) * 4];
+			texel[0] = static_cast<Byte>(x);
+			texel[1] = static_cast<Byte>(y);
+			texel[2] = static_cast<Byte>((x >> 8) * 16 + (y >> 8));
+			texel[3] = 255;
+		}
+	}
+
+	METAL_CHECK(CookVirtualTexture(rgba.data(), Width, Height, TT_NORMAL, texture.desc, texture.data, false) == 0);
+	METAL_CHECK(texture.desc.levels.size() == 3);
+}
+
+/* Updates until every read has finished, the uploads of every Update are checked against the cooked pages*/
+static void Settle(MetalPageResolver& resolver, DWord handle, const MemoryVirtualTexture& texture, DWord& uploaded, DWord& evicted)
+{
+	std::vector<MetalPageUpload> uploads;
+	for (int attempt = 0; attempt < 1000; attempt++)
+	{
+		uploads.clear();
+		resolver.Update(uploads);
+		uploaded += resolver.GetStats().uploaded;
+		evicted += resolver.GetStats().evicted;
+
+		/* The page an upload belongs to is whichever page the table maps to its slot*/
+		const MetalPageTable& table = resolver.GetPageTable(handle);
+		for (const MetalPageUpload& upload : uploads)
+		{
+			bool found = false;
+			for (DWord level = 0; level < texture.desc.levels.size() && !found; level++)
+			{
+				for (DWord i = 0; i < table.slots[level].size() && !found; i++)
+				{
+					if (table.slots[level][i] != upload.slot)
+					{
+						continue;
+					}
+
+					found = true;
+					DWord x = i % texture.desc.levels[level].pagesx;
+					DWord y = i / texture.desc.levels[level].pagesx;
+					METAL_CHECK(memcmp(resolver.GetStagingPage(upload.staging),
+						&texture.data[texture.desc.GetPageIndex(level, x, y) * texture.desc.pagebytes], texture.desc.pagebytes) == 0);
+				}
+			}
+			METAL_CHECK(found);
+		}
+
+		if (resolver.GetLoadingPages() == 0 && uploads.empty())
+		{
+			return;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	METAL_CHECK(resolver.GetLoadingPages() == 0);
+}
+
+/* Every entry has to point at the finest resident page covering it*/
+static void CheckPageTable(const MetalPageResolver& resolver, DWord handle, const MemoryVirtualTexture& texture)
+{
+	const MetalPageTable& table = resolver.GetPageTable(handle);
+	DWord levelcount = static_cast<DWord>(texture.desc.levels.size());
+	DWord cachewidth = resolver.GetCacheWidth();
+
+	for (DWord level = 0; level < levelcount; level++)
+	{
+		const MetalVirtualLevel& info = texture.desc.levels[level];
+		for (DWord y = 0; y < info.pagesy; y++)
+		{
+			for (DWord x = 0; x < info.pagesx; x++)
+			{
+				DWord expected = 0;
+				for (DWord mip = level, px = x, py = y; mip < levelcount; mip++, px >>= 1, py >>= 1)
+				{
+					if (resolver.IsResident(handle, mip, px, py))
+					{
+						DWord slot = table.slots[mip][py * texture.desc.levels[mip].pagesx + px];
+						expected = PackPageEntry(slot % cachewidth, slot / cachewidth, mip);
+						break;
+					}
+				}
+				METAL_CHECK(table.entries[level][y * info.pagesx + x] == expected);
+			}
+		}
+	}
+}
+
+METAL_TEST(page_resolver_residency)
+{
+	MemoryVirtualTexture texture;
+	CookTestTexture(texture);
+
+	std::vector<Byte> staging(8 * texture.desc.pagebytes);
+	MetalPageResolver resolver;
+	METAL_CHECK(resolver.Create(4, 4, texture.desc.pagebytes, staging.data(), 8, 2) == 0);
+
+	DWord handle = resolver.AddTexture(texture.desc, MemoryPageReader, &texture);
+	METAL_CHECK(handle == 0);
+
+	/* Only the coarsest page is asked for up front*/
+	DWord uploaded = 0, evicted = 0;
+	Settle(resolver, handle, texture, uploaded, evicted);
+	METAL_CHECK(uploaded == 1);
+	METAL_CHECK(resolver.IsResident(handle, 2, 0, 0));
+	METAL_CHECK(!resolver.IsResident(handle, 0, 3, 1));
+	CheckPageTable(resolver, handle, texture);
+
+	/* One feedback texel pulls in the page and the one above it, repeats are the same request*/
+	std::vector<DWord> feedback(64, VT_FEEDBACK_NONE);
+	feedback[10] = PackPageRequest(handle, 0, 3, 1);
+	feedback[11] = PackPageRequest(handle, 0, 3, 1);
+	resolver.ProcessFeedback(feedback.data(), feedback.size());
+
+	uploaded = 0;
+	Settle(resolver, handle, texture, uploaded, evicted);
+	METAL_CHECK(uploaded == 2);
+	METAL_CHECK(evicted == 0);
+	METAL_CHECK(resolver.IsResident(handle, 0, 3, 1));
+	METAL_CHECK(resolver.IsResident(handle, 1, 1, 0));
+	CheckPageTable(resolver, handle, texture);
+
+	/* The handle is reused once the texture is gone*/
+	resolver.RemoveTexture(handle);
+	std::vector<MetalPageUpload> uploads;
+	resolver.Update(uploads);
+	METAL_CHECK(!resolver.IsAlive(handle));
+	METAL_CHECK(resolver.AddTexture(texture.desc, MemoryPageReader, &texture) == handle);
+
+	resolver.Destroy();
+}
+
+METAL_TEST(page_resolver_eviction)
+{
+	MemoryVirtualTexture texture;
+	CookTestTexture(texture);
+
+	/* 4 cache pages for 11 pages of texture, the coarsest is pinned and the rest have to take turns*/
+	std::vector<Byte> staging(4 * texture.desc.pagebytes);
+	MetalPageResolver resolver;
+	METAL_CHECK(resolver.Create(2, 2, texture.desc.pagebytes, staging.data(), 4, 2) == 0);
+
+	DWord handle = resolver.AddTexture(texture.desc, MemoryPageReader, &texture);
+	DWord uploaded = 0, evicted = 0;
+	Settle(resolver, handle, texture, uploaded, evicted);
+
+	/* Sweep a window across level 0, every frame only asks for what it can see*/
+	for (DWord frame = 0; frame < 16; frame++)
+	{
+		DWord x = frame % 4;
+		DWord y = (frame / 4) % 2;
+		DWord request = PackPageRequest(handle, 0, x, y);
+		resolver.ProcessFeedback(&request, 1);
+		Settle(resolver, handle, texture, uploaded, evicted);
+
+		METAL_CHECK(resolver.IsResident(handle, 0, x, y));
+		METAL_CHECK(resolver.IsResident(handle, 2, 0, 0));
+		CheckPageTable(resolver, handle, texture);
+		resolver.ClearDirty(handle);
+	}
+
+	METAL_CHECK(evicted > 0);
+	METAL_CHECK(resolver.GetStats().resident <= 4);
+
+	resolver.Destroy();
+}
@@ -0,0 +1,83 @@
+// ------------------------------------------------------
+//
+//	ANDREW CONNER SKATZES (c) 2025
+//
+//	MIT License
+//
+//	Description:
+//		Engine tests (radix sort order and stability against std::stable_sort)
+// ------------------------------------------------------
+
+#include <algorithm>
+#include <random>
+
+#include "MTest.hpp"
+#include "../src/headers/MRadixSort.hpp"
+
+using namespace engine::jobs;
+using namespace engine::tests;
+
+/* Sorts the keys with their index as the payload, the way the instance batcher does, and checks
+	the result against std::stable_sort of the same indices. Returns the number of mismatches
+*/
+static DWord CompareWithStableSort(const std::vector<QWord>& keys)
+{
+	DWord count = static_cast<DWord>(keys.size());
+	std::vector<QWord> sorted(keys);
+	std::vector<DWord> order(count);
+	for (DWord i = 0; i < count; i++)
+	{
+		order[i] = i;
+	}
+
+	std::vector<QWord> scratchkeys(count);
+	std::vector<DWord> scratchorder(count);
+	RadixSort(sorted.data(), order.data(), count, scratchkeys.data(), scratchorder.data());
+
+	std::vector<DWord> expected(count);
+	for (DWord i = 0; i < count; i++)
+	{
+		expected[i] = i;
+	}
+	std::stable_sort(expected.begin(), expected.end(), [&keys](DWord a, DWord b) { return keys[a] < keys[b]; });
+
+	DWord mismatches = 0;
+	for (DWord i = 0; i < count; i++)
+	{
+		mismatches += order[i] != expected[i] || sorted[i] != keys[expected[i]];
+	}
+	return mismatches;
+}
+
+METAL_TEST(radix_sort_stable)
+{
+	std::mt19937_64 random(5);
+
+	/* Few distinct keys so almost every key has duplicates, spread over several blocks so the
+		scatter of one block has to land after the equal keys of the blocks before it
+	*/
+	std::uniform_int_distribution<DWord> pick(0, 63);
+	std::vector<QWord> keys(RADIX_SORT_BLOCK_SIZE * 12 + 17);
+	for (QWord& key : keys)
+	{
+		DWord value = pick(random);
+		key = (static_cast<QWord>(value & 7) << 56) | (static_cast<QWord>(value >> 3) << 20) | 0x1234;
+	}
+	METAL_CHECK(CompareWithStableSort(keys) == 0);
+
+	/* Below one block the sort runs on the calling thread*/
+	keys.resize(RADIX_SORT_BLOCK_SIZE / 3);
+	METAL_CHECK(CompareWithStableSort(keys) == 0);
+
+	/* Every key equal skips every pass, the order has to come back untouched*/
+	std::fill(keys.begin(), keys.end(), 0xABCDEFull);
+	METAL_CHECK(CompareWithStableSort(keys) == 0);
+
+	/* Full width keys with some duplicates mixed in*/
+	keys.resize(RADIX_SORT_BLOCK_SIZE * 5);
+	for (usize i = 0; i < keys.size(); i++)
+	{
+		keys[i] = i % 3 == 0 && i > 0 ? keys[i / 2] : random();
+	}
+	METAL_CHECK(CompareWithStableSort(keys) == 0);
+}